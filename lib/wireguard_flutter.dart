@@ -4,9 +4,21 @@ import 'package:flutter/foundation.dart';
 import 'package:wireguard_flutter/linux/wireguard_flutter_linux.dart';
 import 'package:wireguard_flutter/wireguard_flutter_method_channel.dart';
 
+import 'wireguard_flutter_logs.dart';
+import 'wireguard_flutter_metrics.dart';
 import 'wireguard_flutter_platform_interface.dart';
+import 'wireguard_flutter_statistics.dart';
+import 'wireguard_flutter_tunnels.dart';
+import 'wireguard_flutter_usage.dart';
 
 export 'wireguard_flutter_platform_interface.dart' show VpnStage;
+export 'wireguard_flutter_ffi.dart'
+    show WireGuardCounterReader, WireGuardCounters, WireGuardCounterState;
+export 'wireguard_flutter_logs.dart';
+export 'wireguard_flutter_metrics.dart';
+export 'wireguard_flutter_statistics.dart';
+export 'wireguard_flutter_tunnels.dart';
+export 'wireguard_flutter_usage.dart';
 
 class WireGuardFlutter extends WireGuardFlutterInterface {
   static WireGuardFlutterInterface? __instance;
@@ -59,4 +71,232 @@ class WireGuardFlutter extends WireGuardFlutterInterface {
 
   @override
   Future<VpnStage> stage() => _instance.stage();
+
+  @override
+  Future<WireGuardStatistics> statistics() => _instance.statistics();
+
+  @override
+  Future<List<WireGuardStatistics>> statisticsHistory({int? maxSamples}) =>
+      _instance.statisticsHistory(maxSamples: maxSamples);
+
+  @override
+  Future<void> configureStatistics({
+    Duration? ewmaTimeConstant,
+    int? windowSamples,
+  }) =>
+      _instance.configureStatistics(
+        ewmaTimeConstant: ewmaTimeConstant,
+        windowSamples: windowSamples,
+      );
+
+  @override
+  Stream<DataQuotaEvent> get dataQuotaEvents => _instance.dataQuotaEvents;
+
+  @override
+  Future<List<DataUsage>> dataUsage({String? tunnel}) =>
+      _instance.dataUsage(tunnel: tunnel);
+
+  @override
+  Future<void> setDataQuota({
+    String? tunnel,
+    required DataQuotaPeriod period,
+    required int limitBytes,
+    DataQuotaAction action = DataQuotaAction.notify,
+  }) =>
+      _instance.setDataQuota(
+        tunnel: tunnel,
+        period: period,
+        limitBytes: limitBytes,
+        action: action,
+      );
+
+  @override
+  Future<void> clearDataQuotas({String? tunnel}) =>
+      _instance.clearDataQuotas(tunnel: tunnel);
+
+  @override
+  Stream<TunnelStage> get tunnelStageSnapshot => _instance.tunnelStageSnapshot;
+
+  @override
+  Future<void> startTunnel({
+    required String tunnel,
+    required String wgQuickConfig,
+    List<EndpointCandidate>? raceEndpoints,
+    Duration? raceTimeout,
+  }) =>
+      _instance.startTunnel(
+        tunnel: tunnel,
+        wgQuickConfig: wgQuickConfig,
+        raceEndpoints: raceEndpoints,
+        raceTimeout: raceTimeout,
+      );
+
+  @override
+  Future<void> stopTunnel(String tunnel) => _instance.stopTunnel(tunnel);
+
+  @override
+  Future<VpnStage> tunnelStage(String tunnel) => _instance.tunnelStage(tunnel);
+
+  @override
+  Future<WireGuardStatistics> tunnelStatistics(String tunnel) =>
+      _instance.tunnelStatistics(tunnel);
+
+  @override
+  Future<List<TunnelInfo>> tunnels() => _instance.tunnels();
+
+  @override
+  Future<void> configureReconnect({
+    String? tunnel,
+    bool? enabled,
+    Duration? initialBackoff,
+    Duration? maxBackoff,
+    int? maxAttempts,
+  }) =>
+      _instance.configureReconnect(
+        tunnel: tunnel,
+        enabled: enabled,
+        initialBackoff: initialBackoff,
+        maxBackoff: maxBackoff,
+        maxAttempts: maxAttempts,
+      );
+
+  @override
+  Stream<RecoveryEvent> get recoveryEvents => _instance.recoveryEvents;
+
+  @override
+  Stream<EndpointRaceEvent> get endpointRaceEvents =>
+      _instance.endpointRaceEvents;
+
+  @override
+  Future<List<EndpointRank>> rankEndpoints(
+    List<String> endpoints, {
+    Duration? timeout,
+    int? rounds,
+    Duration? interval,
+  }) =>
+      _instance.rankEndpoints(
+        endpoints,
+        timeout: timeout,
+        rounds: rounds,
+        interval: interval,
+      );
+
+  @override
+  Future<void> prewarm({required String wgQuickConfig}) =>
+      _instance.prewarm(wgQuickConfig: wgQuickConfig);
+
+  @override
+  Future<void> setStandby({String? tunnel, StandbyPeer? peer}) =>
+      _instance.setStandby(tunnel: tunnel, peer: peer);
+
+  @override
+  Future<FailoverEvent> failover({String? tunnel}) =>
+      _instance.failover(tunnel: tunnel);
+
+  @override
+  Stream<FailoverEvent> get failoverEvents => _instance.failoverEvents;
+
+  @override
+  Stream<PathMtuEvent> get pathMtuEvents => _instance.pathMtuEvents;
+
+  @override
+  Future<void> configureKeepalive({
+    String? tunnel,
+    required bool adaptive,
+    Duration? minInterval,
+    Duration? maxInterval,
+  }) =>
+      _instance.configureKeepalive(
+        tunnel: tunnel,
+        adaptive: adaptive,
+        minInterval: minInterval,
+        maxInterval: maxInterval,
+      );
+
+  @override
+  Stream<KeepaliveEvent> get keepaliveEvents => _instance.keepaliveEvents;
+
+  @override
+  Future<int> startSpeedTest({
+    required String endpoint,
+    SpeedTestProtocol protocol = SpeedTestProtocol.tcp,
+    SpeedTestDirection direction = SpeedTestDirection.upload,
+    int? streams,
+    Duration? duration,
+    Duration? warmup,
+    Duration? interval,
+    int? rateBps,
+    int? datagramSize,
+    String? latencyEndpoint,
+  }) =>
+      _instance.startSpeedTest(
+        endpoint: endpoint,
+        protocol: protocol,
+        direction: direction,
+        streams: streams,
+        duration: duration,
+        warmup: warmup,
+        interval: interval,
+        rateBps: rateBps,
+        datagramSize: datagramSize,
+        latencyEndpoint: latencyEndpoint,
+      );
+
+  @override
+  Future<void> stopSpeedTest() => _instance.stopSpeedTest();
+
+  @override
+  Stream<SpeedTestReport> get speedTestEvents => _instance.speedTestEvents;
+
+  @override
+  Future<void> configureLatencyProbe({
+    String? tunnel,
+    required bool enabled,
+    String? target,
+    Duration? interval,
+    Duration? timeout,
+    int? window,
+  }) =>
+      _instance.configureLatencyProbe(
+        tunnel: tunnel,
+        enabled: enabled,
+        target: target,
+        interval: interval,
+        timeout: timeout,
+        window: window,
+      );
+
+  @override
+  Future<PluginMetrics> pluginMetrics() => _instance.pluginMetrics();
+
+  @override
+  Future<void> resetPluginMetrics() => _instance.resetPluginMetrics();
+
+  @override
+  Future<void> setTracing(bool enabled) => _instance.setTracing(enabled);
+
+  @override
+  Future<String> dumpTrace({String? path}) => _instance.dumpTrace(path: path);
+
+  @override
+  Future<void> setPluginLogLevel(PluginLogLevel level) =>
+      _instance.setPluginLogLevel(level);
+
+  @override
+  Future<ConnectTimings> connectTimings({String? tunnel}) =>
+      _instance.connectTimings(tunnel: tunnel);
+
+  @override
+  Stream<DriverLogEntry> driverLogs({
+    DriverLogLevel minLevel = DriverLogLevel.info,
+    Duration batchInterval = const Duration(milliseconds: 250),
+  }) =>
+      _instance.driverLogs(minLevel: minLevel, batchInterval: batchInterval);
+
+  @override
+  Future<List<DriverLogEntry>> recentDriverLogs({
+    int maxEntries = 100,
+    DriverLogLevel minLevel = DriverLogLevel.info,
+  }) =>
+      _instance.recentDriverLogs(maxEntries: maxEntries, minLevel: minLevel);
 }
@@ -0,0 +1,197 @@
+import 'dart:ffi';
+import 'dart:io';
+
+import 'package:ffi/ffi.dart';
+
+/// Mirror of `WireguardFlutterStatsBlock` in
+/// `windows/include/wireguard_flutter/wireguard_flutter_stats_c_api.h`.
+final class _StatsBlock extends Struct {
+  @Uint32()
+  external int sequence;
+  @Uint32()
+  external int version;
+  @Int32()
+  external int state;
+  @Uint32()
+  external int reserved0;
+  @Int64()
+  external int bytesIn;
+  @Int64()
+  external int bytesOut;
+  @Int64()
+  external int speedInBps;
+  @Int64()
+  external int speedOutBps;
+  @Int64()
+  external int smoothedInBps;
+  @Int64()
+  external int smoothedOutBps;
+  @Int64()
+  external int handshakeAgeMs;
+  @Int64()
+  external int updatedAtMs;
+  @Int64()
+  external int packetsInPerSec;
+  @Int64()
+  external int packetsOutPerSec;
+  @Int64()
+  external int dropRatioPpm;
+  @Int64()
+  external int rttP50Us;
+  @Int64()
+  external int rttJitterUs;
+  @Int64()
+  external int rttLossPpm;
+}
+
+/// Tunnel state as published in the counter block.
+enum WireGuardCounterState {
+  disconnected,
+  connecting,
+  connected,
+  error,
+  disconnecting,
+  reconnecting,
+  degraded,
+}
+
+/// Consistent copy of the native counter block.
+class WireGuardCounters {
+  final int version;
+  final WireGuardCounterState state;
+  final int bytesIn;
+  final int bytesOut;
+  final int speedInBps;
+  final int speedOutBps;
+  final int smoothedInBps;
+  final int smoothedOutBps;
+
+  /// Time since the last completed handshake, `null` before the first one.
+  final Duration? handshakeAge;
+
+  /// Monotonic timestamp of the last native update, in milliseconds.
+  final int updatedAtMs;
+
+  final int packetsInPerSec;
+  final int packetsOutPerSec;
+
+  /// Dropped and errored packets in the last interval, in parts per million.
+  final int dropRatioPpm;
+
+  /// Median round trip of the background probe through the tunnel and its
+  /// jitter, `null` until the probe has been answered.
+  final Duration? rttP50;
+  final Duration? rttJitter;
+
+  /// Probes lost over the probe's window, in parts per million.
+  final int rttLossPpm;
+
+  const WireGuardCounters({
+    required this.version,
+    required this.state,
+    required this.bytesIn,
+    required this.bytesOut,
+    required this.speedInBps,
+    required this.speedOutBps,
+    required this.smoothedInBps,
+    required this.smoothedOutBps,
+    required this.handshakeAge,
+    required this.updatedAtMs,
+    required this.packetsInPerSec,
+    required this.packetsOutPerSec,
+    required this.dropRatioPpm,
+    this.rttP50,
+    this.rttJitter,
+    this.rttLossPpm = 0,
+  });
+}
+
+/// Reads the counters the Windows sampler publishes in shared memory.
+///
+/// A read is one native call that copies the block under its seqlock, with
+/// no platform-channel message, so it is cheap enough to call on every frame.
+class WireGuardCounterReader implements Finalizable {
+  static const _libraryName = 'wireguard_flutter_plugin.dll';
+  static final _finalizer = NativeFinalizer(calloc.nativeFree);
+
+  final int _index;
+  final int Function(int, Pointer<_StatsBlock>) _readAt;
+  final void Function() _removeReader;
+
+  /// Snapshot buffer the native side copies into, owned by this reader.
+  final Pointer<_StatsBlock> _snapshot;
+  bool _closed = false;
+
+  WireGuardCounterReader._(this._index, this._readAt, this._removeReader)
+      : _snapshot = calloc<_StatsBlock>() {
+    _finalizer.attach(this, _snapshot.cast(), detach: this);
+  }
+
+  /// Returns a reader for the counter block at [block], as reported by
+  /// `tunnels()`; block 0 belongs to the first tunnel. Returns `null` when
+  /// the platform has no native counter block.
+  ///
+  /// The plugin only publishes samples while someone consumes them, so an
+  /// open reader keeps sampling on; [close] it when done.
+  static WireGuardCounterReader? open({int block = 0}) {
+    if (!Platform.isWindows || block < 0) return null;
+    final library = DynamicLibrary.open(_libraryName);
+    final getBlock = library.lookupFunction<Pointer<_StatsBlock> Function(Uint32),
+        Pointer<_StatsBlock> Function(int)>('WireguardFlutterGetStatsBlockAt');
+    if (getBlock(block) == nullptr) return null;
+    final readAt = library.lookupFunction<
+        Int32 Function(Uint32, Pointer<_StatsBlock>),
+        int Function(int, Pointer<_StatsBlock>)>('WireguardFlutterReadStatsAt',
+        isLeaf: true);
+
+    final addReader = library.lookupFunction<Void Function(), void Function()>(
+        'WireguardFlutterAddStatsReader');
+    final removeReader = library.lookupFunction<Void Function(),
+        void Function()>('WireguardFlutterRemoveStatsReader');
+    addReader();
+    return WireGuardCounterReader._(block, readAt, removeReader);
+  }
+
+  /// Stops counting this reader as a consumer. The block stays readable.
+  void close() {
+    if (_closed) return;
+    _closed = true;
+    _removeReader();
+  }
+
+  /// Takes a consistent snapshot of the block. Returns `null` if the native
+  /// library rejected the read.
+  WireGuardCounters? read() {
+    if (_readAt(_index, _snapshot) != 0) return null;
+    final block = _snapshot.ref;
+    return WireGuardCounters(
+      version: block.version,
+      state: _state(block.state),
+      bytesIn: block.bytesIn,
+      bytesOut: block.bytesOut,
+      speedInBps: block.speedInBps,
+      speedOutBps: block.speedOutBps,
+      smoothedInBps: block.smoothedInBps,
+      smoothedOutBps: block.smoothedOutBps,
+      handshakeAge: block.handshakeAgeMs < 0
+          ? null
+          : Duration(milliseconds: block.handshakeAgeMs),
+      updatedAtMs: block.updatedAtMs,
+      packetsInPerSec: block.version >= 2 ? block.packetsInPerSec : 0,
+      packetsOutPerSec: block.version >= 2 ? block.packetsOutPerSec : 0,
+      dropRatioPpm: block.version >= 2 ? block.dropRatioPpm : 0,
+      rttP50: block.version >= 3 && block.rttP50Us > 0
+          ? Duration(microseconds: block.rttP50Us)
+          : null,
+      rttJitter: block.version >= 3 && block.rttP50Us > 0
+          ? Duration(microseconds: block.rttJitterUs)
+          : null,
+      rttLossPpm: block.version >= 3 ? block.rttLossPpm : 0,
+    );
+  }
+
+  static WireGuardCounterState _state(int value) =>
+      value >= 0 && value < WireGuardCounterState.values.length
+          ? WireGuardCounterState.values[value]
+          : WireGuardCounterState.disconnected;
+}
@@ -0,0 +1,62 @@
+/// Severity of a WireGuard driver log message.
+enum DriverLogLevel {
+  info('info'),
+  warn('warn'),
+  error('error');
+
+  final String code;
+
+  const DriverLogLevel(this.code);
+}
+
+/// Level of the plugin's own log output.
+enum PluginLogLevel {
+  debug('debug'),
+  info('info'),
+  warn('warn'),
+  error('error');
+
+  final String code;
+
+  const PluginLogLevel(this.code);
+}
+
+/// One message from the WireGuard driver or wireguard.dll.
+class DriverLogEntry {
+  /// Position in the native log ring; gaps mean messages were lost or
+  /// filtered out.
+  final int sequence;
+  final DateTime timestamp;
+  final DriverLogLevel level;
+  final String message;
+
+  const DriverLogEntry({
+    required this.sequence,
+    required this.timestamp,
+    required this.level,
+    required this.message,
+  });
+
+  factory DriverLogEntry.fromMap(Map<Object?, Object?> map) => DriverLogEntry(
+        sequence: map['seq'] as int? ?? 0,
+        timestamp: DateTime.fromMillisecondsSinceEpoch(
+          map['timestampMs'] as int? ?? 0,
+          isUtc: true,
+        ),
+        level: DriverLogLevel.values.firstWhere(
+          (level) => level.code == map['level'],
+          orElse: () => DriverLogLevel.info,
+        ),
+        message: map['message'] as String? ?? '',
+      );
+
+  static List<DriverLogEntry> decodeList(Object? value) => value is List
+      ? [
+          for (final entry in value)
+            if (entry is Map) DriverLogEntry.fromMap(entry),
+        ]
+      : const [];
+
+  @override
+  String toString() => '$timestamp ${level.code}: $message';
+}
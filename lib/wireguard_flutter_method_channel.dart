@@ -1,6 +1,11 @@
 import 'package:flutter/services.dart';
 
+import 'wireguard_flutter_logs.dart';
+import 'wireguard_flutter_metrics.dart';
 import 'wireguard_flutter_platform_interface.dart';
+import 'wireguard_flutter_statistics.dart';
+import 'wireguard_flutter_tunnels.dart';
+import 'wireguard_flutter_usage.dart';
 
 class WireGuardFlutterMethodChannel extends WireGuardFlutterInterface {
   static const _methodChannelVpnControl =
@@ -9,20 +14,42 @@ class WireGuardFlutterMethodChannel extends WireGuardFlutterInterface {
   static const _eventChannelVpnStage =
       'billion.group.wireguard_flutter/wgstage';
   static const _eventChannel = EventChannel(_eventChannelVpnStage);
+  static const _eventChannelDriverLog = 'billion.group.wireguard_flutter/wglog';
+  static const _logChannel = EventChannel(_eventChannelDriverLog);
+
+  /// Tunnel the native side uses when a call names none.
+  String _defaultTunnel = 'default';
 
   @override
-  Stream<VpnStage> get vpnStageSnapshot =>
-      _eventChannel.receiveBroadcastStream().map(
-            (event) => event == VpnStage.denied.code
-                ? VpnStage.disconnected
-                : VpnStage.values.firstWhere(
-                    (stage) => stage.code == event,
-                    orElse: () => VpnStage.noConnection,
-                  ),
-          );
+  Stream<VpnStage> get vpnStageSnapshot => _eventChannel
+      .receiveBroadcastStream()
+      .map(_stageCode)
+      .where((code) => code != null)
+      .map(_stageFromCode);
+
+  /// Mobile platforms send the bare stage code; Windows sends
+  /// `{"event": "stage", "tunnel": name, "stage": code, "seq": n}` for every
+  /// tunnel, and other event maps.
+  String? _stageCode(dynamic event) {
+    if (event is String) return event;
+    if (event is Map &&
+        event['event'] == 'stage' &&
+        (event['tunnel'] ?? _defaultTunnel) == _defaultTunnel) {
+      return event['stage'] as String?;
+    }
+    return null;
+  }
+
+  static VpnStage _stageFromCode(String? code) => code == VpnStage.denied.code
+      ? VpnStage.disconnected
+      : VpnStage.values.firstWhere(
+          (stage) => stage.code == code,
+          orElse: () => VpnStage.noConnection,
+        );
 
   @override
   Future<void> initialize({required String interfaceName}) {
+    _defaultTunnel = interfaceName.isEmpty ? 'default' : interfaceName;
     return _methodChannel.invokeMethod("initialize", {
       "localizedDescription": interfaceName,
       "win32ServiceName": interfaceName,
@@ -57,4 +84,308 @@ class WireGuardFlutterMethodChannel extends WireGuardFlutterInterface {
               )
             : VpnStage.disconnected,
       );
+
+  @override
+  Future<WireGuardStatistics> statistics() => _methodChannel
+      .invokeMethod('getWireGuardStatistics')
+      .then(WireGuardStatistics.decode);
+
+  @override
+  Future<List<WireGuardStatistics>> statisticsHistory({int? maxSamples}) =>
+      _methodChannel.invokeMethod('getWireGuardStatisticsHistory', {
+        if (maxSamples != null) 'maxSamples': maxSamples,
+      }).then(WireGuardStatistics.decodeHistory);
+
+  @override
+  Future<void> configureStatistics({
+    Duration? ewmaTimeConstant,
+    int? windowSamples,
+  }) =>
+      _methodChannel.invokeMethod('configureStatistics', {
+        if (ewmaTimeConstant != null)
+          'ewmaTimeConstantMs': ewmaTimeConstant.inMilliseconds,
+        if (windowSamples != null) 'windowSamples': windowSamples,
+      });
+
+  @override
+  Stream<DataQuotaEvent> get dataQuotaEvents => _eventChannel
+      .receiveBroadcastStream()
+      .where((event) => event is Map && event['event'] == 'quota_exceeded')
+      .map((event) => DataQuotaEvent.fromMap(event as Map));
+
+  @override
+  Future<List<DataUsage>> dataUsage({String? tunnel}) => _methodChannel
+      .invokeMethod('getDataUsage', {
+        if (tunnel != null) 'tunnel': tunnel,
+      }).then(DataUsage.decodeList);
+
+  @override
+  Future<void> setDataQuota({
+    String? tunnel,
+    required DataQuotaPeriod period,
+    required int limitBytes,
+    DataQuotaAction action = DataQuotaAction.notify,
+  }) =>
+      _methodChannel.invokeMethod('setDataQuota', {
+        if (tunnel != null) 'tunnel': tunnel,
+        'period': period.code,
+        'limitBytes': limitBytes,
+        'action': action.code,
+      });
+
+  @override
+  Future<void> clearDataQuotas({String? tunnel}) =>
+      _methodChannel.invokeMethod('clearDataQuotas', {
+        if (tunnel != null) 'tunnel': tunnel,
+      });
+
+  @override
+  Stream<TunnelStage> get tunnelStageSnapshot => _eventChannel
+      .receiveBroadcastStream()
+      .where((event) => event is Map && event['event'] == 'stage')
+      .map((event) => TunnelStage(
+            tunnel: event['tunnel'] as String? ?? _defaultTunnel,
+            stage: _stageFromCode(event['stage'] as String?),
+          ));
+
+  @override
+  Future<void> startTunnel({
+    required String tunnel,
+    required String wgQuickConfig,
+    List<EndpointCandidate>? raceEndpoints,
+    Duration? raceTimeout,
+  }) =>
+      _methodChannel.invokeMethod('start', {
+        'tunnel': tunnel,
+        'wgQuickConfig': wgQuickConfig,
+        if (raceEndpoints != null)
+          'raceEndpoints': [
+            for (final candidate in raceEndpoints) candidate.toMap(),
+          ],
+        if (raceTimeout != null) 'raceTimeoutMs': raceTimeout.inMilliseconds,
+      });
+
+  @override
+  Future<void> stopTunnel(String tunnel) =>
+      _methodChannel.invokeMethod('stop', {'tunnel': tunnel});
+
+  @override
+  Future<VpnStage> tunnelStage(String tunnel) => _methodChannel
+      .invokeMethod('stage', {'tunnel': tunnel})
+      .then((value) => _stageFromCode(value?.toString()));
+
+  @override
+  Future<WireGuardStatistics> tunnelStatistics(String tunnel) => _methodChannel
+      .invokeMethod('getWireGuardStatistics', {'tunnel': tunnel})
+      .then(WireGuardStatistics.decode);
+
+  @override
+  Future<List<TunnelInfo>> tunnels() =>
+      _methodChannel.invokeMethod('getTunnels').then((value) => [
+            for (final entry in value is List ? value : const [])
+              if (entry is Map)
+                TunnelInfo(
+                  tunnel: entry['tunnel'] as String? ?? '',
+                  stage: _stageFromCode(entry['stage'] as String?),
+                  statsBlock: entry['statsBlock'] as int? ?? -1,
+                ),
+          ]);
+
+  @override
+  Future<void> configureReconnect({
+    String? tunnel,
+    bool? enabled,
+    Duration? initialBackoff,
+    Duration? maxBackoff,
+    int? maxAttempts,
+  }) =>
+      _methodChannel.invokeMethod('configureReconnect', {
+        if (tunnel != null) 'tunnel': tunnel,
+        if (enabled != null) 'enabled': enabled,
+        if (initialBackoff != null)
+          'initialBackoffMs': initialBackoff.inMilliseconds,
+        if (maxBackoff != null) 'maxBackoffMs': maxBackoff.inMilliseconds,
+        if (maxAttempts != null) 'maxAttempts': maxAttempts,
+      });
+
+  @override
+  Stream<RecoveryEvent> get recoveryEvents => _eventChannel
+      .receiveBroadcastStream()
+      .where((event) => event is Map && event['event'] == 'recovery')
+      .map((event) => RecoveryEvent.fromMap(event as Map));
+
+  @override
+  Stream<EndpointRaceEvent> get endpointRaceEvents => _eventChannel
+      .receiveBroadcastStream()
+      .where((event) => event is Map && event['event'] == 'endpoint_race')
+      .map((event) => EndpointRaceEvent.fromMap(event as Map));
+
+  @override
+  Future<List<EndpointRank>> rankEndpoints(
+    List<String> endpoints, {
+    Duration? timeout,
+    int? rounds,
+    Duration? interval,
+  }) =>
+      _methodChannel.invokeMethod('rankEndpoints', {
+        'endpoints': endpoints,
+        if (timeout != null) 'timeoutMs': timeout.inMilliseconds,
+        if (rounds != null) 'rounds': rounds,
+        if (interval != null) 'intervalMs': interval.inMilliseconds,
+      }).then((value) => [
+            for (final entry in value is List ? value : const [])
+              if (entry is Map) EndpointRank.fromMap(entry),
+          ]);
+
+  @override
+  Future<void> prewarm({required String wgQuickConfig}) => _methodChannel
+      .invokeMethod('prewarm', {'wgQuickConfig': wgQuickConfig});
+
+  @override
+  Future<void> setStandby({String? tunnel, StandbyPeer? peer}) =>
+      _methodChannel.invokeMethod('setStandby', {
+        if (tunnel != null) 'tunnel': tunnel,
+        ...?peer?.toMap(),
+      });
+
+  @override
+  Future<FailoverEvent> failover({String? tunnel}) => _methodChannel
+      .invokeMethod('failover', {if (tunnel != null) 'tunnel': tunnel}).then(
+          (value) => FailoverEvent.fromMap(value is Map ? value : const {}));
+
+  @override
+  Stream<FailoverEvent> get failoverEvents => _eventChannel
+      .receiveBroadcastStream()
+      .where((event) => event is Map && event['event'] == 'failover')
+      .map((event) => FailoverEvent.fromMap(event as Map));
+
+  @override
+  Stream<PathMtuEvent> get pathMtuEvents => _eventChannel
+      .receiveBroadcastStream()
+      .where((event) => event is Map && event['event'] == 'path_mtu')
+      .map((event) => PathMtuEvent.fromMap(event as Map));
+
+  @override
+  Future<void> configureKeepalive({
+    String? tunnel,
+    required bool adaptive,
+    Duration? minInterval,
+    Duration? maxInterval,
+  }) =>
+      _methodChannel.invokeMethod('configureKeepalive', {
+        if (tunnel != null) 'tunnel': tunnel,
+        'adaptive': adaptive,
+        if (minInterval != null) 'minSeconds': minInterval.inSeconds,
+        if (maxInterval != null) 'maxSeconds': maxInterval.inSeconds,
+      });
+
+  @override
+  Stream<KeepaliveEvent> get keepaliveEvents => _eventChannel
+      .receiveBroadcastStream()
+      .where((event) => event is Map && event['event'] == 'keepalive')
+      .map((event) => KeepaliveEvent.fromMap(event as Map));
+
+  @override
+  Future<int> startSpeedTest({
+    required String endpoint,
+    SpeedTestProtocol protocol = SpeedTestProtocol.tcp,
+    SpeedTestDirection direction = SpeedTestDirection.upload,
+    int? streams,
+    Duration? duration,
+    Duration? warmup,
+    Duration? interval,
+    int? rateBps,
+    int? datagramSize,
+    String? latencyEndpoint,
+  }) =>
+      _methodChannel.invokeMethod<int>('startSpeedTest', {
+        'endpoint': endpoint,
+        'protocol': protocol.code,
+        'direction': direction.code,
+        if (streams != null) 'streams': streams,
+        if (duration != null) 'durationMs': duration.inMilliseconds,
+        if (warmup != null) 'warmupMs': warmup.inMilliseconds,
+        if (interval != null) 'intervalMs': interval.inMilliseconds,
+        if (rateBps != null) 'rateBps': rateBps,
+        if (datagramSize != null) 'datagramSize': datagramSize,
+        if (latencyEndpoint != null) 'latencyEndpoint': latencyEndpoint,
+      }).then((id) => id ?? 0);
+
+  @override
+  Future<void> stopSpeedTest() => _methodChannel.invokeMethod('stopSpeedTest');
+
+  @override
+  Stream<SpeedTestReport> get speedTestEvents => _eventChannel
+      .receiveBroadcastStream()
+      .where((event) => event is Map && event['event'] == 'speed_test')
+      .map((event) => SpeedTestReport.fromMap(event as Map));
+
+  @override
+  Future<void> configureLatencyProbe({
+    String? tunnel,
+    required bool enabled,
+    String? target,
+    Duration? interval,
+    Duration? timeout,
+    int? window,
+  }) =>
+      _methodChannel.invokeMethod('configureLatencyProbe', {
+        if (tunnel != null) 'tunnel': tunnel,
+        'enabled': enabled,
+        if (target != null) 'target': target,
+        if (interval != null) 'intervalMs': interval.inMilliseconds,
+        if (timeout != null) 'timeoutMs': timeout.inMilliseconds,
+        if (window != null) 'window': window,
+      });
+
+  @override
+  Future<PluginMetrics> pluginMetrics() => _methodChannel
+      .invokeMethod('getPluginMetrics')
+      .then(PluginMetrics.decode);
+
+  @override
+  Future<void> resetPluginMetrics() =>
+      _methodChannel.invokeMethod('resetPluginMetrics');
+
+  @override
+  Future<void> setTracing(bool enabled) =>
+      _methodChannel.invokeMethod('setTracing', {'enabled': enabled});
+
+  @override
+  Future<String> dumpTrace({String? path}) => _methodChannel
+      .invokeMapMethod<String, Object?>('dumpTrace', {'path': path})
+      .then((result) => result?['path'] as String? ?? '');
+
+  @override
+  Future<void> setPluginLogLevel(PluginLogLevel level) =>
+      _methodChannel.invokeMethod('setLogLevel', {'level': level.code});
+
+  @override
+  Future<ConnectTimings> connectTimings({String? tunnel}) => _methodChannel
+      .invokeMethod('getConnectTimings', {
+        if (tunnel != null) 'tunnel': tunnel,
+      }).then(ConnectTimings.decode);
+
+  @override
+  Stream<DriverLogEntry> driverLogs({
+    DriverLogLevel minLevel = DriverLogLevel.info,
+    Duration batchInterval = const Duration(milliseconds: 250),
+  }) =>
+      _logChannel
+          .receiveBroadcastStream({
+            'minLevel': minLevel.code,
+            'batchMs': batchInterval.inMilliseconds,
+          })
+          .where((event) => event is Map && event['event'] == 'log')
+          .expand((event) => DriverLogEntry.decodeList(event['entries']));
+
+  @override
+  Future<List<DriverLogEntry>> recentDriverLogs({
+    int maxEntries = 100,
+    DriverLogLevel minLevel = DriverLogLevel.info,
+  }) =>
+      _methodChannel.invokeMethod('getDriverLogs', {
+        'maxEntries': maxEntries,
+        'minLevel': minLevel.code,
+      }).then(DriverLogEntry.decodeList);
 }
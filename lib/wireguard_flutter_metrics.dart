@@ -0,0 +1,211 @@
+import 'wireguard_flutter_logs.dart';
+
+/// Cost of the native plugin itself, as opposed to the tunnels it runs.
+class PluginMetrics {
+  /// Time since the plugin's event loop started.
+  final Duration uptime;
+
+  /// Times the event loop thread woke up, for timers and notifications alike.
+  final int wakeups;
+
+  /// [wakeups] averaged over [uptime].
+  final double wakeupsPerHour;
+
+  /// Monitor ticks run across all tunnels.
+  final int monitorTicks;
+
+  /// Interval the monitor chose after its last tick.
+  final Duration monitorInterval;
+
+  /// Whether the last tick found nobody listening for stages or statistics,
+  /// so only the link was checked.
+  final bool monitorIdle;
+
+  /// Time since the method counters were last reset.
+  final Duration sinceReset;
+
+  /// Per method-channel method, for methods called since the last reset.
+  final Map<String, MethodCallMetrics> methods;
+
+  /// Level below which the plugin's own log records are discarded.
+  final PluginLogLevel logLevel;
+
+  /// Plugin log records dropped because a thread logged faster than they
+  /// could be written.
+  final int logsDropped;
+
+  const PluginMetrics({
+    required this.uptime,
+    required this.wakeups,
+    required this.wakeupsPerHour,
+    required this.monitorTicks,
+    required this.monitorInterval,
+    required this.monitorIdle,
+    required this.sinceReset,
+    required this.methods,
+    required this.logLevel,
+    required this.logsDropped,
+  });
+
+  factory PluginMetrics.fromMap(Map<Object?, Object?> map) => PluginMetrics(
+        uptime: Duration(milliseconds: map['uptimeMs'] as int? ?? 0),
+        wakeups: map['wakeups'] as int? ?? 0,
+        wakeupsPerHour: (map['wakeupsPerHour'] as num? ?? 0).toDouble(),
+        monitorTicks: map['monitorTicks'] as int? ?? 0,
+        monitorInterval:
+            Duration(milliseconds: map['monitorIntervalMs'] as int? ?? 0),
+        monitorIdle: map['monitorIdle'] as bool? ?? false,
+        sinceReset: Duration(milliseconds: map['sinceResetMs'] as int? ?? 0),
+        methods: {
+          for (final entry in (map['methods'] as Map? ?? const {}).entries)
+            if (entry.key is String && entry.value is Map)
+              entry.key as String:
+                  MethodCallMetrics.fromMap(entry.value as Map),
+        },
+        logLevel: PluginLogLevel.values.firstWhere(
+          (level) => level.code == map['logLevel'],
+          orElse: () => PluginLogLevel.info,
+        ),
+        logsDropped: map['logsDropped'] as int? ?? 0,
+      );
+
+  static PluginMetrics decode(Object? value) => PluginMetrics.fromMap(
+      value is Map ? value : const <Object?, Object?>{});
+}
+
+/// Calls of one method-channel method. Latency runs from the native
+/// handler's entry until the reply is sent; percentiles are accurate to
+/// about 12.5%.
+class MethodCallMetrics {
+  final int calls;
+
+  /// Calls answered with an error or as not implemented.
+  final int errors;
+  final Duration mean;
+  final Duration p50;
+  final Duration p90;
+  final Duration p99;
+  final Duration max;
+
+  const MethodCallMetrics({
+    required this.calls,
+    required this.errors,
+    required this.mean,
+    required this.p50,
+    required this.p90,
+    required this.p99,
+    required this.max,
+  });
+
+  factory MethodCallMetrics.fromMap(Map<Object?, Object?> map) {
+    Duration us(String key) => Duration(microseconds: map[key] as int? ?? 0);
+    return MethodCallMetrics(
+      calls: map['calls'] as int? ?? 0,
+      errors: map['errors'] as int? ?? 0,
+      mean: us('meanUs'),
+      p50: us('p50Us'),
+      p90: us('p90Us'),
+      p99: us('p99Us'),
+      max: us('maxUs'),
+    );
+  }
+}
+
+/// Phases of a connect, in order; each starts when the previous one ends.
+enum ConnectPhase {
+  configWrite('configWrite'),
+  serviceInstall('serviceInstall'),
+  serviceStart('serviceStart'),
+  adapterUp('adapterUp'),
+  firstHandshake('firstHandshake');
+
+  final String code;
+
+  const ConnectPhase(this.code);
+}
+
+/// Distribution of one phase over every connect recorded on this machine.
+/// Percentiles are accurate to about 12.5%.
+class ConnectPhaseLatency {
+  final int count;
+  final Duration mean;
+  final Duration p50;
+  final Duration p90;
+  final Duration p99;
+  final Duration max;
+
+  const ConnectPhaseLatency({
+    required this.count,
+    required this.mean,
+    required this.p50,
+    required this.p90,
+    required this.p99,
+    required this.max,
+  });
+
+  factory ConnectPhaseLatency.fromMap(Map<Object?, Object?> map) {
+    Duration ms(String key) => Duration(milliseconds: map[key] as int? ?? 0);
+    return ConnectPhaseLatency(
+      count: map['count'] as int? ?? 0,
+      mean: ms('meanMs'),
+      p50: ms('p50Ms'),
+      p90: ms('p90Ms'),
+      p99: ms('p99Ms'),
+      max: ms('maxMs'),
+    );
+  }
+}
+
+/// Where connect time went, for the latest attempt and across sessions.
+class ConnectTimings {
+  final String tunnel;
+
+  /// Start of the latest attempt, or `null` if the tunnel never connected
+  /// since the plugin started.
+  final DateTime? startedAt;
+
+  /// Whether the latest attempt is over; phases missing from a finished
+  /// attempt were never reached.
+  final bool finished;
+
+  /// Durations of the phases the latest attempt got through.
+  final Map<ConnectPhase, Duration> phases;
+
+  /// Aggregated over every finished attempt, persisted across sessions.
+  final Map<ConnectPhase, ConnectPhaseLatency> histograms;
+
+  const ConnectTimings({
+    required this.tunnel,
+    required this.startedAt,
+    required this.finished,
+    required this.phases,
+    required this.histograms,
+  });
+
+  factory ConnectTimings.fromMap(Map<Object?, Object?> map) {
+    final latest = map['latest'];
+    final phases = latest is Map ? latest['phases'] : null;
+    final histograms = map['histograms'];
+    return ConnectTimings(
+      tunnel: map['tunnel'] as String? ?? '',
+      startedAt: latest is Map
+          ? DateTime.fromMillisecondsSinceEpoch(
+              latest['startedAtMs'] as int? ?? 0)
+          : null,
+      finished: latest is Map && latest['finished'] == true,
+      phases: {
+        for (final phase in ConnectPhase.values)
+          if (phases is Map && phases[phase.code] is int)
+            phase: Duration(milliseconds: phases[phase.code] as int),
+      },
+      histograms: {
+        for (final phase in ConnectPhase.values)
+          if (histograms is Map && histograms[phase.code] is Map)
+            phase: ConnectPhaseLatency.fromMap(histograms[phase.code] as Map),
+      },
+    );
+  }
+
+  static ConnectTimings decode(Object? value) => ConnectTimings.fromMap(
+      value is Map ? value : const <Object?, Object?>{});
+}
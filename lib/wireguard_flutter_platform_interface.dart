@@ -1,3 +1,9 @@
+import 'wireguard_flutter_logs.dart';
+import 'wireguard_flutter_metrics.dart';
+import 'wireguard_flutter_statistics.dart';
+import 'wireguard_flutter_tunnels.dart';
+import 'wireguard_flutter_usage.dart';
+
 abstract class WireGuardFlutterInterface {
   Stream<VpnStage> get vpnStageSnapshot;
 
@@ -15,6 +21,262 @@ abstract class WireGuardFlutterInterface {
   Future<VpnStage> stage();
   Future<bool> isConnected() =>
       stage().then((stage) => stage == VpnStage.connected);
+
+  Future<WireGuardStatistics> statistics() => throw UnimplementedError(
+      'statistics() is not supported on this platform');
+
+  /// Recent statistics samples, oldest first, at most [maxSamples].
+  Future<List<WireGuardStatistics>> statisticsHistory({int? maxSamples}) =>
+      throw UnimplementedError(
+          'statisticsHistory() is not supported on this platform');
+
+  /// Tunes the native rate estimator: [ewmaTimeConstant] controls smoothing
+  /// (zero disables it) and [windowSamples] the window used for peak and
+  /// percentile rates.
+  Future<void> configureStatistics({
+    Duration? ewmaTimeConstant,
+    int? windowSamples,
+  }) =>
+      throw UnimplementedError(
+          'configureStatistics() is not supported on this platform');
+
+  /// Emits when a quota set with [setDataQuota] is exceeded.
+  Stream<DataQuotaEvent> get dataQuotaEvents => throw UnimplementedError(
+      'dataQuotaEvents is not supported on this platform');
+
+  /// Recorded traffic per tunnel and UTC day, oldest first. Without [tunnel]
+  /// every tunnel is returned.
+  Future<List<DataUsage>> dataUsage({String? tunnel}) =>
+      throw UnimplementedError('dataUsage() is not supported on this platform');
+
+  /// Sets a quota of [limitBytes] (in plus out) for [tunnel], or for all
+  /// tunnels combined when [tunnel] is null. Quotas are not persisted.
+  Future<void> setDataQuota({
+    String? tunnel,
+    required DataQuotaPeriod period,
+    required int limitBytes,
+    DataQuotaAction action = DataQuotaAction.notify,
+  }) =>
+      throw UnimplementedError(
+          'setDataQuota() is not supported on this platform');
+
+  /// Removes the quotas for [tunnel], or the combined quotas when null.
+  Future<void> clearDataQuotas({String? tunnel}) => throw UnimplementedError(
+      'clearDataQuotas() is not supported on this platform');
+
+  /// Stage changes of every tunnel. [vpnStageSnapshot] only carries the
+  /// tunnel named in [initialize].
+  Stream<TunnelStage> get tunnelStageSnapshot => throw UnimplementedError(
+      'tunnelStageSnapshot is not supported on this platform');
+
+  /// Starts an additional tunnel named [tunnel], next to any already running.
+  ///
+  /// With [raceEndpoints], the first peer handshakes with its own endpoint
+  /// and every candidate at once, over all of their addresses, and the
+  /// tunnel starts on whichever answers first within [raceTimeout]; see
+  /// [endpointRaceEvents].
+  Future<void> startTunnel({
+    required String tunnel,
+    required String wgQuickConfig,
+    List<EndpointCandidate>? raceEndpoints,
+    Duration? raceTimeout,
+  }) =>
+      throw UnimplementedError(
+          'startTunnel() is not supported on this platform');
+
+  Future<void> stopTunnel(String tunnel) => throw UnimplementedError(
+      'stopTunnel() is not supported on this platform');
+
+  Future<VpnStage> tunnelStage(String tunnel) => throw UnimplementedError(
+      'tunnelStage() is not supported on this platform');
+
+  Future<WireGuardStatistics> tunnelStatistics(String tunnel) =>
+      throw UnimplementedError(
+          'tunnelStatistics() is not supported on this platform');
+
+  /// Every tunnel started so far, including stopped ones.
+  Future<List<TunnelInfo>> tunnels() =>
+      throw UnimplementedError('tunnels() is not supported on this platform');
+
+  /// Tunes how a tunnel that lost its link is restarted: the first delay is
+  /// [initialBackoff], doubling up to [maxBackoff], with jitter; after
+  /// [maxAttempts] failed restarts (0 for no limit) the tunnel gives up.
+  /// [enabled] false restores disconnecting on a lost link. Without
+  /// [tunnel] every tunnel, current and future, is configured.
+  Future<void> configureReconnect({
+    String? tunnel,
+    bool? enabled,
+    Duration? initialBackoff,
+    Duration? maxBackoff,
+    int? maxAttempts,
+  }) =>
+      throw UnimplementedError(
+          'configureReconnect() is not supported on this platform');
+
+  /// Emits when a tunnel recovered from a lost link or a network change, or
+  /// gave up.
+  Stream<RecoveryEvent> get recoveryEvents => throw UnimplementedError(
+      'recoveryEvents is not supported on this platform');
+
+  /// Emits the outcome of each endpoint race started by [startTunnel].
+  Stream<EndpointRaceEvent> get endpointRaceEvents => throw UnimplementedError(
+      'endpointRaceEvents is not supported on this platform');
+
+  /// Probes every endpoint at once, [rounds] times [interval] apart, waits
+  /// up to [timeout] after the last round and returns them best first. The
+  /// probed ports must echo UDP datagrams back.
+  Future<List<EndpointRank>> rankEndpoints(
+    List<String> endpoints, {
+    Duration? timeout,
+    int? rounds,
+    Duration? interval,
+  }) =>
+      throw UnimplementedError(
+          'rankEndpoints() is not supported on this platform');
+
+  /// Resolves the endpoint host names of [wgQuickConfig] in the
+  /// background, so a later start or reconnect with it does not wait on
+  /// DNS. Returns once the lookups are under way.
+  Future<void> prewarm({required String wgQuickConfig}) =>
+      throw UnimplementedError('prewarm() is not supported on this platform');
+
+  /// Keeps [peer] warm as a standby for [tunnel]: it handshakes with the
+  /// standby server without routing traffic to it, so a [failover] only
+  /// moves the routes in one driver update. The standby server must accept
+  /// the tunnel's key and address. A null [peer] removes the standby; it
+  /// can be set before the tunnel starts. The path watchdog fails over on
+  /// its own when the standby is warm.
+  Future<void> setStandby({String? tunnel, StandbyPeer? peer}) =>
+      throw UnimplementedError(
+          'setStandby() is not supported on this platform');
+
+  /// Moves [tunnel]'s traffic to its standby now; the former server
+  /// becomes the standby.
+  Future<FailoverEvent> failover({String? tunnel}) => throw UnimplementedError(
+      'failover() is not supported on this platform');
+
+  /// Emits every failover, by the user or by the path watchdog.
+  Stream<FailoverEvent> get failoverEvents => throw UnimplementedError(
+      'failoverEvents is not supported on this platform');
+
+  /// Emits the path MTU found to each tunnel's endpoint, searched once the
+  /// tunnel is up and after network changes, and the tunnel MTU chosen
+  /// from it.
+  Stream<PathMtuEvent> get pathMtuEvents => throw UnimplementedError(
+      'pathMtuEvents is not supported on this platform');
+
+  /// Learns the NAT binding timeout in front of [tunnel], or of every
+  /// tunnel without one, and keeps the persistent keepalive just under it,
+  /// between [minInterval] and [maxInterval]. Turning [adaptive] off
+  /// restores the config's own value.
+  Future<void> configureKeepalive({
+    String? tunnel,
+    required bool adaptive,
+    Duration? minInterval,
+    Duration? maxInterval,
+  }) =>
+      throw UnimplementedError(
+          'configureKeepalive() is not supported on this platform');
+
+  /// Emits every change of an adaptive keepalive.
+  Stream<KeepaliveEvent> get keepaliveEvents => throw UnimplementedError(
+      'keepaliveEvents is not supported on this platform');
+
+  /// Starts a speed test of [endpoint], a test server reached through the
+  /// tunnel, and returns its id. [streams] parallel TCP streams upload to
+  /// a sink or download from a source, or UDP streams send [rateBps] each
+  /// to an echo responder. Reports arrive on [speedTestEvents] every
+  /// [interval] and once more when the test ends. Under TCP, round trips
+  /// under load are probed at the UDP echo responder [latencyEndpoint].
+  Future<int> startSpeedTest({
+    required String endpoint,
+    SpeedTestProtocol protocol = SpeedTestProtocol.tcp,
+    SpeedTestDirection direction = SpeedTestDirection.upload,
+    int? streams,
+    Duration? duration,
+    Duration? warmup,
+    Duration? interval,
+    int? rateBps,
+    int? datagramSize,
+    String? latencyEndpoint,
+  }) =>
+      throw UnimplementedError(
+          'startSpeedTest() is not supported on this platform');
+
+  /// Ends the running speed test early; its final report says `cancelled`.
+  Future<void> stopSpeedTest() => throw UnimplementedError(
+      'stopSpeedTest() is not supported on this platform');
+
+  Stream<SpeedTestReport> get speedTestEvents => throw UnimplementedError(
+      'speedTestEvents is not supported on this platform');
+
+  /// Sets up the background round-trip probe of [tunnel], or of every
+  /// tunnel without one: a small timestamped datagram every [interval] to
+  /// the UDP echo responder [target] ("address:port"), by default the
+  /// config's inner gateway on port 7. Round-trip percentiles, jitter and
+  /// loss over the last [window] probes appear in the statistics and their
+  /// history; a probe unanswered after [timeout] is lost.
+  Future<void> configureLatencyProbe({
+    String? tunnel,
+    required bool enabled,
+    String? target,
+    Duration? interval,
+    Duration? timeout,
+    int? window,
+  }) =>
+      throw UnimplementedError(
+          'configureLatencyProbe() is not supported on this platform');
+
+  /// Wakeups, monitor cadence and per-method call metrics of the native
+  /// plugin.
+  Future<PluginMetrics> pluginMetrics() => throw UnimplementedError(
+      'pluginMetrics() is not supported on this platform');
+
+  /// Zeroes the per-method call metrics.
+  Future<void> resetPluginMetrics() => throw UnimplementedError(
+      'resetPluginMetrics() is not supported on this platform');
+
+  /// Starts or stops recording spans and events of method calls, service and
+  /// adapter transitions, monitor ticks and retries into a bounded buffer.
+  /// Recording is off by default.
+  Future<void> setTracing(bool enabled) => throw UnimplementedError(
+      'setTracing() is not supported on this platform');
+
+  /// Writes what has been recorded as Chrome trace-event JSON, which
+  /// Perfetto (ui.perfetto.dev) opens, and returns the file's path. Without
+  /// [path] the file goes to the plugin's data directory.
+  Future<String> dumpTrace({String? path}) => throw UnimplementedError(
+      'dumpTrace() is not supported on this platform');
+
+  /// Discards the plugin's own log records below [level]. Debug records are
+  /// only compiled into debug builds.
+  Future<void> setPluginLogLevel(PluginLogLevel level) =>
+      throw UnimplementedError(
+          'setPluginLogLevel() is not supported on this platform');
+
+  /// Phase durations of the latest connect of [tunnel] (the default tunnel
+  /// when null), with per-phase histograms across sessions.
+  Future<ConnectTimings> connectTimings({String? tunnel}) =>
+      throw UnimplementedError(
+          'connectTimings() is not supported on this platform');
+
+  /// Driver messages at or above [minLevel] from the time of listening on,
+  /// delivered in batches every [batchInterval]. Only the first listener's
+  /// arguments apply.
+  Stream<DriverLogEntry> driverLogs({
+    DriverLogLevel minLevel = DriverLogLevel.info,
+    Duration batchInterval = const Duration(milliseconds: 250),
+  }) =>
+      throw UnimplementedError('driverLogs is not supported on this platform');
+
+  /// The newest [maxEntries] driver messages at or above [minLevel], oldest
+  /// first.
+  Future<List<DriverLogEntry>> recentDriverLogs({
+    int maxEntries = 100,
+    DriverLogLevel minLevel = DriverLogLevel.info,
+  }) =>
+      throw UnimplementedError(
+          'recentDriverLogs() is not supported on this platform');
 }
 
 enum VpnStage {
@@ -25,6 +287,7 @@ enum VpnStage {
   waitingConnection('wait_connection'),
   authenticating('authenticating'),
   reconnect('reconnect'),
+  degraded('degraded'),
   noConnection('no_connection'),
   preparing('prepare'),
   denied('denied'),
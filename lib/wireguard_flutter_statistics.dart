@@ -0,0 +1,218 @@
+import 'dart:typed_data';
+
+/// Snapshot of the tunnel traffic counters.
+///
+/// On Windows the native side sends the record as a single [Int64List]:
+/// `[version, fieldCount, bytesIn, bytesOut, speedInBps, speedOutBps, ...]`.
+/// Rates are estimated natively on a monotonic clock: [speedInBps] is the
+/// rate of the last sampling interval, the smoothed, peak and percentile
+/// rates come from the sampler's sliding window.
+/// Fields are only ever appended, so unknown trailing fields are ignored and
+/// missing ones default to zero.
+class WireGuardStatistics {
+  static const _headerSize = 2;
+
+  final int version;
+  final int bytesIn;
+  final int bytesOut;
+  final int speedInBps;
+  final int speedOutBps;
+  final int smoothedInBps;
+  final int smoothedOutBps;
+  final int peakInBps;
+  final int peakOutBps;
+  final int p50InBps;
+  final int p50OutBps;
+  final int p95InBps;
+  final int p95OutBps;
+  final int packetsIn;
+  final int packetsOut;
+  final int errorsIn;
+  final int errorsOut;
+  final int discardsIn;
+  final int discardsOut;
+  final int packetsInPerSec;
+  final int packetsOutPerSec;
+  final int avgPacketSizeIn;
+  final int avgPacketSizeOut;
+
+  /// Discarded and errored packets over all packets handled in the last
+  /// interval, in parts per million.
+  final int dropRatioPpm;
+
+  /// Echoes of the background latency probe in its recent window; the
+  /// round trips below are zero while it is zero.
+  final int rttSamples;
+
+  /// Round trips of the probe through the tunnel, in microseconds.
+  final int rttMinUs;
+  final int rttP50Us;
+  final int rttP90Us;
+  final int rttP99Us;
+
+  /// Mean difference between consecutive round trips, in microseconds.
+  final int rttJitterUs;
+
+  /// Probes left unanswered in the window, in parts per million.
+  final int rttLossPpm;
+
+  /// Wall-clock time of the sample in milliseconds since the epoch; only set
+  /// on samples returned by the history.
+  final int timestampMs;
+
+  const WireGuardStatistics({
+    this.version = 0,
+    this.bytesIn = 0,
+    this.bytesOut = 0,
+    this.speedInBps = 0,
+    this.speedOutBps = 0,
+    this.smoothedInBps = 0,
+    this.smoothedOutBps = 0,
+    this.peakInBps = 0,
+    this.peakOutBps = 0,
+    this.p50InBps = 0,
+    this.p50OutBps = 0,
+    this.p95InBps = 0,
+    this.p95OutBps = 0,
+    this.packetsIn = 0,
+    this.packetsOut = 0,
+    this.errorsIn = 0,
+    this.errorsOut = 0,
+    this.discardsIn = 0,
+    this.discardsOut = 0,
+    this.packetsInPerSec = 0,
+    this.packetsOutPerSec = 0,
+    this.avgPacketSizeIn = 0,
+    this.avgPacketSizeOut = 0,
+    this.dropRatioPpm = 0,
+    this.rttSamples = 0,
+    this.rttMinUs = 0,
+    this.rttP50Us = 0,
+    this.rttP90Us = 0,
+    this.rttP99Us = 0,
+    this.rttJitterUs = 0,
+    this.rttLossPpm = 0,
+    this.timestampMs = 0,
+  });
+
+  double get dropRatio => dropRatioPpm / 1e6;
+
+  /// Median round trip through the tunnel, `null` without probe samples.
+  Duration? get rttP50 =>
+      rttSamples > 0 ? Duration(microseconds: rttP50Us) : null;
+
+  double get rttLoss => rttLossPpm / 1e6;
+
+  static const empty = WireGuardStatistics();
+
+  factory WireGuardStatistics.decode(Object? value) {
+    if (value is Int64List) return WireGuardStatistics.fromBuffer(value);
+    if (value is List) {
+      return WireGuardStatistics.fromBuffer(Int64List.fromList(value.cast()));
+    }
+    if (value is Map) {
+      // Records from natives that still send the legacy string-keyed map
+      int read(String key) => (value[key] as num?)?.toInt() ?? 0;
+      return WireGuardStatistics(
+        bytesIn: read('byte_in'),
+        bytesOut: read('byte_out'),
+        speedInBps: read('speed_in_bps'),
+        speedOutBps: read('speed_out_bps'),
+      );
+    }
+    return empty;
+  }
+
+  factory WireGuardStatistics.fromBuffer(Int64List buffer) {
+    if (buffer.length < _headerSize) return empty;
+    return WireGuardStatistics._fromFields(
+      buffer,
+      version: buffer[0],
+      offset: _headerSize,
+      count: buffer[1],
+    );
+  }
+
+  /// Decodes `getWireGuardStatisticsHistory`:
+  /// `[version, fieldsPerRecord, recordCount, (timestampMs, fields...)...]`,
+  /// oldest sample first.
+  static List<WireGuardStatistics> decodeHistory(Object? value) {
+    final buffer = value is Int64List
+        ? value
+        : value is List
+            ? Int64List.fromList(value.cast())
+            : Int64List(0);
+    if (buffer.length < 3) return const [];
+    final version = buffer[0];
+    final fields = buffer[1];
+    final stride = fields + 1;
+    final records = buffer[2];
+    return [
+      for (var offset = 3, i = 0;
+          i < records && offset + stride <= buffer.length;
+          i++, offset += stride)
+        WireGuardStatistics._fromFields(
+          buffer,
+          version: version,
+          offset: offset + 1,
+          count: fields,
+          timestampMs: buffer[offset],
+        ),
+    ];
+  }
+
+  factory WireGuardStatistics._fromFields(
+    Int64List buffer, {
+    required int version,
+    required int offset,
+    required int count,
+    int timestampMs = 0,
+  }) {
+    int field(int index) => index < count && offset + index < buffer.length
+        ? buffer[offset + index]
+        : 0;
+    return WireGuardStatistics(
+      version: version,
+      bytesIn: field(0),
+      bytesOut: field(1),
+      speedInBps: field(2),
+      speedOutBps: field(3),
+      smoothedInBps: field(4),
+      smoothedOutBps: field(5),
+      peakInBps: field(6),
+      peakOutBps: field(7),
+      p50InBps: field(8),
+      p50OutBps: field(9),
+      p95InBps: field(10),
+      p95OutBps: field(11),
+      packetsIn: field(12),
+      packetsOut: field(13),
+      errorsIn: field(14),
+      errorsOut: field(15),
+      discardsIn: field(16),
+      discardsOut: field(17),
+      packetsInPerSec: field(18),
+      packetsOutPerSec: field(19),
+      avgPacketSizeIn: field(20),
+      avgPacketSizeOut: field(21),
+      dropRatioPpm: field(22),
+      rttSamples: field(23),
+      rttMinUs: field(24),
+      rttP50Us: field(25),
+      rttP90Us: field(26),
+      rttP99Us: field(27),
+      rttJitterUs: field(28),
+      rttLossPpm: field(29),
+      timestampMs: timestampMs,
+    );
+  }
+
+  @override
+  String toString() => 'WireGuardStatistics(bytesIn: $bytesIn, '
+      'bytesOut: $bytesOut, speedInBps: $speedInBps, '
+      'speedOutBps: $speedOutBps, smoothedInBps: $smoothedInBps, '
+      'smoothedOutBps: $smoothedOutBps, packetsInPerSec: $packetsInPerSec, '
+      'packetsOutPerSec: $packetsOutPerSec, dropRatioPpm: $dropRatioPpm, '
+      'rttP50Us: $rttP50Us, rttJitterUs: $rttJitterUs, '
+      'rttLossPpm: $rttLossPpm)';
+}
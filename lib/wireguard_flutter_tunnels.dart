@@ -0,0 +1,516 @@
+import 'wireguard_flutter_platform_interface.dart';
+
+/// Stage change of one named tunnel.
+class TunnelStage {
+  final String tunnel;
+  final VpnStage stage;
+
+  const TunnelStage({required this.tunnel, required this.stage});
+}
+
+/// A tunnel the plugin knows about.
+class TunnelInfo {
+  final String tunnel;
+  final VpnStage stage;
+
+  /// Index to pass to `WireGuardCounterReader.open`, or -1 when the tunnel
+  /// has no counter block of its own.
+  final int statsBlock;
+
+  const TunnelInfo({
+    required this.tunnel,
+    required this.stage,
+    required this.statsBlock,
+  });
+}
+
+/// Why a tunnel had to recover.
+enum RecoveryReason {
+  linkLost('link_lost'),
+  serviceExited('service_exited'),
+  networkChange('network_change'),
+
+  /// The adapter stayed up but the peer stopped answering.
+  pathDead('path_dead');
+
+  final String code;
+
+  const RecoveryReason(this.code);
+}
+
+/// A lost tunnel that came back, or gave up after its last attempt, and a
+/// network change whose re-applied endpoints saw a fresh handshake.
+class RecoveryEvent {
+  final String tunnel;
+  final RecoveryReason reason;
+
+  /// From the loss or network change until the adapter was up again, or
+  /// until the first handshake on the new path.
+  final Duration duration;
+
+  /// Service restarts it took; 0 for a roam.
+  final int attempts;
+
+  /// False when the tunnel gave up and is now disconnected.
+  final bool recovered;
+
+  const RecoveryEvent({
+    required this.tunnel,
+    required this.reason,
+    required this.duration,
+    required this.attempts,
+    required this.recovered,
+  });
+
+  factory RecoveryEvent.fromMap(Map<Object?, Object?> map) => RecoveryEvent(
+        tunnel: map['tunnel'] as String? ?? '',
+        reason: RecoveryReason.values.firstWhere(
+          (reason) => reason.code == map['reason'],
+          orElse: () => RecoveryReason.linkLost,
+        ),
+        duration: Duration(milliseconds: map['durationMs'] as int? ?? 0),
+        attempts: map['attempts'] as int? ?? 0,
+        recovered: map['recovered'] as bool? ?? false,
+      );
+}
+
+/// Another endpoint the first peer of a config can be reached at.
+class EndpointCandidate {
+  /// `host:port` or `[v6 address]:port`; a name races all its addresses.
+  final String endpoint;
+
+  /// Base64 public key when this is a different server; the config's
+  /// preshared key, if any, is used with it.
+  final String? publicKey;
+
+  const EndpointCandidate(this.endpoint, {this.publicKey});
+
+  Map<String, Object?> toMap() => {
+        'endpoint': endpoint,
+        if (publicKey != null) 'publicKey': publicKey,
+      };
+}
+
+/// How one raced address ended.
+enum EndpointRaceResult {
+  pending('pending'),
+  won('won'),
+
+  /// Still handshaking when another address won.
+  cancelled('cancelled'),
+
+  /// Could not be tried, e.g. the name did not resolve.
+  failed('failed'),
+  timedOut('timed_out');
+
+  final String code;
+
+  const EndpointRaceResult(this.code);
+}
+
+/// One address raced by [EndpointRaceEvent].
+class EndpointRaceEntry {
+  /// As given, e.g. `vpn.example.com:51820`.
+  final String endpoint;
+
+  /// The address raced; empty when the endpoint did not resolve.
+  final String address;
+  final EndpointRaceResult result;
+
+  /// From the start of the race until [result] was known.
+  final Duration elapsed;
+
+  const EndpointRaceEntry({
+    required this.endpoint,
+    required this.address,
+    required this.result,
+    required this.elapsed,
+  });
+
+  factory EndpointRaceEntry.fromMap(Map<Object?, Object?> map) =>
+      EndpointRaceEntry(
+        endpoint: map['endpoint'] as String? ?? '',
+        address: map['address'] as String? ?? '',
+        result: EndpointRaceResult.values.firstWhere(
+          (result) => result.code == map['result'],
+          orElse: () => EndpointRaceResult.failed,
+        ),
+        elapsed: Duration(milliseconds: map['elapsedMs'] as int? ?? 0),
+      );
+}
+
+/// The endpoints a tunnel raced before starting, the config's own first.
+class EndpointRaceEvent {
+  final String tunnel;
+
+  /// Index into [entries] of the address the tunnel started on, or -1 when
+  /// none answered and the config was used as written.
+  final int winner;
+
+  /// Until the winner answered, or until the race gave up.
+  final Duration duration;
+  final List<EndpointRaceEntry> entries;
+
+  const EndpointRaceEvent({
+    required this.tunnel,
+    required this.winner,
+    required this.duration,
+    required this.entries,
+  });
+
+  factory EndpointRaceEvent.fromMap(Map<Object?, Object?> map) =>
+      EndpointRaceEvent(
+        tunnel: map['tunnel'] as String? ?? '',
+        winner: map['winner'] as int? ?? -1,
+        duration: Duration(milliseconds: map['durationMs'] as int? ?? 0),
+        entries: [
+          for (final entry in map['candidates'] is List
+              ? map['candidates'] as List
+              : const [])
+            if (entry is Map) EndpointRaceEntry.fromMap(entry),
+        ],
+      );
+}
+
+/// Round trips to one endpoint measured by `rankEndpoints`.
+class EndpointRank {
+  final String endpoint;
+
+  /// The address probed; empty when the endpoint did not resolve.
+  final String address;
+  final int sent;
+  final int received;
+
+  /// Mean and fastest round trip in milliseconds; -1 without replies.
+  final double rttMs;
+  final double minRttMs;
+
+  /// Mean difference between consecutive round trips; -1 without replies.
+  final double jitterMs;
+
+  /// Share of probes without a reply, 0 to 1.
+  final double loss;
+
+  const EndpointRank({
+    required this.endpoint,
+    required this.address,
+    required this.sent,
+    required this.received,
+    required this.rttMs,
+    required this.minRttMs,
+    required this.jitterMs,
+    required this.loss,
+  });
+
+  bool get reachable => received > 0;
+
+  factory EndpointRank.fromMap(Map<Object?, Object?> map) => EndpointRank(
+        endpoint: map['endpoint'] as String? ?? '',
+        address: map['address'] as String? ?? '',
+        sent: map['sent'] as int? ?? 0,
+        received: map['received'] as int? ?? 0,
+        rttMs: (map['rttMs'] as num?)?.toDouble() ?? -1,
+        minRttMs: (map['minRttMs'] as num?)?.toDouble() ?? -1,
+        jitterMs: (map['jitterMs'] as num?)?.toDouble() ?? -1,
+        loss: (map['loss'] as num?)?.toDouble() ?? 1,
+      );
+}
+
+/// A second server kept warm next to a tunnel's peer; see
+/// [WireGuardFlutterInterface.setStandby].
+class StandbyPeer {
+  /// Base64 public key of the standby server.
+  final String publicKey;
+
+  /// `address:port` or `[v6 address]:port`; a host name is resolved once
+  /// when the standby is set.
+  final String endpoint;
+
+  /// Base64 preshared key, if the standby server uses one.
+  final String? presharedKey;
+
+  const StandbyPeer({
+    required this.publicKey,
+    required this.endpoint,
+    this.presharedKey,
+  });
+
+  Map<String, Object?> toMap() => {
+        'publicKey': publicKey,
+        'endpoint': endpoint,
+        if (presharedKey != null) 'presharedKey': presharedKey,
+      };
+}
+
+/// Why a tunnel switched to its standby.
+enum FailoverReason {
+  user('user'),
+
+  /// The path watchdog found the active server unreachable.
+  watchdog('watchdog');
+
+  final String code;
+
+  const FailoverReason(this.code);
+}
+
+/// The outcome of a switch to the standby peer.
+class FailoverEvent {
+  /// Empty in the reply to [WireGuardFlutterInterface.failover].
+  final String tunnel;
+  final FailoverReason reason;
+  final bool switched;
+
+  /// Public keys of the peers the traffic moved from and to.
+  final String from;
+  final String to;
+
+  /// Age of the standby's latest handshake at the switch; -1 without one.
+  final int standbyHandshakeAgeMs;
+
+  /// How long the driver update took.
+  final Duration duration;
+
+  /// Why nothing switched, e.g. `not armed`; empty on success.
+  final String error;
+
+  const FailoverEvent({
+    required this.tunnel,
+    required this.reason,
+    required this.switched,
+    required this.from,
+    required this.to,
+    required this.standbyHandshakeAgeMs,
+    required this.duration,
+    required this.error,
+  });
+
+  factory FailoverEvent.fromMap(Map<Object?, Object?> map) => FailoverEvent(
+        tunnel: map['tunnel'] as String? ?? '',
+        reason: FailoverReason.values.firstWhere(
+          (reason) => reason.code == map['reason'],
+          orElse: () => FailoverReason.user,
+        ),
+        switched: map['switched'] as bool? ?? false,
+        from: map['from'] as String? ?? '',
+        to: map['to'] as String? ?? '',
+        standbyHandshakeAgeMs: map['standbyHandshakeAgeMs'] as int? ?? -1,
+        duration: Duration(microseconds: map['durationUs'] as int? ?? 0),
+        error: map['error'] as String? ?? '',
+      );
+}
+
+/// The outcome of a path MTU search to a tunnel's endpoint.
+class PathMtuEvent {
+  final String tunnel;
+
+  /// The endpoint address probed.
+  final String address;
+
+  /// MTU of the interface the probes left on; the largest size tried.
+  final int interfaceMtu;
+
+  /// Largest packet that reached the endpoint unfragmented; 0 when
+  /// nothing was answered.
+  final int pathMtu;
+
+  /// The WireGuard MTU that fits in [pathMtu]; 0 without one.
+  final int tunnelMtu;
+
+  /// Echoes sent, retries included.
+  final int probes;
+  final Duration duration;
+
+  /// False when the config sets its own MTU, or on [error].
+  final bool applied;
+
+  /// `no route`, `no replies` or `interrupted` when the search failed;
+  /// empty otherwise.
+  final String error;
+
+  const PathMtuEvent({
+    required this.tunnel,
+    required this.address,
+    required this.interfaceMtu,
+    required this.pathMtu,
+    required this.tunnelMtu,
+    required this.probes,
+    required this.duration,
+    required this.applied,
+    required this.error,
+  });
+
+  factory PathMtuEvent.fromMap(Map<Object?, Object?> map) => PathMtuEvent(
+        tunnel: map['tunnel'] as String? ?? '',
+        address: map['address'] as String? ?? '',
+        interfaceMtu: map['interfaceMtu'] as int? ?? 0,
+        pathMtu: map['pathMtu'] as int? ?? 0,
+        tunnelMtu: map['tunnelMtu'] as int? ?? 0,
+        probes: map['probes'] as int? ?? 0,
+        duration: Duration(milliseconds: map['durationMs'] as int? ?? 0),
+        applied: map['applied'] as bool? ?? false,
+        error: map['error'] as String? ?? '',
+      );
+}
+
+/// Why the adaptive keepalive changed.
+enum KeepaliveReason {
+  /// Idle stretches survived at the current interval; trying a longer one.
+  explore('explore'),
+
+  /// Settled just under the learned NAT timeout.
+  learned('learned'),
+
+  /// The NAT dropped the binding; falling back to a shorter interval.
+  loss('loss'),
+
+  /// Back to the starting interval after a network change.
+  reset('reset');
+
+  final String code;
+
+  const KeepaliveReason(this.code);
+}
+
+/// A change of a tunnel's persistent keepalive in adaptive mode.
+class KeepaliveEvent {
+  final String tunnel;
+  final Duration keepalive;
+  final KeepaliveReason reason;
+
+  /// Longest idle stretch the NAT binding survived so far, and shortest
+  /// it did not; zero while unknown.
+  final Duration survived;
+  final Duration lost;
+
+  /// False when the adapter was not up; the value is applied once it is.
+  final bool applied;
+
+  const KeepaliveEvent({
+    required this.tunnel,
+    required this.keepalive,
+    required this.reason,
+    required this.survived,
+    required this.lost,
+    required this.applied,
+  });
+
+  factory KeepaliveEvent.fromMap(Map<Object?, Object?> map) => KeepaliveEvent(
+        tunnel: map['tunnel'] as String? ?? '',
+        keepalive: Duration(seconds: map['keepaliveS'] as int? ?? 0),
+        reason: KeepaliveReason.values.firstWhere(
+          (reason) => reason.code == map['reason'],
+          orElse: () => KeepaliveReason.explore,
+        ),
+        survived: Duration(milliseconds: map['survivedMs'] as int? ?? 0),
+        lost: Duration(milliseconds: map['lostMs'] as int? ?? 0),
+        applied: map['applied'] as bool? ?? false,
+      );
+}
+
+enum SpeedTestProtocol {
+  /// Parallel TCP streams to a sink, or from a source.
+  tcp('tcp'),
+
+  /// Paced datagrams to a UDP echo responder.
+  udp('udp');
+
+  final String code;
+
+  const SpeedTestProtocol(this.code);
+}
+
+enum SpeedTestDirection {
+  upload('upload'),
+  download('download');
+
+  final String code;
+
+  const SpeedTestDirection(this.code);
+}
+
+/// Progress or outcome of a speed test; see
+/// [WireGuardFlutterInterface.startSpeedTest].
+class SpeedTestReport {
+  /// The id startSpeedTest returned.
+  final int test;
+
+  /// The final report of the test.
+  final bool done;
+  final Duration elapsed;
+
+  /// Moved since the warmup, over all streams.
+  final int bytes;
+
+  /// Bits per second since the warmup; 0 during it.
+  final double goodputBps;
+
+  /// Bits per second during the latest interval, warmup included.
+  final double intervalBps;
+  final List<double> streamBps;
+
+  /// Jain's index over the streams that connected: 1 for an even split,
+  /// 1/n when one stream takes everything.
+  final double fairness;
+  final int connected;
+  final int failed;
+
+  final int rttSamples;
+
+  /// Round trips under load; -1 microseconds without samples.
+  final Duration rttMin;
+  final Duration rttP50;
+  final Duration rttP90;
+  final Duration rttP99;
+
+  /// Share of datagrams or probes not echoed, 0 to 1; -1 until the end
+  /// or without any.
+  final double loss;
+
+  /// Why the test stopped early, e.g. `cancelled`; empty otherwise.
+  final String error;
+
+  const SpeedTestReport({
+    required this.test,
+    required this.done,
+    required this.elapsed,
+    required this.bytes,
+    required this.goodputBps,
+    required this.intervalBps,
+    required this.streamBps,
+    required this.fairness,
+    required this.connected,
+    required this.failed,
+    required this.rttSamples,
+    required this.rttMin,
+    required this.rttP50,
+    required this.rttP90,
+    required this.rttP99,
+    required this.loss,
+    required this.error,
+  });
+
+  factory SpeedTestReport.fromMap(Map<Object?, Object?> map) =>
+      SpeedTestReport(
+        test: map['test'] as int? ?? 0,
+        done: map['done'] as bool? ?? false,
+        elapsed: Duration(milliseconds: map['elapsedMs'] as int? ?? 0),
+        bytes: map['bytes'] as int? ?? 0,
+        goodputBps: (map['goodputBps'] as num?)?.toDouble() ?? 0,
+        intervalBps: (map['intervalBps'] as num?)?.toDouble() ?? 0,
+        streamBps: [
+          for (final bps in map['streamBps'] as List? ?? const [])
+            if (bps is num) bps.toDouble(),
+        ],
+        fairness: (map['fairness'] as num?)?.toDouble() ?? 0,
+        connected: map['connected'] as int? ?? 0,
+        failed: map['failed'] as int? ?? 0,
+        rttSamples: map['rttSamples'] as int? ?? 0,
+        rttMin: Duration(microseconds: map['rttMinUs'] as int? ?? -1),
+        rttP50: Duration(microseconds: map['rttP50Us'] as int? ?? -1),
+        rttP90: Duration(microseconds: map['rttP90Us'] as int? ?? -1),
+        rttP99: Duration(microseconds: map['rttP99Us'] as int? ?? -1),
+        loss: (map['loss'] as num?)?.toDouble() ?? -1,
+        error: map['error'] as String? ?? '',
+      );
+}
@@ -0,0 +1,86 @@
+/// Period a data quota is measured over. Days and months are UTC.
+enum DataQuotaPeriod {
+  day('day'),
+  month('month'),
+  total('total');
+
+  final String code;
+
+  const DataQuotaPeriod(this.code);
+}
+
+/// What happens when a data quota is exceeded. Both actions emit a
+/// [DataQuotaEvent]; [disconnect] also stops the tunnel.
+enum DataQuotaAction {
+  notify('notify'),
+  disconnect('disconnect');
+
+  final String code;
+
+  const DataQuotaAction(this.code);
+}
+
+/// Traffic recorded for one tunnel on one UTC day.
+class DataUsage {
+  final String tunnel;
+  final DateTime day;
+  final int bytesIn;
+  final int bytesOut;
+
+  const DataUsage({
+    required this.tunnel,
+    required this.day,
+    required this.bytesIn,
+    required this.bytesOut,
+  });
+
+  int get totalBytes => bytesIn + bytesOut;
+
+  factory DataUsage.fromMap(Map<Object?, Object?> map) => DataUsage(
+        tunnel: map['tunnel'] as String? ?? '',
+        day: DateTime.fromMillisecondsSinceEpoch(
+          (map['day'] as int? ?? 0) * Duration.millisecondsPerDay,
+          isUtc: true,
+        ),
+        bytesIn: map['bytesIn'] as int? ?? 0,
+        bytesOut: map['bytesOut'] as int? ?? 0,
+      );
+
+  static List<DataUsage> decodeList(Object? value) => value is List
+      ? [
+          for (final entry in value)
+            if (entry is Map) DataUsage.fromMap(entry),
+        ]
+      : const [];
+}
+
+/// Sent once per period when a quota is exceeded.
+class DataQuotaEvent {
+  /// Tunnel the quota applies to, empty for the combined quota.
+  final String tunnel;
+  final DataQuotaPeriod period;
+  final int usedBytes;
+  final int limitBytes;
+
+  /// Whether the tunnel was stopped because of the quota.
+  final bool disconnected;
+
+  const DataQuotaEvent({
+    required this.tunnel,
+    required this.period,
+    required this.usedBytes,
+    required this.limitBytes,
+    required this.disconnected,
+  });
+
+  factory DataQuotaEvent.fromMap(Map<Object?, Object?> map) => DataQuotaEvent(
+        tunnel: map['tunnel'] as String? ?? '',
+        period: DataQuotaPeriod.values.firstWhere(
+          (period) => period.code == map['period'],
+          orElse: () => DataQuotaPeriod.total,
+        ),
+        usedBytes: map['usedBytes'] as int? ?? 0,
+        limitBytes: map['limitBytes'] as int? ?? 0,
+        disconnected: map['disconnect'] as bool? ?? false,
+      );
+}
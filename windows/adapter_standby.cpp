@@ -0,0 +1,90 @@
+#include "adapter_standby.h"
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "logger.h"
+#include "wg_quick_config.h"
+
+namespace wireguard_flutter {
+
+namespace {
+
+bool parseEndpoint(const std::string& endpoint, SOCKADDR_INET& address) {
+    std::string host;
+    std::string port;
+    if (!WgQuickConfig::splitEndpoint(endpoint, host, port)) {
+        return false;
+    }
+
+    ADDRINFOA hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = AI_NUMERICHOST | AI_NUMERICSERV;
+    ADDRINFOA* results = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &results) != 0 || results == nullptr) {
+        return false;
+    }
+    bool parsed = true;
+    address = SOCKADDR_INET{};
+    if (results->ai_family == AF_INET) {
+        std::memcpy(&address.Ipv4, results->ai_addr, sizeof(address.Ipv4));
+    } else if (results->ai_family == AF_INET6) {
+        std::memcpy(&address.Ipv6, results->ai_addr, sizeof(address.Ipv6));
+    } else {
+        parsed = false;
+    }
+    freeaddrinfo(results);
+    return parsed;
+}
+
+} // namespace
+
+bool AdapterStandby::keepWarm(const StandbyFailover::Peer& peer, std::chrono::seconds keepalive) {
+    BYTE publicKey[WIREGUARD_KEY_LENGTH];
+    BYTE presharedKey[WIREGUARD_KEY_LENGTH];
+    SOCKADDR_INET endpoint{};
+    if (!WireGuardAdapter::decodeKey(peer.publicKey, publicKey)) {
+        WG_LOG_WARN("AdapterStandby: Invalid public key");
+        return false;
+    }
+    bool hasPresharedKey = !peer.presharedKey.empty();
+    if (hasPresharedKey && !WireGuardAdapter::decodeKey(peer.presharedKey, presharedKey)) {
+        WG_LOG_WARN("AdapterStandby: Invalid preshared key");
+        return false;
+    }
+    bool hasEndpoint = !peer.endpoint.empty();
+    if (hasEndpoint && !parseEndpoint(peer.endpoint, endpoint)) {
+        WG_LOG_WARN("AdapterStandby: {} is not an address and port", peer.endpoint);
+        return false;
+    }
+    auto seconds = static_cast<WORD>(std::clamp<int64_t>(keepalive.count(), 1, 65535));
+    return adapter_.setIdlePeer(publicKey, hasPresharedKey ? presharedKey : nullptr,
+                                hasEndpoint ? &endpoint : nullptr, seconds);
+}
+
+bool AdapterStandby::moveAllowedIps(const std::string& from, const std::string& to) {
+    BYTE fromKey[WIREGUARD_KEY_LENGTH];
+    BYTE toKey[WIREGUARD_KEY_LENGTH];
+    return WireGuardAdapter::decodeKey(from, fromKey) && WireGuardAdapter::decodeKey(to, toKey) &&
+           adapter_.moveAllowedIps(fromKey, toKey);
+}
+
+bool AdapterStandby::removePeer(const std::string& publicKey) {
+    BYTE key[WIREGUARD_KEY_LENGTH];
+    return WireGuardAdapter::decodeKey(publicKey, key) && adapter_.removePeer(key);
+}
+
+int64_t AdapterStandby::handshakeAgeMs(const std::string& publicKey) {
+    BYTE key[WIREGUARD_KEY_LENGTH];
+    uint64_t lastHandshake = 0;
+    if (!WireGuardAdapter::decodeKey(publicKey, key) || !adapter_.queryPeerHandshake(key, lastHandshake)) {
+        return -1;
+    }
+    return WireGuardAdapter::handshakeAgeMs(lastHandshake);
+}
+
+} // namespace wireguard_flutter
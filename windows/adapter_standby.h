@@ -0,0 +1,25 @@
+#pragma once
+
+#include "standby_failover.h"
+#include "wireguard_adapter.h"
+
+namespace wireguard_flutter {
+
+// StandbyFailover's backend on Windows: peers of the adapter the tunnel
+// service created, changed through the driver while the service runs.
+// Endpoints have to be address literals. Used on the thread that owns the
+// adapter.
+class AdapterStandby : public StandbyFailover::Backend {
+public:
+    explicit AdapterStandby(WireGuardAdapter& adapter) : adapter_(adapter) {}
+
+    bool keepWarm(const StandbyFailover::Peer& peer, std::chrono::seconds keepalive) override;
+    bool moveAllowedIps(const std::string& from, const std::string& to) override;
+    bool removePeer(const std::string& publicKey) override;
+    int64_t handshakeAgeMs(const std::string& publicKey) override;
+
+private:
+    WireGuardAdapter& adapter_;
+};
+
+} // namespace wireguard_flutter
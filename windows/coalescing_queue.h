@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace wireguard_flutter {
+
+// Multi-producer, single-consumer event queue that collapses runs of state
+// changes. Every accepted event gets the next sequence number; when a state
+// change lands directly behind another one for the same key (e.g. the same
+// tunnel) it replaces it, so a consumer that falls behind only sees the
+// latest state of each run (and a gap in the sequence). State changes carry
+// the version of the state they describe, and one that is older than the
+// state it would replace is dropped, so producers racing on different
+// threads cannot reorder them. Other events are delivered in order, up to
+// |capacity| pending. Portable; no Windows dependencies.
+template <typename T, typename Key = uint64_t>
+class CoalescingQueue {
+public:
+    struct Entry {
+        uint64_t sequence;
+        bool isState;
+        Key key;
+        uint64_t version;
+        T value;
+    };
+
+    static constexpr size_t kDefaultCapacity = 256;
+
+    explicit CoalescingQueue(size_t capacity = kDefaultCapacity) : capacity_(capacity) {}
+
+    // Queues a state change. Returns true when the queue was empty, i.e. the
+    // consumer has to be woken up.
+    bool pushState(const Key& key, T value, uint64_t version = 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        bool wasEmpty = entries_.empty();
+        if (!wasEmpty && entries_.back().isState && entries_.back().key == key) {
+            auto& last = entries_.back();
+            if (version >= last.version) {
+                last.sequence = nextSequence_++;
+                last.version = version;
+                last.value = std::move(value);
+            }
+            coalesced_++;
+            return false;
+        }
+        // State changes are never dropped for backlog
+        entries_.push_back(Entry{nextSequence_++, true, key, version, std::move(value)});
+        return wasEmpty;
+    }
+
+    // Queues any other event. Dropped when |capacity| events are pending.
+    bool pushEvent(T value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        bool wasEmpty = entries_.empty();
+        if (entries_.size() >= capacity_) {
+            dropped_++;
+            return false;
+        }
+        entries_.push_back(Entry{nextSequence_++, false, Key{}, 0, std::move(value)});
+        return wasEmpty;
+    }
+
+    // Moves every pending entry into |out|, oldest first. |out| is cleared;
+    // passing the same vector each time reuses its storage.
+    void drain(std::vector<Entry>& out) {
+        out.clear();
+        std::lock_guard<std::mutex> lock(mutex_);
+        out.swap(entries_);
+    }
+
+    bool empty() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return entries_.empty();
+    }
+
+    // Number of state changes replaced before delivery
+    uint64_t coalesced() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return coalesced_;
+    }
+
+    // Number of events discarded because the queue was full
+    uint64_t dropped() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return dropped_;
+    }
+
+private:
+    size_t capacity_;
+
+    mutable std::mutex mutex_;
+    std::vector<Entry> entries_;
+    uint64_t nextSequence_ = 1;
+    uint64_t coalesced_ = 0;
+    uint64_t dropped_ = 0;
+};
+
+} // namespace wireguard_flutter
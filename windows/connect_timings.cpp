@@ -0,0 +1,193 @@
+#include "connect_timings.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <system_error>
+#include <vector>
+
+#include "crc32.h"
+#include "logger.h"
+
+namespace wireguard_flutter {
+
+namespace {
+
+constexpr char kTimingsMagic[8] = {'W', 'G', 'F', 'C', 'O', 'N', 'N', '1'};
+constexpr uint32_t kTimingsVersion = 1;
+
+struct TimingsHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t phases;
+    uint32_t buckets;
+    // CRC-32 of everything after the header
+    uint32_t checksum;
+};
+
+struct PhaseRecord {
+    int64_t sumMs;
+    int64_t maxMs;
+    LatencyHistogram::Buckets buckets;
+};
+
+static_assert(sizeof(TimingsHeader) == 24, "timings header must stay 24 bytes");
+
+int64_t wallClockMillis() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+} // namespace
+
+const char* connectPhaseName(ConnectPhase phase) {
+    switch (phase) {
+    case ConnectPhase::ConfigWrite:
+        return "configWrite";
+    case ConnectPhase::ServiceInstall:
+        return "serviceInstall";
+    case ConnectPhase::ServiceStart:
+        return "serviceStart";
+    case ConnectPhase::AdapterUp:
+        return "adapterUp";
+    case ConnectPhase::FirstHandshake:
+        return "firstHandshake";
+    }
+    return "unknown";
+}
+
+void ConnectTimer::start() {
+    breakdown_ = ConnectBreakdown();
+    breakdown_.startedAtMs = wallClockMillis();
+    mark_ = Clock::now();
+    running_ = true;
+}
+
+void ConnectTimer::finishPhase(ConnectPhase phase, Clock::time_point at) {
+    if (!running_) {
+        return;
+    }
+    // A phase seen late, e.g. a handshake found on the next tick, may end
+    // before the previous phase was noticed
+    at = std::max(at, mark_);
+    breakdown_.phaseMs[static_cast<size_t>(phase)] =
+        std::chrono::duration_cast<std::chrono::milliseconds>(at - mark_).count();
+    mark_ = at;
+}
+
+void ConnectTimer::finish() {
+    if (running_) {
+        breakdown_.finished = true;
+        running_ = false;
+    }
+}
+
+bool ConnectTimer::reached(ConnectPhase phase) const {
+    return breakdown_.phaseMs[static_cast<size_t>(phase)] >= 0;
+}
+
+ConnectTimingStore::ConnectTimingStore(std::filesystem::path path) : path_(std::move(path)) {}
+
+bool ConnectTimingStore::load() {
+    std::ifstream file(path_, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    TimingsHeader header{};
+    std::vector<PhaseRecord> records(kConnectPhaseCount);
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    file.read(reinterpret_cast<char*>(records.data()),
+              static_cast<std::streamsize>(records.size() * sizeof(PhaseRecord)));
+
+    bool valid = file && std::memcmp(header.magic, kTimingsMagic, sizeof(kTimingsMagic)) == 0 &&
+                 header.version == kTimingsVersion && header.phases == kConnectPhaseCount &&
+                 header.buckets == LatencyHistogram::kBucketCount &&
+                 header.checksum == crc32(reinterpret_cast<const uint8_t*>(records.data()),
+                                          records.size() * sizeof(PhaseRecord));
+    if (!valid) {
+        WG_LOG_WARN("ConnectTimingStore: Ignoring unreadable {}", path_.string());
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < kConnectPhaseCount; i++) {
+        histograms_[i].restore(records[i].buckets, records[i].sumMs, records[i].maxMs);
+    }
+    return true;
+}
+
+bool ConnectTimingStore::save() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return saveLocked();
+}
+
+bool ConnectTimingStore::saveLocked() {
+    std::vector<PhaseRecord> records(kConnectPhaseCount);
+    for (size_t i = 0; i < kConnectPhaseCount; i++) {
+        records[i].sumMs = histograms_[i].sum();
+        records[i].maxMs = histograms_[i].max();
+        records[i].buckets = histograms_[i].buckets();
+    }
+
+    TimingsHeader header{};
+    std::memcpy(header.magic, kTimingsMagic, sizeof(kTimingsMagic));
+    header.version = kTimingsVersion;
+    header.phases = kConnectPhaseCount;
+    header.buckets = LatencyHistogram::kBucketCount;
+    header.checksum = crc32(reinterpret_cast<const uint8_t*>(records.data()), records.size() * sizeof(PhaseRecord));
+
+    std::filesystem::path temporary = path_;
+    temporary += ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(records.data()),
+                   static_cast<std::streamsize>(records.size() * sizeof(PhaseRecord)));
+        if (!file.flush()) {
+            WG_LOG_ERROR("ConnectTimingStore: Failed to write {}", temporary.string());
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary, path_, error);
+    if (error) {
+        WG_LOG_ERROR("ConnectTimingStore: Failed to replace timings: {}", error.message());
+        return false;
+    }
+    return true;
+}
+
+void ConnectTimingStore::update(const std::string& tunnel, const ConnectBreakdown& breakdown) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    latest_[tunnel] = breakdown;
+    if (!breakdown.finished) {
+        return;
+    }
+
+    for (size_t i = 0; i < kConnectPhaseCount; i++) {
+        if (breakdown.phaseMs[i] >= 0) {
+            histograms_[i].record(breakdown.phaseMs[i]);
+        }
+    }
+    saveLocked();
+}
+
+bool ConnectTimingStore::latest(const std::string& tunnel, ConnectBreakdown& out) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto entry = latest_.find(tunnel);
+    if (entry == latest_.end()) {
+        return false;
+    }
+    out = entry->second;
+    return true;
+}
+
+std::array<LatencyHistogram, kConnectPhaseCount> ConnectTimingStore::histograms() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return histograms_;
+}
+
+} // namespace wireguard_flutter
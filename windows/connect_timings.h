@@ -0,0 +1,98 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "latency_histogram.h"
+
+namespace wireguard_flutter {
+
+// Phases of a connect, in order; each starts when the previous one ends
+enum class ConnectPhase {
+    ConfigWrite = 0,
+    ServiceInstall,
+    ServiceStart,
+    AdapterUp,
+    FirstHandshake,
+};
+
+constexpr size_t kConnectPhaseCount = 5;
+
+// "configWrite", "serviceInstall", ... as used on the method channel
+const char* connectPhaseName(ConnectPhase phase);
+
+// Phase durations of one connect attempt
+struct ConnectBreakdown {
+    // -1 for phases not reached (yet)
+    std::array<int64_t, kConnectPhaseCount> phaseMs;
+    // Wall-clock start, for display only
+    int64_t startedAtMs = 0;
+    // False while phases are still running
+    bool finished = false;
+
+    ConnectBreakdown() { phaseMs.fill(-1); }
+};
+
+// Times the phases of one connect attempt on the monotonic clock.
+// Not thread-safe.
+class ConnectTimer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    void start();
+    // Ends |phase| at |at|; it began when the previous phase ended
+    void finishPhase(ConnectPhase phase, Clock::time_point at = Clock::now());
+    // Marks the attempt as over; later phases stay unreached
+    void finish();
+
+    bool isRunning() const { return running_; }
+    bool reached(ConnectPhase phase) const;
+    // Start of the phase that is running now
+    Clock::time_point mark() const { return mark_; }
+    const ConnectBreakdown& breakdown() const { return breakdown_; }
+
+private:
+    ConnectBreakdown breakdown_;
+    Clock::time_point mark_;
+    bool running_ = false;
+};
+
+// Latest breakdown per tunnel and per-phase histograms of every finished
+// attempt. The histograms are saved to a small checksummed file, written to
+// a temporary file and renamed over the old one, so they survive restarts.
+// Thread-safe.
+class ConnectTimingStore {
+public:
+    explicit ConnectTimingStore(std::filesystem::path path);
+
+    ConnectTimingStore(const ConnectTimingStore&) = delete;
+    ConnectTimingStore& operator=(const ConnectTimingStore&) = delete;
+
+    // Reads the saved histograms; a missing or damaged file starts empty
+    bool load();
+    bool save();
+
+    // Replaces the latest breakdown of |tunnel|. A finished one is also added
+    // to the histograms and saved.
+    void update(const std::string& tunnel, const ConnectBreakdown& breakdown);
+
+    bool latest(const std::string& tunnel, ConnectBreakdown& out) const;
+    std::array<LatencyHistogram, kConnectPhaseCount> histograms() const;
+
+private:
+    bool saveLocked();
+
+    std::filesystem::path path_;
+
+    mutable std::mutex mutex_;
+    std::map<std::string, ConnectBreakdown> latest_;
+    std::array<LatencyHistogram, kConnectPhaseCount> histograms_;
+};
+
+} // namespace wireguard_flutter
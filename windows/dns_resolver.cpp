@@ -0,0 +1,166 @@
+#include "dns_resolver.h"
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "logger.h"
+#include "utils.h"
+
+namespace wireguard_flutter {
+
+// Both queries of one name; the last to finish answers
+struct DnsResolver::Lookup {
+    std::mutex mutex;
+    int remaining = 2;
+    std::vector<std::string> v4;
+    std::vector<std::string> v6;
+    DWORD ttl = MAXDWORD;
+    std::function<void(ResolverCache::Answer)> done;
+
+    // |results| is null for a query that never started
+    void add(const DNS_QUERY_RESULT* results) {
+        ResolverCache::Answer answer;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (results && results->QueryStatus == ERROR_SUCCESS) {
+                collect(results->pQueryRecords);
+            }
+            if (--remaining > 0) {
+                return;
+            }
+            answer.addresses = std::move(v4);
+            answer.addresses.insert(answer.addresses.end(), v6.begin(), v6.end());
+            answer.ok = !answer.addresses.empty();
+            answer.ttl = std::chrono::seconds(answer.ok ? ttl : 0);
+        }
+        done(std::move(answer));
+    }
+
+    void collect(const DNS_RECORD* record) {
+        for (; record != nullptr; record = record->pNext) {
+            // CNAMEs on the way are skipped; their TTL does not bound the
+            // addresses' own
+            if (record->Flags.S.Section != DnsSectionAnswer) {
+                continue;
+            }
+            char text[INET6_ADDRSTRLEN] = {};
+            if (record->wType == DNS_TYPE_A) {
+                IN_ADDR address{};
+                address.S_un.S_addr = record->Data.A.IpAddress;
+                if (inet_ntop(AF_INET, &address, text, sizeof(text)) == nullptr) {
+                    continue;
+                }
+                v4.push_back(text);
+            } else if (record->wType == DNS_TYPE_AAAA) {
+                IN6_ADDR address{};
+                std::memcpy(address.u.Byte, record->Data.AAAA.Ip6Address.IP6Byte, sizeof(address.u.Byte));
+                if (inet_ntop(AF_INET6, &address, text, sizeof(text)) == nullptr) {
+                    continue;
+                }
+                v6.push_back(text);
+            } else {
+                continue;
+            }
+            ttl = std::min(ttl, record->dwTtl);
+        }
+    }
+};
+
+struct DnsResolver::Query {
+    DnsResolver* owner = nullptr;
+    std::shared_ptr<Lookup> lookup;
+    std::wstring name;
+    DNS_QUERY_RESULT result{};
+    DNS_QUERY_CANCEL cancel{};
+
+    // Hands the records to the lookup and frees them
+    void deliver() {
+        lookup->add(&result);
+        if (result.pQueryRecords != nullptr) {
+            DnsRecordListFree(result.pQueryRecords, DnsFreeRecordList);
+            result.pQueryRecords = nullptr;
+        }
+    }
+};
+
+DnsResolver::~DnsResolver() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    closing_ = true;
+    for (Query* query : queries_) {
+        DnsCancelQuery(&query->cancel);
+    }
+    idle_.wait(lock, [this] { return queries_.empty(); });
+}
+
+void DnsResolver::resolve(const std::string& host, std::function<void(ResolverCache::Answer)> done) {
+    auto lookup = std::make_shared<Lookup>();
+    lookup->done = std::move(done);
+    std::wstring name = Utf8ToWide(host);
+    startQuery(lookup, name, DNS_TYPE_A);
+    startQuery(lookup, name, DNS_TYPE_AAAA);
+}
+
+void DnsResolver::startQuery(const std::shared_ptr<Lookup>& lookup, const std::wstring& name, WORD type) {
+    auto query = std::make_unique<Query>();
+    query->owner = this;
+    query->lookup = lookup;
+    query->name = name;
+    query->result.Version = DNS_QUERY_REQUEST_VERSION1;
+
+    DNS_QUERY_REQUEST request{};
+    request.Version = DNS_QUERY_REQUEST_VERSION1;
+    request.QueryName = query->name.c_str();
+    request.QueryType = type;
+    request.QueryOptions = DNS_QUERY_STANDARD;
+    request.pQueryCompletionCallback = &DnsResolver::onQueryComplete;
+    request.pQueryContext = query.get();
+
+    DNS_STATUS status;
+    {
+        // Held across the call, so a callback on another thread finds the
+        // query registered
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closing_) {
+            lookup->add(nullptr);
+            return;
+        }
+        status = DnsQueryEx(&request, &query->result, &query->cancel);
+        if (status == DNS_REQUEST_PENDING) {
+            queries_.insert(query.release());
+            return;
+        }
+    }
+
+    // Answered from the cache or failed at once; there is no callback then
+    if (status != ERROR_SUCCESS) {
+        WG_LOG_DEBUG("DnsResolver: Query for {} failed with {}", name, status);
+    }
+    query->result.QueryStatus = status;
+    query->deliver();
+}
+
+void DnsResolver::finishQuery(Query* query) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queries_.erase(query);
+        delete query;
+    }
+    idle_.notify_all();
+}
+
+VOID WINAPI DnsResolver::onQueryComplete(PVOID context, PDNS_QUERY_RESULT results) {
+    auto* query = static_cast<Query*>(context);
+    if (results->QueryStatus != ERROR_SUCCESS && results->QueryStatus != ERROR_CANCELLED) {
+        WG_LOG_DEBUG("DnsResolver: Query for {} failed with {}", query->name, results->QueryStatus);
+    }
+    // |results| is the query's own result
+    query->deliver();
+    query->owner->finishQuery(query);
+}
+
+} // namespace wireguard_flutter
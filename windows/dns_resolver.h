@@ -0,0 +1,48 @@
+#pragma once
+
+#include <windows.h>
+#include <windns.h>
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+
+#include "resolver_cache.h"
+
+namespace wireguard_flutter {
+
+// The ResolverCache's resolver on Windows: asynchronous DnsQueryEx queries
+// for the A and AAAA records of a name, answered on a system thread with
+// the IPv4 addresses first and the smallest record TTL. Names are resolved
+// in parallel, without a thread each.
+//
+// Destroying the resolver cancels the queries in flight and waits for
+// their callbacks, which still answer (as failed).
+class DnsResolver {
+public:
+    DnsResolver() = default;
+    ~DnsResolver();
+
+    DnsResolver(const DnsResolver&) = delete;
+    DnsResolver& operator=(const DnsResolver&) = delete;
+
+    void resolve(const std::string& host, std::function<void(ResolverCache::Answer)> done);
+
+private:
+    struct Lookup;
+    struct Query;
+
+    void startQuery(const std::shared_ptr<Lookup>& lookup, const std::wstring& name, WORD type);
+    void finishQuery(Query* query);
+    static VOID WINAPI onQueryComplete(PVOID context, PDNS_QUERY_RESULT results);
+
+    std::mutex mutex_;
+    std::condition_variable idle_;
+    std::set<Query*> queries_;
+    bool closing_ = false;
+};
+
+} // namespace wireguard_flutter
@@ -0,0 +1,158 @@
+#include "driver_log.h"
+
+// Resolved through wireguard.lib, like the adapter functions
+extern "C" {
+WIREGUARD_SET_LOGGER_FUNC WireGuardSetLogger;
+}
+
+namespace wireguard_flutter {
+
+namespace {
+
+// 100 ns intervals between 1601-01-01 and 1970-01-01
+constexpr uint64_t kUnixEpochFileTime = 116444736000000000ULL;
+
+LogLevel toLogLevel(WIREGUARD_LOGGER_LEVEL level) {
+    switch (level) {
+    case WIREGUARD_LOG_WARN:
+        return LogLevel::Warn;
+    case WIREGUARD_LOG_ERR:
+        return LogLevel::Error;
+    default:
+        return LogLevel::Info;
+    }
+}
+
+} // namespace
+
+DriverLog& DriverLog::instance() {
+    // Never destroyed; the logger may still be called while the process exits
+    static DriverLog* log = new DriverLog();
+    return *log;
+}
+
+void DriverLog::attach(EventLoop& loop, EventDispatcher& dispatcher) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    loop_ = &loop;
+    dispatcher_ = &dispatcher;
+    if (!installed_) {
+        WireGuardSetLogger(&DriverLog::onMessage);
+        installed_ = true;
+    }
+}
+
+void DriverLog::detach() {
+    EventLoop* loop;
+    EventLoop::TaskId timer;
+    {
+        // Waits for a running flush
+        std::lock_guard<std::mutex> lock(mutex_);
+        listening_ = false;
+        loop = loop_;
+        timer = flushTimer_;
+        loop_ = nullptr;
+        dispatcher_ = nullptr;
+        flushTimer_ = 0;
+    }
+    // Outside the lock, which a flush about to start takes; it then finds
+    // nothing attached
+    if (loop != nullptr && timer != 0) {
+        loop->cancel(timer);
+    }
+    flushScheduled_ = false;
+}
+
+void DriverLog::listen(LogLevel minLevel, std::chrono::milliseconds batchInterval) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    minLevel_ = minLevel;
+    batchInterval_ = batchInterval;
+    // Older entries are available through tail()
+    cursor_ = ring_.head();
+    listening_ = true;
+}
+
+void DriverLog::cancel() {
+    listening_ = false;
+}
+
+void DriverLog::tail(size_t maxEntries, LogLevel minLevel, std::vector<LogRing::Entry>& out) const {
+    ring_.tail(maxEntries, minLevel, out);
+}
+
+void CALLBACK DriverLog::onMessage(WIREGUARD_LOGGER_LEVEL level, DWORD64 timestamp, LPCWSTR message) {
+    int64_t timestampMs = timestamp > kUnixEpochFileTime
+                              ? static_cast<int64_t>((timestamp - kUnixEpochFileTime) / 10000)
+                              : 0;
+    instance().append(toLogLevel(level), timestampMs, message);
+}
+
+void DriverLog::append(LogLevel level, int64_t timestampMs, LPCWSTR message) {
+    // The ring keeps kMaxMessageBytes at most, so no more characters than
+    // that are converted; each takes up to three bytes
+    char text[LogRing::kMaxMessageBytes * 3];
+    size_t size = 0;
+    if (message != nullptr) {
+        size_t characters = wcsnlen(message, LogRing::kMaxMessageBytes);
+        if (characters > 0 && IS_HIGH_SURROGATE(message[characters - 1])) {
+            characters--;
+        }
+        int length = WideCharToMultiByte(CP_UTF8, 0, message, static_cast<int>(characters), text,
+                                         static_cast<int>(sizeof(text)), nullptr, nullptr);
+        size = length > 0 ? static_cast<size_t>(length) : 0;
+    }
+    ring_.push(level, timestampMs, std::string_view(text, size));
+
+    if (listening_.load(std::memory_order_relaxed) && !flushScheduled_.exchange(true, std::memory_order_acq_rel)) {
+        scheduleFlush();
+    }
+}
+
+void DriverLog::scheduleFlush() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    scheduleFlushLocked();
+}
+
+void DriverLog::scheduleFlushLocked() {
+    if (loop_ == nullptr) {
+        flushScheduled_ = false;
+        return;
+    }
+    flushTimer_ = loop_->addTimer(batchInterval_, [this]() { flush(); });
+}
+
+void DriverLog::flush() {
+    // Messages pushed from here on schedule the next flush
+    flushScheduled_.store(false, std::memory_order_release);
+
+    // Held throughout, so detach() returns only once no flush uses the
+    // dispatcher
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (dispatcher_ == nullptr || !listening_) {
+        return;
+    }
+
+    uint64_t lost = ring_.read(cursor_, kMaxBatch, minLevel_, batch_);
+    if (!batch_.empty() || lost > 0) {
+        flutter::EncodableList entries;
+        entries.reserve(batch_.size());
+        for (const auto& entry : batch_) {
+            entries.push_back(flutter::EncodableValue(flutter::EncodableMap{
+                {flutter::EncodableValue("seq"), flutter::EncodableValue(static_cast<int64_t>(entry.sequence))},
+                {flutter::EncodableValue("timestampMs"), flutter::EncodableValue(entry.timestampMs)},
+                {flutter::EncodableValue("level"), flutter::EncodableValue(logLevelName(entry.level))},
+                {flutter::EncodableValue("message"), flutter::EncodableValue(entry.message)},
+            }));
+        }
+        dispatcher_->postEvent("log", flutter::EncodableMap{
+            {flutter::EncodableValue("entries"), flutter::EncodableValue(std::move(entries))},
+            {flutter::EncodableValue("lost"), flutter::EncodableValue(static_cast<int64_t>(lost))},
+        });
+    }
+
+    // A full batch leaves more behind; pick it up without waiting for a push
+    if (ring_.head() > cursor_ && !flushScheduled_.exchange(true, std::memory_order_acq_rel)) {
+        scheduleFlushLocked();
+    }
+}
+
+} // namespace wireguard_flutter
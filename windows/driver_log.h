@@ -0,0 +1,74 @@
+#pragma once
+
+#include <windows.h>
+
+#include <wireguard.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "event_dispatcher.h"
+#include "event_loop.h"
+#include "log_ring.h"
+
+namespace wireguard_flutter {
+
+// Captures wireguard.dll and driver log messages through WireGuardSetLogger.
+//
+// The logger is process-wide and may be called from several threads at
+// once, so the callback only converts the message to UTF-8 on the stack and
+// pushes it into a LogRing. While a listener is attached, the first message
+// of a batch schedules a flush on the event loop |batchInterval| later; the
+// flush sends everything at or above the listener's level as one "log" event
+// through its own EventDispatcher. One instance per process; the plugin
+// attaches its loop and dispatcher and detaches them before they go away.
+class DriverLog {
+public:
+    static constexpr size_t kMaxBatch = 256;
+    static constexpr std::chrono::milliseconds kDefaultBatchInterval{250};
+
+    static DriverLog& instance();
+
+    // Installs the logger on first use
+    void attach(EventLoop& loop, EventDispatcher& dispatcher);
+    void detach();
+
+    // Platform thread; starts streaming entries pushed from now on
+    void listen(LogLevel minLevel, std::chrono::milliseconds batchInterval);
+    void cancel();
+
+    // Newest |maxEntries| entries at or above |minLevel|
+    void tail(size_t maxEntries, LogLevel minLevel, std::vector<LogRing::Entry>& out) const;
+
+private:
+    DriverLog() = default;
+
+    static void CALLBACK onMessage(WIREGUARD_LOGGER_LEVEL level, DWORD64 timestamp, LPCWSTR message);
+    void append(LogLevel level, int64_t timestampMs, LPCWSTR message);
+    void scheduleFlush();
+    void scheduleFlushLocked();
+    void flush();
+
+    LogRing ring_;
+    std::atomic<bool> listening_{false};
+    std::atomic<bool> flushScheduled_{false};
+    bool installed_ = false;
+
+    // Guards the attachment, the listener's settings and the stream cursor;
+    // the logger callback only takes it to schedule a flush
+    std::mutex mutex_;
+    EventLoop* loop_ = nullptr;
+    EventDispatcher* dispatcher_ = nullptr;
+    EventLoop::TaskId flushTimer_ = 0;
+    LogLevel minLevel_ = LogLevel::Info;
+    std::chrono::milliseconds batchInterval_ = kDefaultBatchInterval;
+
+    // Next entry to stream; reset by listen(), advanced by flush()
+    uint64_t cursor_ = 0;
+    std::vector<LogRing::Entry> batch_;
+};
+
+} // namespace wireguard_flutter
@@ -0,0 +1,409 @@
+#include "endpoint_prober.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+#include "logger.h"
+#include "wg_quick_config.h"
+
+namespace wireguard_flutter {
+
+namespace {
+
+#ifdef _WIN32
+using SocketHandle = SOCKET;
+using AddressLength = int;
+const SocketHandle kInvalidSocket = INVALID_SOCKET;
+
+void closeSocket(SocketHandle socket) {
+    closesocket(socket);
+}
+
+bool refused() {
+    // An ICMP port unreachable for an earlier probe; the socket stays usable
+    return WSAGetLastError() == WSAECONNRESET;
+}
+#else
+using SocketHandle = int;
+using AddressLength = socklen_t;
+const SocketHandle kInvalidSocket = -1;
+
+void closeSocket(SocketHandle socket) {
+    ::close(socket);
+}
+
+bool refused() {
+    return errno == ECONNREFUSED || errno == EINTR;
+}
+#endif
+
+// "WGFP", then the run's token, the target and the round, big-endian
+constexpr uint32_t kMagic = 0x57474650;
+constexpr size_t kProbeSize = 16;
+
+// Hundreds of replies can arrive in one burst
+constexpr int kSocketBuffer = 1 << 20;
+
+void putWord(uint8_t* out, uint32_t value) {
+    value = htonl(value);
+    std::memcpy(out, &value, sizeof(value));
+}
+
+uint32_t getWord(const uint8_t* in) {
+    uint32_t value;
+    std::memcpy(&value, in, sizeof(value));
+    return ntohl(value);
+}
+
+std::string formatAddress(const sockaddr_storage& address) {
+    char text[INET6_ADDRSTRLEN] = {};
+    if (address.ss_family == AF_INET6) {
+        const auto& v6 = reinterpret_cast<const sockaddr_in6&>(address);
+        inet_ntop(AF_INET6, &v6.sin6_addr, text, sizeof(text));
+        return "[" + std::string(text) + "]:" + std::to_string(ntohs(v6.sin6_port));
+    }
+    const auto& v4 = reinterpret_cast<const sockaddr_in&>(address);
+    inet_ntop(AF_INET, &v4.sin_addr, text, sizeof(text));
+    return std::string(text) + ":" + std::to_string(ntohs(v4.sin_port));
+}
+
+bool sameAddress(const sockaddr_storage& a, const sockaddr_storage& b) {
+    if (a.ss_family != b.ss_family) {
+        return false;
+    }
+    if (a.ss_family == AF_INET6) {
+        const auto& x = reinterpret_cast<const sockaddr_in6&>(a);
+        const auto& y = reinterpret_cast<const sockaddr_in6&>(b);
+        return x.sin6_port == y.sin6_port && std::memcmp(&x.sin6_addr, &y.sin6_addr, sizeof(x.sin6_addr)) == 0;
+    }
+    const auto& x = reinterpret_cast<const sockaddr_in&>(a);
+    const auto& y = reinterpret_cast<const sockaddr_in&>(b);
+    return x.sin_port == y.sin_port && x.sin_addr.s_addr == y.sin_addr.s_addr;
+}
+
+} // namespace
+
+struct EndpointProber::Target {
+    std::string endpoint;
+    std::string address;
+    sockaddr_storage sockaddr{};
+    AddressLength length = 0;
+    // Per round; a zero time point was not sent, -1 was not answered
+    std::vector<Clock::time_point> sentAt;
+    std::vector<int64_t> rttUs;
+    uint32_t sent = 0;
+    uint32_t received = 0;
+};
+
+struct EndpointProber::Socket {
+    SocketHandle handle = kInvalidSocket;
+    int family = AF_UNSPEC;
+    EventLoop::Waitable waitable{};
+    EventLoop::TaskId wait = 0;
+};
+
+bool EndpointProber::start(EventLoop& loop, const std::vector<std::string>& endpoints, const Options& options,
+                           Done done) {
+    auto prober = std::make_shared<EndpointProber>(loop, options, std::move(done));
+    if (!prober->open(endpoints)) {
+        return false;
+    }
+    for (auto& socket : prober->sockets_) {
+        prober->watch(*socket);
+    }
+    loop.post([prober] { prober->sendRound(); });
+    return true;
+}
+
+void EndpointProber::sort(std::vector<Result>& results) {
+    std::stable_sort(results.begin(), results.end(), [](const Result& a, const Result& b) {
+        if ((a.received > 0) != (b.received > 0)) {
+            return a.received > 0;
+        }
+        if (a.loss != b.loss) {
+            return a.loss < b.loss;
+        }
+        if (a.rttMs != b.rttMs) {
+            return a.rttMs < b.rttMs;
+        }
+        return a.jitterMs < b.jitterMs;
+    });
+}
+
+EndpointProber::EndpointProber(EventLoop& loop, const Options& options, Done done)
+    : loop_(loop), options_(options), done_(std::move(done)) {
+    options_.rounds = std::max<uint32_t>(options_.rounds, 1);
+}
+
+EndpointProber::~EndpointProber() {
+    // Only runs once no loop callback holds the prober, possibly while the
+    // loop drops one, so the loop is not touched here
+    for (auto& socket : sockets_) {
+        if (socket->handle != kInvalidSocket) {
+            closeSocket(socket->handle);
+        }
+#ifdef _WIN32
+        if (socket->waitable != nullptr) {
+            WSACloseEvent(socket->waitable);
+        }
+#endif
+    }
+#ifdef _WIN32
+    if (winsock_) {
+        WSACleanup();
+    }
+#endif
+}
+
+bool EndpointProber::open(const std::vector<std::string>& endpoints) {
+#ifdef _WIN32
+    WSADATA wsaData;
+    winsock_ = WSAStartup(MAKEWORD(2, 2), &wsaData) == 0;
+    if (!winsock_) {
+        return false;
+    }
+#endif
+    std::random_device random;
+    token_ = random();
+
+    bool families[2] = {false, false};
+    for (const auto& endpoint : endpoints) {
+        Target target;
+        target.endpoint = endpoint;
+        target.sentAt.resize(options_.rounds);
+        target.rttUs.assign(options_.rounds, -1);
+
+        std::string host;
+        std::string port;
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_DGRAM;
+        hints.ai_protocol = IPPROTO_UDP;
+        hints.ai_flags = AI_ADDRCONFIG;
+        addrinfo* results = nullptr;
+        if (WgQuickConfig::splitEndpoint(endpoint, host, port) &&
+            getaddrinfo(host.c_str(), port.c_str(), &hints, &results) == 0) {
+            for (addrinfo* info = results; info != nullptr; info = info->ai_next) {
+                if ((info->ai_family == AF_INET || info->ai_family == AF_INET6) &&
+                    info->ai_addrlen <= sizeof(target.sockaddr)) {
+                    std::memcpy(&target.sockaddr, info->ai_addr, info->ai_addrlen);
+                    target.length = static_cast<AddressLength>(info->ai_addrlen);
+                    target.address = formatAddress(target.sockaddr);
+                    families[info->ai_family == AF_INET6 ? 1 : 0] = true;
+                    break;
+                }
+            }
+            freeaddrinfo(results);
+        }
+        targets_.push_back(std::move(target));
+    }
+
+    for (int family : {AF_INET, AF_INET6}) {
+        if (!families[family == AF_INET6 ? 1 : 0]) {
+            continue;
+        }
+        auto socket = std::make_unique<Socket>();
+        socket->family = family;
+        socket->handle = ::socket(family, SOCK_DGRAM, IPPROTO_UDP);
+        if (socket->handle == kInvalidSocket) {
+            WG_LOG_WARN("EndpointProber: Could not open a socket for family {}", family);
+            continue;
+        }
+        int buffer = kSocketBuffer;
+        setsockopt(socket->handle, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<const char*>(&buffer), sizeof(buffer));
+        setsockopt(socket->handle, SOL_SOCKET, SO_SNDBUF, reinterpret_cast<const char*>(&buffer), sizeof(buffer));
+#ifdef _WIN32
+        // Also makes the socket non-blocking
+        socket->waitable = WSACreateEvent();
+        if (socket->waitable == WSA_INVALID_EVENT ||
+            WSAEventSelect(socket->handle, socket->waitable, FD_READ) != 0) {
+            if (socket->waitable != WSA_INVALID_EVENT) {
+                WSACloseEvent(socket->waitable);
+            }
+            closeSocket(socket->handle);
+            continue;
+        }
+#else
+        fcntl(socket->handle, F_SETFL, fcntl(socket->handle, F_GETFL) | O_NONBLOCK);
+        socket->waitable = socket->handle;
+#endif
+        sockets_.push_back(std::move(socket));
+    }
+    return !sockets_.empty() || targets_.empty() ||
+           std::none_of(targets_.begin(), targets_.end(), [](const Target& target) { return target.length != 0; });
+}
+
+void EndpointProber::sendRound() {
+    if (finished_) {
+        return;
+    }
+    if (sockets_.empty()) {
+        // Nothing resolved; there is nothing to wait for
+        finish();
+        return;
+    }
+    auto now = Clock::now();
+    uint8_t probe[kProbeSize];
+    putWord(probe, kMagic);
+    putWord(probe + 4, token_);
+    putWord(probe + 12, round_);
+    for (size_t index = 0; index < targets_.size(); index++) {
+        Target& target = targets_[index];
+        auto socket = std::find_if(sockets_.begin(), sockets_.end(), [&](const std::unique_ptr<Socket>& candidate) {
+            return target.length != 0 && candidate->family == target.sockaddr.ss_family;
+        });
+        if (socket == sockets_.end()) {
+            continue;
+        }
+        putWord(probe + 8, static_cast<uint32_t>(index));
+        auto sent = sendto((*socket)->handle, reinterpret_cast<const char*>(probe), static_cast<int>(kProbeSize), 0,
+                           reinterpret_cast<const sockaddr*>(&target.sockaddr), target.length);
+        if (sent == static_cast<decltype(sent)>(kProbeSize)) {
+            target.sentAt[round_] = now;
+            target.sent++;
+        }
+    }
+
+    round_++;
+    auto self = shared_from_this();
+    if (round_ < options_.rounds) {
+        timer_ = loop_.addTimer(options_.interval, [self] { self->sendRound(); });
+    } else {
+        timer_ = loop_.addTimer(options_.timeout, [self] { self->finish(); });
+    }
+}
+
+void EndpointProber::watch(Socket& socket) {
+    auto self = shared_from_this();
+    Socket* target = &socket;
+    socket.wait = loop_.addWait(socket.waitable, [self, target] { self->receive(*target); });
+}
+
+void EndpointProber::receive(Socket& socket) {
+    socket.wait = 0;
+    if (finished_) {
+        return;
+    }
+#ifdef _WIN32
+    // Resets the event before draining, so a datagram arriving after the
+    // last read signals it again
+    WSANETWORKEVENTS events;
+    WSAEnumNetworkEvents(socket.handle, socket.waitable, &events);
+#endif
+    auto now = Clock::now();
+    uint8_t buffer[64];
+    for (;;) {
+        sockaddr_storage from{};
+        AddressLength fromLength = sizeof(from);
+        auto length = recvfrom(socket.handle, reinterpret_cast<char*>(buffer), static_cast<int>(sizeof(buffer)), 0,
+                               reinterpret_cast<sockaddr*>(&from), &fromLength);
+        if (length < 0) {
+            if (refused()) {
+                continue;
+            }
+            // Would block, or an error the next round cannot fix either
+            break;
+        }
+        if (length != static_cast<decltype(length)>(kProbeSize) || getWord(buffer) != kMagic ||
+            getWord(buffer + 4) != token_) {
+            continue;
+        }
+        uint32_t index = getWord(buffer + 8);
+        uint32_t round = getWord(buffer + 12);
+        if (index >= targets_.size() || round >= options_.rounds) {
+            continue;
+        }
+        Target& target = targets_[index];
+        // Only the probed address may answer, and only once per round
+        if (!sameAddress(from, target.sockaddr) || target.sentAt[round] == Clock::time_point{} ||
+            target.rttUs[round] >= 0) {
+            continue;
+        }
+        target.rttUs[round] = std::chrono::duration_cast<std::chrono::microseconds>(now - target.sentAt[round]).count();
+        target.received++;
+    }
+
+    if (round_ >= options_.rounds && complete()) {
+        finish();
+        return;
+    }
+    watch(socket);
+}
+
+bool EndpointProber::complete() const {
+    return std::all_of(targets_.begin(), targets_.end(),
+                       [](const Target& target) { return target.received == target.sent; });
+}
+
+void EndpointProber::finish() {
+    if (finished_) {
+        return;
+    }
+    finished_ = true;
+    if (timer_ != 0) {
+        loop_.cancel(timer_);
+        timer_ = 0;
+    }
+    for (auto& socket : sockets_) {
+        if (socket->wait != 0) {
+            loop_.cancel(socket->wait);
+            socket->wait = 0;
+        }
+    }
+
+    std::vector<Result> results;
+    results.reserve(targets_.size());
+    for (const auto& target : targets_) {
+        Result result;
+        result.endpoint = target.endpoint;
+        result.address = target.address;
+        result.sent = target.sent;
+        result.received = target.received;
+        if (target.sent > 0) {
+            result.loss = 1.0 - static_cast<double>(target.received) / static_cast<double>(target.sent);
+        }
+        double total = 0;
+        double variation = 0;
+        int64_t previous = -1;
+        for (int64_t rtt : target.rttUs) {
+            if (rtt < 0) {
+                continue;
+            }
+            double ms = static_cast<double>(rtt) / 1000.0;
+            total += ms;
+            result.minRttMs = result.minRttMs < 0 ? ms : std::min(result.minRttMs, ms);
+            if (previous >= 0) {
+                variation += std::fabs(static_cast<double>(rtt - previous)) / 1000.0;
+            }
+            previous = rtt;
+        }
+        if (target.received > 0) {
+            result.rttMs = total / target.received;
+            result.jitterMs = target.received > 1 ? variation / (target.received - 1) : 0;
+        }
+        results.push_back(std::move(result));
+    }
+    sort(results);
+
+    Done done = std::move(done_);
+    if (done) {
+        done(std::move(results));
+    }
+}
+
+} // namespace wireguard_flutter
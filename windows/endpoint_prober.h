@@ -0,0 +1,95 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "event_loop.h"
+
+namespace wireguard_flutter {
+
+// Measures round-trip time, jitter and loss to many endpoints at once with
+// small UDP probes, to pick a server before connecting.
+//
+// Each round sends one probe to every target, from one socket per address
+// family, and replies are matched by a per-run token, the target and the
+// round. Hundreds of targets therefore cost two sockets and no threads:
+// rounds are timers and replies are waits on the EventLoop. Replies are
+// awaited for timeout after the last round. The probed port has to echo
+// the datagram back; a WireGuard port drops anything unauthenticated, so
+// servers need an echo responder for this.
+//
+// Names are resolved by start() on the calling thread. Portable.
+class EndpointProber : public std::enable_shared_from_this<EndpointProber> {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Options {
+        uint32_t rounds = 4;
+        std::chrono::milliseconds interval{200};
+        std::chrono::milliseconds timeout{1000};
+    };
+
+    struct Result {
+        // As given, e.g. "vpn.example.com:51820"
+        std::string endpoint;
+        // The address probed; empty when the endpoint did not resolve
+        std::string address;
+        uint32_t sent = 0;
+        uint32_t received = 0;
+        // Over the replies received; -1 without any
+        double rttMs = -1;
+        double minRttMs = -1;
+        // Mean difference between consecutive round trips
+        double jitterMs = -1;
+        // Share of sent probes without a reply, 0 to 1
+        double loss = 1;
+    };
+
+    // Called once on the loop thread, best first
+    using Done = std::function<void(std::vector<Result>)>;
+
+    // Probes |endpoints| on |loop|; false when no socket could be opened,
+    // in which case |done| is not called. The prober keeps itself alive
+    // until it is done.
+    static bool start(EventLoop& loop, const std::vector<std::string>& endpoints, const Options& options,
+                      Done done);
+
+    // Answered before silent, then less loss, lower round trip and lower
+    // jitter; ties keep the order given
+    static void sort(std::vector<Result>& results);
+
+    EndpointProber(EventLoop& loop, const Options& options, Done done);
+    ~EndpointProber();
+
+    EndpointProber(const EndpointProber&) = delete;
+    EndpointProber& operator=(const EndpointProber&) = delete;
+
+private:
+    struct Target;
+    struct Socket;
+
+    bool open(const std::vector<std::string>& endpoints);
+    void sendRound();
+    void watch(Socket& socket);
+    void receive(Socket& socket);
+    bool complete() const;
+    void finish();
+
+    EventLoop& loop_;
+    Options options_;
+    Done done_;
+
+    std::vector<Target> targets_;
+    std::vector<std::unique_ptr<Socket>> sockets_;
+    uint32_t token_ = 0;
+    uint32_t round_ = 0;
+    EventLoop::TaskId timer_ = 0;
+    bool finished_ = false;
+    bool winsock_ = false;
+};
+
+} // namespace wireguard_flutter
@@ -0,0 +1,86 @@
+#include "endpoint_race.h"
+
+#include <algorithm>
+
+namespace wireguard_flutter {
+
+const char* EndpointRace::resultName(Result result) {
+    switch (result) {
+    case Result::Won:
+        return "won";
+    case Result::Cancelled:
+        return "cancelled";
+    case Result::Failed:
+        return "failed";
+    case Result::TimedOut:
+        return "timed_out";
+    case Result::Pending:
+    default:
+        return "pending";
+    }
+}
+
+size_t EndpointRace::add(const std::string& endpoint, const std::string& address) {
+    Entry entry;
+    entry.endpoint = endpoint;
+    entry.address = address;
+    entries_.push_back(std::move(entry));
+    return entries_.size() - 1;
+}
+
+void EndpointRace::start(Clock::time_point now) {
+    start_ = now;
+    started_ = true;
+    finished_ = false;
+    winner_.reset();
+}
+
+bool EndpointRace::onHandshake(size_t index, Clock::time_point now) {
+    if (!started_ || finished_ || index >= entries_.size() || entries_[index].result != Result::Pending) {
+        return false;
+    }
+    entries_[index].result = Result::Won;
+    entries_[index].elapsed = since(now);
+    winner_ = index;
+    finish(Result::Cancelled, now);
+    return true;
+}
+
+void EndpointRace::onFailed(size_t index, Clock::time_point now) {
+    if (finished_ || index >= entries_.size() || entries_[index].result != Result::Pending) {
+        return;
+    }
+    entries_[index].result = Result::Failed;
+    entries_[index].elapsed = started_ ? since(now) : std::chrono::milliseconds(0);
+}
+
+bool EndpointRace::poll(Clock::time_point now) {
+    if (finished_ || !started_) {
+        return finished_;
+    }
+    bool pending = std::any_of(entries_.begin(), entries_.end(),
+                               [](const Entry& entry) { return entry.result == Result::Pending; });
+    if (!pending) {
+        finish(Result::Failed, now);
+    } else if (now >= deadline()) {
+        finish(Result::TimedOut, now);
+    }
+    return finished_;
+}
+
+void EndpointRace::finish(Result pending, Clock::time_point now) {
+    for (auto& entry : entries_) {
+        if (entry.result == Result::Pending) {
+            entry.result = pending;
+            entry.elapsed = since(now);
+        }
+    }
+    finished_ = true;
+    duration_ = since(now);
+}
+
+std::chrono::milliseconds EndpointRace::since(Clock::time_point now) const {
+    return std::max(std::chrono::duration_cast<std::chrono::milliseconds>(now - start_), std::chrono::milliseconds(0));
+}
+
+} // namespace wireguard_flutter
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace wireguard_flutter {
+
+// Bookkeeping for racing several endpoints of one peer: every candidate
+// address starts its handshake at the same moment, the first to complete
+// wins and the rest are cancelled, and each keeps the time it took to win,
+// fail or be cancelled.
+//
+// Nothing here sends a packet or reads a clock; the caller starts the
+// handshakes, reports what happened with the current time and calls poll()
+// until the race is over. Not thread-safe. Portable.
+class EndpointRace {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Result : uint8_t {
+        Pending,
+        Won,
+        // Still running when another candidate won
+        Cancelled,
+        // Could not be tried, e.g. the name did not resolve
+        Failed,
+        TimedOut,
+    };
+
+    struct Options {
+        // WireGuard's REKEY_TIMEOUT; a lone initiation is retried after this
+        std::chrono::milliseconds timeout{5000};
+    };
+
+    struct Entry {
+        // As configured, e.g. "vpn.example.com:51820"
+        std::string endpoint;
+        // The address raced, e.g. "[2001:db8::1]:51820"; empty when Failed
+        // before resolving
+        std::string address;
+        Result result = Result::Pending;
+        // From the start until the result was known; -1 while Pending
+        std::chrono::milliseconds elapsed{-1};
+    };
+
+    // Result code sent to Dart
+    static const char* resultName(Result result);
+
+    void configure(const Options& options) { options_ = options; }
+    const Options& options() const { return options_; }
+
+    // Adds a candidate before start(); returns its index
+    size_t add(const std::string& endpoint, const std::string& address);
+
+    void start(Clock::time_point now);
+
+    // The handshake with |index| completed; true when that won the race
+    bool onHandshake(size_t index, Clock::time_point now);
+    // |index| could not be tried or was refused
+    void onFailed(size_t index, Clock::time_point now);
+
+    // Times out what is still pending at the deadline; true once the race
+    // is over, because a candidate won, all failed or time ran out
+    bool poll(Clock::time_point now);
+
+    bool finished() const { return finished_; }
+    Clock::time_point deadline() const { return start_ + options_.timeout; }
+    std::optional<size_t> winner() const { return winner_; }
+    // From start() until the race was over
+    std::chrono::milliseconds duration() const { return duration_; }
+    const std::vector<Entry>& entries() const { return entries_; }
+
+private:
+    void finish(Result pending, Clock::time_point now);
+    std::chrono::milliseconds since(Clock::time_point now) const;
+
+    Options options_;
+    std::vector<Entry> entries_;
+    Clock::time_point start_{};
+    bool started_ = false;
+    bool finished_ = false;
+    std::optional<size_t> winner_;
+    std::chrono::milliseconds duration_{0};
+};
+
+} // namespace wireguard_flutter
@@ -0,0 +1,288 @@
+#include "endpoint_racer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <utility>
+
+#include "logger.h"
+#include "trace_recorder.h"
+
+namespace wireguard_flutter {
+
+namespace {
+
+using Clock = EndpointRace::Clock;
+
+// Handshakes complete in a round trip or two; polling the adapters this
+// often keeps the measured times close to that
+constexpr auto kPollInterval = std::chrono::milliseconds(5);
+
+// Adapters are named after the race, so races of several tunnels overlap
+std::atomic<uint64_t> nextRace{1};
+
+} // namespace
+
+std::shared_ptr<EndpointRacer> EndpointRacer::start(EventLoop& loop, Backend& backend, ResolverCache* resolver,
+                                                    const std::string& config,
+                                                    const std::vector<Candidate>& candidates,
+                                                    const EndpointRace::Options& options, Done done) {
+    auto racer = std::make_shared<EndpointRacer>(loop, backend, resolver, config, candidates, options,
+                                                 std::move(done));
+    loop.post([racer]() { racer->begin(); });
+    return racer;
+}
+
+EndpointRacer::EndpointRacer(EventLoop& loop, Backend& backend, ResolverCache* resolver, const std::string& config,
+                             const std::vector<Candidate>& candidates, const EndpointRace::Options& options,
+                             Done done)
+    : loop_(loop), backend_(backend), resolver_(resolver), config_(config), done_(std::move(done)),
+      id_(nextRace++) {
+    race_.configure(options);
+    result_ = config;
+    usable_ = WgQuickConfig::parse(config, parsed_) && !parsed_.peers.empty() &&
+              WgQuickConfig::isKey(parsed_.privateKey) && WgQuickConfig::isKey(parsed_.peers[0].publicKey);
+    if (usable_ && !parsed_.peers[0].endpoint.empty()) {
+        candidates_.push_back(Candidate{parsed_.peers[0].endpoint, std::string()});
+    }
+    candidates_.insert(candidates_.end(), candidates.begin(), candidates.end());
+}
+
+void EndpointRacer::cancel() {
+    if (loop_.inLoopThread()) {
+        abort();
+        return;
+    }
+    auto self = shared_from_this();
+    loop_.post([self]() { self->abort(); });
+    std::unique_lock<std::mutex> lock(closedMutex_);
+    closedChanged_.wait(lock, [this] { return closed_; });
+}
+
+void EndpointRacer::begin() {
+    if (phase_ != Phase::Resolving || cancelled_) {
+        return;
+    }
+    startUs_ = TraceRecorder::nowUs();
+    if (!usable_) {
+        WG_LOG_WARN("EndpointRacer: Config has no usable keys; not racing");
+        close();
+        return;
+    }
+
+    std::vector<std::string> hosts;
+    for (const auto& candidate : candidates_) {
+        std::string host;
+        std::string port;
+        if (WgQuickConfig::splitEndpoint(candidate.endpoint, host, port) && !WgQuickConfig::isAddressLiteral(host)) {
+            hosts.push_back(host);
+        }
+    }
+    if (!resolver_ || hosts.empty()) {
+        onResolved();
+        return;
+    }
+    // Names still unanswered when the race would be over are given up on
+    auto self = shared_from_this();
+    timer_ = loop_.addTimer(race_.options().timeout, [self]() { self->onResolved(); });
+    EventLoop* loop = &loop_;
+    resolver_->whenResolved(hosts, ResolverCache::Clock::now(), [loop, self]() {
+        loop->post([self]() { self->onResolved(); });
+    });
+}
+
+void EndpointRacer::onResolved() {
+    if (phase_ != Phase::Resolving || cancelled_) {
+        return;
+    }
+    loop_.cancel(timer_);
+    timer_ = 0;
+
+    // One probe per distinct key and address; candidates that cannot be
+    // tried are recorded as failed right away
+    auto now = ResolverCache::Clock::now();
+    std::vector<size_t> failed;
+    for (const auto& candidate : candidates_) {
+        Probe probe;
+        probe.publicKey = candidate.publicKey.empty() ? parsed_.peers[0].publicKey : candidate.publicKey;
+        std::string host;
+        std::string port;
+        std::vector<std::string> addresses;
+        if (WgQuickConfig::isKey(probe.publicKey) && WgQuickConfig::splitEndpoint(candidate.endpoint, host, port)) {
+            if (WgQuickConfig::isAddressLiteral(host)) {
+                addresses.push_back(host);
+            } else if (resolver_) {
+                addresses = resolver_->lookup(host, now);
+            }
+        }
+        if (addresses.empty()) {
+            failed.push_back(race_.add(candidate.endpoint, std::string()));
+            continue;
+        }
+        for (const auto& address : addresses) {
+            probe.address = WgQuickConfig::joinEndpoint(address, port);
+            bool duplicate = std::any_of(probes_.begin(), probes_.end(), [&](const Probe& other) {
+                return other.address == probe.address && other.publicKey == probe.publicKey;
+            });
+            if (duplicate) {
+                continue;
+            }
+            probe.slot = static_cast<size_t>(std::count_if(probes_.begin(), probes_.end(), [&](const Probe& other) {
+                return other.publicKey == probe.publicKey;
+            }));
+            probe.entry = race_.add(candidate.endpoint, probe.address);
+            probes_.push_back(probe);
+        }
+    }
+    for (size_t index : failed) {
+        race_.onFailed(index, Clock::now());
+    }
+
+    // Adapters take a while to create, so all are set up at once before the
+    // clock starts and brought up together
+    size_t slots = 0;
+    for (const auto& probe : probes_) {
+        slots = std::max(slots, probe.slot + 1);
+    }
+    up_.assign(slots, false);
+    if (slots == 0) {
+        race_.start(Clock::now());
+        race_.poll(Clock::now());
+        finish();
+        return;
+    }
+    phase_ = Phase::Creating;
+    creating_ = slots;
+    auto self = shared_from_this();
+    for (size_t slot = 0; slot < slots; slot++) {
+        backend_.create(id_, slot, slotConfig(slot), [self, slot](bool created) {
+            self->loop_.post([self, slot, created]() { self->onCreated(slot, created); });
+        });
+    }
+}
+
+void EndpointRacer::onCreated(size_t slot, bool created) {
+    up_[slot] = created;
+    if (--creating_ > 0) {
+        return;
+    }
+    if (cancelled_) {
+        close();
+        return;
+    }
+
+    phase_ = Phase::Racing;
+    race_.start(Clock::now());
+    for (size_t i = 0; i < up_.size(); i++) {
+        if (up_[i] && !backend_.setUp(id_, i)) {
+            up_[i] = false;
+        }
+    }
+    for (const auto& probe : probes_) {
+        if (!up_[probe.slot]) {
+            race_.onFailed(probe.entry, Clock::now());
+        }
+    }
+    if (race_.poll(Clock::now())) {
+        finish();
+        return;
+    }
+    auto self = shared_from_this();
+    timer_ = loop_.addRepeatingTimer(kPollInterval, [self]() { self->poll(); });
+}
+
+void EndpointRacer::poll() {
+    if (phase_ != Phase::Racing) {
+        return;
+    }
+    for (const auto& probe : probes_) {
+        if (up_[probe.slot] && backend_.hasHandshake(id_, probe.slot, probe.publicKey) &&
+            race_.onHandshake(probe.entry, Clock::now())) {
+            break;
+        }
+    }
+    if (race_.poll(Clock::now())) {
+        finish();
+    }
+}
+
+void EndpointRacer::finish() {
+    loop_.cancel(timer_);
+    timer_ = 0;
+    for (const auto& entry : race_.entries()) {
+        WG_LOG_INFO("EndpointRacer: {} ({}) {} after {} ms", entry.endpoint, entry.address,
+                    EndpointRace::resultName(entry.result), entry.elapsed.count());
+    }
+    auto winner = race_.winner();
+    if (!winner) {
+        WG_LOG_WARN("EndpointRacer: No endpoint answered within {} ms", race_.options().timeout.count());
+    } else {
+        const Probe& won = *std::find_if(probes_.begin(), probes_.end(),
+                                         [&](const Probe& probe) { return probe.entry == *winner; });
+        TraceRecorder::instance().instant("race", "won", won.address, "elapsedMs",
+                                          static_cast<int64_t>(race_.entries()[*winner].elapsed.count()));
+        // The address, not the name, so the service does not resolve it
+        // again and pick the other family
+        std::string key = won.publicKey == parsed_.peers[0].publicKey ? std::string() : won.publicKey;
+        result_ = WgQuickConfig::withPeerEndpoint(config_, 0, won.address, key);
+    }
+    close();
+}
+
+// Removing the adapters drops the losers' handshakes in flight
+void EndpointRacer::close() {
+    phase_ = Phase::Closing;
+    auto self = shared_from_this();
+    backend_.close(id_, [self]() {
+        self->loop_.post([self]() {
+            self->phase_ = Phase::Done;
+            {
+                std::lock_guard<std::mutex> lock(self->closedMutex_);
+                self->closed_ = true;
+            }
+            self->closedChanged_.notify_all();
+            TraceRecorder::instance().complete("race", "endpoints", self->startUs_,
+                                               TraceRecorder::nowUs() - self->startUs_,
+                                               self->usable_ ? self->parsed_.peers[0].endpoint : std::string());
+            if (!self->cancelled_) {
+                auto done = std::exchange(self->done_, nullptr);
+                done(self->result_, self->race_);
+            }
+        });
+    });
+}
+
+void EndpointRacer::abort() {
+    if (cancelled_) {
+        return;
+    }
+    cancelled_ = true;
+    switch (phase_) {
+    case Phase::Resolving:
+    case Phase::Racing:
+        loop_.cancel(timer_);
+        timer_ = 0;
+        close();
+        break;
+    case Phase::Creating:
+        // Closed once the last create answered
+    case Phase::Closing:
+    case Phase::Done:
+        break;
+    }
+}
+
+EndpointRacer::Slot EndpointRacer::slotConfig(size_t slot) const {
+    Slot config;
+    config.privateKey = parsed_.privateKey;
+    if (WgQuickConfig::isKey(parsed_.peers[0].presharedKey)) {
+        config.presharedKey = parsed_.peers[0].presharedKey;
+    }
+    for (const auto& probe : probes_) {
+        if (probe.slot == slot) {
+            config.peers.push_back(Slot::Peer{probe.publicKey, probe.address});
+        }
+    }
+    return config;
+}
+
+} // namespace wireguard_flutter
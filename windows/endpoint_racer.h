@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstddef>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "endpoint_race.h"
+#include "event_loop.h"
+#include "resolver_cache.h"
+#include "wg_quick_config.h"
+
+namespace wireguard_flutter {
+
+// Races the endpoints a tunnel's first peer could use before the tunnel
+// service starts, by letting the driver handshake with all of them at once.
+//
+// Every candidate is resolved to all of its addresses through the plugin's
+// ResolverCache, so a name with both A and AAAA records races both
+// families; a name still unanswered when the race timeout passes fails.
+// The handshakes run on throwaway adapters, without addresses or routes:
+// each address is a peer with a persistent keepalive, which makes the
+// driver send its initiation as soon as the adapter is up. A key can only
+// appear once per adapter, so addresses of the same server are spread over
+// several slots. The first peer to complete a handshake wins, and closing
+// the adapters cancels the rest.
+//
+// Runs on the event loop and never waits on it: the adapters are created
+// and removed by the Backend off the loop, all at once, and handshakes are
+// polled by a loop timer. Races of several tunnels may overlap. Portable.
+class EndpointRacer : public std::enable_shared_from_this<EndpointRacer> {
+public:
+    struct Candidate {
+        // "host:port" or "[v6 address]:port"
+        std::string endpoint;
+        // Base64 public key of the server; empty for the config's own
+        std::string publicKey;
+    };
+
+    // One throwaway adapter: our key and a peer per address raced on it
+    struct Slot {
+        struct Peer {
+            std::string publicKey;
+            // Address literal and port, e.g. "[2001:db8::1]:51820"
+            std::string endpoint;
+        };
+
+        std::string privateKey;
+        // Empty for none; the config's, used with every peer
+        std::string presharedKey;
+        std::vector<Peer> peers;
+    };
+
+    // The adapters, with keys in base64, so races run against a fake in
+    // tests. create() and close() are called on the loop and answer from
+    // any thread; the rest is called on the loop and must not block.
+    class Backend {
+    public:
+        virtual ~Backend() = default;
+
+        // Creates adapter |slot| of race |race|, down, with |config|
+        virtual void create(uint64_t race, size_t slot, const Slot& config, std::function<void(bool)> done) = 0;
+        virtual bool setUp(uint64_t race, size_t slot) = 0;
+        // True once the peer with |publicKey| completed a handshake
+        virtual bool hasHandshake(uint64_t race, size_t slot, const std::string& publicKey) = 0;
+        // Removes every adapter of |race|; only called once its creates answered
+        virtual void close(uint64_t race, std::function<void()> done) = 0;
+    };
+
+    // Called once on the loop thread, after the adapters are gone, with
+    // |config| pointed at the winning address and key, or unchanged when
+    // nothing won
+    using Done = std::function<void(const std::string& config, const EndpointRace& race)>;
+
+    // Races the first peer's own endpoint and |candidates| on |loop|; names
+    // are looked up in |resolver| when there is one. |done| is never called
+    // before this returns. The racer keeps itself alive until it is done.
+    static std::shared_ptr<EndpointRacer> start(EventLoop& loop, Backend& backend, ResolverCache* resolver,
+                                                const std::string& config, const std::vector<Candidate>& candidates,
+                                                const EndpointRace::Options& options, Done done);
+
+    EndpointRacer(EventLoop& loop, Backend& backend, ResolverCache* resolver, const std::string& config,
+                  const std::vector<Candidate>& candidates, const EndpointRace::Options& options, Done done);
+
+    EndpointRacer(const EndpointRacer&) = delete;
+    EndpointRacer& operator=(const EndpointRacer&) = delete;
+
+    // Ends the race without calling |done|. Called off the loop thread, it
+    // waits until the racer is done with the backend and the resolver, so
+    // they may go away after it returns.
+    void cancel();
+
+private:
+    enum class Phase : uint8_t { Resolving, Creating, Racing, Closing, Done };
+
+    struct Probe {
+        size_t entry = 0;
+        size_t slot = 0;
+        std::string publicKey;
+        // As joined for the driver, e.g. "[2001:db8::1]:51820"
+        std::string address;
+    };
+
+    void begin();
+    void onResolved();
+    void onCreated(size_t slot, bool created);
+    void poll();
+    void finish();
+    void close();
+    void abort();
+    Slot slotConfig(size_t slot) const;
+
+    EventLoop& loop_;
+    Backend& backend_;
+    ResolverCache* resolver_;
+    std::string config_;
+    WgQuickConfig parsed_;
+    bool usable_ = false;
+    std::vector<Candidate> candidates_;
+    EndpointRace race_;
+    Done done_;
+    uint64_t id_;
+
+    // Only touched on the loop thread
+    Phase phase_ = Phase::Resolving;
+    bool cancelled_ = false;
+    EventLoop::TaskId timer_ = 0;
+    int64_t startUs_ = 0;
+    std::vector<Probe> probes_;
+    size_t creating_ = 0;
+    std::vector<bool> up_;
+    std::string result_;
+
+    // Set once the adapters are removed
+    std::mutex closedMutex_;
+    std::condition_variable closedChanged_;
+    bool closed_ = false;
+};
+
+} // namespace wireguard_flutter
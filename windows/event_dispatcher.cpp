@@ -0,0 +1,187 @@
+#include "event_dispatcher.h"
+
+#include "logger.h"
+
+namespace wireguard_flutter {
+
+namespace {
+
+const flutter::EncodableValue kEventKey("event");
+const flutter::EncodableValue kSequenceKey("seq");
+const flutter::EncodableValue kStageKey("stage");
+const flutter::EncodableValue kTunnelKey("tunnel");
+
+const wchar_t kFallbackWindowClass[] = L"WireGuardFlutterDispatcherWindow";
+
+flutter::EncodableMap stageFields(const std::string& tunnel, const std::string& stage) {
+    flutter::EncodableMap fields;
+    fields[kEventKey] = flutter::EncodableValue("stage");
+    fields[kTunnelKey] = flutter::EncodableValue(tunnel);
+    fields[kStageKey] = flutter::EncodableValue(stage);
+    return fields;
+}
+
+} // namespace
+
+EventDispatcher::EventDispatcher(flutter::PluginRegistrarWindows* registrar) : registrar_(registrar) {
+    message_ = RegisterWindowMessageW(L"WireGuardFlutterDispatchEvents");
+
+    // Messages have to reach the top-level window for the delegate to see them
+    if (auto* view = registrar_->GetView()) {
+        window_ = GetAncestor(view->GetNativeWindow(), GA_ROOT);
+    }
+    if (window_ == nullptr) {
+        fallbackWindow_ = createFallbackWindow();
+        window_ = fallbackWindow_;
+        if (window_ != nullptr) {
+            WG_LOG_WARN("EventDispatcher: No Flutter window, delivering through a message-only window");
+        } else {
+            WG_LOG_ERROR("EventDispatcher: No window to deliver through ({}), events are not delivered",
+                         GetLastError());
+        }
+    }
+
+    delegateId_ = registrar_->RegisterTopLevelWindowProcDelegate(
+        [this](HWND hwnd, UINT message, WPARAM wparam, LPARAM lparam) {
+            return handleMessage(hwnd, message, wparam, lparam);
+        });
+}
+
+EventDispatcher::~EventDispatcher() {
+    registrar_->UnregisterTopLevelWindowProcDelegate(delegateId_);
+    if (fallbackWindow_ != nullptr) {
+        DestroyWindow(fallbackWindow_);
+    }
+}
+
+LRESULT CALLBACK EventDispatcher::fallbackWindowProc(HWND hwnd, UINT message, WPARAM wparam, LPARAM lparam) {
+    if (message == WM_NCCREATE) {
+        auto* create = reinterpret_cast<CREATESTRUCTW*>(lparam);
+        SetWindowLongPtrW(hwnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(create->lpCreateParams));
+    } else if (auto* self = reinterpret_cast<EventDispatcher*>(GetWindowLongPtrW(hwnd, GWLP_USERDATA))) {
+        if (auto result = self->handleMessage(hwnd, message, wparam, lparam)) {
+            return *result;
+        }
+    }
+    return DefWindowProcW(hwnd, message, wparam, lparam);
+}
+
+HWND EventDispatcher::createFallbackWindow() {
+    // The class lives in this plugin's module, not the executable
+    HMODULE module = nullptr;
+    GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                       reinterpret_cast<LPCWSTR>(&EventDispatcher::fallbackWindowProc), &module);
+
+    WNDCLASSEXW windowClass{};
+    windowClass.cbSize = sizeof(windowClass);
+    windowClass.lpfnWndProc = &EventDispatcher::fallbackWindowProc;
+    windowClass.hInstance = module;
+    windowClass.lpszClassName = kFallbackWindowClass;
+    if (RegisterClassExW(&windowClass) == 0 && GetLastError() != ERROR_CLASS_ALREADY_EXISTS) {
+        return nullptr;
+    }
+    // Created on the platform thread, so its messages are handled there
+    return CreateWindowExW(0, kFallbackWindowClass, L"", 0, 0, 0, 0, 0, HWND_MESSAGE, nullptr, module, this);
+}
+
+void EventDispatcher::postStage(const std::string& tunnel, const std::string& stage, uint64_t version) {
+    if (queue_.pushState(tunnel, stageFields(tunnel, stage), version)) {
+        wake();
+    }
+}
+
+void EventDispatcher::postEvent(const std::string& name, flutter::EncodableMap fields) {
+    fields[kEventKey] = flutter::EncodableValue(name);
+    if (queue_.pushEvent(std::move(fields))) {
+        wake();
+    }
+}
+
+void EventDispatcher::postTask(std::function<void()> task) {
+    std::lock_guard<std::mutex> lock(tasksMutex_);
+    tasks_.push_back(std::move(task));
+    // One message is enough for everything queued before it is handled
+    if (tasks_.size() == 1) {
+        wake();
+    }
+}
+
+void EventDispatcher::setSink(std::unique_ptr<flutter::EventSink<flutter::EncodableValue>> sink) {
+    sink_ = std::move(sink);
+    listening_ = sink_ != nullptr;
+
+    // Events still queued were produced after the last delivered stages, so
+    // replaying those first keeps the listener's view in order
+    if (!defaultTunnel_.empty() && lastStages_.count(defaultTunnel_) == 0) {
+        send(0, stageFields(defaultTunnel_, "disconnected"));
+    }
+    for (const auto& entry : lastStages_) {
+        send(entry.second.sequence, entry.second.fields);
+    }
+    dispatchPending();
+}
+
+void EventDispatcher::clearSink() {
+    sink_ = nullptr;
+    listening_ = false;
+}
+
+void EventDispatcher::setDefaultTunnel(const std::string& tunnel) {
+    defaultTunnel_ = tunnel;
+}
+
+std::optional<LRESULT> EventDispatcher::handleMessage(HWND, UINT message, WPARAM wparam, LPARAM) {
+    // Every dispatcher shares the message; the first delegate to answer
+    // stops the others, so only answer for this one
+    if (message != message_ || wparam != reinterpret_cast<WPARAM>(this)) {
+        return std::nullopt;
+    }
+    dispatchPending();
+    runTasks();
+    return 0;
+}
+
+void EventDispatcher::wake() {
+    if (window_ != nullptr) {
+        PostMessageW(window_, message_, reinterpret_cast<WPARAM>(this), 0);
+    }
+}
+
+void EventDispatcher::dispatchPending() {
+    queue_.drain(drained_);
+    for (const auto& entry : drained_) {
+        if (entry.isState) {
+            auto& last = lastStages_[entry.key];
+            if (entry.version < last.version) {
+                continue;
+            }
+            last.fields = entry.value;
+            last.sequence = entry.sequence;
+            last.version = entry.version;
+        }
+        send(entry.sequence, entry.value);
+    }
+    drained_.clear();
+}
+
+void EventDispatcher::runTasks() {
+    std::vector<std::function<void()>> tasks;
+    {
+        std::lock_guard<std::mutex> lock(tasksMutex_);
+        tasks.swap(tasks_);
+    }
+    for (auto& task : tasks) {
+        task();
+    }
+}
+
+void EventDispatcher::send(uint64_t sequence, const flutter::EncodableMap& fields) {
+    if (!sink_) {
+        return;
+    }
+    flutter::EncodableMap event = fields;
+    event[kSequenceKey] = flutter::EncodableValue(static_cast<int64_t>(sequence));
+    sink_->Success(flutter::EncodableValue(std::move(event)));
+}
+
+} // namespace wireguard_flutter
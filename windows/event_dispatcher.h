@@ -0,0 +1,101 @@
+#pragma once
+
+#include <windows.h>
+
+#include <flutter/encodable_value.h>
+#include <flutter/event_channel.h>
+#include <flutter/plugin_registrar_windows.h>
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "coalescing_queue.h"
+
+namespace wireguard_flutter {
+
+// Delivers stage changes and other events to the Dart event channel on the
+// platform thread.
+//
+// Any thread may post. Events are queued in a CoalescingQueue and the first
+// one into an empty queue posts a window message to the top-level Flutter
+// window; the registrar's window-proc delegate then drains the queue and
+// calls the sink. Without a Flutter window, e.g. in a headless engine, the
+// message goes to a hidden message-only window of the dispatcher's own
+// instead. Every event is sent as a map with "event" and "seq" keys;
+// stage changes are {"event": "stage", "tunnel": <name>, "stage": <code>,
+// "seq": n}. When Dart starts listening, the last delivered stage of every
+// tunnel is sent again straight away.
+//
+// The same message runs tasks posted from other threads, e.g. to complete
+// a method call whose answer was produced on the event loop.
+class EventDispatcher {
+public:
+    explicit EventDispatcher(flutter::PluginRegistrarWindows* registrar);
+    ~EventDispatcher();
+
+    EventDispatcher(const EventDispatcher&) = delete;
+    EventDispatcher& operator=(const EventDispatcher&) = delete;
+
+    // Thread-safe
+    // |version| orders stage changes of a tunnel posted from different
+    // threads; one older than the last delivered stage is dropped
+    void postStage(const std::string& tunnel, const std::string& stage, uint64_t version = 0);
+    void postEvent(const std::string& name, flutter::EncodableMap fields);
+    // Runs |task| on the platform thread; dropped if the dispatcher is
+    // destroyed first
+    void postTask(std::function<void()> task);
+
+    // Platform thread only
+    void setSink(std::unique_ptr<flutter::EventSink<flutter::EncodableValue>> sink);
+    void clearSink();
+    // Tunnel whose stage is replayed as "disconnected" before it has any
+    void setDefaultTunnel(const std::string& tunnel);
+
+    // Whether Dart listens to the event channel; thread-safe
+    bool hasListener() const { return listening_.load(std::memory_order_relaxed); }
+
+private:
+    using Queue = CoalescingQueue<flutter::EncodableMap, std::string>;
+
+    struct DeliveredStage {
+        flutter::EncodableMap fields;
+        uint64_t sequence = 0;
+        uint64_t version = 0;
+    };
+
+    static LRESULT CALLBACK fallbackWindowProc(HWND hwnd, UINT message, WPARAM wparam, LPARAM lparam);
+
+    std::optional<LRESULT> handleMessage(HWND hwnd, UINT message, WPARAM wparam, LPARAM lparam);
+    HWND createFallbackWindow();
+    void wake();
+    void dispatchPending();
+    void runTasks();
+    void send(uint64_t sequence, const flutter::EncodableMap& fields);
+
+    flutter::PluginRegistrarWindows* registrar_;
+    HWND window_ = nullptr;
+    // Owned message-only window when there is no Flutter window
+    HWND fallbackWindow_ = nullptr;
+    UINT message_ = 0;
+    int delegateId_ = -1;
+
+    Queue queue_;
+    std::vector<Queue::Entry> drained_;
+
+    std::mutex tasksMutex_;
+    std::vector<std::function<void()>> tasks_;
+
+    // Platform thread state
+    std::unique_ptr<flutter::EventSink<flutter::EncodableValue>> sink_;
+    std::atomic<bool> listening_{false};
+    std::map<std::string, DeliveredStage> lastStages_;
+    std::string defaultTunnel_;
+};
+
+} // namespace wireguard_flutter
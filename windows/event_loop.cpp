@@ -0,0 +1,469 @@
+#include "event_loop.h"
+
+#include <algorithm>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <cerrno>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#endif
+
+#include "logger.h"
+#include "trace_recorder.h"
+
+namespace wireguard_flutter {
+
+struct PolledWait {
+    EventLoop::TaskId id;
+    EventLoop::Waitable waitable;
+    bool writable;
+};
+using WaitList = std::vector<PolledWait>;
+
+// Blocks the loop thread until it is woken, the next timer is due or a wait
+// fires. Only the loop thread calls wait(); wake() may be called from any.
+class EventLoop::Poller {
+public:
+    ~Poller() { close(); }
+
+#ifdef _WIN32
+    bool open() {
+        if (!wakeEvent) {
+            wakeEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+        }
+        return wakeEvent != nullptr;
+    }
+
+    void close() {
+        if (wakeEvent) {
+            CloseHandle(wakeEvent);
+            wakeEvent = nullptr;
+        }
+    }
+
+    void wake() {
+        if (wakeEvent) {
+            SetEvent(wakeEvent);
+        }
+    }
+
+    void wait(Clock::time_point deadline, const WaitList& waits, std::vector<TaskId>& fired) {
+        HANDLE handles[kMaxWaits + 1];
+        DWORD count = 0;
+        handles[count++] = wakeEvent;
+        for (const auto& entry : waits) {
+            handles[count++] = static_cast<HANDLE>(entry.waitable);
+        }
+
+        // Compared before subtracting: a deadline of min(), for posted
+        // tasks, would overflow the difference
+        DWORD timeout = INFINITE;
+        auto now = Clock::now();
+        if (deadline <= now) {
+            timeout = 0;
+        } else if (deadline != Clock::time_point::max()) {
+            auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - now).count();
+            timeout = static_cast<DWORD>(std::min<long long>(remaining, INFINITE - 1));
+        }
+
+        // Reports the lowest signaled handle; any other is still signaled
+        // on the next pass
+        DWORD result = WaitForMultipleObjects(count, handles, FALSE, timeout);
+        if (result > WAIT_OBJECT_0 && result < WAIT_OBJECT_0 + count) {
+            fired.push_back(waits[result - WAIT_OBJECT_0 - 1].id);
+        } else if (result > WAIT_ABANDONED_0 && result < WAIT_ABANDONED_0 + count) {
+            fired.push_back(waits[result - WAIT_ABANDONED_0 - 1].id);
+        } else if (result == WAIT_FAILED) {
+            // A handle was closed under us; let its owner see it fire
+            for (const auto& entry : waits) {
+                if (WaitForSingleObject(static_cast<HANDLE>(entry.waitable), 0) != WAIT_TIMEOUT) {
+                    fired.push_back(entry.id);
+                }
+            }
+        }
+    }
+
+private:
+    HANDLE wakeEvent = nullptr;
+#else
+    bool open() {
+        if (epollFd >= 0) {
+            return true;
+        }
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (epollFd < 0 || wakeFd < 0 || timerFd < 0 || !watch(wakeFd, kWakeKey) || !watch(timerFd, kTimerKey)) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        for (int* fd : {&timerFd, &wakeFd, &epollFd}) {
+            if (*fd >= 0) {
+                ::close(*fd);
+                *fd = -1;
+            }
+        }
+        registered.clear();
+    }
+
+    void wake() {
+        if (wakeFd >= 0) {
+            uint64_t one = 1;
+            (void)!write(wakeFd, &one, sizeof(one));
+        }
+    }
+
+    void wait(Clock::time_point deadline, const WaitList& waits, std::vector<TaskId>& fired) {
+        syncWaits(waits);
+        armTimer(deadline);
+
+        epoll_event events[16];
+        int count = epoll_wait(epollFd, events, 16, -1);
+        for (int i = 0; i < count; i++) {
+            uint64_t key = events[i].data.u64;
+            uint64_t value;
+            if (key == kWakeKey) {
+                (void)!read(wakeFd, &value, sizeof(value));
+            } else if (key == kTimerKey) {
+                (void)!read(timerFd, &value, sizeof(value));
+            } else {
+                // Waits are one-shot
+                auto entry = registered.find(key);
+                if (entry != registered.end()) {
+                    epoll_ctl(epollFd, EPOLL_CTL_DEL, entry->second, nullptr);
+                    registered.erase(entry);
+                }
+                fired.push_back(key);
+            }
+        }
+    }
+
+private:
+    // Task ids start at 1
+    static constexpr uint64_t kWakeKey = 0;
+    static constexpr uint64_t kTimerKey = UINT64_MAX;
+
+    bool watch(int fd, uint64_t key, bool writable = false) {
+        epoll_event event{};
+        event.events = writable ? EPOLLOUT : EPOLLIN;
+        event.data.u64 = key;
+        return epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) == 0;
+    }
+
+    void syncWaits(const WaitList& waits) {
+        for (auto entry = registered.begin(); entry != registered.end();) {
+            bool wanted = std::any_of(waits.begin(), waits.end(),
+                                      [&](const PolledWait& wait) { return wait.id == entry->first; });
+            if (!wanted) {
+                epoll_ctl(epollFd, EPOLL_CTL_DEL, entry->second, nullptr);
+                entry = registered.erase(entry);
+            } else {
+                ++entry;
+            }
+        }
+        for (const auto& wait : waits) {
+            if (registered.count(wait.id) == 0 && watch(wait.waitable, wait.id, wait.writable)) {
+                registered[wait.id] = wait.waitable;
+            }
+        }
+    }
+
+    void armTimer(Clock::time_point deadline) {
+        itimerspec spec{};
+        if (deadline != Clock::time_point::max()) {
+            // steady_clock is CLOCK_MONOTONIC; a zero value would disarm, so
+            // min() for posted tasks and past deadlines fire at once
+            auto since = std::max(deadline.time_since_epoch(), Clock::duration(1));
+            auto seconds = std::chrono::duration_cast<std::chrono::seconds>(since);
+            spec.it_value.tv_sec = static_cast<time_t>(seconds.count());
+            spec.it_value.tv_nsec = static_cast<long>(std::chrono::duration_cast<std::chrono::nanoseconds>(since - seconds).count());
+        }
+        timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &spec, nullptr);
+    }
+
+    int epollFd = -1;
+    int wakeFd = -1;
+    int timerFd = -1;
+    std::map<TaskId, int> registered;
+#endif
+};
+
+EventLoop::EventLoop() : poller_(std::make_unique<Poller>()) {}
+
+EventLoop::~EventLoop() {
+    stop();
+}
+
+bool EventLoop::start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_) {
+        return true;
+    }
+    if (!poller_->open()) {
+        WG_LOG_ERROR("EventLoop: Failed to create poller");
+        return false;
+    }
+    running_ = true;
+    startedAt_ = Clock::now();
+    thread_ = std::thread(&EventLoop::run, this);
+    // run() takes the lock before reading this
+    threadId_ = thread_.get_id();
+    return true;
+}
+
+void EventLoop::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_ || stopping_) {
+            return;
+        }
+        stopping_ = true;
+    }
+    poller_->wake();
+    thread_.join();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+        stopping_ = false;
+        threadId_ = std::thread::id();
+        posted_.clear();
+    }
+    callbackDone_.notify_all();
+}
+
+bool EventLoop::isRunning() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return running_;
+}
+
+bool EventLoop::inLoopThread() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::this_thread::get_id() == threadId_;
+}
+
+void EventLoop::post(Callback callback) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        posted_.push_back(std::move(callback));
+    }
+    poller_->wake();
+}
+
+EventLoop::TaskId EventLoop::addTimer(std::chrono::milliseconds delay, Callback callback) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    TaskId id = nextId_++;
+    Clock::time_point deadline = Clock::now() + delay;
+    timers_[id] = Timer{std::move(callback), Clock::duration::zero(), deadline};
+    wheel_.add(id, deadline);
+
+    // The loop thread picks up the new expiry before it sleeps again
+    bool wake = std::this_thread::get_id() != threadId_;
+    lock.unlock();
+    if (wake) {
+        poller_->wake();
+    }
+    return id;
+}
+
+EventLoop::TaskId EventLoop::addRepeatingTimer(std::chrono::milliseconds interval, Callback callback) {
+    interval = std::max(interval, std::chrono::milliseconds(1));
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    TaskId id = nextId_++;
+    Clock::time_point deadline = Clock::now() + interval;
+    timers_[id] = Timer{std::move(callback), interval, deadline};
+    wheel_.add(id, deadline);
+
+    bool wake = std::this_thread::get_id() != threadId_;
+    lock.unlock();
+    if (wake) {
+        poller_->wake();
+    }
+    return id;
+}
+
+EventLoop::TaskId EventLoop::addWait(Waitable waitable, Callback callback) {
+    return addWait(waitable, std::move(callback), false);
+}
+
+EventLoop::TaskId EventLoop::addWriteWait(Waitable waitable, Callback callback) {
+    return addWait(waitable, std::move(callback), true);
+}
+
+EventLoop::TaskId EventLoop::addWait(Waitable waitable, Callback callback, bool writable) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (waits_.size() >= kMaxWaits) {
+        WG_LOG_ERROR("EventLoop: Too many waits");
+        return 0;
+    }
+    TaskId id = nextId_++;
+    waits_[id] = Wait{waitable, std::move(callback), writable};
+
+    bool wake = std::this_thread::get_id() != threadId_;
+    lock.unlock();
+    if (wake) {
+        poller_->wake();
+    }
+    return id;
+}
+
+void EventLoop::cancel(TaskId id) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    bool wasWait = waits_.erase(id) != 0;
+    if (timers_.erase(id) != 0) {
+        wheel_.remove(id);
+    }
+
+    if (!running_ || std::this_thread::get_id() == threadId_) {
+        return;
+    }
+
+    // The loop may still be blocked on the handle; wait until it has polled
+    // again without it, so the caller can close it
+    uint64_t wakeupsBefore = wakeups_;
+    if (wasWait) {
+        lock.unlock();
+        poller_->wake();
+        lock.lock();
+    }
+    callbackDone_.wait(lock, [&] {
+        return !running_ || (runningId_ != id && (!wasWait || wakeups_ > wakeupsBefore));
+    });
+}
+
+uint64_t EventLoop::wakeups() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return wakeups_;
+}
+
+EventLoop::Clock::duration EventLoop::uptime() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return running_ ? Clock::now() - startedAt_ : Clock::duration::zero();
+}
+
+void EventLoop::run() {
+    TraceRecorder::nameThread("event loop");
+    WaitList waitList;
+    std::vector<TaskId> fired;
+    std::vector<Callback> posted;
+
+    for (;;) {
+        Clock::time_point deadline;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_) {
+                break;
+            }
+            deadline = posted_.empty() ? wheel_.nextExpiry() : Clock::time_point::min();
+            waitList.clear();
+            for (const auto& entry : waits_) {
+                waitList.push_back(PolledWait{entry.first, entry.second.waitable, entry.second.writable});
+            }
+        }
+
+        fired.clear();
+        poller_->wait(deadline, waitList, fired);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            wakeups_++;
+            if (stopping_) {
+                break;
+            }
+            posted.swap(posted_);
+        }
+        // Lets cancel() of a wait return now that the poll has ended
+        callbackDone_.notify_all();
+
+        for (auto& task : posted) {
+            task();
+        }
+        posted.clear();
+
+        for (TaskId id : fired) {
+            Callback callback;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto wait = waits_.find(id);
+                if (wait == waits_.end()) {
+                    continue;
+                }
+                callback = std::move(wait->second.callback);
+                waits_.erase(wait);
+                runningId_ = id;
+            }
+            runCallback(id, callback);
+        }
+
+        runTimers();
+    }
+}
+
+void EventLoop::runTimers() {
+    std::vector<TaskId> expired;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        wheel_.advance(Clock::now(), expired);
+    }
+
+    for (TaskId id : expired) {
+        Callback callback;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto timer = timers_.find(id);
+            if (timer == timers_.end()) {
+                continue;
+            }
+            // Moved out so a callback that cancels itself does not destroy
+            // the function it is running
+            callback = std::move(timer->second.callback);
+            runningId_ = id;
+        }
+        runCallback(id, callback);
+    }
+}
+
+void EventLoop::runCallback(TaskId id, Callback& callback) {
+    if (callback) {
+        callback();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        runningId_ = 0;
+
+        auto timer = timers_.find(id);
+        if (timer != timers_.end()) {
+            if (timer->second.interval == Clock::duration::zero()) {
+                timers_.erase(timer);
+            } else {
+                // Keep the phase; skip periods the callback overran
+                auto interval = timer->second.interval;
+                auto now = Clock::now();
+                auto next = timer->second.deadline + interval;
+                if (next <= now) {
+                    next += interval * ((now - next) / interval + 1);
+                }
+                timer->second.deadline = next;
+                timer->second.callback = std::move(callback);
+                wheel_.add(id, next);
+            }
+        }
+    }
+    callbackDone_.notify_all();
+}
+
+} // namespace wireguard_flutter
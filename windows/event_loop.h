@@ -0,0 +1,122 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "timer_wheel.h"
+
+namespace wireguard_flutter {
+
+// Single reactor thread that runs every timer, deadline and notification of
+// a plugin instance.
+//
+// Components register callbacks instead of owning threads. One loop
+// iteration runs posted tasks first, then waits whose handle was signaled,
+// then timers in deadline order, so callbacks never overlap and their order
+// is deterministic. Timers live in a TimerWheel; the thread sleeps until the
+// next expiry or a signaled handle, never on a fixed cadence.
+//
+// Waitables are kernel handles on Windows (WaitForMultipleObjects, at most
+// kMaxWaits) and file descriptors elsewhere (epoll, with a timerfd for the
+// next expiry).
+class EventLoop {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Callback = std::function<void()>;
+    using TaskId = uint64_t;
+#ifdef _WIN32
+    using Waitable = void*;
+#else
+    using Waitable = int;
+#endif
+
+    static constexpr size_t kMaxWaits = 62;
+
+    EventLoop();
+    ~EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    // Starts the loop thread. stop() must not be called from a callback.
+    bool start();
+    void stop();
+    bool isRunning() const;
+    bool inLoopThread() const;
+
+    // Everything below is thread-safe.
+
+    // Runs |callback| on the loop thread as soon as possible.
+    void post(Callback callback);
+
+    // Runs |callback| once after |delay|, or every |interval|. Repeating
+    // timers keep their phase; missed periods are skipped, not replayed.
+    TaskId addTimer(std::chrono::milliseconds delay, Callback callback);
+    TaskId addRepeatingTimer(std::chrono::milliseconds interval, Callback callback);
+
+    // Runs |callback| once when |waitable| is signaled (Windows) or readable.
+    // Returns 0 when too many waits are registered.
+    TaskId addWait(Waitable waitable, Callback callback);
+    // The same for writable; on Windows a handle is signaled for whatever
+    // its owner selected, so this is addWait. A descriptor has one wait at
+    // a time.
+    TaskId addWriteWait(Waitable waitable, Callback callback);
+
+    // Cancels a timer or wait. When its callback is running on the loop
+    // thread and this is called from another thread, blocks until it returns,
+    // so the caller may free whatever the callback uses.
+    void cancel(TaskId id);
+
+    // Number of times the loop thread woke up
+    uint64_t wakeups() const;
+    // Time since start(); zero when not running
+    Clock::duration uptime() const;
+
+private:
+    struct Timer {
+        Callback callback;
+        Clock::duration interval{};
+        Clock::time_point deadline;
+    };
+
+    struct Wait {
+        Waitable waitable;
+        Callback callback;
+        bool writable = false;
+    };
+
+    class Poller;
+
+    void run();
+    void runTimers();
+    void runCallback(TaskId id, Callback& callback);
+    TaskId addWait(Waitable waitable, Callback callback, bool writable);
+
+    std::unique_ptr<Poller> poller_;
+    std::thread thread_;
+    std::thread::id threadId_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable callbackDone_;
+    bool running_ = false;
+    bool stopping_ = false;
+    TaskId nextId_ = 1;
+    TaskId runningId_ = 0;
+    uint64_t wakeups_ = 0;
+    Clock::time_point startedAt_;
+
+    std::vector<Callback> posted_;
+    TimerWheel wheel_;
+    std::map<TaskId, Timer> timers_;
+    std::map<TaskId, Wait> waits_;
+};
+
+} // namespace wireguard_flutter
@@ -0,0 +1,96 @@
+#ifndef FLUTTER_PLUGIN_WIREGUARD_FLUTTER_STATS_C_API_H_
+#define FLUTTER_PLUGIN_WIREGUARD_FLUTTER_STATS_C_API_H_
+
+#include <stdint.h>
+
+#ifndef FLUTTER_PLUGIN_EXPORT
+#if defined(_WIN32)
+#ifdef FLUTTER_PLUGIN_IMPL
+#define FLUTTER_PLUGIN_EXPORT __declspec(dllexport)
+#else
+#define FLUTTER_PLUGIN_EXPORT __declspec(dllimport)
+#endif
+#else
+#define FLUTTER_PLUGIN_EXPORT __attribute__((visibility("default")))
+#endif
+#endif
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#define WIREGUARD_FLUTTER_STATS_BLOCK_VERSION 3
+
+// Tunnel state as published in the counter block.
+typedef enum {
+  WIREGUARD_FLUTTER_STATE_DISCONNECTED = 0,
+  WIREGUARD_FLUTTER_STATE_CONNECTING = 1,
+  WIREGUARD_FLUTTER_STATE_CONNECTED = 2,
+  WIREGUARD_FLUTTER_STATE_ERROR = 3,
+  WIREGUARD_FLUTTER_STATE_DISCONNECTING = 4,
+  WIREGUARD_FLUTTER_STATE_RECONNECTING = 5,
+  WIREGUARD_FLUTTER_STATE_DEGRADED = 6,
+} WireguardFlutterTunnelState;
+
+// Counter block updated in place by the native sampler and read over
+// dart:ffi without any platform-channel message.
+//
+// Readers use the seqlock protocol: read |sequence|, skip while it is odd,
+// copy the fields, then re-read |sequence| and retry if it changed. The
+// layout is fixed; new fields bump |version|. Version 3 took the last
+// reserved fields, so later ones extend the block by a whole cache line.
+typedef struct WireguardFlutterStatsBlock {
+  uint32_t sequence;
+  uint32_t version;
+  int32_t state;
+  uint32_t reserved0;
+  int64_t bytes_in;
+  int64_t bytes_out;
+  int64_t speed_in_bps;
+  int64_t speed_out_bps;
+  int64_t smoothed_in_bps;
+  int64_t smoothed_out_bps;
+  // Milliseconds since the last completed handshake, -1 before the first.
+  int64_t handshake_age_ms;
+  // Monotonic timestamp of the last update, in milliseconds.
+  int64_t updated_at_ms;
+  // Added in version 2.
+  int64_t packets_in_per_sec;
+  int64_t packets_out_per_sec;
+  int64_t drop_ratio_ppm;
+  // Added in version 3: round trips of the background probe through the
+  // tunnel, in microseconds, 0 until it has been answered
+  int64_t rtt_p50_us;
+  int64_t rtt_jitter_us;
+  int64_t rtt_loss_ppm;
+} WireguardFlutterStatsBlock;
+
+// Returns the counter block of the first tunnel. The pointer stays valid for
+// the lifetime of the plugin library and is aligned to a cache line.
+FLUTTER_PLUGIN_EXPORT const WireguardFlutterStatsBlock *WireguardFlutterGetStatsBlock(void);
+
+// Returns the counter block at |index|, as reported for each tunnel by the
+// getTunnels method, or NULL when |index| is out of range. Index 0 is the
+// block WireguardFlutterGetStatsBlock returns.
+FLUTTER_PLUGIN_EXPORT const WireguardFlutterStatsBlock *WireguardFlutterGetStatsBlockAt(uint32_t index);
+
+// Copies a consistent snapshot of the block into |out|. Returns 0 on
+// success, -1 if |out| is null.
+FLUTTER_PLUGIN_EXPORT int32_t WireguardFlutterReadStats(WireguardFlutterStatsBlock *out);
+
+// Copies a consistent snapshot of the block at |index| into |out|, retrying
+// the seqlock natively so callers never load the shared fields themselves.
+// Returns 0 on success, -1 if |out| is null or |index| is out of range.
+FLUTTER_PLUGIN_EXPORT int32_t WireguardFlutterReadStatsAt(uint32_t index, WireguardFlutterStatsBlock *out);
+
+// Registers a reader that polls the blocks. Samples are only published
+// while someone consumes them, so a reader should register when it starts
+// polling and call WireguardFlutterRemoveStatsReader when it stops.
+FLUTTER_PLUGIN_EXPORT void WireguardFlutterAddStatsReader(void);
+FLUTTER_PLUGIN_EXPORT void WireguardFlutterRemoveStatsReader(void);
+
+#if defined(__cplusplus)
+}  // extern "C"
+#endif
+
+#endif  // FLUTTER_PLUGIN_WIREGUARD_FLUTTER_STATS_C_API_H_
@@ -0,0 +1,41 @@
+#include "instrumented_method_result.h"
+
+#include "trace_recorder.h"
+
+namespace wireguard_flutter {
+
+InstrumentedMethodResult::InstrumentedMethodResult(
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result, MethodMetrics::Method& method)
+    : result_(std::move(result)), method_(method), started_(std::chrono::steady_clock::now()) {
+    method_.calls.fetch_add(1, std::memory_order_relaxed);
+}
+
+void InstrumentedMethodResult::SuccessInternal(const flutter::EncodableValue* result) {
+    result_->Success(result ? *result : flutter::EncodableValue());
+    record(false);
+}
+
+void InstrumentedMethodResult::ErrorInternal(const std::string& error_code, const std::string& error_message,
+                                             const flutter::EncodableValue* error_details) {
+    result_->Error(error_code, error_message, error_details ? *error_details : flutter::EncodableValue());
+    record(true);
+}
+
+void InstrumentedMethodResult::NotImplementedInternal() {
+    result_->NotImplemented();
+    record(true);
+}
+
+void InstrumentedMethodResult::record(bool failed) {
+    // Includes encoding and sending the reply
+    auto elapsed = std::chrono::steady_clock::now() - started_;
+    auto elapsedUs = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    method_.latencyUs.record(elapsedUs);
+    TraceRecorder::instance().complete("method", method_.name.c_str(), TraceRecorder::timestampUs(started_),
+                                       elapsedUs, {}, "failed", failed ? 1 : 0);
+    if (failed) {
+        method_.errors.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+} // namespace wireguard_flutter
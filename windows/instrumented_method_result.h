@@ -0,0 +1,36 @@
+#pragma once
+
+#include <flutter/encodable_value.h>
+#include <flutter/method_result.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include "method_metrics.h"
+
+namespace wireguard_flutter {
+
+// Forwards to the wrapped result and records the call in MethodMetrics:
+// the call when created, the latency from then until Success, Error or
+// NotImplemented returns, and an error for the latter two.
+class InstrumentedMethodResult : public flutter::MethodResult<flutter::EncodableValue> {
+public:
+    InstrumentedMethodResult(std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result,
+                             MethodMetrics::Method& method);
+
+protected:
+    void SuccessInternal(const flutter::EncodableValue* result) override;
+    void ErrorInternal(const std::string& error_code, const std::string& error_message,
+                       const flutter::EncodableValue* error_details) override;
+    void NotImplementedInternal() override;
+
+private:
+    void record(bool failed);
+
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result_;
+    MethodMetrics::Method& method_;
+    std::chrono::steady_clock::time_point started_;
+};
+
+} // namespace wireguard_flutter
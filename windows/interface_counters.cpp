@@ -0,0 +1,57 @@
+#include "interface_counters.h"
+
+namespace wireguard_flutter {
+
+namespace {
+
+// A counter that went backwards was reset along with the adapter
+uint64_t delta(uint64_t current, uint64_t last) {
+    return current >= last ? current - last : current;
+}
+
+} // namespace
+
+void InterfaceCounterTracker::reset() {
+    hasBaseline_ = false;
+    last_ = InterfaceCounters{};
+    lastTime_ = Clock::time_point{};
+    metrics_ = IntervalMetrics{};
+}
+
+bool InterfaceCounterTracker::addSample(const InterfaceCounters& counters, Clock::time_point now) {
+    if (!hasBaseline_) {
+        hasBaseline_ = true;
+        last_ = counters;
+        lastTime_ = now;
+        return false;
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - lastTime_);
+    if (elapsed.count() <= 0) {
+        return false;
+    }
+    double seconds = elapsed.count() / 1e6;
+
+    uint64_t octetsIn = delta(counters.octetsIn, last_.octetsIn);
+    uint64_t octetsOut = delta(counters.octetsOut, last_.octetsOut);
+    uint64_t packetsIn = delta(counters.packetsIn, last_.packetsIn);
+    uint64_t packetsOut = delta(counters.packetsOut, last_.packetsOut);
+    uint64_t dropped = delta(counters.discardsIn, last_.discardsIn) +
+                       delta(counters.discardsOut, last_.discardsOut) +
+                       delta(counters.errorsIn, last_.errorsIn) +
+                       delta(counters.errorsOut, last_.errorsOut);
+
+    metrics_.packetsInPerSec = static_cast<uint64_t>(packetsIn / seconds);
+    metrics_.packetsOutPerSec = static_cast<uint64_t>(packetsOut / seconds);
+    metrics_.avgPacketSizeIn = packetsIn ? octetsIn / packetsIn : 0;
+    metrics_.avgPacketSizeOut = packetsOut ? octetsOut / packetsOut : 0;
+
+    uint64_t handled = packetsIn + packetsOut + dropped;
+    metrics_.dropRatioPpm = handled ? dropped * 1000000 / handled : 0;
+
+    last_ = counters;
+    lastTime_ = now;
+    return true;
+}
+
+} // namespace wireguard_flutter
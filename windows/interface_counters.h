@@ -0,0 +1,51 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace wireguard_flutter {
+
+// Raw interface counters as reported by GetIfEntry2.
+struct InterfaceCounters {
+    uint64_t octetsIn = 0;
+    uint64_t octetsOut = 0;
+    uint64_t packetsIn = 0;
+    uint64_t packetsOut = 0;
+    uint64_t errorsIn = 0;
+    uint64_t errorsOut = 0;
+    uint64_t discardsIn = 0;
+    uint64_t discardsOut = 0;
+};
+
+// Values derived from the change between two consecutive samples.
+struct IntervalMetrics {
+    uint64_t packetsInPerSec = 0;
+    uint64_t packetsOutPerSec = 0;
+    uint64_t avgPacketSizeIn = 0;
+    uint64_t avgPacketSizeOut = 0;
+    // Discarded and errored packets over everything the interface handled in
+    // the interval, in parts per million
+    uint64_t dropRatioPpm = 0;
+};
+
+// Derives per-interval packet rate, average packet size and drop ratio from
+// successive counter samples. Portable; no Windows dependencies.
+class InterfaceCounterTracker {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    void reset();
+
+    // Returns true when the sample closed an interval and metrics() changed.
+    bool addSample(const InterfaceCounters& counters, Clock::time_point now);
+
+    const IntervalMetrics& metrics() const { return metrics_; }
+
+private:
+    bool hasBaseline_ = false;
+    InterfaceCounters last_;
+    Clock::time_point lastTime_;
+    IntervalMetrics metrics_;
+};
+
+} // namespace wireguard_flutter
@@ -0,0 +1,171 @@
+#include "keepalive_tuner.h"
+
+#include <algorithm>
+
+namespace wireguard_flutter {
+
+const char* KeepaliveTuner::reasonName(Reason reason) {
+    switch (reason) {
+    case Reason::Explore:
+        return "explore";
+    case Reason::Learned:
+        return "learned";
+    case Reason::Loss:
+        return "loss";
+    case Reason::Reset:
+        return "reset";
+    }
+    return "unknown";
+}
+
+KeepaliveTuner::KeepaliveTuner() : KeepaliveTuner(Options()) {}
+
+KeepaliveTuner::KeepaliveTuner(const Options& options) {
+    configure(options);
+}
+
+void KeepaliveTuner::configure(const Options& options) {
+    options_ = options;
+    options_.confirmations = std::max<uint32_t>(options_.confirmations, 1);
+    options_.growth = std::max(options_.growth, 1.0);
+    keepalive_ = clamp(options_.initial);
+    lower_ = std::chrono::milliseconds(0);
+    upper_ = std::chrono::milliseconds(0);
+    confirmed_ = 0;
+    losses_ = 0;
+    holding_ = false;
+    haveSample_ = false;
+    resumed_ = false;
+}
+
+std::optional<KeepaliveTuner::Change> KeepaliveTuner::addSample(const Sample& sample) {
+    if (!haveSample_ || sample.bytesIn < bytesIn_ || sample.bytesOut < bytesOut_) {
+        // The first sample, or a recreated adapter
+        haveSample_ = true;
+        bytesIn_ = sample.bytesIn;
+        bytesOut_ = sample.bytesOut;
+        lastActivity_ = sample.at;
+        resumed_ = false;
+        return std::nullopt;
+    }
+    bool received = sample.bytesIn > bytesIn_;
+    bool sent = sample.bytesOut >= bytesOut_ + options_.minBytes;
+    bytesIn_ = sample.bytesIn;
+    bytesOut_ = sample.bytesOut;
+
+    std::optional<Change> change;
+    if (resumed_) {
+        auto waited = sample.at - resumedAt_;
+        if (received) {
+            resumed_ = false;
+            bool rehandshaken = sample.handshakeAgeMs >= 0 &&
+                                sample.at - std::chrono::milliseconds(sample.handshakeAgeMs) > resumedAt_;
+            if (waited <= options_.replyWindow) {
+                change = onSurvived(exposure_, sample.at);
+            } else if (rehandshaken) {
+                change = onLost(exposure_, sample.at);
+            }
+            // A late answer without a handshake is a slow peer, not the NAT
+        } else if (waited > options_.verdictWindow) {
+            resumed_ = false;
+        }
+    } else if (sent || received) {
+        auto quiet = std::chrono::duration_cast<std::chrono::milliseconds>(sample.at - lastActivity_);
+        if (quiet >= options_.floor) {
+            exposure_ = std::min(quiet, std::chrono::milliseconds(keepalive_));
+            if (received) {
+                change = onSurvived(exposure_, sample.at);
+            } else {
+                resumed_ = true;
+                resumedAt_ = sample.at;
+            }
+        }
+    }
+    if (sent || received) {
+        lastActivity_ = sample.at;
+    }
+    return change;
+}
+
+std::optional<KeepaliveTuner::Change> KeepaliveTuner::onNetworkChange() {
+    // Another NAT, or none
+    lower_ = std::chrono::milliseconds(0);
+    upper_ = std::chrono::milliseconds(0);
+    confirmed_ = 0;
+    losses_ = 0;
+    holding_ = false;
+    resumed_ = false;
+    return moveTo(clamp(options_.initial), Reason::Reset);
+}
+
+std::optional<KeepaliveTuner::Change> KeepaliveTuner::onSurvived(std::chrono::milliseconds exposure,
+                                                                 Clock::time_point at) {
+    lower_ = std::max(lower_, exposure);
+    if (upper_.count() > 0 && lower_ >= upper_) {
+        // Bindings last longer than they did; learn the new timeout
+        upper_ = std::chrono::milliseconds(0);
+    }
+    losses_ = 0;
+    if (holding_) {
+        if (at - lostAt_ < options_.holdAfterLoss) {
+            return std::nullopt;
+        }
+        holding_ = false;
+    }
+    if (upper_.count() > 0) {
+        return moveTo(target(), Reason::Learned);
+    }
+
+    // Only stretches as long as the interval test it
+    if (exposure < keepalive_ || ++confirmed_ < options_.confirmations) {
+        return std::nullopt;
+    }
+    confirmed_ = 0;
+    auto longer = std::chrono::seconds(static_cast<int64_t>(static_cast<double>(keepalive_.count()) * options_.growth));
+    return moveTo(clamp(std::max(longer, keepalive_ + std::chrono::seconds(1))), Reason::Explore);
+}
+
+std::optional<KeepaliveTuner::Change> KeepaliveTuner::onLost(std::chrono::milliseconds exposure,
+                                                             Clock::time_point at) {
+    upper_ = upper_.count() > 0 ? std::min(upper_, exposure) : exposure;
+    if (lower_ >= upper_) {
+        lower_ = std::chrono::milliseconds(0);
+    }
+    confirmed_ = 0;
+    losses_++;
+    holding_ = true;
+    lostAt_ = at;
+
+    // Reported even when the interval stays, e.g. already at the floor
+    keepalive_ = losses_ > 1 ? clamp(options_.floor) : clamp(std::min(options_.initial, target()));
+    Change change;
+    change.keepalive = keepalive_;
+    change.reason = Reason::Loss;
+    return change;
+}
+
+std::chrono::seconds KeepaliveTuner::target() const {
+    if (upper_.count() == 0) {
+        return keepalive_;
+    }
+    auto under = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::milliseconds(static_cast<int64_t>(static_cast<double>(upper_.count()) * options_.margin)));
+    return clamp(std::max(under, std::chrono::duration_cast<std::chrono::seconds>(lower_)));
+}
+
+std::chrono::seconds KeepaliveTuner::clamp(std::chrono::seconds value) const {
+    return std::clamp(value, options_.floor, std::max(options_.floor, options_.ceiling));
+}
+
+std::optional<KeepaliveTuner::Change> KeepaliveTuner::moveTo(std::chrono::seconds value, Reason reason) {
+    if (value == keepalive_) {
+        return std::nullopt;
+    }
+    keepalive_ = value;
+    Change change;
+    change.keepalive = value;
+    change.reason = reason;
+    return change;
+}
+
+} // namespace wireguard_flutter
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+namespace wireguard_flutter {
+
+// Learns how long the NAT in front of a tunnel keeps an idle UDP binding and
+// picks the persistent keepalive just under it, so idle tunnels send as
+// little as possible without losing the binding.
+//
+// Evidence comes from quiet stretches of the tunnel's own traffic. The NAT
+// went without an outgoing packet for the stretch, or for the keepalive
+// interval when that is shorter; call that the exposure. When traffic
+// resumes and is answered within replyWindow, the binding outlived the
+// exposure. When it stays unanswered until a new handshake completes, the
+// binding died before it. Traffic arriving unasked after a quiet stretch
+// also shows the binding alive. Stretches shorter than the floor are not
+// evidence; keepalives are not counted by the adapter, so they do not end
+// a stretch.
+//
+// Until a binding is lost, the keepalive grows by |growth| after
+// |confirmations| stretches survived at the current interval. Once one is
+// lost, the timeout lies between the longest exposure survived and the
+// shortest lost, and the keepalive settles at margin times the latter, but
+// not under the former. Right after a loss the keepalive falls back to
+// |initial| or lower for holdAfterLoss, and to the floor when losses repeat.
+// A network change forgets what was learned.
+//
+// Times come from the samples, never from a clock read here. Not
+// thread-safe; the monitor tick drives it. Portable.
+class KeepaliveTuner {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Reason : uint8_t {
+        // Stretches survived at the current interval; trying a longer one
+        Explore,
+        // Settled under the learned timeout
+        Learned,
+        // A binding was lost; falling back
+        Loss,
+        // Back to the initial interval after a network change
+        Reset,
+    };
+
+    struct Options {
+        std::chrono::seconds floor{15};
+        std::chrono::seconds ceiling{120};
+        // Used before anything is learned; the config's own value if it has one
+        std::chrono::seconds initial{25};
+        double margin = 0.8;
+        double growth = 1.5;
+        uint32_t confirmations = 3;
+        // Resumed traffic answered this soon went through a live binding
+        std::chrono::milliseconds replyWindow{5000};
+        // Resumed traffic unanswered this long gives no verdict at all;
+        // WireGuard retries a handshake 15 s after an unanswered packet
+        std::chrono::milliseconds verdictWindow{30000};
+        std::chrono::milliseconds holdAfterLoss{600000};
+        // Less than this going out is not traffic resuming
+        uint64_t minBytes = 60;
+    };
+
+    struct Sample {
+        Clock::time_point at;
+        uint64_t bytesIn = 0;
+        uint64_t bytesOut = 0;
+        // -1 when no handshake has completed
+        int64_t handshakeAgeMs = -1;
+    };
+
+    struct Change {
+        std::chrono::seconds keepalive{0};
+        Reason reason = Reason::Explore;
+    };
+
+    // Reason code sent to Dart
+    static const char* reasonName(Reason reason);
+
+    KeepaliveTuner();
+    explicit KeepaliveTuner(const Options& options);
+
+    // Starts over with |options|
+    void configure(const Options& options);
+    const Options& options() const { return options_; }
+
+    std::chrono::seconds keepalive() const { return keepalive_; }
+    // Longest exposure survived and shortest lost; zero while unknown
+    std::chrono::milliseconds survived() const { return lower_; }
+    std::chrono::milliseconds lost() const { return upper_; }
+
+    // Returns a change of the keepalive to apply, and every loss
+    std::optional<Change> addSample(const Sample& sample);
+    // Forgets the bounds; a change when the keepalive was not the initial one
+    std::optional<Change> onNetworkChange();
+
+private:
+    std::optional<Change> onSurvived(std::chrono::milliseconds exposure, Clock::time_point at);
+    std::optional<Change> onLost(std::chrono::milliseconds exposure, Clock::time_point at);
+    // Under the learned timeout, or the current interval while none is known
+    std::chrono::seconds target() const;
+    std::chrono::seconds clamp(std::chrono::seconds value) const;
+    std::optional<Change> moveTo(std::chrono::seconds value, Reason reason);
+
+    Options options_;
+    std::chrono::seconds keepalive_{0};
+    std::chrono::milliseconds lower_{0};
+    std::chrono::milliseconds upper_{0};
+    uint32_t confirmed_ = 0;
+    uint32_t losses_ = 0;
+    bool holding_ = false;
+    Clock::time_point lostAt_;
+
+    bool haveSample_ = false;
+    uint64_t bytesIn_ = 0;
+    uint64_t bytesOut_ = 0;
+    Clock::time_point lastActivity_;
+    // Traffic resumed after a quiet stretch and waits for an answer
+    bool resumed_ = false;
+    Clock::time_point resumedAt_;
+    std::chrono::milliseconds exposure_{0};
+};
+
+} // namespace wireguard_flutter
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace wireguard_flutter {
+
+// Latency histogram with log-linear buckets, in whatever unit the caller
+// records.
+//
+// Values below 8 get a bucket each; above that every power of two is split
+// into 8 buckets, so a percentile is off by at most 12.5%. Values of
+// 2^MaxExponent and more land in an overflow bucket. Fixed size and
+// trivially copyable, so it can be persisted as is. Not thread-safe; see
+// AtomicLatencyHistogram for a concurrent recorder.
+template <uint32_t MaxExponent>
+class BasicLatencyHistogram {
+public:
+    static_assert(MaxExponent > 3 && MaxExponent < 62, "unsupported range");
+
+    static constexpr uint32_t kSubBuckets = 8;
+    static constexpr size_t kBucketCount = kSubBuckets + (MaxExponent - 3) * kSubBuckets + 1;
+
+    using Buckets = std::array<uint64_t, kBucketCount>;
+
+    void record(int64_t value) {
+        value = std::max<int64_t>(value, 0);
+        buckets_[bucketIndex(value)]++;
+        count_++;
+        sum_ += value;
+        max_ = std::max(max_, value);
+    }
+
+    void merge(const BasicLatencyHistogram& other) {
+        for (size_t i = 0; i < kBucketCount; i++) {
+            buckets_[i] += other.buckets_[i];
+        }
+        count_ += other.count_;
+        sum_ += other.sum_;
+        max_ = std::max(max_, other.max_);
+    }
+
+    void clear() { *this = BasicLatencyHistogram(); }
+
+    uint64_t count() const { return count_; }
+    int64_t max() const { return max_; }
+    int64_t sum() const { return sum_; }
+    int64_t mean() const { return count_ > 0 ? sum_ / static_cast<int64_t>(count_) : 0; }
+
+    // Upper bound of the bucket holding the |percentile|th value (0-100), or
+    // 0 when empty. Never above the largest value recorded.
+    int64_t percentile(double percentile) const {
+        if (count_ == 0) {
+            return 0;
+        }
+        percentile = std::clamp(percentile, 0.0, 100.0);
+        auto rank = static_cast<uint64_t>(std::ceil(percentile / 100.0 * static_cast<double>(count_)));
+        rank = std::max<uint64_t>(rank, 1);
+
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kBucketCount; i++) {
+            seen += buckets_[i];
+            if (seen >= rank) {
+                return std::min(bucketUpperBound(i), max_);
+            }
+        }
+        return max_;
+    }
+
+    const Buckets& buckets() const { return buckets_; }
+
+    // Rebuilds a histogram from persisted or sampled buckets and totals
+    void restore(const Buckets& buckets, int64_t sum, int64_t max) {
+        buckets_ = buckets;
+        count_ = 0;
+        for (uint64_t bucket : buckets_) {
+            count_ += bucket;
+        }
+        sum_ = sum;
+        max_ = max;
+    }
+
+    static size_t bucketIndex(int64_t value) {
+        if (value < static_cast<int64_t>(kSubBuckets)) {
+            return value < 0 ? 0 : static_cast<size_t>(value);
+        }
+        auto bits = static_cast<uint64_t>(value);
+        uint32_t exponent = 0;
+        while (bits >>= 1) {
+            exponent++;
+        }
+        if (exponent >= MaxExponent) {
+            return kBucketCount - 1;
+        }
+        // The three bits below the leading one pick the sub-bucket
+        auto sub = static_cast<uint32_t>(static_cast<uint64_t>(value) >> (exponent - 3)) & (kSubBuckets - 1);
+        return kSubBuckets + (exponent - 3) * kSubBuckets + sub;
+    }
+
+    static int64_t bucketUpperBound(size_t index) {
+        if (index < kSubBuckets) {
+            return static_cast<int64_t>(index);
+        }
+        if (index >= kBucketCount - 1) {
+            return std::numeric_limits<int64_t>::max();
+        }
+        size_t offset = index - kSubBuckets;
+        auto shift = static_cast<uint32_t>(offset / kSubBuckets);
+        uint64_t lower = (kSubBuckets + offset % kSubBuckets) << shift;
+        return static_cast<int64_t>(lower + (uint64_t{1} << shift) - 1);
+    }
+
+private:
+    Buckets buckets_{};
+    uint64_t count_ = 0;
+    int64_t sum_ = 0;
+    int64_t max_ = 0;
+};
+
+// Concurrent recorder with the same buckets. Recording is a few relaxed
+// atomic adds, with no locks or allocation, so it can stay on in production.
+// A snapshot taken during recording may be off by the samples in flight;
+// its count is always the sum of its buckets.
+template <uint32_t MaxExponent>
+class AtomicLatencyHistogram {
+public:
+    using Snapshot = BasicLatencyHistogram<MaxExponent>;
+
+    void record(int64_t value) {
+        value = std::max<int64_t>(value, 0);
+        buckets_[Snapshot::bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(value, std::memory_order_relaxed);
+        int64_t current = max_.load(std::memory_order_relaxed);
+        while (value > current && !max_.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    void snapshot(Snapshot& out) const {
+        typename Snapshot::Buckets buckets;
+        for (size_t i = 0; i < Snapshot::kBucketCount; i++) {
+            buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+        }
+        out.restore(buckets, sum_.load(std::memory_order_relaxed), max_.load(std::memory_order_relaxed));
+    }
+
+    // Not atomic as a whole; samples recorded meanwhile may be half counted
+    void reset() {
+        for (auto& bucket : buckets_) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+        sum_.store(0, std::memory_order_relaxed);
+        max_.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, Snapshot::kBucketCount> buckets_{};
+    std::atomic<int64_t> sum_{0};
+    std::atomic<int64_t> max_{0};
+};
+
+// Connect phases, in milliseconds; tops out at about 131 s
+using LatencyHistogram = BasicLatencyHistogram<17>;
+
+} // namespace wireguard_flutter
@@ -0,0 +1,246 @@
+#include "latency_probe.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <cstring>
+#include <random>
+#include <utility>
+
+#include "logger.h"
+#include "wg_quick_config.h"
+
+namespace wireguard_flutter {
+
+namespace {
+
+#ifdef _WIN32
+using SocketHandle = SOCKET;
+using AddressLength = int;
+const SocketHandle kInvalidSocket = INVALID_SOCKET;
+
+void closeSocket(SocketHandle socket) {
+    closesocket(socket);
+}
+
+// An ICMP port unreachable for an earlier probe; the socket stays usable
+bool refused() {
+    return WSAGetLastError() == WSAECONNRESET;
+}
+#else
+using SocketHandle = int;
+using AddressLength = socklen_t;
+const SocketHandle kInvalidSocket = -1;
+
+void closeSocket(SocketHandle socket) {
+    ::close(socket);
+}
+
+bool refused() {
+    return errno == ECONNREFUSED || errno == EINTR;
+}
+#endif
+
+// "WGLP", the socket's token, the sequence and the microseconds since
+// open() at which the probe left, big-endian
+constexpr uint32_t kMagic = 0x57474c50;
+constexpr size_t kProbeSize = 20;
+
+void putWord(uint8_t* out, uint32_t value) {
+    value = htonl(value);
+    std::memcpy(out, &value, sizeof(value));
+}
+
+uint32_t getWord(const uint8_t* in) {
+    uint32_t value;
+    std::memcpy(&value, in, sizeof(value));
+    return ntohl(value);
+}
+
+} // namespace
+
+LatencyProbe::LatencyProbe(EventLoop& loop) : loop_(loop) {}
+
+LatencyProbe::~LatencyProbe() {
+    close();
+#ifdef _WIN32
+    if (winsock_) {
+        WSACleanup();
+    }
+#endif
+}
+
+bool LatencyProbe::open(const std::string& endpoint) {
+    close();
+#ifdef _WIN32
+    if (!winsock_) {
+        WSADATA wsaData;
+        winsock_ = WSAStartup(MAKEWORD(2, 2), &wsaData) == 0;
+        if (!winsock_) {
+            return false;
+        }
+    }
+#endif
+    std::string host;
+    std::string port;
+    if (!WgQuickConfig::splitEndpoint(endpoint, host, port) || !WgQuickConfig::isAddressLiteral(host)) {
+        WG_LOG_WARN("LatencyProbe: {} is not an address and port", endpoint);
+        return false;
+    }
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_protocol = IPPROTO_UDP;
+    hints.ai_flags = AI_NUMERICHOST | AI_NUMERICSERV;
+    addrinfo* results = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &results) != 0) {
+        WG_LOG_WARN("LatencyProbe: Could not parse {}", endpoint);
+        return false;
+    }
+
+    SocketHandle handle = ::socket(results->ai_family, SOCK_DGRAM, IPPROTO_UDP);
+    bool ready = handle != kInvalidSocket;
+#ifdef _WIN32
+    // Also makes the socket non-blocking
+    waitable_ = ready ? WSACreateEvent() : WSA_INVALID_EVENT;
+    if (waitable_ == WSA_INVALID_EVENT) {
+        waitable_ = nullptr;
+        ready = false;
+    }
+    ready = ready && WSAEventSelect(handle, waitable_, FD_READ) == 0;
+#else
+    waitable_ = handle;
+    ready = ready && fcntl(handle, F_SETFL, fcntl(handle, F_GETFL) | O_NONBLOCK) == 0;
+#endif
+    // Connected, so only the target's datagrams are read
+    ready = ready && connect(handle, results->ai_addr, static_cast<AddressLength>(results->ai_addrlen)) == 0;
+    freeaddrinfo(results);
+
+#ifdef _WIN32
+    handle_ = static_cast<uintptr_t>(handle);
+#else
+    handle_ = handle;
+#endif
+    open_ = true;
+    if (!ready) {
+        WG_LOG_WARN("LatencyProbe: Could not open a socket to {}", endpoint);
+        close();
+        return false;
+    }
+
+    std::random_device random;
+    token_ = random();
+    // Sequences carry on, so probes of an earlier socket still in flight
+    // cannot be matched by new echoes
+    openedAt_ = Clock::now();
+    endpoint_ = endpoint;
+    watch();
+    return true;
+}
+
+void LatencyProbe::close() {
+    EventLoop::TaskId wait = 0;
+    {
+        std::lock_guard<std::mutex> lock(waitMutex_);
+        if (!open_) {
+            return;
+        }
+        open_ = false;
+        wait = std::exchange(wait_, 0);
+    }
+    // Waits for an echo callback in progress, which sees open_ cleared and
+    // does not renew its wait
+    if (wait != 0) {
+        loop_.cancel(wait);
+    }
+    auto handle = static_cast<SocketHandle>(handle_);
+    if (handle != kInvalidSocket) {
+        closeSocket(handle);
+    }
+    handle_ = static_cast<decltype(handle_)>(kInvalidSocket);
+#ifdef _WIN32
+    if (waitable_ != nullptr) {
+        WSACloseEvent(waitable_);
+    }
+#endif
+    waitable_ = EventLoop::Waitable{};
+    endpoint_.clear();
+}
+
+bool LatencyProbe::send(Clock::time_point now) {
+    tracker_.expire(now);
+    if (!open_) {
+        return false;
+    }
+    auto sentUs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(now - openedAt_).count());
+    uint8_t probe[kProbeSize];
+    putWord(probe, kMagic);
+    putWord(probe + 4, token_);
+    putWord(probe + 8, sequence_);
+    putWord(probe + 12, static_cast<uint32_t>(sentUs >> 32));
+    putWord(probe + 16, static_cast<uint32_t>(sentUs));
+    auto handle = static_cast<SocketHandle>(handle_);
+    auto sent = ::send(handle, reinterpret_cast<const char*>(probe), static_cast<int>(kProbeSize), 0);
+    // The error of an earlier probe may be reported here instead
+    if (sent < 0 && refused()) {
+        sent = ::send(handle, reinterpret_cast<const char*>(probe), static_cast<int>(kProbeSize), 0);
+    }
+    if (sent != static_cast<decltype(sent)>(kProbeSize)) {
+        return false;
+    }
+    tracker_.onSent(sequence_++, now);
+    return true;
+}
+
+void LatencyProbe::watch() {
+    std::lock_guard<std::mutex> lock(waitMutex_);
+    if (!open_) {
+        return;
+    }
+    wait_ = loop_.addWait(waitable_, [this]() { receive(); });
+    if (wait_ == 0) {
+        WG_LOG_WARN("LatencyProbe: Too many waits to read echoes from {}", endpoint_);
+    }
+}
+
+void LatencyProbe::receive() {
+    if (!open_) {
+        return;
+    }
+    auto handle = static_cast<SocketHandle>(handle_);
+#ifdef _WIN32
+    // Resets the event before draining, so an echo arriving after the last
+    // read signals it again
+    WSANETWORKEVENTS events;
+    WSAEnumNetworkEvents(handle, waitable_, &events);
+#endif
+    auto now = Clock::now();
+    uint8_t buffer[64];
+    for (;;) {
+        auto length = recv(handle, reinterpret_cast<char*>(buffer), static_cast<int>(sizeof(buffer)), 0);
+        if (length < 0) {
+            if (refused()) {
+                continue;
+            }
+            break;
+        }
+        if (length != static_cast<decltype(length)>(kProbeSize) || getWord(buffer) != kMagic ||
+            getWord(buffer + 4) != token_) {
+            continue;
+        }
+        tracker_.onEcho(getWord(buffer + 8), now);
+    }
+    watch();
+}
+
+} // namespace wireguard_flutter
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "event_loop.h"
+#include "rtt_tracker.h"
+
+namespace wireguard_flutter {
+
+// Background round-trip probe through a tunnel: one small timestamped UDP
+// datagram per send() to an echo responder behind the peer, e.g. on its
+// inner gateway, feeding an RttTracker.
+//
+// Datagrams carry a per-socket token, the sequence and the microseconds
+// since open() at which they left; an echo counts when its token is ours
+// and its sequence is still in flight. Echoes are read by a wait on the EventLoop; the owner
+// decides when to send, so an idle tunnel is left alone. open(), send()
+// and the echoes run on the loop thread; close() may run on any thread
+// once the owner stopped calling the others. Portable.
+class LatencyProbe {
+public:
+    using Clock = RttTracker::Clock;
+
+    // How the owner runs the probe
+    struct Options {
+        bool enabled = true;
+        // Address and port of the echo responder; empty for the config's
+        // inner gateway on the echo port
+        std::string target;
+        std::chrono::milliseconds interval{5000};
+        RttTracker::Options tracker;
+    };
+
+    // The standard echo service
+    static constexpr const char* kEchoPort = "7";
+
+    explicit LatencyProbe(EventLoop& loop);
+    ~LatencyProbe();
+
+    LatencyProbe(const LatencyProbe&) = delete;
+    LatencyProbe& operator=(const LatencyProbe&) = delete;
+
+    // Targets |endpoint|, an address and port such as "10.0.0.1:7"; names
+    // are refused so the loop never waits on DNS. False when it does not
+    // parse or no socket could be opened. The tracker is kept.
+    bool open(const std::string& endpoint);
+    void close();
+    bool isOpen() const { return open_; }
+    const std::string& endpoint() const { return endpoint_; }
+
+    // Counts the probes past their timeout as lost and sends the next one;
+    // false when it could not go out
+    bool send(Clock::time_point now);
+
+    RttTracker& tracker() { return tracker_; }
+    const RttTracker& tracker() const { return tracker_; }
+
+private:
+    void watch();
+    void receive();
+
+    EventLoop& loop_;
+    RttTracker tracker_;
+    std::string endpoint_;
+#ifdef _WIN32
+    uintptr_t handle_ = ~static_cast<uintptr_t>(0);
+#else
+    int handle_ = -1;
+#endif
+    EventLoop::Waitable waitable_{};
+    // Hands the wait over between the echo callback, which renews it, and
+    // close() on another thread
+    std::mutex waitMutex_;
+    EventLoop::TaskId wait_ = 0;
+    uint32_t token_ = 0;
+    uint32_t sequence_ = 0;
+    Clock::time_point openedAt_;
+    std::atomic<bool> open_{false};
+    bool winsock_ = false;
+};
+
+} // namespace wireguard_flutter
@@ -0,0 +1,149 @@
+#include "log_ring.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+namespace wireguard_flutter {
+
+namespace {
+
+size_t roundUpToPowerOfTwo(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+// Longest prefix of at most |limit| bytes that does not split a character
+size_t utf8Prefix(std::string_view text, size_t limit) {
+    if (text.size() <= limit) {
+        return text.size();
+    }
+    size_t length = limit;
+    while (length > 0 && (static_cast<uint8_t>(text[length]) & 0xC0) == 0x80) {
+        length--;
+    }
+    return length;
+}
+
+} // namespace
+
+LogRing::LogRing(size_t capacity)
+    : slots_(new Slot[roundUpToPowerOfTwo(std::max<size_t>(capacity, 2))]),
+      mask_(roundUpToPowerOfTwo(std::max<size_t>(capacity, 2)) - 1) {}
+
+void LogRing::push(LogLevel level, int64_t timestampMs, std::string_view message) {
+    uint64_t position = head_.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = slots_[position & mask_];
+    const uint64_t writing = 2 * position + 1;
+
+    uint64_t current = slot.state.load(std::memory_order_relaxed);
+    for (;;) {
+        if (current >= writing) {
+            // A producer one lap ahead already owns the slot; this entry is
+            // lost, as it would have been overwritten anyway
+            return;
+        }
+        if (current & 1) {
+            // A producer one lap behind is still copying; it is mid-memcpy,
+            // so waiting is short, and skipping would stall readers
+            std::this_thread::yield();
+            current = slot.state.load(std::memory_order_relaxed);
+            continue;
+        }
+        if (slot.state.compare_exchange_weak(current, writing, std::memory_order_relaxed)) {
+            break;
+        }
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+
+    size_t length = utf8Prefix(message, kMaxMessageBytes);
+    std::array<uint64_t, kWords> words{};
+    std::memcpy(words.data(), message.data(), length);
+    for (size_t i = 0; i < (length + sizeof(uint64_t) - 1) / sizeof(uint64_t); i++) {
+        slot.words[i].store(words[i], std::memory_order_relaxed);
+    }
+    slot.timestampMs.store(timestampMs, std::memory_order_relaxed);
+    slot.levelAndLength.store(static_cast<uint32_t>(level) << 16 | static_cast<uint32_t>(length),
+                              std::memory_order_relaxed);
+
+    slot.state.store(writing + 1, std::memory_order_release);
+}
+
+LogRing::ReadResult LogRing::readSlot(uint64_t position, Entry& out) const {
+    const Slot& slot = slots_[position & mask_];
+    const uint64_t written = 2 * position + 2;
+
+    uint64_t before = slot.state.load(std::memory_order_acquire);
+    if (before < written) {
+        return ReadResult::Pending;
+    }
+    if (before > written) {
+        return ReadResult::Overwritten;
+    }
+
+    uint32_t levelAndLength = slot.levelAndLength.load(std::memory_order_relaxed);
+    size_t length = std::min<size_t>(levelAndLength & 0xFFFF, kMaxMessageBytes);
+    std::array<uint64_t, kWords> words;
+    for (size_t i = 0; i < (length + sizeof(uint64_t) - 1) / sizeof(uint64_t); i++) {
+        words[i] = slot.words[i].load(std::memory_order_relaxed);
+    }
+    int64_t timestampMs = slot.timestampMs.load(std::memory_order_relaxed);
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.state.load(std::memory_order_relaxed) != before) {
+        return ReadResult::Overwritten;
+    }
+
+    out.sequence = position;
+    out.timestampMs = timestampMs;
+    out.level = static_cast<LogLevel>(levelAndLength >> 16);
+    out.message.assign(reinterpret_cast<const char*>(words.data()), length);
+    return ReadResult::Ok;
+}
+
+uint64_t LogRing::read(uint64_t& cursor, size_t maxEntries, LogLevel minLevel, std::vector<Entry>& out) const {
+    out.clear();
+    uint64_t end = head();
+    uint64_t lost = 0;
+
+    // Anything more than a lap behind is gone
+    if (end - cursor > capacity()) {
+        lost = end - capacity() - cursor;
+        cursor = end - capacity();
+    }
+
+    Entry entry;
+    while (cursor < end && out.size() < maxEntries) {
+        ReadResult result = readSlot(cursor, entry);
+        if (result == ReadResult::Pending) {
+            break;
+        }
+        if (result == ReadResult::Overwritten) {
+            lost++;
+        } else if (entry.level >= minLevel) {
+            out.push_back(std::move(entry));
+        }
+        cursor++;
+    }
+    return lost;
+}
+
+void LogRing::tail(size_t maxEntries, LogLevel minLevel, std::vector<Entry>& out) const {
+    out.clear();
+    uint64_t end = head();
+    uint64_t begin = end > capacity() ? end - capacity() : 0;
+
+    // Newest first, so filtering still yields up to |maxEntries| entries
+    Entry entry;
+    for (uint64_t position = end; position > begin && out.size() < maxEntries; position--) {
+        if (readSlot(position - 1, entry) == ReadResult::Ok && entry.level >= minLevel) {
+            out.push_back(std::move(entry));
+        }
+    }
+    std::reverse(out.begin(), out.end());
+}
+
+} // namespace wireguard_flutter
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "log_level.h"
+
+namespace wireguard_flutter {
+
+// Bounded, lossy, lock-free multi-producer ring of log messages.
+//
+// Producers claim the next position with one fetch_add and write the slot
+// under a per-slot seqlock, so any number of threads may push at once and a
+// push never blocks or allocates; once the ring is full the oldest entries
+// are overwritten. Readers copy entries out and check the slot's sequence
+// afterwards, so an entry overwritten while being read is skipped rather
+// than returned torn. Messages are UTF-8, cut at kMaxMessageBytes on a
+// character boundary. Portable; no Windows dependencies.
+class LogRing {
+public:
+    static constexpr size_t kMaxMessageBytes = 232;
+    static constexpr size_t kDefaultCapacity = 1024;
+
+    struct Entry {
+        // Position in the ring since it was created; gaps mean lost entries
+        uint64_t sequence = 0;
+        int64_t timestampMs = 0;
+        LogLevel level = LogLevel::Info;
+        std::string message;
+    };
+
+    // |capacity| is rounded up to a power of two
+    explicit LogRing(size_t capacity = kDefaultCapacity);
+
+    LogRing(const LogRing&) = delete;
+    LogRing& operator=(const LogRing&) = delete;
+
+    // Thread-safe, wait-free unless a producer laps one still writing
+    void push(LogLevel level, int64_t timestampMs, std::string_view message);
+
+    // Position the next push gets
+    uint64_t head() const { return head_.load(std::memory_order_acquire); }
+    size_t capacity() const { return mask_ + 1; }
+
+    // Up to |maxEntries| entries from |cursor| on, oldest first, at or above
+    // |minLevel|; |cursor| is advanced past what was consumed. Stops at an
+    // entry still being written. Returns the number of entries overwritten
+    // before they could be read.
+    uint64_t read(uint64_t& cursor, size_t maxEntries, LogLevel minLevel, std::vector<Entry>& out) const;
+
+    // The newest |maxEntries| entries at or above |minLevel|, oldest first
+    void tail(size_t maxEntries, LogLevel minLevel, std::vector<Entry>& out) const;
+
+private:
+    static constexpr size_t kWords = kMaxMessageBytes / sizeof(uint64_t);
+
+    // 0 when never written; 2p+1 while position p is written, 2p+2 after
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> state{0};
+        std::atomic<int64_t> timestampMs{0};
+        std::atomic<uint32_t> levelAndLength{0};
+        std::array<std::atomic<uint64_t>, kWords> words{};
+    };
+
+    enum class ReadResult { Ok, Pending, Overwritten };
+    ReadResult readSlot(uint64_t position, Entry& out) const;
+
+    std::unique_ptr<Slot[]> slots_;
+    size_t mask_;
+    std::atomic<uint64_t> head_{0};
+};
+
+} // namespace wireguard_flutter
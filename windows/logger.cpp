@@ -0,0 +1,457 @@
+#include "logger.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+
+namespace wireguard_flutter {
+
+namespace {
+
+constexpr size_t kAlignment = 8;
+constexpr size_t kMask = Logger::kBufferBytes - 1;
+// Longest record accepted; larger ones are dropped
+constexpr size_t kMaxRecordBytes = Logger::kBufferBytes / 4;
+// Level of the filler written before the ring wraps
+constexpr uint8_t kPadding = 0xFF;
+// How long the writer lets a burst go on after being woken, so that it is
+// written as one batch
+constexpr std::chrono::milliseconds kLinger{5};
+
+static_assert((Logger::kBufferBytes & kMask) == 0, "kBufferBytes must be a power of two");
+
+// The first eight bytes are all a padding record has
+struct RecordHeader {
+    uint32_t size;
+    uint8_t level;
+    uint8_t argCount;
+    uint16_t reserved;
+    int64_t timestampUs;
+    const char* format;
+};
+
+int64_t nowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+size_t encodedLength(const logging::Arg& arg) {
+    if (arg.type == logging::ArgType::WideString) {
+        return std::min(arg.length, Logger::kMaxStringBytes / sizeof(wchar_t) * sizeof(wchar_t));
+    }
+    return std::min(arg.length, Logger::kMaxStringBytes);
+}
+
+bool isString(const logging::Arg& arg) {
+    return arg.type == logging::ArgType::String || arg.type == logging::ArgType::WideString;
+}
+
+template <typename T>
+T readValue(const char*& cursor) {
+    T value;
+    std::memcpy(&value, cursor, sizeof(value));
+    cursor += sizeof(value);
+    return value;
+}
+
+template <typename T>
+void appendNumber(std::string& out, T value, int base = 10) {
+    char text[24];
+    auto converted = std::to_chars(text, text + sizeof(text), value, base);
+    out.append(text, converted.ptr);
+}
+
+void appendUtf8(std::string& out, uint32_t codePoint) {
+    if (codePoint < 0x80) {
+        out += static_cast<char>(codePoint);
+    } else if (codePoint < 0x800) {
+        out += static_cast<char>(0xC0 | (codePoint >> 6));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else if (codePoint < 0x10000) {
+        out += static_cast<char>(0xE0 | (codePoint >> 12));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (codePoint >> 18));
+        out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+}
+
+// UTF-16 on Windows, UTF-32 elsewhere; unpaired surrogates become U+FFFD
+void appendWide(std::string& out, const char* data, size_t bytes) {
+    size_t count = bytes / sizeof(wchar_t);
+    for (size_t i = 0; i < count; i++) {
+        wchar_t unit;
+        std::memcpy(&unit, data + i * sizeof(wchar_t), sizeof(unit));
+        auto codePoint = static_cast<uint32_t>(unit);
+        if (codePoint >= 0xD800 && codePoint < 0xDC00 && i + 1 < count) {
+            wchar_t next;
+            std::memcpy(&next, data + (i + 1) * sizeof(wchar_t), sizeof(next));
+            auto low = static_cast<uint32_t>(next);
+            if (low >= 0xDC00 && low < 0xE000) {
+                codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                i++;
+            }
+        }
+        if ((codePoint >= 0xD800 && codePoint < 0xE000) || codePoint > 0x10FFFF) {
+            codePoint = 0xFFFD;
+        }
+        appendUtf8(out, codePoint);
+    }
+}
+
+void appendArg(std::string& out, const char*& cursor) {
+    auto type = static_cast<logging::ArgType>(readValue<uint8_t>(cursor));
+    switch (type) {
+    case logging::ArgType::String:
+    case logging::ArgType::WideString: {
+        auto length = readValue<uint32_t>(cursor);
+        if (type == logging::ArgType::String) {
+            out.append(cursor, length);
+        } else {
+            appendWide(out, cursor, length);
+        }
+        cursor += length;
+        return;
+    }
+    default:
+        break;
+    }
+
+    auto bits = readValue<uint64_t>(cursor);
+    switch (type) {
+    case logging::ArgType::Bool:
+        out += bits != 0 ? "true" : "false";
+        break;
+    case logging::ArgType::Int:
+        appendNumber(out, static_cast<int64_t>(bits));
+        break;
+    case logging::ArgType::UInt:
+        appendNumber(out, bits);
+        break;
+    case logging::ArgType::Double: {
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        char text[32];
+        int length = std::snprintf(text, sizeof(text), "%g", value);
+        out.append(text, static_cast<size_t>(std::clamp(length, 0, static_cast<int>(sizeof(text)) - 1)));
+        break;
+    }
+    case logging::ArgType::Char:
+        out += static_cast<char>(bits);
+        break;
+    case logging::ArgType::Pointer:
+        out += "0x";
+        appendNumber(out, bits, 16);
+        break;
+    default:
+        break;
+    }
+}
+
+// Substitutes the arguments for "{}" in order; extra arguments are appended
+void formatRecord(const RecordHeader& header, const char* args, std::string& out) {
+    size_t remaining = header.argCount;
+    for (const char* format = header.format; *format != '\0'; format++) {
+        if (format[0] == '{' && format[1] == '}' && remaining > 0) {
+            appendArg(out, args);
+            remaining--;
+            format++;
+        } else {
+            out += *format;
+        }
+    }
+    for (; remaining > 0; remaining--) {
+        out += ' ';
+        appendArg(out, args);
+    }
+}
+
+void writeToStdio(const std::vector<Logger::Line>& lines) {
+    bool wroteOut = false;
+    bool wroteError = false;
+    std::string text;
+    for (const auto& line : lines) {
+        text = Logger::formatLine(line);
+        text += '\n';
+        bool error = line.level >= LogLevel::Warn;
+        std::fwrite(text.data(), 1, text.size(), error ? stderr : stdout);
+        wroteError |= error;
+        wroteOut |= !error;
+    }
+    if (wroteOut) {
+        std::fflush(stdout);
+    }
+    if (wroteError) {
+        std::fflush(stderr);
+    }
+}
+
+} // namespace
+
+// Single-producer, single-consumer ring of records. Only the owning thread
+// writes head and cachedTail; only the drainer, under drainMutex_, writes tail.
+struct Logger::ThreadBuffer {
+    explicit ThreadBuffer(uint32_t index) : storage(new uint64_t[kBufferBytes / sizeof(uint64_t)]), thread(index) {}
+
+    char* bytes() { return reinterpret_cast<char*>(storage.get()); }
+
+    std::unique_ptr<uint64_t[]> storage;
+    const uint32_t thread;
+    std::atomic<bool> exited{false};
+
+    alignas(64) std::atomic<size_t> head{0};
+    size_t cachedTail = 0;
+
+    alignas(64) std::atomic<size_t> tail{0};
+};
+
+// Marks the thread's ring for removal once it has been drained
+struct Logger::ThreadHandle {
+    ~ThreadHandle() {
+        if (buffer) {
+            buffer->exited.store(true, std::memory_order_release);
+        }
+    }
+
+    std::shared_ptr<ThreadBuffer> buffer;
+};
+
+Logger& Logger::instance() {
+    // Leaked so that threads and destructors logging during shutdown never
+    // see it destroyed
+    static Logger* logger = new Logger();
+    return *logger;
+}
+
+void Logger::setSink(Sink sink) {
+    std::lock_guard<std::mutex> lock(drainMutex_);
+    sink_ = std::move(sink);
+}
+
+void Logger::write(LogLevel level, const char* format, const logging::Arg* args, size_t count) {
+    size_t size = sizeof(RecordHeader);
+    for (size_t i = 0; i < count; i++) {
+        size += 1 + (isString(args[i]) ? sizeof(uint32_t) + encodedLength(args[i]) : sizeof(uint64_t));
+    }
+    size = (size + kAlignment - 1) & ~(kAlignment - 1);
+    if (size > kMaxRecordBytes || count > UINT8_MAX) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    ThreadBuffer& buffer = threadBuffer();
+    size_t head = buffer.head.load(std::memory_order_relaxed);
+    size_t offset = head & kMask;
+    size_t contiguous = kBufferBytes - offset;
+    size_t needed = size <= contiguous ? size : contiguous + size;
+    if (head + needed - buffer.cachedTail > kBufferBytes) {
+        buffer.cachedTail = buffer.tail.load(std::memory_order_acquire);
+        if (head + needed - buffer.cachedTail > kBufferBytes) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+    if (size > contiguous) {
+        RecordHeader padding{};
+        padding.size = static_cast<uint32_t>(contiguous);
+        padding.level = kPadding;
+        std::memcpy(buffer.bytes() + offset, &padding, kAlignment);
+        head += contiguous;
+        offset = 0;
+    }
+
+    char* record = buffer.bytes() + offset;
+    RecordHeader header{};
+    header.size = static_cast<uint32_t>(size);
+    header.level = static_cast<uint8_t>(level);
+    header.argCount = static_cast<uint8_t>(count);
+    header.timestampUs = nowUs();
+    header.format = format;
+    std::memcpy(record, &header, sizeof(header));
+
+    char* cursor = record + sizeof(header);
+    for (size_t i = 0; i < count; i++) {
+        const auto& arg = args[i];
+        *cursor++ = static_cast<char>(arg.type);
+        if (isString(arg)) {
+            auto length = static_cast<uint32_t>(encodedLength(arg));
+            std::memcpy(cursor, &length, sizeof(length));
+            std::memcpy(cursor + sizeof(length), arg.data, length);
+            cursor += sizeof(length) + length;
+        } else {
+            std::memcpy(cursor, &arg.bits, sizeof(arg.bits));
+            cursor += sizeof(arg.bits);
+        }
+    }
+    buffer.head.store(head + size, std::memory_order_release);
+
+    // Pairs with the fence in the drainer: either it sees this record, or
+    // this thread sees the flag it cleared and wakes it again
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!wakePending_.load(std::memory_order_relaxed) && !wakePending_.exchange(true)) {
+        wake();
+    }
+}
+
+Logger::ThreadBuffer& Logger::threadBuffer() {
+    thread_local ThreadHandle handle;
+    if (!handle.buffer) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        handle.buffer = std::make_shared<ThreadBuffer>(nextThread_++);
+        buffers_.push_back(handle.buffer);
+        if (!writer_.joinable() && !stopped_) {
+            writer_ = std::thread(&Logger::run, this);
+        }
+    }
+    return *handle.buffer;
+}
+
+void Logger::wake() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!stopped_) {
+        wake_.notify_one();
+        return;
+    }
+
+    // No writer any more; write the record out here
+    auto buffers = buffersLocked();
+    lock.unlock();
+    wakePending_.store(false, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    drainAll(buffers);
+}
+
+void Logger::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        wake_.wait(lock, [this] {
+            return stopped_ || flushRequested_ != flushCompleted_ || wakePending_.load(std::memory_order_relaxed);
+        });
+        if (!stopped_ && flushRequested_ == flushCompleted_) {
+            wake_.wait_for(lock, kLinger, [this] { return stopped_ || flushRequested_ != flushCompleted_; });
+        }
+
+        bool stop = stopped_;
+        uint64_t flushTarget = flushRequested_;
+        auto buffers = buffersLocked();
+        lock.unlock();
+
+        wakePending_.store(false, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        drainAll(buffers);
+
+        lock.lock();
+        flushCompleted_ = flushTarget;
+        flushed_.notify_all();
+        if (stop) {
+            return;
+        }
+    }
+}
+
+std::vector<std::shared_ptr<Logger::ThreadBuffer>> Logger::buffersLocked() {
+    // Rings of threads that have exited go once they are empty
+    buffers_.erase(std::remove_if(buffers_.begin(), buffers_.end(),
+                                  [](const std::shared_ptr<ThreadBuffer>& buffer) {
+                                      return buffer->exited.load(std::memory_order_acquire) &&
+                                             buffer->tail.load(std::memory_order_relaxed) ==
+                                                 buffer->head.load(std::memory_order_acquire);
+                                  }),
+                   buffers_.end());
+    return buffers_;
+}
+
+void Logger::drainAll(const std::vector<std::shared_ptr<ThreadBuffer>>& buffers) {
+    std::lock_guard<std::mutex> lock(drainMutex_);
+    for (const auto& buffer : buffers) {
+        char* bytes = buffer->bytes();
+        size_t tail = buffer->tail.load(std::memory_order_relaxed);
+        size_t head = buffer->head.load(std::memory_order_acquire);
+        while (tail != head) {
+            const char* record = bytes + (tail & kMask);
+            RecordHeader header{};
+            std::memcpy(&header, record, kAlignment);
+            if (header.level != kPadding) {
+                std::memcpy(&header, record, sizeof(header));
+                Line line;
+                line.timestampUs = header.timestampUs;
+                line.level = static_cast<LogLevel>(header.level);
+                line.thread = buffer->thread;
+                formatRecord(header, record + sizeof(header), line.message);
+                lines_.push_back(std::move(line));
+            }
+            tail += header.size;
+        }
+        buffer->tail.store(tail, std::memory_order_release);
+    }
+
+    uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+    if (dropped != reportedDrops_) {
+        Line line;
+        line.timestampUs = nowUs();
+        line.level = LogLevel::Warn;
+        line.message = "Logger: Dropped " + std::to_string(dropped - reportedDrops_) + " records";
+        lines_.push_back(std::move(line));
+        reportedDrops_ = dropped;
+    }
+    if (lines_.empty()) {
+        return;
+    }
+
+    // Each ring is in order already; this interleaves the threads
+    std::stable_sort(lines_.begin(), lines_.end(),
+                     [](const Line& a, const Line& b) { return a.timestampUs < b.timestampUs; });
+    if (sink_) {
+        sink_(lines_);
+    } else {
+        writeToStdio(lines_);
+    }
+    lines_.clear();
+}
+
+void Logger::flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!writer_.joinable()) {
+        auto buffers = buffersLocked();
+        lock.unlock();
+        drainAll(buffers);
+        return;
+    }
+    uint64_t target = ++flushRequested_;
+    wake_.notify_one();
+    flushed_.wait(lock, [this, target] { return flushCompleted_ >= target; });
+}
+
+void Logger::shutdown() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    // From here on callers write their own records, even while the writer
+    // finishes its last batch
+    stopped_ = true;
+    wake_.notify_one();
+    std::thread writer = std::move(writer_);
+    lock.unlock();
+    if (writer.joinable()) {
+        writer.join();
+    }
+    flush();
+}
+
+std::string Logger::formatLine(const Line& line) {
+    int64_t millis = line.timestampUs / 1000;
+    int64_t ofDay = ((millis % 86400000) + 86400000) % 86400000;
+    char prefix[48];
+    int length = std::snprintf(prefix, sizeof(prefix), "%02d:%02d:%02d.%03d %-5s [%u] ",
+                               static_cast<int>(ofDay / 3600000), static_cast<int>(ofDay / 60000 % 60),
+                               static_cast<int>(ofDay / 1000 % 60), static_cast<int>(ofDay % 1000),
+                               logLevelName(line.level), line.thread);
+    std::string text(prefix, static_cast<size_t>(std::clamp(length, 0, static_cast<int>(sizeof(prefix)) - 1)));
+    text += line.message;
+    return text;
+}
+
+} // namespace wireguard_flutter
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "log_level.h"
+
+// Debug records are compiled out of release builds unless asked for
+#ifndef WIREGUARD_FLUTTER_DEBUG_LOGS
+#ifdef NDEBUG
+#define WIREGUARD_FLUTTER_DEBUG_LOGS 0
+#else
+#define WIREGUARD_FLUTTER_DEBUG_LOGS 1
+#endif
+#endif
+
+namespace wireguard_flutter {
+
+namespace logging {
+
+enum class ArgType : uint8_t { Bool, Int, UInt, Double, Char, Pointer, String, WideString };
+
+// One argument as handed to the encoder; strings are only referenced here and
+// copied into the record
+struct Arg {
+    ArgType type = ArgType::Int;
+    uint64_t bits = 0;
+    const void* data = nullptr;
+    size_t length = 0;
+};
+
+inline Arg toArg(bool value) {
+    return {ArgType::Bool, value ? 1u : 0u};
+}
+
+inline Arg toArg(char value) {
+    return {ArgType::Char, static_cast<uint8_t>(value)};
+}
+
+template <typename T, std::enable_if_t<std::is_integral_v<T> || std::is_enum_v<T>, int> = 0>
+Arg toArg(T value) {
+    if constexpr (std::is_enum_v<T>) {
+        return toArg(static_cast<std::underlying_type_t<T>>(value));
+    } else if constexpr (std::is_signed_v<T>) {
+        return {ArgType::Int, static_cast<uint64_t>(static_cast<int64_t>(value))};
+    } else {
+        return {ArgType::UInt, static_cast<uint64_t>(value)};
+    }
+}
+
+template <typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
+Arg toArg(T value) {
+    double converted = static_cast<double>(value);
+    Arg arg{ArgType::Double};
+    static_assert(sizeof(converted) == sizeof(arg.bits));
+    std::memcpy(&arg.bits, &converted, sizeof(converted));
+    return arg;
+}
+
+inline Arg toArg(std::string_view value) {
+    return {ArgType::String, 0, value.data(), value.size()};
+}
+
+inline Arg toArg(const char* value) {
+    return toArg(std::string_view(value != nullptr ? value : "(null)"));
+}
+
+inline Arg toArg(std::wstring_view value) {
+    return {ArgType::WideString, 0, value.data(), value.size() * sizeof(wchar_t)};
+}
+
+inline Arg toArg(const wchar_t* value) {
+    return toArg(std::wstring_view(value != nullptr ? value : L"(null)"));
+}
+
+template <typename T>
+Arg toArg(const T* value) {
+    return {ArgType::Pointer, reinterpret_cast<uintptr_t>(value)};
+}
+
+} // namespace logging
+
+// Asynchronous binary logger.
+//
+// A log call checks the runtime level, then copies the format's address, a
+// timestamp and its arguments in binary form into a ring owned by the calling
+// thread; it takes no lock, allocates nothing after the thread's first record
+// and does no formatting. A writer thread drains every thread's ring, puts
+// the records in time order, substitutes the arguments for the "{}"
+// placeholders and hands the lines to the sink in batches. A full ring drops
+// the record and counts it rather than block the caller. Formats must be
+// string literals; string arguments are copied, up to kMaxStringBytes.
+//
+// After shutdown() records are formatted and written by the caller, so
+// destructors running later still get their lines out. Never destroyed.
+// Portable; no Windows dependencies.
+class Logger {
+public:
+    // Bytes of records each thread can have waiting
+    static constexpr size_t kBufferBytes = 64 * 1024;
+    static constexpr size_t kMaxStringBytes = 1024;
+
+    struct Line {
+        int64_t timestampUs = 0;
+        LogLevel level = LogLevel::Info;
+        // Order in which the thread first logged
+        uint32_t thread = 0;
+        std::string message;
+    };
+
+    // Called on the writer thread with each batch, oldest first
+    using Sink = std::function<void(const std::vector<Line>& lines)>;
+
+    static Logger& instance();
+
+    // Cheap enough for every call site; checked before arguments are encoded
+    static bool enabled(LogLevel level) { return level >= level_.load(std::memory_order_relaxed); }
+    static void setLevel(LogLevel level) { level_.store(level, std::memory_order_relaxed); }
+    static LogLevel currentLevel() { return level_.load(std::memory_order_relaxed); }
+
+    template <size_t N, typename... Args>
+    void log(LogLevel level, const char (&format)[N], const Args&... args) {
+        const logging::Arg encoded[] = {logging::toArg(args)..., logging::Arg{}};
+        write(level, format, encoded, sizeof...(Args));
+    }
+
+    // Replaces the default sink, which writes to stdout, and warnings and
+    // errors to stderr
+    void setSink(Sink sink);
+
+    // Returns once everything logged before the call has reached the sink
+    void flush();
+
+    // Flushes and stops the writer thread
+    void shutdown();
+
+    // Records dropped because a thread's ring was full
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    // "HH:MM:SS.mmm level [thread] message", UTC
+    static std::string formatLine(const Line& line);
+
+private:
+    struct ThreadBuffer;
+    struct ThreadHandle;
+
+    Logger() = default;
+
+    void write(LogLevel level, const char* format, const logging::Arg* args, size_t count);
+    ThreadBuffer& threadBuffer();
+    void wake();
+    void run();
+    std::vector<std::shared_ptr<ThreadBuffer>> buffersLocked();
+    // Drains every ring into lines_ and hands them to the sink; one caller at a time
+    void drainAll(const std::vector<std::shared_ptr<ThreadBuffer>>& buffers);
+
+    static inline std::atomic<LogLevel> level_{WIREGUARD_FLUTTER_DEBUG_LOGS ? LogLevel::Debug : LogLevel::Info};
+
+    // Set by the first record after a drain, so only that one wakes the writer
+    std::atomic<bool> wakePending_{false};
+    std::atomic<uint64_t> dropped_{0};
+
+    // Guards the thread list, the writer's lifecycle and flush requests
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable flushed_;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers_;
+    std::thread writer_;
+    bool stopped_ = false;
+    uint64_t flushRequested_ = 0;
+    uint64_t flushCompleted_ = 0;
+    uint32_t nextThread_ = 0;
+
+    // Writer side; guards the sink and the batch buffer
+    std::mutex drainMutex_;
+    Sink sink_;
+    std::vector<Line> lines_;
+    uint64_t reportedDrops_ = 0;
+};
+
+} // namespace wireguard_flutter
+
+#define WG_LOG(level, ...)                                                                   \
+    do {                                                                                     \
+        if (::wireguard_flutter::Logger::enabled(level)) {                                   \
+            ::wireguard_flutter::Logger::instance().log(level, __VA_ARGS__);                 \
+        }                                                                                    \
+    } while (false)
+
+// Arguments of elided debug records are not evaluated
+#if WIREGUARD_FLUTTER_DEBUG_LOGS
+#define WG_LOG_DEBUG(...) WG_LOG(::wireguard_flutter::LogLevel::Debug, __VA_ARGS__)
+#else
+#define WG_LOG_DEBUG(...) ((void)0)
+#endif
+#define WG_LOG_INFO(...) WG_LOG(::wireguard_flutter::LogLevel::Info, __VA_ARGS__)
+#define WG_LOG_WARN(...) WG_LOG(::wireguard_flutter::LogLevel::Warn, __VA_ARGS__)
+#define WG_LOG_ERROR(...) WG_LOG(::wireguard_flutter::LogLevel::Error, __VA_ARGS__)
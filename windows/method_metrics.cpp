@@ -0,0 +1,89 @@
+#include "method_metrics.h"
+
+#include <algorithm>
+#include <functional>
+
+namespace wireguard_flutter {
+
+namespace {
+
+std::chrono::steady_clock::rep steadyNow() {
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+} // namespace
+
+MethodMetrics::MethodMetrics() : other_(std::make_unique<Method>("other")), resetAt_(steadyNow()) {}
+
+MethodMetrics::Method& MethodMetrics::method(std::string_view name) {
+    size_t start = std::hash<std::string_view>()(name) % kMaxMethods;
+
+    // Slots are only ever filled, so a probe that meets an empty slot has
+    // seen every entry the name could be in
+    for (size_t i = 0; i < kMaxMethods; i++) {
+        Method* entry = slots_[(start + i) % kMaxMethods].load(std::memory_order_acquire);
+        if (entry == nullptr) {
+            break;
+        }
+        if (entry->name == name) {
+            return *entry;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < kMaxMethods; i++) {
+        auto& slot = slots_[(start + i) % kMaxMethods];
+        Method* entry = slot.load(std::memory_order_relaxed);
+        if (entry == nullptr) {
+            methods_.push_back(std::make_unique<Method>(std::string(name)));
+            slot.store(methods_.back().get(), std::memory_order_release);
+            return *methods_.back();
+        }
+        if (entry->name == name) {
+            return *entry;
+        }
+    }
+    return *other_;
+}
+
+template <typename Visit>
+void MethodMetrics::forEach(Visit visit) const {
+    for (const auto& slot : slots_) {
+        if (Method* entry = slot.load(std::memory_order_acquire)) {
+            visit(*entry);
+        }
+    }
+    visit(*other_);
+}
+
+void MethodMetrics::summarize(std::vector<Summary>& out) const {
+    out.clear();
+    forEach([&out](const Method& entry) {
+        uint64_t calls = entry.calls.load(std::memory_order_relaxed);
+        if (calls == 0) {
+            return;
+        }
+        Summary summary;
+        summary.name = entry.name;
+        summary.calls = calls;
+        summary.errors = entry.errors.load(std::memory_order_relaxed);
+        entry.latencyUs.snapshot(summary.latencyUs);
+        out.push_back(std::move(summary));
+    });
+    std::sort(out.begin(), out.end(), [](const Summary& a, const Summary& b) { return a.name < b.name; });
+}
+
+void MethodMetrics::reset() {
+    forEach([](Method& entry) {
+        entry.calls.store(0, std::memory_order_relaxed);
+        entry.errors.store(0, std::memory_order_relaxed);
+        entry.latencyUs.reset();
+    });
+    resetAt_.store(steadyNow(), std::memory_order_relaxed);
+}
+
+std::chrono::steady_clock::duration MethodMetrics::sinceReset() const {
+    return std::chrono::steady_clock::duration(steadyNow() - resetAt_.load(std::memory_order_relaxed));
+}
+
+} // namespace wireguard_flutter
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "latency_histogram.h"
+
+namespace wireguard_flutter {
+
+// Call counts and latencies of the plugin's method channel, per method.
+//
+// Entries are created the first time a method is seen and never freed, so a
+// caller may keep the reference. Lookup is lock-free; only creating an entry
+// takes a lock. The table is fixed size; methods beyond kMaxMethods share an
+// "other" entry.
+class MethodMetrics {
+public:
+    // Microseconds; tops out at about 134 s
+    using Histogram = AtomicLatencyHistogram<27>;
+
+    struct Method {
+        explicit Method(std::string methodName) : name(std::move(methodName)) {}
+
+        const std::string name;
+        std::atomic<uint64_t> calls{0};
+        std::atomic<uint64_t> errors{0};
+        Histogram latencyUs;
+    };
+
+    struct Summary {
+        std::string name;
+        uint64_t calls = 0;
+        uint64_t errors = 0;
+        Histogram::Snapshot latencyUs;
+    };
+
+    static constexpr size_t kMaxMethods = 64;
+
+    MethodMetrics();
+
+    MethodMetrics(const MethodMetrics&) = delete;
+    MethodMetrics& operator=(const MethodMetrics&) = delete;
+
+    Method& method(std::string_view name);
+
+    // Methods called since the last reset, by name
+    void summarize(std::vector<Summary>& out) const;
+
+    // Zeroes every counter; entries stay
+    void reset();
+    std::chrono::steady_clock::duration sinceReset() const;
+
+private:
+    template <typename Visit>
+    void forEach(Visit visit) const;
+
+    std::array<std::atomic<Method*>, kMaxMethods> slots_{};
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<Method>> methods_;
+    const std::unique_ptr<Method> other_;
+    std::atomic<std::chrono::steady_clock::rep> resetAt_;
+};
+
+} // namespace wireguard_flutter
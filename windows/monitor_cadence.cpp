@@ -0,0 +1,42 @@
+#include "monitor_cadence.h"
+
+namespace wireguard_flutter {
+
+MonitorCadence::MonitorCadence(const Options& options) : options_(options) {}
+
+std::chrono::milliseconds MonitorCadence::next(Activity activity, bool listened) {
+    switch (activity) {
+    case Activity::Connecting:
+        quietTicks_ = 0;
+        recoveringTicks_ = 0;
+        return options_.fast;
+
+    case Activity::Recovering:
+        quietTicks_ = 0;
+        if (recoveringTicks_ < options_.recoveryTicks) {
+            recoveringTicks_++;
+            return options_.fast;
+        }
+        return listened ? options_.settling : options_.idle;
+
+    case Activity::Connected:
+        break;
+    }
+
+    recoveringTicks_ = 0;
+    if (!listened) {
+        return options_.idle;
+    }
+    if (quietTicks_ < options_.settleTicks) {
+        quietTicks_++;
+        return options_.settling;
+    }
+    return options_.stable;
+}
+
+void MonitorCadence::reset() {
+    quietTicks_ = 0;
+    recoveringTicks_ = 0;
+}
+
+} // namespace wireguard_flutter
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace wireguard_flutter {
+
+// Picks how long a tunnel's monitor may sleep before its next tick.
+//
+// A connecting or recovering tunnel is polled fast so the change is noticed
+// quickly; recovery only gets a bounded burst of fast ticks, so a peer that
+// stays silent does not keep the loop busy. Once connected, a tunnel ticks
+// at the settling rate until it has been quiet for a while and then backs
+// off to the stable rate. With nobody listening for stages or statistics,
+// only the link is watched, at the idle rate.
+class MonitorCadence {
+public:
+    enum class Activity {
+        Connecting,
+        // Connected, but something needs watching, e.g. a stale handshake
+        Recovering,
+        Connected,
+    };
+
+    struct Options {
+        std::chrono::milliseconds fast{250};
+        std::chrono::milliseconds settling{1000};
+        std::chrono::milliseconds stable{2000};
+        std::chrono::milliseconds idle{15000};
+        // Quiet ticks before a connected tunnel counts as stable
+        uint32_t settleTicks = 10;
+        // Fast ticks a recovery gets before it falls back to settling
+        uint32_t recoveryTicks = 40;
+    };
+
+    MonitorCadence() = default;
+    explicit MonitorCadence(const Options& options);
+
+    // Interval until the next tick, after a tick that saw |activity|.
+    // |listened| tells whether anyone consumes stages or statistics.
+    std::chrono::milliseconds next(Activity activity, bool listened);
+
+    // Forgets the history, e.g. when the tunnel reconnects
+    void reset();
+
+    const Options& options() const { return options_; }
+
+private:
+    Options options_;
+    uint32_t quietTicks_ = 0;
+    uint32_t recoveringTicks_ = 0;
+};
+
+} // namespace wireguard_flutter
@@ -0,0 +1,73 @@
+#include "network_monitor.h"
+
+#include <cwchar>
+
+#include "logger.h"
+
+namespace wireguard_flutter {
+
+NetworkMonitor::~NetworkMonitor() {
+    stop();
+}
+
+bool NetworkMonitor::start(Callback callback) {
+    stop();
+    callback_ = std::move(callback);
+
+    DWORD error = NotifyRouteChange2(AF_UNSPEC, &NetworkMonitor::onRouteChange, this, FALSE, &routeHandle_);
+    if (error != NO_ERROR) {
+        WG_LOG_ERROR("NetworkMonitor: Failed to watch routes. Error: {}", error);
+        routeHandle_ = nullptr;
+        return false;
+    }
+    error = NotifyUnicastIpAddressChange(AF_UNSPEC, &NetworkMonitor::onAddressChange, this, FALSE, &addressHandle_);
+    if (error != NO_ERROR) {
+        WG_LOG_ERROR("NetworkMonitor: Failed to watch addresses. Error: {}", error);
+        addressHandle_ = nullptr;
+        stop();
+        return false;
+    }
+    return true;
+}
+
+void NetworkMonitor::stop() {
+    // Both wait for callbacks that are already running
+    if (routeHandle_) {
+        CancelMibChangeNotify2(routeHandle_);
+        routeHandle_ = nullptr;
+    }
+    if (addressHandle_) {
+        CancelMibChangeNotify2(addressHandle_);
+        addressHandle_ = nullptr;
+    }
+}
+
+void WINAPI NetworkMonitor::onRouteChange(PVOID context, PMIB_IPFORWARD_ROW2 row, MIB_NOTIFICATION_TYPE type) {
+    // Only default routes decide which interface carries the tunnel's packets
+    if (type == MibInitialNotification || row == nullptr || row->DestinationPrefix.PrefixLength != 0) {
+        return;
+    }
+    static_cast<NetworkMonitor*>(context)->report(row->InterfaceLuid);
+}
+
+void WINAPI NetworkMonitor::onAddressChange(PVOID context, PMIB_UNICASTIPADDRESS_ROW row, MIB_NOTIFICATION_TYPE type) {
+    if (type == MibInitialNotification || row == nullptr) {
+        return;
+    }
+    static_cast<NetworkMonitor*>(context)->report(row->InterfaceLuid);
+}
+
+void NetworkMonitor::report(const NET_LUID& luid) {
+    MIB_IF_ROW2 ifRow;
+    ZeroMemory(&ifRow, sizeof(ifRow));
+    ifRow.InterfaceLuid = luid;
+    // Tunnels coming up add routes and addresses of their own; an interface
+    // that is already gone could have been anything, so it counts
+    if (GetIfEntry2(&ifRow) == NO_ERROR && std::wcsstr(ifRow.Description, L"WireGuard") != nullptr) {
+        return;
+    }
+    WG_LOG_DEBUG("NetworkMonitor: Change on interface {}", luid.Value);
+    callback_();
+}
+
+} // namespace wireguard_flutter
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <winsock2.h>
+#include <windows.h>
+#include <ws2ipdef.h>
+#include <iphlpapi.h>
+#include <netioapi.h>
+
+#include <functional>
+
+namespace wireguard_flutter {
+
+// Reports changes of the host's default routes and unicast addresses, such
+// as a switch from Wi-Fi to Ethernet or a new DHCP lease. Changes on
+// WireGuard adapters, the tunnels' own, are left out.
+//
+// Notifications arrive on system thread-pool threads, possibly several at
+// once, so the callback only hands the change off. stop() returns once no
+// callback runs any more.
+class NetworkMonitor {
+public:
+    using Callback = std::function<void()>;
+
+    NetworkMonitor() = default;
+    ~NetworkMonitor();
+
+    NetworkMonitor(const NetworkMonitor&) = delete;
+    NetworkMonitor& operator=(const NetworkMonitor&) = delete;
+
+    bool start(Callback callback);
+    void stop();
+
+private:
+    static void WINAPI onRouteChange(PVOID context, PMIB_IPFORWARD_ROW2 row, MIB_NOTIFICATION_TYPE type);
+    static void WINAPI onAddressChange(PVOID context, PMIB_UNICASTIPADDRESS_ROW row, MIB_NOTIFICATION_TYPE type);
+    void report(const NET_LUID& luid);
+
+    Callback callback_;
+    HANDLE routeHandle_ = nullptr;
+    HANDLE addressHandle_ = nullptr;
+};
+
+} // namespace wireguard_flutter
@@ -0,0 +1,192 @@
+#include "path_mtu_prober.h"
+
+#include <iphlpapi.h>
+#include <icmpapi.h>
+
+#include "logger.h"
+
+namespace wireguard_flutter {
+
+namespace {
+
+// IP header plus the echo's own 8 bytes; the rest is payload
+constexpr uint32_t kIcmp4Headers = 20 + 8;
+constexpr uint32_t kIcmp6Headers = 40 + 8;
+
+// Room for the reply structure, the ICMP error's quoted header and the
+// IO_STATUS_BLOCK the asynchronous call appends
+constexpr size_t kReplySlack = 256;
+
+// The interface packets to |destination| leave on when the tunnel is not in
+// the way: the best route, unless that is the tunnel, else the best default
+// route of another connected interface
+bool outsideRoute(const SOCKADDR_INET& destination, const NET_LUID* tunnel, NET_LUID& luid, SOCKADDR_INET& source) {
+    MIB_IPFORWARD_ROW2 route{};
+    if (GetBestRoute2(nullptr, 0, nullptr, &destination, 0, &route, &source) == NO_ERROR &&
+        (tunnel == nullptr || route.InterfaceLuid.Value != tunnel->Value)) {
+        luid = route.InterfaceLuid;
+        return true;
+    }
+
+    PMIB_IPFORWARD_TABLE2 table = nullptr;
+    if (GetIpForwardTable2(destination.si_family, &table) != NO_ERROR) {
+        return false;
+    }
+    bool found = false;
+    ULONG bestMetric = MAXULONG;
+    for (ULONG i = 0; i < table->NumEntries; i++) {
+        const MIB_IPFORWARD_ROW2& row = table->Table[i];
+        if (row.DestinationPrefix.PrefixLength != 0 ||
+            (tunnel != nullptr && row.InterfaceLuid.Value == tunnel->Value)) {
+            continue;
+        }
+        MIB_IPINTERFACE_ROW ipInterface;
+        InitializeIpInterfaceEntry(&ipInterface);
+        ipInterface.Family = destination.si_family;
+        ipInterface.InterfaceLuid = row.InterfaceLuid;
+        if (GetIpInterfaceEntry(&ipInterface) != NO_ERROR || !ipInterface.Connected) {
+            continue;
+        }
+        // What the stack itself compares
+        ULONG metric = row.Metric + ipInterface.Metric;
+        if (metric < bestMetric) {
+            bestMetric = metric;
+            luid = row.InterfaceLuid;
+            found = true;
+        }
+    }
+    FreeMibTable(table);
+    return found && GetBestRoute2(&luid, 0, nullptr, &destination, 0, &route, &source) == NO_ERROR;
+}
+
+PmtuSearch::Outcome outcomeOf(DWORD status) {
+    switch (status) {
+    case IP_SUCCESS:
+        return PmtuSearch::Outcome::Reply;
+    case IP_PACKET_TOO_BIG:
+        return PmtuSearch::Outcome::TooBig;
+    default:
+        // Timed out, or unreachable at this size; both are retried
+        return PmtuSearch::Outcome::Loss;
+    }
+}
+
+} // namespace
+
+PathMtuProber::~PathMtuProber() {
+    close();
+}
+
+bool PathMtuProber::open(const std::string& address, const NET_LUID* tunnel) {
+    close();
+    SOCKADDR_INET destination{};
+    if (inet_pton(AF_INET, address.c_str(), &destination.Ipv4.sin_addr) == 1) {
+        destination.Ipv4.sin_family = AF_INET;
+    } else if (inet_pton(AF_INET6, address.c_str(), &destination.Ipv6.sin6_addr) == 1) {
+        destination.Ipv6.sin6_family = AF_INET6;
+    } else {
+        return false;
+    }
+
+    NET_LUID luid{};
+    if (!outsideRoute(destination, tunnel, luid, source_)) {
+        WG_LOG_WARN("PathMtuProber: No route to {} outside the tunnel", address);
+        return false;
+    }
+    MIB_IPINTERFACE_ROW row;
+    InitializeIpInterfaceEntry(&row);
+    row.Family = destination.si_family;
+    row.InterfaceLuid = luid;
+    if (GetIpInterfaceEntry(&row) != NO_ERROR) {
+        return false;
+    }
+
+    icmp_ = destination.si_family == AF_INET6 ? Icmp6CreateFile() : IcmpCreateFile();
+    event_ = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (icmp_ == INVALID_HANDLE_VALUE || event_ == nullptr) {
+        WG_LOG_WARN("PathMtuProber: Could not open an ICMP handle. Error: {}", GetLastError());
+        close();
+        return false;
+    }
+    destination_ = destination;
+    interfaceMtu_ = row.NlMtu;
+    payload_.assign(interfaceMtu_, 0x5a);
+    reply_.assign(interfaceMtu_ + kReplySlack, 0);
+    return true;
+}
+
+void PathMtuProber::close() {
+    drain();
+    if (icmp_ != INVALID_HANDLE_VALUE) {
+        IcmpCloseHandle(icmp_);
+        icmp_ = INVALID_HANDLE_VALUE;
+    }
+    if (event_ != nullptr) {
+        CloseHandle(event_);
+        event_ = nullptr;
+    }
+    destination_ = SOCKADDR_INET{};
+    interfaceMtu_ = 0;
+}
+
+bool PathMtuProber::send(uint32_t size, std::chrono::milliseconds timeout, PmtuSearch::Outcome& outcome) {
+    drain();
+    uint32_t headers = ipv6() ? kIcmp6Headers : kIcmp4Headers;
+    if (icmp_ == INVALID_HANDLE_VALUE || size <= headers || size - headers > payload_.size()) {
+        outcome = PmtuSearch::Outcome::TooBig;
+        return false;
+    }
+    auto length = static_cast<WORD>(size - headers);
+    auto replySize = static_cast<DWORD>(reply_.size());
+    auto timeoutMs = static_cast<DWORD>(timeout.count());
+
+    IP_OPTION_INFORMATION options{};
+    options.Ttl = 128;
+    ResetEvent(event_);
+    DWORD replies;
+    if (ipv6()) {
+        replies = Icmp6SendEcho2(icmp_, event_, nullptr, nullptr, &source_.Ipv6, &destination_.Ipv6, payload_.data(),
+                                 length, &options, reply_.data(), replySize, timeoutMs);
+    } else {
+        options.Flags = IP_FLAG_DF;
+        replies = IcmpSendEcho2Ex(icmp_, event_, nullptr, nullptr, source_.Ipv4.sin_addr.S_un.S_addr,
+                                  destination_.Ipv4.sin_addr.S_un.S_addr, payload_.data(), length, &options,
+                                  reply_.data(), replySize, timeoutMs);
+    }
+    DWORD error = GetLastError();
+    if (replies == 0 && error == ERROR_IO_PENDING) {
+        pending_ = true;
+        timeout_ = timeout;
+        return true;
+    }
+    // Answered at once, or refused by the local stack
+    outcome = replies != 0 ? collect() : outcomeOf(error);
+    return false;
+}
+
+PmtuSearch::Outcome PathMtuProber::collect() {
+    pending_ = false;
+    auto size = static_cast<DWORD>(reply_.size());
+    DWORD status;
+    if (ipv6()) {
+        status = Icmp6ParseReplies(reply_.data(), size) > 0
+                     ? reinterpret_cast<const ICMPV6_ECHO_REPLY*>(reply_.data())->Status
+                     : GetLastError();
+    } else {
+        status = IcmpParseReplies(reply_.data(), size) > 0
+                     ? reinterpret_cast<const ICMP_ECHO_REPLY*>(reply_.data())->Status
+                     : GetLastError();
+    }
+    return outcomeOf(status);
+}
+
+void PathMtuProber::drain() {
+    if (!pending_) {
+        return;
+    }
+    // The system answers every echo within its timeout
+    WaitForSingleObject(event_, static_cast<DWORD>(timeout_.count()) + 1000);
+    pending_ = false;
+}
+
+} // namespace wireguard_flutter
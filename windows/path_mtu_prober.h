@@ -0,0 +1,64 @@
+#pragma once
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#include <ifdef.h>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "pmtu_search.h"
+#include "pmtu_searcher.h"
+
+namespace wireguard_flutter {
+
+// Sends the probes of a PmtuSearcher on Windows: ICMP echo requests of an
+// exact size, with Don't Fragment set on IPv4 (IPv6 routers never
+// fragment), from the interface the tunnel's own UDP packets leave on.
+//
+// With a tunnel routing everything, the best route to the endpoint is the
+// tunnel itself, so the probe is bound to the source address of the best
+// default route on any other interface instead. Echoes complete on a
+// manual-reset event for the EventLoop to wait on, and on their own at the
+// timeout; one is in flight at a time. Used on one thread.
+class PathMtuProber : public PmtuSearcher::Prober {
+public:
+    PathMtuProber() = default;
+    ~PathMtuProber() override;
+
+    PathMtuProber(const PathMtuProber&) = delete;
+    PathMtuProber& operator=(const PathMtuProber&) = delete;
+
+    // Targets |address|, an IPv4 or IPv6 literal, skipping |tunnel|'s
+    // interface when it is given. False without a route outside the tunnel.
+    bool open(const std::string& address, const NET_LUID* tunnel);
+    void close();
+
+    bool ipv6() const { return destination_.si_family == AF_INET6; }
+    // MTU of the interface the probes leave on; the search's ceiling
+    uint32_t interfaceMtu() const { return interfaceMtu_; }
+
+    // An echo |size| bytes long on the wire
+    bool send(uint32_t size, std::chrono::milliseconds timeout, PmtuSearch::Outcome& outcome) override;
+    EventLoop::Waitable waitable() const override { return event_; }
+    PmtuSearch::Outcome collect() override;
+
+private:
+    // An echo whose wait was cancelled may still write into reply_
+    void drain();
+
+    HANDLE icmp_ = INVALID_HANDLE_VALUE;
+    HANDLE event_ = nullptr;
+    SOCKADDR_INET destination_{};
+    SOCKADDR_INET source_{};
+    uint32_t interfaceMtu_ = 0;
+    std::vector<BYTE> payload_;
+    std::vector<BYTE> reply_;
+    bool pending_ = false;
+    std::chrono::milliseconds timeout_{0};
+};
+
+} // namespace wireguard_flutter
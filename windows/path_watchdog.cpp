@@ -0,0 +1,134 @@
+#include "path_watchdog.h"
+
+namespace wireguard_flutter {
+
+const char* PathWatchdog::causeName(Cause cause) {
+    switch (cause) {
+    case Cause::RxStall:
+        return "rx_stall";
+    case Cause::MissedKeepalive:
+        return "missed_keepalive";
+    case Cause::StaleHandshake:
+        return "stale_handshake";
+    case Cause::None:
+    default:
+        return "none";
+    }
+}
+
+void PathWatchdog::configure(const Options& options) {
+    options_ = options;
+    if (!options_.enabled) {
+        reset();
+    }
+}
+
+void PathWatchdog::reset() {
+    status_ = Status::Healthy;
+    cause_ = Cause::None;
+    primed_ = false;
+    failedOver_ = false;
+    clearUnanswered();
+}
+
+void PathWatchdog::onFailedOver(Clock::time_point at) {
+    if (status_ == Status::Degraded) {
+        failedOver_ = false;
+        failoverSince_ = at;
+    }
+}
+
+void PathWatchdog::clearUnanswered() {
+    unansweredPackets_ = 0;
+    unansweredBytes_ = 0;
+}
+
+PathWatchdog::Verdict PathWatchdog::addSample(const Sample& sample) {
+    Verdict verdict;
+    if (!options_.enabled) {
+        return verdict;
+    }
+    if (!primed_ || sample.packetsIn < previous_.packetsIn || sample.packetsOut < previous_.packetsOut ||
+        sample.bytesOut < previous_.bytesOut) {
+        // First sample, or the adapter was recreated; nothing to compare yet
+        primed_ = true;
+        previous_ = sample;
+        clearUnanswered();
+        return verdict;
+    }
+
+    uint64_t received = sample.packetsIn - previous_.packetsIn;
+    uint64_t sentPackets = sample.packetsOut - previous_.packetsOut;
+    uint64_t sentBytes = sample.bytesOut - previous_.bytesOut;
+    previous_ = sample;
+
+    if (received > 0) {
+        clearUnanswered();
+        if (status_ == Status::Degraded) {
+            verdict.action = Action::Recovered;
+            verdict.cause = cause_;
+            verdict.degradedFor = std::chrono::duration_cast<std::chrono::milliseconds>(sample.at - degradedAt_);
+        }
+        status_ = Status::Healthy;
+        cause_ = Cause::None;
+        return verdict;
+    }
+
+    if (sentPackets > 0) {
+        if (unansweredPackets_ == 0) {
+            unansweredSince_ = sample.at;
+        }
+        unansweredPackets_ += sentPackets;
+        unansweredBytes_ += sentBytes;
+    }
+
+    if (status_ == Status::Degraded) {
+        verdict.cause = cause_;
+        // The peer completed a handshake after the path degraded, so it is
+        // reachable; what was sent simply needed no answer
+        if (sample.handshakeAgeMs >= 0 && sample.at - std::chrono::milliseconds(sample.handshakeAgeMs) >= degradedAt_) {
+            verdict.action = Action::Recovered;
+            verdict.degradedFor = std::chrono::duration_cast<std::chrono::milliseconds>(sample.at - degradedAt_);
+            status_ = Status::Healthy;
+            cause_ = Cause::None;
+            clearUnanswered();
+        } else if (!failedOver_ && sample.at - failoverSince_ >= options_.failoverAfter) {
+            failedOver_ = true;
+            verdict.action = Action::Failover;
+        }
+        return verdict;
+    }
+
+    if (unansweredPackets_ == 0 || unansweredBytes_ == 0) {
+        status_ = Status::Healthy;
+        return verdict;
+    }
+    status_ = Status::Suspect;
+
+    // Measured from the first sample that showed unanswered traffic, so the
+    // evidence is never overstated by a long gap between samples
+    auto waited = sample.at - unansweredSince_;
+    Cause cause = Cause::None;
+    if (sample.handshakeAgeMs > options_.staleHandshakeMs) {
+        cause = Cause::StaleHandshake;
+    } else if (waited >= options_.keepaliveTimeout) {
+        cause = Cause::MissedKeepalive;
+    } else if (waited >= options_.stallThreshold && unansweredPackets_ >= options_.minTxPackets &&
+               unansweredBytes_ >= options_.minTxBytes) {
+        cause = Cause::RxStall;
+    }
+    if (cause == Cause::None) {
+        return verdict;
+    }
+
+    status_ = Status::Degraded;
+    cause_ = cause;
+    degradedAt_ = sample.at;
+    failoverSince_ = sample.at;
+    failedOver_ = false;
+    verdict.action = Action::Rehandshake;
+    verdict.cause = cause;
+    return verdict;
+}
+
+} // namespace wireguard_flutter
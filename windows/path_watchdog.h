@@ -0,0 +1,114 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace wireguard_flutter {
+
+// Tells a tunnel whose adapter is up but whose peer stopped answering from
+// one that is merely idle, from the interface counters and handshake age
+// the monitor samples anyway.
+//
+// Traffic sent without anything coming back makes the path suspect, and the
+// monitor then samples fast. It is degraded once any of these holds:
+//   - at least minTxPackets and minTxBytes went out, and for stallThreshold
+//     after a sample first showed them nothing came in
+//   - data went out and nothing came back for keepaliveTimeout; a live peer
+//     answers data with at least a keepalive after 10 s (KEEPALIVE_TIMEOUT)
+//   - data goes out on a session whose last handshake is older than
+//     WireGuard's REJECT_AFTER_TIME
+// Degrading asks for a rehandshake once. Anything received, or a handshake
+// newer than the degradation, ends it; failoverAfter without either asks
+// for a failover. Counters that go backwards (a recreated adapter) only
+// restart the baseline.
+//
+// Evidence is measured from sample times, never from a clock read here, so
+// the detector can be replayed against recorded traces. Not thread-safe; the
+// monitor tick drives it. Portable.
+class PathWatchdog {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Status : uint8_t { Healthy, Suspect, Degraded };
+
+    enum class Cause : uint8_t { None, RxStall, MissedKeepalive, StaleHandshake };
+
+    enum class Action : uint8_t {
+        None,
+        // Just degraded; force a new handshake
+        Rehandshake,
+        // Degraded and the rehandshake did not help
+        Failover,
+        // No longer degraded
+        Recovered,
+    };
+
+    struct Options {
+        bool enabled = true;
+        std::chrono::milliseconds stallThreshold{750};
+        uint64_t minTxPackets = 3;
+        // Three bare IPv4 headers; persistent keepalives carry no payload
+        uint64_t minTxBytes = 60;
+        std::chrono::milliseconds keepaliveTimeout{12000};
+        int64_t staleHandshakeMs = 180000;
+        std::chrono::milliseconds failoverAfter{6000};
+    };
+
+    struct Sample {
+        Clock::time_point at;
+        uint64_t bytesIn = 0;
+        uint64_t bytesOut = 0;
+        uint64_t packetsIn = 0;
+        uint64_t packetsOut = 0;
+        // -1 when no handshake has completed
+        int64_t handshakeAgeMs = -1;
+    };
+
+    struct Verdict {
+        Action action = Action::None;
+        Cause cause = Cause::None;
+        // With Recovered, how long the path was degraded
+        std::chrono::milliseconds degradedFor{0};
+    };
+
+    // Cause code used in logs and traces
+    static const char* causeName(Cause cause);
+
+    void configure(const Options& options);
+    const Options& options() const { return options_; }
+
+    Verdict addSample(const Sample& sample);
+
+    Status status() const { return status_; }
+    Cause cause() const { return cause_; }
+
+    // Forgets the baseline, e.g. when the tunnel reconnects
+    void reset();
+
+    // Traffic moved to another peer at |at| without a reconnect; a path
+    // still degraded failoverAfter later asks for a failover again
+    void onFailedOver(Clock::time_point at);
+
+private:
+    void clearUnanswered();
+
+    Options options_;
+    Status status_ = Status::Healthy;
+    Cause cause_ = Cause::None;
+
+    bool primed_ = false;
+    Sample previous_;
+
+    // Sent since the last sample that saw anything received
+    uint64_t unansweredPackets_ = 0;
+    uint64_t unansweredBytes_ = 0;
+    // First sample that showed them; they went out before it
+    Clock::time_point unansweredSince_{};
+
+    Clock::time_point degradedAt_{};
+    // Degradation or the last failover, whichever is later
+    Clock::time_point failoverSince_{};
+    bool failedOver_ = false;
+};
+
+} // namespace wireguard_flutter
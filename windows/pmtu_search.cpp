@@ -0,0 +1,65 @@
+#include "pmtu_search.h"
+
+#include <algorithm>
+
+namespace wireguard_flutter {
+
+namespace {
+
+// Outer IP header, UDP header, then WireGuard's type, receiver index and
+// counter (16 bytes) and the Poly1305 tag (16 bytes)
+constexpr uint32_t kUdpHeader = 8;
+constexpr uint32_t kWireGuardOverhead = 32;
+constexpr uint32_t kMinTunnelMtu = 576;
+
+} // namespace
+
+PmtuSearch::PmtuSearch() : PmtuSearch(Options()) {}
+
+PmtuSearch::PmtuSearch(const Options& options) : options_(options) {
+    options_.attempts = std::max<uint32_t>(options_.attempts, 1);
+    options_.precision = std::max<uint32_t>(options_.precision, 1);
+    options_.ceiling = std::max(options_.ceiling, options_.floor);
+    bad_ = options_.ceiling + 1;
+    current_ = options_.ceiling;
+}
+
+void PmtuSearch::onOutcome(uint32_t size, Outcome outcome) {
+    if (done() || size != current_) {
+        return;
+    }
+    probes_++;
+    switch (outcome) {
+    case Outcome::Reply:
+        good_ = std::max(good_, size);
+        break;
+    case Outcome::TooBig:
+        bad_ = std::min(bad_, size);
+        break;
+    case Outcome::Loss:
+        if (++losses_ < options_.attempts) {
+            // The same size again
+            return;
+        }
+        bad_ = std::min(bad_, size);
+        break;
+    }
+    losses_ = 0;
+    advance();
+}
+
+void PmtuSearch::advance() {
+    if (good_ == 0) {
+        // The ceiling failed; the floor tells whether anything answers
+        current_ = bad_ > options_.floor ? options_.floor : 0;
+        return;
+    }
+    current_ = bad_ - good_ > options_.precision ? good_ + (bad_ - good_) / 2 : 0;
+}
+
+uint32_t PmtuSearch::tunnelMtu(uint32_t pathMtu, bool ipv6) {
+    uint32_t overhead = (ipv6 ? 40 : 20) + kUdpHeader + kWireGuardOverhead;
+    return pathMtu > overhead + kMinTunnelMtu ? pathMtu - overhead : kMinTunnelMtu;
+}
+
+} // namespace wireguard_flutter
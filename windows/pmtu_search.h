@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+
+namespace wireguard_flutter {
+
+// Finds the largest packet that crosses a path unfragmented, from the
+// answers to probes of exact sizes sent with Don't Fragment.
+//
+// The ceiling, usually the outgoing interface's MTU, is tried first, since
+// most paths carry it; then the floor, to tell a path that does not answer
+// probes at all from one with a small MTU; then the sizes in between are
+// bisected. A "too big" error settles a size at once. A lost probe is
+// retried, and a size only counts as too big after |attempts| losses, so
+// ordinary loss costs a retry rather than a wrong result. Sizes are whole IP
+// packets, headers included.
+//
+// The caller sends next(), reports its outcome and repeats until done().
+// Nothing here sends, reads a clock or blocks. Not thread-safe. Portable.
+class PmtuSearch {
+public:
+    enum class Outcome : uint8_t {
+        Reply,
+        // No answer within the caller's timeout
+        Loss,
+        // Rejected by the local stack or a router ("fragmentation needed",
+        // "packet too big")
+        TooBig,
+    };
+
+    struct Options {
+        // 576 for IPv4 and 1280 for IPv6 are what every path must carry
+        uint32_t floor = 576;
+        uint32_t ceiling = 1500;
+        uint32_t attempts = 2;
+        // Stops once the bounds are this close
+        uint32_t precision = 1;
+    };
+
+    PmtuSearch();
+    explicit PmtuSearch(const Options& options);
+
+    // Size to probe next; 0 once done
+    uint32_t next() const { return current_; }
+    // Outcomes for any size but next() are ignored
+    void onOutcome(uint32_t size, Outcome outcome);
+
+    bool done() const { return current_ == 0; }
+    // Largest size answered; 0 when not even the floor was
+    uint32_t pathMtu() const { return good_; }
+    // Probes reported so far, retries included
+    uint32_t probes() const { return probes_; }
+
+    // MTU for a WireGuard interface whose packets travel in |pathMtu|:
+    // less the outer IP header, UDP and WireGuard's 32 bytes, and never
+    // under 576
+    static uint32_t tunnelMtu(uint32_t pathMtu, bool ipv6);
+
+private:
+    void advance();
+
+    Options options_;
+    uint32_t good_ = 0;
+    // Smallest size known not to pass
+    uint32_t bad_ = 0;
+    uint32_t current_ = 0;
+    uint32_t losses_ = 0;
+    uint32_t probes_ = 0;
+};
+
+} // namespace wireguard_flutter
@@ -0,0 +1,92 @@
+#include "pmtu_searcher.h"
+
+#include <utility>
+
+#include "logger.h"
+
+namespace wireguard_flutter {
+
+PmtuSearcher::PmtuSearcher(EventLoop& loop, Prober& prober) : loop_(loop), prober_(prober) {}
+
+PmtuSearcher::~PmtuSearcher() {
+    cancel();
+}
+
+void PmtuSearcher::start(const PmtuSearch::Options& options, std::chrono::milliseconds timeout, Done done) {
+    cancel();
+    search_ = PmtuSearch(options);
+    timeout_ = timeout;
+    done_ = std::move(done);
+    running_ = true;
+    sendNext();
+}
+
+void PmtuSearcher::cancel() {
+    running_ = false;
+    // A callback in progress may arm the next probe before it returns;
+    // cancelling it waits for that, and the second pass catches what it armed
+    for (int pass = 0; pass < 2; pass++) {
+        for (auto* task : {&wait_, &timer_}) {
+            if (EventLoop::TaskId id = task->exchange(0)) {
+                loop_.cancel(id);
+            }
+        }
+    }
+}
+
+void PmtuSearcher::sendNext() {
+    // Sizes the local stack refuses are settled without waiting
+    while (!search_.done()) {
+        uint32_t size = search_.next();
+        PmtuSearch::Outcome outcome = PmtuSearch::Outcome::Loss;
+        if (prober_.send(size, timeout_, outcome)) {
+            wait_ = loop_.addWait(prober_.waitable(), [this, size]() { onAnswer(size); });
+            if (wait_ == 0) {
+                WG_LOG_WARN("PmtuSearcher: Too many waits; giving up once the probe of {} bytes timed out", size);
+            }
+            timer_ = loop_.addTimer(timeout_, [this, size]() { onTimeout(size); });
+            return;
+        }
+        search_.onOutcome(size, outcome);
+    }
+    finish(false);
+}
+
+void PmtuSearcher::onAnswer(uint32_t size) {
+    wait_ = 0;
+    if (!running_) {
+        return;
+    }
+    // On the loop, so this does not wait
+    if (EventLoop::TaskId timer = timer_.exchange(0)) {
+        loop_.cancel(timer);
+    }
+    search_.onOutcome(size, prober_.collect());
+    sendNext();
+}
+
+void PmtuSearcher::onTimeout(uint32_t size) {
+    timer_ = 0;
+    if (!running_) {
+        return;
+    }
+    if (EventLoop::TaskId wait = wait_.exchange(0)) {
+        loop_.cancel(wait);
+    } else {
+        // Never waited for; its answer is unknown
+        finish(true);
+        return;
+    }
+    search_.onOutcome(size, PmtuSearch::Outcome::Loss);
+    sendNext();
+}
+
+void PmtuSearcher::finish(bool interrupted) {
+    running_ = false;
+    Done done = std::move(done_);
+    if (done) {
+        done(search_, interrupted);
+    }
+}
+
+} // namespace wireguard_flutter
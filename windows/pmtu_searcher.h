@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+#include "event_loop.h"
+#include "pmtu_search.h"
+
+namespace wireguard_flutter {
+
+// Runs a PmtuSearch on the EventLoop: sends next() through a Prober, waits
+// for the prober's waitable or the probe timeout, whichever comes first,
+// reports the outcome and repeats until the search is done.
+//
+// The Prober is PathMtuProber's ICMP echoes on Windows and a fake in tests.
+// When the loop has no room for a probe's wait, the search ends as
+// interrupted once that probe has timed out, so nothing learned from a
+// partial search is applied. Runs on the loop thread; cancel() may be
+// called from any thread. Portable.
+class PmtuSearcher {
+public:
+    // Sends probes of exact sizes, one in flight at a time
+    class Prober {
+    public:
+        virtual ~Prober() = default;
+
+        // Starts a probe |size| bytes long on the wire. True when it is in
+        // flight and waitable() will be signaled by its answer; otherwise
+        // |outcome| is known already, e.g. TooBig from the local stack.
+        virtual bool send(uint32_t size, std::chrono::milliseconds timeout, PmtuSearch::Outcome& outcome) = 0;
+        virtual EventLoop::Waitable waitable() const = 0;
+        // The outcome of the probe in flight, once waitable() is signaled
+        virtual PmtuSearch::Outcome collect() = 0;
+    };
+
+    // Called on the loop with the finished search; |interrupted| when it
+    // stopped early
+    using Done = std::function<void(const PmtuSearch& search, bool interrupted)>;
+
+    PmtuSearcher(EventLoop& loop, Prober& prober);
+    ~PmtuSearcher();
+
+    PmtuSearcher(const PmtuSearcher&) = delete;
+    PmtuSearcher& operator=(const PmtuSearcher&) = delete;
+
+    // Starts a search with |options|, cancelling one in progress; on the
+    // loop thread
+    void start(const PmtuSearch::Options& options, std::chrono::milliseconds timeout, Done done);
+    // Stops without calling |done|. From another thread, waits for a
+    // callback in progress.
+    void cancel();
+    bool running() const { return running_; }
+
+private:
+    void sendNext();
+    void onAnswer(uint32_t size);
+    void onTimeout(uint32_t size);
+    void finish(bool interrupted);
+
+    EventLoop& loop_;
+    Prober& prober_;
+    PmtuSearch search_;
+    std::chrono::milliseconds timeout_{0};
+    Done done_;
+    std::atomic<bool> running_{false};
+    // Probe in flight; a wait of 0 could not be registered
+    std::atomic<EventLoop::TaskId> wait_{0};
+    std::atomic<EventLoop::TaskId> timer_{0};
+};
+
+} // namespace wireguard_flutter
@@ -0,0 +1,183 @@
+#include "race_adapters.h"
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#include <cstring>
+#include <vector>
+
+#include "logger.h"
+#include "wg_quick_config.h"
+
+namespace wireguard_flutter {
+
+namespace {
+
+// Only sends the first initiation; the race is over long before it repeats
+constexpr WORD kProbeKeepalive = 25;
+
+bool parseEndpoint(const std::string& endpoint, SOCKADDR_INET& address) {
+    std::string host;
+    std::string port;
+    if (!WgQuickConfig::splitEndpoint(endpoint, host, port) || port.size() > 5 || std::stoul(port) > 65535) {
+        return false;
+    }
+    auto portNumber = htons(static_cast<USHORT>(std::stoul(port)));
+    address = SOCKADDR_INET{};
+    if (inet_pton(AF_INET, host.c_str(), &address.Ipv4.sin_addr) == 1) {
+        address.Ipv4.sin_family = AF_INET;
+        address.Ipv4.sin_port = portNumber;
+        return true;
+    }
+    if (inet_pton(AF_INET6, host.c_str(), &address.Ipv6.sin6_addr) == 1) {
+        address.Ipv6.sin6_family = AF_INET6;
+        address.Ipv6.sin6_port = portNumber;
+        return true;
+    }
+    return false;
+}
+
+// The interface of one slot: our private key and a peer per address,
+// without allowed IPs
+bool slotConfiguration(const EndpointRacer::Slot& slot, std::vector<BYTE>& config) {
+    BYTE presharedKey[WIREGUARD_KEY_LENGTH];
+    bool hasPresharedKey = WireGuardAdapter::decodeKey(slot.presharedKey, presharedKey);
+    config.assign(sizeof(WIREGUARD_INTERFACE) + slot.peers.size() * sizeof(WIREGUARD_PEER), 0);
+    auto* header = reinterpret_cast<WIREGUARD_INTERFACE*>(config.data());
+    header->Flags = static_cast<WIREGUARD_INTERFACE_FLAG>(WIREGUARD_INTERFACE_HAS_PRIVATE_KEY |
+                                                          WIREGUARD_INTERFACE_REPLACE_PEERS);
+    if (!WireGuardAdapter::decodeKey(slot.privateKey, header->PrivateKey)) {
+        return false;
+    }
+
+    auto* peer = reinterpret_cast<WIREGUARD_PEER*>(config.data() + sizeof(WIREGUARD_INTERFACE));
+    for (const auto& probe : slot.peers) {
+        if (!WireGuardAdapter::decodeKey(probe.publicKey, peer->PublicKey) ||
+            !parseEndpoint(probe.endpoint, peer->Endpoint)) {
+            return false;
+        }
+        int flags =
+            WIREGUARD_PEER_HAS_PUBLIC_KEY | WIREGUARD_PEER_HAS_ENDPOINT | WIREGUARD_PEER_HAS_PERSISTENT_KEEPALIVE;
+        if (hasPresharedKey) {
+            flags |= WIREGUARD_PEER_HAS_PRESHARED_KEY;
+            std::memcpy(peer->PresharedKey, presharedKey, WIREGUARD_KEY_LENGTH);
+        }
+        peer->Flags = static_cast<WIREGUARD_PEER_FLAG>(flags);
+        peer->PersistentKeepalive = kProbeKeepalive;
+        header->PeersCount++;
+        peer++;
+    }
+    return true;
+}
+
+} // namespace
+
+struct RaceAdapters::Work {
+    RaceAdapters* owner = nullptr;
+    std::function<void()> task;
+};
+
+RaceAdapters::~RaceAdapters() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this] { return working_ == 0; });
+    adapters_.clear();
+}
+
+void RaceAdapters::create(uint64_t race, size_t slot, const EndpointRacer::Slot& config,
+                          std::function<void(bool)> done) {
+    std::vector<BYTE> configuration;
+    if (!slotConfiguration(config, configuration)) {
+        WG_LOG_WARN("RaceAdapters: Slot {} of race {} has an invalid key or endpoint", slot, race);
+        done(false);
+        return;
+    }
+    auto task = [this, race, slot, configuration, done]() {
+        auto adapter = std::make_shared<WireGuardAdapter>();
+        std::wstring name = L"WireGuardRace" + std::to_wstring(race) + L"_" + std::to_wstring(slot);
+        bool created = adapter->create(name) && adapter->setConfiguration(configuration);
+        if (created) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            adapters_[Key(race, slot)] = adapter;
+        } else {
+            adapter->close();
+        }
+        done(created);
+    };
+    if (!submit(task)) {
+        done(false);
+    }
+}
+
+bool RaceAdapters::setUp(uint64_t race, size_t slot) {
+    auto adapter = find(race, slot);
+    return adapter && adapter->setUp(true);
+}
+
+bool RaceAdapters::hasHandshake(uint64_t race, size_t slot, const std::string& publicKey) {
+    BYTE key[WIREGUARD_KEY_LENGTH];
+    uint64_t lastHandshake = 0;
+    auto adapter = find(race, slot);
+    return adapter && WireGuardAdapter::decodeKey(publicKey, key) && adapter->queryPeerHandshake(key, lastHandshake) &&
+           lastHandshake != 0;
+}
+
+void RaceAdapters::close(uint64_t race, std::function<void()> done) {
+    std::vector<std::shared_ptr<WireGuardAdapter>> closing;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto first = adapters_.lower_bound(Key(race, 0));
+        auto last = first;
+        while (last != adapters_.end() && last->first.first == race) {
+            closing.push_back(std::move(last->second));
+            ++last;
+        }
+        adapters_.erase(first, last);
+    }
+    if (closing.empty()) {
+        done();
+        return;
+    }
+    // Removing an adapter waits for the driver, so it stays off the loop
+    auto task = [closing, done]() mutable {
+        closing.clear();
+        done();
+    };
+    if (!submit(task)) {
+        closing.clear();
+        done();
+    }
+}
+
+std::shared_ptr<WireGuardAdapter> RaceAdapters::find(uint64_t race, size_t slot) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = adapters_.find(Key(race, slot));
+    return found != adapters_.end() ? found->second : nullptr;
+}
+
+bool RaceAdapters::submit(std::function<void()> task) {
+    auto work = std::make_unique<Work>();
+    work->owner = this;
+    work->task = std::move(task);
+    // Held across the call, so the work finds itself counted
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!TrySubmitThreadpoolCallback(&RaceAdapters::runWork, work.get(), nullptr)) {
+        WG_LOG_ERROR("RaceAdapters: Failed to queue work. Error: {}", GetLastError());
+        return false;
+    }
+    work.release();
+    working_++;
+    return true;
+}
+
+VOID CALLBACK RaceAdapters::runWork(PTP_CALLBACK_INSTANCE, PVOID context) {
+    std::unique_ptr<Work> work(static_cast<Work*>(context));
+    work->task();
+    RaceAdapters* owner = work->owner;
+    work.reset();
+    // The owner may be gone once this returns
+    std::lock_guard<std::mutex> lock(owner->mutex_);
+    owner->working_--;
+    owner->idle_.notify_all();
+}
+
+} // namespace wireguard_flutter
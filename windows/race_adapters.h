@@ -0,0 +1,55 @@
+#pragma once
+
+#include <windows.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "endpoint_racer.h"
+#include "wireguard_adapter.h"
+
+namespace wireguard_flutter {
+
+// The EndpointRacer's backend on Windows: adapters of wireguard.dll this
+// process creates, named after the race and slot. Creating and removing
+// them takes a while, so it runs on the system thread pool, one work item
+// per adapter; peers' handshakes are read on the loop.
+//
+// Shared by every tunnel's races. Destroying it waits for the work in
+// flight, which still answers.
+class RaceAdapters : public EndpointRacer::Backend {
+public:
+    RaceAdapters() = default;
+    ~RaceAdapters() override;
+
+    RaceAdapters(const RaceAdapters&) = delete;
+    RaceAdapters& operator=(const RaceAdapters&) = delete;
+
+    void create(uint64_t race, size_t slot, const EndpointRacer::Slot& config, std::function<void(bool)> done) override;
+    bool setUp(uint64_t race, size_t slot) override;
+    bool hasHandshake(uint64_t race, size_t slot, const std::string& publicKey) override;
+    void close(uint64_t race, std::function<void()> done) override;
+
+private:
+    using Key = std::pair<uint64_t, size_t>;
+    struct Work;
+
+    std::shared_ptr<WireGuardAdapter> find(uint64_t race, size_t slot);
+    // Runs |task| on the thread pool; false when it could not be queued
+    bool submit(std::function<void()> task);
+    static VOID CALLBACK runWork(PTP_CALLBACK_INSTANCE instance, PVOID context);
+
+    std::mutex mutex_;
+    std::condition_variable idle_;
+    size_t working_ = 0;
+    std::map<Key, std::shared_ptr<WireGuardAdapter>> adapters_;
+};
+
+} // namespace wireguard_flutter
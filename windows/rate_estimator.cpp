@@ -0,0 +1,110 @@
+#include "rate_estimator.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace wireguard_flutter {
+
+RateEstimator::RateEstimator() : RateEstimator(Options()) {}
+
+RateEstimator::RateEstimator(const Options& options) {
+    configure(options);
+}
+
+void RateEstimator::configure(const Options& options) {
+    size_t previousWindow = options_.windowSamples;
+    options_ = options;
+    options_.windowSamples = std::min(std::max<size_t>(options_.windowSamples, 1), kMaxWindowSamples);
+    options_.counterBits = std::min(std::max(options_.counterBits, 8u), 64u);
+
+    if (options_.windowSamples != previousWindow) {
+        windowCount_ = 0;
+        windowNext_ = 0;
+        rates_.peakBps = rates_.p50Bps = rates_.p95Bps = 0;
+    }
+}
+
+void RateEstimator::reset() {
+    hasBaseline_ = false;
+    lastCounter_ = 0;
+    lastTime_ = Clock::time_point{};
+    smoothed_ = 0.0;
+    windowCount_ = 0;
+    windowNext_ = 0;
+    rates_ = Rates{};
+}
+
+uint64_t RateEstimator::counterDelta(uint64_t counter) const {
+    if (counter >= lastCounter_) {
+        return counter - lastCounter_;
+    }
+
+    if (options_.counterBits < 64) {
+        uint64_t range = uint64_t{1} << options_.counterBits;
+        // Only a drop from the upper half of the range counts as a wrap
+        if (lastCounter_ >= range / 2 && lastCounter_ < range) {
+            return (range - lastCounter_) + counter;
+        }
+    }
+
+    // Counter was reset (adapter recreated); everything it holds is new
+    return counter;
+}
+
+bool RateEstimator::addSample(uint64_t counter, Clock::time_point now) {
+    if (!hasBaseline_) {
+        hasBaseline_ = true;
+        lastCounter_ = counter;
+        lastTime_ = now;
+        return false;
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - lastTime_);
+    if (elapsed.count() <= 0) {
+        return false;
+    }
+
+    double seconds = elapsed.count() / 1e6;
+    double instant = counterDelta(counter) / seconds;
+
+    lastCounter_ = counter;
+    lastTime_ = now;
+
+    // Irregular intervals are weighted by their length
+    if (options_.ewmaTimeConstant.count() > 0 && windowCount_ > 0) {
+        double tau = options_.ewmaTimeConstant.count() / 1000.0;
+        double alpha = 1.0 - std::exp(-seconds / tau);
+        smoothed_ += alpha * (instant - smoothed_);
+    } else {
+        smoothed_ = instant;
+    }
+
+    rates_.instantBps = static_cast<uint64_t>(instant);
+    rates_.smoothedBps = static_cast<uint64_t>(smoothed_);
+
+    window_[windowNext_] = rates_.instantBps;
+    windowNext_ = (windowNext_ + 1) % options_.windowSamples;
+    windowCount_ = std::min(windowCount_ + 1, options_.windowSamples);
+    updateWindowStats();
+
+    return true;
+}
+
+void RateEstimator::updateWindowStats() {
+    auto begin = scratch_.begin();
+    auto end = begin + windowCount_;
+    std::copy(window_.begin(), window_.begin() + windowCount_, begin);
+
+    // Nearest-rank percentiles; each nth_element partitions the range so the
+    // later, higher ranks only need to search above the previous one
+    size_t p50 = (windowCount_ - 1) / 2;
+    size_t p95 = (windowCount_ * 95 + 99) / 100 - 1;
+
+    std::nth_element(begin, begin + p50, end);
+    rates_.p50Bps = *(begin + p50);
+    std::nth_element(begin + p50, begin + p95, end);
+    rates_.p95Bps = *(begin + p95);
+    rates_.peakBps = *std::max_element(begin + p95, end);
+}
+
+} // namespace wireguard_flutter
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace wireguard_flutter {
+
+// Derives byte rates from a cumulative counter sampled on the monotonic clock.
+//
+// Besides the raw rate of the last interval it keeps an EWMA-smoothed rate and
+// a sliding window of recent interval rates for peak and p50/p95. Everything
+// lives in fixed storage so a sample never allocates. Portable; no Windows
+// dependencies.
+class RateEstimator {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t kMaxWindowSamples = 300;
+
+    struct Options {
+        // Time constant of the exponential smoothing; zero disables smoothing
+        std::chrono::milliseconds ewmaTimeConstant{3000};
+        // Number of interval rates kept for peak and percentiles
+        size_t windowSamples = 60;
+        // Width of the sampled counter. A decrease of a narrower counter near
+        // its limit is a wrap; any other decrease means the counter was reset.
+        unsigned counterBits = 64;
+    };
+
+    struct Rates {
+        uint64_t instantBps = 0;
+        uint64_t smoothedBps = 0;
+        uint64_t peakBps = 0;
+        uint64_t p50Bps = 0;
+        uint64_t p95Bps = 0;
+    };
+
+    RateEstimator();
+    explicit RateEstimator(const Options& options);
+
+    // Applies new options. Clears the window when its size changes.
+    void configure(const Options& options);
+    const Options& options() const { return options_; }
+
+    // Forgets all samples, e.g. when a new session starts.
+    void reset();
+
+    // Feeds the counter value read at |now|. Returns true when a new interval
+    // rate was produced; the first sample only sets the baseline.
+    bool addSample(uint64_t counter, Clock::time_point now);
+
+    const Rates& rates() const { return rates_; }
+
+private:
+    uint64_t counterDelta(uint64_t counter) const;
+    void updateWindowStats();
+
+    Options options_;
+    Rates rates_;
+
+    bool hasBaseline_ = false;
+    uint64_t lastCounter_ = 0;
+    Clock::time_point lastTime_;
+    double smoothed_ = 0.0;
+
+    std::array<uint64_t, kMaxWindowSamples> window_{};
+    std::array<uint64_t, kMaxWindowSamples> scratch_{};
+    size_t windowCount_ = 0;
+    size_t windowNext_ = 0;
+};
+
+} // namespace wireguard_flutter
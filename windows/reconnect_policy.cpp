@@ -0,0 +1,160 @@
+#include "reconnect_policy.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace wireguard_flutter {
+
+ReconnectPolicy::ReconnectPolicy(uint64_t seed) : random_(seed) {}
+
+const char* ReconnectPolicy::reasonName(Reason reason) {
+    switch (reason) {
+    case Reason::ServiceExited:
+        return "service_exited";
+    case Reason::NetworkChange:
+        return "network_change";
+    case Reason::PathDead:
+        return "path_dead";
+    case Reason::LinkLost:
+    default:
+        return "link_lost";
+    }
+}
+
+void ReconnectPolicy::configure(const Options& options) {
+    options_ = options;
+    options_.multiplier = std::max(options_.multiplier, 1.0);
+    options_.jitter = std::clamp(options_.jitter, 0.0, 1.0);
+    options_.maxBackoff = std::max(options_.maxBackoff, options_.initialBackoff);
+    if (!options_.enabled) {
+        reset();
+    }
+}
+
+void ReconnectPolicy::onLost(Reason reason, Clock::time_point now) {
+    if (!options_.enabled || recovering()) {
+        return;
+    }
+    phase_ = Phase::Backoff;
+    reason_ = reason;
+    since_ = now;
+    attempts_ = 0;
+    due_ = now + backoff(0);
+}
+
+void ReconnectPolicy::onNetworkChange(Clock::time_point now, bool connected) {
+    if (!options_.enabled) {
+        return;
+    }
+    switch (phase_) {
+    case Phase::Backoff:
+        // The old path is gone either way; the new one is worth trying now
+        due_ = std::min(due_, now + options_.networkSettle);
+        break;
+    case Phase::Settle:
+        due_ = std::min(now + options_.networkSettle, since_ + 4 * options_.networkSettle);
+        break;
+    case Phase::Idle:
+    case Phase::Roam:
+        if (connected) {
+            phase_ = Phase::Settle;
+            since_ = now;
+            due_ = now + options_.networkSettle;
+        }
+        break;
+    case Phase::Attempt:
+        break;
+    }
+}
+
+std::optional<ReconnectPolicy::Recovery> ReconnectPolicy::onRecovered(Clock::time_point now) {
+    Recovery recovery;
+    recovery.recovered = true;
+    recovery.duration = std::chrono::duration_cast<std::chrono::milliseconds>(now - since_);
+    if (recovering()) {
+        recovery.reason = reason_;
+        recovery.attempts = attempts_;
+    } else if (roaming()) {
+        recovery.reason = Reason::NetworkChange;
+    } else {
+        return std::nullopt;
+    }
+    reset();
+    return recovery;
+}
+
+ReconnectPolicy::Step ReconnectPolicy::onAttemptFailed(Clock::time_point now) {
+    if (phase_ != Phase::Attempt) {
+        return Step{};
+    }
+    return failAttempt(now);
+}
+
+ReconnectPolicy::Step ReconnectPolicy::poll(Clock::time_point now) {
+    Step step;
+    if (now < due_) {
+        return step;
+    }
+    switch (phase_) {
+    case Phase::Backoff:
+        attempts_++;
+        phase_ = Phase::Attempt;
+        due_ = now + options_.attemptTimeout;
+        step.action = Action::Restart;
+        break;
+    case Phase::Attempt:
+        step = failAttempt(now);
+        break;
+    case Phase::Settle:
+        phase_ = Phase::Roam;
+        due_ = now + options_.roamTimeout;
+        step.action = Action::Roam;
+        break;
+    case Phase::Roam:
+    case Phase::Idle:
+        reset();
+        break;
+    }
+    return step;
+}
+
+void ReconnectPolicy::reset() {
+    phase_ = Phase::Idle;
+    due_ = Clock::time_point::max();
+    attempts_ = 0;
+}
+
+std::chrono::milliseconds ReconnectPolicy::backoff(uint32_t attempt) {
+    double initial = static_cast<double>(options_.initialBackoff.count());
+    double limit = static_cast<double>(options_.maxBackoff.count());
+    // pow overflows to infinity long after min() has capped it
+    double delay = std::min(initial * std::pow(options_.multiplier, static_cast<double>(attempt)), limit);
+    double jittered = delay * (1.0 - options_.jitter * nextUnit());
+    return std::chrono::milliseconds(static_cast<int64_t>(jittered));
+}
+
+ReconnectPolicy::Step ReconnectPolicy::failAttempt(Clock::time_point now) {
+    Step step;
+    if (options_.maxAttempts != 0 && attempts_ >= options_.maxAttempts) {
+        step.action = Action::GiveUp;
+        step.outcome.reason = reason_;
+        step.outcome.duration = std::chrono::duration_cast<std::chrono::milliseconds>(now - since_);
+        step.outcome.attempts = attempts_;
+        reset();
+        return step;
+    }
+    phase_ = Phase::Backoff;
+    due_ = now + backoff(attempts_);
+    return step;
+}
+
+// splitmix64; only needs to keep tunnels apart, not be unpredictable
+double ReconnectPolicy::nextUnit() {
+    uint64_t z = (random_ += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    return static_cast<double>(z >> 11) * 0x1.0p-53;
+}
+
+} // namespace wireguard_flutter
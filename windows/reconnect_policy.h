@@ -0,0 +1,125 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+namespace wireguard_flutter {
+
+// Decides when a tunnel that lost its link is restarted and when a network
+// change re-applies the peer endpoints, so a roam gets a fresh handshake
+// instead of waiting for the next rekey.
+//
+// A lost tunnel is retried with exponential backoff and "equal jitter":
+// each delay is drawn from [(1 - jitter) * d, d], where d doubles per attempt
+// up to maxBackoff, so tunnels that dropped together do not retry in step.
+// An attempt that does not bring the adapter up within attemptTimeout counts
+// as failed. A network change while backing off brings the next attempt
+// forward; while connected, changes are debounced by networkSettle (but never
+// for more than four times that) and then turned into one roam.
+//
+// Nothing here reads a clock or blocks: every call takes the current time,
+// and the caller arms a timer for nextDue() and calls poll() when it fires.
+// Not thread-safe; the tunnel drives it from its event loop. Portable.
+class ReconnectPolicy {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Reason : uint8_t { LinkLost, ServiceExited, NetworkChange, PathDead };
+
+    enum class Action : uint8_t {
+        None,
+        // Re-apply the peer endpoints
+        Roam,
+        // Restart the tunnel service
+        Restart,
+        // maxAttempts failed; stop recovering
+        GiveUp,
+    };
+
+    struct Options {
+        bool enabled = true;
+        std::chrono::milliseconds initialBackoff{1000};
+        std::chrono::milliseconds maxBackoff{60000};
+        double multiplier = 2.0;
+        // Fraction of each delay that is randomized, 0 to 1
+        double jitter = 0.5;
+        // Failed attempts before giving up; 0 retries until stopped
+        uint32_t maxAttempts = 0;
+        std::chrono::milliseconds attemptTimeout{20000};
+        std::chrono::milliseconds networkSettle{500};
+        // A roam without a fresh handshake this long is dropped silently
+        std::chrono::milliseconds roamTimeout{30000};
+    };
+
+    // A finished recovery: from the loss or network change to the adapter
+    // being up again, or to the first handshake after a roam
+    struct Recovery {
+        Reason reason = Reason::LinkLost;
+        std::chrono::milliseconds duration{0};
+        uint32_t attempts = 0;
+        bool recovered = false;
+    };
+
+    struct Step {
+        Action action = Action::None;
+        // Set with GiveUp
+        Recovery outcome;
+    };
+
+    explicit ReconnectPolicy(uint64_t seed = 0);
+
+    // Reason code sent to Dart
+    static const char* reasonName(Reason reason);
+
+    void configure(const Options& options);
+    const Options& options() const { return options_; }
+
+    // Lost and not given up yet
+    bool recovering() const { return phase_ == Phase::Backoff || phase_ == Phase::Attempt; }
+    // Endpoints re-applied, waiting for a handshake newer than roamStart()
+    bool roaming() const { return phase_ == Phase::Roam; }
+    Clock::time_point roamStart() const { return since_; }
+
+    // Starts a recovery unless one is running; a pending roam is dropped
+    void onLost(Reason reason, Clock::time_point now);
+
+    // |connected| tells whether the tunnel is up; changes while connecting
+    // or during an attempt are ignored
+    void onNetworkChange(Clock::time_point now, bool connected);
+
+    // The adapter is up again, or a roam saw a fresh handshake
+    std::optional<Recovery> onRecovered(Clock::time_point now);
+
+    // The attempt poll() asked for failed before its timeout, e.g. the
+    // service did not start or exited again
+    Step onAttemptFailed(Clock::time_point now);
+
+    // When poll() next has something to do; Clock::time_point::max() when
+    // nothing is pending
+    Clock::time_point nextDue() const { return due_; }
+    Step poll(Clock::time_point now);
+
+    // Forgets any recovery or roam, e.g. when the tunnel is stopped
+    void reset();
+
+    // Jittered delay before attempt |attempt|, counted from 0
+    std::chrono::milliseconds backoff(uint32_t attempt);
+
+private:
+    enum class Phase : uint8_t { Idle, Backoff, Attempt, Settle, Roam };
+
+    Step failAttempt(Clock::time_point now);
+    double nextUnit();
+
+    Options options_;
+    Phase phase_ = Phase::Idle;
+    Reason reason_ = Reason::LinkLost;
+    // When the loss, or the first network change of a roam, happened
+    Clock::time_point since_{};
+    Clock::time_point due_ = Clock::time_point::max();
+    uint32_t attempts_ = 0;
+    uint64_t random_;
+};
+
+} // namespace wireguard_flutter
@@ -0,0 +1,190 @@
+#include "resolver_cache.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace wireguard_flutter {
+
+ResolverCache::ResolverCache(Resolver resolver) : ResolverCache(std::move(resolver), Options()) {}
+
+ResolverCache::ResolverCache(Resolver resolver, const Options& options)
+    : resolver_(std::move(resolver)), state_(std::make_shared<State>()) {
+    state_->options = options;
+}
+
+void ResolverCache::prefetch(const std::vector<std::string>& hosts, Clock::time_point now) {
+    std::vector<std::string> queries;
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        for (const auto& host : hosts) {
+            if (host.empty()) {
+                continue;
+            }
+            if (claimQuery(state_->entries[host], now)) {
+                queries.push_back(host);
+            }
+        }
+    }
+    // Outside the lock, since a resolver may answer before returning
+    for (const auto& host : queries) {
+        query(host, now);
+    }
+}
+
+std::vector<std::string> ResolverCache::lookup(const std::string& host, Clock::time_point now) {
+    bool start = false;
+    std::vector<std::string> addresses;
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        addresses = lookupLocked(state_->entries[host], now, start);
+    }
+    if (start) {
+        query(host, now);
+    }
+    return addresses;
+}
+
+std::vector<std::string> ResolverCache::resolve(const std::string& host, Clock::time_point now,
+                                                Clock::time_point deadline) {
+    std::unique_lock<std::mutex> lock(state_->mutex);
+    auto& entry = state_->entries[host];
+    bool start = false;
+    auto addresses = lookupLocked(entry, now, start);
+    if (!addresses.empty() || (!start && !entry.inFlight)) {
+        lock.unlock();
+        if (start) {
+            query(host, now);
+        }
+        return addresses;
+    }
+
+    const uint64_t answers = entry.answers;
+    if (start) {
+        lock.unlock();
+        query(host, now);
+        lock.lock();
+    }
+    state_->answered.wait_until(lock, deadline, [&] { return entry.answers != answers; });
+    return entry.answers != answers ? entry.addresses : std::vector<std::string>();
+}
+
+void ResolverCache::whenResolved(const std::vector<std::string>& hosts, Clock::time_point now,
+                                 std::function<void()> ready) {
+    auto waiter = std::make_shared<Waiter>();
+    waiter->ready = std::move(ready);
+    std::vector<std::string> queries;
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        std::vector<std::string> names = hosts;
+        std::sort(names.begin(), names.end());
+        names.erase(std::unique(names.begin(), names.end()), names.end());
+        for (const auto& host : names) {
+            if (host.empty()) {
+                continue;
+            }
+            auto& entry = state_->entries[host];
+            bool start = false;
+            auto addresses = lookupLocked(entry, now, start);
+            if (start) {
+                queries.push_back(host);
+            }
+            if (addresses.empty() && entry.inFlight) {
+                state_->waiters[host].push_back(waiter);
+                waiter->pending++;
+            }
+        }
+        // Otherwise the last of the answers runs it
+        if (waiter->pending != 0) {
+            waiter.reset();
+        }
+    }
+    if (waiter) {
+        waiter->ready();
+    }
+    for (const auto& host : queries) {
+        query(host, now);
+    }
+}
+
+void ResolverCache::expireAll() {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    for (auto& entry : state_->entries) {
+        entry.second.expires = Clock::time_point();
+        entry.second.retryAt = Clock::time_point();
+    }
+}
+
+ResolverCache::Stats ResolverCache::stats() const {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    return state_->stats;
+}
+
+bool ResolverCache::claimQuery(Entry& entry, Clock::time_point now) {
+    if (now < entry.expires || entry.inFlight || now < entry.retryAt) {
+        return false;
+    }
+    entry.inFlight = true;
+    ++state_->stats.queries;
+    return true;
+}
+
+std::vector<std::string> ResolverCache::lookupLocked(Entry& entry, Clock::time_point now, bool& start) {
+    if (!entry.addresses.empty() && now < entry.expires) {
+        ++state_->stats.fresh;
+        return entry.addresses;
+    }
+    start = claimQuery(entry, now);
+    if (!entry.addresses.empty() && now < entry.usableUntil) {
+        ++state_->stats.stale;
+        return entry.addresses;
+    }
+    ++state_->stats.misses;
+    return {};
+}
+
+void ResolverCache::query(const std::string& host, Clock::time_point now) {
+    std::shared_ptr<State> state = state_;
+    resolver_(host, [state, host, now](Answer answer) {
+        std::vector<std::shared_ptr<Waiter>> ready;
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            store(*state, host, answer, now);
+            auto waiting = state->waiters.find(host);
+            if (waiting != state->waiters.end()) {
+                for (auto& waiter : waiting->second) {
+                    if (--waiter->pending == 0) {
+                        ready.push_back(std::move(waiter));
+                    }
+                }
+                state->waiters.erase(waiting);
+            }
+        }
+        state->answered.notify_all();
+        for (const auto& waiter : ready) {
+            waiter->ready();
+        }
+    });
+}
+
+void ResolverCache::store(State& state, const std::string& host, const Answer& answer, Clock::time_point now) {
+    auto& entry = state.entries[host];
+    entry.inFlight = false;
+    ++entry.answers;
+
+    // The time the query started stands in for the time of the answer, which
+    // errs on the short side
+    if (answer.ok && !answer.addresses.empty()) {
+        const auto ttl = std::min(std::max(answer.ttl, state.options.minTtl), state.options.maxTtl);
+        entry.addresses = answer.addresses;
+        entry.expires = now + ttl;
+        entry.usableUntil = entry.expires + state.options.staleFor;
+        entry.retryAt = Clock::time_point();
+        return;
+    }
+    entry.retryAt = now + state.options.negativeTtl;
+    if (now >= entry.usableUntil) {
+        entry.addresses.clear();
+    }
+}
+
+} // namespace wireguard_flutter
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace wireguard_flutter {
+
+// Caches the addresses of endpoint host names with their DNS TTL, so a
+// connect can hand the tunnel service literal addresses without waiting on
+// DNS, and a reconnect never does.
+//
+// An answer is fresh for its TTL, clamped to minTtl..maxTtl; a failure is
+// remembered for negativeTtl so a dead name is not queried in a loop. An
+// expired answer is still served for up to staleFor while a refresh runs in
+// the background (stale-while-revalidate), so only a name never resolved,
+// or stale for longer than that, makes resolve() wait. A failed refresh
+// keeps the stale answer.
+//
+// Queries go through a Resolver that may answer from any thread, and at
+// most one per name is in flight, so resolving many names at once is up to
+// the resolver. The current time is passed in, so tests can drive it.
+// Thread-safe. Portable.
+class ResolverCache {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Answer {
+        bool ok = false;
+        // Address literals in order of preference
+        std::vector<std::string> addresses;
+        // Smallest TTL of the records
+        std::chrono::seconds ttl{0};
+    };
+
+    // Starts a query for |host| and calls |done| exactly once, from any
+    // thread, possibly before returning
+    using Resolver = std::function<void(const std::string& host, std::function<void(Answer)> done)>;
+
+    struct Options {
+        std::chrono::seconds minTtl{30};
+        std::chrono::seconds maxTtl{3600};
+        std::chrono::seconds negativeTtl{10};
+        std::chrono::seconds staleFor{86400};
+    };
+
+    struct Stats {
+        uint64_t fresh = 0;
+        uint64_t stale = 0;
+        uint64_t misses = 0;
+        uint64_t queries = 0;
+    };
+
+    explicit ResolverCache(Resolver resolver);
+    ResolverCache(Resolver resolver, const Options& options);
+
+    ResolverCache(const ResolverCache&) = delete;
+    ResolverCache& operator=(const ResolverCache&) = delete;
+
+    // Starts queries for the names that are not fresh; returns at once
+    void prefetch(const std::vector<std::string>& hosts, Clock::time_point now);
+
+    // Cached addresses of |host|, possibly stale; starts a refresh when they
+    // are not fresh. Empty when nothing usable is cached.
+    std::vector<std::string> lookup(const std::string& host, Clock::time_point now);
+
+    // Like lookup(), but when nothing usable is cached waits for the query
+    // until |deadline|
+    std::vector<std::string> resolve(const std::string& host, Clock::time_point now, Clock::time_point deadline);
+
+    // Calls |ready| once every name in |hosts| has usable addresses cached
+    // or its query has answered, starting the queries that are needed; a
+    // name that failed recently is not waited for. |ready| runs on the
+    // thread of the last answer, or before returning when nothing has to be
+    // waited for. Never blocks: the caller bounds the wait with its own
+    // timer and reads the addresses with lookup().
+    void whenResolved(const std::vector<std::string>& hosts, Clock::time_point now, std::function<void()> ready);
+
+    // Makes every answer stale, e.g. after a network change; they are still
+    // served while refreshed
+    void expireAll();
+
+    Stats stats() const;
+
+private:
+    struct Entry {
+        std::vector<std::string> addresses;
+        // Fresh until, and usable until
+        Clock::time_point expires{};
+        Clock::time_point usableUntil{};
+        // No query before this after a failure
+        Clock::time_point retryAt{};
+        bool inFlight = false;
+        // Bumped per answer, so waiters notice one arrived
+        uint64_t answers = 0;
+    };
+
+    // A whenResolved() call still waiting for |pending| names
+    struct Waiter {
+        size_t pending = 0;
+        std::function<void()> ready;
+    };
+
+    // Shared with queries in flight, which may answer after the cache is gone
+    struct State {
+        Options options;
+        mutable std::mutex mutex;
+        std::condition_variable answered;
+        std::map<std::string, Entry> entries;
+        std::map<std::string, std::vector<std::shared_ptr<Waiter>>> waiters;
+        Stats stats;
+    };
+
+    // Under the lock: true when a query for a stale |entry| should start,
+    // which is then marked in flight
+    bool claimQuery(Entry& entry, Clock::time_point now);
+    // Under the lock: counts the lookup and claims a query when needed
+    std::vector<std::string> lookupLocked(Entry& entry, Clock::time_point now, bool& start);
+    // Without the lock
+    void query(const std::string& host, Clock::time_point now);
+    static void store(State& state, const std::string& host, const Answer& answer, Clock::time_point now);
+
+    Resolver resolver_;
+    std::shared_ptr<State> state_;
+};
+
+} // namespace wireguard_flutter
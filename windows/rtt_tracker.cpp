@@ -0,0 +1,117 @@
+#include "rtt_tracker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace wireguard_flutter {
+
+namespace {
+
+// Nearest rank in |sorted|, which is not empty
+int64_t percentile(const std::vector<int64_t>& sorted, double fraction) {
+    auto rank = static_cast<size_t>(std::ceil(fraction * static_cast<double>(sorted.size())));
+    return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+} // namespace
+
+RttTracker::RttTracker() : RttTracker(Options()) {}
+
+RttTracker::RttTracker(const Options& options) {
+    configure(options);
+}
+
+void RttTracker::configure(const Options& options) {
+    options_ = options;
+    options_.window = std::max<uint32_t>(options_.window, 1);
+    options_.timeout = std::max(options_.timeout, std::chrono::milliseconds(1));
+    reset();
+}
+
+void RttTracker::reset() {
+    pending_.clear();
+    settled_.clear();
+    settled_.reserve(options_.window);
+    sorted_.clear();
+    sorted_.reserve(options_.window);
+    next_ = 0;
+    answered_ = false;
+    lastRttUs_ = -1;
+    jitterUs_ = 0;
+}
+
+void RttTracker::onSent(uint32_t sequence, Clock::time_point at) {
+    pending_.push_back(Pending{sequence, at});
+}
+
+bool RttTracker::onEcho(uint32_t sequence, Clock::time_point at) {
+    auto found = std::find_if(pending_.begin(), pending_.end(),
+                              [sequence](const Pending& entry) { return entry.sequence == sequence; });
+    if (found == pending_.end() || at < found->sentAt) {
+        return false;
+    }
+    auto rttUs = std::chrono::duration_cast<std::chrono::microseconds>(at - found->sentAt).count();
+    pending_.erase(found);
+    answered_ = true;
+
+    if (lastRttUs_ >= 0) {
+        double deviation = static_cast<double>(std::llabs(rttUs - lastRttUs_));
+        jitterUs_ += (deviation - jitterUs_) / 16.0;
+    }
+    lastRttUs_ = rttUs;
+    settle(rttUs);
+    return true;
+}
+
+void RttTracker::expire(Clock::time_point now) {
+    // Probes go out in order, so the expired ones lead
+    auto end = std::find_if(pending_.begin(), pending_.end(),
+                            [&](const Pending& entry) { return now - entry.sentAt < options_.timeout; });
+    size_t expired = static_cast<size_t>(end - pending_.begin());
+    pending_.erase(pending_.begin(), end);
+    if (!answered_) {
+        return;
+    }
+    for (size_t i = 0; i < expired; i++) {
+        settle(-1);
+    }
+}
+
+void RttTracker::settle(int64_t rttUs) {
+    if (settled_.size() < options_.window) {
+        settled_.push_back(rttUs);
+        return;
+    }
+    settled_[next_] = rttUs;
+    next_ = (next_ + 1) % settled_.size();
+}
+
+RttTracker::Summary RttTracker::summary() const {
+    Summary summary;
+    auto& rtts = sorted_;
+    rtts.clear();
+    for (int64_t rttUs : settled_) {
+        if (rttUs < 0) {
+            summary.lost++;
+        } else {
+            rtts.push_back(rttUs);
+        }
+    }
+    summary.samples = static_cast<uint32_t>(rtts.size());
+    if (!settled_.empty()) {
+        summary.lossPpm = static_cast<uint64_t>(summary.lost) * 1000000 / settled_.size();
+    }
+    if (rtts.empty()) {
+        return summary;
+    }
+    std::sort(rtts.begin(), rtts.end());
+    summary.minUs = rtts.front();
+    summary.p50Us = percentile(rtts, 0.50);
+    summary.p90Us = percentile(rtts, 0.90);
+    summary.p99Us = percentile(rtts, 0.99);
+    summary.jitterUs = static_cast<int64_t>(std::lround(jitterUs_));
+    return summary;
+}
+
+} // namespace wireguard_flutter
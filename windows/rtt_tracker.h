@@ -0,0 +1,83 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace wireguard_flutter {
+
+// Rolling round-trip statistics over the last |window| probes of a
+// low-rate background probe: percentiles, jitter and loss.
+//
+// Each probe is registered by sequence when sent and settled by its echo,
+// or counted lost once it is older than |timeout|; an echo that comes after
+// that, or twice, is ignored. Jitter follows RFC 3550: the mean deviation
+// between consecutive round trips, smoothed by 1/16 per sample. Losses only
+// count once the target has answered at least once, so a target that runs
+// no echo responder reads as no samples rather than as a dead path.
+//
+// Times come from the callers, never from a clock read here. Not
+// thread-safe. Portable.
+class RttTracker {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Options {
+        // Settled probes the statistics cover
+        uint32_t window = 60;
+        std::chrono::milliseconds timeout{2000};
+    };
+
+    struct Summary {
+        // Echoes in the window; the round trips are 0 without any
+        uint32_t samples = 0;
+        uint32_t lost = 0;
+        int64_t minUs = 0;
+        int64_t p50Us = 0;
+        int64_t p90Us = 0;
+        int64_t p99Us = 0;
+        int64_t jitterUs = 0;
+        // Lost over settled probes in the window, in parts per million
+        uint64_t lossPpm = 0;
+    };
+
+    RttTracker();
+    explicit RttTracker(const Options& options);
+
+    // Starts over with |options|
+    void configure(const Options& options);
+    const Options& options() const { return options_; }
+    void reset();
+
+    void onSent(uint32_t sequence, Clock::time_point at);
+    // False for an echo of no probe in flight
+    bool onEcho(uint32_t sequence, Clock::time_point at);
+    // Counts the probes older than the timeout as lost
+    void expire(Clock::time_point now);
+
+    bool answered() const { return answered_; }
+    size_t inFlight() const { return pending_.size(); }
+    Summary summary() const;
+
+private:
+    struct Pending {
+        uint32_t sequence;
+        Clock::time_point sentAt;
+    };
+
+    // |rttUs| of an echo, or -1 for a loss
+    void settle(int64_t rttUs);
+
+    Options options_;
+    std::vector<Pending> pending_;
+    // Ring of settled probes, oldest at next_ once full
+    std::vector<int64_t> settled_;
+    size_t next_ = 0;
+    // Round trips of summary() to sort, kept so a summary never allocates
+    mutable std::vector<int64_t> sorted_;
+    bool answered_ = false;
+    int64_t lastRttUs_ = -1;
+    double jitterUs_ = 0;
+};
+
+} // namespace wireguard_flutter
@@ -0,0 +1,87 @@
+#include "standby_failover.h"
+
+#include <utility>
+
+namespace wireguard_flutter {
+
+const char* StandbyFailover::reasonName(Reason reason) {
+    switch (reason) {
+    case Reason::User:
+        return "user";
+    case Reason::Watchdog:
+        return "watchdog";
+    }
+    return "unknown";
+}
+
+StandbyFailover::StandbyFailover(Backend& backend) : backend_(backend) {}
+
+bool StandbyFailover::arm(const std::string& active, const Peer& standby) {
+    if (active.empty() || standby.publicKey.empty() || standby.publicKey == active) {
+        return false;
+    }
+    // A different standby replaces the previous one
+    if (armed_ && standby_ != standby.publicKey) {
+        disarm();
+    }
+    if (!backend_.keepWarm(standby, options_.keepalive)) {
+        return false;
+    }
+    armed_ = true;
+    active_ = active;
+    standby_ = standby.publicKey;
+    return true;
+}
+
+void StandbyFailover::disarm() {
+    if (armed_) {
+        backend_.removePeer(standby_);
+    }
+    reset();
+}
+
+void StandbyFailover::reset() {
+    armed_ = false;
+    active_.clear();
+    standby_.clear();
+}
+
+bool StandbyFailover::warm() const {
+    if (!armed_) {
+        return false;
+    }
+    int64_t age = backend_.handshakeAgeMs(standby_);
+    return age >= 0 && age < options_.warmFor.count();
+}
+
+StandbyFailover::Result StandbyFailover::failover(Reason reason) {
+    Result result;
+    result.reason = reason;
+    if (!armed_) {
+        result.error = "not armed";
+        return result;
+    }
+    result.from = active_;
+    result.to = standby_;
+    result.standbyHandshakeAgeMs = backend_.handshakeAgeMs(standby_);
+    bool isWarm = result.standbyHandshakeAgeMs >= 0 && result.standbyHandshakeAgeMs < options_.warmFor.count();
+    if (reason == Reason::Watchdog && !isWarm) {
+        result.error = "standby not warm";
+        return result;
+    }
+    if (!backend_.moveAllowedIps(active_, standby_)) {
+        result.error = "update failed";
+        return result;
+    }
+    result.switched = true;
+    std::swap(active_, standby_);
+
+    // Traffic already moved; a former active peer that cannot be kept warm
+    // only makes failing back slower
+    Peer former;
+    former.publicKey = standby_;
+    backend_.keepWarm(former, options_.keepalive);
+    return result;
+}
+
+} // namespace wireguard_flutter
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace wireguard_flutter {
+
+// Keeps a second server warm on a tunnel's adapter and moves the tunnel's
+// traffic to it in one step, so a failover takes a configuration update
+// instead of a service restart.
+//
+// The standby is an extra peer without allowed IPs: no traffic is routed
+// to it, but a persistent keepalive makes the driver keep a session with it
+// (rekeying every two minutes as it sends). WireGuard routes by allowed IPs,
+// so failing over moves the active peer's allowed IPs to the standby in a
+// single update; the operating system's routes point at the adapter and do
+// not change. The former active peer then becomes the standby, with the
+// same keepalive, so failing back is just as fast. The standby server has
+// to accept the tunnel's key and address like the active one.
+//
+// The adapter is behind Backend, with keys in base64, so the switchover
+// runs against a fake in tests. Not thread-safe. Portable.
+class StandbyFailover {
+public:
+    enum class Reason : uint8_t { User, Watchdog };
+
+    struct Options {
+        std::chrono::seconds keepalive{25};
+        // A standby whose handshake is older is not trusted to carry
+        // traffic at once; keepalives keep it under REKEY_AFTER_TIME plus a
+        // keepalive interval
+        std::chrono::milliseconds warmFor{150000};
+    };
+
+    struct Peer {
+        std::string publicKey;
+        // Empty for none
+        std::string presharedKey;
+        // Address literal and port, e.g. "[2001:db8::1]:51820"
+        std::string endpoint;
+    };
+
+    // What the switchover drives; the tunnel's adapter on Windows
+    class Backend {
+    public:
+        virtual ~Backend() = default;
+
+        // Adds |peer| without allowed IPs, or updates it, with a persistent
+        // keepalive. An empty endpoint or preshared key keeps the current one.
+        virtual bool keepWarm(const Peer& peer, std::chrono::seconds keepalive) = 0;
+        // Moves every allowed IP of |from| to |to| in one update
+        virtual bool moveAllowedIps(const std::string& from, const std::string& to) = 0;
+        virtual bool removePeer(const std::string& publicKey) = 0;
+        // Age of the peer's latest handshake; -1 without one or without the peer
+        virtual int64_t handshakeAgeMs(const std::string& publicKey) = 0;
+    };
+
+    struct Result {
+        bool switched = false;
+        Reason reason = Reason::User;
+        // Public keys of the peers traffic moved from and to
+        std::string from;
+        std::string to;
+        // The standby's handshake age at the switch; -1 without one
+        int64_t standbyHandshakeAgeMs = -1;
+        // Why nothing switched, e.g. "not armed"
+        std::string error;
+        // How long the switch took, measured by the caller
+        std::chrono::microseconds duration{0};
+    };
+
+    // Reason code sent to Dart
+    static const char* reasonName(Reason reason);
+
+    explicit StandbyFailover(Backend& backend);
+
+    StandbyFailover(const StandbyFailover&) = delete;
+    StandbyFailover& operator=(const StandbyFailover&) = delete;
+
+    void configure(const Options& options) { options_ = options; }
+    const Options& options() const { return options_; }
+
+    // Adds |standby| next to |active|, the peer carrying traffic
+    bool arm(const std::string& active, const Peer& standby);
+    // Removes the standby peer; the active one keeps the traffic
+    void disarm();
+    // Forgets the peers without touching the backend, e.g. when the adapter
+    // was recreated
+    void reset();
+
+    bool armed() const { return armed_; }
+    const std::string& active() const { return active_; }
+    const std::string& standby() const { return standby_; }
+
+    // The standby completed a handshake recently enough to switch blind
+    bool warm() const;
+
+    // Moves the traffic to the standby. The watchdog only switches to a warm
+    // standby; a user may switch to a cold one, which then handshakes on the
+    // first packet.
+    Result failover(Reason reason);
+
+private:
+    Backend& backend_;
+    Options options_;
+    bool armed_ = false;
+    std::string active_;
+    std::string standby_;
+};
+
+} // namespace wireguard_flutter
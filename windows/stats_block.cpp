@@ -0,0 +1,208 @@
+#include "stats_block.h"
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace wireguard_flutter {
+
+static_assert(sizeof(AtomicStatsBlock) == sizeof(WireguardFlutterStatsBlock), "block layout mismatch");
+static_assert(sizeof(AtomicStatsBlock) % 64 == 0, "block must fill whole cache lines");
+static_assert(sizeof(std::atomic<int64_t>) == sizeof(int64_t), "atomics must not add storage");
+static_assert(std::atomic<int64_t>::is_always_lock_free, "counters must be lock-free");
+static_assert(offsetof(WireguardFlutterStatsBlock, bytes_in) == 16, "unexpected C layout");
+static_assert(offsetof(WireguardFlutterStatsBlock, updated_at_ms) == 72, "unexpected C layout");
+
+namespace {
+
+AtomicStatsBlock tunnelBlocks[kMaxTunnelStatsBlocks];
+AtomicStatsBlock overflowBlock;
+std::atomic<int32_t> statsReaders{0};
+
+// Claims are rare, so a plain mutex guards the name table
+struct BlockTable {
+    std::mutex mutex;
+    std::string names[kMaxTunnelStatsBlocks];
+    std::unique_ptr<StatsBlock> writers[kMaxTunnelStatsBlocks];
+    size_t used = 0;
+};
+
+BlockTable& blockTable() {
+    static BlockTable table;
+    return table;
+}
+
+int64_t steadyMillis() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+uint32_t StatsBlock::beginWrite() {
+    uint32_t sequence = block_.sequence.load(std::memory_order_relaxed);
+    for (;;) {
+        // An odd value means another writer is mid-update
+        if ((sequence & 1) == 0 &&
+            block_.sequence.compare_exchange_weak(sequence, sequence + 1, std::memory_order_acquire,
+                                                  std::memory_order_relaxed)) {
+            break;
+        }
+        std::this_thread::yield();
+        sequence = block_.sequence.load(std::memory_order_relaxed);
+    }
+    // Field stores must not become visible before the odd sequence
+    std::atomic_thread_fence(std::memory_order_release);
+    return sequence + 1;
+}
+
+void StatsBlock::endWrite(uint32_t sequence) {
+    block_.updatedAtMs.store(steadyMillis(), std::memory_order_relaxed);
+    block_.sequence.store(sequence + 1, std::memory_order_release);
+}
+
+void StatsBlock::publish(const TunnelStats& stats, WireguardFlutterTunnelState state, int64_t handshakeAgeMs) {
+    uint32_t sequence = beginWrite();
+    block_.state.store(state, std::memory_order_relaxed);
+    block_.bytesIn.store(static_cast<int64_t>(stats.bytesIn), std::memory_order_relaxed);
+    block_.bytesOut.store(static_cast<int64_t>(stats.bytesOut), std::memory_order_relaxed);
+    block_.speedInBps.store(static_cast<int64_t>(stats.speedInBps), std::memory_order_relaxed);
+    block_.speedOutBps.store(static_cast<int64_t>(stats.speedOutBps), std::memory_order_relaxed);
+    block_.smoothedInBps.store(static_cast<int64_t>(stats.smoothedInBps), std::memory_order_relaxed);
+    block_.smoothedOutBps.store(static_cast<int64_t>(stats.smoothedOutBps), std::memory_order_relaxed);
+    block_.handshakeAgeMs.store(handshakeAgeMs, std::memory_order_relaxed);
+    block_.packetsInPerSec.store(static_cast<int64_t>(stats.packetsInPerSec), std::memory_order_relaxed);
+    block_.packetsOutPerSec.store(static_cast<int64_t>(stats.packetsOutPerSec), std::memory_order_relaxed);
+    block_.dropRatioPpm.store(static_cast<int64_t>(stats.dropRatioPpm), std::memory_order_relaxed);
+    block_.rttP50Us.store(static_cast<int64_t>(stats.rttP50Us), std::memory_order_relaxed);
+    block_.rttJitterUs.store(static_cast<int64_t>(stats.rttJitterUs), std::memory_order_relaxed);
+    block_.rttLossPpm.store(static_cast<int64_t>(stats.rttLossPpm), std::memory_order_relaxed);
+    endWrite(sequence);
+}
+
+void StatsBlock::publishState(WireguardFlutterTunnelState state) {
+    // A degraded tunnel is still up; its counters stay meaningful
+    if (state == WIREGUARD_FLUTTER_STATE_CONNECTED || state == WIREGUARD_FLUTTER_STATE_DEGRADED) {
+        uint32_t sequence = beginWrite();
+        block_.state.store(state, std::memory_order_relaxed);
+        endWrite(sequence);
+        return;
+    }
+    publish(TunnelStats{}, state, -1);
+}
+
+void StatsBlock::read(WireguardFlutterStatsBlock& out) const {
+    for (;;) {
+        uint32_t before = block_.sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        out.version = block_.version.load(std::memory_order_relaxed);
+        out.state = block_.state.load(std::memory_order_relaxed);
+        out.reserved0 = 0;
+        out.bytes_in = block_.bytesIn.load(std::memory_order_relaxed);
+        out.bytes_out = block_.bytesOut.load(std::memory_order_relaxed);
+        out.speed_in_bps = block_.speedInBps.load(std::memory_order_relaxed);
+        out.speed_out_bps = block_.speedOutBps.load(std::memory_order_relaxed);
+        out.smoothed_in_bps = block_.smoothedInBps.load(std::memory_order_relaxed);
+        out.smoothed_out_bps = block_.smoothedOutBps.load(std::memory_order_relaxed);
+        out.handshake_age_ms = block_.handshakeAgeMs.load(std::memory_order_relaxed);
+        out.updated_at_ms = block_.updatedAtMs.load(std::memory_order_relaxed);
+        out.packets_in_per_sec = block_.packetsInPerSec.load(std::memory_order_relaxed);
+        out.packets_out_per_sec = block_.packetsOutPerSec.load(std::memory_order_relaxed);
+        out.drop_ratio_ppm = block_.dropRatioPpm.load(std::memory_order_relaxed);
+        out.rtt_p50_us = block_.rttP50Us.load(std::memory_order_relaxed);
+        out.rtt_jitter_us = block_.rttJitterUs.load(std::memory_order_relaxed);
+        out.rtt_loss_ppm = block_.rttLossPpm.load(std::memory_order_relaxed);
+
+        // Field loads must complete before the sequence is checked again
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (block_.sequence.load(std::memory_order_relaxed) == before) {
+            out.sequence = before;
+            return;
+        }
+    }
+}
+
+const WireguardFlutterStatsBlock* StatsBlock::raw() const {
+    return reinterpret_cast<const WireguardFlutterStatsBlock*>(&block_);
+}
+
+StatsBlock& GlobalStatsBlock() {
+    static StatsBlock block(tunnelBlocks[0]);
+    return block;
+}
+
+StatsBlock& TunnelStatsBlock(const std::string& tunnel, int32_t& index) {
+    auto& table = blockTable();
+    std::lock_guard<std::mutex> lock(table.mutex);
+    for (size_t i = 0; i < table.used; i++) {
+        if (table.names[i] == tunnel) {
+            index = static_cast<int32_t>(i);
+            return i == 0 ? GlobalStatsBlock() : *table.writers[i];
+        }
+    }
+
+    if (table.used == kMaxTunnelStatsBlocks) {
+        static StatsBlock overflow(overflowBlock);
+        index = -1;
+        return overflow;
+    }
+
+    size_t slot = table.used++;
+    table.names[slot] = tunnel;
+    if (slot != 0) {
+        table.writers[slot] = std::make_unique<StatsBlock>(tunnelBlocks[slot]);
+    }
+    index = static_cast<int32_t>(slot);
+    return slot == 0 ? GlobalStatsBlock() : *table.writers[slot];
+}
+
+int32_t StatsReaderCount() {
+    return statsReaders.load(std::memory_order_relaxed);
+}
+
+} // namespace wireguard_flutter
+
+const WireguardFlutterStatsBlock* WireguardFlutterGetStatsBlock(void) {
+    return wireguard_flutter::GlobalStatsBlock().raw();
+}
+
+const WireguardFlutterStatsBlock* WireguardFlutterGetStatsBlockAt(uint32_t index) {
+    if (index >= wireguard_flutter::kMaxTunnelStatsBlocks) {
+        return nullptr;
+    }
+    return reinterpret_cast<const WireguardFlutterStatsBlock*>(&wireguard_flutter::tunnelBlocks[index]);
+}
+
+int32_t WireguardFlutterReadStats(WireguardFlutterStatsBlock* out) {
+    if (out == nullptr) {
+        return -1;
+    }
+    wireguard_flutter::GlobalStatsBlock().read(*out);
+    return 0;
+}
+
+int32_t WireguardFlutterReadStatsAt(uint32_t index, WireguardFlutterStatsBlock* out) {
+    if (out == nullptr || index >= wireguard_flutter::kMaxTunnelStatsBlocks) {
+        return -1;
+    }
+    wireguard_flutter::StatsBlock(wireguard_flutter::tunnelBlocks[index]).read(*out);
+    return 0;
+}
+
+void WireguardFlutterAddStatsReader(void) {
+    wireguard_flutter::statsReaders.fetch_add(1, std::memory_order_relaxed);
+}
+
+void WireguardFlutterRemoveStatsReader(void) {
+    // Never below zero, even if a reader is closed twice
+    auto& readers = wireguard_flutter::statsReaders;
+    int32_t current = readers.load(std::memory_order_relaxed);
+    while (current > 0 && !readers.compare_exchange_weak(current, current - 1, std::memory_order_relaxed)) {
+    }
+}
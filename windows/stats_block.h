@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "include/wireguard_flutter/wireguard_flutter_stats_c_api.h"
+#include "tunnel_stats.h"
+
+namespace wireguard_flutter {
+
+// Native view of WireguardFlutterStatsBlock. Same layout as the C struct, but
+// every field is an atomic so the seqlock is well defined in C++.
+struct alignas(64) AtomicStatsBlock {
+    std::atomic<uint32_t> sequence{0};
+    std::atomic<uint32_t> version{WIREGUARD_FLUTTER_STATS_BLOCK_VERSION};
+    std::atomic<int32_t> state{WIREGUARD_FLUTTER_STATE_DISCONNECTED};
+    std::atomic<uint32_t> reserved0{0};
+    std::atomic<int64_t> bytesIn{0};
+    std::atomic<int64_t> bytesOut{0};
+    std::atomic<int64_t> speedInBps{0};
+    std::atomic<int64_t> speedOutBps{0};
+    std::atomic<int64_t> smoothedInBps{0};
+    std::atomic<int64_t> smoothedOutBps{0};
+    std::atomic<int64_t> handshakeAgeMs{-1};
+    std::atomic<int64_t> updatedAtMs{0};
+    std::atomic<int64_t> packetsInPerSec{0};
+    std::atomic<int64_t> packetsOutPerSec{0};
+    std::atomic<int64_t> dropRatioPpm{0};
+    std::atomic<int64_t> rttP50Us{0};
+    std::atomic<int64_t> rttJitterUs{0};
+    std::atomic<int64_t> rttLossPpm{0};
+};
+
+// Seqlock writer/reader over an AtomicStatsBlock. Writers serialize among
+// themselves by claiming the odd sequence with a CAS, so the sampler thread
+// and the platform thread can both publish without an extra lock. Readers
+// never block writers.
+class StatsBlock {
+public:
+    explicit StatsBlock(AtomicStatsBlock& block) : block_(block) {}
+
+    // Publishes a full sample.
+    void publish(const TunnelStats& stats, WireguardFlutterTunnelState state, int64_t handshakeAgeMs);
+
+    // Publishes a state change and clears the counters when the tunnel is
+    // not connected.
+    void publishState(WireguardFlutterTunnelState state);
+
+    // Copies a consistent snapshot into |out|.
+    void read(WireguardFlutterStatsBlock& out) const;
+
+    const WireguardFlutterStatsBlock* raw() const;
+
+private:
+    uint32_t beginWrite();
+    void endWrite(uint32_t sequence);
+
+    AtomicStatsBlock& block_;
+};
+
+constexpr size_t kMaxTunnelStatsBlocks = 128;
+
+// The block handed out through WireguardFlutterGetStatsBlock, which belongs
+// to the first tunnel that claimed one.
+StatsBlock& GlobalStatsBlock();
+
+// Returns the block |tunnel| publishes to, claiming a free one on first use;
+// the same name always maps to the same block. |index| receives its position
+// for WireguardFlutterGetStatsBlockAt, or -1 when every block is taken and
+// the tunnel shares an overflow block no reader can reach.
+StatsBlock& TunnelStatsBlock(const std::string& tunnel, int32_t& index);
+
+// Number of dart:ffi readers registered through WireguardFlutterAddStatsReader.
+// The monitor keeps publishing samples while any are attached.
+int32_t StatsReaderCount();
+
+} // namespace wireguard_flutter
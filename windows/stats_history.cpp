@@ -0,0 +1,38 @@
+#include "stats_history.h"
+
+#include <algorithm>
+
+namespace wireguard_flutter {
+
+void StatsHistory::clear() {
+    next_ = 0;
+    count_ = 0;
+}
+
+void StatsHistory::push(const TunnelStats& stats, int64_t timestampMs) {
+    entries_[next_] = Entry{timestampMs, stats};
+    next_ = (next_ + 1) % kCapacity;
+    count_ = std::min(count_ + 1, kCapacity);
+}
+
+void StatsHistory::encode(size_t maxSamples, std::vector<int64_t>& out) const {
+    constexpr size_t kHeader = 3;
+    constexpr size_t kStride = 1 + kStatsRecordFields;
+
+    size_t records = std::min(maxSamples, count_);
+    out.resize(kHeader + records * kStride);
+    out[0] = TunnelStats::kVersion;
+    out[1] = static_cast<int64_t>(kStatsRecordFields);
+    out[2] = static_cast<int64_t>(records);
+
+    size_t first = (next_ + kCapacity - records) % kCapacity;
+    int64_t* cursor = out.data() + kHeader;
+    for (size_t i = 0; i < records; i++) {
+        const Entry& entry = entries_[(first + i) % kCapacity];
+        cursor[0] = entry.timestampMs;
+        EncodeTunnelStatsFields(entry.stats, cursor + 1);
+        cursor += kStride;
+    }
+}
+
+} // namespace wireguard_flutter
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "tunnel_stats.h"
+
+namespace wireguard_flutter {
+
+// Fixed-size ring of recent statistics samples, newest overwriting oldest.
+// Not synchronized; the owner guards it together with the live sample.
+class StatsHistory {
+public:
+    // Ten minutes at the monitor's one-second cadence
+    static constexpr size_t kCapacity = 600;
+
+    void clear();
+    void push(const TunnelStats& stats, int64_t timestampMs);
+    size_t size() const { return count_; }
+
+    // Encodes the newest |maxSamples| records, oldest first, as
+    //   [version, fields per record, record count, (timestampMs, fields...)...]
+    // where the per-record fields follow the TunnelStats field order.
+    void encode(size_t maxSamples, std::vector<int64_t>& out) const;
+
+private:
+    struct Entry {
+        int64_t timestampMs;
+        TunnelStats stats;
+    };
+
+    std::array<Entry, kCapacity> entries_{};
+    size_t next_ = 0;
+    size_t count_ = 0;
+};
+
+} // namespace wireguard_flutter
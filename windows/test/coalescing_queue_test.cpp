@@ -0,0 +1,168 @@
+#include "coalescing_queue.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace wireguard_flutter {
+namespace {
+
+using Queue = CoalescingQueue<std::string, std::string>;
+
+std::vector<std::string> Values(const std::vector<Queue::Entry>& entries) {
+    std::vector<std::string> values;
+    for (const auto& entry : entries) {
+        values.push_back(entry.value);
+    }
+    return values;
+}
+
+TEST(CoalescingQueueTest, FirstPushWakesTheConsumer) {
+    Queue queue;
+    EXPECT_TRUE(queue.empty());
+    EXPECT_TRUE(queue.pushState("home", "connecting"));
+    EXPECT_FALSE(queue.pushEvent("stats"));
+    EXPECT_FALSE(queue.empty());
+
+    std::vector<Queue::Entry> drained;
+    queue.drain(drained);
+    EXPECT_TRUE(queue.empty());
+    EXPECT_TRUE(queue.pushEvent("stats"));
+}
+
+TEST(CoalescingQueueTest, SameKeyRunCollapsesToTheLatest) {
+    Queue queue;
+    queue.pushState("home", "connecting", 1);
+    queue.pushState("home", "handshaking", 2);
+    queue.pushState("home", "connected", 3);
+
+    std::vector<Queue::Entry> drained;
+    queue.drain(drained);
+    ASSERT_EQ(drained.size(), 1u);
+    EXPECT_TRUE(drained[0].isState);
+    EXPECT_EQ(drained[0].key, "home");
+    EXPECT_EQ(drained[0].value, "connected");
+    EXPECT_EQ(drained[0].version, 3u);
+    EXPECT_EQ(queue.coalesced(), 2u);
+}
+
+TEST(CoalescingQueueTest, OlderStateDoesNotReplaceANewerOne) {
+    Queue queue;
+    queue.pushState("home", "connected", 5);
+    queue.pushState("home", "connecting", 4);
+
+    std::vector<Queue::Entry> drained;
+    queue.drain(drained);
+    ASSERT_EQ(drained.size(), 1u);
+    EXPECT_EQ(drained[0].value, "connected");
+    EXPECT_EQ(drained[0].version, 5u);
+}
+
+TEST(CoalescingQueueTest, DifferentKeysKeepTheirOrder) {
+    Queue queue;
+    queue.pushState("home", "connecting");
+    queue.pushState("work", "connecting");
+    queue.pushState("home", "connected");
+    queue.pushEvent("usage");
+    queue.pushState("home", "disconnected");
+
+    std::vector<Queue::Entry> drained;
+    queue.drain(drained);
+    EXPECT_EQ(Values(drained),
+              (std::vector<std::string>{"connecting", "connecting", "connected", "usage", "disconnected"}));
+    EXPECT_EQ(drained[0].key, "home");
+    EXPECT_EQ(drained[1].key, "work");
+    EXPECT_FALSE(drained[3].isState);
+    EXPECT_EQ(queue.coalesced(), 0u);
+}
+
+TEST(CoalescingQueueTest, EventsAreNeverCollapsed) {
+    Queue queue;
+    queue.pushEvent("a");
+    queue.pushEvent("a");
+
+    std::vector<Queue::Entry> drained;
+    queue.drain(drained);
+    EXPECT_EQ(drained.size(), 2u);
+}
+
+TEST(CoalescingQueueTest, EventsBeyondCapacityAreDropped) {
+    Queue queue(3);
+    for (int i = 0; i < 5; i++) {
+        queue.pushEvent(std::to_string(i));
+    }
+    EXPECT_EQ(queue.dropped(), 2u);
+    // State changes are kept whatever the backlog
+    queue.pushState("home", "connected");
+
+    std::vector<Queue::Entry> drained;
+    queue.drain(drained);
+    EXPECT_EQ(Values(drained), (std::vector<std::string>{"0", "1", "2", "connected"}));
+
+    queue.pushEvent("5");
+    queue.drain(drained);
+    EXPECT_EQ(Values(drained), (std::vector<std::string>{"5"}));
+    EXPECT_EQ(queue.dropped(), 2u);
+}
+
+TEST(CoalescingQueueTest, SequenceNumbersIncreaseAndShowCollapsedRuns) {
+    Queue queue(2);
+    queue.pushEvent("a");                  // 1
+    queue.pushState("home", "connecting"); // 2
+    queue.pushState("home", "connected");  // 3, replaces 2
+    queue.pushEvent("dropped");            // no number
+
+    std::vector<Queue::Entry> drained;
+    queue.drain(drained);
+    ASSERT_EQ(drained.size(), 2u);
+    EXPECT_EQ(drained[0].sequence, 1u);
+    EXPECT_EQ(drained[1].sequence, 3u);
+
+    queue.pushEvent("b");
+    queue.drain(drained);
+    ASSERT_EQ(drained.size(), 1u);
+    EXPECT_EQ(drained[0].sequence, 4u);
+}
+
+TEST(CoalescingQueueTest, ConcurrentProducersLoseNothing) {
+    Queue queue(1 << 20);
+    constexpr int kThreads = 4;
+    constexpr int kEvents = 10000;
+    std::vector<std::thread> producers;
+    for (int t = 0; t < kThreads; t++) {
+        producers.emplace_back([&queue, t]() {
+            for (int i = 0; i < kEvents; i++) {
+                queue.pushEvent(std::to_string(t));
+            }
+        });
+    }
+    std::vector<Queue::Entry> drained;
+    size_t delivered = 0;
+    uint64_t last = 0;
+    bool ordered = true;
+    auto consume = [&]() {
+        queue.drain(drained);
+        for (const auto& entry : drained) {
+            ordered = ordered && entry.sequence > last;
+            last = entry.sequence;
+        }
+        delivered += drained.size();
+    };
+    // Drained while the producers run, like the platform thread does
+    while (delivered < static_cast<size_t>(kThreads) * kEvents) {
+        consume();
+        std::this_thread::yield();
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    EXPECT_TRUE(ordered);
+    EXPECT_EQ(delivered, static_cast<size_t>(kThreads) * kEvents);
+    EXPECT_EQ(queue.dropped(), 0u);
+}
+
+} // namespace
+} // namespace wireguard_flutter
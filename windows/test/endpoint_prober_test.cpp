@@ -0,0 +1,251 @@
+#include "endpoint_prober.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace wireguard_flutter {
+namespace {
+
+using std::chrono::milliseconds;
+using Clock = std::chrono::steady_clock;
+using Result = EndpointProber::Result;
+
+#ifdef _WIN32
+using SocketHandle = SOCKET;
+using AddressLength = int;
+
+void closeSocket(SocketHandle socket) {
+    closesocket(socket);
+}
+#else
+using SocketHandle = int;
+using AddressLength = socklen_t;
+
+void closeSocket(SocketHandle socket) {
+    ::close(socket);
+}
+#endif
+
+constexpr auto kPatience = std::chrono::seconds(10);
+
+// A UDP responder on the loopback that echoes every |echoEvery|th datagram
+// after |delay|, like a server that far away; 0 never answers
+class Responder {
+public:
+    explicit Responder(milliseconds delay, uint32_t echoEvery = 1) : delay_(delay), echoEvery_(echoEvery) {
+#ifdef _WIN32
+        WSADATA wsaData;
+        WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+        socket_ = ::socket(AF_INET, SOCK_DGRAM, 0);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        AddressLength length = sizeof(address);
+        bind(socket_, reinterpret_cast<const sockaddr*>(&address), length);
+        getsockname(socket_, reinterpret_cast<sockaddr*>(&address), &length);
+        port_ = ntohs(address.sin_port);
+        thread_ = std::thread([this] { echo(); });
+    }
+
+    ~Responder() {
+        stop_ = true;
+        thread_.join();
+        closeSocket(socket_);
+#ifdef _WIN32
+        WSACleanup();
+#endif
+    }
+
+    std::string endpoint() const { return "127.0.0.1:" + std::to_string(port_); }
+    uint32_t received() const { return received_; }
+
+private:
+    void echo() {
+        char buffer[64];
+        while (!stop_) {
+            fd_set set;
+            FD_ZERO(&set);
+            FD_SET(socket_, &set);
+            timeval timeout{0, 20000};
+            if (select(static_cast<int>(socket_) + 1, &set, nullptr, nullptr, &timeout) <= 0) {
+                continue;
+            }
+            sockaddr_storage from{};
+            AddressLength length = sizeof(from);
+            auto size = recvfrom(socket_, buffer, static_cast<int>(sizeof(buffer)), 0,
+                                 reinterpret_cast<sockaddr*>(&from), &length);
+            if (size <= 0) {
+                continue;
+            }
+            uint32_t count = received_++;
+            if (echoEvery_ == 0 || count % echoEvery_ != 0) {
+                continue;
+            }
+            std::this_thread::sleep_for(delay_);
+            sendto(socket_, buffer, static_cast<int>(size), 0, reinterpret_cast<const sockaddr*>(&from), length);
+        }
+    }
+
+    milliseconds delay_;
+    uint32_t echoEvery_;
+    SocketHandle socket_;
+    uint16_t port_ = 0;
+    std::atomic<uint32_t> received_{0};
+    std::atomic<bool> stop_{false};
+    std::thread thread_;
+};
+
+std::vector<std::string> Endpoints(const std::vector<Result>& results) {
+    std::vector<std::string> endpoints;
+    for (const auto& result : results) {
+        endpoints.push_back(result.endpoint);
+    }
+    return endpoints;
+}
+
+class EndpointProberTest : public ::testing::Test {
+protected:
+    void SetUp() override { ASSERT_TRUE(loop_.start()); }
+    void TearDown() override { loop_.stop(); }
+
+    // Probes |endpoints| and waits for the results; |elapsed| is the time
+    // until they were reported
+    std::vector<Result> probe(const std::vector<std::string>& endpoints, const EndpointProber::Options& options,
+                              Clock::duration* elapsed = nullptr) {
+        auto done = std::make_shared<std::promise<std::vector<Result>>>();
+        auto future = done->get_future();
+        auto started = Clock::now();
+        EXPECT_TRUE(EndpointProber::start(loop_, endpoints, options, [this, done](std::vector<Result> results) {
+            EXPECT_TRUE(loop_.inLoopThread());
+            done->set_value(std::move(results));
+        }));
+        EXPECT_EQ(future.wait_for(kPatience), std::future_status::ready);
+        if (elapsed != nullptr) {
+            *elapsed = Clock::now() - started;
+        }
+        return future.get();
+    }
+
+    EventLoop loop_;
+};
+
+EndpointProber::Options ShortOptions() {
+    EndpointProber::Options options;
+    options.rounds = 4;
+    options.interval = milliseconds(150);
+    options.timeout = milliseconds(400);
+    return options;
+}
+
+TEST_F(EndpointProberTest, RanksByRoundTrip) {
+    Responder near(milliseconds(0));
+    Responder middle(milliseconds(40));
+    Responder far(milliseconds(120));
+    // Given worst first, so the order comes from the probes
+    auto results = probe({far.endpoint(), middle.endpoint(), near.endpoint()}, ShortOptions());
+
+    EXPECT_EQ(Endpoints(results), (std::vector<std::string>{near.endpoint(), middle.endpoint(), far.endpoint()}));
+    for (const auto& result : results) {
+        EXPECT_EQ(result.address, result.endpoint);
+        EXPECT_EQ(result.sent, 4u);
+        EXPECT_EQ(result.received, 4u);
+        EXPECT_EQ(result.loss, 0.0);
+        EXPECT_GE(result.rttMs, result.minRttMs);
+        EXPECT_GE(result.jitterMs, 0.0);
+    }
+    EXPECT_GE(results[1].minRttMs, 40.0);
+    EXPECT_GE(results[2].minRttMs, 120.0);
+}
+
+TEST_F(EndpointProberTest, AllAnsweredFinishesWithoutWaitingForTheTimeout) {
+    Responder near(milliseconds(0));
+    auto options = ShortOptions();
+    options.timeout = std::chrono::seconds(5);
+    Clock::duration elapsed{};
+    auto results = probe({near.endpoint()}, options, &elapsed);
+
+    ASSERT_EQ(results.size(), 1u);
+    EXPECT_EQ(results[0].received, 4u);
+    EXPECT_LT(elapsed, options.timeout);
+}
+
+TEST_F(EndpointProberTest, SilentResponderTimesOutLast) {
+    Responder silent(milliseconds(0), 0);
+    Responder far(milliseconds(120));
+    auto options = ShortOptions();
+    Clock::duration elapsed{};
+    auto results = probe({silent.endpoint(), far.endpoint()}, options, &elapsed);
+
+    EXPECT_EQ(Endpoints(results), (std::vector<std::string>{far.endpoint(), silent.endpoint()}));
+    EXPECT_EQ(silent.received(), 4u);
+    EXPECT_EQ(results[1].sent, 4u);
+    EXPECT_EQ(results[1].received, 0u);
+    EXPECT_EQ(results[1].loss, 1.0);
+    EXPECT_EQ(results[1].rttMs, -1);
+    EXPECT_EQ(results[1].jitterMs, -1);
+    // Replies are awaited for the timeout after the last round
+    EXPECT_GE(elapsed, options.interval * (options.rounds - 1) + options.timeout);
+}
+
+TEST_F(EndpointProberTest, LossOutranksRoundTrip) {
+    Responder lossy(milliseconds(0), 2);
+    Responder far(milliseconds(60));
+    auto results = probe({lossy.endpoint(), far.endpoint()}, ShortOptions());
+
+    EXPECT_EQ(Endpoints(results), (std::vector<std::string>{far.endpoint(), lossy.endpoint()}));
+    EXPECT_EQ(results[1].sent, 4u);
+    EXPECT_EQ(results[1].received, 2u);
+    EXPECT_EQ(results[1].loss, 0.5);
+}
+
+TEST_F(EndpointProberTest, UnresolvedEndpointsAreReportedUnprobed) {
+    Responder near(milliseconds(0));
+    auto results = probe({"not an endpoint", near.endpoint()}, ShortOptions());
+
+    EXPECT_EQ(Endpoints(results), (std::vector<std::string>{near.endpoint(), "not an endpoint"}));
+    EXPECT_TRUE(results[1].address.empty());
+    EXPECT_EQ(results[1].sent, 0u);
+    EXPECT_EQ(results[1].loss, 1.0);
+}
+
+TEST_F(EndpointProberTest, NothingToProbeStillFinishes) {
+    auto results = probe({"not an endpoint"}, ShortOptions());
+    ASSERT_EQ(results.size(), 1u);
+    EXPECT_EQ(results[0].sent, 0u);
+}
+
+TEST(EndpointProberSortTest, TiesKeepTheOrderGiven) {
+    std::vector<Result> results(3);
+    results[0].endpoint = "a";
+    results[1].endpoint = "b";
+    results[1].received = 1;
+    results[1].loss = 0;
+    results[1].rttMs = 10;
+    results[1].jitterMs = 1;
+    results[2].endpoint = "c";
+    EndpointProber::sort(results);
+    EXPECT_EQ(Endpoints(results), (std::vector<std::string>{"b", "a", "c"}));
+}
+
+} // namespace
+} // namespace wireguard_flutter
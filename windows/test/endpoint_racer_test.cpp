@@ -0,0 +1,315 @@
+#include "endpoint_racer.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace wireguard_flutter {
+namespace {
+
+using std::chrono::milliseconds;
+
+constexpr auto kPatience = std::chrono::seconds(5);
+
+const std::string kPrivateKey = "yAnz5TF+lXXJte14tji3zlMNq+hd2rYUIgJBgB3fBmk=";
+const std::string kServerKey = "xTIBA5rboUvnH4htodjb6e697QjLERt1NAB4mZqp8Dg=";
+const std::string kOtherKey = "HIgo9xNzJMWLKASShiTqIybxZ0U3wGLiUeJ1PKf8ykw=";
+
+std::string Config(const std::string& endpoint) {
+    return "[Interface]\nPrivateKey = " + kPrivateKey + "\nAddress = 10.0.0.2/32\n\n[Peer]\nPublicKey = " +
+           kServerKey + "\nEndpoint = " + endpoint + "\nAllowedIPs = 0.0.0.0/0\n";
+}
+
+// Peers whose endpoint is in |answering| complete a handshake once their
+// adapter is up
+class FakeBackend : public EndpointRacer::Backend {
+public:
+    ~FakeBackend() override {
+        for (auto& thread : threads_) {
+            thread.join();
+        }
+    }
+
+    void create(uint64_t race, size_t slot, const EndpointRacer::Slot& config,
+                std::function<void(bool)> done) override {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            slots_[{race, slot}] = config;
+            creates_++;
+            races_.insert(race);
+        }
+        if (createDelay == milliseconds(0)) {
+            done(true);
+            return;
+        }
+        threads_.emplace_back([this, done]() {
+            std::this_thread::sleep_for(createDelay);
+            done(true);
+        });
+    }
+
+    bool setUp(uint64_t race, size_t slot) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        up_.insert({race, slot});
+        return true;
+    }
+
+    bool hasHandshake(uint64_t race, size_t slot, const std::string& publicKey) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto found = slots_.find({race, slot});
+        if (found == slots_.end() || up_.count({race, slot}) == 0) {
+            return false;
+        }
+        for (const auto& peer : found->second.peers) {
+            if (peer.publicKey == publicKey && answering.count(peer.endpoint) != 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void close(uint64_t race, std::function<void()> done) override {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_.insert(race);
+            for (auto slot = slots_.begin(); slot != slots_.end();) {
+                slot = slot->first.first == race ? slots_.erase(slot) : std::next(slot);
+            }
+        }
+        done();
+    }
+
+    int creates() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return creates_;
+    }
+
+    std::vector<EndpointRacer::Slot> slots() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<EndpointRacer::Slot> all;
+        for (const auto& slot : slots_) {
+            all.push_back(slot.second);
+        }
+        return all;
+    }
+
+    std::set<uint64_t> races() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return races_;
+    }
+
+    bool allClosed() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return slots_.empty() && closed_ == races_;
+    }
+
+    std::set<std::string> answering;
+    milliseconds createDelay{0};
+
+private:
+    std::mutex mutex_;
+    std::map<std::pair<uint64_t, size_t>, EndpointRacer::Slot> slots_;
+    std::set<std::pair<uint64_t, size_t>> up_;
+    std::set<uint64_t> races_;
+    std::set<uint64_t> closed_;
+    int creates_ = 0;
+    std::vector<std::thread> threads_;
+};
+
+// Keeps queries pending until the test answers them
+class FakeResolver {
+public:
+    ResolverCache::Resolver resolver() {
+        return [this](const std::string& host, std::function<void(ResolverCache::Answer)> done) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pending_[host].push_back(std::move(done));
+        };
+    }
+
+    void answer(const std::string& host, std::vector<std::string> addresses) {
+        std::vector<std::function<void(ResolverCache::Answer)>> done;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done.swap(pending_[host]);
+        }
+        ResolverCache::Answer answer;
+        answer.ok = !addresses.empty();
+        answer.addresses = std::move(addresses);
+        answer.ttl = std::chrono::seconds(300);
+        for (auto& callback : done) {
+            callback(answer);
+        }
+    }
+
+private:
+    std::mutex mutex_;
+    std::map<std::string, std::vector<std::function<void(ResolverCache::Answer)>>> pending_;
+};
+
+// What a race handed to its Done
+struct Outcome {
+    std::string config;
+    std::vector<EndpointRace::Entry> entries;
+    std::optional<size_t> winner;
+    std::chrono::steady_clock::time_point at;
+};
+
+class EndpointRacerTest : public ::testing::Test {
+protected:
+    void SetUp() override { ASSERT_TRUE(loop_.start()); }
+    void TearDown() override { loop_.stop(); }
+
+    EndpointRacer::Done record() {
+        return [this](const std::string& config, const EndpointRace& race) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            outcomes_.push_back(Outcome{config, race.entries(), race.winner(), std::chrono::steady_clock::now()});
+            changed_.notify_all();
+        };
+    }
+
+    bool waitForOutcomes(size_t count) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return changed_.wait_for(lock, kPatience, [&] { return outcomes_.size() >= count; });
+    }
+
+    EndpointRace::Options timeout(milliseconds value) {
+        EndpointRace::Options options;
+        options.timeout = value;
+        return options;
+    }
+
+    EventLoop loop_;
+    FakeBackend backend_;
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::vector<Outcome> outcomes_;
+};
+
+TEST_F(EndpointRacerTest, WinnerIsWrittenIntoTheConfig) {
+    backend_.answering = {"198.51.100.7:51820"};
+    auto racer = EndpointRacer::start(loop_, backend_, nullptr, Config("192.0.2.1:51820"),
+                                      {{"198.51.100.7:51820", kOtherKey}}, timeout(milliseconds(2000)), record());
+    ASSERT_TRUE(waitForOutcomes(1));
+
+    const auto& outcome = outcomes_[0];
+    ASSERT_EQ(outcome.winner, std::optional<size_t>(1));
+    EXPECT_EQ(outcome.entries[0].result, EndpointRace::Result::Cancelled);
+    EXPECT_EQ(outcome.entries[1].result, EndpointRace::Result::Won);
+    EXPECT_NE(outcome.config.find("Endpoint = 198.51.100.7:51820"), std::string::npos);
+    EXPECT_NE(outcome.config.find("PublicKey = " + kOtherKey), std::string::npos);
+    EXPECT_TRUE(backend_.allClosed());
+}
+
+TEST_F(EndpointRacerTest, KeysSpreadOverSlots) {
+    auto racer = EndpointRacer::start(loop_, backend_, nullptr, Config("192.0.2.1:51820"),
+                                      {{"192.0.2.2:51820", ""}, {"192.0.2.3:51820", kOtherKey}},
+                                      timeout(milliseconds(50)), record());
+    ASSERT_TRUE(waitForOutcomes(1));
+    // The server's key twice needs two adapters; the other key fits the first
+    EXPECT_EQ(backend_.creates(), 2);
+    EXPECT_FALSE(outcomes_[0].winner.has_value());
+    EXPECT_EQ(outcomes_[0].config, Config("192.0.2.1:51820"));
+    for (const auto& entry : outcomes_[0].entries) {
+        EXPECT_EQ(entry.result, EndpointRace::Result::TimedOut);
+    }
+}
+
+TEST_F(EndpointRacerTest, NamesResolveThroughTheCacheToEveryAddress) {
+    FakeResolver resolver;
+    ResolverCache cache(resolver.resolver());
+    backend_.answering = {"[2001:db8::1]:51820"};
+    auto racer = EndpointRacer::start(loop_, backend_, &cache, Config("vpn.example:51820"), {},
+                                      timeout(milliseconds(2000)), record());
+    std::this_thread::sleep_for(milliseconds(20));
+    EXPECT_EQ(backend_.creates(), 0);
+    resolver.answer("vpn.example", {"192.0.2.1", "2001:db8::1"});
+    ASSERT_TRUE(waitForOutcomes(1));
+
+    ASSERT_EQ(outcomes_[0].entries.size(), 2u);
+    EXPECT_EQ(outcomes_[0].entries[0].address, "192.0.2.1:51820");
+    EXPECT_EQ(outcomes_[0].entries[1].address, "[2001:db8::1]:51820");
+    ASSERT_EQ(outcomes_[0].winner, std::optional<size_t>(1));
+    EXPECT_NE(outcomes_[0].config.find("Endpoint = [2001:db8::1]:51820"), std::string::npos);
+}
+
+TEST_F(EndpointRacerTest, UnansweredNameFailsAtTheRaceTimeout) {
+    FakeResolver resolver;
+    ResolverCache cache(resolver.resolver());
+    backend_.answering = {"192.0.2.9:51820"};
+    auto began = std::chrono::steady_clock::now();
+    auto racer = EndpointRacer::start(loop_, backend_, &cache, Config("slow.example:51820"),
+                                      {{"192.0.2.9:51820", ""}}, timeout(milliseconds(100)), record());
+    ASSERT_TRUE(waitForOutcomes(1));
+    EXPECT_GE(outcomes_[0].at - began, milliseconds(100));
+    ASSERT_EQ(outcomes_[0].entries.size(), 2u);
+    EXPECT_EQ(outcomes_[0].entries[0].result, EndpointRace::Result::Failed);
+    EXPECT_EQ(outcomes_[0].entries[1].result, EndpointRace::Result::Won);
+    resolver.answer("slow.example", {});
+}
+
+TEST_F(EndpointRacerTest, UnusableConfigIsReturnedUnchanged) {
+    std::string config = "[Interface]\nPrivateKey = nope\n\n[Peer]\nPublicKey = " + kServerKey + "\n";
+    auto racer = EndpointRacer::start(loop_, backend_, nullptr, config, {{"192.0.2.2:51820", ""}},
+                                      timeout(milliseconds(1000)), record());
+    ASSERT_TRUE(waitForOutcomes(1));
+    EXPECT_EQ(outcomes_[0].config, config);
+    EXPECT_EQ(backend_.creates(), 0);
+}
+
+TEST_F(EndpointRacerTest, DoneNeverRunsBeforeStartReturns) {
+    std::atomic<bool> returned{false};
+    std::atomic<bool> early{false};
+    std::shared_ptr<EndpointRacer> racer;
+    backend_.answering = {"192.0.2.1:51820"};
+    loop_.post([&]() {
+        racer = EndpointRacer::start(loop_, backend_, nullptr, Config("192.0.2.1:51820"), {},
+                                     timeout(milliseconds(1000)), [&, done = record()](const std::string& config,
+                                                                                     const EndpointRace& race) {
+                                         early = !returned;
+                                         done(config, race);
+                                     });
+        returned = true;
+    });
+    ASSERT_TRUE(waitForOutcomes(1));
+    EXPECT_FALSE(early.load());
+}
+
+TEST_F(EndpointRacerTest, CancelWaitsForTheAdaptersAndSkipsDone) {
+    backend_.createDelay = milliseconds(50);
+    auto racer = EndpointRacer::start(loop_, backend_, nullptr, Config("192.0.2.1:51820"),
+                                      {{"192.0.2.2:51820", ""}}, timeout(milliseconds(1000)), record());
+    std::this_thread::sleep_for(milliseconds(10));
+    racer->cancel();
+    EXPECT_EQ(backend_.creates(), 2);
+    EXPECT_TRUE(backend_.allClosed());
+    std::this_thread::sleep_for(milliseconds(20));
+    std::lock_guard<std::mutex> lock(mutex_);
+    EXPECT_TRUE(outcomes_.empty());
+}
+
+TEST_F(EndpointRacerTest, OverlappingRacesUseTheirOwnAdapters) {
+    backend_.answering = {"192.0.2.1:51820"};
+    auto first = EndpointRacer::start(loop_, backend_, nullptr, Config("192.0.2.1:51820"), {},
+                                      timeout(milliseconds(1000)), record());
+    auto second = EndpointRacer::start(loop_, backend_, nullptr, Config("192.0.2.1:51820"), {},
+                                       timeout(milliseconds(1000)), record());
+    ASSERT_TRUE(waitForOutcomes(2));
+    EXPECT_EQ(backend_.races().size(), 2u);
+    EXPECT_TRUE(outcomes_[0].winner.has_value());
+    EXPECT_TRUE(outcomes_[1].winner.has_value());
+    EXPECT_TRUE(backend_.allClosed());
+}
+
+} // namespace
+} // namespace wireguard_flutter
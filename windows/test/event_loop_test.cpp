@@ -0,0 +1,183 @@
+#include "event_loop.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+namespace wireguard_flutter {
+namespace {
+
+using std::chrono::milliseconds;
+
+// A waitable the test signals by hand
+class TestEvent {
+public:
+#ifdef _WIN32
+    TestEvent() : handle_(CreateEventW(nullptr, TRUE, FALSE, nullptr)) {}
+    ~TestEvent() { CloseHandle(handle_); }
+    void signal() { SetEvent(handle_); }
+    EventLoop::Waitable waitable() const { return handle_; }
+
+private:
+    HANDLE handle_;
+#else
+    TestEvent() : fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {}
+    ~TestEvent() { close(fd_); }
+    void signal() {
+        uint64_t one = 1;
+        (void)!write(fd_, &one, sizeof(one));
+    }
+    EventLoop::Waitable waitable() const { return fd_; }
+
+private:
+    int fd_;
+#endif
+};
+
+constexpr auto kPatience = std::chrono::seconds(5);
+
+class EventLoopTest : public ::testing::Test {
+protected:
+    void SetUp() override { ASSERT_TRUE(loop_.start()); }
+    void TearDown() override { loop_.stop(); }
+
+    EventLoop loop_;
+};
+
+TEST_F(EventLoopTest, RunsPostedTasksInOrderOnTheLoopThread) {
+    std::promise<std::vector<int>> done;
+    auto order = std::make_shared<std::vector<int>>();
+    for (int i = 0; i < 3; i++) {
+        loop_.post([this, order, i]() {
+            EXPECT_TRUE(loop_.inLoopThread());
+            order->push_back(i);
+        });
+    }
+    loop_.post([order, &done]() { done.set_value(*order); });
+    auto future = done.get_future();
+    ASSERT_EQ(future.wait_for(kPatience), std::future_status::ready);
+    EXPECT_EQ(future.get(), (std::vector<int>{0, 1, 2}));
+    EXPECT_FALSE(loop_.inLoopThread());
+}
+
+// Posted tasks make the poll return at once; a chain of posts must not wait
+// for the pending timer each time
+TEST_F(EventLoopTest, PostedTasksDoNotWaitForTimers) {
+    loop_.addTimer(std::chrono::hours(1), []() {});
+    std::promise<void> done;
+    std::function<void(int)> chain = [&](int left) {
+        if (left == 0) {
+            done.set_value();
+            return;
+        }
+        loop_.post([&chain, left]() { chain(left - 1); });
+    };
+    auto started = std::chrono::steady_clock::now();
+    loop_.post([&chain]() { chain(1000); });
+    ASSERT_EQ(done.get_future().wait_for(kPatience), std::future_status::ready);
+    EXPECT_LT(std::chrono::steady_clock::now() - started, std::chrono::seconds(1));
+}
+
+TEST_F(EventLoopTest, TimersFireOnceAfterTheirDelay) {
+    std::promise<std::chrono::steady_clock::time_point> fired;
+    auto started = std::chrono::steady_clock::now();
+    loop_.addTimer(milliseconds(50), [&fired]() { fired.set_value(std::chrono::steady_clock::now()); });
+    auto future = fired.get_future();
+    ASSERT_EQ(future.wait_for(kPatience), std::future_status::ready);
+    EXPECT_GE(future.get() - started, milliseconds(50));
+}
+
+TEST_F(EventLoopTest, CancelledRepeatingTimerStops) {
+    std::atomic<int> ticks{0};
+    auto id = loop_.addRepeatingTimer(milliseconds(10), [&ticks]() { ticks++; });
+    while (ticks < 3) {
+        std::this_thread::sleep_for(milliseconds(5));
+    }
+    loop_.cancel(id);
+    int seen = ticks;
+    std::this_thread::sleep_for(milliseconds(60));
+    EXPECT_EQ(ticks, seen);
+}
+
+TEST_F(EventLoopTest, CancelWaitsForARunningCallback) {
+    std::atomic<bool> entered{false};
+    std::atomic<bool> finished{false};
+    auto id = loop_.addTimer(milliseconds(0), [&]() {
+        entered = true;
+        std::this_thread::sleep_for(milliseconds(50));
+        finished = true;
+    });
+    while (!entered) {
+        std::this_thread::yield();
+    }
+    loop_.cancel(id);
+    EXPECT_TRUE(finished);
+}
+
+TEST_F(EventLoopTest, CallbackMayCancelItself) {
+    std::atomic<int> runs{0};
+    EventLoop::TaskId id = 0;
+    std::promise<void> registered;
+    auto ready = registered.get_future().share();
+    id = loop_.addRepeatingTimer(milliseconds(5), [&, ready]() {
+        ready.wait();
+        runs++;
+        loop_.cancel(id);
+    });
+    registered.set_value();
+    std::this_thread::sleep_for(milliseconds(60));
+    EXPECT_EQ(runs, 1);
+}
+
+TEST_F(EventLoopTest, WaitFiresOnceWhenSignaled) {
+    TestEvent event;
+    std::atomic<int> fired{0};
+    loop_.addWait(event.waitable(), [&fired]() { fired++; });
+    std::this_thread::sleep_for(milliseconds(20));
+    EXPECT_EQ(fired, 0);
+    event.signal();
+    auto deadline = std::chrono::steady_clock::now() + kPatience;
+    while (fired == 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(milliseconds(1));
+    }
+    std::this_thread::sleep_for(milliseconds(20));
+    EXPECT_EQ(fired, 1);
+}
+
+TEST_F(EventLoopTest, CancelledWaitNeverFires) {
+    TestEvent event;
+    std::atomic<int> fired{0};
+    auto id = loop_.addWait(event.waitable(), [&fired]() { fired++; });
+    loop_.cancel(id);
+    event.signal();
+    std::this_thread::sleep_for(milliseconds(30));
+    EXPECT_EQ(fired, 0);
+}
+
+TEST_F(EventLoopTest, RefusesWaitsBeyondTheLimit) {
+    std::vector<std::unique_ptr<TestEvent>> events;
+    std::vector<EventLoop::TaskId> ids;
+    for (size_t i = 0; i < EventLoop::kMaxWaits; i++) {
+        events.push_back(std::make_unique<TestEvent>());
+        ids.push_back(loop_.addWait(events.back()->waitable(), []() {}));
+        EXPECT_NE(ids.back(), 0u);
+    }
+    TestEvent extra;
+    EXPECT_EQ(loop_.addWait(extra.waitable(), []() {}), 0u);
+    for (auto id : ids) {
+        loop_.cancel(id);
+    }
+}
+
+} // namespace
+} // namespace wireguard_flutter
@@ -0,0 +1,96 @@
+// Times method-channel accounting under contention: several threads look up
+// their method and record its latency, as InstrumentedMethodResult does,
+// while another one keeps summarizing like the methodMetrics call. Fails
+// when a call is lost or recording gets slower than the budget.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "method_metrics.h"
+
+namespace wireguard_flutter {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int kRecordsPerThread = 1000000;
+// A ceiling that catches a lock or an allocation creeping in, with room
+// for a loaded machine; a few hundred ns is typical
+constexpr double kBudgetNsPerRecord = 5000.0;
+
+int run() {
+    unsigned threads = std::max(2u, std::min(8u, std::thread::hardware_concurrency()));
+    const char* names[] = {"start", "stop", "stage", "getStatistics", "getTunnels", "methodMetrics"};
+    MethodMetrics metrics;
+    for (const char* name : names) {
+        metrics.method(name);
+    }
+
+    std::atomic<bool> done{false};
+    std::atomic<uint64_t> summaries{0};
+    std::thread summarizer([&]() {
+        std::vector<MethodMetrics::Summary> summary;
+        while (!done) {
+            metrics.summarize(summary);
+            summaries++;
+        }
+    });
+
+    std::vector<std::thread> callers;
+    auto started = Clock::now();
+    for (unsigned t = 0; t < threads; t++) {
+        callers.emplace_back([&, t]() {
+            uint32_t value = t * 7919;
+            for (int i = 0; i < kRecordsPerThread; i++) {
+                auto& method = metrics.method(names[(t + static_cast<unsigned>(i)) % 6]);
+                method.calls.fetch_add(1, std::memory_order_relaxed);
+                value = value * 1103515245 + 12345;
+                method.latencyUs.record(value % 200000);
+            }
+        });
+    }
+    for (auto& caller : callers) {
+        caller.join();
+    }
+    auto elapsed = Clock::now() - started;
+    done = true;
+    summarizer.join();
+
+    std::vector<MethodMetrics::Summary> summary;
+    metrics.summarize(summary);
+    uint64_t calls = 0;
+    uint64_t recorded = 0;
+    for (const auto& entry : summary) {
+        calls += entry.calls;
+        recorded += entry.latencyUs.count();
+    }
+    uint64_t expected = static_cast<uint64_t>(threads) * kRecordsPerThread;
+    auto ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    double perRecord = ns * threads / static_cast<double>(expected);
+    std::printf("threads: %u, records: %llu, summaries meanwhile: %llu\n", threads,
+                static_cast<unsigned long long>(expected), static_cast<unsigned long long>(summaries.load()));
+    std::printf("time per record and thread: %.1f ns\n", perRecord);
+
+    if (calls != expected || recorded != expected) {
+        std::printf("FAIL: counted %llu calls and %llu latencies of %llu\n", static_cast<unsigned long long>(calls),
+                    static_cast<unsigned long long>(recorded), static_cast<unsigned long long>(expected));
+        return 1;
+    }
+    if (perRecord > kBudgetNsPerRecord) {
+        std::printf("FAIL: recording took longer than %.0f ns\n", kBudgetNsPerRecord);
+        return 1;
+    }
+    return 0;
+}
+
+} // namespace
+} // namespace wireguard_flutter
+
+int main() {
+    return wireguard_flutter::run();
+}
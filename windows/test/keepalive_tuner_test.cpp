@@ -0,0 +1,195 @@
+#include "keepalive_tuner.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace wireguard_flutter {
+namespace {
+
+using std::chrono::milliseconds;
+using std::chrono::seconds;
+using Change = KeepaliveTuner::Change;
+using Reason = KeepaliveTuner::Reason;
+
+// Feeds the tuner the counters of a tunnel whose traffic the test scripts
+class KeepaliveTunerTest : public ::testing::Test {
+protected:
+    void SetUp() override { EXPECT_FALSE(sample(0, 0)); }
+
+    // Advances by |elapsed| and samples after |in| and |out| more bytes;
+    // a handshake |handshakeAge| ago, or none when negative
+    std::optional<Change> sample(uint64_t in, uint64_t out, milliseconds elapsed = milliseconds(0),
+                                 milliseconds handshakeAge = milliseconds(-1)) {
+        now_ += elapsed;
+        in_ += in;
+        out_ += out;
+        KeepaliveTuner::Sample sample;
+        sample.at = now_;
+        sample.bytesIn = in_;
+        sample.bytesOut = out_;
+        sample.handshakeAgeMs = handshakeAge.count();
+        return tuner_.addSample(sample);
+    }
+
+    // Quiet for |quiet|, then traffic both ways
+    std::optional<Change> answeredAfter(milliseconds quiet) { return sample(200, 200, quiet); }
+
+    // Quiet for |quiet|, then traffic out that is only answered after |late|,
+    // once the driver handshook again
+    std::optional<Change> lostAfter(milliseconds quiet, milliseconds late = seconds(20)) {
+        EXPECT_FALSE(sample(0, 200, quiet));
+        return sample(200, 0, late, milliseconds(500));
+    }
+
+    KeepaliveTuner tuner_;
+    KeepaliveTuner::Clock::time_point now_;
+    uint64_t in_ = 0;
+    uint64_t out_ = 0;
+};
+
+TEST_F(KeepaliveTunerTest, StartsAtTheInitialInterval) {
+    EXPECT_EQ(tuner_.keepalive(), seconds(25));
+    EXPECT_EQ(tuner_.survived(), milliseconds(0));
+    EXPECT_EQ(tuner_.lost(), milliseconds(0));
+}
+
+TEST(KeepaliveTunerOptionsTest, InitialIntervalIsClamped) {
+    KeepaliveTuner::Options options;
+    options.initial = seconds(5);
+    EXPECT_EQ(KeepaliveTuner(options).keepalive(), seconds(15));
+    options.initial = seconds(600);
+    EXPECT_EQ(KeepaliveTuner(options).keepalive(), seconds(120));
+}
+
+TEST_F(KeepaliveTunerTest, GrowsAfterEnoughStretchesSurvived) {
+    EXPECT_FALSE(answeredAfter(seconds(40)));
+    EXPECT_FALSE(answeredAfter(seconds(40)));
+    auto change = answeredAfter(seconds(40));
+    ASSERT_TRUE(change);
+    EXPECT_EQ(change->reason, Reason::Explore);
+    EXPECT_EQ(change->keepalive, seconds(37));
+    EXPECT_EQ(tuner_.keepalive(), seconds(37));
+    // The NAT never went longer than the interval without a packet
+    EXPECT_EQ(tuner_.survived(), seconds(25));
+}
+
+TEST_F(KeepaliveTunerTest, GrowthStopsAtTheCeiling) {
+    for (int i = 0; i < 30; i++) {
+        answeredAfter(seconds(200));
+    }
+    EXPECT_EQ(tuner_.keepalive(), seconds(120));
+}
+
+TEST_F(KeepaliveTunerTest, StretchesUnderTheFloorAreNoEvidence) {
+    for (int i = 0; i < 10; i++) {
+        EXPECT_FALSE(answeredAfter(seconds(10)));
+    }
+    EXPECT_EQ(tuner_.survived(), milliseconds(0));
+    EXPECT_EQ(tuner_.keepalive(), seconds(25));
+}
+
+TEST_F(KeepaliveTunerTest, StretchesShorterThanTheIntervalDoNotGrowIt) {
+    for (int i = 0; i < 10; i++) {
+        EXPECT_FALSE(answeredAfter(seconds(20)));
+    }
+    EXPECT_EQ(tuner_.survived(), seconds(20));
+    EXPECT_EQ(tuner_.keepalive(), seconds(25));
+}
+
+TEST_F(KeepaliveTunerTest, FewOutgoingBytesDoNotEndAStretch) {
+    EXPECT_FALSE(sample(0, 32, seconds(30)));
+    EXPECT_FALSE(answeredAfter(seconds(10)));
+    EXPECT_EQ(tuner_.survived(), seconds(25));
+}
+
+TEST_F(KeepaliveTunerTest, LossFallsBackUnderTheLostExposure) {
+    auto change = lostAfter(seconds(60));
+    ASSERT_TRUE(change);
+    EXPECT_EQ(change->reason, Reason::Loss);
+    EXPECT_EQ(tuner_.lost(), seconds(25));
+    // 0.8 times the 25 s the binding did not last
+    EXPECT_EQ(change->keepalive, seconds(20));
+}
+
+TEST_F(KeepaliveTunerTest, RepeatedLossesFallToTheFloor) {
+    ASSERT_TRUE(lostAfter(seconds(60)));
+    auto change = lostAfter(seconds(60));
+    ASSERT_TRUE(change);
+    EXPECT_EQ(change->reason, Reason::Loss);
+    EXPECT_EQ(change->keepalive, seconds(15));
+    EXPECT_EQ(tuner_.lost(), seconds(20));
+}
+
+TEST_F(KeepaliveTunerTest, LateAnswerWithoutAHandshakeIsNotALoss) {
+    EXPECT_FALSE(sample(0, 200, seconds(60)));
+    // The last handshake predates the traffic resuming
+    EXPECT_FALSE(sample(200, 0, seconds(20), seconds(90)));
+    EXPECT_EQ(tuner_.lost(), milliseconds(0));
+    EXPECT_EQ(tuner_.keepalive(), seconds(25));
+}
+
+TEST_F(KeepaliveTunerTest, AnswerWithinTheReplyWindowIsSurvived) {
+    EXPECT_FALSE(sample(0, 200, seconds(60)));
+    EXPECT_FALSE(sample(200, 0, seconds(2)));
+    EXPECT_EQ(tuner_.survived(), seconds(25));
+    EXPECT_EQ(tuner_.lost(), milliseconds(0));
+}
+
+TEST_F(KeepaliveTunerTest, SettlesUnderTheLearnedTimeoutAfterTheHold) {
+    for (int i = 0; i < 3; i++) {
+        answeredAfter(seconds(40));
+    }
+    ASSERT_EQ(tuner_.keepalive(), seconds(37));
+    auto loss = lostAfter(seconds(60));
+    ASSERT_TRUE(loss);
+    // Back to the initial interval, under the 29 s the margin allows
+    EXPECT_EQ(loss->keepalive, seconds(25));
+    EXPECT_EQ(tuner_.lost(), seconds(37));
+
+    // Held at the fallback for a while
+    EXPECT_FALSE(answeredAfter(seconds(40)));
+    EXPECT_EQ(tuner_.keepalive(), seconds(25));
+
+    auto learned = answeredAfter(std::chrono::minutes(11));
+    ASSERT_TRUE(learned);
+    EXPECT_EQ(learned->reason, Reason::Learned);
+    EXPECT_EQ(learned->keepalive, seconds(29));
+}
+
+TEST_F(KeepaliveTunerTest, NetworkChangeForgetsWhatWasLearned) {
+    EXPECT_FALSE(tuner_.onNetworkChange());
+    ASSERT_TRUE(lostAfter(seconds(60)));
+    auto change = tuner_.onNetworkChange();
+    ASSERT_TRUE(change);
+    EXPECT_EQ(change->reason, Reason::Reset);
+    EXPECT_EQ(change->keepalive, seconds(25));
+    EXPECT_EQ(tuner_.survived(), milliseconds(0));
+    EXPECT_EQ(tuner_.lost(), milliseconds(0));
+}
+
+// A recreated adapter counts from zero; the stretch starts over
+TEST_F(KeepaliveTunerTest, CountersGoingBackStartOver) {
+    sample(5000, 5000);
+    KeepaliveTuner::Sample reset;
+    now_ += seconds(100);
+    reset.at = now_;
+    EXPECT_FALSE(tuner_.addSample(reset));
+    in_ = 0;
+    out_ = 0;
+    EXPECT_FALSE(answeredAfter(seconds(5)));
+    EXPECT_EQ(tuner_.survived(), milliseconds(0));
+}
+
+TEST(KeepaliveTunerReasonTest, NamesEveryReason) {
+    EXPECT_EQ(std::string(KeepaliveTuner::reasonName(Reason::Explore)), "explore");
+    EXPECT_EQ(std::string(KeepaliveTuner::reasonName(Reason::Learned)), "learned");
+    EXPECT_EQ(std::string(KeepaliveTuner::reasonName(Reason::Loss)), "loss");
+    EXPECT_EQ(std::string(KeepaliveTuner::reasonName(Reason::Reset)), "reset");
+}
+
+} // namespace
+} // namespace wireguard_flutter
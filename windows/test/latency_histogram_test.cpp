@@ -0,0 +1,111 @@
+#include "latency_histogram.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace wireguard_flutter {
+namespace {
+
+using Histogram = BasicLatencyHistogram<27>;
+
+TEST(LatencyHistogramTest, SmallValuesGetABucketEach) {
+    for (int64_t value = 0; value < 8; value++) {
+        EXPECT_EQ(Histogram::bucketIndex(value), static_cast<size_t>(value));
+        EXPECT_EQ(Histogram::bucketUpperBound(static_cast<size_t>(value)), value);
+    }
+    EXPECT_EQ(Histogram::bucketIndex(-5), 0u);
+}
+
+TEST(LatencyHistogramTest, BucketsCoverEveryValueWithinAnEighth) {
+    size_t previous = 0;
+    for (int64_t value = 8; value < (int64_t{1} << 27); value = value * 9 / 8 + 1) {
+        size_t index = Histogram::bucketIndex(value);
+        EXPECT_GE(index, previous);
+        previous = index;
+        int64_t upper = Histogram::bucketUpperBound(index);
+        EXPECT_GE(upper, value);
+        EXPECT_LE(upper - value, value / 8) << value;
+    }
+    EXPECT_EQ(Histogram::bucketIndex(int64_t{1} << 27), Histogram::kBucketCount - 1);
+}
+
+TEST(LatencyHistogramTest, PercentilesStayWithinTheBucket) {
+    Histogram histogram;
+    EXPECT_EQ(histogram.percentile(50), 0);
+    for (int64_t value = 1; value <= 1000; value++) {
+        histogram.record(value);
+    }
+    EXPECT_EQ(histogram.count(), 1000u);
+    EXPECT_EQ(histogram.max(), 1000);
+    EXPECT_EQ(histogram.mean(), 500);
+    int64_t p50 = histogram.percentile(50);
+    EXPECT_GE(p50, 500);
+    EXPECT_LE(p50, 500 + 500 / 8);
+    EXPECT_EQ(histogram.percentile(100), 1000);
+    EXPECT_EQ(histogram.percentile(0), 1);
+}
+
+TEST(LatencyHistogramTest, MergeAndRestoreKeepTotals) {
+    Histogram a;
+    Histogram b;
+    a.record(10);
+    a.record(20);
+    b.record(3000);
+    a.merge(b);
+    EXPECT_EQ(a.count(), 3u);
+    EXPECT_EQ(a.sum(), 3030);
+    EXPECT_EQ(a.max(), 3000);
+
+    Histogram restored;
+    restored.restore(a.buckets(), a.sum(), a.max());
+    EXPECT_EQ(restored.count(), 3u);
+    EXPECT_EQ(restored.percentile(99), a.percentile(99));
+}
+
+TEST(LatencyHistogramTest, ConcurrentRecordingLosesNothing) {
+    AtomicLatencyHistogram<27> histogram;
+    constexpr int kThreads = 4;
+    constexpr int kRecords = 50000;
+    std::atomic<bool> done{false};
+    std::thread reader([&]() {
+        Histogram snapshot;
+        while (!done) {
+            histogram.snapshot(snapshot);
+            uint64_t total = 0;
+            for (uint64_t bucket : snapshot.buckets()) {
+                total += bucket;
+            }
+            ASSERT_EQ(total, snapshot.count());
+        }
+    });
+    std::vector<std::thread> writers;
+    for (int t = 0; t < kThreads; t++) {
+        writers.emplace_back([&, t]() {
+            for (int i = 0; i < kRecords; i++) {
+                histogram.record(t * 1000 + i % 1000);
+            }
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    done = true;
+    reader.join();
+
+    Histogram snapshot;
+    histogram.snapshot(snapshot);
+    EXPECT_EQ(snapshot.count(), static_cast<uint64_t>(kThreads) * kRecords);
+    EXPECT_EQ(snapshot.max(), (kThreads - 1) * 1000 + 999);
+    int64_t expectedSum = 0;
+    for (int t = 0; t < kThreads; t++) {
+        expectedSum += static_cast<int64_t>(kRecords / 1000) * (t * 1000 * 1000 + 999 * 1000 / 2);
+    }
+    EXPECT_EQ(snapshot.sum(), expectedSum);
+}
+
+} // namespace
+} // namespace wireguard_flutter
@@ -0,0 +1,260 @@
+#include "latency_probe.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace wireguard_flutter {
+namespace {
+
+using std::chrono::milliseconds;
+
+#ifdef _WIN32
+using SocketHandle = SOCKET;
+using AddressLength = int;
+
+void closeSocket(SocketHandle socket) {
+    closesocket(socket);
+}
+#else
+using SocketHandle = int;
+using AddressLength = socklen_t;
+
+void closeSocket(SocketHandle socket) {
+    ::close(socket);
+}
+#endif
+
+constexpr auto kPatience = std::chrono::seconds(10);
+
+// A UDP echo responder on the loopback that answers every |echoEvery|th
+// datagram; 0 never answers
+class Echo {
+public:
+    explicit Echo(uint32_t echoEvery = 1) : echoEvery_(echoEvery) {
+#ifdef _WIN32
+        WSADATA wsaData;
+        WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+        socket_ = ::socket(AF_INET, SOCK_DGRAM, 0);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        AddressLength length = sizeof(address);
+        bind(socket_, reinterpret_cast<const sockaddr*>(&address), length);
+        getsockname(socket_, reinterpret_cast<sockaddr*>(&address), &length);
+        port_ = ntohs(address.sin_port);
+        thread_ = std::thread([this] { echo(); });
+    }
+
+    ~Echo() {
+        stop_ = true;
+        thread_.join();
+        closeSocket(socket_);
+#ifdef _WIN32
+        WSACleanup();
+#endif
+    }
+
+    std::string endpoint() const { return "127.0.0.1:" + std::to_string(port_); }
+    uint32_t received() const { return received_; }
+
+private:
+    void echo() {
+        char buffer[64];
+        while (!stop_) {
+            fd_set set;
+            FD_ZERO(&set);
+            FD_SET(socket_, &set);
+            timeval timeout{0, 20000};
+            if (select(static_cast<int>(socket_) + 1, &set, nullptr, nullptr, &timeout) <= 0) {
+                continue;
+            }
+            sockaddr_storage from{};
+            AddressLength length = sizeof(from);
+            auto size = recvfrom(socket_, buffer, static_cast<int>(sizeof(buffer)), 0,
+                                 reinterpret_cast<sockaddr*>(&from), &length);
+            if (size <= 0) {
+                continue;
+            }
+            uint32_t count = received_++;
+            if (echoEvery_ != 0 && count % echoEvery_ == 0) {
+                sendto(socket_, buffer, static_cast<int>(size), 0, reinterpret_cast<const sockaddr*>(&from), length);
+            }
+        }
+    }
+
+    uint32_t echoEvery_;
+    SocketHandle socket_;
+    uint16_t port_ = 0;
+    std::atomic<uint32_t> received_{0};
+    std::atomic<bool> stop_{false};
+    std::thread thread_;
+};
+
+class LatencyProbeTest : public ::testing::Test {
+protected:
+    void SetUp() override { ASSERT_TRUE(loop_.start()); }
+    void TearDown() override {
+        probe_.close();
+        loop_.stop();
+    }
+
+    // The probe runs on the loop thread, as in the plugin
+    void onLoop(const std::function<void()>& task) {
+        std::promise<void> done;
+        auto finished = done.get_future();
+        loop_.post([&task, &done]() {
+            task();
+            done.set_value();
+        });
+        ASSERT_EQ(finished.wait_for(kPatience), std::future_status::ready);
+    }
+
+    // Sends |count| probes a little apart
+    void send(uint32_t count) {
+        for (uint32_t i = 0; i < count; i++) {
+            bool sent = false;
+            onLoop([&]() { sent = probe_.send(LatencyProbe::Clock::now()); });
+            EXPECT_TRUE(sent);
+            std::this_thread::sleep_for(milliseconds(10));
+        }
+    }
+
+    // Waits until |samples| echoes came back
+    RttTracker::Summary awaitSamples(uint32_t samples) {
+        RttTracker::Summary summary;
+        auto deadline = std::chrono::steady_clock::now() + kPatience;
+        while (std::chrono::steady_clock::now() < deadline) {
+            onLoop([&]() { summary = probe_.tracker().summary(); });
+            if (summary.samples >= samples) {
+                break;
+            }
+            std::this_thread::sleep_for(milliseconds(10));
+        }
+        return summary;
+    }
+
+    EventLoop loop_;
+    LatencyProbe probe_{loop_};
+};
+
+TEST_F(LatencyProbeTest, OpensAddressesOnly) {
+    onLoop([&]() {
+        EXPECT_FALSE(probe_.open("localhost:7"));
+        EXPECT_FALSE(probe_.open("10.0.0.1"));
+        EXPECT_FALSE(probe_.isOpen());
+        EXPECT_TRUE(probe_.open("127.0.0.1:7"));
+        EXPECT_TRUE(probe_.isOpen());
+        EXPECT_EQ(probe_.endpoint(), "127.0.0.1:7");
+    });
+}
+
+TEST_F(LatencyProbeTest, EchoesSettleTheProbes) {
+    Echo echo;
+    onLoop([&]() { ASSERT_TRUE(probe_.open(echo.endpoint())); });
+    send(5);
+
+    auto summary = awaitSamples(5);
+    EXPECT_EQ(summary.samples, 5u);
+    EXPECT_EQ(summary.lost, 0u);
+    EXPECT_EQ(summary.lossPpm, 0u);
+    EXPECT_GE(summary.minUs, 0);
+    EXPECT_LE(summary.p50Us, summary.p99Us);
+    // A loopback round trip, even on a loaded machine
+    EXPECT_LT(summary.p50Us, 1000000);
+    size_t inFlight = 1;
+    onLoop([&]() { inFlight = probe_.tracker().inFlight(); });
+    EXPECT_EQ(inFlight, 0u);
+}
+
+TEST_F(LatencyProbeTest, DroppedEchoesAreCountedLostAfterTheTimeout) {
+    Echo echo(2);
+    onLoop([&]() { ASSERT_TRUE(probe_.open(echo.endpoint())); });
+    send(10);
+
+    auto summary = awaitSamples(5);
+    EXPECT_EQ(summary.samples, 5u);
+    EXPECT_EQ(summary.lost, 0u);
+    onLoop([&]() {
+        auto& tracker = probe_.tracker();
+        EXPECT_EQ(tracker.inFlight(), 5u);
+        tracker.expire(LatencyProbe::Clock::now() + tracker.options().timeout);
+        summary = tracker.summary();
+    });
+    EXPECT_EQ(summary.samples, 5u);
+    EXPECT_EQ(summary.lost, 5u);
+    EXPECT_EQ(summary.lossPpm, 500000u);
+}
+
+// A target without an echo service is not a lossy path
+TEST_F(LatencyProbeTest, SilentTargetCountsNoLoss) {
+    Echo silent(0);
+    onLoop([&]() { ASSERT_TRUE(probe_.open(silent.endpoint())); });
+    send(3);
+
+    RttTracker::Summary summary;
+    bool answered = true;
+    size_t inFlight = 0;
+    // Sends expire what is past the timeout first
+    onLoop([&]() {
+        auto later = LatencyProbe::Clock::now() + probe_.tracker().options().timeout;
+        EXPECT_TRUE(probe_.send(later));
+        summary = probe_.tracker().summary();
+        answered = probe_.tracker().answered();
+        inFlight = probe_.tracker().inFlight();
+    });
+    auto deadline = std::chrono::steady_clock::now() + kPatience;
+    while (silent.received() < 4 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(milliseconds(10));
+    }
+    EXPECT_EQ(silent.received(), 4u);
+    EXPECT_FALSE(answered);
+    EXPECT_EQ(summary.samples, 0u);
+    EXPECT_EQ(summary.lost, 0u);
+    EXPECT_EQ(inFlight, 1u);
+}
+
+TEST_F(LatencyProbeTest, ClosedProbeSendsNothingAndKeepsTheTracker) {
+    Echo echo;
+    onLoop([&]() { ASSERT_TRUE(probe_.open(echo.endpoint())); });
+    send(2);
+    awaitSamples(2);
+
+    bool sent = true;
+    RttTracker::Summary summary;
+    onLoop([&]() {
+        probe_.close();
+        sent = probe_.send(LatencyProbe::Clock::now());
+        summary = probe_.tracker().summary();
+    });
+    EXPECT_FALSE(sent);
+    EXPECT_FALSE(probe_.isOpen());
+    EXPECT_TRUE(probe_.endpoint().empty());
+    EXPECT_EQ(summary.samples, 2u);
+
+    // Reopened, the sequences carry on
+    onLoop([&]() { ASSERT_TRUE(probe_.open(echo.endpoint())); });
+    send(1);
+    EXPECT_EQ(awaitSamples(3).samples, 3u);
+}
+
+} // namespace
+} // namespace wireguard_flutter
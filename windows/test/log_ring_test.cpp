@@ -0,0 +1,184 @@
+#include "log_ring.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace wireguard_flutter {
+namespace {
+
+constexpr size_t kMessageBytes = 120;
+
+// "<producer> <count> " padded with one letter that depends on both, so a
+// message stitched from two pushes shows
+std::string Message(uint32_t producer, uint64_t count) {
+    char prefix[32];
+    std::snprintf(prefix, sizeof(prefix), "%u %llu ", producer, static_cast<unsigned long long>(count));
+    std::string message(prefix);
+    message.append(kMessageBytes - message.size(), static_cast<char>('a' + (producer * 7 + count) % 26));
+    return message;
+}
+
+// Parses a message of Message(); false when it is torn
+bool Parse(const LogRing::Entry& entry, uint32_t& producer, uint64_t& count) {
+    unsigned parsedProducer = 0;
+    unsigned long long parsedCount = 0;
+    int used = 0;
+    if (entry.message.size() != kMessageBytes ||
+        std::sscanf(entry.message.c_str(), "%u %llu %n", &parsedProducer, &parsedCount, &used) != 2) {
+        return false;
+    }
+    producer = parsedProducer;
+    count = parsedCount;
+    char fill = static_cast<char>('a' + (producer * 7 + count) % 26);
+    return entry.message.find_first_not_of(fill, static_cast<size_t>(used)) == std::string::npos &&
+           entry.timestampMs == static_cast<int64_t>(count) &&
+           entry.level == static_cast<LogLevel>(producer % 4);
+}
+
+TEST(LogRingTest, CapacityIsAPowerOfTwo) {
+    EXPECT_EQ(LogRing(100).capacity(), 128u);
+    EXPECT_EQ(LogRing(0).capacity(), 2u);
+}
+
+TEST(LogRingTest, ReadsWhatWasPushedInOrder) {
+    LogRing ring(8);
+    ring.push(LogLevel::Info, 10, "first");
+    ring.push(LogLevel::Error, 20, "second");
+    uint64_t cursor = 0;
+    std::vector<LogRing::Entry> entries;
+    EXPECT_EQ(ring.read(cursor, 16, LogLevel::Debug, entries), 0u);
+    ASSERT_EQ(entries.size(), 2u);
+    EXPECT_EQ(entries[0].sequence, 0u);
+    EXPECT_EQ(entries[0].message, "first");
+    EXPECT_EQ(entries[0].timestampMs, 10);
+    EXPECT_EQ(entries[1].level, LogLevel::Error);
+    EXPECT_EQ(cursor, 2u);
+
+    EXPECT_EQ(ring.read(cursor, 16, LogLevel::Debug, entries), 0u);
+    EXPECT_TRUE(entries.empty());
+}
+
+TEST(LogRingTest, LevelFilterSkipsButConsumes) {
+    LogRing ring(8);
+    ring.push(LogLevel::Debug, 0, "debug");
+    ring.push(LogLevel::Warn, 0, "warn");
+    uint64_t cursor = 0;
+    std::vector<LogRing::Entry> entries;
+    ring.read(cursor, 16, LogLevel::Warn, entries);
+    ASSERT_EQ(entries.size(), 1u);
+    EXPECT_EQ(entries[0].message, "warn");
+    EXPECT_EQ(cursor, 2u);
+}
+
+TEST(LogRingTest, LaggingReaderCountsOverwrittenEntries) {
+    LogRing ring(8);
+    for (int i = 0; i < 20; i++) {
+        ring.push(LogLevel::Info, i, std::to_string(i));
+    }
+    uint64_t cursor = 0;
+    std::vector<LogRing::Entry> entries;
+    EXPECT_EQ(ring.read(cursor, 64, LogLevel::Debug, entries), 12u);
+    ASSERT_EQ(entries.size(), 8u);
+    EXPECT_EQ(entries.front().sequence, 12u);
+    EXPECT_EQ(entries.front().message, "12");
+    EXPECT_EQ(entries.back().sequence, 19u);
+}
+
+TEST(LogRingTest, TailKeepsTheNewestMatching) {
+    LogRing ring(8);
+    for (int i = 0; i < 6; i++) {
+        ring.push(i % 2 == 0 ? LogLevel::Info : LogLevel::Error, i, std::to_string(i));
+    }
+    std::vector<LogRing::Entry> entries;
+    ring.tail(2, LogLevel::Error, entries);
+    ASSERT_EQ(entries.size(), 2u);
+    EXPECT_EQ(entries[0].message, "3");
+    EXPECT_EQ(entries[1].message, "5");
+}
+
+TEST(LogRingTest, LongMessagesAreCutOnACharacterBoundary) {
+    LogRing ring(2);
+    // Two-byte characters, one straddling the limit
+    std::string message = "x";
+    while (message.size() < LogRing::kMaxMessageBytes + 8) {
+        message += "\xC3\xA9";
+    }
+    ring.push(LogLevel::Info, 0, message);
+    std::vector<LogRing::Entry> entries;
+    ring.tail(1, LogLevel::Debug, entries);
+    ASSERT_EQ(entries.size(), 1u);
+    EXPECT_EQ(entries[0].message.size(), LogRing::kMaxMessageBytes - 1);
+    EXPECT_EQ(entries[0].message, message.substr(0, LogRing::kMaxMessageBytes - 1));
+}
+
+// Producers race each other and a drainer that keeps up only part of the
+// time; every position is either delivered whole or counted as lost
+TEST(LogRingTest, ConcurrentProducersAndDrainer) {
+    constexpr uint32_t kProducers = 4;
+    constexpr uint64_t kPushes = 50000;
+    LogRing ring(256);
+
+    std::atomic<uint32_t> running{kProducers};
+    std::vector<std::thread> producers;
+    for (uint32_t p = 0; p < kProducers; p++) {
+        producers.emplace_back([&ring, &running, p]() {
+            for (uint64_t n = 0; n < kPushes; n++) {
+                ring.push(static_cast<LogLevel>(p % 4), static_cast<int64_t>(n), Message(p, n));
+            }
+            running--;
+        });
+    }
+
+    uint64_t cursor = 0;
+    uint64_t delivered = 0;
+    uint64_t lost = 0;
+    uint64_t torn = 0;
+    bool sequencesIncrease = true;
+    bool countsIncrease = true;
+    int64_t lastSequence = -1;
+    std::vector<int64_t> lastCount(kProducers, -1);
+    std::vector<LogRing::Entry> entries;
+    auto drain = [&]() {
+        lost += ring.read(cursor, 64, LogLevel::Debug, entries);
+        for (const auto& entry : entries) {
+            sequencesIncrease = sequencesIncrease && static_cast<int64_t>(entry.sequence) > lastSequence;
+            lastSequence = static_cast<int64_t>(entry.sequence);
+            uint32_t producer = 0;
+            uint64_t count = 0;
+            if (!Parse(entry, producer, count) || producer >= kProducers) {
+                torn++;
+                continue;
+            }
+            // Positions are claimed in push order
+            countsIncrease = countsIncrease && static_cast<int64_t>(count) > lastCount[producer];
+            lastCount[producer] = static_cast<int64_t>(count);
+        }
+        delivered += entries.size();
+    };
+    while (running > 0) {
+        drain();
+        std::this_thread::yield();
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    while (cursor < ring.head()) {
+        drain();
+    }
+
+    EXPECT_EQ(torn, 0u);
+    EXPECT_TRUE(sequencesIncrease);
+    EXPECT_TRUE(countsIncrease);
+    EXPECT_GT(delivered, 0u);
+    EXPECT_EQ(ring.head(), kProducers * kPushes);
+    EXPECT_EQ(delivered + lost, kProducers * kPushes);
+}
+
+} // namespace
+} // namespace wireguard_flutter
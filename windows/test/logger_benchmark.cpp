@@ -0,0 +1,125 @@
+// Times a log call on the calling thread while several threads log at once
+// and the writer formats behind them, and counts the heap allocations the
+// callers make. Fails when a caller allocates after its first record, when
+// a record is neither delivered nor counted as dropped, or when a call gets
+// slower than the budget.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "logger.h"
+
+namespace {
+
+// Only the logging threads count; the writer formats into strings
+thread_local bool countAllocations = false;
+std::atomic<size_t> allocations{0};
+
+} // namespace
+
+void* operator new(size_t size) {
+    if (countAllocations) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (void* memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+namespace wireguard_flutter {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int kRecordsPerThread = 200000;
+// A ceiling that catches a lock or formatting on the caller, with room for
+// a loaded machine; well under 100 ns is typical
+constexpr double kBudgetNsPerCall = 2000.0;
+
+int run() {
+    unsigned threads = std::max(2u, std::min(8u, std::thread::hardware_concurrency()));
+    std::mutex mutex;
+    uint64_t delivered = 0;
+    uint64_t dropped = 0;
+    Logger::setLevel(LogLevel::Info);
+    Logger::instance().setSink([&](const std::vector<Logger::Line>& lines) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& line : lines) {
+            unsigned long long count = 0;
+            if (std::sscanf(line.message.c_str(), "Logger: Dropped %llu records", &count) == 1) {
+                dropped += count;
+            } else {
+                delivered++;
+            }
+        }
+    });
+
+    std::atomic<int64_t> callerNs{0};
+    std::vector<std::thread> loggers;
+    for (unsigned t = 0; t < threads; t++) {
+        loggers.emplace_back([&, t]() {
+            // The first record sets up the thread's ring
+            WG_LOG_INFO("logger {} ready", t);
+            countAllocations = true;
+            auto started = Clock::now();
+            for (int i = 0; i < kRecordsPerThread; i++) {
+                WG_LOG_INFO("tunnel {} sample {}: {} bytes in, {} ms", "benchmark", i, i * 1500LL, 0.25);
+            }
+            auto elapsed = Clock::now() - started;
+            countAllocations = false;
+            callerNs += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        });
+    }
+    for (auto& logger : loggers) {
+        logger.join();
+    }
+    Logger::instance().flush();
+    Logger::instance().setSink(nullptr);
+
+    uint64_t logged = static_cast<uint64_t>(threads) * (kRecordsPerThread + 1);
+    double perCall = static_cast<double>(callerNs.load()) / (static_cast<double>(threads) * kRecordsPerThread);
+    std::printf("threads: %u, records: %llu, delivered: %llu, dropped: %llu\n", threads,
+                static_cast<unsigned long long>(logged), static_cast<unsigned long long>(delivered),
+                static_cast<unsigned long long>(dropped));
+    std::printf("time per call: %.1f ns\n", perCall);
+    std::printf("caller allocations: %zu\n", allocations.load());
+
+    if (delivered + dropped != logged) {
+        std::printf("FAIL: %llu records went missing\n",
+                    static_cast<unsigned long long>(logged - delivered - dropped));
+        return 1;
+    }
+    if (allocations.load() != 0) {
+        std::printf("FAIL: log calls allocate\n");
+        return 1;
+    }
+    if (perCall > kBudgetNsPerCall) {
+        std::printf("FAIL: a call took longer than %.0f ns\n", kBudgetNsPerCall);
+        return 1;
+    }
+    return 0;
+}
+
+} // namespace
+} // namespace wireguard_flutter
+
+int main() {
+    return wireguard_flutter::run();
+}
@@ -0,0 +1,142 @@
+#include "logger.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace wireguard_flutter {
+namespace {
+
+// Collects what reaches the sink; the logger itself lives for the process
+class LoggerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        previousLevel_ = Logger::currentLevel();
+        Logger::setLevel(LogLevel::Debug);
+        Logger::instance().flush();
+        Logger::instance().setSink([this](const std::vector<Logger::Line>& lines) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            lines_.insert(lines_.end(), lines.begin(), lines.end());
+        });
+    }
+
+    void TearDown() override {
+        Logger::instance().flush();
+        Logger::instance().setSink(nullptr);
+        Logger::setLevel(previousLevel_);
+    }
+
+    std::vector<Logger::Line> lines() {
+        Logger::instance().flush();
+        std::lock_guard<std::mutex> lock(mutex_);
+        return lines_;
+    }
+
+    std::vector<std::string> messages() {
+        std::vector<std::string> out;
+        for (const auto& line : lines()) {
+            out.push_back(line.message);
+        }
+        return out;
+    }
+
+    LogLevel previousLevel_ = LogLevel::Info;
+    std::mutex mutex_;
+    std::vector<Logger::Line> lines_;
+};
+
+TEST_F(LoggerTest, SubstitutesArguments) {
+    std::string owned = "home";
+    WG_LOG_INFO("tunnel {} up after {} ms, {} retries, mtu {}", owned, 250, -3, 1420u);
+    WG_LOG_INFO("flags {} {} {}", true, false, 'x');
+    WG_LOG_INFO("ratio {}", 0.5);
+    WG_LOG_INFO("wide {}", std::wstring(L"caf\u00e9"));
+    WG_LOG_INFO("extra", 1, "two");
+    WG_LOG_INFO("too few {} {}", 1);
+    auto out = messages();
+    ASSERT_EQ(out.size(), 6u);
+    EXPECT_EQ(out[0], "tunnel home up after 250 ms, -3 retries, mtu 1420");
+    EXPECT_EQ(out[1], "flags true false x");
+    EXPECT_EQ(out[2], "ratio 0.5");
+    EXPECT_EQ(out[3], "wide caf\xc3\xa9");
+    EXPECT_EQ(out[4], "extra 1 two");
+    EXPECT_EQ(out[5], "too few 1 {}");
+}
+
+TEST_F(LoggerTest, LevelFiltersBeforeEncoding) {
+    Logger::setLevel(LogLevel::Warn);
+    int evaluated = 0;
+    auto count = [&evaluated]() { return ++evaluated; };
+    WG_LOG_INFO("hidden {}", count());
+    WG_LOG_WARN("shown {}", count());
+    WG_LOG_ERROR("shown {}", count());
+    auto out = lines();
+    ASSERT_EQ(out.size(), 2u);
+    EXPECT_EQ(evaluated, 2);
+    EXPECT_EQ(out[0].level, LogLevel::Warn);
+    EXPECT_EQ(out[1].level, LogLevel::Error);
+}
+
+TEST_F(LoggerTest, LongStringsAreCut) {
+    std::string longText(Logger::kMaxStringBytes * 2, 'a');
+    WG_LOG_INFO("{}", longText);
+    auto out = messages();
+    ASSERT_EQ(out.size(), 1u);
+    EXPECT_EQ(out[0].size(), Logger::kMaxStringBytes);
+}
+
+TEST_F(LoggerTest, FormatsTheLinePrefix) {
+    Logger::Line line;
+    line.timestampUs = (int64_t{13} * 3600 + 7 * 60 + 9) * 1000000 + 42000;
+    line.level = LogLevel::Warn;
+    line.thread = 3;
+    line.message = "message";
+    EXPECT_EQ(Logger::formatLine(line), "13:07:09.042 warn  [3] message");
+}
+
+TEST_F(LoggerTest, ConcurrentThreadsKeepTheirOrder) {
+    constexpr int kThreads = 4;
+    constexpr int kRecords = 5000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; t++) {
+        threads.emplace_back([t]() {
+            for (int i = 0; i < kRecords; i++) {
+                WG_LOG_INFO("thread {} record {}", t, i);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // Every record either arrives in order or is counted as dropped
+    std::map<int, int> last;
+    int received = 0;
+    uint64_t dropped = 0;
+    for (const auto& line : lines()) {
+        int thread = -1;
+        int record = -1;
+        if (std::sscanf(line.message.c_str(), "thread %d record %d", &thread, &record) == 2) {
+            auto it = last.find(thread);
+            if (it != last.end()) {
+                EXPECT_GT(record, it->second) << "thread " << thread;
+            }
+            last[thread] = record;
+            received++;
+        } else {
+            unsigned long long count = 0;
+            ASSERT_EQ(std::sscanf(line.message.c_str(), "Logger: Dropped %llu records", &count), 1) << line.message;
+            dropped += count;
+        }
+    }
+    EXPECT_EQ(static_cast<uint64_t>(received) + dropped, static_cast<uint64_t>(kThreads) * kRecords);
+    EXPECT_EQ(last.size(), static_cast<size_t>(kThreads));
+}
+
+} // namespace
+} // namespace wireguard_flutter
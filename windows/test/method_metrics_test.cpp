@@ -0,0 +1,82 @@
+#include "method_metrics.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace wireguard_flutter {
+namespace {
+
+TEST(MethodMetricsTest, SameNameSameEntry) {
+    MethodMetrics metrics;
+    auto& start = metrics.method("start");
+    EXPECT_EQ(&metrics.method("start"), &start);
+    EXPECT_NE(&metrics.method("stop"), &start);
+    EXPECT_EQ(start.name, "start");
+}
+
+TEST(MethodMetricsTest, SummaryListsCalledMethodsByName) {
+    MethodMetrics metrics;
+    metrics.method("stop").calls++;
+    auto& start = metrics.method("start");
+    start.calls += 2;
+    start.errors++;
+    start.latencyUs.record(150);
+    metrics.method("unused");
+
+    std::vector<MethodMetrics::Summary> summary;
+    metrics.summarize(summary);
+    ASSERT_EQ(summary.size(), 2u);
+    EXPECT_EQ(summary[0].name, "start");
+    EXPECT_EQ(summary[0].calls, 2u);
+    EXPECT_EQ(summary[0].errors, 1u);
+    EXPECT_EQ(summary[0].latencyUs.count(), 1u);
+    EXPECT_EQ(summary[1].name, "stop");
+
+    metrics.reset();
+    metrics.summarize(summary);
+    EXPECT_TRUE(summary.empty());
+    EXPECT_EQ(&metrics.method("start"), &start);
+}
+
+TEST(MethodMetricsTest, MethodsBeyondTheTableShareOther) {
+    MethodMetrics metrics;
+    for (size_t i = 0; i < MethodMetrics::kMaxMethods; i++) {
+        EXPECT_EQ(metrics.method("method" + std::to_string(i)).name, "method" + std::to_string(i));
+    }
+    auto& overflow = metrics.method("one-too-many");
+    EXPECT_EQ(overflow.name, "other");
+    EXPECT_EQ(&metrics.method("another"), &overflow);
+}
+
+TEST(MethodMetricsTest, ConcurrentCallersShareEntries) {
+    MethodMetrics metrics;
+    constexpr int kThreads = 8;
+    constexpr int kCalls = 20000;
+    const char* names[] = {"start", "stop", "stage", "getStatistics"};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; t++) {
+        threads.emplace_back([&, t]() {
+            for (int i = 0; i < kCalls; i++) {
+                auto& entry = metrics.method(names[(t + i) % 4]);
+                entry.calls.fetch_add(1, std::memory_order_relaxed);
+                entry.latencyUs.record(i % 5000);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    std::vector<MethodMetrics::Summary> summary;
+    metrics.summarize(summary);
+    ASSERT_EQ(summary.size(), 4u);
+    for (const auto& entry : summary) {
+        EXPECT_EQ(entry.calls, static_cast<uint64_t>(kThreads) * kCalls / 4) << entry.name;
+        EXPECT_EQ(entry.latencyUs.count(), entry.calls) << entry.name;
+    }
+}
+
+} // namespace
+} // namespace wireguard_flutter
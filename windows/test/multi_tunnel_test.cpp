@@ -0,0 +1,516 @@
+// Many tunnels driven by the TunnelRegistry through one shared tick on an
+// EventLoop, against a fake backend whose adapters come and go on other
+// threads. Each tunnel publishes to its own counter block and queues stage
+// changes by name, while readers poll every block.
+
+#include "tunnel_registry.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "coalescing_queue.h"
+#include "monitor_cadence.h"
+#include "stats_block.h"
+#include "tunnel_state.h"
+#include "tunnel_stats.h"
+
+namespace wireguard_flutter {
+namespace {
+
+using std::chrono::milliseconds;
+using Stages = CoalescingQueue<std::string, std::string>;
+
+constexpr size_t kTunnels = 100;
+constexpr auto kPatience = std::chrono::seconds(10);
+
+MonitorCadence::Options Cadence() {
+    MonitorCadence::Options options;
+    options.fast = milliseconds(1);
+    options.settling = milliseconds(2);
+    options.stable = milliseconds(4);
+    options.idle = milliseconds(10000);
+    return options;
+}
+
+std::string Name(size_t i) {
+    return "multi-tunnel-" + std::to_string(i);
+}
+
+// A tunnel whose service and adapter are a flag other threads flip. Ticks
+// the way WireGuardTunnelManager does: connects once the adapter is up,
+// drops when it goes away and samples its counters while someone listens.
+class FakeTunnel : public TunnelRegistry::Tunnel {
+public:
+    FakeTunnel(const std::string& name, Stages& stages) : name(name), stages_(stages), cadence_(Cadence()) {
+        block = &TunnelStatsBlock(name, index);
+        block->publishState(WIREGUARD_FLUTTER_STATE_DISCONNECTED);
+    }
+
+    bool isActive() const override {
+        TunnelState current = state.state();
+        return current == TunnelState::Connecting || current == TunnelState::Connected;
+    }
+
+    std::chrono::milliseconds monitorTick(bool listened) override {
+        ticks++;
+        auto current = state.snapshot();
+        bool up = adapterUp;
+        auto activity = MonitorCadence::Activity::Connected;
+        if (current.state == TunnelState::Connecting && up) {
+            enter(current, TunnelState::Connected);
+            cadence_.reset();
+        } else if (current.state == TunnelState::Connecting) {
+            activity = MonitorCadence::Activity::Connecting;
+        } else if (current.state == TunnelState::Connected && !up) {
+            enter(current, TunnelState::Disconnected);
+        } else if (current.state == TunnelState::Connected && listened) {
+            bytes += 1000;
+            TunnelStats stats{};
+            stats.bytesIn = bytes;
+            stats.bytesOut = bytes * 2;
+            block->publish(stats, WIREGUARD_FLUTTER_STATE_CONNECTED, 0);
+        }
+        return cadence_.next(activity, listened);
+    }
+
+    void onNetworkChange() override { networkChanges++; }
+
+    void configureStatistics(const RateEstimator::Options& options) override { statistics = options; }
+    void configureReconnect(const ReconnectPolicy::Options& options) override { reconnect = options; }
+    void configureKeepalive(bool adaptive, const KeepaliveTuner::Options&) override { adaptiveKeepalive = adaptive; }
+    void configureLatencyProbe(const LatencyProbe::Options&) override { latencyConfigured = true; }
+
+    // Any thread, like startTunnel and stopTunnel
+    bool connect() { return enter(TunnelState::Connecting); }
+    void disconnect() {
+        adapterUp = false;
+        if (enter(TunnelState::Disconnecting)) {
+            enter(TunnelState::Disconnected);
+        }
+    }
+
+    const std::string name;
+    TunnelStateMachine state;
+    StatsBlock* block = nullptr;
+    int32_t index = -1;
+    // The fake backend's adapter
+    std::atomic<bool> adapterUp{false};
+
+    // Loop thread only
+    uint64_t ticks = 0;
+    uint64_t bytes = 0;
+    uint32_t networkChanges = 0;
+    RateEstimator::Options statistics;
+    ReconnectPolicy::Options reconnect;
+    bool adaptiveKeepalive = false;
+    bool latencyConfigured = false;
+
+private:
+    bool enter(TunnelState next) {
+        TunnelStateMachine::Snapshot previous;
+        if (!state.transition(next, &previous)) {
+            return false;
+        }
+        publish(next, previous.generation + 1);
+        return true;
+    }
+
+    bool enter(const TunnelStateMachine::Snapshot& expected, TunnelState next) {
+        if (!state.transition(expected, next)) {
+            return false;
+        }
+        publish(next, expected.generation + 1);
+        return true;
+    }
+
+    void publish(TunnelState next, uint64_t generation) {
+        block->publishState(static_cast<WireguardFlutterTunnelState>(next));
+        stages_.pushState(name, TunnelStateMachine::stageName(next), generation);
+    }
+
+    Stages& stages_;
+    MonitorCadence cadence_;
+};
+
+class FakeBackend : public TunnelRegistry::Backend {
+public:
+    std::unique_ptr<TunnelRegistry::Tunnel> create(const std::string& name) override {
+        created++;
+        return std::make_unique<FakeTunnel>(name, stages);
+    }
+
+    bool hasListener() const override { return listening; }
+
+    void watchNetwork(std::function<void()> changed) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        changed_ = std::move(changed);
+    }
+
+    void unwatchNetwork() override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        changed_ = nullptr;
+    }
+
+    // Like a route notification on a pool thread
+    void changeNetwork() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (changed_) {
+            changed_();
+        }
+    }
+
+    std::atomic<bool> listening{true};
+    std::atomic<uint32_t> created{0};
+    Stages stages{4096};
+
+private:
+    std::mutex mutex_;
+    std::function<void()> changed_;
+};
+
+class MultiTunnelTest : public ::testing::Test {
+protected:
+    void SetUp() override { ASSERT_TRUE(loop_.start()); }
+    void TearDown() override {
+        registry_.reset();
+        loop_.stop();
+    }
+
+    FakeTunnel& tunnel(size_t i) { return static_cast<FakeTunnel&>(registry_->getOrCreate(Name(i))); }
+
+    // Runs |task| between ticks, where the tunnels' loop state may be read
+    void onLoop(const std::function<void()>& task) {
+        std::promise<void> done;
+        auto finished = done.get_future();
+        loop_.post([&task, &done]() {
+            task();
+            done.set_value();
+        });
+        ASSERT_EQ(finished.wait_for(kPatience), std::future_status::ready);
+    }
+
+    // Waits until the registry's metrics satisfy |ready|
+    TunnelRegistry::Metrics awaitMetrics(const std::function<bool(const TunnelRegistry::Metrics&)>& ready) {
+        auto deadline = std::chrono::steady_clock::now() + kPatience;
+        auto metrics = registry_->metrics();
+        while (!ready(metrics) && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(milliseconds(1));
+            metrics = registry_->metrics();
+        }
+        return metrics;
+    }
+
+    // Connects the first |count| tunnels, with their adapters up or not
+    void connect(size_t count, bool up) {
+        for (size_t i = 0; i < count; i++) {
+            ASSERT_TRUE(tunnel(i).connect());
+            tunnel(i).adapterUp = up;
+        }
+        registry_->ensureTicking();
+    }
+
+    EventLoop loop_;
+    FakeBackend backend_;
+    std::unique_ptr<TunnelRegistry> registry_ = std::make_unique<TunnelRegistry>(loop_, backend_, nullptr);
+};
+
+TEST_F(MultiTunnelTest, HundredTunnelsShareOneTick) {
+    std::map<int32_t, std::string> indices;
+    for (size_t i = 0; i < kTunnels; i++) {
+        auto& created = tunnel(i);
+        ASSERT_GE(created.index, 0) << created.name;
+        EXPECT_TRUE(indices.emplace(created.index, created.name).second) << "block shared by " << created.name;
+        int32_t again = -2;
+        EXPECT_EQ(&TunnelStatsBlock(created.name, again), created.block);
+        EXPECT_EQ(again, created.index);
+    }
+    EXPECT_EQ(backend_.created, kTunnels);
+    EXPECT_EQ(registry_->tunnels().size(), kTunnels);
+
+    std::atomic<bool> done{false};
+    std::atomic<uint64_t> reads{0};
+    std::atomic<uint64_t> torn{0};
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 2; r++) {
+        readers.emplace_back([&]() {
+            WireguardFlutterStatsBlock snapshot;
+            while (!done) {
+                for (size_t i = 0; i < kTunnels; i++) {
+                    tunnel(i).block->read(snapshot);
+                    if (snapshot.bytes_out != snapshot.bytes_in * 2) {
+                        torn++;
+                    }
+                    reads++;
+                }
+            }
+        });
+    }
+
+    // Four threads play the platform thread and the services, each for a
+    // quarter of the tunnels, connecting and dropping them at random
+    std::vector<std::thread> drivers;
+    for (size_t d = 0; d < 4; d++) {
+        drivers.emplace_back([&, d]() {
+            std::mt19937 random(static_cast<uint32_t>(d));
+            for (int round = 0; round < 20; round++) {
+                for (size_t i = d; i < kTunnels; i += 4) {
+                    auto& driven = tunnel(i);
+                    switch (random() % 3) {
+                    case 0:
+                        // As the plugin does once a start succeeded
+                        if (driven.connect()) {
+                            registry_->ensureTicking();
+                        }
+                        driven.adapterUp = true;
+                        break;
+                    case 1:
+                        // The adapter going away on its own
+                        driven.adapterUp = false;
+                        break;
+                    default:
+                        driven.disconnect();
+                        break;
+                    }
+                }
+                std::this_thread::sleep_for(milliseconds(1));
+            }
+            for (size_t i = d; i < kTunnels; i += 4) {
+                tunnel(i).disconnect();
+            }
+        });
+    }
+    for (auto& driver : drivers) {
+        driver.join();
+    }
+    // A tick that saw an adapter before it went down is over once the loop
+    // has run something after it
+    onLoop([]() {});
+    done = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+
+    EXPECT_GT(registry_->metrics().ticks, 0u);
+    EXPECT_GT(reads.load(), 0u);
+    EXPECT_EQ(torn.load(), 0u);
+
+    // The latest stage of every tunnel is what its state machine says, and
+    // versions only ever grow per tunnel
+    std::vector<Stages::Entry> entries;
+    backend_.stages.drain(entries);
+    std::map<std::string, uint64_t> versions;
+    std::map<std::string, std::string> latest;
+    for (const auto& entry : entries) {
+        auto& version = versions[entry.key];
+        if (entry.version > version) {
+            version = entry.version;
+            latest[entry.key] = entry.value;
+        }
+    }
+    for (size_t i = 0; i < kTunnels; i++) {
+        auto& driven = tunnel(i);
+        auto snapshot = driven.state.snapshot();
+        EXPECT_EQ(snapshot.state, TunnelState::Disconnected) << driven.name;
+        EXPECT_FALSE(driven.isActive());
+        if (snapshot.generation > 0) {
+            EXPECT_EQ(versions[driven.name], snapshot.generation) << driven.name;
+            EXPECT_EQ(latest[driven.name], "disconnected") << driven.name;
+        }
+        WireguardFlutterStatsBlock block;
+        driven.block->read(block);
+        EXPECT_EQ(block.state, WIREGUARD_FLUTTER_STATE_DISCONNECTED) << driven.name;
+        EXPECT_EQ(block.bytes_in, 0) << driven.name;
+    }
+}
+
+TEST_F(MultiTunnelTest, EveryActiveTunnelRidesTheSameTick) {
+    uint64_t wakeupsBefore = loop_.wakeups();
+    connect(kTunnels, false);
+    awaitMetrics([](const TunnelRegistry::Metrics& metrics) { return metrics.ticks >= 50; });
+
+    TunnelRegistry::Metrics metrics;
+    std::vector<uint64_t> ticks;
+    uint64_t wakeups = 0;
+    onLoop([&]() {
+        metrics = registry_->metrics();
+        wakeups = loop_.wakeups() - wakeupsBefore;
+        for (size_t i = 0; i < kTunnels; i++) {
+            ticks.push_back(tunnel(i).ticks);
+        }
+    });
+    ASSERT_GE(metrics.ticks, 50u);
+    for (size_t i = 0; i < kTunnels; i++) {
+        EXPECT_EQ(ticks[i], metrics.ticks) << Name(i);
+    }
+    // One wakeup per tick, not one per tunnel, give or take the posts
+    EXPECT_LT(wakeups, metrics.ticks * 2 + 10);
+    EXPECT_EQ(metrics.interval, Cadence().fast);
+    EXPECT_FALSE(metrics.idle);
+}
+
+TEST_F(MultiTunnelTest, TickComesAsSoonAsAnyTunnelAsks) {
+    for (size_t i = 0; i < 10; i++) {
+        ASSERT_TRUE(tunnel(i).connect());
+        tunnel(i).adapterUp = i != 0;
+    }
+    registry_->ensureTicking();
+
+    // Nine tunnels settled, one still connecting
+    auto metrics = awaitMetrics([](const TunnelRegistry::Metrics& current) { return current.ticks >= 20; });
+    EXPECT_EQ(metrics.interval, Cadence().fast);
+
+    tunnel(0).adapterUp = true;
+    metrics = awaitMetrics(
+        [](const TunnelRegistry::Metrics& current) { return current.interval == Cadence().stable; });
+    EXPECT_EQ(metrics.interval, Cadence().stable);
+    EXPECT_EQ(tunnel(0).state.state(), TunnelState::Connected);
+}
+
+TEST_F(MultiTunnelTest, NobodyListeningOnlyWatchesTheLinks) {
+    ASSERT_EQ(StatsReaderCount(), 0);
+    backend_.listening = false;
+    connect(3, true);
+
+    auto metrics = awaitMetrics([](const TunnelRegistry::Metrics& current) { return current.idle; });
+    ASSERT_TRUE(metrics.idle);
+    EXPECT_EQ(metrics.interval, Cadence().idle);
+    uint64_t bytes = 1;
+    onLoop([&]() { bytes = tunnel(0).bytes; });
+    EXPECT_EQ(bytes, 0u);
+
+    // A listener brings the idle tick forward
+    backend_.listening = true;
+    registry_->wake();
+    metrics = awaitMetrics([](const TunnelRegistry::Metrics& current) { return !current.idle; });
+    EXPECT_FALSE(metrics.idle);
+    EXPECT_LT(metrics.interval, Cadence().idle);
+    onLoop([&]() { bytes = tunnel(0).bytes; });
+    EXPECT_GT(bytes, 0u);
+}
+
+TEST_F(MultiTunnelTest, ReadersKeepSamplingOn) {
+    backend_.listening = false;
+    connect(1, true);
+    ASSERT_TRUE(awaitMetrics([](const TunnelRegistry::Metrics& current) { return current.idle; }).idle);
+
+    // Statistics read through the method channel, for a while
+    registry_->noteStatisticsRead();
+    EXPECT_FALSE(awaitMetrics([](const TunnelRegistry::Metrics& current) { return !current.idle; }).idle);
+}
+
+TEST_F(MultiTunnelTest, CounterBlockReadersKeepSamplingOn) {
+    backend_.listening = false;
+    connect(1, true);
+    ASSERT_TRUE(awaitMetrics([](const TunnelRegistry::Metrics& current) { return current.idle; }).idle);
+
+    WireguardFlutterAddStatsReader();
+    registry_->wake();
+    auto metrics = awaitMetrics([](const TunnelRegistry::Metrics& current) { return !current.idle; });
+    WireguardFlutterRemoveStatsReader();
+    EXPECT_FALSE(metrics.idle);
+}
+
+TEST_F(MultiTunnelTest, TickStopsWithoutActiveTunnelsUntilTheNextStart) {
+    connect(2, true);
+    awaitMetrics([](const TunnelRegistry::Metrics& current) { return current.ticks >= 3; });
+    tunnel(0).disconnect();
+    tunnel(1).disconnect();
+
+    // The tick that finds nothing active is the last
+    std::this_thread::sleep_for(milliseconds(30));
+    uint64_t stopped = registry_->metrics().ticks;
+    std::this_thread::sleep_for(milliseconds(50));
+    EXPECT_EQ(registry_->metrics().ticks, stopped);
+
+    connect(1, true);
+    auto metrics = awaitMetrics([stopped](const TunnelRegistry::Metrics& current) {
+        return current.ticks > stopped + 3;
+    });
+    EXPECT_GT(metrics.ticks, stopped + 3);
+}
+
+TEST_F(MultiTunnelTest, NetworkChangesReachActiveTunnelsFolded) {
+    ResolverCache::Answer answer;
+    answer.ok = true;
+    answer.addresses = {"192.0.2.1"};
+    answer.ttl = std::chrono::seconds(300);
+    ResolverCache resolver([answer](const std::string&, std::function<void(ResolverCache::Answer)> done) {
+        done(answer);
+    });
+    // Its network watch ends with it
+    registry_.reset();
+    registry_ = std::make_unique<TunnelRegistry>(loop_, backend_, &resolver);
+    auto now = ResolverCache::Clock::now();
+    resolver.lookup("peer.example", now);
+    ASSERT_EQ(resolver.lookup("peer.example", now), std::vector<std::string>{"192.0.2.1"});
+    ASSERT_EQ(resolver.stats().fresh, 1u);
+
+    connect(2, true);
+    tunnel(2);
+
+    // Changes arriving while the loop is busy are dispatched once
+    std::promise<void> release;
+    auto busy = release.get_future().share();
+    loop_.post([busy]() { busy.wait(); });
+    backend_.changeNetwork();
+    backend_.changeNetwork();
+    backend_.changeNetwork();
+    release.set_value();
+
+    uint32_t changes[3] = {};
+    auto deadline = std::chrono::steady_clock::now() + kPatience;
+    while (changes[0] == 0 && std::chrono::steady_clock::now() < deadline) {
+        onLoop([&]() {
+            for (size_t i = 0; i < 3; i++) {
+                changes[i] = tunnel(i).networkChanges;
+            }
+        });
+    }
+    EXPECT_EQ(changes[0], 1u);
+    EXPECT_EQ(changes[1], 1u);
+    EXPECT_EQ(changes[2], 0u);
+    // The cached names were expired with it
+    resolver.lookup("peer.example", now);
+    EXPECT_EQ(resolver.stats().stale, 1u);
+
+    // Nothing reaches the tunnels once the registry is gone
+    registry_.reset();
+    backend_.changeNetwork();
+}
+
+TEST_F(MultiTunnelTest, SettingsReachExistingAndLaterTunnels) {
+    RateEstimator::Options statistics;
+    statistics.windowSamples = 7;
+    ReconnectPolicy::Options reconnect;
+    reconnect.maxAttempts = 3;
+    tunnel(0);
+    registry_->configureStatistics(statistics);
+    registry_->configureReconnect(reconnect);
+    registry_->configureKeepalive(true, KeepaliveTuner::Options());
+    registry_->configureLatencyProbe(LatencyProbe::Options());
+    tunnel(1);
+
+    for (size_t i = 0; i < 2; i++) {
+        EXPECT_EQ(tunnel(i).statistics.windowSamples, 7u) << Name(i);
+        EXPECT_EQ(tunnel(i).reconnect.maxAttempts, 3u) << Name(i);
+        EXPECT_TRUE(tunnel(i).adaptiveKeepalive) << Name(i);
+        EXPECT_TRUE(tunnel(i).latencyConfigured) << Name(i);
+    }
+    EXPECT_EQ(registry_->find(Name(0)), &tunnel(0));
+    EXPECT_EQ(registry_->find("never-started"), nullptr);
+    EXPECT_EQ(backend_.created, 2u);
+}
+
+} // namespace
+} // namespace wireguard_flutter
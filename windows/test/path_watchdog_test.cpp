@@ -0,0 +1,241 @@
+#include "path_watchdog.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace wireguard_flutter {
+namespace {
+
+using std::chrono::milliseconds;
+using Action = PathWatchdog::Action;
+using Cause = PathWatchdog::Cause;
+using Status = PathWatchdog::Status;
+
+struct Step {
+    int64_t atMs;
+    Action action;
+    Cause cause;
+    Status status;
+};
+
+// Replays a counter trace as the monitor samples it, one line per sample:
+//   <ms since start> <bytes in> <bytes out> <packets in> <packets out> <handshake age ms>
+// and returns the verdict after each line
+std::vector<Step> Replay(PathWatchdog& watchdog, const std::string& trace) {
+    std::vector<Step> steps;
+    std::istringstream lines(trace);
+    std::string line;
+    PathWatchdog::Clock::time_point start;
+    while (std::getline(lines, line)) {
+        std::istringstream fields(line);
+        int64_t atMs = 0;
+        PathWatchdog::Sample sample;
+        if (!(fields >> atMs >> sample.bytesIn >> sample.bytesOut >> sample.packetsIn >> sample.packetsOut >>
+              sample.handshakeAgeMs)) {
+            continue;
+        }
+        sample.at = start + milliseconds(atMs);
+        auto verdict = watchdog.addSample(sample);
+        steps.push_back(Step{atMs, verdict.action, verdict.cause, watchdog.status()});
+    }
+    return steps;
+}
+
+// The verdicts other than Action::None, as "<ms> <action> <cause>"
+std::vector<std::string> Actions(const std::vector<Step>& steps) {
+    static const char* kActions[] = {"none", "rehandshake", "failover", "recovered"};
+    std::vector<std::string> actions;
+    for (const auto& step : steps) {
+        if (step.action != Action::None) {
+            actions.push_back(std::to_string(step.atMs) + " " + kActions[static_cast<int>(step.action)] + " " +
+                              PathWatchdog::causeName(step.cause));
+        }
+    }
+    return actions;
+}
+
+PathWatchdog Watchdog() {
+    PathWatchdog watchdog;
+    watchdog.configure(PathWatchdog::Options());
+    return watchdog;
+}
+
+// An idle tunnel: persistent keepalives every 25 s both ways, which the
+// adapter counts as packets but without bytes worth noting
+const char* kIdle = R"(
+    0      1000   1000   10  10   5000
+    1000   1000   1000   10  10   6000
+    25000  1032   1032   11  11   30000
+    50000  1064   1064   12  12   55000
+    75000  1096   1096   13  13   80000
+    100000 1128   1128   14  14   105000
+)";
+
+// A download that keeps receiving, sampled every 250 ms
+const char* kBusy = R"(
+    0     0       0      0    0    2000
+    250   150000  4000   100  50   2250
+    500   300000  8000   200  100  2500
+    750   450000  12000  300  150  2750
+    1000  600000  16000  400  200  3000
+    1250  750000  20000  500  250  3250
+)";
+
+// The peer goes dark mid-download at 500 ms: requests keep going out and
+// nothing comes back
+const std::string kPeerGoesDark = R"(
+    0     0       0      0    0    2000
+    250   150000  4000   100  50   2250
+    500   300000  8000   200  100  2500
+    750   300000  8600   200  108  2750
+    1000  300000  9200   200  116  3000
+    1250  300000  9800   200  124  3250
+    1500  300000  10400  200  132  3500
+    2000  300000  11000  200  140  4000
+)";
+
+TEST(PathWatchdogTest, IdleTunnelStaysHealthy) {
+    auto watchdog = Watchdog();
+    auto steps = Replay(watchdog, kIdle);
+    EXPECT_TRUE(Actions(steps).empty());
+    EXPECT_EQ(watchdog.status(), Status::Healthy);
+}
+
+TEST(PathWatchdogTest, BusyTunnelStaysHealthy) {
+    auto watchdog = Watchdog();
+    auto steps = Replay(watchdog, kBusy);
+    EXPECT_TRUE(Actions(steps).empty());
+    for (const auto& step : steps) {
+        EXPECT_EQ(step.status, Status::Healthy) << step.atMs;
+    }
+}
+
+TEST(PathWatchdogTest, StalledReceiveDegradesAndHandshakeRecovers) {
+    auto watchdog = Watchdog();
+    // A new handshake completes at 2500 ms
+    auto steps = Replay(watchdog, kPeerGoesDark + R"(
+        2600  300000  11148  200  141  100
+    )");
+    ASSERT_EQ(steps.size(), 9u);
+    // Suspect from the first unanswered sample, degraded once 750 ms passed
+    // since that sample
+    EXPECT_EQ(steps[3].status, Status::Suspect);
+    EXPECT_EQ(steps[5].status, Status::Suspect);
+    EXPECT_EQ(Actions(steps), (std::vector<std::string>{"1500 rehandshake rx_stall", "2600 recovered rx_stall"}));
+}
+
+TEST(PathWatchdogTest, ReceivingRecoversAndReportsTheOutage) {
+    auto watchdog = Watchdog();
+    auto steps = Replay(watchdog, kPeerGoesDark + R"(
+        2500  300000  11148  200  141  4500
+        3100  301000  11300  204  143  5100
+    )");
+    EXPECT_EQ(Actions(steps), (std::vector<std::string>{"1500 rehandshake rx_stall", "3100 recovered rx_stall"}));
+    EXPECT_EQ(watchdog.status(), Status::Healthy);
+}
+
+TEST(PathWatchdogTest, DegradedPathAsksForFailoverOncePerPath) {
+    auto watchdog = Watchdog();
+    auto steps = Replay(watchdog, R"(
+        0     0     0     0   0   2000
+        500   0     600   0   8   2500
+        1500  0     1200  0   16  3500
+        4000  0     1300  0   17  6000
+        7000  0     1400  0   18  9000
+        7600  0     1500  0   19  9600
+        9000  0     1600  0   20  11000
+    )");
+    EXPECT_EQ(Actions(steps), (std::vector<std::string>{"1500 rehandshake rx_stall", "7600 failover rx_stall"}));
+    EXPECT_EQ(watchdog.status(), Status::Degraded);
+
+    // Traffic moved to the standby; still nothing back after failoverAfter
+    PathWatchdog::Clock::time_point start;
+    watchdog.onFailedOver(start + milliseconds(9000));
+    PathWatchdog::Sample sample;
+    sample.bytesOut = 1700;
+    sample.packetsOut = 21;
+    sample.handshakeAgeMs = 13000;
+    sample.at = start + milliseconds(11000);
+    EXPECT_EQ(watchdog.addSample(sample).action, Action::None);
+    sample.bytesOut = 1800;
+    sample.packetsOut = 22;
+    sample.handshakeAgeMs = 15000;
+    sample.at = start + milliseconds(15000);
+    EXPECT_EQ(watchdog.addSample(sample).action, Action::Failover);
+}
+
+// A slow trickle out, too little for a stall, but no keepalive back for
+// longer than a live peer allows
+TEST(PathWatchdogTest, MissedKeepaliveDegrades) {
+    auto watchdog = Watchdog();
+    auto steps = Replay(watchdog, R"(
+        0      500  500  5  5  1000
+        5000   500  700  5  6  6000
+        10000  500  700  5  6  11000
+        17000  500  700  5  6  18000
+    )");
+    EXPECT_EQ(Actions(steps), (std::vector<std::string>{"17000 rehandshake missed_keepalive"}));
+}
+
+TEST(PathWatchdogTest, StaleHandshakeDegradesAtOnce) {
+    auto watchdog = Watchdog();
+    auto steps = Replay(watchdog, R"(
+        0    500  500  5  5  179000
+        250  500  600  5  6  181000
+    )");
+    EXPECT_EQ(Actions(steps), (std::vector<std::string>{"250 rehandshake stale_handshake"}));
+}
+
+TEST(PathWatchdogTest, ShortBurstWithoutAnswerIsOnlySuspect) {
+    auto watchdog = Watchdog();
+    auto steps = Replay(watchdog, R"(
+        0     500  500  5  5  1000
+        250   500  540  5  6  1250
+        1500  500  540  5  6  2500
+        3000  500  540  5  6  4000
+    )");
+    EXPECT_TRUE(Actions(steps).empty());
+    EXPECT_EQ(watchdog.status(), Status::Suspect);
+}
+
+// The adapter was recreated between samples; its counters start over
+TEST(PathWatchdogTest, CountersGoingBackRestartTheBaseline) {
+    auto watchdog = Watchdog();
+    auto steps = Replay(watchdog, R"(
+        0     900000  50000  900  600  1000
+        250   900000  56000  900  700  1250
+        500   0       0      0    0    -1
+        750   0       600    0    8    -1
+        1000  0       1200   0    16   -1
+        1250  0       1800   0    24   -1
+    )");
+    EXPECT_TRUE(Actions(steps).empty());
+    EXPECT_EQ(watchdog.status(), Status::Suspect);
+}
+
+TEST(PathWatchdogTest, DisabledWatchdogSaysNothing) {
+    PathWatchdog::Options options;
+    options.enabled = false;
+    PathWatchdog watchdog;
+    watchdog.configure(options);
+    auto steps = Replay(watchdog, kPeerGoesDark);
+    EXPECT_TRUE(Actions(steps).empty());
+    EXPECT_EQ(watchdog.status(), Status::Healthy);
+}
+
+TEST(PathWatchdogTest, ResetForgetsADegradedPath) {
+    auto watchdog = Watchdog();
+    Replay(watchdog, kPeerGoesDark);
+    ASSERT_EQ(watchdog.status(), Status::Degraded);
+    watchdog.reset();
+    EXPECT_EQ(watchdog.status(), Status::Healthy);
+    EXPECT_EQ(watchdog.cause(), Cause::None);
+}
+
+} // namespace
+} // namespace wireguard_flutter
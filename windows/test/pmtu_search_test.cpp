@@ -0,0 +1,118 @@
+#include "pmtu_search.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+namespace wireguard_flutter {
+namespace {
+
+using Outcome = PmtuSearch::Outcome;
+
+// Answers every probe like a path with |mtu| would, from a router that
+// reports "too big"; returns the probes it took
+uint32_t SearchPath(PmtuSearch& search, uint32_t mtu) {
+    while (!search.done()) {
+        uint32_t size = search.next();
+        search.onOutcome(size, size <= mtu ? Outcome::Reply : Outcome::TooBig);
+    }
+    return search.probes();
+}
+
+TEST(PmtuSearchTest, CeilingIsTriedFirst) {
+    PmtuSearch search;
+    EXPECT_EQ(search.next(), 1500u);
+    search.onOutcome(1500, Outcome::Reply);
+    EXPECT_TRUE(search.done());
+    EXPECT_EQ(search.pathMtu(), 1500u);
+    EXPECT_EQ(search.probes(), 1u);
+}
+
+TEST(PmtuSearchTest, FloorIsTriedAfterTheCeiling) {
+    PmtuSearch search;
+    search.onOutcome(1500, Outcome::TooBig);
+    EXPECT_EQ(search.next(), 576u);
+}
+
+TEST(PmtuSearchTest, BisectsToThePathMtu) {
+    for (uint32_t mtu : {576u, 577u, 1280u, 1420u, 1492u, 1499u}) {
+        PmtuSearch search;
+        uint32_t probes = SearchPath(search, mtu);
+        EXPECT_EQ(search.pathMtu(), mtu) << mtu;
+        // Ceiling, floor and ten halvings of the 924 sizes in between
+        EXPECT_LE(probes, 12u) << mtu;
+    }
+}
+
+TEST(PmtuSearchTest, PrecisionStopsTheSearchEarly) {
+    PmtuSearch::Options options;
+    options.precision = 16;
+    PmtuSearch search(options);
+    uint32_t probes = SearchPath(search, 1400);
+    EXPECT_LE(search.pathMtu(), 1400u);
+    EXPECT_GT(search.pathMtu() + 16, 1400u);
+    EXPECT_LT(probes, 10u);
+}
+
+TEST(PmtuSearchTest, LossIsRetriedBeforeItCounts) {
+    PmtuSearch search;
+    search.onOutcome(1500, Outcome::Loss);
+    EXPECT_EQ(search.next(), 1500u);
+    search.onOutcome(1500, Outcome::Loss);
+    EXPECT_EQ(search.next(), 576u);
+    EXPECT_EQ(search.probes(), 2u);
+}
+
+TEST(PmtuSearchTest, OneLossAmongRepliesCostsARetry) {
+    PmtuSearch search;
+    search.onOutcome(1500, Outcome::TooBig);
+    search.onOutcome(576, Outcome::Loss);
+    search.onOutcome(576, Outcome::Reply);
+    uint32_t probes = SearchPath(search, 1420);
+    EXPECT_EQ(search.pathMtu(), 1420u);
+    EXPECT_LE(probes, 13u);
+}
+
+TEST(PmtuSearchTest, SilentPathEndsWithoutAnMtu) {
+    PmtuSearch::Options options;
+    options.attempts = 3;
+    PmtuSearch search(options);
+    while (!search.done()) {
+        search.onOutcome(search.next(), Outcome::Loss);
+    }
+    EXPECT_EQ(search.pathMtu(), 0u);
+    EXPECT_EQ(search.probes(), 6u);
+}
+
+TEST(PmtuSearchTest, OutcomesForOtherSizesAreIgnored) {
+    PmtuSearch search;
+    search.onOutcome(1400, Outcome::Reply);
+    EXPECT_EQ(search.next(), 1500u);
+    EXPECT_EQ(search.probes(), 0u);
+    search.onOutcome(1500, Outcome::Reply);
+    search.onOutcome(1500, Outcome::TooBig);
+    EXPECT_EQ(search.pathMtu(), 1500u);
+    EXPECT_EQ(search.probes(), 1u);
+}
+
+TEST(PmtuSearchTest, OptionsAreClamped) {
+    PmtuSearch::Options options;
+    options.floor = 1280;
+    options.ceiling = 1000;
+    options.attempts = 0;
+    PmtuSearch search(options);
+    EXPECT_EQ(search.next(), 1280u);
+    search.onOutcome(1280, Outcome::Loss);
+    EXPECT_TRUE(search.done());
+}
+
+TEST(PmtuSearchTest, TunnelMtuLeavesRoomForTheEncapsulation) {
+    EXPECT_EQ(PmtuSearch::tunnelMtu(1500, false), 1440u);
+    EXPECT_EQ(PmtuSearch::tunnelMtu(1500, true), 1420u);
+    EXPECT_EQ(PmtuSearch::tunnelMtu(1280, true), 1200u);
+    EXPECT_EQ(PmtuSearch::tunnelMtu(600, false), 576u);
+    EXPECT_EQ(PmtuSearch::tunnelMtu(0, true), 576u);
+}
+
+} // namespace
+} // namespace wireguard_flutter
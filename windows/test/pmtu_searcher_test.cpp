@@ -0,0 +1,356 @@
+#include "pmtu_searcher.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace wireguard_flutter {
+namespace {
+
+using std::chrono::milliseconds;
+using Outcome = PmtuSearch::Outcome;
+
+#ifdef _WIN32
+using SocketHandle = SOCKET;
+using AddressLength = int;
+
+void closeSocket(SocketHandle socket) {
+    closesocket(socket);
+}
+#else
+using SocketHandle = int;
+using AddressLength = socklen_t;
+
+void closeSocket(SocketHandle socket) {
+    ::close(socket);
+}
+#endif
+
+constexpr auto kPatience = std::chrono::seconds(10);
+// IPv4 and UDP headers; a probe of |size| carries the rest as payload
+constexpr uint32_t kHeaders = 20 + 8;
+
+SocketHandle LoopbackSocket(uint16_t& port) {
+    SocketHandle handle = ::socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    AddressLength length = sizeof(address);
+    bind(handle, reinterpret_cast<const sockaddr*>(&address), length);
+    getsockname(handle, reinterpret_cast<sockaddr*>(&address), &length);
+    port = ntohs(address.sin_port);
+    return handle;
+}
+
+// A path on the loopback: echoes the datagrams that fit in |pathMtu| and
+// drops larger ones, like a router that cannot forward them; 0 drops all
+class Responder {
+public:
+    explicit Responder(uint32_t pathMtu) : pathMtu_(pathMtu) {
+#ifdef _WIN32
+        WSADATA wsaData;
+        WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+        socket_ = LoopbackSocket(port_);
+        thread_ = std::thread([this] { echo(); });
+    }
+
+    ~Responder() {
+        stop_ = true;
+        thread_.join();
+        closeSocket(socket_);
+#ifdef _WIN32
+        WSACleanup();
+#endif
+    }
+
+    uint16_t port() const { return port_; }
+    uint32_t dropped() const { return dropped_; }
+
+private:
+    void echo() {
+        std::vector<char> buffer(65536);
+        while (!stop_) {
+            fd_set set;
+            FD_ZERO(&set);
+            FD_SET(socket_, &set);
+            timeval timeout{0, 20000};
+            if (select(static_cast<int>(socket_) + 1, &set, nullptr, nullptr, &timeout) <= 0) {
+                continue;
+            }
+            sockaddr_storage from{};
+            AddressLength length = sizeof(from);
+            auto size = recvfrom(socket_, buffer.data(), static_cast<int>(buffer.size()), 0,
+                                 reinterpret_cast<sockaddr*>(&from), &length);
+            if (size < 0) {
+                continue;
+            }
+            if (static_cast<uint32_t>(size) + kHeaders > pathMtu_) {
+                dropped_++;
+                continue;
+            }
+            sendto(socket_, buffer.data(), static_cast<int>(size), 0, reinterpret_cast<const sockaddr*>(&from),
+                   length);
+        }
+    }
+
+    uint32_t pathMtu_;
+    SocketHandle socket_;
+    uint16_t port_ = 0;
+    std::atomic<uint32_t> dropped_{0};
+    std::atomic<bool> stop_{false};
+    std::thread thread_;
+};
+
+// Probes the responder with UDP datagrams of the probed size; sizes over
+// |interfaceMtu| are refused at once, as the local stack does
+class UdpProber : public PmtuSearcher::Prober {
+public:
+    UdpProber(uint16_t port, uint32_t interfaceMtu) : interfaceMtu_(interfaceMtu) {
+#ifdef _WIN32
+        WSADATA wsaData;
+        WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+        uint16_t local = 0;
+        socket_ = LoopbackSocket(local);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(port);
+        connect(socket_, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+#ifdef _WIN32
+        event_ = WSACreateEvent();
+        WSAEventSelect(socket_, event_, FD_READ);
+#else
+        fcntl(socket_, F_SETFL, fcntl(socket_, F_GETFL) | O_NONBLOCK);
+#endif
+    }
+
+    ~UdpProber() override {
+        closeSocket(socket_);
+#ifdef _WIN32
+        WSACloseEvent(event_);
+        WSACleanup();
+#endif
+    }
+
+    bool send(uint32_t size, milliseconds, Outcome& outcome) override {
+        sizes.push_back(size);
+        if (size > interfaceMtu_) {
+            outcome = Outcome::TooBig;
+            return false;
+        }
+        expected_ = size - kHeaders;
+        std::vector<char> payload(expected_, 0x5a);
+        ::send(socket_, payload.data(), static_cast<int>(payload.size()), 0);
+        return true;
+    }
+
+    EventLoop::Waitable waitable() const override {
+#ifdef _WIN32
+        return event_;
+#else
+        return socket_;
+#endif
+    }
+
+    // A late echo of an earlier, smaller probe does not count
+    Outcome collect() override {
+#ifdef _WIN32
+        WSANETWORKEVENTS events;
+        WSAEnumNetworkEvents(socket_, event_, &events);
+#endif
+        Outcome outcome = Outcome::Loss;
+        std::vector<char> buffer(65536);
+        for (;;) {
+            auto size = recv(socket_, buffer.data(), static_cast<int>(buffer.size()), 0);
+            if (size < 0) {
+                break;
+            }
+            if (static_cast<uint32_t>(size) == expected_) {
+                outcome = Outcome::Reply;
+            }
+        }
+        return outcome;
+    }
+
+    // Sizes sent or refused, in order
+    std::vector<uint32_t> sizes;
+
+private:
+    uint32_t interfaceMtu_;
+    SocketHandle socket_;
+#ifdef _WIN32
+    WSAEVENT event_ = nullptr;
+#endif
+    uint32_t expected_ = 0;
+};
+
+struct Finished {
+    uint32_t pathMtu = 0;
+    uint32_t probes = 0;
+    bool done = false;
+    bool interrupted = false;
+};
+
+class PmtuSearcherTest : public ::testing::Test {
+protected:
+    void SetUp() override { ASSERT_TRUE(loop_.start()); }
+    void TearDown() override { loop_.stop(); }
+
+    // Searches between |floor| and |ceiling| and waits for the result
+    Finished search(PmtuSearcher& searcher, uint32_t floor, uint32_t ceiling) {
+        PmtuSearch::Options options;
+        options.floor = floor;
+        options.ceiling = ceiling;
+        options.attempts = 1;
+        auto finished = std::make_shared<std::promise<Finished>>();
+        auto result = finished->get_future();
+        loop_.post([&searcher, options, finished]() {
+            searcher.start(options, kTimeout, [finished](const PmtuSearch& search, bool interrupted) {
+                finished->set_value(Finished{search.pathMtu(), search.probes(), search.done(), interrupted});
+            });
+        });
+        EXPECT_EQ(result.wait_for(kPatience), std::future_status::ready);
+        return result.get();
+    }
+
+    static constexpr milliseconds kTimeout{100};
+    EventLoop loop_;
+};
+
+TEST_F(PmtuSearcherTest, FindsTheLargestSizeThePathCarries) {
+    Responder path(1400);
+    UdpProber prober(path.port(), 1500);
+    PmtuSearcher searcher(loop_, prober);
+    auto finished = search(searcher, 576, 1500);
+
+    EXPECT_TRUE(finished.done);
+    EXPECT_FALSE(finished.interrupted);
+    EXPECT_EQ(finished.pathMtu, 1400u);
+    EXPECT_GT(path.dropped(), 0u);
+    // The ceiling, then the floor, then bisection
+    ASSERT_GE(prober.sizes.size(), 3u);
+    EXPECT_EQ(prober.sizes[0], 1500u);
+    EXPECT_EQ(prober.sizes[1], 576u);
+    EXPECT_EQ(finished.probes, prober.sizes.size());
+}
+
+TEST_F(PmtuSearcherTest, CeilingThatPassesEndsAtOnce) {
+    Responder path(1500);
+    UdpProber prober(path.port(), 1500);
+    PmtuSearcher searcher(loop_, prober);
+    auto finished = search(searcher, 576, 1500);
+
+    EXPECT_EQ(finished.pathMtu, 1500u);
+    EXPECT_EQ(finished.probes, 1u);
+    EXPECT_EQ(path.dropped(), 0u);
+}
+
+TEST_F(PmtuSearcherTest, SizesTheStackRefusesNeedNoWait) {
+    Responder path(1500);
+    UdpProber prober(path.port(), 1300);
+    PmtuSearcher searcher(loop_, prober);
+    auto started = std::chrono::steady_clock::now();
+    auto finished = search(searcher, 576, 1500);
+
+    EXPECT_EQ(finished.pathMtu, 1300u);
+    EXPECT_FALSE(finished.interrupted);
+    // Every size went through or was refused; none timed out
+    EXPECT_LT(std::chrono::steady_clock::now() - started, kTimeout * static_cast<int>(finished.probes));
+}
+
+TEST_F(PmtuSearcherTest, PathWithoutRepliesFindsNothing) {
+    Responder path(0);
+    UdpProber prober(path.port(), 1500);
+    PmtuSearcher searcher(loop_, prober);
+    auto started = std::chrono::steady_clock::now();
+    auto finished = search(searcher, 576, 1500);
+
+    EXPECT_TRUE(finished.done);
+    EXPECT_FALSE(finished.interrupted);
+    EXPECT_EQ(finished.pathMtu, 0u);
+    EXPECT_EQ(prober.sizes, (std::vector<uint32_t>{1500, 576}));
+    EXPECT_GE(std::chrono::steady_clock::now() - started, kTimeout * 2);
+}
+
+TEST_F(PmtuSearcherTest, NoRoomForTheWaitInterruptsTheSearch) {
+    Responder path(1400);
+    UdpProber prober(path.port(), 1500);
+    PmtuSearcher searcher(loop_, prober);
+
+    // Handles nothing signals take every wait the loop has
+    std::vector<SocketHandle> idle;
+    std::vector<EventLoop::TaskId> waits;
+    for (;;) {
+        uint16_t port = 0;
+        idle.push_back(LoopbackSocket(port));
+#ifdef _WIN32
+        WSAEVENT event = WSACreateEvent();
+        WSAEventSelect(idle.back(), event, FD_READ);
+        EventLoop::TaskId wait = loop_.addWait(event, []() {});
+#else
+        EventLoop::TaskId wait = loop_.addWait(idle.back(), []() {});
+#endif
+        if (wait == 0) {
+            break;
+        }
+        waits.push_back(wait);
+    }
+    EXPECT_EQ(waits.size(), EventLoop::kMaxWaits);
+
+    auto finished = search(searcher, 576, 1500);
+    EXPECT_TRUE(finished.interrupted);
+    EXPECT_FALSE(finished.done);
+    EXPECT_EQ(prober.sizes, (std::vector<uint32_t>{1500}));
+
+    for (auto wait : waits) {
+        loop_.cancel(wait);
+    }
+    for (auto handle : idle) {
+        closeSocket(handle);
+    }
+}
+
+TEST_F(PmtuSearcherTest, CancelStopsWithoutReporting) {
+    Responder path(0);
+    UdpProber prober(path.port(), 1500);
+    PmtuSearcher searcher(loop_, prober);
+    std::atomic<bool> reported{false};
+    std::promise<void> started;
+    loop_.post([&]() {
+        PmtuSearch::Options options;
+        searcher.start(options, kTimeout, [&reported](const PmtuSearch&, bool) { reported = true; });
+        started.set_value();
+    });
+    ASSERT_EQ(started.get_future().wait_for(kPatience), std::future_status::ready);
+    EXPECT_TRUE(searcher.running());
+    searcher.cancel();
+    EXPECT_FALSE(searcher.running());
+
+    std::this_thread::sleep_for(kTimeout * 3);
+    EXPECT_FALSE(reported);
+}
+
+} // namespace
+} // namespace wireguard_flutter
@@ -0,0 +1,225 @@
+// Runs many endpoint races at once on one event loop, the way tunnels
+// started together do, against adapters that take a while to create.
+// Half the races have a peer that answers, the rest run into their
+// timeout. Prints when the races finished and how late the loop ran a
+// steady timer meanwhile; fails when creating adapters or waiting for
+// handshakes holds up the loop, or races wait on each other.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "endpoint_racer.h"
+#include "event_loop.h"
+#include "logger.h"
+
+namespace wireguard_flutter {
+namespace {
+
+using std::chrono::milliseconds;
+using Clock = std::chrono::steady_clock;
+
+constexpr int kRaces = 100;
+constexpr milliseconds kCreateDelay{250};
+constexpr milliseconds kRaceTimeout{300};
+// Generous ceilings; creating the adapters one after another would take
+// kCreateDelay for each
+constexpr milliseconds kMaxLoopLateness{150};
+constexpr milliseconds kSlack{200};
+
+const std::string kPrivateKey = "yAnz5TF+lXXJte14tji3zlMNq+hd2rYUIgJBgB3fBmk=";
+const std::string kServerKey = "xTIBA5rboUvnH4htodjb6e697QjLERt1NAB4mZqp8Dg=";
+
+// Adapters come up after kCreateDelay, each on a thread of its own; peers
+// at an answering endpoint complete their handshake at once
+class SlowBackend : public EndpointRacer::Backend {
+public:
+    ~SlowBackend() override {
+        for (auto& thread : threads_) {
+            thread.join();
+        }
+    }
+
+    void create(uint64_t race, size_t slot, const EndpointRacer::Slot& config,
+                std::function<void(bool)> done) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        adapters_[{race, slot}] = config;
+        threads_.emplace_back([done]() {
+            std::this_thread::sleep_for(kCreateDelay);
+            done(true);
+        });
+    }
+
+    bool setUp(uint64_t, size_t) override { return true; }
+
+    bool hasHandshake(uint64_t race, size_t slot, const std::string& publicKey) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& peer : adapters_[{race, slot}].peers) {
+            if (peer.publicKey == publicKey && answering_.count(peer.endpoint) != 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void close(uint64_t race, std::function<void()> done) override {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            adapters_.erase(adapters_.lower_bound({race, 0}), adapters_.lower_bound({race + 1, 0}));
+        }
+        done();
+    }
+
+    void answer(const std::string& endpoint) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        answering_.insert(endpoint);
+    }
+
+    size_t open() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return adapters_.size();
+    }
+
+private:
+    std::mutex mutex_;
+    std::map<std::pair<uint64_t, size_t>, EndpointRacer::Slot> adapters_;
+    std::set<std::string> answering_;
+    std::vector<std::thread> threads_;
+};
+
+struct Finished {
+    bool won = false;
+    Clock::time_point at;
+};
+
+int run() {
+    // Every race logs its candidates; the figures would drown in them
+    Logger::instance().setSink([](const std::vector<Logger::Line>&) {});
+    EventLoop loop;
+    if (!loop.start()) {
+        std::printf("FAIL: the event loop did not start\n");
+        return 1;
+    }
+    int failures = 0;
+    {
+        SlowBackend backend;
+
+        // Missed periods are skipped, so a held-up loop shows as a long gap
+        std::atomic<int64_t> maxLatenessUs{0};
+        Clock::time_point lastTick = Clock::now();
+        auto tick = loop.addRepeatingTimer(milliseconds(5), [&]() {
+            auto now = Clock::now();
+            auto late = now - lastTick - milliseconds(5);
+            int64_t lateUs = std::chrono::duration_cast<std::chrono::microseconds>(late).count();
+            lastTick = now;
+            if (lateUs > maxLatenessUs) {
+                maxLatenessUs = lateUs;
+            }
+        });
+
+        EndpointRace::Options options;
+        options.timeout = kRaceTimeout;
+        std::mutex mutex;
+        std::vector<Finished> finished(kRaces);
+        std::atomic<int> done{0};
+        std::vector<std::shared_ptr<EndpointRacer>> racers;
+        auto began = Clock::now();
+        for (int i = 0; i < kRaces; i++) {
+            std::string octet = std::to_string(1 + i);
+            std::string candidate = "198.51.100." + octet + ":51820";
+            if (i % 2 == 0) {
+                backend.answer(candidate);
+            }
+            std::string config = "[Interface]\nPrivateKey = " + kPrivateKey + "\n\n[Peer]\nPublicKey = " +
+                                 kServerKey + "\nEndpoint = 192.0.2." + octet + ":51820\n";
+            racers.push_back(EndpointRacer::start(
+                loop, backend, nullptr, config, {{candidate, std::string()}}, options,
+                [&, i](const std::string&, const EndpointRace& race) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    finished[i].won = race.winner().has_value();
+                    finished[i].at = Clock::now();
+                    done++;
+                }));
+        }
+        auto deadline = began + kCreateDelay + kRaceTimeout + kSlack * 5;
+        while (done < kRaces && Clock::now() < deadline) {
+            std::this_thread::sleep_for(milliseconds(5));
+        }
+        loop.cancel(tick);
+
+        int64_t maxWonMs = 0;
+        int64_t minLostMs = INT64_MAX;
+        int64_t maxLostMs = 0;
+        int won = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (int i = 0; i < kRaces; i++) {
+                if (finished[i].at == Clock::time_point()) {
+                    std::printf("FAIL: race %d never finished\n", i);
+                    failures++;
+                    continue;
+                }
+                int64_t ms = std::chrono::duration_cast<milliseconds>(finished[i].at - began).count();
+                if (finished[i].won) {
+                    won++;
+                    maxWonMs = std::max(maxWonMs, ms);
+                } else {
+                    minLostMs = std::min(minLostMs, ms);
+                    maxLostMs = std::max(maxLostMs, ms);
+                }
+            }
+        }
+        std::printf("%d races, %d won\n", kRaces, won);
+        std::printf("won races finished by %lld ms (adapters take %lld ms)\n", static_cast<long long>(maxWonMs),
+                    static_cast<long long>(kCreateDelay.count()));
+        std::printf("timed out races finished after %lld..%lld ms (timeout %lld ms)\n",
+                    static_cast<long long>(minLostMs), static_cast<long long>(maxLostMs),
+                    static_cast<long long>(kRaceTimeout.count()));
+        std::printf("loop timer at most %lld us late (max %lld ms)\n", static_cast<long long>(maxLatenessUs.load()),
+                    static_cast<long long>(kMaxLoopLateness.count()));
+        std::printf("adapters left open: %zu\n", backend.open());
+
+        if (won != kRaces / 2) {
+            std::printf("FAIL: expected %d races to win\n", kRaces / 2);
+            failures++;
+        }
+        if (maxWonMs > (kCreateDelay + kSlack).count()) {
+            std::printf("FAIL: races waited on each other's adapters\n");
+            failures++;
+        }
+        if (won < kRaces && (minLostMs < (kCreateDelay + kRaceTimeout).count() ||
+                             maxLostMs > (kCreateDelay + kRaceTimeout + kSlack).count())) {
+            std::printf("FAIL: a race without an answer did not end at its timeout\n");
+            failures++;
+        }
+        if (maxLatenessUs.load() > std::chrono::duration_cast<std::chrono::microseconds>(kMaxLoopLateness).count()) {
+            std::printf("FAIL: the loop was held up\n");
+            failures++;
+        }
+        if (backend.open() != 0) {
+            std::printf("FAIL: adapters were left behind\n");
+            failures++;
+        }
+    }
+    loop.stop();
+    Logger::instance().flush();
+    Logger::instance().setSink(nullptr);
+    return failures == 0 ? 0 : 1;
+}
+
+} // namespace
+} // namespace wireguard_flutter
+
+int main() {
+    return wireguard_flutter::run();
+}
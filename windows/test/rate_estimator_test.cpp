@@ -0,0 +1,94 @@
+#include "rate_estimator.h"
+
+#include <gtest/gtest.h>
+
+namespace wireguard_flutter {
+namespace {
+
+using std::chrono::milliseconds;
+using std::chrono::seconds;
+
+RateEstimator::Clock::time_point Start() {
+    return RateEstimator::Clock::time_point{} + seconds(5);
+}
+
+TEST(RateEstimatorTest, FirstSampleOnlySetsBaseline) {
+    RateEstimator estimator;
+    EXPECT_FALSE(estimator.addSample(1000, Start()));
+    EXPECT_EQ(estimator.rates().instantBps, 0u);
+    EXPECT_TRUE(estimator.addSample(3000, Start() + seconds(1)));
+    EXPECT_EQ(estimator.rates().instantBps, 2000u);
+}
+
+TEST(RateEstimatorTest, PeakAndPercentilesCoverTheWindow) {
+    RateEstimator::Options options;
+    options.windowSamples = 20;
+    RateEstimator estimator(options);
+    auto now = Start();
+    uint64_t counter = 0;
+    estimator.addSample(counter, now);
+    for (uint64_t i = 1; i <= 20; i++) {
+        now += seconds(1);
+        counter += i * 1000;
+        ASSERT_TRUE(estimator.addSample(counter, now));
+    }
+    EXPECT_EQ(estimator.rates().instantBps, 20000u);
+    EXPECT_EQ(estimator.rates().peakBps, 20000u);
+    EXPECT_EQ(estimator.rates().p50Bps, 10000u);
+    EXPECT_EQ(estimator.rates().p95Bps, 19000u);
+
+    // Older rates slide out of the window
+    for (int i = 0; i < 20; i++) {
+        now += seconds(1);
+        counter += 500;
+        estimator.addSample(counter, now);
+    }
+    EXPECT_EQ(estimator.rates().peakBps, 500u);
+}
+
+TEST(RateEstimatorTest, SmoothedRateConvergesOnAConstantRate) {
+    RateEstimator::Options options;
+    options.ewmaTimeConstant = milliseconds(2000);
+    RateEstimator estimator(options);
+    auto now = Start();
+    uint64_t counter = 0;
+    estimator.addSample(counter, now);
+    now += seconds(1);
+    counter += 10000;
+    estimator.addSample(counter, now);
+    for (int i = 0; i < 30; i++) {
+        now += seconds(1);
+        counter += 1000;
+        estimator.addSample(counter, now);
+        EXPECT_GE(estimator.rates().smoothedBps, 1000u);
+    }
+    EXPECT_NEAR(static_cast<double>(estimator.rates().smoothedBps), 1000.0, 10.0);
+}
+
+TEST(RateEstimatorTest, NarrowCounterWraps) {
+    RateEstimator::Options options;
+    options.counterBits = 32;
+    RateEstimator estimator(options);
+    estimator.addSample(0xFFFFFF00ull, Start());
+    estimator.addSample(0x100, Start() + seconds(1));
+    EXPECT_EQ(estimator.rates().instantBps, 0x200u);
+}
+
+TEST(RateEstimatorTest, DecreaseOfAFullWidthCounterIsAReset) {
+    RateEstimator estimator;
+    estimator.addSample(5000, Start());
+    estimator.addSample(100, Start() + seconds(1));
+    EXPECT_EQ(estimator.rates().instantBps, 100u);
+}
+
+TEST(RateEstimatorTest, ResetForgetsTheBaseline) {
+    RateEstimator estimator;
+    estimator.addSample(0, Start());
+    estimator.addSample(4000, Start() + seconds(1));
+    estimator.reset();
+    EXPECT_EQ(estimator.rates().peakBps, 0u);
+    EXPECT_FALSE(estimator.addSample(10000, Start() + seconds(2)));
+}
+
+} // namespace
+} // namespace wireguard_flutter
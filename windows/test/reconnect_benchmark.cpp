@@ -0,0 +1,110 @@
+// Replays an outage on many tunnels at once through ReconnectPolicy, on a
+// simulated clock: every tunnel loses its link at the same instant and
+// retries until the peer comes back. Prints how the restarts spread out
+// and how long recovery took, and fails when jitter leaves the retries in
+// step or a tunnel does not recover within its backoff bound.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <vector>
+
+#include "reconnect_policy.h"
+
+namespace wireguard_flutter {
+namespace {
+
+using std::chrono::milliseconds;
+using Clock = ReconnectPolicy::Clock;
+
+constexpr int kTunnels = 1000;
+// The peer answers again this long after the outage began
+constexpr milliseconds kOutage{45000};
+// Restarts of all tunnels in any one 10 ms bucket; in step they would all
+// land in the same one
+constexpr int kMaxRestartsPerBucket = kTunnels / 10;
+
+int run() {
+    ReconnectPolicy::Options options;
+    std::vector<ReconnectPolicy> policies;
+    policies.reserve(kTunnels);
+    for (int i = 0; i < kTunnels; i++) {
+        policies.emplace_back(static_cast<uint64_t>(i) * 7919 + 1);
+        policies.back().configure(options);
+    }
+
+    auto start = Clock::time_point{} + std::chrono::hours(1);
+    for (auto& policy : policies) {
+        policy.onLost(ReconnectPolicy::Reason::LinkLost, start);
+    }
+
+    std::map<int64_t, int> restartsPerBucket;
+    std::vector<int64_t> recoveredAfterMs;
+    uint64_t restarts = 0;
+    auto began = std::chrono::steady_clock::now();
+    for (auto& policy : policies) {
+        for (;;) {
+            auto due = policy.nextDue();
+            if (due == Clock::time_point::max()) {
+                break;
+            }
+            auto step = policy.poll(due);
+            if (step.action != ReconnectPolicy::Action::Restart) {
+                continue;
+            }
+            restarts++;
+            auto sinceLoss = std::chrono::duration_cast<milliseconds>(due - start);
+            restartsPerBucket[sinceLoss.count() / 10]++;
+            if (sinceLoss >= kOutage) {
+                // The adapter comes up a second into the attempt
+                auto recovery = policy.onRecovered(due + milliseconds(1000));
+                recoveredAfterMs.push_back(recovery ? recovery->duration.count() : -1);
+                break;
+            }
+            // Service started, but no adapter before the timeout
+        }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - began;
+
+    int busiest = 0;
+    for (const auto& [bucket, count] : restartsPerBucket) {
+        busiest = std::max(busiest, count);
+    }
+    std::sort(recoveredAfterMs.begin(), recoveredAfterMs.end());
+    auto percentile = [&](size_t p) { return recoveredAfterMs[(recoveredAfterMs.size() - 1) * p / 100]; };
+    // The attempt that recovers starts at most one full backoff plus its
+    // timeout after the outage ends
+    int64_t bound = kOutage.count() + options.maxBackoff.count() + options.attemptTimeout.count() + 1000;
+
+    std::printf("tunnels: %d, restarts: %llu, busiest 10 ms: %d\n", kTunnels,
+                static_cast<unsigned long long>(restarts), busiest);
+    if (recoveredAfterMs.size() != static_cast<size_t>(kTunnels)) {
+        std::printf("FAIL: %zu of %d tunnels recovered\n", recoveredAfterMs.size(), kTunnels);
+        return 1;
+    }
+    std::printf("recovered after: p50 %lld ms, p99 %lld ms, max %lld ms\n", static_cast<long long>(percentile(50)),
+                static_cast<long long>(percentile(99)), static_cast<long long>(recoveredAfterMs.back()));
+    std::printf("policy time per restart: %.0f ns\n",
+                static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) /
+                    static_cast<double>(restarts));
+
+    if (busiest > kMaxRestartsPerBucket) {
+        std::printf("FAIL: %d restarts in one 10 ms bucket\n", busiest);
+        return 1;
+    }
+    if (recoveredAfterMs.front() < kOutage.count() || recoveredAfterMs.back() > bound) {
+        std::printf("FAIL: recovery outside [%lld, %lld] ms\n", static_cast<long long>(kOutage.count()),
+                    static_cast<long long>(bound));
+        return 1;
+    }
+    return 0;
+}
+
+} // namespace
+} // namespace wireguard_flutter
+
+int main() {
+    return wireguard_flutter::run();
+}
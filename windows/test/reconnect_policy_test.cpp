@@ -0,0 +1,183 @@
+#include "reconnect_policy.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace wireguard_flutter {
+namespace {
+
+using std::chrono::milliseconds;
+using std::chrono::seconds;
+using Clock = ReconnectPolicy::Clock;
+
+Clock::time_point Start() {
+    return Clock::time_point{} + seconds(100);
+}
+
+ReconnectPolicy::Options NoJitter() {
+    ReconnectPolicy::Options options;
+    options.jitter = 0.0;
+    options.initialBackoff = milliseconds(1000);
+    options.maxBackoff = milliseconds(8000);
+    options.attemptTimeout = milliseconds(5000);
+    return options;
+}
+
+TEST(ReconnectPolicyTest, IdleHasNothingDue) {
+    ReconnectPolicy policy;
+    EXPECT_EQ(policy.nextDue(), Clock::time_point::max());
+    EXPECT_EQ(policy.poll(Start()).action, ReconnectPolicy::Action::None);
+    EXPECT_FALSE(policy.onRecovered(Start()));
+}
+
+TEST(ReconnectPolicyTest, BackoffDoublesUpToTheCap) {
+    ReconnectPolicy policy;
+    policy.configure(NoJitter());
+    std::vector<int64_t> delays;
+    for (uint32_t attempt = 0; attempt < 6; attempt++) {
+        delays.push_back(policy.backoff(attempt).count());
+    }
+    EXPECT_EQ(delays, (std::vector<int64_t>{1000, 2000, 4000, 8000, 8000, 8000}));
+    // Far past where pow would overflow
+    EXPECT_EQ(policy.backoff(5000).count(), 8000);
+}
+
+TEST(ReconnectPolicyTest, JitterStaysInTheUpperPart) {
+    auto options = NoJitter();
+    options.jitter = 0.5;
+    ReconnectPolicy a(1);
+    ReconnectPolicy b(2);
+    a.configure(options);
+    b.configure(options);
+    bool differ = false;
+    for (int i = 0; i < 1000; i++) {
+        auto delay = a.backoff(2).count();
+        EXPECT_GE(delay, 2000);
+        EXPECT_LE(delay, 4000);
+        differ |= delay != b.backoff(2).count();
+    }
+    EXPECT_TRUE(differ);
+}
+
+TEST(ReconnectPolicyTest, OptionsAreClamped) {
+    ReconnectPolicy::Options options;
+    options.multiplier = 0.5;
+    options.jitter = 3.0;
+    options.initialBackoff = milliseconds(500);
+    options.maxBackoff = milliseconds(100);
+    ReconnectPolicy policy;
+    policy.configure(options);
+    EXPECT_EQ(policy.options().multiplier, 1.0);
+    EXPECT_EQ(policy.options().jitter, 1.0);
+    EXPECT_EQ(policy.options().maxBackoff, milliseconds(500));
+}
+
+TEST(ReconnectPolicyTest, LossRestartsAfterBackoff) {
+    ReconnectPolicy policy;
+    policy.configure(NoJitter());
+    auto now = Start();
+    policy.onLost(ReconnectPolicy::Reason::LinkLost, now);
+    EXPECT_TRUE(policy.recovering());
+    EXPECT_EQ(policy.nextDue(), now + milliseconds(1000));
+    EXPECT_EQ(policy.poll(now + milliseconds(999)).action, ReconnectPolicy::Action::None);
+    EXPECT_EQ(policy.poll(now + milliseconds(1000)).action, ReconnectPolicy::Action::Restart);
+    // The attempt times out and the next one backs off twice as long
+    EXPECT_EQ(policy.nextDue(), now + milliseconds(6000));
+    EXPECT_EQ(policy.poll(now + milliseconds(6000)).action, ReconnectPolicy::Action::None);
+    EXPECT_EQ(policy.nextDue(), now + milliseconds(8000));
+
+    auto recovery = policy.onRecovered(now + milliseconds(8500));
+    ASSERT_TRUE(recovery);
+    EXPECT_TRUE(recovery->recovered);
+    EXPECT_EQ(recovery->attempts, 1u);
+    EXPECT_EQ(recovery->duration, milliseconds(8500));
+    EXPECT_EQ(recovery->reason, ReconnectPolicy::Reason::LinkLost);
+    EXPECT_FALSE(policy.recovering());
+}
+
+TEST(ReconnectPolicyTest, GivesUpAfterMaxAttempts) {
+    auto options = NoJitter();
+    options.maxAttempts = 2;
+    ReconnectPolicy policy;
+    policy.configure(options);
+    auto now = Start();
+    policy.onLost(ReconnectPolicy::Reason::ServiceExited, now);
+    ASSERT_EQ(policy.poll(policy.nextDue()).action, ReconnectPolicy::Action::Restart);
+    EXPECT_EQ(policy.onAttemptFailed(now + seconds(2)).action, ReconnectPolicy::Action::None);
+    ASSERT_EQ(policy.poll(policy.nextDue()).action, ReconnectPolicy::Action::Restart);
+    auto step = policy.onAttemptFailed(now + seconds(10));
+    EXPECT_EQ(step.action, ReconnectPolicy::Action::GiveUp);
+    EXPECT_EQ(step.outcome.attempts, 2u);
+    EXPECT_FALSE(step.outcome.recovered);
+    EXPECT_EQ(step.outcome.reason, ReconnectPolicy::Reason::ServiceExited);
+    EXPECT_EQ(policy.nextDue(), Clock::time_point::max());
+}
+
+TEST(ReconnectPolicyTest, FailureOutsideAnAttemptIsIgnored) {
+    ReconnectPolicy policy;
+    policy.configure(NoJitter());
+    policy.onLost(ReconnectPolicy::Reason::LinkLost, Start());
+    auto due = policy.nextDue();
+    EXPECT_EQ(policy.onAttemptFailed(Start()).action, ReconnectPolicy::Action::None);
+    EXPECT_EQ(policy.nextDue(), due);
+}
+
+TEST(ReconnectPolicyTest, NetworkChangeBringsTheAttemptForward) {
+    auto options = NoJitter();
+    options.initialBackoff = milliseconds(30000);
+    options.maxBackoff = milliseconds(30000);
+    ReconnectPolicy policy;
+    policy.configure(options);
+    auto now = Start();
+    policy.onLost(ReconnectPolicy::Reason::LinkLost, now);
+    policy.onNetworkChange(now + seconds(1), false);
+    EXPECT_EQ(policy.nextDue(), now + seconds(1) + options.networkSettle);
+}
+
+TEST(ReconnectPolicyTest, NetworkChangesWhileConnectedSettleIntoOneRoam) {
+    auto options = NoJitter();
+    ReconnectPolicy policy;
+    policy.configure(options);
+    auto now = Start();
+    policy.onNetworkChange(now, true);
+    EXPECT_EQ(policy.nextDue(), now + milliseconds(500));
+    // Each change pushes the roam out, but never past four settle times
+    for (int i = 1; i <= 10; i++) {
+        policy.onNetworkChange(now + milliseconds(400 * i), true);
+    }
+    EXPECT_EQ(policy.nextDue(), now + milliseconds(2000));
+    EXPECT_EQ(policy.poll(now + milliseconds(2000)).action, ReconnectPolicy::Action::Roam);
+    EXPECT_TRUE(policy.roaming());
+    EXPECT_EQ(policy.roamStart(), now);
+
+    auto recovery = policy.onRecovered(now + milliseconds(2300));
+    ASSERT_TRUE(recovery);
+    EXPECT_EQ(recovery->reason, ReconnectPolicy::Reason::NetworkChange);
+    EXPECT_EQ(recovery->duration, milliseconds(2300));
+}
+
+TEST(ReconnectPolicyTest, RoamWithoutHandshakeIsDropped) {
+    ReconnectPolicy policy;
+    policy.configure(NoJitter());
+    auto now = Start();
+    policy.onNetworkChange(now, true);
+    ASSERT_EQ(policy.poll(policy.nextDue()).action, ReconnectPolicy::Action::Roam);
+    EXPECT_EQ(policy.poll(policy.nextDue()).action, ReconnectPolicy::Action::None);
+    EXPECT_FALSE(policy.roaming());
+    EXPECT_EQ(policy.nextDue(), Clock::time_point::max());
+}
+
+TEST(ReconnectPolicyTest, DisabledDoesNothing) {
+    auto options = NoJitter();
+    options.enabled = false;
+    ReconnectPolicy policy;
+    policy.configure(options);
+    policy.onLost(ReconnectPolicy::Reason::LinkLost, Start());
+    policy.onNetworkChange(Start(), true);
+    EXPECT_FALSE(policy.recovering());
+    EXPECT_EQ(policy.nextDue(), Clock::time_point::max());
+}
+
+} // namespace
+} // namespace wireguard_flutter
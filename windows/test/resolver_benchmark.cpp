@@ -0,0 +1,206 @@
+// Starts many tunnels at once the way WireGuardTunnelManager does: each
+// waits on the event loop for ResolverCache::whenResolved, or for its
+// resolve timeout when a name never answers. Prints how long the calls
+// took, when the starts went on and how late the loop ran a steady timer
+// meanwhile; fails when anything waits on DNS in the caller or the loop.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "event_loop.h"
+#include "resolver_cache.h"
+
+namespace wireguard_flutter {
+namespace {
+
+using std::chrono::milliseconds;
+using Clock = std::chrono::steady_clock;
+
+constexpr int kStarts = 200;
+// Every fourth start has a name that never answers
+constexpr int kBlackholeEvery = 4;
+constexpr milliseconds kAnswerDelay{20};
+constexpr milliseconds kResolveTimeout{300};
+// Generous ceilings; a blocking wait would take kResolveTimeout
+constexpr milliseconds kMaxCall{50};
+constexpr milliseconds kMaxLoopLateness{150};
+constexpr milliseconds kSlack{150};
+
+// Answers after kAnswerDelay from its own thread, except for names
+// starting with "blackhole", which are only answered by flush
+class SlowResolver {
+public:
+    ~SlowResolver() {
+        if (worker_.joinable()) {
+            worker_.join();
+        }
+    }
+
+    ResolverCache::Resolver resolver() {
+        return [this](const std::string& host, std::function<void(ResolverCache::Answer)> done) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            (host.rfind("blackhole", 0) == 0 ? held_ : due_).push_back(std::move(done));
+        };
+    }
+
+    void answerLater() {
+        worker_ = std::thread([this]() {
+            std::this_thread::sleep_for(kAnswerDelay);
+            answer(due_);
+        });
+    }
+
+    void flush() {
+        answer(held_);
+    }
+
+private:
+    void answer(std::vector<std::function<void(ResolverCache::Answer)>>& queue) {
+        std::vector<std::function<void(ResolverCache::Answer)>> done;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done.swap(queue);
+        }
+        ResolverCache::Answer answer;
+        answer.ok = true;
+        answer.addresses = {"192.0.2.1"};
+        answer.ttl = std::chrono::seconds(300);
+        for (auto& callback : done) {
+            callback(answer);
+        }
+    }
+
+    std::mutex mutex_;
+    std::vector<std::function<void(ResolverCache::Answer)>> due_;
+    std::vector<std::function<void(ResolverCache::Answer)>> held_;
+    std::thread worker_;
+};
+
+struct Start {
+    std::mutex mutex;
+    bool finished = false;
+    EventLoop::TaskId timeout = 0;
+    Clock::time_point finishedAt;
+};
+
+int run() {
+    EventLoop loop;
+    if (!loop.start()) {
+        std::printf("FAIL: the event loop did not start\n");
+        return 1;
+    }
+    SlowResolver slow;
+    ResolverCache cache(slow.resolver());
+
+    // Missed periods are skipped, so a held-up loop shows as a long gap
+    std::atomic<int64_t> maxLatenessUs{0};
+    Clock::time_point lastTick = Clock::now();
+    auto tick = loop.addRepeatingTimer(milliseconds(5), [&]() {
+        auto now = Clock::now();
+        auto late = now - lastTick - milliseconds(5);
+        int64_t lateUs = std::chrono::duration_cast<std::chrono::microseconds>(late).count();
+        lastTick = now;
+        if (lateUs > maxLatenessUs) {
+            maxLatenessUs = lateUs;
+        }
+    });
+
+    std::vector<std::shared_ptr<Start>> starts;
+    int64_t maxCallUs = 0;
+    auto began = Clock::now();
+    for (int i = 0; i < kStarts; i++) {
+        auto start = std::make_shared<Start>();
+        starts.push_back(start);
+        auto finish = [start]() {
+            std::lock_guard<std::mutex> lock(start->mutex);
+            if (!start->finished) {
+                start->finished = true;
+                start->finishedAt = Clock::now();
+            }
+        };
+        std::vector<std::string> hosts = {"vpn" + std::to_string(i % 50) + ".example", "shared.example"};
+        if (i % kBlackholeEvery == 0) {
+            hosts.push_back("blackhole" + std::to_string(i) + ".example");
+        }
+        auto callStart = Clock::now();
+        start->timeout = loop.addTimer(kResolveTimeout, finish);
+        cache.whenResolved(hosts, ResolverCache::Clock::now(), [&loop, finish]() { loop.post(finish); });
+        maxCallUs = std::max<int64_t>(
+            maxCallUs, std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - callStart).count());
+    }
+    slow.answerLater();
+    std::this_thread::sleep_for(kResolveTimeout + kSlack);
+    loop.cancel(tick);
+
+    int failures = 0;
+    int64_t maxAnsweredMs = 0;
+    int64_t minTimedOutMs = INT64_MAX;
+    int64_t maxTimedOutMs = 0;
+    for (int i = 0; i < kStarts; i++) {
+        std::lock_guard<std::mutex> lock(starts[i]->mutex);
+        if (!starts[i]->finished) {
+            std::printf("FAIL: start %d never went on\n", i);
+            failures++;
+            continue;
+        }
+        int64_t ms = std::chrono::duration_cast<milliseconds>(starts[i]->finishedAt - began).count();
+        if (i % kBlackholeEvery == 0) {
+            minTimedOutMs = std::min(minTimedOutMs, ms);
+            maxTimedOutMs = std::max(maxTimedOutMs, ms);
+        } else {
+            maxAnsweredMs = std::max(maxAnsweredMs, ms);
+        }
+    }
+    for (auto& start : starts) {
+        loop.cancel(start->timeout);
+    }
+    slow.flush();
+    loop.stop();
+
+    auto stats = cache.stats();
+    std::printf("%d starts, %llu queries\n", kStarts, static_cast<unsigned long long>(stats.queries));
+    std::printf("slowest whenResolved call: %lld us (max %lld ms)\n", static_cast<long long>(maxCallUs),
+                static_cast<long long>(kMaxCall.count()));
+    std::printf("answered starts went on by %lld ms (answers after %lld ms)\n", static_cast<long long>(maxAnsweredMs),
+                static_cast<long long>(kAnswerDelay.count()));
+    std::printf("timed out starts went on after %lld..%lld ms (timeout %lld ms)\n",
+                static_cast<long long>(minTimedOutMs), static_cast<long long>(maxTimedOutMs),
+                static_cast<long long>(kResolveTimeout.count()));
+    std::printf("loop timer at most %lld us late (max %lld ms)\n", static_cast<long long>(maxLatenessUs.load()),
+                static_cast<long long>(kMaxLoopLateness.count()));
+
+    if (maxCallUs > std::chrono::duration_cast<std::chrono::microseconds>(kMaxCall).count()) {
+        std::printf("FAIL: whenResolved waited in the caller\n");
+        failures++;
+    }
+    if (maxAnsweredMs > (kAnswerDelay + kSlack).count()) {
+        std::printf("FAIL: answered starts waited for the timeout\n");
+        failures++;
+    }
+    if (minTimedOutMs < kResolveTimeout.count() || maxTimedOutMs > (kResolveTimeout + kSlack).count()) {
+        std::printf("FAIL: a start without an answer did not go on at its timeout\n");
+        failures++;
+    }
+    if (maxLatenessUs.load() > std::chrono::duration_cast<std::chrono::microseconds>(kMaxLoopLateness).count()) {
+        std::printf("FAIL: the loop was held up\n");
+        failures++;
+    }
+    return failures == 0 ? 0 : 1;
+}
+
+} // namespace
+} // namespace wireguard_flutter
+
+int main() {
+    return wireguard_flutter::run();
+}
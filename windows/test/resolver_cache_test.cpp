@@ -0,0 +1,224 @@
+#include "resolver_cache.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace wireguard_flutter {
+namespace {
+
+using std::chrono::seconds;
+using Clock = ResolverCache::Clock;
+
+Clock::time_point Start() {
+    return Clock::time_point{} + seconds(1000);
+}
+
+// Keeps queries pending until the test answers them
+class FakeResolver {
+public:
+    ResolverCache::Resolver resolver() {
+        return [this](const std::string& host, std::function<void(ResolverCache::Answer)> done) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queries_[host]++;
+            pending_[host].push_back(std::move(done));
+        };
+    }
+
+    int queries(const std::string& host) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return queries_[host];
+    }
+
+    void answer(const std::string& host, std::vector<std::string> addresses, seconds ttl = seconds(300)) {
+        std::vector<std::function<void(ResolverCache::Answer)>> done;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done.swap(pending_[host]);
+        }
+        ResolverCache::Answer answer;
+        answer.ok = !addresses.empty();
+        answer.addresses = std::move(addresses);
+        answer.ttl = ttl;
+        for (auto& callback : done) {
+            callback(answer);
+        }
+    }
+
+private:
+    std::mutex mutex_;
+    std::map<std::string, int> queries_;
+    std::map<std::string, std::vector<std::function<void(ResolverCache::Answer)>>> pending_;
+};
+
+TEST(ResolverCacheTest, LookupQueriesOnceAndServesTheAnswer) {
+    FakeResolver fake;
+    ResolverCache cache(fake.resolver());
+    auto now = Start();
+    EXPECT_TRUE(cache.lookup("vpn.example", now).empty());
+    EXPECT_TRUE(cache.lookup("vpn.example", now).empty());
+    EXPECT_EQ(fake.queries("vpn.example"), 1);
+    fake.answer("vpn.example", {"192.0.2.1"});
+    EXPECT_EQ(cache.lookup("vpn.example", now), std::vector<std::string>{"192.0.2.1"});
+    auto stats = cache.stats();
+    EXPECT_EQ(stats.fresh, 1u);
+    EXPECT_EQ(stats.misses, 2u);
+    EXPECT_EQ(stats.queries, 1u);
+}
+
+TEST(ResolverCacheTest, StaleAnswerIsServedWhileRefreshing) {
+    FakeResolver fake;
+    ResolverCache cache(fake.resolver());
+    auto now = Start();
+    cache.prefetch({"vpn.example"}, now);
+    fake.answer("vpn.example", {"192.0.2.1"}, seconds(60));
+
+    auto later = now + seconds(61);
+    EXPECT_EQ(cache.lookup("vpn.example", later), std::vector<std::string>{"192.0.2.1"});
+    EXPECT_EQ(fake.queries("vpn.example"), 2);
+    fake.answer("vpn.example", {"192.0.2.2"});
+    EXPECT_EQ(cache.lookup("vpn.example", later), std::vector<std::string>{"192.0.2.2"});
+    EXPECT_EQ(cache.stats().stale, 1u);
+}
+
+TEST(ResolverCacheTest, TtlIsClamped) {
+    FakeResolver fake;
+    ResolverCache::Options options;
+    options.minTtl = seconds(30);
+    ResolverCache cache(fake.resolver(), options);
+    auto now = Start();
+    cache.prefetch({"vpn.example"}, now);
+    fake.answer("vpn.example", {"192.0.2.1"}, seconds(1));
+    cache.lookup("vpn.example", now + seconds(29));
+    EXPECT_EQ(fake.queries("vpn.example"), 1);
+    cache.lookup("vpn.example", now + seconds(30));
+    EXPECT_EQ(fake.queries("vpn.example"), 2);
+}
+
+TEST(ResolverCacheTest, FailureIsRememberedForNegativeTtl) {
+    FakeResolver fake;
+    ResolverCache::Options options;
+    options.negativeTtl = seconds(10);
+    ResolverCache cache(fake.resolver(), options);
+    auto now = Start();
+    cache.lookup("dead.example", now);
+    fake.answer("dead.example", {});
+    EXPECT_TRUE(cache.lookup("dead.example", now + seconds(5)).empty());
+    EXPECT_EQ(fake.queries("dead.example"), 1);
+    cache.lookup("dead.example", now + seconds(10));
+    EXPECT_EQ(fake.queries("dead.example"), 2);
+}
+
+TEST(ResolverCacheTest, FailedRefreshKeepsTheStaleAnswer) {
+    FakeResolver fake;
+    ResolverCache cache(fake.resolver());
+    auto now = Start();
+    cache.prefetch({"vpn.example"}, now);
+    fake.answer("vpn.example", {"192.0.2.1"}, seconds(60));
+    cache.expireAll();
+    EXPECT_EQ(cache.lookup("vpn.example", now), std::vector<std::string>{"192.0.2.1"});
+    fake.answer("vpn.example", {});
+    EXPECT_EQ(cache.lookup("vpn.example", now), std::vector<std::string>{"192.0.2.1"});
+}
+
+TEST(ResolverCacheTest, ResolveGivesUpAtTheDeadline) {
+    FakeResolver fake;
+    ResolverCache cache(fake.resolver());
+    auto now = Clock::now();
+    auto began = Clock::now();
+    EXPECT_TRUE(cache.resolve("slow.example", now, now + std::chrono::milliseconds(50)).empty());
+    EXPECT_GE(Clock::now() - began, std::chrono::milliseconds(50));
+
+    std::thread answer([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        fake.answer("slow.example", {"192.0.2.9"});
+    });
+    // Joins the query still in flight rather than starting another
+    auto addresses = cache.resolve("slow.example", now, now + seconds(10));
+    answer.join();
+    EXPECT_EQ(addresses, std::vector<std::string>{"192.0.2.9"});
+    EXPECT_EQ(fake.queries("slow.example"), 1);
+}
+
+TEST(ResolverCacheTest, WhenResolvedIsReadyAtOnceWithNothingToWaitFor) {
+    FakeResolver fake;
+    ResolverCache cache(fake.resolver());
+    auto now = Start();
+    cache.prefetch({"vpn.example"}, now);
+    fake.answer("vpn.example", {"192.0.2.1"});
+    int ready = 0;
+    cache.whenResolved({"vpn.example", ""}, now, [&]() { ready++; });
+    EXPECT_EQ(ready, 1);
+    cache.whenResolved({}, now, [&]() { ready++; });
+    EXPECT_EQ(ready, 2);
+}
+
+TEST(ResolverCacheTest, WhenResolvedWaitsForTheLastName) {
+    FakeResolver fake;
+    ResolverCache cache(fake.resolver());
+    auto now = Start();
+    // One name is already in flight; the other is queried by the call
+    cache.prefetch({"a.example"}, now);
+    int ready = 0;
+    cache.whenResolved({"a.example", "b.example", "a.example"}, now, [&]() { ready++; });
+    EXPECT_EQ(fake.queries("a.example"), 1);
+    EXPECT_EQ(fake.queries("b.example"), 1);
+    fake.answer("b.example", {"192.0.2.2"});
+    EXPECT_EQ(ready, 0);
+    // A failure counts as an answer too
+    fake.answer("a.example", {});
+    EXPECT_EQ(ready, 1);
+    EXPECT_EQ(cache.lookup("b.example", now), std::vector<std::string>{"192.0.2.2"});
+}
+
+TEST(ResolverCacheTest, WhenResolvedSkipsNegativelyCachedNames) {
+    FakeResolver fake;
+    ResolverCache cache(fake.resolver());
+    auto now = Start();
+    cache.lookup("dead.example", now);
+    fake.answer("dead.example", {});
+    int ready = 0;
+    cache.whenResolved({"dead.example"}, now + seconds(1), [&]() { ready++; });
+    EXPECT_EQ(ready, 1);
+    EXPECT_EQ(fake.queries("dead.example"), 1);
+}
+
+TEST(ResolverCacheTest, WhenResolvedAnswersFromTheResolversThread) {
+    FakeResolver fake;
+    ResolverCache cache(fake.resolver());
+    std::atomic<int> ready{0};
+    std::thread::id readyOn;
+    cache.whenResolved({"vpn.example"}, Start(), [&]() {
+        readyOn = std::this_thread::get_id();
+        ready++;
+    });
+    std::thread::id answeredOn;
+    std::thread answer([&]() {
+        answeredOn = std::this_thread::get_id();
+        fake.answer("vpn.example", {"192.0.2.1"});
+    });
+    answer.join();
+    EXPECT_EQ(ready.load(), 1);
+    EXPECT_EQ(readyOn, answeredOn);
+}
+
+TEST(ResolverCacheTest, AnswersAfterTheCacheIsGoneAreHarmless) {
+    FakeResolver fake;
+    int ready = 0;
+    {
+        ResolverCache cache(fake.resolver());
+        cache.whenResolved({"vpn.example"}, Start(), [&]() { ready++; });
+    }
+    fake.answer("vpn.example", {"192.0.2.1"});
+    EXPECT_EQ(ready, 1);
+}
+
+} // namespace
+} // namespace wireguard_flutter
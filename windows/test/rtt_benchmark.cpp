@@ -0,0 +1,113 @@
+// Times the round-trip math of the latency probe: registering a probe,
+// settling its echo or its loss, and the summary with percentiles, jitter
+// and loss the statistics read. Runs the trackers of 100 tunnels with a
+// full window, every tenth probe lost. Fails when the summary disagrees
+// with the loss fed in or an operation gets slower than the budget.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "rtt_tracker.h"
+
+namespace wireguard_flutter {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+
+constexpr int kTunnels = 100;
+constexpr int kProbesPerTunnel = 10000;
+constexpr int kLossEvery = 10;
+// Ceilings that catch work growing with every probe seen, e.g. a summary
+// over all of them, with room for a loaded machine; a probe typically
+// takes a few hundred ns and a summary of the window some 10 us
+constexpr double kBudgetNsPerProbe = 10000.0;
+constexpr double kBudgetNsPerSummary = 200000.0;
+
+int64_t nanoseconds(Clock::duration duration) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+}
+
+int run() {
+    // Losses expire by the next probe, so every window holds the same share
+    RttTracker::Options options;
+    options.timeout = milliseconds(400);
+    std::vector<RttTracker> trackers(kTunnels, RttTracker(options));
+    RttTracker::Clock::time_point now;
+    uint32_t value = 12345;
+
+    auto started = Clock::now();
+    for (int i = 0; i < kProbesPerTunnel; i++) {
+        auto sequence = static_cast<uint32_t>(i);
+        for (auto& tracker : trackers) {
+            tracker.onSent(sequence, now);
+            value = value * 1103515245 + 12345;
+            if (i % kLossEvery != kLossEvery - 1) {
+                tracker.onEcho(sequence, now + microseconds(5000 + value % 20000));
+            }
+        }
+        now += milliseconds(500);
+        for (auto& tracker : trackers) {
+            tracker.expire(now);
+        }
+    }
+    auto probing = Clock::now() - started;
+
+    constexpr int kRounds = 100;
+    uint64_t checksum = 0;
+    RttTracker::Summary summary;
+    started = Clock::now();
+    for (int round = 0; round < kRounds; round++) {
+        for (const auto& tracker : trackers) {
+            summary = tracker.summary();
+            checksum += static_cast<uint64_t>(summary.p99Us);
+        }
+    }
+    auto summarizing = Clock::now() - started;
+
+    double perProbe = static_cast<double>(nanoseconds(probing)) / (static_cast<double>(kTunnels) * kProbesPerTunnel);
+    double perSummary = static_cast<double>(nanoseconds(summarizing)) / (static_cast<double>(kTunnels) * kRounds);
+    std::printf("tunnels: %d, probes each: %d, window: %u\n", kTunnels, kProbesPerTunnel,
+                trackers[0].options().window);
+    std::printf("time per probe (send, echo or loss, expire): %.1f ns\n", perProbe);
+    std::printf("time per summary: %.1f ns (checksum %llu)\n", perSummary, static_cast<unsigned long long>(checksum));
+    std::printf("summary: %u samples, %u lost, %llu ppm, p50 %lld us, p99 %lld us, jitter %lld us\n", summary.samples,
+                summary.lost, static_cast<unsigned long long>(summary.lossPpm), static_cast<long long>(summary.p50Us),
+                static_cast<long long>(summary.p99Us), static_cast<long long>(summary.jitterUs));
+
+    int failures = 0;
+    uint32_t window = trackers[0].options().window;
+    if (summary.samples + summary.lost != window || summary.lost != window / kLossEvery ||
+        summary.lossPpm != 1000000u / kLossEvery) {
+        std::printf("FAIL: expected %u lost of %u\n", window / kLossEvery, window);
+        failures++;
+    }
+    if (summary.minUs < 5000 || summary.p99Us >= 25000 || summary.p50Us > summary.p90Us ||
+        summary.p90Us > summary.p99Us) {
+        std::printf("FAIL: percentiles outside the round trips fed in\n");
+        failures++;
+    }
+    if (trackers[0].inFlight() != 0) {
+        std::printf("FAIL: %zu probes still in flight\n", trackers[0].inFlight());
+        failures++;
+    }
+    if (perProbe > kBudgetNsPerProbe) {
+        std::printf("FAIL: a probe took longer than %.0f ns\n", kBudgetNsPerProbe);
+        failures++;
+    }
+    if (perSummary > kBudgetNsPerSummary) {
+        std::printf("FAIL: a summary took longer than %.0f ns\n", kBudgetNsPerSummary);
+        failures++;
+    }
+    return failures == 0 ? 0 : 1;
+}
+
+} // namespace
+} // namespace wireguard_flutter
+
+int main() {
+    return wireguard_flutter::run();
+}
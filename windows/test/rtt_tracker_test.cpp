@@ -0,0 +1,178 @@
+#include "rtt_tracker.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+
+namespace wireguard_flutter {
+namespace {
+
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+
+class RttTrackerTest : public ::testing::Test {
+protected:
+    // Sends the next probe and echoes it after |rtt|
+    void echoed(microseconds rtt) {
+        tracker_.onSent(sequence_, now_);
+        EXPECT_TRUE(tracker_.onEcho(sequence_++, now_ + rtt));
+        now_ += milliseconds(100);
+    }
+
+    // Sends the next probe and lets it time out
+    void lost() {
+        tracker_.onSent(sequence_++, now_);
+        now_ += tracker_.options().timeout;
+        tracker_.expire(now_);
+    }
+
+    RttTracker tracker_;
+    RttTracker::Clock::time_point now_;
+    uint32_t sequence_ = 0;
+};
+
+TEST_F(RttTrackerTest, EmptyWithoutProbes) {
+    auto summary = tracker_.summary();
+    EXPECT_EQ(summary.samples, 0u);
+    EXPECT_EQ(summary.lost, 0u);
+    EXPECT_EQ(summary.p50Us, 0);
+    EXPECT_EQ(summary.lossPpm, 0u);
+    EXPECT_FALSE(tracker_.answered());
+}
+
+TEST_F(RttTrackerTest, EchoSettlesItsProbe) {
+    tracker_.onSent(7, now_);
+    EXPECT_EQ(tracker_.inFlight(), 1u);
+    EXPECT_TRUE(tracker_.onEcho(7, now_ + microseconds(1500)));
+    EXPECT_EQ(tracker_.inFlight(), 0u);
+    EXPECT_TRUE(tracker_.answered());
+    auto summary = tracker_.summary();
+    EXPECT_EQ(summary.samples, 1u);
+    EXPECT_EQ(summary.minUs, 1500);
+    EXPECT_EQ(summary.p50Us, 1500);
+    EXPECT_EQ(summary.p99Us, 1500);
+    EXPECT_EQ(summary.jitterUs, 0);
+}
+
+TEST_F(RttTrackerTest, IgnoresUnknownDuplicateAndEarlyEchoes) {
+    tracker_.onSent(1, now_);
+    EXPECT_FALSE(tracker_.onEcho(2, now_));
+    EXPECT_FALSE(tracker_.onEcho(1, now_ - milliseconds(1)));
+    EXPECT_TRUE(tracker_.onEcho(1, now_ + milliseconds(1)));
+    EXPECT_FALSE(tracker_.onEcho(1, now_ + milliseconds(2)));
+    EXPECT_EQ(tracker_.summary().samples, 1u);
+}
+
+TEST_F(RttTrackerTest, PercentilesAreNearestRank) {
+    RttTracker::Options options;
+    options.window = 100;
+    tracker_.configure(options);
+    // Out of order, so the summary has to sort
+    for (int i = 0; i < 100; i++) {
+        echoed(milliseconds(1 + (i * 37) % 100));
+    }
+    auto summary = tracker_.summary();
+    EXPECT_EQ(summary.samples, 100u);
+    EXPECT_EQ(summary.minUs, 1000);
+    EXPECT_EQ(summary.p50Us, 50000);
+    EXPECT_EQ(summary.p90Us, 90000);
+    EXPECT_EQ(summary.p99Us, 99000);
+}
+
+// RFC 3550: J += (|D| - J) / 16
+TEST_F(RttTrackerTest, JitterIsTheSmoothedDeviation) {
+    echoed(milliseconds(10));
+    echoed(milliseconds(20));
+    EXPECT_EQ(tracker_.summary().jitterUs, 625);
+    for (int i = 0; i < 200; i++) {
+        echoed(milliseconds(i % 2 == 0 ? 10 : 20));
+    }
+    EXPECT_NEAR(static_cast<double>(tracker_.summary().jitterUs), 10000.0, 1.0);
+}
+
+TEST_F(RttTrackerTest, SteadyRoundTripsHaveNoJitter) {
+    for (int i = 0; i < 20; i++) {
+        echoed(milliseconds(30));
+    }
+    EXPECT_EQ(tracker_.summary().jitterUs, 0);
+}
+
+// A target without an echo responder reads as no samples, not as loss
+TEST_F(RttTrackerTest, LossesOnlyCountOnceAnswered) {
+    for (int i = 0; i < 5; i++) {
+        lost();
+    }
+    EXPECT_EQ(tracker_.inFlight(), 0u);
+    EXPECT_EQ(tracker_.summary().lost, 0u);
+
+    echoed(milliseconds(10));
+    lost();
+    auto summary = tracker_.summary();
+    EXPECT_EQ(summary.samples, 1u);
+    EXPECT_EQ(summary.lost, 1u);
+    EXPECT_EQ(summary.lossPpm, 500000u);
+}
+
+TEST_F(RttTrackerTest, ExpiresOnlyProbesPastTheTimeout) {
+    echoed(milliseconds(10));
+    tracker_.onSent(sequence_++, now_);
+    tracker_.onSent(sequence_++, now_ + milliseconds(1500));
+    tracker_.expire(now_ + milliseconds(2500));
+    EXPECT_EQ(tracker_.inFlight(), 1u);
+    EXPECT_EQ(tracker_.summary().lost, 1u);
+}
+
+TEST_F(RttTrackerTest, EchoAfterTheTimeoutIsIgnored) {
+    echoed(milliseconds(10));
+    tracker_.onSent(sequence_, now_);
+    tracker_.expire(now_ + milliseconds(2000));
+    EXPECT_FALSE(tracker_.onEcho(sequence_, now_ + milliseconds(2100)));
+    EXPECT_EQ(tracker_.summary().samples, 1u);
+    EXPECT_EQ(tracker_.summary().lost, 1u);
+}
+
+TEST_F(RttTrackerTest, WindowKeepsTheLatestProbes) {
+    RttTracker::Options options;
+    options.window = 4;
+    tracker_.configure(options);
+    echoed(milliseconds(1));
+    lost();
+    for (int i = 0; i < 4; i++) {
+        echoed(milliseconds(50 + i));
+    }
+    auto summary = tracker_.summary();
+    EXPECT_EQ(summary.samples, 4u);
+    EXPECT_EQ(summary.lost, 0u);
+    EXPECT_EQ(summary.minUs, 50000);
+    EXPECT_EQ(summary.lossPpm, 0u);
+}
+
+TEST_F(RttTrackerTest, ConfigureClampsAndStartsOver) {
+    echoed(milliseconds(10));
+    RttTracker::Options options;
+    options.window = 0;
+    options.timeout = milliseconds(0);
+    tracker_.configure(options);
+    EXPECT_EQ(tracker_.options().window, 1u);
+    EXPECT_EQ(tracker_.options().timeout, milliseconds(1));
+    EXPECT_FALSE(tracker_.answered());
+    EXPECT_EQ(tracker_.summary().samples, 0u);
+
+    echoed(milliseconds(10));
+    echoed(milliseconds(20));
+    EXPECT_EQ(tracker_.summary().samples, 1u);
+    EXPECT_EQ(tracker_.summary().p50Us, 20000);
+}
+
+TEST_F(RttTrackerTest, ResetForgetsEverything) {
+    echoed(milliseconds(10));
+    tracker_.onSent(sequence_++, now_);
+    tracker_.reset();
+    EXPECT_EQ(tracker_.inFlight(), 0u);
+    EXPECT_FALSE(tracker_.answered());
+    EXPECT_EQ(tracker_.summary().samples, 0u);
+}
+
+} // namespace
+} // namespace wireguard_flutter
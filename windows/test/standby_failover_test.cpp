@@ -0,0 +1,210 @@
+#include "standby_failover.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace wireguard_flutter {
+namespace {
+
+using Reason = StandbyFailover::Reason;
+
+// An adapter's peers in memory
+class FakeBackend : public StandbyFailover::Backend {
+public:
+    struct Peer {
+        std::string endpoint;
+        std::vector<std::string> allowedIps;
+        int64_t keepalive = 0;
+        int64_t handshakeAgeMs = -1;
+    };
+
+    bool keepWarm(const StandbyFailover::Peer& peer, std::chrono::seconds keepalive) override {
+        calls.push_back("keepWarm " + peer.publicKey);
+        if (failKeepWarm) {
+            return false;
+        }
+        Peer& entry = peers[peer.publicKey];
+        if (!peer.endpoint.empty()) {
+            entry.endpoint = peer.endpoint;
+        }
+        entry.keepalive = keepalive.count();
+        return true;
+    }
+
+    bool moveAllowedIps(const std::string& from, const std::string& to) override {
+        calls.push_back("moveAllowedIps " + from + " " + to);
+        if (failMove || peers.count(from) == 0 || peers.count(to) == 0) {
+            return false;
+        }
+        auto& source = peers[from].allowedIps;
+        auto& target = peers[to].allowedIps;
+        target.insert(target.end(), source.begin(), source.end());
+        source.clear();
+        return true;
+    }
+
+    bool removePeer(const std::string& publicKey) override {
+        calls.push_back("removePeer " + publicKey);
+        return peers.erase(publicKey) > 0;
+    }
+
+    int64_t handshakeAgeMs(const std::string& publicKey) override {
+        auto peer = peers.find(publicKey);
+        return peer == peers.end() ? -1 : peer->second.handshakeAgeMs;
+    }
+
+    std::map<std::string, Peer> peers;
+    std::vector<std::string> calls;
+    bool failKeepWarm = false;
+    bool failMove = false;
+};
+
+StandbyFailover::Peer Standby(const std::string& publicKey) {
+    StandbyFailover::Peer peer;
+    peer.publicKey = publicKey;
+    peer.endpoint = "192.0.2.2:51820";
+    return peer;
+}
+
+class StandbyFailoverTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        backend_.peers["active"].allowedIps = {"0.0.0.0/0", "::/0"};
+        backend_.peers["active"].handshakeAgeMs = 5000;
+    }
+
+    FakeBackend backend_;
+    StandbyFailover failover_{backend_};
+};
+
+TEST_F(StandbyFailoverTest, ArmingAddsAStandbyThatCarriesNothing) {
+    ASSERT_TRUE(failover_.arm("active", Standby("standby")));
+    EXPECT_TRUE(failover_.armed());
+    EXPECT_EQ(failover_.active(), "active");
+    EXPECT_EQ(failover_.standby(), "standby");
+
+    const auto& standby = backend_.peers["standby"];
+    EXPECT_TRUE(standby.allowedIps.empty());
+    EXPECT_EQ(standby.endpoint, "192.0.2.2:51820");
+    EXPECT_EQ(standby.keepalive, 25);
+}
+
+TEST_F(StandbyFailoverTest, ArmingRejectsMissingOrSamePeers) {
+    EXPECT_FALSE(failover_.arm("", Standby("standby")));
+    EXPECT_FALSE(failover_.arm("active", Standby("")));
+    EXPECT_FALSE(failover_.arm("active", Standby("active")));
+    backend_.failKeepWarm = true;
+    EXPECT_FALSE(failover_.arm("active", Standby("standby")));
+    EXPECT_FALSE(failover_.armed());
+}
+
+TEST_F(StandbyFailoverTest, ADifferentStandbyReplacesThePrevious) {
+    failover_.arm("active", Standby("first"));
+    failover_.arm("active", Standby("second"));
+    EXPECT_EQ(backend_.peers.count("first"), 0u);
+    EXPECT_EQ(failover_.standby(), "second");
+}
+
+TEST_F(StandbyFailoverTest, WarmNeedsARecentHandshake) {
+    failover_.arm("active", Standby("standby"));
+    EXPECT_FALSE(failover_.warm());
+    backend_.peers["standby"].handshakeAgeMs = 149999;
+    EXPECT_TRUE(failover_.warm());
+    backend_.peers["standby"].handshakeAgeMs = 150000;
+    EXPECT_FALSE(failover_.warm());
+}
+
+TEST_F(StandbyFailoverTest, WatchdogPromotesAWarmStandby) {
+    failover_.arm("active", Standby("standby"));
+    backend_.peers["standby"].handshakeAgeMs = 20000;
+    backend_.calls.clear();
+
+    auto result = failover_.failover(Reason::Watchdog);
+    ASSERT_TRUE(result.switched) << result.error;
+    EXPECT_EQ(result.from, "active");
+    EXPECT_EQ(result.to, "standby");
+    EXPECT_EQ(result.standbyHandshakeAgeMs, 20000);
+
+    // All traffic moved in one update, then the former active peer was
+    // demoted to a standby that is kept warm
+    EXPECT_EQ(backend_.calls, (std::vector<std::string>{"moveAllowedIps active standby", "keepWarm active"}));
+    EXPECT_EQ(backend_.peers["standby"].allowedIps, (std::vector<std::string>{"0.0.0.0/0", "::/0"}));
+    EXPECT_TRUE(backend_.peers["active"].allowedIps.empty());
+    EXPECT_EQ(backend_.peers["active"].keepalive, 25);
+    EXPECT_EQ(failover_.active(), "standby");
+    EXPECT_EQ(failover_.standby(), "active");
+}
+
+TEST_F(StandbyFailoverTest, WatchdogLeavesAColdStandbyAlone) {
+    failover_.arm("active", Standby("standby"));
+    backend_.calls.clear();
+
+    auto result = failover_.failover(Reason::Watchdog);
+    EXPECT_FALSE(result.switched);
+    EXPECT_EQ(result.error, "standby not warm");
+    EXPECT_EQ(result.standbyHandshakeAgeMs, -1);
+    EXPECT_TRUE(backend_.calls.empty());
+    EXPECT_EQ(failover_.active(), "active");
+}
+
+TEST_F(StandbyFailoverTest, UserMayPromoteAColdStandby) {
+    failover_.arm("active", Standby("standby"));
+    auto result = failover_.failover(Reason::User);
+    EXPECT_TRUE(result.switched);
+    EXPECT_EQ(result.reason, Reason::User);
+    EXPECT_EQ(failover_.active(), "standby");
+}
+
+TEST_F(StandbyFailoverTest, FailingBackSwapsAgain) {
+    failover_.arm("active", Standby("standby"));
+    backend_.peers["standby"].handshakeAgeMs = 1000;
+    ASSERT_TRUE(failover_.failover(Reason::Watchdog).switched);
+
+    auto result = failover_.failover(Reason::Watchdog);
+    ASSERT_TRUE(result.switched) << result.error;
+    EXPECT_EQ(result.from, "standby");
+    EXPECT_EQ(result.to, "active");
+    EXPECT_EQ(backend_.peers["active"].allowedIps.size(), 2u);
+    EXPECT_TRUE(backend_.peers["standby"].allowedIps.empty());
+}
+
+TEST_F(StandbyFailoverTest, FailedUpdateKeepsTheRoles) {
+    failover_.arm("active", Standby("standby"));
+    backend_.failMove = true;
+    auto result = failover_.failover(Reason::User);
+    EXPECT_FALSE(result.switched);
+    EXPECT_EQ(result.error, "update failed");
+    EXPECT_EQ(failover_.active(), "active");
+    EXPECT_EQ(failover_.standby(), "standby");
+}
+
+TEST_F(StandbyFailoverTest, NotArmedHasNothingToSwitchTo) {
+    auto result = failover_.failover(Reason::User);
+    EXPECT_FALSE(result.switched);
+    EXPECT_EQ(result.error, "not armed");
+}
+
+TEST_F(StandbyFailoverTest, DisarmRemovesTheStandbyAndResetDoesNot) {
+    failover_.arm("active", Standby("standby"));
+    failover_.disarm();
+    EXPECT_FALSE(failover_.armed());
+    EXPECT_EQ(backend_.peers.count("standby"), 0u);
+
+    failover_.arm("active", Standby("standby"));
+    failover_.reset();
+    EXPECT_FALSE(failover_.armed());
+    EXPECT_EQ(backend_.peers.count("standby"), 1u);
+}
+
+TEST(StandbyFailoverNamesTest, ReasonNames) {
+    EXPECT_STREQ(StandbyFailover::reasonName(Reason::User), "user");
+    EXPECT_STREQ(StandbyFailover::reasonName(Reason::Watchdog), "watchdog");
+}
+
+} // namespace
+} // namespace wireguard_flutter
@@ -0,0 +1,134 @@
+// Counts the heap allocations of the statistics sampling path and times it:
+// the rate estimators, the interval counters, the round-trip summary, the
+// history ring, the stats block and the Int64List encoding the plugin
+// replies with. Fails when a warmed-up sample allocates.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include "interface_counters.h"
+#include "rate_estimator.h"
+#include "rtt_tracker.h"
+#include "stats_block.h"
+#include "stats_history.h"
+#include "tunnel_stats.h"
+
+namespace {
+
+std::atomic<size_t> allocations{0};
+
+} // namespace
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+namespace wireguard_flutter {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int kWarmupSamples = 700;
+constexpr int kMeasuredSamples = 100000;
+
+// The state WireGuardTunnelManager keeps per tunnel for sampling
+struct Sampler {
+    RateEstimator rateIn;
+    RateEstimator rateOut;
+    InterfaceCounterTracker counterTracker;
+    RttTracker rtt;
+    StatsHistory history;
+    TunnelStats latest{};
+    AtomicStatsBlock block;
+    StatsBlock stats{block};
+    // The plugin's kept getWireGuardStatistics reply
+    std::vector<int64_t> reply;
+
+    void sample(const InterfaceCounters& counters, Clock::time_point now, int64_t wallClockMs) {
+        rateIn.addSample(counters.octetsIn, now);
+        rateOut.addSample(counters.octetsOut, now);
+        counterTracker.addSample(counters, now);
+        latest.bytesIn = counters.octetsIn;
+        latest.bytesOut = counters.octetsOut;
+        latest.speedInBps = rateIn.rates().instantBps;
+        latest.speedOutBps = rateOut.rates().instantBps;
+        latest.smoothedInBps = rateIn.rates().smoothedBps;
+        latest.smoothedOutBps = rateOut.rates().smoothedBps;
+        latest.peakInBps = rateIn.rates().peakBps;
+        latest.p95InBps = rateIn.rates().p95Bps;
+        latest.packetsInPerSec = counterTracker.metrics().packetsInPerSec;
+        latest.dropRatioPpm = counterTracker.metrics().dropRatioPpm;
+        auto summary = rtt.summary();
+        latest.rttSamples = summary.samples;
+        latest.rttP50Us = static_cast<uint64_t>(summary.p50Us);
+        history.push(latest, wallClockMs);
+        stats.publish(latest, WIREGUARD_FLUTTER_STATE_CONNECTED, 1000);
+        EncodeTunnelStats(latest, reply);
+    }
+};
+
+int run() {
+    auto sampler = std::make_unique<Sampler>();
+    auto now = Clock::now();
+    InterfaceCounters counters;
+    uint32_t sequence = 0;
+    auto step = [&](int i) {
+        now += std::chrono::seconds(1);
+        counters.octetsIn += 125000 + static_cast<uint64_t>(i % 7) * 1000;
+        counters.octetsOut += 25000;
+        counters.packetsIn += 100;
+        counters.packetsOut += 40;
+        sampler->rtt.expire(now);
+        sampler->rtt.onSent(sequence, now);
+        sampler->rtt.onEcho(sequence++, now + std::chrono::microseconds(20000 + i % 500));
+        sampler->sample(counters, now, 1000LL * i);
+    };
+
+    // Fills the windows and the history ring
+    for (int i = 0; i < kWarmupSamples; i++) {
+        step(i);
+    }
+
+    size_t before = allocations.load();
+    auto started = Clock::now();
+    for (int i = 0; i < kMeasuredSamples; i++) {
+        step(i);
+    }
+    auto elapsed = Clock::now() - started;
+    size_t allocated = allocations.load() - before;
+
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    std::printf("samples: %d\n", kMeasuredSamples);
+    std::printf("allocations: %zu (%.3f per sample)\n", allocated,
+                static_cast<double>(allocated) / kMeasuredSamples);
+    std::printf("time per sample: %.0f ns\n", static_cast<double>(ns) / kMeasuredSamples);
+    if (allocated != 0) {
+        std::printf("FAIL: the sampling path allocates\n");
+        return 1;
+    }
+    return 0;
+}
+
+} // namespace
+} // namespace wireguard_flutter
+
+int main() {
+    return wireguard_flutter::run();
+}
@@ -0,0 +1,90 @@
+#include "stats_block.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace wireguard_flutter {
+namespace {
+
+TEST(StatsBlockTest, ReadStatsAtRejectsBadArguments) {
+    WireguardFlutterStatsBlock out;
+    EXPECT_EQ(WireguardFlutterReadStatsAt(0, nullptr), -1);
+    EXPECT_EQ(WireguardFlutterReadStatsAt(static_cast<uint32_t>(kMaxTunnelStatsBlocks), &out), -1);
+    EXPECT_EQ(WireguardFlutterGetStatsBlockAt(static_cast<uint32_t>(kMaxTunnelStatsBlocks)), nullptr);
+}
+
+TEST(StatsBlockTest, ReadStatsAtCopiesTheTunnelsBlock) {
+    int32_t index = -1;
+    auto& block = TunnelStatsBlock("stats-block-copy", index);
+    ASSERT_GE(index, 0);
+    TunnelStats stats{};
+    stats.bytesIn = 10;
+    stats.bytesOut = 20;
+    block.publish(stats, WIREGUARD_FLUTTER_STATE_CONNECTED, 1500);
+
+    WireguardFlutterStatsBlock out;
+    ASSERT_EQ(WireguardFlutterReadStatsAt(static_cast<uint32_t>(index), &out), 0);
+    EXPECT_EQ(out.version, static_cast<uint32_t>(WIREGUARD_FLUTTER_STATS_BLOCK_VERSION));
+    EXPECT_EQ(out.state, WIREGUARD_FLUTTER_STATE_CONNECTED);
+    EXPECT_EQ(out.bytes_in, 10);
+    EXPECT_EQ(out.bytes_out, 20);
+    EXPECT_EQ(out.handshake_age_ms, 1500);
+    EXPECT_EQ(out.sequence % 2, 0u);
+
+    block.publishState(WIREGUARD_FLUTTER_STATE_DISCONNECTED);
+    ASSERT_EQ(WireguardFlutterReadStatsAt(static_cast<uint32_t>(index), &out), 0);
+    EXPECT_EQ(out.bytes_in, 0);
+    EXPECT_EQ(out.handshake_age_ms, -1);
+}
+
+TEST(StatsBlockTest, ReadStatsAtNeverSeesATornSample) {
+    int32_t index = -1;
+    auto& block = TunnelStatsBlock("stats-block-torn", index);
+    ASSERT_GE(index, 0);
+    std::atomic<bool> done{false};
+    std::atomic<uint64_t> torn{0};
+    std::atomic<uint64_t> reads{0};
+
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 3; r++) {
+        readers.emplace_back([&]() {
+            WireguardFlutterStatsBlock out;
+            while (!done) {
+                WireguardFlutterReadStatsAt(static_cast<uint32_t>(index), &out);
+                if (out.bytes_out != out.bytes_in * 2 || out.speed_in_bps != out.bytes_in ||
+                    out.sequence % 2 != 0) {
+                    torn++;
+                }
+                reads++;
+            }
+        });
+    }
+    // Two writers, like the sampler and the platform thread
+    std::vector<std::thread> writers;
+    for (int w = 0; w < 2; w++) {
+        writers.emplace_back([&, w]() {
+            for (uint64_t i = 1; i <= 100000; i++) {
+                TunnelStats stats{};
+                stats.bytesIn = i * 2 + static_cast<uint64_t>(w);
+                stats.bytesOut = stats.bytesIn * 2;
+                stats.speedInBps = stats.bytesIn;
+                block.publish(stats, WIREGUARD_FLUTTER_STATE_CONNECTED, 0);
+            }
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    done = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    EXPECT_GT(reads.load(), 0u);
+    EXPECT_EQ(torn.load(), 0u);
+}
+
+} // namespace
+} // namespace wireguard_flutter
@@ -0,0 +1,357 @@
+#include "throughput_test.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace wireguard_flutter {
+namespace {
+
+using std::chrono::milliseconds;
+using Report = ThroughputTest::Report;
+
+#ifdef _WIN32
+using SocketHandle = SOCKET;
+using AddressLength = int;
+constexpr int kSendFlags = 0;
+
+void closeSocket(SocketHandle socket) {
+    closesocket(socket);
+}
+#else
+using SocketHandle = int;
+using AddressLength = socklen_t;
+constexpr int kSendFlags = MSG_NOSIGNAL;
+
+void closeSocket(SocketHandle socket) {
+    ::close(socket);
+}
+#endif
+
+constexpr auto kPatience = std::chrono::seconds(10);
+
+// True once |socket| can be read, or written with |write|; gives up after a
+// short while so the server threads notice when to stop
+bool ready(SocketHandle socket, bool write) {
+    fd_set set;
+    FD_ZERO(&set);
+    FD_SET(socket, &set);
+    timeval timeout{0, 20000};
+    return select(static_cast<int>(socket) + 1, write ? nullptr : &set, write ? &set : nullptr, nullptr, &timeout) > 0;
+}
+
+// A test server on the loopback: a TCP sink that discards what it reads, a
+// TCP source that sends until the client goes, or a UDP echo responder
+// that answers every |echoEvery|th datagram
+class TestServer {
+public:
+    enum class Kind { Sink, Source, Echo };
+
+    explicit TestServer(Kind kind, uint32_t echoEvery = 1) : kind_(kind), echoEvery_(echoEvery) {
+#ifdef _WIN32
+        WSADATA wsaData;
+        WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+        bool tcp = kind != Kind::Echo;
+        socket_ = ::socket(AF_INET, tcp ? SOCK_STREAM : SOCK_DGRAM, 0);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        AddressLength length = sizeof(address);
+        bind(socket_, reinterpret_cast<const sockaddr*>(&address), length);
+        getsockname(socket_, reinterpret_cast<sockaddr*>(&address), &length);
+        port_ = ntohs(address.sin_port);
+        if (tcp) {
+            listen(socket_, 16);
+            threads_.emplace_back([this] { accept(); });
+        } else {
+            threads_.emplace_back([this] { echo(); });
+        }
+    }
+
+    ~TestServer() {
+        stop_ = true;
+        // Joined one by one, since accept() adds connection threads
+        for (size_t i = 0;; i++) {
+            std::thread thread;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (i == threads_.size()) {
+                    break;
+                }
+                thread = std::move(threads_[i]);
+            }
+            thread.join();
+        }
+        closeSocket(socket_);
+#ifdef _WIN32
+        WSACleanup();
+#endif
+    }
+
+    std::string endpoint() const { return "127.0.0.1:" + std::to_string(port_); }
+
+private:
+    void accept() {
+        while (!stop_) {
+            if (!ready(socket_, false)) {
+                continue;
+            }
+            SocketHandle connection = ::accept(socket_, nullptr, nullptr);
+            std::lock_guard<std::mutex> lock(mutex_);
+            threads_.emplace_back([this, connection] { serve(connection); });
+        }
+    }
+
+    void serve(SocketHandle connection) {
+        std::vector<char> buffer(64 * 1024, 0x5a);
+        while (!stop_) {
+            if (!ready(connection, kind_ == Kind::Source)) {
+                continue;
+            }
+            auto moved = kind_ == Kind::Source
+                             ? send(connection, buffer.data(), static_cast<int>(buffer.size()), kSendFlags)
+                             : recv(connection, buffer.data(), static_cast<int>(buffer.size()), 0);
+            if (moved <= 0) {
+                break;
+            }
+        }
+        closeSocket(connection);
+    }
+
+    void echo() {
+        std::vector<char> buffer(65536);
+        uint32_t received = 0;
+        while (!stop_) {
+            if (!ready(socket_, false)) {
+                continue;
+            }
+            sockaddr_storage from{};
+            AddressLength length = sizeof(from);
+            auto size = recvfrom(socket_, buffer.data(), static_cast<int>(buffer.size()), 0,
+                                 reinterpret_cast<sockaddr*>(&from), &length);
+            if (size > 0 && received++ % echoEvery_ == 0) {
+                sendto(socket_, buffer.data(), static_cast<int>(size), 0, reinterpret_cast<const sockaddr*>(&from),
+                       length);
+            }
+        }
+    }
+
+    Kind kind_;
+    uint32_t echoEvery_;
+    SocketHandle socket_;
+    uint16_t port_ = 0;
+    std::atomic<bool> stop_{false};
+    std::mutex mutex_;
+    std::vector<std::thread> threads_;
+};
+
+// Short tests, so the suite stays quick; loopback moves plenty in that time
+ThroughputTest::Options shortOptions(ThroughputTest::Protocol protocol) {
+    ThroughputTest::Options options;
+    options.protocol = protocol;
+    options.streams = 2;
+    options.duration = milliseconds(600);
+    options.warmup = milliseconds(100);
+    options.interval = milliseconds(100);
+    options.drain = milliseconds(200);
+    options.rateBps = 1000000;
+    options.probeInterval = milliseconds(20);
+    return options;
+}
+
+class ThroughputTestTest : public ::testing::Test {
+protected:
+    struct Reports {
+        std::mutex mutex;
+        std::vector<Report> all;
+        std::promise<void> done;
+    };
+
+    void SetUp() override { ASSERT_TRUE(loop_.start()); }
+    void TearDown() override { loop_.stop(); }
+
+    std::shared_ptr<ThroughputTest> begin(const std::string& endpoint, const ThroughputTest::Options& options) {
+        reports_ = std::make_shared<Reports>();
+        auto reports = reports_;
+        return ThroughputTest::start(loop_, endpoint, options, [this, reports](const Report& report) {
+            EXPECT_TRUE(loop_.inLoopThread());
+            std::lock_guard<std::mutex> lock(reports->mutex);
+            reports->all.push_back(report);
+            if (report.done) {
+                reports->done.set_value();
+            }
+        });
+    }
+
+    // Every report, the final one last, once the test ended
+    std::vector<Report> awaitReports() {
+        EXPECT_EQ(reports_->done.get_future().wait_for(kPatience), std::future_status::ready);
+        std::lock_guard<std::mutex> lock(reports_->mutex);
+        return reports_->all;
+    }
+
+    std::vector<Report> measure(const std::string& endpoint, const ThroughputTest::Options& options) {
+        auto test = begin(endpoint, options);
+        EXPECT_TRUE(test);
+        if (!test) {
+            return {};
+        }
+        auto reports = awaitReports();
+        EXPECT_TRUE(test->finished());
+        return reports;
+    }
+
+    EventLoop loop_;
+    std::shared_ptr<Reports> reports_;
+};
+
+TEST(ThroughputFairnessTest, JainsIndex) {
+    EXPECT_DOUBLE_EQ(ThroughputTest::fairness({5, 5, 5, 5}), 1.0);
+    EXPECT_DOUBLE_EQ(ThroughputTest::fairness({8, 0, 0, 0}), 0.25);
+    // (1 + 3)^2 / (2 * (1 + 9))
+    EXPECT_DOUBLE_EQ(ThroughputTest::fairness({1, 3}), 0.8);
+    EXPECT_DOUBLE_EQ(ThroughputTest::fairness({0, 0}), 0.0);
+    EXPECT_DOUBLE_EQ(ThroughputTest::fairness({}), 0.0);
+}
+
+TEST_F(ThroughputTestTest, TcpUploadReportsGoodputPerStream) {
+    TestServer sink(TestServer::Kind::Sink);
+    auto reports = measure(sink.endpoint(), shortOptions(ThroughputTest::Protocol::Tcp));
+    ASSERT_GE(reports.size(), 2u);
+    for (size_t i = 0; i + 1 < reports.size(); i++) {
+        EXPECT_FALSE(reports[i].done);
+    }
+    const Report& final = reports.back();
+    EXPECT_TRUE(final.done);
+    EXPECT_EQ(final.error, "");
+    EXPECT_EQ(final.connected, 2u);
+    EXPECT_EQ(final.failed, 0u);
+    EXPECT_GT(final.bytes, 0u);
+    EXPECT_GT(final.goodputBps, 0);
+    ASSERT_EQ(final.streamBps.size(), 2u);
+    EXPECT_GT(final.fairness, 0.5);
+    EXPECT_LE(final.fairness, 1.0 + 1e-9);
+    EXPECT_LE(final.elapsed, milliseconds(600));
+    // No echo responder, so neither round trips nor loss
+    EXPECT_EQ(final.rttSamples, 0u);
+    EXPECT_EQ(final.rttP50Us, -1);
+    EXPECT_EQ(final.loss, -1);
+}
+
+TEST_F(ThroughputTestTest, TcpDownloadReadsFromTheSource) {
+    TestServer source(TestServer::Kind::Source);
+    auto options = shortOptions(ThroughputTest::Protocol::Tcp);
+    options.direction = ThroughputTest::Direction::Download;
+    auto reports = measure(source.endpoint(), options);
+    ASSERT_FALSE(reports.empty());
+    const Report& final = reports.back();
+    EXPECT_EQ(final.error, "");
+    EXPECT_EQ(final.connected, 2u);
+    EXPECT_GT(final.bytes, 0u);
+    EXPECT_GT(final.goodputBps, 0);
+}
+
+TEST_F(ThroughputTestTest, TcpProbesGiveRoundTripsUnderLoad) {
+    TestServer sink(TestServer::Kind::Sink);
+    TestServer echo(TestServer::Kind::Echo);
+    auto options = shortOptions(ThroughputTest::Protocol::Tcp);
+    options.latencyEndpoint = echo.endpoint();
+    auto reports = measure(sink.endpoint(), options);
+    ASSERT_FALSE(reports.empty());
+    const Report& final = reports.back();
+    EXPECT_EQ(final.error, "");
+    EXPECT_GT(final.rttSamples, 0u);
+    EXPECT_GE(final.rttMinUs, 0);
+    EXPECT_LE(final.rttMinUs, final.rttP50Us);
+    EXPECT_LE(final.rttP50Us, final.rttP90Us);
+    EXPECT_LE(final.rttP90Us, final.rttP99Us);
+    EXPECT_GE(final.loss, 0);
+    EXPECT_LT(final.loss, 0.5);
+}
+
+TEST_F(ThroughputTestTest, UdpEchoesGiveGoodputAndRoundTrips) {
+    TestServer echo(TestServer::Kind::Echo);
+    auto reports = measure(echo.endpoint(), shortOptions(ThroughputTest::Protocol::Udp));
+    ASSERT_FALSE(reports.empty());
+    const Report& final = reports.back();
+    EXPECT_EQ(final.error, "");
+    EXPECT_EQ(final.connected, 2u);
+    EXPECT_GT(final.bytes, 0u);
+    EXPECT_GT(final.rttSamples, 0u);
+    EXPECT_GE(final.loss, 0);
+    EXPECT_LT(final.loss, 0.2);
+    // Paced at 1 Mbit/s per stream; echoes counted after the warmup
+    EXPECT_LT(final.goodputBps, 2 * 1000000 * 1.5);
+}
+
+TEST_F(ThroughputTestTest, UdpLossCountsDatagramsNotEchoed) {
+    TestServer echo(TestServer::Kind::Echo, 2);
+    auto reports = measure(echo.endpoint(), shortOptions(ThroughputTest::Protocol::Udp));
+    ASSERT_FALSE(reports.empty());
+    const Report& final = reports.back();
+    EXPECT_GT(final.loss, 0.3);
+    EXPECT_LT(final.loss, 0.7);
+}
+
+// Loss is only known once nothing more can come back
+TEST_F(ThroughputTestTest, LossIsUnknownWhileLoading) {
+    TestServer echo(TestServer::Kind::Echo);
+    auto reports = measure(echo.endpoint(), shortOptions(ThroughputTest::Protocol::Udp));
+    ASSERT_GE(reports.size(), 2u);
+    EXPECT_EQ(reports.front().loss, -1);
+    EXPECT_GE(reports.back().loss, 0);
+}
+
+TEST_F(ThroughputTestTest, CancelEndsWithAFinalReport) {
+    TestServer sink(TestServer::Kind::Sink);
+    auto options = shortOptions(ThroughputTest::Protocol::Tcp);
+    options.duration = std::chrono::seconds(60);
+    auto test = begin(sink.endpoint(), options);
+    ASSERT_TRUE(test);
+    test->cancel();
+    auto reports = awaitReports();
+    ASSERT_FALSE(reports.empty());
+    EXPECT_TRUE(reports.back().done);
+    EXPECT_EQ(reports.back().error, "cancelled");
+    EXPECT_TRUE(test->finished());
+}
+
+TEST_F(ThroughputTestTest, StreamCountIsClamped) {
+    TestServer sink(TestServer::Kind::Sink);
+    auto options = shortOptions(ThroughputTest::Protocol::Tcp);
+    options.streams = 0;
+    auto reports = measure(sink.endpoint(), options);
+    ASSERT_FALSE(reports.empty());
+    EXPECT_EQ(reports.back().streamBps.size(), 1u);
+}
+
+TEST_F(ThroughputTestTest, MalformedEndpointDoesNotStart) {
+    bool called = false;
+    auto test = ThroughputTest::start(loop_, "no port", shortOptions(ThroughputTest::Protocol::Tcp),
+                                      [&called](const Report&) { called = true; });
+    EXPECT_FALSE(test);
+    EXPECT_FALSE(called);
+}
+
+} // namespace
+} // namespace wireguard_flutter
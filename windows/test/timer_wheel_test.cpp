@@ -0,0 +1,71 @@
+#include "timer_wheel.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace wireguard_flutter {
+namespace {
+
+using std::chrono::milliseconds;
+
+TEST(TimerWheelTest, ExpiresInDeadlineThenIdOrder) {
+    auto origin = TimerWheel::Clock::now();
+    TimerWheel wheel(origin, milliseconds(10), 4);
+    wheel.add(3, origin + milliseconds(25));
+    wheel.add(1, origin + milliseconds(25));
+    wheel.add(2, origin + milliseconds(21));
+    wheel.add(9, origin + milliseconds(500));
+
+    std::vector<uint64_t> expired;
+    wheel.advance(origin + milliseconds(20), expired);
+    EXPECT_TRUE(expired.empty());
+    wheel.advance(origin + milliseconds(30), expired);
+    EXPECT_EQ(expired, (std::vector<uint64_t>{2, 1, 3}));
+    EXPECT_EQ(wheel.size(), 1u);
+}
+
+TEST(TimerWheelTest, NeverFiresEarlyAcrossLaps) {
+    auto origin = TimerWheel::Clock::now();
+    TimerWheel wheel(origin, milliseconds(10), 4);
+    wheel.add(9, origin + milliseconds(500));
+    EXPECT_EQ(wheel.nextExpiry(), origin + milliseconds(500));
+
+    std::vector<uint64_t> expired;
+    wheel.advance(origin + milliseconds(499), expired);
+    EXPECT_TRUE(expired.empty());
+    wheel.advance(origin + milliseconds(500), expired);
+    EXPECT_EQ(expired, (std::vector<uint64_t>{9}));
+    EXPECT_EQ(wheel.nextExpiry(), TimerWheel::Clock::time_point::max());
+}
+
+TEST(TimerWheelTest, AddReplacesAndRemoveForgets) {
+    auto origin = TimerWheel::Clock::now();
+    TimerWheel wheel(origin, milliseconds(10), 8);
+    wheel.add(1, origin + milliseconds(20));
+    wheel.add(1, origin + milliseconds(80));
+    wheel.add(2, origin + milliseconds(30));
+    EXPECT_TRUE(wheel.remove(2));
+    EXPECT_FALSE(wheel.remove(2));
+    EXPECT_FALSE(wheel.contains(2));
+
+    std::vector<uint64_t> expired;
+    wheel.advance(origin + milliseconds(50), expired);
+    EXPECT_TRUE(expired.empty());
+    wheel.advance(origin + milliseconds(80), expired);
+    EXPECT_EQ(expired, (std::vector<uint64_t>{1}));
+}
+
+TEST(TimerWheelTest, PastDeadlinesExpireOnTheNextAdvance) {
+    auto origin = TimerWheel::Clock::now();
+    TimerWheel wheel(origin, milliseconds(10), 4);
+    std::vector<uint64_t> expired;
+    wheel.advance(origin + milliseconds(100), expired);
+    wheel.add(5, origin);
+    EXPECT_LE(wheel.nextExpiry(), origin + milliseconds(110));
+    wheel.advance(origin + milliseconds(110), expired);
+    EXPECT_EQ(expired, (std::vector<uint64_t>{5}));
+}
+
+} // namespace
+} // namespace wireguard_flutter
@@ -0,0 +1,142 @@
+// Times complete() and instant() with recording off, as on every start,
+// sample and method call in a normal run, and with it on, from one thread
+// and from several at once, and counts the heap allocations a record
+// makes. Fails when a call allocates, when the ring does not hold the
+// latest events, or when a call gets slower than the budget.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "trace_recorder.h"
+
+namespace {
+
+// Only the recording threads count; the check reads into strings
+thread_local bool countAllocations = false;
+std::atomic<size_t> allocations{0};
+
+} // namespace
+
+void* operator new(size_t size) {
+    if (countAllocations) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (void* memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+namespace wireguard_flutter {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int kCallsOff = 10000000;
+constexpr int kCallsOn = 1000000;
+// Ceilings that catch a lock or an allocation creeping in, with room for a
+// loaded machine and an unoptimized build; there a call typically takes
+// some 25 ns while off and a few hundred while on
+constexpr double kBudgetNsOff = 250.0;
+constexpr double kBudgetNsOn = 2000.0;
+
+// Alternates spans and instant events; returns ns per call
+double record(int calls) {
+    TraceRecorder& recorder = TraceRecorder::instance();
+    auto started = Clock::now();
+    for (int i = 0; i < calls; i++) {
+        if (i % 2 == 0) {
+            recorder.complete("tunnel", "sample", i, 3, "benchmark-tunnel", "bytes", i);
+        } else {
+            recorder.instant("tunnel", "stage", "benchmark-tunnel");
+        }
+    }
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - started).count();
+    return static_cast<double>(ns) / calls;
+}
+
+int run() {
+    TraceRecorder& recorder = TraceRecorder::instance();
+    int failures = 0;
+
+    countAllocations = true;
+    double off = record(kCallsOff);
+    size_t offAllocations = allocations.load();
+    // The first record allocates the ring
+    recorder.setEnabled(true);
+    record(1);
+    allocations = 0;
+    double on = record(kCallsOn);
+    countAllocations = false;
+    size_t onAllocations = allocations.load();
+
+    unsigned threads = std::max(2u, std::min(8u, std::thread::hardware_concurrency()));
+    std::vector<std::thread> recorders;
+    std::vector<double> contended(threads);
+    for (unsigned t = 0; t < threads; t++) {
+        recorders.emplace_back([&contended, t]() {
+            TraceRecorder::nameThread("benchmark");
+            countAllocations = true;
+            contended[t] = record(kCallsOn / 4);
+            countAllocations = false;
+        });
+    }
+    for (auto& thread : recorders) {
+        thread.join();
+    }
+    double worst = *std::max_element(contended.begin(), contended.end());
+    size_t contendedAllocations = allocations.load() - onAllocations;
+
+    recorder.instant("tunnel", "last", "final-event");
+    std::vector<TraceRecorder::Event> events;
+    recorder.snapshot(events);
+    recorder.setEnabled(false);
+    recorder.clear();
+
+    std::printf("recording off: %.2f ns per call\n", off);
+    std::printf("recording on: %.1f ns per call, %.1f ns with %u threads\n", on, worst, threads);
+    std::printf("allocations while off: %zu, while on: %zu, %zu with %u threads\n", offAllocations, onAllocations,
+                contendedAllocations, threads);
+    std::printf("events in the ring: %zu of %zu\n", events.size(), TraceRecorder::kCapacity);
+
+    if (offAllocations != 0 || onAllocations != 0 || contendedAllocations != 0) {
+        std::printf("FAIL: a call allocated\n");
+        failures++;
+    }
+    if (events.empty() || events.size() > TraceRecorder::kCapacity || events.back().label != "final-event") {
+        std::printf("FAIL: the ring does not end with the last event\n");
+        failures++;
+    }
+    if (off > kBudgetNsOff) {
+        std::printf("FAIL: a call took longer than %.0f ns while off\n", kBudgetNsOff);
+        failures++;
+    }
+    if (on > kBudgetNsOn || worst > kBudgetNsOn) {
+        std::printf("FAIL: a call took longer than %.0f ns while on\n", kBudgetNsOn);
+        failures++;
+    }
+    return failures == 0 ? 0 : 1;
+}
+
+} // namespace
+} // namespace wireguard_flutter
+
+int main() {
+    return wireguard_flutter::run();
+}
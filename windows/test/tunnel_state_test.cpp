@@ -0,0 +1,130 @@
+#include "tunnel_state.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace wireguard_flutter {
+namespace {
+
+TEST(TunnelStateTest, StartsDisconnected) {
+    TunnelStateMachine machine;
+    auto snapshot = machine.snapshot();
+    EXPECT_EQ(snapshot.state, TunnelState::Disconnected);
+    EXPECT_EQ(snapshot.generation, 0u);
+}
+
+TEST(TunnelStateTest, FollowsTheTable) {
+    using S = TunnelState;
+    EXPECT_TRUE(TunnelStateMachine::isAllowed(S::Disconnected, S::Connecting));
+    EXPECT_FALSE(TunnelStateMachine::isAllowed(S::Disconnected, S::Connected));
+    EXPECT_FALSE(TunnelStateMachine::isAllowed(S::Disconnected, S::Disconnecting));
+    EXPECT_TRUE(TunnelStateMachine::isAllowed(S::Connected, S::Reconnecting));
+    EXPECT_TRUE(TunnelStateMachine::isAllowed(S::Degraded, S::Reconnecting));
+    EXPECT_FALSE(TunnelStateMachine::isAllowed(S::Reconnecting, S::Degraded));
+    EXPECT_TRUE(TunnelStateMachine::isAllowed(S::Error, S::Disconnecting));
+    EXPECT_FALSE(TunnelStateMachine::isAllowed(S::Error, S::Connecting));
+    EXPECT_FALSE(TunnelStateMachine::isAllowed(S::Disconnecting, S::Disconnecting));
+    EXPECT_FALSE(TunnelStateMachine::isAllowed(S::Connected, static_cast<S>(kTunnelStateCount)));
+    for (size_t i = 0; i < kTunnelStateCount; i++) {
+        auto state = static_cast<S>(i);
+        EXPECT_FALSE(TunnelStateMachine::isAllowed(state, state)) << TunnelStateMachine::stageName(state);
+    }
+}
+
+TEST(TunnelStateTest, RefusedTransitionKeepsState) {
+    TunnelStateMachine machine;
+    EXPECT_FALSE(machine.transition(TunnelState::Connected));
+    EXPECT_TRUE(machine.is(TunnelState::Disconnected));
+    EXPECT_EQ(machine.snapshot().generation, 0u);
+}
+
+TEST(TunnelStateTest, EveryTransitionBumpsTheGeneration) {
+    TunnelStateMachine machine;
+    TunnelStateMachine::Snapshot previous;
+    ASSERT_TRUE(machine.transition(TunnelState::Connecting, &previous));
+    EXPECT_EQ(previous.state, TunnelState::Disconnected);
+    ASSERT_TRUE(machine.transition(TunnelState::Connected));
+    ASSERT_TRUE(machine.transition(TunnelState::Degraded));
+    ASSERT_TRUE(machine.transition(TunnelState::Connected, &previous));
+    EXPECT_EQ(previous.state, TunnelState::Degraded);
+    EXPECT_EQ(previous.generation, 3u);
+    EXPECT_EQ(machine.snapshot().generation, 4u);
+}
+
+TEST(TunnelStateTest, StaleSnapshotIsRefused) {
+    TunnelStateMachine machine;
+    machine.transition(TunnelState::Connecting);
+    machine.transition(TunnelState::Connected);
+    auto seen = machine.snapshot();
+    // Drops and comes back while a callback still holds |seen|
+    machine.transition(TunnelState::Reconnecting);
+    machine.transition(TunnelState::Connected);
+    EXPECT_EQ(machine.state(), seen.state);
+    EXPECT_FALSE(machine.transition(seen, TunnelState::Degraded));
+    EXPECT_TRUE(machine.transition(machine.snapshot(), TunnelState::Degraded));
+}
+
+TEST(TunnelStateTest, StageNames) {
+    EXPECT_STREQ(TunnelStateMachine::stageName(TunnelState::Disconnected), "disconnected");
+    EXPECT_STREQ(TunnelStateMachine::stageName(TunnelState::Connecting), "connecting");
+    EXPECT_STREQ(TunnelStateMachine::stageName(TunnelState::Connected), "connected");
+    EXPECT_STREQ(TunnelStateMachine::stageName(TunnelState::Error), "error");
+    EXPECT_STREQ(TunnelStateMachine::stageName(TunnelState::Disconnecting), "disconnecting");
+    EXPECT_STREQ(TunnelStateMachine::stageName(TunnelState::Reconnecting), "reconnect");
+    EXPECT_STREQ(TunnelStateMachine::stageName(TunnelState::Degraded), "degraded");
+}
+
+TEST(TunnelStateTest, ConcurrentStartsHaveOneWinner) {
+    for (int round = 0; round < 200; round++) {
+        TunnelStateMachine machine;
+        std::atomic<int> winners{0};
+        std::atomic<bool> go{false};
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; t++) {
+            threads.emplace_back([&]() {
+                while (!go) {
+                    std::this_thread::yield();
+                }
+                if (machine.transition(TunnelState::Connecting)) {
+                    winners++;
+                }
+            });
+        }
+        go = true;
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        ASSERT_EQ(winners.load(), 1);
+        ASSERT_EQ(machine.snapshot().generation, 1u);
+    }
+}
+
+TEST(TunnelStateTest, ConcurrentSnapshotTransitionsHaveOneWinner) {
+    TunnelStateMachine machine;
+    machine.transition(TunnelState::Connecting);
+    machine.transition(TunnelState::Connected);
+    auto seen = machine.snapshot();
+    std::atomic<int> winners{0};
+    std::vector<std::thread> threads;
+    const TunnelState targets[] = {TunnelState::Degraded, TunnelState::Reconnecting, TunnelState::Error,
+                                   TunnelState::Disconnecting};
+    for (auto target : targets) {
+        threads.emplace_back([&, target]() {
+            if (machine.transition(seen, target)) {
+                winners++;
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(winners.load(), 1);
+    EXPECT_EQ(machine.snapshot().generation, seen.generation + 1);
+}
+
+} // namespace
+} // namespace wireguard_flutter
@@ -0,0 +1,144 @@
+// Crashes the usage ledger at random points and times its recovery. Each
+// round flushes a random number of records, takes the file as a crash
+// would leave it, tears the next slot with a partial record and replays
+// the image. Fails when a replay recovers anything but the flushed totals,
+// or when replaying a full ledger takes longer than the budget.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "usage_ledger.h"
+
+namespace wireguard_flutter {
+namespace {
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kHeaderSize = 64;
+constexpr size_t kRecordSize = 64;
+constexpr size_t kCapacity = UsageLedger::kDefaultCapacity;
+constexpr int kRounds = 200;
+constexpr auto kReplayBudget = std::chrono::milliseconds(50);
+
+uint64_t total(const UsageLedger& ledger) {
+    uint64_t bytes = 0;
+    for (const auto& entry : ledger.usage("")) {
+        bytes += entry.bytesIn + entry.bytesOut;
+    }
+    return bytes;
+}
+
+// Writes a prefix of a record into |slot|: what a crash between the stores
+// of an append leaves behind, garbage or a commit marker included
+void tear(const fs::path& image, size_t slot, std::mt19937& random) {
+    std::fstream file(image, std::ios::binary | std::ios::in | std::ios::out);
+    std::vector<char> bytes(1 + random() % kRecordSize);
+    for (auto& byte : bytes) {
+        byte = static_cast<char>(random());
+    }
+    if (random() % 2) {
+        const char commit[4] = {'W', 'G', 'L', 'R'};
+        std::memcpy(bytes.data(), commit, std::min(bytes.size(), sizeof(commit)));
+    }
+    file.seekp(static_cast<std::streamoff>(kHeaderSize + slot * kRecordSize));
+    file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+int run() {
+    fs::path directory = fs::temp_directory_path() / "wireguard_flutter_ledger_benchmark";
+    std::error_code error;
+    fs::remove_all(directory, error);
+    fs::create_directories(directory);
+    fs::path path = directory / "usage.bin";
+    fs::path image = directory / "crashed.bin";
+
+    std::mt19937 random(42);
+    int failures = 0;
+    UsageLedger ledger(path, kCapacity);
+    if (!ledger.open()) {
+        std::printf("FAIL: could not open %s\n", path.string().c_str());
+        return 1;
+    }
+    size_t records = 0;
+    uint64_t flushed = 0;
+    Clock::duration recovering{};
+    for (int round = 0; round < kRounds; round++) {
+        // Stays below the point where flush compacts, so records line up
+        // with slots
+        size_t appends = 1 + random() % 8;
+        for (size_t i = 0; i < appends && records < kCapacity - 1; i++) {
+            uint64_t bytes = 1 + random() % 100000;
+            ledger.record("tunnel-" + std::to_string(records), bytes, 0);
+            ledger.flush();
+            flushed += bytes;
+            records++;
+        }
+        // Recorded, but the process dies before the next flush
+        ledger.record("tunnel-0", 1, 1);
+
+        fs::copy_file(path, image, fs::copy_options::overwrite_existing);
+        tear(image, records, random);
+        auto started = Clock::now();
+        UsageLedger recovered(image, kCapacity);
+        bool opened = recovered.open();
+        recovering += Clock::now() - started;
+        if (!opened || total(recovered) != flushed) {
+            std::printf("FAIL: round %d recovered %llu of %llu bytes\n", round,
+                        static_cast<unsigned long long>(opened ? total(recovered) : 0),
+                        static_cast<unsigned long long>(flushed));
+            failures++;
+        }
+        recovered.close();
+        // What survived the crash goes to disk before the next one
+        ledger.flush();
+        flushed += 2;
+        records++;
+    }
+    ledger.close();
+
+    // Replay of a ledger filled up to the point where it compacts
+    UsageLedger full(path, kCapacity);
+    full.open();
+    for (size_t i = records; i < kCapacity * 3 / 4; i++) {
+        full.record("tunnel-" + std::to_string(i % 64), 1, 1);
+        full.flush();
+    }
+    full.close();
+    auto started = Clock::now();
+    UsageLedger replayed(path, kCapacity);
+    replayed.open();
+    auto replay = Clock::now() - started;
+
+    auto us = [](Clock::duration duration) {
+        return static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+    };
+    std::printf("crash rounds: %d, failures: %d\n", kRounds, failures);
+    std::printf("recovery per crash: %.0f us\n", us(recovering) / kRounds);
+    std::printf("replay of %zu records: %.0f us\n", kCapacity * 3 / 4, us(replay));
+    replayed.close();
+    fs::remove_all(directory, error);
+
+    if (failures != 0) {
+        return 1;
+    }
+    if (replay > kReplayBudget) {
+        std::printf("FAIL: replay took longer than %lld ms\n", static_cast<long long>(kReplayBudget.count()));
+        return 1;
+    }
+    return 0;
+}
+
+} // namespace
+} // namespace wireguard_flutter
+
+int main() {
+    return wireguard_flutter::run();
+}
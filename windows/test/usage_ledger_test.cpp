@@ -0,0 +1,208 @@
+#include "usage_ledger.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace wireguard_flutter {
+namespace {
+
+namespace fs = std::filesystem;
+
+// The on-disk layout: a 64-byte header, then 64-byte records that start
+// with their commit marker
+constexpr size_t kHeaderSize = 64;
+constexpr size_t kRecordSize = 64;
+constexpr size_t kChecksumOffset = 56;
+
+class UsageLedgerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        static std::atomic<int> next{0};
+        directory_ = fs::temp_directory_path() /
+                     ("wireguard_flutter_ledger_" + std::to_string(::testing::UnitTest::GetInstance()->random_seed()) +
+                      "_" + std::to_string(next++));
+        fs::remove_all(directory_);
+        path_ = directory_ / "usage.bin";
+    }
+
+    void TearDown() override {
+        std::error_code error;
+        fs::remove_all(directory_, error);
+    }
+
+    // What the file looked like the moment the process died: the mapping
+    // is shared, so the pages written so far are in the file
+    fs::path crashImage() {
+        fs::path image = directory_ / "crashed.bin";
+        fs::copy_file(path_, image, fs::copy_options::overwrite_existing);
+        return image;
+    }
+
+    static std::vector<char> readFile(const fs::path& path) {
+        std::ifstream in(path, std::ios::binary);
+        return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    static void writeFile(const fs::path& path, const std::vector<char>& bytes) {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    }
+
+    static uint64_t total(const UsageLedger& ledger, const std::string& tunnel) {
+        uint64_t bytes = 0;
+        for (const auto& entry : ledger.usage(tunnel)) {
+            bytes += entry.bytesIn + entry.bytesOut;
+        }
+        return bytes;
+    }
+
+    fs::path directory_;
+    fs::path path_;
+};
+
+TEST_F(UsageLedgerTest, TotalsSurviveReopening) {
+    {
+        UsageLedger ledger(path_);
+        ASSERT_TRUE(ledger.open());
+        ledger.record("home", 100, 10);
+        ledger.flush();
+        ledger.record("home", 50, 5);
+        ledger.record("work", 7, 3);
+        ledger.close();
+    }
+    UsageLedger ledger(path_);
+    ASSERT_TRUE(ledger.open());
+    auto home = ledger.usage("home");
+    ASSERT_EQ(home.size(), 1u);
+    EXPECT_EQ(home[0].bytesIn, 150u);
+    EXPECT_EQ(home[0].bytesOut, 15u);
+    EXPECT_EQ(home[0].day, UsageLedger::today());
+    EXPECT_EQ(ledger.usedBytes("work", UsageLedger::QuotaPeriod::Total), 10u);
+    EXPECT_EQ(ledger.usage("").size(), 2u);
+}
+
+TEST_F(UsageLedgerTest, CrashLosesOnlyWhatWasNotFlushed) {
+    UsageLedger ledger(path_);
+    ASSERT_TRUE(ledger.open());
+    ledger.record("home", 1000, 100);
+    ledger.flush();
+    ledger.record("home", 1, 1);
+    fs::path image = crashImage();
+
+    UsageLedger recovered(image);
+    ASSERT_TRUE(recovered.open());
+    EXPECT_EQ(total(recovered, "home"), 1100u);
+}
+
+TEST_F(UsageLedgerTest, TornRecordsAreDropped) {
+    {
+        UsageLedger ledger(path_);
+        ASSERT_TRUE(ledger.open());
+        ledger.record("home", 100, 0);
+        ledger.flush();
+        ledger.record("home", 200, 0);
+        ledger.flush();
+    }
+    auto bytes = readFile(path_);
+    size_t second = kHeaderSize + kRecordSize;
+
+    // Commit marker on disk, payload not: the checksum gives it away
+    auto torn = bytes;
+    torn[second + kChecksumOffset] ^= 0x5a;
+    writeFile(path_, torn);
+    {
+        UsageLedger ledger(path_);
+        ASSERT_TRUE(ledger.open());
+        EXPECT_EQ(total(ledger, "home"), 100u);
+    }
+
+    // Payload on disk, commit marker not
+    torn = bytes;
+    std::memset(&torn[second], 0, sizeof(uint32_t));
+    writeFile(path_, torn);
+    UsageLedger ledger(path_);
+    ASSERT_TRUE(ledger.open());
+    EXPECT_EQ(total(ledger, "home"), 100u);
+
+    // The torn slot is reused by the next append
+    ledger.record("home", 5, 0);
+    ledger.close();
+    UsageLedger reopened(path_);
+    ASSERT_TRUE(reopened.open());
+    EXPECT_EQ(total(reopened, "home"), 105u);
+}
+
+TEST_F(UsageLedgerTest, CompactionKeepsTotals) {
+    UsageLedger ledger(path_, 16);
+    ASSERT_TRUE(ledger.open());
+    for (int i = 0; i < 100; i++) {
+        ledger.record(i % 2 ? "home" : "work", 10, 1);
+        ledger.flush();
+    }
+    EXPECT_EQ(total(ledger, "home"), 550u);
+    EXPECT_EQ(total(ledger, "work"), 550u);
+    ledger.close();
+    EXPECT_FALSE(fs::exists(directory_ / "usage.bin.tmp"));
+
+    UsageLedger reopened(path_, 16);
+    ASSERT_TRUE(reopened.open());
+    EXPECT_EQ(total(reopened, "home"), 550u);
+    EXPECT_EQ(total(reopened, "work"), 550u);
+}
+
+TEST_F(UsageLedgerTest, UnknownFileIsSetAside) {
+    fs::create_directories(directory_);
+    writeFile(path_, std::vector<char>(4096, 'x'));
+    UsageLedger ledger(path_);
+    ASSERT_TRUE(ledger.open());
+    EXPECT_TRUE(ledger.usage("").empty());
+    EXPECT_TRUE(fs::exists(directory_ / "usage.bin.bad"));
+}
+
+TEST_F(UsageLedgerTest, QuotaFiresOncePerPeriod) {
+    UsageLedger ledger(path_);
+    ASSERT_TRUE(ledger.open());
+    UsageLedger::Quota quota;
+    quota.tunnel = "home";
+    quota.period = UsageLedger::QuotaPeriod::Day;
+    quota.limitBytes = 1000;
+    quota.action = UsageLedger::QuotaAction::Disconnect;
+    ledger.setQuota(quota);
+
+    UsageLedger::QuotaHit hit;
+    ledger.record("home", 600, 0);
+    EXPECT_FALSE(ledger.checkQuotas("home", hit));
+    ledger.record("home", 600, 0);
+    ASSERT_TRUE(ledger.checkQuotas("home", hit));
+    EXPECT_EQ(hit.usedBytes, 1200u);
+    EXPECT_EQ(hit.quota.action, UsageLedger::QuotaAction::Disconnect);
+    EXPECT_FALSE(ledger.checkQuotas("home", hit));
+    EXPECT_FALSE(ledger.checkQuotas("work", hit));
+}
+
+// As the setDataQuota arguments are checked; a typo must not pass
+TEST(UsageLedgerNamesTest, ParsesOnlyKnownPeriodsAndActions) {
+    UsageLedger::QuotaPeriod period = UsageLedger::QuotaPeriod::Total;
+    EXPECT_TRUE(UsageLedger::parsePeriod("month", period));
+    EXPECT_EQ(period, UsageLedger::QuotaPeriod::Month);
+    EXPECT_FALSE(UsageLedger::parsePeriod("week", period));
+
+    UsageLedger::QuotaAction action = UsageLedger::QuotaAction::Notify;
+    EXPECT_TRUE(UsageLedger::parseAction("disconnect", action));
+    EXPECT_EQ(action, UsageLedger::QuotaAction::Disconnect);
+    EXPECT_TRUE(UsageLedger::parseAction("notify", action));
+    EXPECT_EQ(action, UsageLedger::QuotaAction::Notify);
+    EXPECT_FALSE(UsageLedger::parseAction("disconect", action));
+    EXPECT_FALSE(UsageLedger::parseAction("", action));
+    EXPECT_EQ(action, UsageLedger::QuotaAction::Notify);
+}
+
+} // namespace
+} // namespace wireguard_flutter
@@ -0,0 +1,758 @@
+#include "throughput_test.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+#include "logger.h"
+#include "wg_quick_config.h"
+
+namespace wireguard_flutter {
+
+namespace {
+
+#ifdef _WIN32
+using SocketHandle = SOCKET;
+using AddressLength = int;
+const SocketHandle kInvalidSocket = INVALID_SOCKET;
+constexpr int kSendFlags = 0;
+
+void closeSocket(SocketHandle socket) {
+    closesocket(socket);
+}
+
+int lastError() {
+    return WSAGetLastError();
+}
+
+bool wouldBlock(int error) {
+    return error == WSAEWOULDBLOCK;
+}
+
+bool connecting(int error) {
+    return error == WSAEWOULDBLOCK;
+}
+
+// An ICMP port unreachable for an earlier datagram; the socket stays usable
+bool refused(int error) {
+    return error == WSAECONNRESET;
+}
+#else
+using SocketHandle = int;
+using AddressLength = socklen_t;
+const SocketHandle kInvalidSocket = -1;
+// A sink that goes away must not raise SIGPIPE in the host app
+constexpr int kSendFlags = MSG_NOSIGNAL;
+
+void closeSocket(SocketHandle socket) {
+    ::close(socket);
+}
+
+int lastError() {
+    return errno;
+}
+
+bool wouldBlock(int error) {
+    return error == EAGAIN || error == EWOULDBLOCK;
+}
+
+bool connecting(int error) {
+    return error == EINPROGRESS;
+}
+
+bool refused(int error) {
+    return error == ECONNREFUSED || error == EINTR;
+}
+#endif
+
+// Datagrams start with "WGTT" (load) or "WGTP" (probe), the run's token,
+// the stream, the sequence and the microseconds since the start at which
+// it was sent, big-endian; the rest is padding
+constexpr uint32_t kLoadMagic = 0x57475454;
+constexpr uint32_t kProbeMagic = 0x57475450;
+constexpr size_t kHeaderSize = 24;
+constexpr uint32_t kMaxDatagram = 65507;
+
+constexpr uint32_t kMaxStreams = 16;
+constexpr int kSocketBuffer = 1 << 20;
+constexpr size_t kChunk = 64 * 1024;
+// Bytes moved per stream in one callback before the others get a turn
+constexpr uint64_t kBurst = 1 << 20;
+constexpr std::chrono::milliseconds kPaceTick{5};
+
+void putWord(uint8_t* out, uint32_t value) {
+    value = htonl(value);
+    std::memcpy(out, &value, sizeof(value));
+}
+
+uint32_t getWord(const uint8_t* in) {
+    uint32_t value;
+    std::memcpy(&value, in, sizeof(value));
+    return ntohl(value);
+}
+
+void putHeader(uint8_t* out, uint32_t magic, uint32_t token, uint32_t stream, uint32_t sequence, int64_t sentUs) {
+    auto sent = static_cast<uint64_t>(sentUs);
+    putWord(out, magic);
+    putWord(out + 4, token);
+    putWord(out + 8, stream);
+    putWord(out + 12, sequence);
+    putWord(out + 16, static_cast<uint32_t>(sent >> 32));
+    putWord(out + 20, static_cast<uint32_t>(sent));
+}
+
+int64_t getSentUs(const uint8_t* in) {
+    return static_cast<int64_t>((static_cast<uint64_t>(getWord(in + 16)) << 32) | getWord(in + 20));
+}
+
+bool resolve(const std::string& endpoint, int type, sockaddr_storage& address, AddressLength& length) {
+    std::string host;
+    std::string port;
+    if (!WgQuickConfig::splitEndpoint(endpoint, host, port)) {
+        return false;
+    }
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = type;
+    hints.ai_flags = AI_ADDRCONFIG;
+    addrinfo* results = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &results) != 0) {
+        return false;
+    }
+    bool found = false;
+    for (addrinfo* info = results; info != nullptr; info = info->ai_next) {
+        if ((info->ai_family == AF_INET || info->ai_family == AF_INET6) && info->ai_addrlen <= sizeof(address)) {
+            std::memcpy(&address, info->ai_addr, info->ai_addrlen);
+            length = static_cast<AddressLength>(info->ai_addrlen);
+            found = true;
+            break;
+        }
+    }
+    freeaddrinfo(results);
+    return found;
+}
+
+double seconds(ThroughputTest::Clock::duration duration) {
+    return std::chrono::duration<double>(duration).count();
+}
+
+} // namespace
+
+struct ThroughputTest::Socket {
+    SocketHandle handle = kInvalidSocket;
+    EventLoop::Waitable waitable{};
+    EventLoop::TaskId wait = 0;
+};
+
+struct ThroughputTest::Stream : ThroughputTest::Socket {
+    uint32_t index = 0;
+    bool connected = false;
+    bool failed = false;
+    // Failed, or ended by the server
+    bool closed = false;
+    // Bytes moved, or echoed under UDP, and those counted since the warmup
+    uint64_t total = 0;
+    uint64_t counted = 0;
+    // UDP only
+    uint32_t sequence = 0;
+    double credit = 0;
+    uint64_t sentCounted = 0;
+    uint64_t echoedCounted = 0;
+};
+
+std::shared_ptr<ThroughputTest> ThroughputTest::start(EventLoop& loop, const std::string& endpoint,
+                                                      const Options& options, Progress progress) {
+    auto test = std::make_shared<ThroughputTest>(loop, options, std::move(progress));
+    if (!test->open(endpoint)) {
+        return nullptr;
+    }
+    loop.post([test] { test->begin(); });
+    return test;
+}
+
+bool ThroughputTest::prepare(Socket& socket, long events) {
+#ifdef _WIN32
+    socket.waitable = WSACreateEvent();
+    if (socket.waitable == WSA_INVALID_EVENT) {
+        socket.waitable = nullptr;
+        return false;
+    }
+    return WSAEventSelect(socket.handle, socket.waitable, events) == 0;
+#else
+    (void)events;
+    socket.waitable = socket.handle;
+    return fcntl(socket.handle, F_SETFL, fcntl(socket.handle, F_GETFL) | O_NONBLOCK) == 0;
+#endif
+}
+
+void ThroughputTest::release(Socket& socket) {
+    if (socket.handle != kInvalidSocket) {
+        closeSocket(socket.handle);
+        socket.handle = kInvalidSocket;
+    }
+#ifdef _WIN32
+    if (socket.waitable != nullptr) {
+        WSACloseEvent(socket.waitable);
+        socket.waitable = nullptr;
+    }
+#endif
+}
+
+double ThroughputTest::fairness(const std::vector<double>& values) {
+    double sum = 0;
+    double squares = 0;
+    for (double value : values) {
+        sum += value;
+        squares += value * value;
+    }
+    if (values.empty() || squares <= 0) {
+        return 0;
+    }
+    return sum * sum / (static_cast<double>(values.size()) * squares);
+}
+
+ThroughputTest::ThroughputTest(EventLoop& loop, const Options& options, Progress progress)
+    : loop_(loop), options_(options), progress_(std::move(progress)) {
+    options_.streams = std::clamp<uint32_t>(options_.streams, 1, kMaxStreams);
+    options_.datagramSize = std::clamp<uint32_t>(options_.datagramSize, kHeaderSize, kMaxDatagram);
+    options_.duration = std::max(options_.duration, std::chrono::milliseconds(1));
+    options_.warmup = std::min(options_.warmup, options_.duration / 2);
+    payload_.assign(std::max<size_t>(kChunk, options_.datagramSize), 0x5a);
+}
+
+ThroughputTest::~ThroughputTest() {
+    // Only runs once no loop callback holds the test, so the loop is not
+    // touched here
+    std::vector<Socket*> sockets;
+    for (auto& stream : streams_) {
+        sockets.push_back(stream.get());
+    }
+    if (probe_) {
+        sockets.push_back(probe_.get());
+    }
+    for (Socket* socket : sockets) {
+        release(*socket);
+    }
+#ifdef _WIN32
+    if (winsock_) {
+        WSACleanup();
+    }
+#endif
+}
+
+bool ThroughputTest::open(const std::string& endpoint) {
+#ifdef _WIN32
+    WSADATA wsaData;
+    winsock_ = WSAStartup(MAKEWORD(2, 2), &wsaData) == 0;
+    if (!winsock_) {
+        return false;
+    }
+#endif
+    std::random_device random;
+    token_ = random();
+    // Until begin() runs, e.g. for a test cancelled right away
+    startedAt_ = Clock::now();
+
+    bool tcp = options_.protocol == Protocol::Tcp;
+    sockaddr_storage address{};
+    AddressLength length = 0;
+    if (!resolve(endpoint, tcp ? SOCK_STREAM : SOCK_DGRAM, address, length)) {
+        WG_LOG_WARN("ThroughputTest: Could not resolve {}", endpoint);
+        return false;
+    }
+
+    for (uint32_t index = 0; index < options_.streams; index++) {
+        auto stream = std::make_unique<Stream>();
+        stream->index = index;
+        stream->handle = ::socket(address.ss_family, tcp ? SOCK_STREAM : SOCK_DGRAM, tcp ? IPPROTO_TCP : IPPROTO_UDP);
+        if (stream->handle == kInvalidSocket) {
+            WG_LOG_WARN("ThroughputTest: Could not open a socket. Error: {}", lastError());
+            continue;
+        }
+        if (!tcp) {
+            int buffer = kSocketBuffer;
+            setsockopt(stream->handle, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<const char*>(&buffer), sizeof(buffer));
+            setsockopt(stream->handle, SOL_SOCKET, SO_SNDBUF, reinterpret_cast<const char*>(&buffer), sizeof(buffer));
+        }
+#ifdef _WIN32
+        long events = tcp ? FD_CONNECT | FD_READ | FD_WRITE | FD_CLOSE : FD_READ;
+#else
+        long events = 0;
+#endif
+        // Selected before connecting, so the connect is reported
+        bool ready = prepare(*stream, events);
+        if (ready && connect(stream->handle, reinterpret_cast<const sockaddr*>(&address), length) == 0) {
+            stream->connected = true;
+        } else if (!ready || !connecting(lastError())) {
+            WG_LOG_WARN("ThroughputTest: Could not connect stream {}. Error: {}", index, lastError());
+            release(*stream);
+            continue;
+        }
+        streams_.push_back(std::move(stream));
+    }
+    if (streams_.empty()) {
+        return false;
+    }
+
+    // Under UDP the load itself carries the timestamps
+    if (tcp && !options_.latencyEndpoint.empty()) {
+        sockaddr_storage probeAddress{};
+        AddressLength probeLength = 0;
+        auto probe = std::make_unique<Socket>();
+        if (!resolve(options_.latencyEndpoint, SOCK_DGRAM, probeAddress, probeLength)) {
+            WG_LOG_WARN("ThroughputTest: Could not resolve {}", options_.latencyEndpoint);
+        } else if ((probe->handle = ::socket(probeAddress.ss_family, SOCK_DGRAM, IPPROTO_UDP)) != kInvalidSocket) {
+#ifdef _WIN32
+            long events = FD_READ;
+#else
+            long events = 0;
+#endif
+            if (prepare(*probe, events) &&
+                connect(probe->handle, reinterpret_cast<const sockaddr*>(&probeAddress), probeLength) == 0) {
+                probe_ = std::move(probe);
+            }
+        }
+        // Round trips are left out when the probe could not be set up
+        if (probe) {
+            release(*probe);
+        }
+    }
+    return true;
+}
+
+void ThroughputTest::begin() {
+    if (finished_) {
+        return;
+    }
+    startedAt_ = Clock::now();
+    lastPace_ = startedAt_;
+    lastReport_ = startedAt_;
+    loading_ = true;
+
+    auto self = shared_from_this();
+    for (auto& stream : streams_) {
+        watch(*stream);
+    }
+    if (options_.protocol == Protocol::Udp) {
+        paceTimer_ = loop_.addRepeatingTimer(kPaceTick, [self] { self->pace(); });
+        pace();
+    }
+    if (probe_) {
+        watchProbes();
+        probeTimer_ = loop_.addRepeatingTimer(options_.probeInterval, [self] { self->sendProbe(); });
+        sendProbe();
+    }
+    reportTimer_ = loop_.addRepeatingTimer(options_.interval, [self] { self->report(); });
+    endTimer_ = loop_.addTimer(options_.duration, [self] { self->endLoad(); });
+}
+
+void ThroughputTest::watch(Stream& stream) {
+    auto self = shared_from_this();
+    Stream* target = &stream;
+    auto callback = [self, target] { self->onReady(*target); };
+    // A connect in progress completes as writable
+    bool writable = !stream.connected ||
+                    (options_.protocol == Protocol::Tcp && options_.direction == Direction::Upload);
+    stream.wait = writable ? loop_.addWriteWait(stream.waitable, callback) : loop_.addWait(stream.waitable, callback);
+    if (stream.wait == 0) {
+        fail(stream, 0);
+    }
+}
+
+void ThroughputTest::onReady(Stream& stream) {
+    stream.wait = 0;
+    if (finished_ || stream.closed) {
+        return;
+    }
+#ifdef _WIN32
+    // Resets the event before reading, so data arriving after the last
+    // read signals it again
+    WSANETWORKEVENTS events{};
+    WSAEnumNetworkEvents(stream.handle, stream.waitable, &events);
+    if ((events.lNetworkEvents & FD_CONNECT) != 0) {
+        if (events.iErrorCode[FD_CONNECT_BIT] != 0) {
+            fail(stream, events.iErrorCode[FD_CONNECT_BIT]);
+            return;
+        }
+        stream.connected = true;
+    }
+#else
+    if (!stream.connected) {
+        int error = 0;
+        socklen_t length = sizeof(error);
+        getsockopt(stream.handle, SOL_SOCKET, SO_ERROR, &error, &length);
+        if (error != 0) {
+            fail(stream, error);
+            return;
+        }
+        stream.connected = true;
+    }
+#endif
+    if (!stream.connected) {
+        watch(stream);
+        return;
+    }
+    if (options_.protocol == Protocol::Tcp && options_.direction == Direction::Upload) {
+        fill(stream);
+    } else {
+        drainReads(stream, Clock::now());
+        if (!stream.closed) {
+            watch(stream);
+        }
+    }
+}
+
+void ThroughputTest::fill(Stream& stream) {
+    if (!loading_) {
+        return;
+    }
+    bool counting = Clock::now() - startedAt_ >= options_.warmup;
+    uint64_t moved = 0;
+    while (moved < kBurst) {
+        auto sent = send(stream.handle, reinterpret_cast<const char*>(payload_.data()), static_cast<int>(kChunk),
+                         kSendFlags);
+        if (sent > 0) {
+            auto bytes = static_cast<uint64_t>(sent);
+            moved += bytes;
+            stream.total += bytes;
+            stream.counted += counting ? bytes : 0;
+            continue;
+        }
+        int error = lastError();
+        if (sent < 0 && wouldBlock(error)) {
+            watch(stream);
+            return;
+        }
+        fail(stream, error);
+        return;
+    }
+    // Still writable; Windows would not signal that again, so come back
+    // after whatever else is due
+    auto self = shared_from_this();
+    Stream* target = &stream;
+    loop_.post([self, target] { self->onReady(*target); });
+}
+
+void ThroughputTest::drainReads(Stream& stream, Clock::time_point now) {
+    bool tcp = options_.protocol == Protocol::Tcp;
+    bool counting = loading_ && now - startedAt_ >= options_.warmup;
+    auto nowUs = std::chrono::duration_cast<std::chrono::microseconds>(now - startedAt_).count();
+    auto warmupUs = std::chrono::duration_cast<std::chrono::microseconds>(options_.warmup).count();
+    auto durationUs = std::chrono::duration_cast<std::chrono::microseconds>(options_.duration).count();
+    uint64_t moved = 0;
+    while (moved < kBurst) {
+        auto length = recv(stream.handle, reinterpret_cast<char*>(payload_.data()), static_cast<int>(payload_.size()),
+                           0);
+        if (length < 0) {
+            int error = lastError();
+            if (!tcp && refused(error)) {
+                continue;
+            }
+            if (!wouldBlock(error)) {
+                fail(stream, error);
+            }
+            return;
+        }
+        if (length == 0 && tcp) {
+            // The server ended the stream
+            stream.closed = true;
+            endIfIdle();
+            return;
+        }
+        auto bytes = static_cast<uint64_t>(length);
+        moved += bytes;
+        if (tcp) {
+            stream.total += bytes;
+            stream.counted += counting ? bytes : 0;
+            continue;
+        }
+
+        const uint8_t* datagram = payload_.data();
+        if (bytes != options_.datagramSize || getWord(datagram) != kLoadMagic || getWord(datagram + 4) != token_ ||
+            getWord(datagram + 8) != stream.index) {
+            continue;
+        }
+        int64_t sentUs = getSentUs(datagram);
+        if (sentUs < 0 || sentUs > nowUs) {
+            continue;
+        }
+        stream.total += bytes;
+        recordRtt(nowUs - sentUs);
+        // Goodput and loss cover what was sent after the warmup, whenever
+        // its echo arrives
+        if (sentUs >= warmupUs && sentUs < durationUs) {
+            stream.counted += bytes;
+            stream.echoedCounted++;
+        }
+    }
+}
+
+void ThroughputTest::fail(Stream& stream, int error) {
+    if (stream.closed) {
+        return;
+    }
+    WG_LOG_WARN("ThroughputTest: Stream {} failed. Error: {}", stream.index, error);
+    stream.failed = !stream.connected;
+    stream.closed = true;
+    if (stream.wait != 0) {
+        loop_.cancel(stream.wait);
+        stream.wait = 0;
+    }
+    endIfIdle();
+}
+
+void ThroughputTest::endIfIdle() {
+    if (!loading_ ||
+        std::any_of(streams_.begin(), streams_.end(), [](const std::unique_ptr<Stream>& stream) {
+            return !stream->closed;
+        })) {
+        return;
+    }
+    bool anyConnected = std::any_of(streams_.begin(), streams_.end(),
+                                    [](const std::unique_ptr<Stream>& stream) { return stream->connected; });
+    if (!anyConnected) {
+        finish("no stream connected");
+        return;
+    }
+    endLoad();
+}
+
+void ThroughputTest::pace() {
+    if (!loading_) {
+        return;
+    }
+    auto now = Clock::now();
+    double budget = static_cast<double>(options_.rateBps) / 8.0 * seconds(now - lastPace_);
+    lastPace_ = now;
+    // A late tick catches up a little, not with one large burst
+    double size = options_.datagramSize;
+    double limit = std::max(size, static_cast<double>(options_.rateBps) / 8.0 * seconds(kPaceTick) * 4);
+    auto nowUs = std::chrono::duration_cast<std::chrono::microseconds>(now - startedAt_).count();
+    bool counting = now - startedAt_ >= options_.warmup;
+
+    for (auto& stream : streams_) {
+        if (stream->closed) {
+            continue;
+        }
+        stream->credit = std::min(stream->credit + budget, limit);
+        while (stream->credit >= size) {
+            putHeader(payload_.data(), kLoadMagic, token_, stream->index, stream->sequence, nowUs);
+            auto sent = send(stream->handle, reinterpret_cast<const char*>(payload_.data()),
+                             static_cast<int>(options_.datagramSize), kSendFlags);
+            if (sent < 0) {
+                int error = lastError();
+                if (wouldBlock(error) || refused(error)) {
+                    // Dropped here rather than queued
+                    break;
+                }
+                fail(*stream, error);
+                break;
+            }
+            stream->credit -= size;
+            stream->sequence++;
+            stream->sentCounted += counting ? 1 : 0;
+        }
+    }
+}
+
+void ThroughputTest::sendProbe() {
+    if (!loading_ || !probe_) {
+        return;
+    }
+    uint8_t probe[kHeaderSize];
+    auto nowUs = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - startedAt_).count();
+    putHeader(probe, kProbeMagic, token_, 0, probeSequence_++, nowUs);
+    auto sent = send(probe_->handle, reinterpret_cast<const char*>(probe), static_cast<int>(kHeaderSize), kSendFlags);
+    if (sent == static_cast<decltype(sent)>(kHeaderSize)) {
+        probesSent_++;
+    }
+}
+
+void ThroughputTest::watchProbes() {
+    auto self = shared_from_this();
+    probe_->wait = loop_.addWait(probe_->waitable, [self] { self->receiveProbes(); });
+}
+
+void ThroughputTest::receiveProbes() {
+    probe_->wait = 0;
+    if (finished_) {
+        return;
+    }
+#ifdef _WIN32
+    WSANETWORKEVENTS events;
+    WSAEnumNetworkEvents(probe_->handle, probe_->waitable, &events);
+#endif
+    auto nowUs = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - startedAt_).count();
+    uint8_t buffer[64];
+    for (;;) {
+        auto length = recv(probe_->handle, reinterpret_cast<char*>(buffer), static_cast<int>(sizeof(buffer)), 0);
+        if (length < 0) {
+            if (refused(lastError())) {
+                continue;
+            }
+            break;
+        }
+        if (length != static_cast<decltype(length)>(kHeaderSize) || getWord(buffer) != kProbeMagic ||
+            getWord(buffer + 4) != token_ || getWord(buffer + 12) >= probeSequence_) {
+            continue;
+        }
+        int64_t sentUs = getSentUs(buffer);
+        if (sentUs >= 0 && sentUs <= nowUs) {
+            recordRtt(nowUs - sentUs);
+            probesEchoed_++;
+        }
+    }
+    watchProbes();
+}
+
+void ThroughputTest::recordRtt(int64_t rttUs) {
+    rtt_.record(rttUs);
+    rttMinUs_ = rttMinUs_ < 0 ? rttUs : std::min(rttMinUs_, rttUs);
+}
+
+void ThroughputTest::report() {
+    if (finished_ || !progress_) {
+        return;
+    }
+    progress_(makeReport(Clock::now()));
+}
+
+void ThroughputTest::endLoad() {
+    if (!loading_) {
+        return;
+    }
+    loading_ = false;
+    for (EventLoop::TaskId* timer : {&paceTimer_, &probeTimer_, &reportTimer_, &endTimer_}) {
+        if (*timer != 0) {
+            loop_.cancel(*timer);
+            *timer = 0;
+        }
+    }
+    // TCP has nothing in flight worth waiting for
+    if (options_.protocol == Protocol::Tcp && !probe_) {
+        finish(std::string());
+        return;
+    }
+    for (auto& stream : streams_) {
+        if (options_.protocol == Protocol::Tcp && stream->wait != 0) {
+            loop_.cancel(stream->wait);
+            stream->wait = 0;
+        }
+    }
+    auto self = shared_from_this();
+    endTimer_ = loop_.addTimer(options_.drain, [self] { self->finish(std::string()); });
+}
+
+void ThroughputTest::cancel() {
+    auto self = shared_from_this();
+    loop_.post([self] { self->finish("cancelled"); });
+}
+
+void ThroughputTest::finish(const std::string& error) {
+    if (finished_) {
+        return;
+    }
+    auto now = Clock::now();
+    Report final = makeReport(now);
+    final.done = true;
+    final.error = error;
+    finished_ = true;
+    loading_ = false;
+
+    for (EventLoop::TaskId* timer : {&paceTimer_, &probeTimer_, &reportTimer_, &endTimer_}) {
+        if (*timer != 0) {
+            loop_.cancel(*timer);
+            *timer = 0;
+        }
+    }
+    // Closed now rather than when the last reference goes, which may be
+    // the caller's
+    std::vector<Socket*> sockets;
+    for (auto& stream : streams_) {
+        sockets.push_back(stream.get());
+    }
+    if (probe_) {
+        sockets.push_back(probe_.get());
+    }
+    for (Socket* socket : sockets) {
+        if (socket->wait != 0) {
+            loop_.cancel(socket->wait);
+            socket->wait = 0;
+        }
+        release(*socket);
+    }
+
+    Progress progress = std::move(progress_);
+    if (progress) {
+        progress(final);
+    }
+}
+
+ThroughputTest::Report ThroughputTest::makeReport(Clock::time_point now) {
+    Report report;
+    auto elapsed = std::min(now - startedAt_, Clock::duration(options_.duration));
+    report.elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed);
+    double measured = seconds(elapsed - options_.warmup);
+
+    uint64_t total = 0;
+    uint64_t sentCounted = 0;
+    uint64_t echoedCounted = 0;
+    std::vector<double> connected;
+    for (const auto& stream : streams_) {
+        double bps = measured > 0 ? static_cast<double>(stream->counted) * 8.0 / measured : 0;
+        report.streamBps.push_back(bps);
+        report.bytes += stream->counted;
+        total += stream->total;
+        sentCounted += stream->sentCounted;
+        echoedCounted += stream->echoedCounted;
+        if (stream->connected) {
+            report.connected++;
+            connected.push_back(bps);
+        }
+        report.failed += stream->failed ? 1 : 0;
+    }
+    // Streams that never opened count as failed too
+    report.failed += options_.streams - static_cast<uint32_t>(streams_.size());
+    report.goodputBps = measured > 0 ? static_cast<double>(report.bytes) * 8.0 / measured : 0;
+    report.fairness = fairness(connected);
+
+    double interval = seconds(now - lastReport_);
+    if (interval > 0) {
+        report.intervalBps = static_cast<double>(total - lastReportBytes_) * 8.0 / interval;
+    }
+    lastReport_ = now;
+    lastReportBytes_ = total;
+
+    report.rttSamples = rtt_.count();
+    if (report.rttSamples > 0) {
+        report.rttMinUs = rttMinUs_;
+        report.rttP50Us = rtt_.percentile(50);
+        report.rttP90Us = rtt_.percentile(90);
+        report.rttP99Us = rtt_.percentile(99);
+    }
+
+    // Echoes still on their way would count as lost before the end
+    if (finished_ || !loading_) {
+        uint64_t sent = options_.protocol == Protocol::Udp ? sentCounted : probesSent_;
+        uint64_t echoed = options_.protocol == Protocol::Udp ? echoedCounted : probesEchoed_;
+        if (sent > 0) {
+            report.loss = 1.0 - static_cast<double>(std::min(echoed, sent)) / static_cast<double>(sent);
+        }
+    }
+    return report;
+}
+
+} // namespace wireguard_flutter
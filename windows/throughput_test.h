@@ -0,0 +1,167 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "event_loop.h"
+#include "latency_histogram.h"
+
+namespace wireguard_flutter {
+
+// Measures goodput, fairness between streams and latency under load to a
+// test server, e.g. one inside the tunnel, so "the VPN is slow" can be put
+// in numbers.
+//
+// Several parallel streams run at once, all as waits and timers on one
+// EventLoop, with no thread per stream. TCP streams upload to a sink that
+// discards what it reads, or download from a server that sends as soon as
+// a connection is accepted. Bytes are counted from the end of the warmup,
+// so slow start does not weigh in; an upload counts what the stack took,
+// which matches what left once its send buffer stays full. UDP streams are
+// paced at a fixed rate to an echo responder, and the datagrams that come
+// back give goodput, loss and round trips in one. Under TCP, round trips
+// come from small timestamped probes to an echo responder, when one is
+// given.
+//
+// A report goes to |progress| every interval and a final one when the test
+// ends, always on the loop thread. Names are resolved by start() on the
+// calling thread. Portable.
+class ThroughputTest : public std::enable_shared_from_this<ThroughputTest> {
+public:
+    using Clock = std::chrono::steady_clock;
+    // Microseconds, up to about 16 s
+    using RttHistogram = BasicLatencyHistogram<24>;
+
+    enum class Protocol : uint8_t { Tcp, Udp };
+    enum class Direction : uint8_t { Upload, Download };
+
+    struct Options {
+        Protocol protocol = Protocol::Tcp;
+        // TCP only; UDP always goes there and back
+        Direction direction = Direction::Upload;
+        uint32_t streams = 4;
+        std::chrono::milliseconds duration{10000};
+        // Not counted towards goodput
+        std::chrono::milliseconds warmup{1000};
+        std::chrono::milliseconds interval{500};
+        // How long echoes are awaited after the last datagram or probe
+        std::chrono::milliseconds drain{1000};
+        // Per UDP stream, in bits per second
+        uint64_t rateBps = 10000000;
+        uint32_t datagramSize = 1200;
+        // UDP echo responder probed under TCP load, e.g. "10.0.0.1:7";
+        // empty for no round trips
+        std::string latencyEndpoint;
+        std::chrono::milliseconds probeInterval{100};
+    };
+
+    struct Report {
+        // The final report; nothing follows it
+        bool done = false;
+        std::chrono::milliseconds elapsed{0};
+        // Counted since the warmup, over all streams
+        uint64_t bytes = 0;
+        // In bits per second; 0 during the warmup
+        double goodputBps = 0;
+        // Everything moved during the latest interval, warmup included
+        double intervalBps = 0;
+        std::vector<double> streamBps;
+        // Jain's index over the streams that connected: 1 for an even
+        // split, 1/n when one takes everything
+        double fairness = 0;
+        uint32_t connected = 0;
+        uint32_t failed = 0;
+        uint64_t rttSamples = 0;
+        // -1 without samples
+        int64_t rttMinUs = -1;
+        int64_t rttP50Us = -1;
+        int64_t rttP90Us = -1;
+        int64_t rttP99Us = -1;
+        // Share of datagrams or probes not echoed, 0 to 1; -1 unknown
+        double loss = -1;
+        // Why the test stopped early, e.g. "cancelled"
+        std::string error;
+    };
+
+    using Progress = std::function<void(const Report&)>;
+
+    // Starts a test of |endpoint| ("host:port") on |loop|; nullptr when it
+    // does not resolve or no socket could be opened, in which case
+    // |progress| is not called. The test keeps itself alive until it ends.
+    static std::shared_ptr<ThroughputTest> start(EventLoop& loop, const std::string& endpoint,
+                                                 const Options& options, Progress progress);
+
+    // Jain's fairness index of |values|; 0 when they are all zero
+    static double fairness(const std::vector<double>& values);
+
+    ThroughputTest(EventLoop& loop, const Options& options, Progress progress);
+    ~ThroughputTest();
+
+    ThroughputTest(const ThroughputTest&) = delete;
+    ThroughputTest& operator=(const ThroughputTest&) = delete;
+
+    // Ends the test with a final report; thread-safe
+    void cancel();
+    bool finished() const { return finished_.load(); }
+
+private:
+    struct Stream;
+    struct Socket;
+
+    // Non-blocking, and on Windows signaling |events| on its own event
+    static bool prepare(Socket& socket, long events);
+    static void release(Socket& socket);
+
+    bool open(const std::string& endpoint);
+    void begin();
+    void watch(Stream& stream);
+    void onReady(Stream& stream);
+    void fill(Stream& stream);
+    void drainReads(Stream& stream, Clock::time_point now);
+    void fail(Stream& stream, int error);
+    // Ends the load early once every stream is closed
+    void endIfIdle();
+    void pace();
+    void sendProbe();
+    void watchProbes();
+    void receiveProbes();
+    void recordRtt(int64_t rttUs);
+    void report();
+    void endLoad();
+    void finish(const std::string& error);
+    Report makeReport(Clock::time_point now);
+
+    EventLoop& loop_;
+    Options options_;
+    Progress progress_;
+
+    std::vector<std::unique_ptr<Stream>> streams_;
+    std::unique_ptr<Socket> probe_;
+    std::vector<uint8_t> payload_;
+    uint32_t token_ = 0;
+    Clock::time_point startedAt_;
+    Clock::time_point lastPace_;
+    Clock::time_point lastReport_;
+    uint64_t lastReportBytes_ = 0;
+    bool loading_ = false;
+    std::atomic<bool> finished_{false};
+    bool winsock_ = false;
+
+    EventLoop::TaskId paceTimer_ = 0;
+    EventLoop::TaskId probeTimer_ = 0;
+    EventLoop::TaskId reportTimer_ = 0;
+    EventLoop::TaskId endTimer_ = 0;
+
+    RttHistogram rtt_;
+    int64_t rttMinUs_ = -1;
+    uint32_t probeSequence_ = 0;
+    uint64_t probesSent_ = 0;
+    uint64_t probesEchoed_ = 0;
+};
+
+} // namespace wireguard_flutter
@@ -0,0 +1,98 @@
+#include "timer_wheel.h"
+
+#include <algorithm>
+
+namespace wireguard_flutter {
+
+TimerWheel::TimerWheel(Clock::time_point origin, std::chrono::milliseconds tick, size_t slots)
+    : origin_(origin), tick_(std::max(tick, std::chrono::milliseconds(1))), slots_(std::max<size_t>(slots, 1)) {}
+
+int64_t TimerWheel::tickOf(Clock::time_point time) const {
+    if (time <= origin_) {
+        return 0;
+    }
+    return static_cast<int64_t>((time - origin_) / tick_);
+}
+
+int64_t TimerWheel::deadlineTick(Clock::time_point deadline) const {
+    if (deadline <= origin_) {
+        return 0;
+    }
+    auto elapsed = deadline - origin_;
+    auto ticks = static_cast<int64_t>(elapsed / tick_);
+    // Round up so the timer cannot fire before its deadline
+    if (elapsed % tick_ != Clock::duration::zero()) {
+        ticks++;
+    }
+    return ticks;
+}
+
+void TimerWheel::add(uint64_t id, Clock::time_point deadline) {
+    // Anything already due goes into the next slot advance() looks at
+    int64_t tick = std::max(deadlineTick(deadline), currentTick_ + 1);
+    timers_[id] = Timer{deadline, tick};
+    slots_[static_cast<size_t>(tick % static_cast<int64_t>(slots_.size()))].push_back(SlotEntry{id, tick});
+}
+
+bool TimerWheel::remove(uint64_t id) {
+    // The slot entry is dropped lazily when its slot comes round
+    return timers_.erase(id) != 0;
+}
+
+void TimerWheel::collect(std::vector<SlotEntry>& slot, int64_t nowTick, std::vector<uint64_t>& expired) {
+    for (size_t i = 0; i < slot.size();) {
+        auto timer = timers_.find(slot[i].id);
+        bool stale = timer == timers_.end() || timer->second.tick != slot[i].tick;
+        bool due = !stale && slot[i].tick <= nowTick;
+        if (stale || due) {
+            if (due) {
+                expired.push_back(slot[i].id);
+            }
+            slot[i] = slot.back();
+            slot.pop_back();
+        } else {
+            i++;
+        }
+    }
+}
+
+void TimerWheel::advance(Clock::time_point now, std::vector<uint64_t>& expired) {
+    expired.clear();
+    int64_t nowTick = tickOf(now);
+    if (nowTick <= currentTick_) {
+        return;
+    }
+
+    // After a full turn every slot has been visited once
+    int64_t slotCount = static_cast<int64_t>(slots_.size());
+    int64_t last = std::min(nowTick, currentTick_ + slotCount);
+    for (int64_t tick = currentTick_ + 1; tick <= last; tick++) {
+        collect(slots_[static_cast<size_t>(tick % slotCount)], nowTick, expired);
+    }
+    currentTick_ = nowTick;
+
+    std::sort(expired.begin(), expired.end(), [this](uint64_t a, uint64_t b) {
+        const auto& left = timers_.at(a);
+        const auto& right = timers_.at(b);
+        return left.deadline != right.deadline ? left.deadline < right.deadline : a < b;
+    });
+    for (uint64_t id : expired) {
+        timers_.erase(id);
+    }
+}
+
+TimerWheel::Clock::time_point TimerWheel::nextExpiry() const {
+    // A linear scan; the plugin keeps a handful of timers
+    int64_t next = -1;
+    for (const auto& entry : timers_) {
+        if (next < 0 || entry.second.tick < next) {
+            next = entry.second.tick;
+        }
+    }
+    if (next < 0) {
+        return Clock::time_point::max();
+    }
+    return origin_ + next * tick_;
+}
+
+} // namespace wireguard_flutter
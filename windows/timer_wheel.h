@@ -0,0 +1,63 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace wireguard_flutter {
+
+// Hashed timing wheel keyed by timer id.
+//
+// Deadlines are rounded up to whole ticks, so a timer never fires early and
+// at most one tick late. Timers that expire together are returned ordered by
+// deadline and then id, which keeps callback order deterministic. Not
+// synchronized; the event loop owns it. Portable; no Windows dependencies.
+class TimerWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr std::chrono::milliseconds kDefaultTick{10};
+    static constexpr size_t kDefaultSlots = 256;
+
+    explicit TimerWheel(Clock::time_point origin = Clock::now(), std::chrono::milliseconds tick = kDefaultTick,
+                        size_t slots = kDefaultSlots);
+
+    // Schedules |id|, replacing any earlier deadline for it.
+    void add(uint64_t id, Clock::time_point deadline);
+    bool remove(uint64_t id);
+    bool contains(uint64_t id) const { return timers_.count(id) != 0; }
+    size_t size() const { return timers_.size(); }
+
+    // Moves every timer due at |now| into |expired|, which is cleared first.
+    void advance(Clock::time_point now, std::vector<uint64_t>& expired);
+
+    // Earliest time at which advance() returns something, or
+    // Clock::time_point::max() when no timer is pending.
+    Clock::time_point nextExpiry() const;
+
+private:
+    struct Timer {
+        Clock::time_point deadline;
+        int64_t tick;
+    };
+
+    struct SlotEntry {
+        uint64_t id;
+        int64_t tick;
+    };
+
+    int64_t tickOf(Clock::time_point time) const;
+    int64_t deadlineTick(Clock::time_point deadline) const;
+    void collect(std::vector<SlotEntry>& slot, int64_t nowTick, std::vector<uint64_t>& expired);
+
+    Clock::time_point origin_;
+    std::chrono::milliseconds tick_;
+    int64_t currentTick_ = 0;
+
+    std::vector<std::vector<SlotEntry>> slots_;
+    std::unordered_map<uint64_t, Timer> timers_;
+};
+
+} // namespace wireguard_flutter
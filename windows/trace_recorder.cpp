@@ -0,0 +1,265 @@
+#include "trace_recorder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace wireguard_flutter {
+
+namespace {
+
+enum Word : size_t { Category, Name, Timestamp, Duration, ArgName, ArgValue, Packed, Label };
+
+std::atomic<uint32_t> nextThread{1};
+
+uint64_t fromPointer(const char* value) {
+    return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(value));
+}
+
+const char* toPointer(uint64_t value) {
+    return reinterpret_cast<const char*>(static_cast<uintptr_t>(value));
+}
+
+void writeString(std::ostream& out, std::string_view text) {
+    out << '"';
+    for (char c : text) {
+        switch (c) {
+        case '"':
+            out << "\\\"";
+            break;
+        case '\\':
+            out << "\\\\";
+            break;
+        case '\n':
+            out << "\\n";
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                static const char kHex[] = "0123456789abcdef";
+                out << "\\u00" << kHex[(c >> 4) & 0xF] << kHex[c & 0xF];
+            } else {
+                out << c;
+            }
+        }
+    }
+    out << '"';
+}
+
+} // namespace
+
+TraceRecorder& TraceRecorder::instance() {
+    static TraceRecorder recorder;
+    return recorder;
+}
+
+void TraceRecorder::setEnabled(bool on) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (on && slots_.load(std::memory_order_relaxed) == nullptr) {
+        mask_ = kCapacity - 1;
+        slots_.store(new Slot[kCapacity], std::memory_order_release);
+    }
+    enabled_.store(on, std::memory_order_release);
+}
+
+void TraceRecorder::clear() {
+    base_.store(head_.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+int64_t TraceRecorder::timestampUs(std::chrono::steady_clock::time_point at) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(at.time_since_epoch()).count();
+}
+
+void TraceRecorder::complete(const char* category, const char* name, int64_t startUs, int64_t durationUs,
+                             std::string_view label, const char* argName, int64_t argValue) {
+    if (!enabled()) {
+        return;
+    }
+    Event event;
+    event.category = category;
+    event.name = name;
+    event.phase = 'X';
+    event.timestampUs = startUs;
+    event.durationUs = durationUs;
+    event.argName = argName;
+    event.argValue = argValue;
+    record(event, label);
+}
+
+void TraceRecorder::instant(const char* category, const char* name, std::string_view label,
+                            const char* argName, int64_t argValue) {
+    if (!enabled()) {
+        return;
+    }
+    Event event;
+    event.category = category;
+    event.name = name;
+    event.phase = 'i';
+    event.timestampUs = nowUs();
+    event.argName = argName;
+    event.argValue = argValue;
+    record(event, label);
+}
+
+void TraceRecorder::record(const Event& event, std::string_view label) {
+    Slot* slots = slots_.load(std::memory_order_acquire);
+    if (slots == nullptr) {
+        return;
+    }
+
+    // A writer lapped by the whole ring mid-write could interleave with
+    // another; at thousands of events per lap that is not worth a retry loop
+    uint64_t position = head_.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = slots[position & mask_];
+    slot.state.store(2 * position + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    size_t length = std::min(label.size(), kMaxLabelBytes);
+    std::array<uint64_t, kLabelWords> text{};
+    std::memcpy(text.data(), label.data(), length);
+
+    auto& words = slot.words;
+    words[Category].store(fromPointer(event.category), std::memory_order_relaxed);
+    words[Name].store(fromPointer(event.name), std::memory_order_relaxed);
+    words[Timestamp].store(static_cast<uint64_t>(event.timestampUs), std::memory_order_relaxed);
+    words[Duration].store(static_cast<uint64_t>(event.durationUs), std::memory_order_relaxed);
+    words[ArgName].store(fromPointer(event.argName), std::memory_order_relaxed);
+    words[ArgValue].store(static_cast<uint64_t>(event.argValue), std::memory_order_relaxed);
+    words[Packed].store(static_cast<uint64_t>(static_cast<uint8_t>(event.phase)) |
+                            static_cast<uint64_t>(threadIndex()) << 8 | static_cast<uint64_t>(length) << 40,
+                        std::memory_order_relaxed);
+    for (size_t i = 0; i < kLabelWords; i++) {
+        words[Label + i].store(text[i], std::memory_order_relaxed);
+    }
+
+    slot.state.store(2 * position + 2, std::memory_order_release);
+}
+
+bool TraceRecorder::readSlot(const Slot* slots, uint64_t position, Event& out) const {
+    const Slot& slot = slots[position & mask_];
+    const uint64_t written = 2 * position + 2;
+    if (slot.state.load(std::memory_order_acquire) != written) {
+        return false;
+    }
+
+    std::array<uint64_t, kWords> words;
+    for (size_t i = 0; i < kWords; i++) {
+        words[i] = slot.words[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.state.load(std::memory_order_relaxed) != written) {
+        return false;
+    }
+
+    out.category = toPointer(words[Category]);
+    out.name = toPointer(words[Name]);
+    out.timestampUs = static_cast<int64_t>(words[Timestamp]);
+    out.durationUs = static_cast<int64_t>(words[Duration]);
+    out.argName = toPointer(words[ArgName]);
+    out.argValue = static_cast<int64_t>(words[ArgValue]);
+    out.phase = static_cast<char>(words[Packed] & 0xFF);
+    out.thread = static_cast<uint32_t>(words[Packed] >> 8);
+    size_t length = std::min<size_t>(words[Packed] >> 40, kMaxLabelBytes);
+    out.label.assign(reinterpret_cast<const char*>(&words[Label]), length);
+    return true;
+}
+
+uint32_t TraceRecorder::threadIndex() {
+    thread_local uint32_t index = nextThread.fetch_add(1, std::memory_order_relaxed);
+    return index;
+}
+
+void TraceRecorder::nameThread(const char* name) {
+    auto& recorder = instance();
+    uint32_t thread = threadIndex();
+    std::lock_guard<std::mutex> lock(recorder.mutex_);
+    auto& names = recorder.threadNames_;
+    auto found = std::find_if(names.begin(), names.end(), [thread](const auto& entry) { return entry.first == thread; });
+    if (found != names.end()) {
+        found->second = name;
+    } else {
+        names.emplace_back(thread, name);
+    }
+}
+
+void TraceRecorder::snapshot(std::vector<Event>& out) const {
+    const Slot* slots = slots_.load(std::memory_order_acquire);
+    if (slots == nullptr) {
+        return;
+    }
+    uint64_t head = head_.load(std::memory_order_acquire);
+    uint64_t capacity = mask_ + 1;
+    uint64_t position = std::max(base_.load(std::memory_order_acquire), head > capacity ? head - capacity : 0);
+
+    Event event;
+    for (; position < head; position++) {
+        // Skips slots still being written or already overwritten
+        if (readSlot(slots, position, event)) {
+            out.push_back(event);
+        }
+    }
+}
+
+size_t TraceRecorder::writeJson(std::ostream& out) const {
+    std::vector<Event> events;
+    snapshot(events);
+    std::vector<std::pair<uint32_t, std::string>> threadNames;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        threadNames = threadNames_;
+    }
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    auto separate = [&out, &first]() {
+        out << (first ? "\n" : ",\n");
+        first = false;
+    };
+    for (const auto& thread : threadNames) {
+        separate();
+        out << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << thread.first << ",\"args\":{\"name\":";
+        writeString(out, thread.second);
+        out << "}}";
+    }
+    for (const auto& event : events) {
+        separate();
+        out << "{\"name\":";
+        writeString(out, event.name);
+        out << ",\"cat\":";
+        writeString(out, event.category);
+        out << ",\"ph\":\"" << event.phase << "\",\"ts\":" << event.timestampUs;
+        if (event.phase == 'X') {
+            out << ",\"dur\":" << event.durationUs;
+        } else {
+            out << ",\"s\":\"t\"";
+        }
+        out << ",\"pid\":1,\"tid\":" << event.thread;
+        if (!event.label.empty() || event.argName != nullptr) {
+            out << ",\"args\":{";
+            if (!event.label.empty()) {
+                out << "\"tunnel\":";
+                writeString(out, event.label);
+            }
+            if (event.argName != nullptr) {
+                out << (event.label.empty() ? "" : ",");
+                writeString(out, event.argName);
+                out << ':' << event.argValue;
+            }
+            out << '}';
+        }
+        out << '}';
+    }
+    out << "\n]}\n";
+    return events.size();
+}
+
+bool TraceRecorder::dump(const std::filesystem::path& path, size_t& events) const {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        return false;
+    }
+    events = writeJson(file);
+    file.flush();
+    return static_cast<bool>(file);
+}
+
+} // namespace wireguard_flutter
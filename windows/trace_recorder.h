@@ -0,0 +1,139 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace wireguard_flutter {
+
+// Bounded in-memory recorder of spans and instant events, exported as Chrome
+// trace-event JSON for Perfetto or chrome://tracing.
+//
+// Recording is off until setEnabled(true); while off, a span or event costs
+// one atomic load and the ring is not even allocated. While on, a record
+// claims a position with one fetch_add and writes its slot under a per-slot
+// seqlock, like LogRing, so any thread may record without locking; the
+// oldest events are overwritten once the ring is full. Names, categories and
+// argument names must be string literals or otherwise outlive the recording;
+// labels are copied, up to kMaxLabelBytes. Timestamps are microseconds on
+// the steady clock. One instance per process. Portable.
+class TraceRecorder {
+public:
+    static constexpr size_t kCapacity = 8192;
+    static constexpr size_t kMaxLabelBytes = 24;
+
+    struct Event {
+        const char* category = "";
+        const char* name = "";
+        // 'X' for a span, 'i' for an instant event
+        char phase = 'X';
+        uint32_t thread = 0;
+        int64_t timestampUs = 0;
+        int64_t durationUs = 0;
+        // Shown as "tunnel" in the event's arguments when not empty
+        std::string label;
+        const char* argName = nullptr;
+        int64_t argValue = 0;
+    };
+
+    static TraceRecorder& instance();
+
+    static bool enabled() { return enabled_.load(std::memory_order_acquire); }
+
+    // Allocates the ring on first use; events already recorded are kept
+    void setEnabled(bool on);
+    void clear();
+
+    static int64_t nowUs() { return timestampUs(std::chrono::steady_clock::now()); }
+    static int64_t timestampUs(std::chrono::steady_clock::time_point at);
+
+    // Both return immediately unless enabled
+    void complete(const char* category, const char* name, int64_t startUs, int64_t durationUs,
+                  std::string_view label = {}, const char* argName = nullptr, int64_t argValue = 0);
+    void instant(const char* category, const char* name, std::string_view label = {},
+                 const char* argName = nullptr, int64_t argValue = 0);
+
+    // Names the calling thread in exported traces; cheap enough to call
+    // whether or not recording is on
+    static void nameThread(const char* name);
+
+    // Events still in the ring, oldest first
+    void snapshot(std::vector<Event>& out) const;
+
+    // Writes everything recorded as one JSON object; returns the event count
+    size_t writeJson(std::ostream& out) const;
+    bool dump(const std::filesystem::path& path, size_t& events) const;
+
+private:
+    static constexpr size_t kLabelWords = kMaxLabelBytes / sizeof(uint64_t);
+    static constexpr size_t kWords = 7 + kLabelWords;
+
+    // 0 when never written; 2p+1 while position p is written, 2p+2 after
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> state{0};
+        std::array<std::atomic<uint64_t>, kWords> words{};
+    };
+
+    TraceRecorder() = default;
+
+    void record(const Event& event, std::string_view label);
+    bool readSlot(const Slot* slots, uint64_t position, Event& out) const;
+    static uint32_t threadIndex();
+
+    static inline std::atomic<bool> enabled_{false};
+
+    // Allocated once and never freed, so recorders racing setEnabled(false)
+    // still write into valid memory
+    std::atomic<Slot*> slots_{nullptr};
+    size_t mask_ = 0;
+    std::atomic<uint64_t> head_{0};
+    // Positions below this were cleared
+    std::atomic<uint64_t> base_{0};
+
+    mutable std::mutex mutex_;
+    std::vector<std::pair<uint32_t, std::string>> threadNames_;
+};
+
+// Records the enclosing scope as a span when recording is on at its start.
+// |label| is copied at the end of the scope, so it must outlive the span.
+class TraceSpan {
+public:
+    TraceSpan(const char* category, const char* name, std::string_view label = {})
+        : category_(category), name_(name), label_(label),
+          startUs_(TraceRecorder::enabled() ? TraceRecorder::nowUs() : -1) {}
+
+    ~TraceSpan() {
+        if (startUs_ >= 0) {
+            TraceRecorder::instance().complete(category_, name_, startUs_, TraceRecorder::nowUs() - startUs_,
+                                               label_, argName_, argValue_);
+        }
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    void setArg(const char* name, int64_t value) {
+        argName_ = name;
+        argValue_ = value;
+    }
+
+private:
+    const char* category_;
+    const char* name_;
+    std::string_view label_;
+    int64_t startUs_;
+    const char* argName_ = nullptr;
+    int64_t argValue_ = 0;
+};
+
+} // namespace wireguard_flutter
@@ -0,0 +1,33 @@
+#include "tunnel_managers.h"
+
+#include <utility>
+
+namespace wireguard_flutter {
+
+TunnelManagers::TunnelManagers(EventLoop& loop, EventDispatcher* dispatcher, UsageLedger* ledger,
+                               ConnectTimingStore* timings, ResolverCache* resolver, EndpointRacer::Backend* racer)
+    : loop_(loop), dispatcher_(dispatcher), ledger_(ledger), timings_(timings), resolver_(resolver), racer_(racer) {}
+
+std::unique_ptr<TunnelRegistry::Tunnel> TunnelManagers::create(const std::string& name) {
+    auto tunnel = std::make_unique<WireGuardTunnelManager>(loop_, name);
+    tunnel->setEventDispatcher(dispatcher_);
+    tunnel->setUsageLedger(ledger_);
+    tunnel->setConnectTimingStore(timings_);
+    tunnel->setResolverCache(resolver_);
+    tunnel->setRaceBackend(racer_);
+    return tunnel;
+}
+
+bool TunnelManagers::hasListener() const {
+    return dispatcher_ && dispatcher_->hasListener();
+}
+
+void TunnelManagers::watchNetwork(std::function<void()> changed) {
+    network_.start(std::move(changed));
+}
+
+void TunnelManagers::unwatchNetwork() {
+    network_.stop();
+}
+
+} // namespace wireguard_flutter
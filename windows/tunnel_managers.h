@@ -0,0 +1,51 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "connect_timings.h"
+#include "endpoint_racer.h"
+#include "event_dispatcher.h"
+#include "event_loop.h"
+#include "network_monitor.h"
+#include "resolver_cache.h"
+#include "tunnel_registry.h"
+#include "usage_ledger.h"
+#include "wireguard_tunnel_manager.h"
+
+namespace wireguard_flutter {
+
+// The TunnelRegistry's backend on Windows: WireGuardTunnelManagers wired to
+// the plugin's dispatcher, usage ledger, timing store, endpoint name cache
+// and race adapters, which all outlive it. Network changes come from a
+// NetworkMonitor.
+class TunnelManagers : public TunnelRegistry::Backend {
+public:
+    TunnelManagers(EventLoop& loop, EventDispatcher* dispatcher, UsageLedger* ledger, ConnectTimingStore* timings,
+                   ResolverCache* resolver, EndpointRacer::Backend* racer);
+
+    TunnelManagers(const TunnelManagers&) = delete;
+    TunnelManagers& operator=(const TunnelManagers&) = delete;
+
+    // Every tunnel of a registry on this backend is a manager
+    static WireGuardTunnelManager& manager(TunnelRegistry::Tunnel& tunnel) {
+        return static_cast<WireGuardTunnelManager&>(tunnel);
+    }
+
+    std::unique_ptr<TunnelRegistry::Tunnel> create(const std::string& name) override;
+    bool hasListener() const override;
+    void watchNetwork(std::function<void()> changed) override;
+    void unwatchNetwork() override;
+
+private:
+    EventLoop& loop_;
+    EventDispatcher* dispatcher_;
+    UsageLedger* ledger_;
+    ConnectTimingStore* timings_;
+    ResolverCache* resolver_;
+    EndpointRacer::Backend* racer_;
+    NetworkMonitor network_;
+};
+
+} // namespace wireguard_flutter
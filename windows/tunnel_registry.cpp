@@ -0,0 +1,217 @@
+#include "tunnel_registry.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "stats_block.h"
+#include "trace_recorder.h"
+
+namespace wireguard_flutter {
+
+TunnelRegistry::TunnelRegistry(EventLoop& loop, Backend& backend, ResolverCache* resolver)
+    : loop_(loop), backend_(backend), resolver_(resolver) {
+    backend_.watchNetwork([this]() { noteNetworkChange(); });
+}
+
+TunnelRegistry::~TunnelRegistry() {
+    // No change is reported after this
+    backend_.unwatchNetwork();
+
+    EventLoop::TaskId timers[2];
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        timers[0] = tickTimer_;
+        timers[1] = networkTimer_;
+        tickTimer_ = 0;
+        tickGeneration_++;
+    }
+    // Waits for a running tick before the tunnels go away
+    for (EventLoop::TaskId timer : timers) {
+        if (timer != 0) {
+            loop_.cancel(timer);
+        }
+    }
+    tunnels_.clear();
+}
+
+TunnelRegistry::Tunnel* TunnelRegistry::find(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto tunnel = tunnels_.find(name);
+    return tunnel != tunnels_.end() ? tunnel->second.get() : nullptr;
+}
+
+TunnelRegistry::Tunnel& TunnelRegistry::getOrCreate(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& tunnel = tunnels_[name];
+    if (!tunnel) {
+        tunnel = backend_.create(name);
+        tunnel->configureStatistics(statsOptions_);
+        tunnel->configureReconnect(reconnectOptions_);
+        tunnel->configureKeepalive(adaptiveKeepalive_, keepaliveOptions_);
+        tunnel->configureLatencyProbe(latencyOptions_);
+    }
+    return *tunnel;
+}
+
+std::vector<TunnelRegistry::Tunnel*> TunnelRegistry::tunnels() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<Tunnel*> result;
+    result.reserve(tunnels_.size());
+    for (const auto& entry : tunnels_) {
+        result.push_back(entry.second.get());
+    }
+    return result;
+}
+
+void TunnelRegistry::configureStatistics(const RateEstimator::Options& options) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    statsOptions_ = options;
+    for (const auto& entry : tunnels_) {
+        entry.second->configureStatistics(options);
+    }
+}
+
+void TunnelRegistry::configureReconnect(const ReconnectPolicy::Options& options) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    reconnectOptions_ = options;
+    for (const auto& entry : tunnels_) {
+        entry.second->configureReconnect(options);
+    }
+}
+
+void TunnelRegistry::configureKeepalive(bool adaptive, const KeepaliveTuner::Options& options) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    adaptiveKeepalive_ = adaptive;
+    keepaliveOptions_ = options;
+    for (const auto& entry : tunnels_) {
+        entry.second->configureKeepalive(adaptive, options);
+    }
+}
+
+void TunnelRegistry::configureLatencyProbe(const LatencyProbe::Options& options) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    latencyOptions_ = options;
+    for (const auto& entry : tunnels_) {
+        entry.second->configureLatencyProbe(options);
+    }
+}
+
+void TunnelRegistry::ensureTicking() {
+    schedule(std::chrono::milliseconds(0));
+}
+
+void TunnelRegistry::wake() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (tickTimer_ == 0 || !metrics_.idle) {
+            return;
+        }
+    }
+    schedule(std::chrono::milliseconds(0));
+}
+
+void TunnelRegistry::noteStatisticsRead() {
+    lastStatisticsRead_.store(EventLoop::Clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+    wake();
+}
+
+TunnelRegistry::Metrics TunnelRegistry::metrics() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return metrics_;
+}
+
+void TunnelRegistry::schedule(std::chrono::milliseconds delay) {
+    EventLoop::TaskId previous;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        previous = tickTimer_;
+        uint64_t generation = ++tickGeneration_;
+        tickTimer_ = loop_.addTimer(delay, [this, generation]() { tick(generation); });
+    }
+    // Outside the lock: the tick being replaced may be running and needs it
+    if (previous != 0) {
+        loop_.cancel(previous);
+    }
+}
+
+bool TunnelRegistry::hasListeners() const {
+    if (backend_.hasListener() || StatsReaderCount() > 0) {
+        return true;
+    }
+    EventLoop::Clock::duration sinceRead(EventLoop::Clock::now().time_since_epoch().count() -
+                                         lastStatisticsRead_.load(std::memory_order_relaxed));
+    return sinceRead < kStatisticsLease;
+}
+
+void TunnelRegistry::noteNetworkChange() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (networkPending_) {
+        return;
+    }
+    networkPending_ = true;
+    networkTimer_ = loop_.addTimer(std::chrono::milliseconds(0), [this]() { dispatchNetworkChange(); });
+}
+
+void TunnelRegistry::dispatchNetworkChange() {
+    std::vector<Tunnel*> active;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        networkPending_ = false;
+        for (const auto& entry : tunnels_) {
+            if (entry.second->isActive()) {
+                active.push_back(entry.second.get());
+            }
+        }
+    }
+    TraceRecorder::instance().instant("network", "change", {}, "tunnels", static_cast<int64_t>(active.size()));
+    // Answers from the old network are still served while they refresh
+    if (resolver_) {
+        resolver_->expireAll();
+    }
+    for (auto* tunnel : active) {
+        tunnel->onNetworkChange();
+    }
+}
+
+void TunnelRegistry::tick(uint64_t generation) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (generation != tickGeneration_) {
+            return;
+        }
+        ticking_.clear();
+        for (const auto& entry : tunnels_) {
+            if (entry.second->isActive()) {
+                ticking_.push_back(entry.second.get());
+            }
+        }
+
+        // Nothing to watch; the next start brings the timer back
+        if (ticking_.empty()) {
+            tickTimer_ = 0;
+            metrics_.idle = false;
+            return;
+        }
+    }
+
+    // Tunnels are never removed while the registry lives, so the pointers
+    // stay valid without the lock
+    TraceSpan span("monitor", "tick");
+    span.setArg("tunnels", static_cast<int64_t>(ticking_.size()));
+    bool listened = hasListeners();
+    auto interval = std::chrono::milliseconds::max();
+    for (auto* tunnel : ticking_) {
+        interval = std::min(interval, tunnel->monitorTick(listened));
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (generation != tickGeneration_) {
+        return;
+    }
+    metrics_.ticks++;
+    metrics_.interval = interval;
+    metrics_.idle = !listened;
+    tickTimer_ = loop_.addTimer(interval, [this, generation]() { tick(generation); });
+}
+
+} // namespace wireguard_flutter
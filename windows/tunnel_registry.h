@@ -0,0 +1,141 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "event_loop.h"
+#include "keepalive_tuner.h"
+#include "latency_probe.h"
+#include "rate_estimator.h"
+#include "reconnect_policy.h"
+#include "resolver_cache.h"
+
+namespace wireguard_flutter {
+
+// Tunnels of one plugin instance, keyed by name.
+//
+// Each tunnel keeps its own lifecycle, statistics and events; monitoring and
+// sampling share one timer on the event loop that ticks every active tunnel
+// in name order, so N tunnels cost one wakeup per tick rather than N. The
+// timer is one-shot and re-armed after each tick with the shortest interval
+// any tunnel asked for (see MonitorCadence). While nobody listens to the
+// event channel, reads statistics or polls a counter block, tunnels only
+// watch their link. Network changes expire the shared endpoint name cache
+// and are passed on to the active tunnels, which decide whether to roam.
+// Tunnels are created on first start and live as long as the registry.
+//
+// The tunnels and the host come from a Backend: WireGuardTunnelManagers,
+// the event channel and the host's routes on Windows, fakes in tests.
+// Portable.
+class TunnelRegistry {
+public:
+    // What the shared tick drives
+    class Tunnel {
+    public:
+        virtual ~Tunnel() = default;
+
+        // Connecting, up or reconnecting, i.e. in need of monitor ticks
+        virtual bool isActive() const = 0;
+        // On the loop. Statistics are only sampled when |listened|; the link
+        // is always checked. Returns how soon the tunnel wants the next tick.
+        virtual std::chrono::milliseconds monitorTick(bool listened) = 0;
+        // On the loop, when the host's default route or addresses changed
+        virtual void onNetworkChange() = 0;
+
+        virtual void configureStatistics(const RateEstimator::Options& options) = 0;
+        virtual void configureReconnect(const ReconnectPolicy::Options& options) = 0;
+        virtual void configureKeepalive(bool adaptive, const KeepaliveTuner::Options& options) = 0;
+        virtual void configureLatencyProbe(const LatencyProbe::Options& options) = 0;
+    };
+
+    class Backend {
+    public:
+        virtual ~Backend() = default;
+
+        // A new tunnel named |name|, under the registry's lock
+        virtual std::unique_ptr<Tunnel> create(const std::string& name) = 0;
+        // Whether Dart listens to the event channel; any thread
+        virtual bool hasListener() const = 0;
+        // Calls |changed| from any thread when the host's default route or
+        // addresses change, until unwatchNetwork returns
+        virtual void watchNetwork(std::function<void()> changed) = 0;
+        virtual void unwatchNetwork() = 0;
+    };
+
+    struct Metrics {
+        uint64_t ticks = 0;
+        std::chrono::milliseconds interval{0};
+        // The last tick found no listeners
+        bool idle = false;
+    };
+
+    // A statistics call keeps sampling on for this long
+    static constexpr std::chrono::seconds kStatisticsLease{30};
+
+    // |resolver| is expired on network changes; may be null
+    TunnelRegistry(EventLoop& loop, Backend& backend, ResolverCache* resolver);
+    ~TunnelRegistry();
+
+    TunnelRegistry(const TunnelRegistry&) = delete;
+    TunnelRegistry& operator=(const TunnelRegistry&) = delete;
+
+    // nullptr when no tunnel of that name was started yet
+    Tunnel* find(const std::string& name);
+    Tunnel& getOrCreate(const std::string& name);
+    std::vector<Tunnel*> tunnels();
+
+    // Applies to existing tunnels and to those created later
+    void configureStatistics(const RateEstimator::Options& options);
+    void configureReconnect(const ReconnectPolicy::Options& options);
+    void configureKeepalive(bool adaptive, const KeepaliveTuner::Options& options);
+    void configureLatencyProbe(const LatencyProbe::Options& options);
+
+    // Runs the shared tick now, starting it if it is not running. Call after
+    // a start.
+    void ensureTicking();
+
+    // Call when a listener attaches or statistics are read; an idle tick is
+    // brought forward so sampling resumes right away.
+    void wake();
+    void noteStatisticsRead();
+
+    Metrics metrics();
+
+private:
+    void schedule(std::chrono::milliseconds delay);
+    void tick(uint64_t generation);
+    bool hasListeners() const;
+    // Any thread; changes that arrive while one is pending are folded in
+    void noteNetworkChange();
+    void dispatchNetworkChange();
+
+    EventLoop& loop_;
+    Backend& backend_;
+    ResolverCache* resolver_;
+
+    std::mutex mutex_;
+    std::map<std::string, std::unique_ptr<Tunnel>> tunnels_;
+    RateEstimator::Options statsOptions_;
+    ReconnectPolicy::Options reconnectOptions_;
+    bool adaptiveKeepalive_ = false;
+    KeepaliveTuner::Options keepaliveOptions_;
+    LatencyProbe::Options latencyOptions_;
+    EventLoop::TaskId tickTimer_ = 0;
+    // A tick whose generation is stale neither runs nor re-arms
+    uint64_t tickGeneration_ = 0;
+    Metrics metrics_;
+    std::vector<Tunnel*> ticking_;
+
+    EventLoop::TaskId networkTimer_ = 0;
+    bool networkPending_ = false;
+
+    std::atomic<EventLoop::Clock::rep> lastStatisticsRead_{0};
+};
+
+} // namespace wireguard_flutter
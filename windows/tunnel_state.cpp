@@ -0,0 +1,84 @@
+#include "tunnel_state.h"
+
+namespace wireguard_flutter {
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "state word must be lock-free");
+
+namespace {
+
+// kTransitions[from][to], in TunnelState order
+constexpr bool kTransitions[kTunnelStateCount][kTunnelStateCount] = {
+    // Disconnected
+    {false, true, false, false, false, false, false},
+    // Connecting
+    {true, false, true, true, true, false, false},
+    // Connected
+    {true, false, false, true, true, true, true},
+    // Error
+    {false, false, false, false, true, false, false},
+    // Disconnecting
+    {true, false, false, false, false, false, false},
+    // Reconnecting
+    {true, false, true, true, true, false, false},
+    // Degraded
+    {true, false, true, true, true, true, false},
+};
+
+} // namespace
+
+bool TunnelStateMachine::isAllowed(TunnelState from, TunnelState to) {
+    auto fromIndex = static_cast<size_t>(from);
+    auto toIndex = static_cast<size_t>(to);
+    if (fromIndex >= kTunnelStateCount || toIndex >= kTunnelStateCount) {
+        return false;
+    }
+    return kTransitions[fromIndex][toIndex];
+}
+
+const char* TunnelStateMachine::stageName(TunnelState state) {
+    switch (state) {
+    case TunnelState::Connecting:
+        return "connecting";
+    case TunnelState::Connected:
+        return "connected";
+    case TunnelState::Error:
+        return "error";
+    case TunnelState::Disconnecting:
+        return "disconnecting";
+    case TunnelState::Reconnecting:
+        return "reconnect";
+    case TunnelState::Degraded:
+        return "degraded";
+    case TunnelState::Disconnected:
+    default:
+        return "disconnected";
+    }
+}
+
+bool TunnelStateMachine::transition(TunnelState to, Snapshot* previous) {
+    uint64_t word = word_.load(std::memory_order_acquire);
+    for (;;) {
+        Snapshot current = unpack(word);
+        if (!isAllowed(current.state, to)) {
+            return false;
+        }
+        if (word_.compare_exchange_weak(word, pack(to, current.generation + 1), std::memory_order_acq_rel,
+                                        std::memory_order_acquire)) {
+            if (previous) {
+                *previous = current;
+            }
+            return true;
+        }
+    }
+}
+
+bool TunnelStateMachine::transition(const Snapshot& expected, TunnelState to) {
+    if (!isAllowed(expected.state, to)) {
+        return false;
+    }
+    uint64_t word = pack(expected.state, expected.generation);
+    return word_.compare_exchange_strong(word, pack(to, expected.generation + 1), std::memory_order_acq_rel,
+                                         std::memory_order_acquire);
+}
+
+} // namespace wireguard_flutter
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace wireguard_flutter {
+
+enum class TunnelState : uint8_t {
+    Disconnected = 0,
+    Connecting = 1,
+    Connected = 2,
+    Error = 3,
+    Disconnecting = 4,
+    // Connected before, link lost, being restarted
+    Reconnecting = 5,
+    // Adapter up, but the peer stopped answering
+    Degraded = 6,
+};
+
+constexpr size_t kTunnelStateCount = 7;
+
+// Tunnel lifecycle as a validated state machine.
+//
+// The state and a generation counter share one atomic word, so reading the
+// state never takes a lock and a transition is a single compare-and-swap.
+// Every transition bumps the generation; callbacks that captured a snapshot
+// can use it to make sure they still act on the state they saw. Portable; no
+// Windows dependencies.
+//
+//   Disconnected  -> Connecting
+//   Connecting    -> Connected | Error | Disconnecting | Disconnected
+//   Connected     -> Disconnecting | Disconnected | Error | Reconnecting |
+//                    Degraded
+//   Error         -> Disconnecting
+//   Disconnecting -> Disconnected
+//   Reconnecting  -> Connected | Error | Disconnecting | Disconnected
+//   Degraded      -> Connected | Error | Disconnecting | Disconnected |
+//                    Reconnecting
+class TunnelStateMachine {
+public:
+    struct Snapshot {
+        TunnelState state = TunnelState::Disconnected;
+        uint64_t generation = 0;
+    };
+
+    static bool isAllowed(TunnelState from, TunnelState to);
+
+    // Stage code sent to Dart
+    static const char* stageName(TunnelState state);
+
+    Snapshot snapshot() const { return unpack(word_.load(std::memory_order_acquire)); }
+    TunnelState state() const { return snapshot().state; }
+    bool is(TunnelState state) const { return this->state() == state; }
+
+    // Moves to |to| from whatever the current state is, if the table allows
+    // it. |previous| receives the state that was left.
+    bool transition(TunnelState to, Snapshot* previous = nullptr);
+
+    // Moves to |to| only from |expected|, generation included.
+    bool transition(const Snapshot& expected, TunnelState to);
+
+private:
+    static constexpr uint64_t kStateBits = 8;
+    static constexpr uint64_t kStateMask = (uint64_t{1} << kStateBits) - 1;
+
+    static uint64_t pack(TunnelState state, uint64_t generation) {
+        return (generation << kStateBits) | static_cast<uint64_t>(state);
+    }
+    static Snapshot unpack(uint64_t word) {
+        return Snapshot{static_cast<TunnelState>(word & kStateMask), word >> kStateBits};
+    }
+
+    std::atomic<uint64_t> word_{0};
+};
+
+} // namespace wireguard_flutter
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+namespace wireguard_flutter {
+
+// Fixed-layout statistics record. The tunnel manager fills it in place so
+// taking a sample never allocates.
+//
+// On the method channel the record travels as a single Int64List:
+//   [version, field count, field 0, field 1, ...]
+// Fields are only ever appended; a decoder reads the fields it knows about
+// and ignores the rest, so older Dart code keeps working with newer natives.
+struct TunnelStats {
+    static constexpr int64_t kVersion = 4;
+
+    uint64_t bytesIn;
+    uint64_t bytesOut;
+    // Rate over the last sampling interval
+    uint64_t speedInBps;
+    uint64_t speedOutBps;
+
+    // Added in version 2: computed by the sampler's RateEstimator
+    uint64_t smoothedInBps;
+    uint64_t smoothedOutBps;
+    uint64_t peakInBps;
+    uint64_t peakOutBps;
+    uint64_t p50InBps;
+    uint64_t p50OutBps;
+    uint64_t p95InBps;
+    uint64_t p95OutBps;
+
+    // Added in version 3: interface packet counters and values derived from
+    // the last sampling interval
+    uint64_t packetsIn;
+    uint64_t packetsOut;
+    uint64_t errorsIn;
+    uint64_t errorsOut;
+    uint64_t discardsIn;
+    uint64_t discardsOut;
+    uint64_t packetsInPerSec;
+    uint64_t packetsOutPerSec;
+    uint64_t avgPacketSizeIn;
+    uint64_t avgPacketSizeOut;
+    uint64_t dropRatioPpm;
+
+    // Added in version 4: round trips of the background probe through the
+    // tunnel over its recent window, in microseconds; all 0 while
+    // rttSamples is 0
+    uint64_t rttSamples;
+    uint64_t rttMinUs;
+    uint64_t rttP50Us;
+    uint64_t rttP90Us;
+    uint64_t rttP99Us;
+    uint64_t rttJitterUs;
+    uint64_t rttLossPpm;
+};
+
+static_assert(std::is_trivially_copyable<TunnelStats>::value, "TunnelStats must stay POD");
+
+// Index of each value in the encoded buffer.
+enum TunnelStatsField : size_t {
+    kStatsFieldVersion = 0,
+    kStatsFieldCount,
+    kStatsFieldBytesIn,
+    kStatsFieldBytesOut,
+    kStatsFieldSpeedIn,
+    kStatsFieldSpeedOut,
+    kStatsFieldSmoothedIn,
+    kStatsFieldSmoothedOut,
+    kStatsFieldPeakIn,
+    kStatsFieldPeakOut,
+    kStatsFieldP50In,
+    kStatsFieldP50Out,
+    kStatsFieldP95In,
+    kStatsFieldP95Out,
+    kStatsFieldPacketsIn,
+    kStatsFieldPacketsOut,
+    kStatsFieldErrorsIn,
+    kStatsFieldErrorsOut,
+    kStatsFieldDiscardsIn,
+    kStatsFieldDiscardsOut,
+    kStatsFieldPacketsInPerSec,
+    kStatsFieldPacketsOutPerSec,
+    kStatsFieldAvgPacketSizeIn,
+    kStatsFieldAvgPacketSizeOut,
+    kStatsFieldDropRatioPpm,
+    kStatsFieldRttSamples,
+    kStatsFieldRttMin,
+    kStatsFieldRttP50,
+    kStatsFieldRttP90,
+    kStatsFieldRttP99,
+    kStatsFieldRttJitter,
+    kStatsFieldRttLossPpm,
+    kStatsFieldTotal
+};
+
+constexpr size_t kStatsHeaderSize = kStatsFieldBytesIn;
+constexpr size_t kStatsRecordFields = kStatsFieldTotal - kStatsHeaderSize;
+
+// Writes the kStatsRecordFields values of |stats| starting at |fields|.
+inline void EncodeTunnelStatsFields(const TunnelStats& stats, int64_t* fields) {
+    auto set = [fields](TunnelStatsField index, uint64_t value) {
+        fields[index - kStatsHeaderSize] = static_cast<int64_t>(value);
+    };
+    set(kStatsFieldBytesIn, stats.bytesIn);
+    set(kStatsFieldBytesOut, stats.bytesOut);
+    set(kStatsFieldSpeedIn, stats.speedInBps);
+    set(kStatsFieldSpeedOut, stats.speedOutBps);
+    set(kStatsFieldSmoothedIn, stats.smoothedInBps);
+    set(kStatsFieldSmoothedOut, stats.smoothedOutBps);
+    set(kStatsFieldPeakIn, stats.peakInBps);
+    set(kStatsFieldPeakOut, stats.peakOutBps);
+    set(kStatsFieldP50In, stats.p50InBps);
+    set(kStatsFieldP50Out, stats.p50OutBps);
+    set(kStatsFieldP95In, stats.p95InBps);
+    set(kStatsFieldP95Out, stats.p95OutBps);
+    set(kStatsFieldPacketsIn, stats.packetsIn);
+    set(kStatsFieldPacketsOut, stats.packetsOut);
+    set(kStatsFieldErrorsIn, stats.errorsIn);
+    set(kStatsFieldErrorsOut, stats.errorsOut);
+    set(kStatsFieldDiscardsIn, stats.discardsIn);
+    set(kStatsFieldDiscardsOut, stats.discardsOut);
+    set(kStatsFieldPacketsInPerSec, stats.packetsInPerSec);
+    set(kStatsFieldPacketsOutPerSec, stats.packetsOutPerSec);
+    set(kStatsFieldAvgPacketSizeIn, stats.avgPacketSizeIn);
+    set(kStatsFieldAvgPacketSizeOut, stats.avgPacketSizeOut);
+    set(kStatsFieldDropRatioPpm, stats.dropRatioPpm);
+    set(kStatsFieldRttSamples, stats.rttSamples);
+    set(kStatsFieldRttMin, stats.rttMinUs);
+    set(kStatsFieldRttP50, stats.rttP50Us);
+    set(kStatsFieldRttP90, stats.rttP90Us);
+    set(kStatsFieldRttP99, stats.rttP99Us);
+    set(kStatsFieldRttJitter, stats.rttJitterUs);
+    set(kStatsFieldRttLossPpm, stats.rttLossPpm);
+}
+
+inline void EncodeTunnelStats(const TunnelStats& stats, std::vector<int64_t>& out) {
+    out.resize(kStatsFieldTotal);
+    out[kStatsFieldVersion] = TunnelStats::kVersion;
+    out[kStatsFieldCount] = static_cast<int64_t>(kStatsRecordFields);
+    EncodeTunnelStatsFields(stats, out.data() + kStatsHeaderSize);
+}
+
+} // namespace wireguard_flutter
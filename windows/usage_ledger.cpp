@@ -0,0 +1,583 @@
+#include "usage_ledger.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <string_view>
+#include <system_error>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "crc32.h"
+#include "logger.h"
+
+namespace wireguard_flutter {
+
+namespace {
+
+constexpr char kLedgerMagic[8] = {'W', 'G', 'F', 'L', 'E', 'D', 'G', '1'};
+constexpr uint32_t kLedgerVersion = 1;
+constexpr uint32_t kRecordCommit = 0x524C4757; // "WGLR"
+constexpr size_t kTunnelNameSize = 32;
+
+struct LedgerHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint64_t capacity;
+    uint8_t reserved[40];
+};
+
+// |commit| is written last; a record without it was torn by a crash
+struct LedgerRecord {
+    uint32_t commit;
+    uint32_t day;
+    char tunnel[kTunnelNameSize];
+    uint64_t bytesIn;
+    uint64_t bytesOut;
+    uint32_t checksum;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(LedgerHeader) == 64, "ledger header must stay 64 bytes");
+static_assert(sizeof(LedgerRecord) == 64, "ledger records must stay 64 bytes");
+
+uint32_t recordChecksum(const LedgerRecord& record) {
+    const auto* begin = reinterpret_cast<const uint8_t*>(&record.day);
+    const auto* end = reinterpret_cast<const uint8_t*>(&record.checksum);
+    return crc32(begin, static_cast<size_t>(end - begin));
+}
+
+// Names are stored in a fixed field; longer ones are truncated consistently
+std::string_view ledgerKey(const std::string& tunnel) {
+    return std::string_view(tunnel.data(), std::min(tunnel.size(), kTunnelNameSize - 1));
+}
+
+// Days since 1970-01-01 to a civil year and month (proleptic Gregorian)
+void civilFromDays(int64_t days, int64_t& year, unsigned& month) {
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    auto doe = static_cast<unsigned>(days - era * 146097);
+    unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    unsigned mp = (5 * doy + 2) / 153;
+    month = mp < 10 ? mp + 3 : mp - 9;
+    year = static_cast<int64_t>(yoe) + era * 400 + (month <= 2 ? 1 : 0);
+}
+
+} // namespace
+
+class UsageLedger::MappedFile {
+public:
+    ~MappedFile() { unmap(); }
+
+    bool map(const std::filesystem::path& path, size_t size) {
+        unmap();
+#ifdef _WIN32
+        file = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS,
+                           FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+
+        LARGE_INTEGER current;
+        if (!GetFileSizeEx(file, &current)) {
+            unmap();
+            return false;
+        }
+        // The mapping extends the file with zeros if it is shorter
+        size = std::max(size, static_cast<size_t>(current.QuadPart));
+
+        ULARGE_INTEGER mappingSize;
+        mappingSize.QuadPart = size;
+        mapping = CreateFileMappingW(file, nullptr, PAGE_READWRITE, mappingSize.HighPart, mappingSize.LowPart, nullptr);
+        if (!mapping) {
+            unmap();
+            return false;
+        }
+
+        view = static_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size));
+        if (!view) {
+            unmap();
+            return false;
+        }
+#else
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0) {
+            return false;
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            unmap();
+            return false;
+        }
+        size = std::max(size, static_cast<size_t>(info.st_size));
+        if (static_cast<size_t>(info.st_size) < size && ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            unmap();
+            return false;
+        }
+
+        void* address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (address == MAP_FAILED) {
+            unmap();
+            return false;
+        }
+        view = static_cast<uint8_t*>(address);
+#endif
+        length = size;
+        return true;
+    }
+
+    void unmap() {
+#ifdef _WIN32
+        if (view) {
+            UnmapViewOfFile(view);
+        }
+        if (mapping) {
+            CloseHandle(mapping);
+            mapping = nullptr;
+        }
+        if (file != INVALID_HANDLE_VALUE) {
+            CloseHandle(file);
+            file = INVALID_HANDLE_VALUE;
+        }
+#else
+        if (view) {
+            munmap(view, length);
+        }
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+#endif
+        view = nullptr;
+        length = 0;
+    }
+
+    void sync() {
+        if (!view) {
+            return;
+        }
+#ifdef _WIN32
+        FlushViewOfFile(view, length);
+        FlushFileBuffers(file);
+#else
+        msync(view, length, MS_SYNC);
+#endif
+    }
+
+    LedgerHeader* header() const { return reinterpret_cast<LedgerHeader*>(view); }
+    LedgerRecord* records() const { return reinterpret_cast<LedgerRecord*>(view + sizeof(LedgerHeader)); }
+    size_t capacity() const { return length > sizeof(LedgerHeader) ? (length - sizeof(LedgerHeader)) / sizeof(LedgerRecord) : 0; }
+
+private:
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+    uint8_t* view = nullptr;
+    size_t length = 0;
+};
+
+UsageLedger::UsageLedger(std::filesystem::path path, size_t capacity)
+    : path_(std::move(path)), capacity_(std::max<size_t>(capacity, 16)) {}
+
+UsageLedger::~UsageLedger() {
+    close();
+}
+
+uint32_t UsageLedger::today() {
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::hours>(now).count() / 24);
+}
+
+const char* UsageLedger::periodName(QuotaPeriod period) {
+    switch (period) {
+    case QuotaPeriod::Day:
+        return "day";
+    case QuotaPeriod::Month:
+        return "month";
+    case QuotaPeriod::Total:
+    default:
+        return "total";
+    }
+}
+
+bool UsageLedger::parsePeriod(const std::string& name, QuotaPeriod& period) {
+    for (auto candidate : {QuotaPeriod::Day, QuotaPeriod::Month, QuotaPeriod::Total}) {
+        if (name == periodName(candidate)) {
+            period = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* UsageLedger::actionName(QuotaAction action) {
+    switch (action) {
+    case QuotaAction::Disconnect:
+        return "disconnect";
+    case QuotaAction::Notify:
+    default:
+        return "notify";
+    }
+}
+
+bool UsageLedger::parseAction(const std::string& name, QuotaAction& action) {
+    for (auto candidate : {QuotaAction::Notify, QuotaAction::Disconnect}) {
+        if (name == actionName(candidate)) {
+            action = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool UsageLedger::mapFile(size_t records) {
+    file_ = std::make_unique<MappedFile>();
+    if (!file_->map(path_, sizeof(LedgerHeader) + records * sizeof(LedgerRecord))) {
+        file_.reset();
+        return false;
+    }
+    return true;
+}
+
+bool UsageLedger::open() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (file_) {
+        return true;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(path_.parent_path(), error);
+
+    if (!mapFile(capacity_)) {
+        WG_LOG_ERROR("UsageLedger: Failed to map {}", path_.string());
+        return false;
+    }
+
+    LedgerHeader* header = file_->header();
+    bool fresh = std::all_of(header->magic, header->magic + sizeof(header->magic), [](char c) { return c == 0; });
+    bool valid = std::memcmp(header->magic, kLedgerMagic, sizeof(kLedgerMagic)) == 0 &&
+                 header->version == kLedgerVersion && header->recordSize == sizeof(LedgerRecord);
+
+    if (!fresh && !valid) {
+        // Unknown format; keep it aside rather than misreading it
+        WG_LOG_WARN("UsageLedger: Unrecognized ledger, starting a new one");
+        file_.reset();
+        std::filesystem::path aside = path_;
+        aside += ".bad";
+        std::filesystem::rename(path_, aside, error);
+        if (!mapFile(capacity_)) {
+            return false;
+        }
+        header = file_->header();
+        fresh = true;
+    }
+
+    if (fresh) {
+        std::memcpy(header->magic, kLedgerMagic, sizeof(kLedgerMagic));
+        header->version = kLedgerVersion;
+        header->recordSize = sizeof(LedgerRecord);
+    }
+    capacity_ = file_->capacity();
+    header->capacity = capacity_;
+
+    // Replay until the first record that was never committed
+    totals_.clear();
+    pending_.clear();
+    nextRecord_ = 0;
+    const LedgerRecord* records = file_->records();
+    while (nextRecord_ < capacity_) {
+        const LedgerRecord& record = records[nextRecord_];
+        if (record.commit != kRecordCommit || record.checksum != recordChecksum(record)) {
+            break;
+        }
+        std::string tunnel(record.tunnel, strnlen(record.tunnel, kTunnelNameSize));
+        Totals& totals = totals_[tunnel][record.day];
+        totals.bytesIn += record.bytesIn;
+        totals.bytesOut += record.bytesOut;
+        nextRecord_++;
+    }
+
+    WG_LOG_INFO("UsageLedger: Loaded {} records", nextRecord_);
+
+    // Compact early so a session never has to do it on a full file
+    if (nextRecord_ > capacity_ * 3 / 4) {
+        compactLocked();
+    }
+    return true;
+}
+
+void UsageLedger::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!file_) {
+            return;
+        }
+    }
+    flush();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (file_) {
+        file_->sync();
+        file_.reset();
+    }
+}
+
+bool UsageLedger::isOpen() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return file_ != nullptr;
+}
+
+void UsageLedger::record(const std::string& tunnel, uint64_t bytesIn, uint64_t bytesOut) {
+    if (bytesIn == 0 && bytesOut == 0) {
+        return;
+    }
+
+    uint32_t day = today();
+    std::string_view key = ledgerKey(tunnel);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto* map : {&totals_, &pending_}) {
+        auto it = map->find(key);
+        if (it == map->end()) {
+            it = map->emplace(std::string(key), DayTotals{}).first;
+        }
+        Totals& totals = it->second[day];
+        totals.bytesIn += bytesIn;
+        totals.bytesOut += bytesOut;
+    }
+}
+
+bool UsageLedger::append(const std::string& tunnel, uint32_t day, const Totals& totals) {
+    if (!file_ || nextRecord_ >= capacity_) {
+        return false;
+    }
+
+    LedgerRecord& record = file_->records()[nextRecord_];
+
+    // Clear any torn commit before reusing the slot; the fences keep the
+    // compiler from moving the commit marker across the payload stores
+    record.commit = 0;
+    std::atomic_thread_fence(std::memory_order_release);
+    record.day = day;
+    std::memset(record.tunnel, 0, sizeof(record.tunnel));
+    std::memcpy(record.tunnel, tunnel.data(), std::min(tunnel.size(), kTunnelNameSize - 1));
+    record.bytesIn = totals.bytesIn;
+    record.bytesOut = totals.bytesOut;
+    record.reserved = 0;
+    record.checksum = recordChecksum(record);
+    std::atomic_thread_fence(std::memory_order_release);
+    record.commit = kRecordCommit;
+
+    nextRecord_++;
+    return true;
+}
+
+void UsageLedger::flush() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!file_ || pending_.empty()) {
+        return;
+    }
+
+    for (const auto& [tunnel, days] : pending_) {
+        for (const auto& [day, totals] : days) {
+            if (!append(tunnel, day, totals)) {
+                // Full: the compacted file is rebuilt from the totals, which
+                // already include everything pending
+                compactLocked();
+                return;
+            }
+        }
+    }
+    pending_.clear();
+}
+
+bool UsageLedger::compact() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return compactLocked();
+}
+
+bool UsageLedger::compactLocked() {
+    if (!file_) {
+        return false;
+    }
+
+    uint32_t oldest = today() > kRetentionDays ? today() - kRetentionDays : 0;
+    size_t entries = 0;
+    for (auto it = totals_.begin(); it != totals_.end();) {
+        DayTotals& days = it->second;
+        days.erase(days.begin(), days.lower_bound(oldest));
+        entries += days.size();
+        it = days.empty() ? totals_.erase(it) : std::next(it);
+    }
+
+    // Leave room for at least as many appends as there are live entries
+    size_t capacity = std::max(capacity_, entries * 2);
+
+    std::filesystem::path temporary = path_;
+    temporary += ".tmp";
+    std::error_code error;
+    std::filesystem::remove(temporary, error);
+
+    {
+        MappedFile compacted;
+        if (!compacted.map(temporary, sizeof(LedgerHeader) + capacity * sizeof(LedgerRecord))) {
+            WG_LOG_ERROR("UsageLedger: Failed to create compacted ledger");
+            return false;
+        }
+
+        LedgerHeader* header = compacted.header();
+        std::memcpy(header->magic, kLedgerMagic, sizeof(kLedgerMagic));
+        header->version = kLedgerVersion;
+        header->recordSize = sizeof(LedgerRecord);
+        header->capacity = capacity;
+
+        LedgerRecord* records = compacted.records();
+        size_t index = 0;
+        for (const auto& [tunnel, days] : totals_) {
+            for (const auto& [day, totals] : days) {
+                LedgerRecord& record = records[index++];
+                record.day = day;
+                std::memcpy(record.tunnel, tunnel.data(), std::min(tunnel.size(), kTunnelNameSize - 1));
+                record.bytesIn = totals.bytesIn;
+                record.bytesOut = totals.bytesOut;
+                record.checksum = recordChecksum(record);
+                record.commit = kRecordCommit;
+            }
+        }
+        // Everything must be on disk before it replaces the old ledger
+        compacted.sync();
+    }
+
+    file_.reset();
+    std::filesystem::rename(temporary, path_, error);
+    if (error) {
+        WG_LOG_ERROR("UsageLedger: Failed to replace ledger: {}", error.message());
+    }
+
+    if (!mapFile(capacity)) {
+        return false;
+    }
+    capacity_ = file_->capacity();
+    nextRecord_ = error ? capacity_ : entries;
+    pending_.clear();
+
+    WG_LOG_INFO("UsageLedger: Compacted to {} records", entries);
+    return !error;
+}
+
+std::vector<UsageLedger::UsageEntry> UsageLedger::usage(const std::string& tunnel) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<UsageEntry> entries;
+    for (const auto& [name, days] : totals_) {
+        if (!tunnel.empty() && name != ledgerKey(tunnel)) {
+            continue;
+        }
+        for (const auto& [day, totals] : days) {
+            entries.push_back(UsageEntry{name, day, totals.bytesIn, totals.bytesOut});
+        }
+    }
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const UsageEntry& a, const UsageEntry& b) { return a.day < b.day; });
+    return entries;
+}
+
+int64_t UsageLedger::periodKey(QuotaPeriod period, uint32_t day) {
+    switch (period) {
+    case QuotaPeriod::Day:
+        return day;
+    case QuotaPeriod::Month: {
+        int64_t year;
+        unsigned month;
+        civilFromDays(day, year, month);
+        return year * 12 + (month - 1);
+    }
+    case QuotaPeriod::Total:
+    default:
+        return 0;
+    }
+}
+
+uint64_t UsageLedger::usedBytesLocked(const std::string& tunnel, QuotaPeriod period) const {
+    int64_t current = periodKey(period, today());
+    uint64_t used = 0;
+    for (const auto& [name, days] : totals_) {
+        if (!tunnel.empty() && name != ledgerKey(tunnel)) {
+            continue;
+        }
+        for (const auto& [day, totals] : days) {
+            if (periodKey(period, day) == current) {
+                used += totals.bytesIn + totals.bytesOut;
+            }
+        }
+    }
+    return used;
+}
+
+uint64_t UsageLedger::usedBytes(const std::string& tunnel, QuotaPeriod period) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return usedBytesLocked(tunnel, period);
+}
+
+void UsageLedger::setQuota(const Quota& quota) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& state : quotas_) {
+        if (state.quota.tunnel == quota.tunnel && state.quota.period == quota.period) {
+            state.quota = quota;
+            state.triggeredPeriod = -1;
+            return;
+        }
+    }
+    quotas_.push_back(QuotaState{quota, -1});
+}
+
+void UsageLedger::clearQuotas(const std::string& tunnel) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    quotas_.erase(std::remove_if(quotas_.begin(), quotas_.end(),
+                                 [&tunnel](const QuotaState& state) { return state.quota.tunnel == tunnel; }),
+                  quotas_.end());
+}
+
+bool UsageLedger::checkQuotas(const std::string& tunnel, QuotaHit& hit) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint32_t day = today();
+    for (auto& state : quotas_) {
+        const Quota& quota = state.quota;
+        // A quota without a tunnel limits the combined usage of all tunnels
+        if (!quota.tunnel.empty() && quota.tunnel != tunnel) {
+            continue;
+        }
+
+        int64_t period = periodKey(quota.period, day);
+        if (state.triggeredPeriod == period) {
+            continue;
+        }
+
+        uint64_t used = usedBytesLocked(quota.tunnel, quota.period);
+        if (used >= quota.limitBytes) {
+            state.triggeredPeriod = period;
+            hit.quota = quota;
+            hit.usedBytes = used;
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace wireguard_flutter
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace wireguard_flutter {
+
+// Persistent, append-only data-usage ledger.
+//
+// Usage is accumulated per tunnel and per UTC day in memory and appended to a
+// memory-mapped file as fixed-size, checksummed records. A record is only
+// considered written once its trailing commit marker is set, so a crash in
+// the middle of an append loses at most that record. When the file fills up,
+// or when asked to, the ledger is compacted to one record per tunnel and day
+// by writing a fresh file and renaming it over the old one.
+//
+// Quotas are checked against the in-memory totals, so the sampler can enforce
+// them on every tick without touching the disk. Thread-safe. Portable; uses
+// file mappings on Windows and mmap elsewhere.
+class UsageLedger {
+public:
+    enum class QuotaPeriod { Day, Month, Total };
+    enum class QuotaAction { Notify, Disconnect };
+
+    struct Quota {
+        // Empty applies to every tunnel
+        std::string tunnel;
+        QuotaPeriod period = QuotaPeriod::Month;
+        uint64_t limitBytes = 0;
+        QuotaAction action = QuotaAction::Notify;
+    };
+
+    struct QuotaHit {
+        Quota quota;
+        uint64_t usedBytes = 0;
+    };
+
+    struct UsageEntry {
+        std::string tunnel;
+        // Days since 1970-01-01 UTC
+        uint32_t day = 0;
+        uint64_t bytesIn = 0;
+        uint64_t bytesOut = 0;
+    };
+
+    // Number of records the mapped file holds before it is compacted
+    static constexpr size_t kDefaultCapacity = 4096;
+    // Days kept when compacting
+    static constexpr uint32_t kRetentionDays = 400;
+
+    explicit UsageLedger(std::filesystem::path path, size_t capacity = kDefaultCapacity);
+    ~UsageLedger();
+
+    UsageLedger(const UsageLedger&) = delete;
+    UsageLedger& operator=(const UsageLedger&) = delete;
+
+    // Maps the file, creating it if needed, and replays committed records.
+    bool open();
+    void close();
+    bool isOpen() const;
+
+    // Adds traffic for |tunnel| to today's totals. Cheap; nothing is written
+    // until flush().
+    void record(const std::string& tunnel, uint64_t bytesIn, uint64_t bytesOut);
+
+    // Appends the traffic recorded since the last flush.
+    void flush();
+
+    // Rewrites the file with one record per tunnel and day.
+    bool compact();
+
+    // Totals per tunnel and day, oldest first. An empty |tunnel| returns all.
+    std::vector<UsageEntry> usage(const std::string& tunnel) const;
+
+    // Bytes in and out used by |tunnel| in the current |period|.
+    uint64_t usedBytes(const std::string& tunnel, QuotaPeriod period) const;
+
+    void setQuota(const Quota& quota);
+    void clearQuotas(const std::string& tunnel);
+
+    // Returns true and fills |hit| when a quota for |tunnel| is exceeded. Each
+    // quota fires once per period.
+    bool checkQuotas(const std::string& tunnel, QuotaHit& hit);
+
+    static uint32_t today();
+
+    // "day", "month" and "total", as used on the method channel
+    static const char* periodName(QuotaPeriod period);
+    static bool parsePeriod(const std::string& name, QuotaPeriod& period);
+    // "notify" and "disconnect"
+    static const char* actionName(QuotaAction action);
+    static bool parseAction(const std::string& name, QuotaAction& action);
+
+private:
+    struct Totals {
+        uint64_t bytesIn = 0;
+        uint64_t bytesOut = 0;
+    };
+
+    struct QuotaState {
+        Quota quota;
+        int64_t triggeredPeriod = -1;
+    };
+
+    using DayTotals = std::map<uint32_t, Totals>;
+
+    class MappedFile;
+
+    bool mapFile(size_t records);
+    bool append(const std::string& tunnel, uint32_t day, const Totals& totals);
+    bool compactLocked();
+    uint64_t usedBytesLocked(const std::string& tunnel, QuotaPeriod period) const;
+    static int64_t periodKey(QuotaPeriod period, uint32_t day);
+
+    std::filesystem::path path_;
+    size_t capacity_;
+
+    mutable std::mutex mutex_;
+    std::unique_ptr<MappedFile> file_;
+    size_t nextRecord_ = 0;
+
+    std::map<std::string, DayTotals, std::less<>> totals_;
+    std::map<std::string, DayTotals, std::less<>> pending_;
+    std::vector<QuotaState> quotas_;
+};
+
+} // namespace wireguard_flutter
@@ -17,6 +17,26 @@ namespace wireguard_flutter
     return &(it->second);
   }
 
+  bool IntValue(const flutter::EncodableMap &map, const char *key, int64_t &out)
+  {
+    const auto *value = ValueOrNull(map, key);
+    if (value == nullptr)
+    {
+      return false;
+    }
+    if (const auto *v32 = std::get_if<int32_t>(value))
+    {
+      out = *v32;
+      return true;
+    }
+    if (const auto *v64 = std::get_if<int64_t>(value))
+    {
+      out = *v64;
+      return true;
+    }
+    return false;
+  }
+
   std::string ErrorWithCode(const char *msg, unsigned long error_code)
   {
     std::ostringstream builder;
@@ -56,6 +76,25 @@ namespace wireguard_flutter
     return wstrTo;
   }
 
+  std::wstring GetDataDirectory()
+  {
+    wchar_t base[MAX_PATH];
+    DWORD length = GetEnvironmentVariableW(L"LOCALAPPDATA", base, MAX_PATH);
+    if (length == 0 || length >= MAX_PATH)
+    {
+      length = GetTempPathW(MAX_PATH, base);
+    }
+
+    std::wstring directory(base, length);
+    if (!directory.empty() && directory.back() != L'\\')
+    {
+      directory += L'\\';
+    }
+    directory += L"wireguard_flutter";
+    CreateDirectoryW(directory.c_str(), NULL);
+    return directory;
+  }
+
   void DebugMessageBox(const char *msg)
   {
     std::string s(msg);
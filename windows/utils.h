@@ -11,6 +11,10 @@ namespace wireguard_flutter {
 
 const flutter::EncodableValue *ValueOrNull(const flutter::EncodableMap &map, const char *key);
 
+// Reads an integer argument sent as either int32 or int64. Leaves |out|
+// untouched and returns false when the key is missing or not an integer.
+bool IntValue(const flutter::EncodableMap &map, const char *key, int64_t &out);
+
 std::string ErrorWithCode(const char *msg, unsigned long error_code);
 
 std::string WideToUtf8(const std::wstring &wstr);
@@ -21,6 +25,10 @@ std::string WideToAnsi(const std::wstring &wstr);
 
 std::wstring AnsiToWide(const std::string &str);
 
+// Per-user directory for plugin data that must survive restarts
+// (%LOCALAPPDATA%\wireguard_flutter). Created if missing.
+std::wstring GetDataDirectory();
+
 // Pops a message box (useful for debugging native code)
 void DebugMessageBox(const char* msg);
 
@@ -0,0 +1,320 @@
+#include "wg_quick_config.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace wireguard_flutter {
+
+namespace {
+
+enum class Section { None, Interface, Peer, Other };
+
+std::string trim(const std::string& value) {
+    size_t begin = value.find_first_not_of(" \t\r\n");
+    if (begin == std::string::npos) {
+        return std::string();
+    }
+    size_t end = value.find_last_not_of(" \t\r\n");
+    return value.substr(begin, end - begin + 1);
+}
+
+std::string lower(std::string value) {
+    std::transform(value.begin(), value.end(), value.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return value;
+}
+
+// Plain decimal up to 65535, as MTU and keepalive values are
+bool parseSmallNumber(const std::string& value, uint32_t& out) {
+    if (value.empty() || value.size() > 5 ||
+        !std::all_of(value.begin(), value.end(), [](unsigned char c) { return std::isdigit(c) != 0; })) {
+        return false;
+    }
+    unsigned long number = std::stoul(value);
+    if (number > 65535) {
+        return false;
+    }
+    out = static_cast<uint32_t>(number);
+    return true;
+}
+
+// Calls |visit| with each line (without its line break), the offset it
+// starts at, the section it belongs to and, for "key = value" lines, the
+// lower-cased key and the value. Peers are numbered from 0 in order.
+template <typename Visit>
+void forEachLine(const std::string& text, Visit visit) {
+    Section section = Section::None;
+    int peer = -1;
+    size_t offset = 0;
+    while (offset < text.size()) {
+        size_t end = text.find('\n', offset);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        std::string line = text.substr(offset, end - offset);
+        std::string content = trim(line.substr(0, line.find('#')));
+
+        std::string key;
+        std::string value;
+        if (content.size() >= 2 && content.front() == '[' && content.back() == ']') {
+            std::string name = lower(trim(content.substr(1, content.size() - 2)));
+            if (name == "interface") {
+                section = Section::Interface;
+            } else if (name == "peer") {
+                section = Section::Peer;
+                peer++;
+            } else {
+                section = Section::Other;
+            }
+        } else {
+            size_t equals = content.find('=');
+            if (equals != std::string::npos) {
+                key = lower(trim(content.substr(0, equals)));
+                value = trim(content.substr(equals + 1));
+            }
+        }
+        visit(line, offset, section, peer, key, value);
+        offset = end + 1;
+    }
+}
+
+} // namespace
+
+bool WgQuickConfig::parse(const std::string& text, WgQuickConfig& out) {
+    out = WgQuickConfig{};
+    bool hasInterface = false;
+    forEachLine(text, [&](const std::string&, size_t, Section section, int peer, const std::string& key,
+                          const std::string& value) {
+        if (section == Section::Interface) {
+            hasInterface = true;
+            if (key == "privatekey") {
+                out.privateKey = value;
+            } else if (key == "address") {
+                // Comma-separated, and the key may repeat
+                size_t start = 0;
+                while (start <= value.size()) {
+                    size_t comma = value.find(',', start);
+                    if (comma == std::string::npos) {
+                        comma = value.size();
+                    }
+                    std::string address = trim(value.substr(start, comma - start));
+                    if (!address.empty()) {
+                        out.addresses.push_back(address);
+                    }
+                    start = comma + 1;
+                }
+            } else if (key == "mtu") {
+                parseSmallNumber(value, out.mtu);
+            }
+        } else if (section == Section::Peer) {
+            if (out.peers.size() <= static_cast<size_t>(peer)) {
+                out.peers.resize(static_cast<size_t>(peer) + 1);
+            }
+            Peer& target = out.peers[static_cast<size_t>(peer)];
+            if (key == "publickey") {
+                target.publicKey = value;
+            } else if (key == "presharedkey") {
+                target.presharedKey = value;
+            } else if (key == "endpoint") {
+                target.endpoint = value;
+            } else if (key == "persistentkeepalive") {
+                // "off" is 0 as well
+                parseSmallNumber(value, target.persistentKeepalive);
+            }
+        }
+    });
+    return hasInterface;
+}
+
+std::string WgQuickConfig::withPeerEndpoint(const std::string& text, size_t peer, const std::string& endpoint,
+                                            const std::string& publicKey) {
+    std::string out;
+    out.reserve(text.size() + endpoint.size() + 16);
+    bool written = false;
+    // Where the peer's header line ends in |out|, for adding a missing Endpoint
+    size_t headerEnd = std::string::npos;
+    std::string newline = text.find("\r\n") != std::string::npos ? "\r\n" : "\n";
+
+    forEachLine(text, [&](const std::string& line, size_t offset, Section section, int index, const std::string& key,
+                          const std::string&) {
+        bool ours = section == Section::Peer && index == static_cast<int>(peer);
+        if (ours && key == "endpoint") {
+            if (!written) {
+                out += "Endpoint = " + endpoint + (line.empty() || line.back() != '\r' ? "" : "\r");
+                written = true;
+            }
+            // A repeated Endpoint line is dropped rather than left to win
+        } else if (ours && key == "publickey" && !publicKey.empty()) {
+            out += "PublicKey = " + publicKey + (line.empty() || line.back() != '\r' ? "" : "\r");
+        } else {
+            out += line;
+        }
+        bool lastLine = offset + line.size() >= text.size();
+        if (!lastLine || (!text.empty() && text.back() == '\n')) {
+            out += '\n';
+        }
+        if (ours && key.empty() && headerEnd == std::string::npos) {
+            headerEnd = out.size();
+            if (lastLine && (text.empty() || text.back() != '\n')) {
+                out += newline;
+                headerEnd = out.size();
+            }
+        }
+    });
+
+    if (!written && headerEnd != std::string::npos) {
+        out.insert(headerEnd, "Endpoint = " + endpoint + newline);
+    }
+    return out;
+}
+
+std::string WgQuickConfig::withInterfaceMtu(const std::string& text, uint32_t mtu) {
+    std::string line = "MTU = " + std::to_string(mtu);
+    std::string out;
+    out.reserve(text.size() + line.size() + 2);
+    bool written = false;
+    size_t headerEnd = std::string::npos;
+    std::string newline = text.find("\r\n") != std::string::npos ? "\r\n" : "\n";
+
+    forEachLine(text, [&](const std::string& current, size_t offset, Section section, int, const std::string& key,
+                          const std::string&) {
+        bool ours = section == Section::Interface;
+        if (ours && key == "mtu") {
+            if (!written) {
+                out += line + (current.empty() || current.back() != '\r' ? "" : "\r");
+                written = true;
+            }
+        } else {
+            out += current;
+        }
+        bool lastLine = offset + current.size() >= text.size();
+        if (!lastLine || (!text.empty() && text.back() == '\n')) {
+            out += '\n';
+        }
+        if (ours && key.empty() && headerEnd == std::string::npos) {
+            headerEnd = out.size();
+            if (lastLine && (text.empty() || text.back() != '\n')) {
+                out += newline;
+                headerEnd = out.size();
+            }
+        }
+    });
+
+    if (!written && headerEnd != std::string::npos) {
+        out.insert(headerEnd, line + newline);
+    }
+    return out;
+}
+
+bool WgQuickConfig::splitEndpoint(const std::string& endpoint, std::string& host, std::string& port) {
+    std::string value = trim(endpoint);
+    size_t colon;
+    if (!value.empty() && value.front() == '[') {
+        size_t close = value.find(']');
+        if (close == std::string::npos || close + 1 >= value.size() || value[close + 1] != ':') {
+            return false;
+        }
+        host = value.substr(1, close - 1);
+        colon = close + 1;
+    } else {
+        colon = value.rfind(':');
+        if (colon == std::string::npos || value.find(':') != colon) {
+            // No port, or a bare IPv6 address that would be ambiguous
+            return false;
+        }
+        host = value.substr(0, colon);
+    }
+    port = value.substr(colon + 1);
+    return !host.empty() && !port.empty() &&
+           std::all_of(port.begin(), port.end(), [](unsigned char c) { return std::isdigit(c) != 0; });
+}
+
+std::string WgQuickConfig::joinEndpoint(const std::string& host, const std::string& port) {
+    if (host.find(':') != std::string::npos) {
+        return "[" + host + "]:" + port;
+    }
+    return host + ":" + port;
+}
+
+bool WgQuickConfig::isAddressLiteral(const std::string& host) {
+    // Names cannot contain a colon, so anything with one is meant as IPv6
+    if (host.find(':') != std::string::npos) {
+        return true;
+    }
+    int parts = 0;
+    size_t offset = 0;
+    while (offset <= host.size()) {
+        size_t end = host.find('.', offset);
+        if (end == std::string::npos) {
+            end = host.size();
+        }
+        std::string part = host.substr(offset, end - offset);
+        if (part.empty() || part.size() > 3 ||
+            !std::all_of(part.begin(), part.end(), [](unsigned char c) { return std::isdigit(c) != 0; }) ||
+            std::stoi(part) > 255) {
+            return false;
+        }
+        parts++;
+        offset = end + 1;
+    }
+    return parts == 4;
+}
+
+bool WgQuickConfig::isKey(const std::string& text) {
+    // 43 characters carry the 32 bytes, the last one is padding
+    if (text.size() != 44 || text.back() != '=') {
+        return false;
+    }
+    return std::all_of(text.begin(), text.end() - 1,
+                       [](unsigned char c) { return std::isalnum(c) != 0 || c == '+' || c == '/'; });
+}
+
+std::vector<std::string> WgQuickConfig::endpointHosts() const {
+    std::vector<std::string> hosts;
+    for (const auto& peer : peers) {
+        std::string host;
+        std::string port;
+        if (splitEndpoint(peer.endpoint, host, port) && !isAddressLiteral(host) &&
+            std::find(hosts.begin(), hosts.end(), host) == hosts.end()) {
+            hosts.push_back(host);
+        }
+    }
+    return hosts;
+}
+
+std::string WgQuickConfig::innerGateway() const {
+    for (const auto& entry : addresses) {
+        size_t slash = entry.find('/');
+        std::string host = entry.substr(0, slash);
+        uint32_t prefix = 32;
+        if (slash != std::string::npos && !parseSmallNumber(entry.substr(slash + 1), prefix)) {
+            continue;
+        }
+        if (host.find(':') != std::string::npos || !isAddressLiteral(host) || prefix > 32) {
+            continue;
+        }
+
+        uint32_t address = 0;
+        size_t offset = 0;
+        for (int part = 0; part < 4; part++) {
+            size_t end = host.find('.', offset);
+            address = (address << 8) | static_cast<uint32_t>(std::stoul(host.substr(offset, end - offset)));
+            offset = end + 1;
+        }
+        // Point-to-point addresses say nothing about the gateway; a /24 is
+        // the common layout behind them
+        if (prefix > 30) {
+            prefix = 24;
+        }
+        uint32_t mask = prefix == 0 ? 0 : ~0u << (32 - prefix);
+        uint32_t gateway = (address & mask) + 1;
+        if (gateway == address) {
+            return std::string();
+        }
+        return std::to_string(gateway >> 24) + "." + std::to_string((gateway >> 16) & 0xff) + "." +
+               std::to_string((gateway >> 8) & 0xff) + "." + std::to_string(gateway & 0xff);
+    }
+    return std::string();
+}
+
+} // namespace wireguard_flutter
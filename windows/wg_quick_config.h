@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace wireguard_flutter {
+
+// The few settings of a wg-quick config the plugin needs itself; the tunnel
+// service still parses the full text. Section and key names are matched
+// case-insensitively, "#" starts a comment, values are kept as written
+// (keys in base64). Portable.
+struct WgQuickConfig {
+    struct Peer {
+        std::string publicKey;
+        std::string presharedKey;
+        std::string endpoint;
+        // Seconds; 0 for none
+        uint32_t persistentKeepalive = 0;
+    };
+
+    std::string privateKey;
+    // The interface's own addresses with their prefixes, e.g. "10.0.0.2/24"
+    std::vector<std::string> addresses;
+    // 0 when the config leaves it to the tunnel service
+    uint32_t mtu = 0;
+    std::vector<Peer> peers;
+
+    // False when there is no [Interface] section
+    static bool parse(const std::string& text, WgQuickConfig& out);
+
+    // |text| with the Endpoint of peer |peer| replaced, or added when the
+    // peer has none, and its PublicKey replaced unless |publicKey| is empty.
+    // Other lines are left exactly as they were.
+    static std::string withPeerEndpoint(const std::string& text, size_t peer, const std::string& endpoint,
+                                        const std::string& publicKey = std::string());
+
+    // |text| with the [Interface] MTU set to |mtu|, added when missing
+    static std::string withInterfaceMtu(const std::string& text, uint32_t mtu);
+
+    // Splits "host:port" or "[v6 address]:port"; false without a port
+    static bool splitEndpoint(const std::string& endpoint, std::string& host, std::string& port);
+
+    // The reverse, bracketing IPv6 addresses
+    static std::string joinEndpoint(const std::string& host, const std::string& port);
+
+    // True for an IPv4 or IPv6 address, false for a name to resolve
+    static bool isAddressLiteral(const std::string& host);
+
+    // True for a key as wg-quick writes it: 32 bytes in padded base64
+    static bool isKey(const std::string& text);
+
+    // Names in the peers' endpoints, each once, in order
+    std::vector<std::string> endpointHosts() const;
+
+    // Best guess at the peer's address inside the tunnel: the first host of
+    // the first IPv4 Address's network, or of its /24 for a /31 or /32.
+    // Empty without an IPv4 Address, or when the guess is our own address.
+    std::string innerGateway() const;
+};
+
+} // namespace wireguard_flutter
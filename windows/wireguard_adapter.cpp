@@ -0,0 +1,394 @@
+#include "wireguard_adapter.h"
+
+#include <iphlpapi.h>
+#include <libbase64.h>
+
+#include <cstring>
+
+#include "logger.h"
+
+// wireguard.h only declares the function types; the functions themselves
+// are resolved through wireguard.lib
+extern "C" {
+WIREGUARD_CREATE_ADAPTER_FUNC WireGuardCreateAdapter;
+WIREGUARD_OPEN_ADAPTER_FUNC WireGuardOpenAdapter;
+WIREGUARD_CLOSE_ADAPTER_FUNC WireGuardCloseAdapter;
+WIREGUARD_GET_ADAPTER_LUID_FUNC WireGuardGetAdapterLUID;
+WIREGUARD_GET_CONFIGURATION_FUNC WireGuardGetConfiguration;
+WIREGUARD_SET_CONFIGURATION_FUNC WireGuardSetConfiguration;
+WIREGUARD_SET_ADAPTER_LOGGING_FUNC WireGuardSetAdapterLogging;
+WIREGUARD_SET_ADAPTER_STATE_FUNC WireGuardSetAdapterState;
+}
+
+namespace wireguard_flutter {
+
+WireGuardAdapter::~WireGuardAdapter() {
+    close();
+}
+
+bool WireGuardAdapter::open(const std::wstring& name) {
+    close();
+    return attach(WireGuardOpenAdapter(name.c_str()), name, "Opened");
+}
+
+bool WireGuardAdapter::create(const std::wstring& name) {
+    close();
+    WIREGUARD_ADAPTER_HANDLE created = WireGuardCreateAdapter(name.c_str(), L"WireGuard", nullptr);
+    if (!created) {
+        WG_LOG_ERROR("WireGuardAdapter: Failed to create adapter {}. Error: {}", name, GetLastError());
+    }
+    return attach(created, name, "Created");
+}
+
+bool WireGuardAdapter::attach(WIREGUARD_ADAPTER_HANDLE adapter, const std::wstring& name, const char* verb) {
+    handle = adapter;
+    if (!handle) {
+        return false;
+    }
+
+    if (configBuffer.empty()) {
+        configBuffer.resize(4096);
+    }
+
+    // Driver messages for this adapter go to the logger DriverLog installed
+    if (!WireGuardSetAdapterLogging(handle, WIREGUARD_ADAPTER_LOG_ON)) {
+        WG_LOG_ERROR("WireGuardAdapter: Failed to enable driver logging. Error: {}", GetLastError());
+    }
+
+    WG_LOG_INFO("WireGuardAdapter: {} adapter {}", verb, name);
+    return true;
+}
+
+void WireGuardAdapter::close() {
+    if (handle) {
+        WireGuardCloseAdapter(handle);
+        handle = nullptr;
+    }
+}
+
+bool WireGuardAdapter::getLuid(NET_LUID& luid) {
+    if (!handle) {
+        return false;
+    }
+    WireGuardGetAdapterLUID(handle, &luid);
+    return true;
+}
+
+const WIREGUARD_INTERFACE* WireGuardAdapter::queryConfiguration() {
+    if (!handle) {
+        return nullptr;
+    }
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        DWORD bytes = static_cast<DWORD>(configBuffer.size());
+        auto* config = reinterpret_cast<WIREGUARD_INTERFACE*>(configBuffer.data());
+        if (WireGuardGetConfiguration(handle, config, &bytes)) {
+            return config;
+        }
+        if (GetLastError() != ERROR_MORE_DATA) {
+            return nullptr;
+        }
+        // Only grows when peers or allowed IPs are added
+        configBuffer.resize(bytes);
+    }
+    return nullptr;
+}
+
+bool WireGuardAdapter::queryLastHandshake(uint64_t& lastHandshake) {
+    const WIREGUARD_INTERFACE* config = queryConfiguration();
+    if (!config) {
+        return false;
+    }
+
+    lastHandshake = 0;
+
+    // Peers are laid out back to back, each followed by its allowed IPs
+    const BYTE* cursor = reinterpret_cast<const BYTE*>(config) + sizeof(WIREGUARD_INTERFACE);
+    for (DWORD i = 0; i < config->PeersCount; i++) {
+        const auto* peer = reinterpret_cast<const WIREGUARD_PEER*>(cursor);
+        if (peer->LastHandshake > lastHandshake) {
+            lastHandshake = peer->LastHandshake;
+        }
+        cursor += sizeof(WIREGUARD_PEER) + peer->AllowedIPsCount * sizeof(WIREGUARD_ALLOWED_IP);
+    }
+    return true;
+}
+
+bool WireGuardAdapter::queryPeerHandshake(const BYTE (&publicKey)[WIREGUARD_KEY_LENGTH], uint64_t& lastHandshake) {
+    const WIREGUARD_INTERFACE* config = queryConfiguration();
+    if (!config) {
+        return false;
+    }
+
+    const BYTE* cursor = reinterpret_cast<const BYTE*>(config) + sizeof(WIREGUARD_INTERFACE);
+    for (DWORD i = 0; i < config->PeersCount; i++) {
+        const auto* peer = reinterpret_cast<const WIREGUARD_PEER*>(cursor);
+        if (std::memcmp(peer->PublicKey, publicKey, WIREGUARD_KEY_LENGTH) == 0) {
+            lastHandshake = peer->LastHandshake;
+            return true;
+        }
+        cursor += sizeof(WIREGUARD_PEER) + peer->AllowedIPsCount * sizeof(WIREGUARD_ALLOWED_IP);
+    }
+    return false;
+}
+
+bool WireGuardAdapter::setConfiguration(const std::vector<BYTE>& config) {
+    if (!handle || config.size() < sizeof(WIREGUARD_INTERFACE)) {
+        return false;
+    }
+    const auto* header = reinterpret_cast<const WIREGUARD_INTERFACE*>(config.data());
+    if (!WireGuardSetConfiguration(handle, header, static_cast<DWORD>(config.size()))) {
+        WG_LOG_ERROR("WireGuardAdapter: Failed to set configuration. Error: {}", GetLastError());
+        return false;
+    }
+    return true;
+}
+
+bool WireGuardAdapter::setUp(bool up) {
+    if (!handle) {
+        return false;
+    }
+    if (!WireGuardSetAdapterState(handle, up ? WIREGUARD_ADAPTER_STATE_UP : WIREGUARD_ADAPTER_STATE_DOWN)) {
+        WG_LOG_ERROR("WireGuardAdapter: Failed to set adapter state. Error: {}", GetLastError());
+        return false;
+    }
+    return true;
+}
+
+bool WireGuardAdapter::reapplyEndpoints() {
+    const WIREGUARD_INTERFACE* config = queryConfiguration();
+    if (!config) {
+        return false;
+    }
+
+    // Interface flags stay zero so keys and listen port are left alone; each
+    // peer is matched by public key and sent without allowed IPs
+    std::vector<BYTE> update(sizeof(WIREGUARD_INTERFACE) + config->PeersCount * sizeof(WIREGUARD_PEER));
+    auto* header = reinterpret_cast<WIREGUARD_INTERFACE*>(update.data());
+    BYTE* out = update.data() + sizeof(WIREGUARD_INTERFACE);
+
+    const BYTE* cursor = reinterpret_cast<const BYTE*>(config) + sizeof(WIREGUARD_INTERFACE);
+    for (DWORD i = 0; i < config->PeersCount; i++) {
+        const auto* peer = reinterpret_cast<const WIREGUARD_PEER*>(cursor);
+        cursor += sizeof(WIREGUARD_PEER) + peer->AllowedIPsCount * sizeof(WIREGUARD_ALLOWED_IP);
+        if (peer->Endpoint.si_family == AF_UNSPEC) {
+            continue;
+        }
+
+        auto* target = reinterpret_cast<WIREGUARD_PEER*>(out);
+        int flags = WIREGUARD_PEER_HAS_PUBLIC_KEY | WIREGUARD_PEER_HAS_ENDPOINT | WIREGUARD_PEER_UPDATE;
+        if (peer->PersistentKeepalive != 0) {
+            flags |= WIREGUARD_PEER_HAS_PERSISTENT_KEEPALIVE;
+            target->PersistentKeepalive = peer->PersistentKeepalive;
+        }
+        target->Flags = static_cast<WIREGUARD_PEER_FLAG>(flags);
+        std::memcpy(target->PublicKey, peer->PublicKey, sizeof(target->PublicKey));
+        target->Endpoint = peer->Endpoint;
+        header->PeersCount++;
+        out += sizeof(WIREGUARD_PEER);
+    }
+
+    if (header->PeersCount == 0) {
+        return false;
+    }
+    if (!WireGuardSetConfiguration(handle, header, static_cast<DWORD>(out - update.data()))) {
+        WG_LOG_ERROR("WireGuardAdapter: Failed to re-apply endpoints. Error: {}", GetLastError());
+        return false;
+    }
+    return true;
+}
+
+bool WireGuardAdapter::forceHandshake() {
+    const WIREGUARD_INTERFACE* config = queryConfiguration();
+    if (!config || config->PeersCount == 0) {
+        return false;
+    }
+
+    const BYTE* begin = reinterpret_cast<const BYTE*>(config);
+    const BYTE* end = begin + sizeof(WIREGUARD_INTERFACE);
+    for (DWORD i = 0; i < config->PeersCount; i++) {
+        const auto* peer = reinterpret_cast<const WIREGUARD_PEER*>(end);
+        end += sizeof(WIREGUARD_PEER) + peer->AllowedIPsCount * sizeof(WIREGUARD_ALLOWED_IP);
+    }
+
+    // The same layout goes back in one call, so the peers are never missing
+    // for a packet; only the flags change
+    std::vector<BYTE> update(begin, end);
+    auto* header = reinterpret_cast<WIREGUARD_INTERFACE*>(update.data());
+    header->Flags = WIREGUARD_INTERFACE_REPLACE_PEERS;
+    BYTE* out = update.data() + sizeof(WIREGUARD_INTERFACE);
+    for (DWORD i = 0; i < header->PeersCount; i++) {
+        auto* peer = reinterpret_cast<WIREGUARD_PEER*>(out);
+        int flags = WIREGUARD_PEER_HAS_PUBLIC_KEY | WIREGUARD_PEER_HAS_PERSISTENT_KEEPALIVE |
+                    WIREGUARD_PEER_REPLACE_ALLOWED_IPS | (peer->Flags & WIREGUARD_PEER_HAS_PRESHARED_KEY);
+        if (peer->Endpoint.si_family != AF_UNSPEC) {
+            flags |= WIREGUARD_PEER_HAS_ENDPOINT;
+        }
+        peer->Flags = static_cast<WIREGUARD_PEER_FLAG>(flags);
+        peer->Reserved = 0;
+        out += sizeof(WIREGUARD_PEER) + peer->AllowedIPsCount * sizeof(WIREGUARD_ALLOWED_IP);
+    }
+
+    if (!WireGuardSetConfiguration(handle, header, static_cast<DWORD>(update.size()))) {
+        WG_LOG_ERROR("WireGuardAdapter: Failed to reset peers. Error: {}", GetLastError());
+        return false;
+    }
+    return true;
+}
+
+bool WireGuardAdapter::setIdlePeer(const BYTE (&publicKey)[WIREGUARD_KEY_LENGTH], const BYTE* presharedKey,
+                                   const SOCKADDR_INET* endpoint, WORD keepalive) {
+    std::vector<BYTE> update(sizeof(WIREGUARD_INTERFACE) + sizeof(WIREGUARD_PEER));
+    auto* header = reinterpret_cast<WIREGUARD_INTERFACE*>(update.data());
+    header->PeersCount = 1;
+    auto* peer = reinterpret_cast<WIREGUARD_PEER*>(update.data() + sizeof(WIREGUARD_INTERFACE));
+    int flags = WIREGUARD_PEER_HAS_PUBLIC_KEY | WIREGUARD_PEER_HAS_PERSISTENT_KEEPALIVE |
+                WIREGUARD_PEER_REPLACE_ALLOWED_IPS | WIREGUARD_PEER_UPDATE;
+    std::memcpy(peer->PublicKey, publicKey, WIREGUARD_KEY_LENGTH);
+    peer->PersistentKeepalive = keepalive;
+    if (presharedKey) {
+        flags |= WIREGUARD_PEER_HAS_PRESHARED_KEY;
+        std::memcpy(peer->PresharedKey, presharedKey, WIREGUARD_KEY_LENGTH);
+    }
+    if (endpoint) {
+        flags |= WIREGUARD_PEER_HAS_ENDPOINT;
+        peer->Endpoint = *endpoint;
+    }
+    peer->Flags = static_cast<WIREGUARD_PEER_FLAG>(flags);
+    return setConfiguration(update);
+}
+
+bool WireGuardAdapter::moveAllowedIps(const BYTE (&from)[WIREGUARD_KEY_LENGTH],
+                                      const BYTE (&to)[WIREGUARD_KEY_LENGTH]) {
+    const WIREGUARD_INTERFACE* config = queryConfiguration();
+    if (!config) {
+        return false;
+    }
+
+    const WIREGUARD_PEER* source = nullptr;
+    bool hasTarget = false;
+    const BYTE* cursor = reinterpret_cast<const BYTE*>(config) + sizeof(WIREGUARD_INTERFACE);
+    for (DWORD i = 0; i < config->PeersCount; i++) {
+        const auto* peer = reinterpret_cast<const WIREGUARD_PEER*>(cursor);
+        if (std::memcmp(peer->PublicKey, from, WIREGUARD_KEY_LENGTH) == 0) {
+            source = peer;
+        } else if (std::memcmp(peer->PublicKey, to, WIREGUARD_KEY_LENGTH) == 0) {
+            hasTarget = true;
+        }
+        cursor += sizeof(WIREGUARD_PEER) + peer->AllowedIPsCount * sizeof(WIREGUARD_ALLOWED_IP);
+    }
+    if (!source || !hasTarget) {
+        return false;
+    }
+
+    // The driver applies one configuration under its own lock, so the
+    // routing table never has the addresses on neither or both peers
+    size_t ipsBytes = source->AllowedIPsCount * sizeof(WIREGUARD_ALLOWED_IP);
+    std::vector<BYTE> update(sizeof(WIREGUARD_INTERFACE) + 2 * sizeof(WIREGUARD_PEER) + ipsBytes);
+    auto* header = reinterpret_cast<WIREGUARD_INTERFACE*>(update.data());
+    header->PeersCount = 2;
+    BYTE* out = update.data() + sizeof(WIREGUARD_INTERFACE);
+
+    auto* released = reinterpret_cast<WIREGUARD_PEER*>(out);
+    released->Flags = static_cast<WIREGUARD_PEER_FLAG>(WIREGUARD_PEER_HAS_PUBLIC_KEY |
+                                                       WIREGUARD_PEER_REPLACE_ALLOWED_IPS | WIREGUARD_PEER_UPDATE);
+    std::memcpy(released->PublicKey, from, WIREGUARD_KEY_LENGTH);
+    out += sizeof(WIREGUARD_PEER);
+
+    auto* taking = reinterpret_cast<WIREGUARD_PEER*>(out);
+    taking->Flags = static_cast<WIREGUARD_PEER_FLAG>(WIREGUARD_PEER_HAS_PUBLIC_KEY |
+                                                     WIREGUARD_PEER_REPLACE_ALLOWED_IPS | WIREGUARD_PEER_UPDATE);
+    std::memcpy(taking->PublicKey, to, WIREGUARD_KEY_LENGTH);
+    taking->AllowedIPsCount = source->AllowedIPsCount;
+    out += sizeof(WIREGUARD_PEER);
+    std::memcpy(out, reinterpret_cast<const BYTE*>(source) + sizeof(WIREGUARD_PEER), ipsBytes);
+
+    if (!WireGuardSetConfiguration(handle, header, static_cast<DWORD>(update.size()))) {
+        WG_LOG_ERROR("WireGuardAdapter: Failed to move allowed IPs. Error: {}", GetLastError());
+        return false;
+    }
+    return true;
+}
+
+bool WireGuardAdapter::removePeer(const BYTE (&publicKey)[WIREGUARD_KEY_LENGTH]) {
+    std::vector<BYTE> update(sizeof(WIREGUARD_INTERFACE) + sizeof(WIREGUARD_PEER));
+    auto* header = reinterpret_cast<WIREGUARD_INTERFACE*>(update.data());
+    header->PeersCount = 1;
+    auto* peer = reinterpret_cast<WIREGUARD_PEER*>(update.data() + sizeof(WIREGUARD_INTERFACE));
+    peer->Flags = static_cast<WIREGUARD_PEER_FLAG>(WIREGUARD_PEER_HAS_PUBLIC_KEY | WIREGUARD_PEER_REMOVE);
+    std::memcpy(peer->PublicKey, publicKey, WIREGUARD_KEY_LENGTH);
+    return setConfiguration(update);
+}
+
+bool WireGuardAdapter::setPersistentKeepalive(const BYTE (&publicKey)[WIREGUARD_KEY_LENGTH], WORD keepalive) {
+    std::vector<BYTE> update(sizeof(WIREGUARD_INTERFACE) + sizeof(WIREGUARD_PEER));
+    auto* header = reinterpret_cast<WIREGUARD_INTERFACE*>(update.data());
+    header->PeersCount = 1;
+    auto* peer = reinterpret_cast<WIREGUARD_PEER*>(update.data() + sizeof(WIREGUARD_INTERFACE));
+    peer->Flags = static_cast<WIREGUARD_PEER_FLAG>(WIREGUARD_PEER_HAS_PUBLIC_KEY |
+                                                   WIREGUARD_PEER_HAS_PERSISTENT_KEEPALIVE | WIREGUARD_PEER_UPDATE);
+    std::memcpy(peer->PublicKey, publicKey, WIREGUARD_KEY_LENGTH);
+    peer->PersistentKeepalive = keepalive;
+    return setConfiguration(update);
+}
+
+bool WireGuardAdapter::setMtu(ULONG mtu) {
+    NET_LUID luid;
+    if (!getLuid(luid)) {
+        return false;
+    }
+    bool applied = false;
+    for (int family : {AF_INET, AF_INET6}) {
+        if (family == AF_INET6 && mtu < 1280) {
+            continue;
+        }
+        MIB_IPINTERFACE_ROW row;
+        InitializeIpInterfaceEntry(&row);
+        row.Family = static_cast<ADDRESS_FAMILY>(family);
+        row.InterfaceLuid = luid;
+        if (GetIpInterfaceEntry(&row) != NO_ERROR) {
+            // The family is not bound to the adapter
+            continue;
+        }
+        if (row.NlMtu != mtu) {
+            row.NlMtu = mtu;
+            // Set calls reject the prefix length that Get returns for IPv4
+            row.SitePrefixLength = 0;
+            DWORD error = SetIpInterfaceEntry(&row);
+            if (error != NO_ERROR) {
+                WG_LOG_WARN("WireGuardAdapter: Failed to set the MTU for family {}. Error: {}", family, error);
+                continue;
+            }
+        }
+        applied = true;
+    }
+    return applied;
+}
+
+int64_t WireGuardAdapter::handshakeAgeMs(uint64_t lastHandshake) {
+    if (lastHandshake == 0) {
+        return -1;
+    }
+
+    // LastHandshake is a FILETIME, so this is the one wall-clock comparison
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    uint64_t nowTicks = (static_cast<uint64_t>(now.dwHighDateTime) << 32) | now.dwLowDateTime;
+
+    return nowTicks > lastHandshake ? static_cast<int64_t>((nowTicks - lastHandshake) / 10000) : 0;
+}
+
+bool WireGuardAdapter::decodeKey(const std::string& text, BYTE (&key)[WIREGUARD_KEY_LENGTH]) {
+    // 44 characters of base64 hold a key; the buffer leaves room for one more
+    // decoded block so a longer string fails on length, not on overflow
+    char decoded[48];
+    size_t length = 0;
+    if (text.empty() || text.size() > 44 || !base64_decode(text.data(), text.size(), decoded, &length, 0) ||
+        length != WIREGUARD_KEY_LENGTH) {
+        return false;
+    }
+    std::memcpy(key, decoded, WIREGUARD_KEY_LENGTH);
+    return true;
+}
+
+} // namespace wireguard_flutter
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <winsock2.h>
+#include <windows.h>
+#include <ifdef.h>
+#include <string>
+#include <vector>
+
+#include <wireguard.h>
+
+namespace wireguard_flutter {
+
+// Thin wrapper over the wireguard.dll adapter API for the adapter the tunnel
+// service creates. The service names the adapter after the config file, so
+// the plugin can open it by name from its own process.
+class WireGuardAdapter {
+private:
+    WIREGUARD_ADAPTER_HANDLE handle = nullptr;
+
+    // Reused between queries so polling the configuration does not allocate
+    std::vector<BYTE> configBuffer;
+
+public:
+    WireGuardAdapter() = default;
+    ~WireGuardAdapter();
+
+    WireGuardAdapter(const WireGuardAdapter&) = delete;
+    WireGuardAdapter& operator=(const WireGuardAdapter&) = delete;
+
+    bool open(const std::wstring& name);
+    // Creates an adapter owned by this process; close() removes it again
+    bool create(const std::wstring& name);
+    void close();
+    bool isOpen() const { return handle != nullptr; }
+
+    bool getLuid(NET_LUID& luid);
+
+    // Most recent handshake over all peers, in 100ns intervals since
+    // 1601-01-01 UTC; 0 when no handshake has completed yet
+    bool queryLastHandshake(uint64_t& lastHandshake);
+    // The same for the peer with |publicKey|; false when there is no such peer
+    bool queryPeerHandshake(const BYTE (&publicKey)[WIREGUARD_KEY_LENGTH], uint64_t& lastHandshake);
+
+    // Applies |config|, a WIREGUARD_INTERFACE followed by its peers
+    bool setConfiguration(const std::vector<BYTE>& config);
+    bool setUp(bool up);
+
+    // Sets every peer's endpoint to what it already is. The driver then
+    // drops the cached source address and route, so after a network change
+    // packets leave through the new interface; peers with a persistent
+    // keepalive also send one right away. Keys and allowed IPs are untouched.
+    bool reapplyEndpoints();
+
+    // Removes the peers and adds them back exactly as they were, which drops
+    // their sessions, so the next packet out starts a new handshake.
+    bool forceHandshake();
+
+    // Adds the peer, or updates it, without allowed IPs and with a persistent
+    // keepalive; a null preshared key or endpoint keeps the current one
+    bool setIdlePeer(const BYTE (&publicKey)[WIREGUARD_KEY_LENGTH], const BYTE* presharedKey,
+                     const SOCKADDR_INET* endpoint, WORD keepalive);
+    // Gives |to| the allowed IPs of |from| and leaves |from| without any, in
+    // one update, so no packet finds neither
+    bool moveAllowedIps(const BYTE (&from)[WIREGUARD_KEY_LENGTH], const BYTE (&to)[WIREGUARD_KEY_LENGTH]);
+    bool removePeer(const BYTE (&publicKey)[WIREGUARD_KEY_LENGTH]);
+    // Changes an existing peer's persistent keepalive, 0 for none, leaving
+    // its session alone
+    bool setPersistentKeepalive(const BYTE (&publicKey)[WIREGUARD_KEY_LENGTH], WORD keepalive);
+
+    // Sets the IP interface MTU of both families, skipping IPv6 under its
+    // minimum of 1280; true when at least one took it
+    bool setMtu(ULONG mtu);
+
+    // Milliseconds since a LastHandshake time; -1 for 0, i.e. none yet
+    static int64_t handshakeAgeMs(uint64_t lastHandshake);
+
+    // Decodes a base64 key as written in wg-quick configs
+    static bool decodeKey(const std::string& text, BYTE (&key)[WIREGUARD_KEY_LENGTH]);
+
+private:
+    bool attach(WIREGUARD_ADAPTER_HANDLE adapter, const std::wstring& name, const char* verb);
+    const WIREGUARD_INTERFACE* queryConfiguration();
+};
+
+} // namespace wireguard_flutter
@@ -11,11 +11,22 @@
 #include <libbase64.h>
 #include <windows.h>
 
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
 #include <memory>
+#include <optional>
 #include <sstream>
 
+#include "endpoint_prober.h"
+#include "instrumented_method_result.h"
+#include "logger.h"
+#include "throughput_test.h"
+#include "trace_recorder.h"
 #include "wireguard_tunnel_manager.h"
+#include "tunnel_stats.h"
 #include "utils.h"
+#include "wg_quick_config.h"
 
 using namespace flutter;
 using namespace std;
@@ -31,7 +42,7 @@ namespace wireguard_flutter
     auto eventChannel = make_unique<EventChannel<EncodableValue>>(
         registrar->messenger(), "billion.group.wireguard_flutter/wgstage", &StandardMethodCodec::GetInstance());
 
-    auto plugin = make_unique<WireguardFlutterPlugin>();
+    auto plugin = make_unique<WireguardFlutterPlugin>(registrar);
 
     channel->SetMethodCallHandler([plugin_pointer = plugin.get()](const auto &call, auto result)
                                   { plugin_pointer->HandleMethodCall(call, move(result)); });
@@ -52,30 +63,99 @@ namespace wireguard_flutter
 
     eventChannel->SetStreamHandler(move(eventsHandler));
 
+    auto logChannel = make_unique<EventChannel<EncodableValue>>(
+        registrar->messenger(), "billion.group.wireguard_flutter/wglog", &StandardMethodCodec::GetInstance());
+    logChannel->SetStreamHandler(make_unique<StreamHandlerFunctions<EncodableValue>>(
+        [plugin_pointer = plugin.get()](
+            const EncodableValue *arguments,
+            unique_ptr<EventSink<EncodableValue>> &&events)
+            -> unique_ptr<StreamHandlerError<EncodableValue>>
+        {
+          return plugin_pointer->OnLogListen(arguments, move(events));
+        },
+        [plugin_pointer = plugin.get()](const EncodableValue *arguments)
+            -> unique_ptr<StreamHandlerError<EncodableValue>>
+        {
+          return plugin_pointer->OnLogCancel(arguments);
+        }));
+
     registrar->AddPlugin(move(plugin));
   }
 
-  WireguardFlutterPlugin::WireguardFlutterPlugin() {
-    // Create tunnel manager
-    tunnel_manager_ = make_unique<WireGuardTunnelManager>();
-    cout << "WireguardFlutterPlugin: Created with embedded tunnel manager" << endl;
+  WireguardFlutterPlugin::WireguardFlutterPlugin(PluginRegistrarWindows *registrar) {
+    TraceRecorder::nameThread("platform");
+    loop_ = make_unique<EventLoop>();
+    if (!loop_->start()) {
+      WG_LOG_ERROR("WireguardFlutterPlugin: Event loop failed to start");
+    }
+    dispatcher_ = make_unique<EventDispatcher>(registrar);
+
+    // Driver messages are captured from the start, so getDriverLogs covers
+    // the first connect too
+    log_dispatcher_ = make_unique<EventDispatcher>(registrar);
+    DriverLog::instance().attach(*loop_, *log_dispatcher_);
+
+    // Usage survives disconnects and restarts in a ledger under LOCALAPPDATA
+    usage_ledger_ = make_unique<UsageLedger>(filesystem::path(GetDataDirectory()) / L"usage.ledger");
+    if (!usage_ledger_->open()) {
+      WG_LOG_ERROR("WireguardFlutterPlugin: Usage ledger unavailable");
+    }
+
+    // Connect phase histograms accumulate across sessions next to the ledger
+    connect_timings_ = make_unique<ConnectTimingStore>(filesystem::path(GetDataDirectory()) / L"connect_timings.bin");
+    connect_timings_->load();
+
+    dns_resolver_ = make_unique<DnsResolver>();
+    resolver_cache_ = make_unique<ResolverCache>(
+        [resolver = dns_resolver_.get()](const string &host, function<void(ResolverCache::Answer)> done)
+        { resolver->resolve(host, move(done)); });
+    race_adapters_ = make_unique<RaceAdapters>();
+
+    // Tunnels are created on first use and share the loop's monitor tick
+    tunnel_managers_ = make_unique<TunnelManagers>(*loop_, dispatcher_.get(),
+                                                   usage_ledger_->isOpen() ? usage_ledger_.get() : nullptr,
+                                                   connect_timings_.get(), resolver_cache_.get(), race_adapters_.get());
+    tunnels_ = make_unique<TunnelRegistry>(*loop_, *tunnel_managers_, resolver_cache_.get());
+    dispatcher_->setDefaultTunnel(default_tunnel_);
+    WG_LOG_INFO("WireguardFlutterPlugin: Created with embedded tunnel manager");
   }
 
-  WireguardFlutterPlugin::~WireguardFlutterPlugin() {}
+  WireguardFlutterPlugin::~WireguardFlutterPlugin()
+  {
+    {
+      lock_guard<mutex> lock(pending_replies_->mutex);
+      pending_replies_->closed = true;
+    }
+    // The logger outlives the plugin; it must stop using the loop first
+    DriverLog::instance().detach();
+    // Method spans point at names owned by method_metrics_
+    TraceRecorder::instance().setEnabled(false);
+    TraceRecorder::instance().clear();
+    // Nothing may be left running once the plugin is unloaded; what the
+    // members log while they are destroyed is written synchronously
+    Logger::instance().shutdown();
+  }
 
   void WireguardFlutterPlugin::HandleMethodCall(const MethodCall<EncodableValue> &call,
                                                 unique_ptr<MethodResult<EncodableValue>> result)
   {
+    // Counted and timed until whichever branch below completes the result
+    result = make_unique<InstrumentedMethodResult>(move(result), method_metrics_.method(call.method_name()));
     const auto *args = get_if<EncodableMap>(call.arguments());
 
     if (call.method_name() == "initialize")
     {
       // For the embedded approach, we don't need win32ServiceName
       // Just acknowledge initialization
-      cout << "WireguardFlutterPlugin: Initialize called (embedded mode)" << endl;
+      WG_LOG_INFO("WireguardFlutterPlugin: Initialize called (embedded mode)");
       
-      if (tunnel_manager_ && events_) {
-        tunnel_manager_->setEventSink(events_.get());
+      // The interface name is the tunnel used when a call names none
+      if (args) {
+        const auto *name = get_if<string>(ValueOrNull(*args, "win32ServiceName"));
+        if (name && !name->empty()) {
+          default_tunnel_ = *name;
+          dispatcher_->setDefaultTunnel(default_tunnel_);
+        }
       }
       
       result->Success();
@@ -83,11 +163,16 @@ namespace wireguard_flutter
     }
     else if (call.method_name() == "start")
     {
-      if (tunnel_manager_ == nullptr)
+      if (tunnels_ == nullptr)
       {
         result->Error("Invalid state: tunnel manager not initialized");
         return;
       }
+      if (args == nullptr)
+      {
+        result->Error("Argument 'wgQuickConfig' is required");
+        return;
+      }
       
       const auto *wgQuickConfig = get_if<string>(ValueOrNull(*args, "wgQuickConfig"));
       if (wgQuickConfig == NULL)
@@ -96,36 +181,108 @@ namespace wireguard_flutter
         return;
       }
 
-      cout << "WireguardFlutterPlugin: Starting tunnel with embedded approach" << endl;
+      string name = TunnelName(args);
+      WG_LOG_INFO("WireguardFlutterPlugin: Starting tunnel {} with embedded approach", name);
       
+      // Extra endpoints to race against the config's own
+      vector<EndpointRacer::Candidate> raceCandidates;
+      if (const auto *endpoints = get_if<EncodableList>(ValueOrNull(*args, "raceEndpoints")))
+      {
+        for (const auto &value : *endpoints)
+        {
+          const auto *map = get_if<EncodableMap>(&value);
+          const auto *endpoint = map ? get_if<string>(ValueOrNull(*map, "endpoint")) : nullptr;
+          if (endpoint == nullptr || endpoint->empty())
+          {
+            result->Error("Each entry of 'raceEndpoints' needs an 'endpoint'");
+            return;
+          }
+          const auto *publicKey = get_if<string>(ValueOrNull(*map, "publicKey"));
+          raceCandidates.push_back(EndpointRacer::Candidate{*endpoint, publicKey ? *publicKey : string()});
+        }
+      }
+      EndpointRace::Options raceOptions;
+      int64_t raceTimeoutMs = 0;
+      if (IntValue(*args, "raceTimeoutMs", raceTimeoutMs) && raceTimeoutMs > 0)
+      {
+        raceOptions.timeout = chrono::milliseconds(raceTimeoutMs);
+      }
+      
+      // Answered on the platform thread once the service is started on the
+      // loop, which first waits for the endpoint names
+      shared_ptr<MethodResult<EncodableValue>> pending(move(result));
+      auto *dispatcher = dispatcher_.get();
+      auto *tunnels = tunnels_.get();
+      auto replies = pending_replies_;
       try
       {
-        bool success = tunnel_manager_->startTunnel(*wgQuickConfig);
-        if (success) {
-          result->Success();
-        } else {
-          result->Error("Failed to start tunnel");
+        bool started = TunnelManagers::manager(tunnels_->getOrCreate(name)).startTunnel(
+            *wgQuickConfig, raceCandidates, raceOptions,
+            [pending, dispatcher, tunnels, replies](bool success)
+            {
+              lock_guard<mutex> lock(replies->mutex);
+              if (replies->closed)
+              {
+                return;
+              }
+              if (success)
+              {
+                tunnels->ensureTicking();
+                dispatcher->postTask([pending]()
+                                     { pending->Success(); });
+              }
+              else
+              {
+                dispatcher->postTask([pending]()
+                                     { pending->Error("Failed to start tunnel"); });
+              }
+            });
+        if (!started)
+        {
+          pending->Error("Failed to start tunnel");
         }
       }
       catch (exception &e)
       {
-        result->Error(string("Tunnel start error: ").append(e.what()));
+        pending->Error(string("Tunnel start error: ").append(e.what()));
       }
       return;
     }
+    else if (call.method_name() == "prewarm")
+    {
+      const auto *wgQuickConfig = args ? get_if<string>(ValueOrNull(*args, "wgQuickConfig")) : nullptr;
+      if (wgQuickConfig == nullptr)
+      {
+        result->Error("Argument 'wgQuickConfig' is required");
+        return;
+      }
+      WgQuickConfig config;
+      if (!WgQuickConfig::parse(*wgQuickConfig, config))
+      {
+        result->Error("Argument 'wgQuickConfig' has no [Interface] section");
+        return;
+      }
+
+      // Only starts the queries; a later start finds the answers cached
+      auto hosts = config.endpointHosts();
+      resolver_cache_->prefetch(hosts, ResolverCache::Clock::now());
+      WG_LOG_INFO("WireguardFlutterPlugin: Resolving {} endpoint names ahead of a start", hosts.size());
+      result->Success();
+      return;
+    }
     else if (call.method_name() == "stop")
     {
-      if (tunnel_manager_ == nullptr)
+      auto *tunnel = FindTunnel(args, *result);
+      if (tunnel == nullptr)
       {
-        result->Error("Invalid state: tunnel manager not initialized");
         return;
       }
 
-      cout << "WireguardFlutterPlugin: Stopping tunnel" << endl;
+      WG_LOG_INFO("WireguardFlutterPlugin: Stopping tunnel");
       
       try
       {
-        tunnel_manager_->stopTunnel();
+        tunnel->stopTunnel();
         result->Success();
       }
       catch (exception &e)
@@ -134,37 +291,54 @@ namespace wireguard_flutter
       }
       return;
     }
+    else if (call.method_name() == "refresh")
+    {
+      auto *tunnel = FindTunnel(args, *result);
+      if (tunnel == nullptr)
+      {
+        return;
+      }
+
+      // Re-sent through the event channel like any other stage change
+      tunnel->refreshStatus();
+      result->Success();
+      return;
+    }
     else if (call.method_name() == "stage")
     {
-      if (tunnel_manager_ == nullptr)
+      auto *tunnel = FindTunnel(args, *result);
+      if (tunnel == nullptr)
       {
-        result->Error("Invalid state: tunnel manager not initialized");
         return;
       }
 
-      string status = tunnel_manager_->getStatus();
+      string status = tunnel->getStatus();
       result->Success(status);
       return;
     }
     else if (call.method_name() == "getWireGuardStatistics")
     {
-      if (tunnel_manager_ == nullptr)
+      auto *tunnel = FindTunnel(args, *result);
+      if (tunnel == nullptr)
       {
-        result->Error("Invalid state: tunnel manager not initialized");
         return;
       }
 
+      // Keeps the sampler running while Dart polls
+      tunnels_->noteStatisticsRead();
+
       try
       {
-        auto stats = tunnel_manager_->getStatistics();
+        TunnelStats stats;
+        tunnel->getStatistics(stats);
         
-        EncodableMap statsMap;
-        statsMap[EncodableValue("byte_in")] = EncodableValue(static_cast<int64_t>(stats["byte_in"]));
-        statsMap[EncodableValue("byte_out")] = EncodableValue(static_cast<int64_t>(stats["byte_out"]));
-        statsMap[EncodableValue("speed_in_bps")] = EncodableValue(static_cast<int64_t>(stats["speed_in_bps"]));
-        statsMap[EncodableValue("speed_out_bps")] = EncodableValue(static_cast<int64_t>(stats["speed_out_bps"]));
+        // One typed buffer instead of a map of string keys; decoded by
+        // WireGuardStatistics on the Dart side. The reply is kept, so after
+        // the first call encoding it neither allocates nor copies.
+        auto &buffer = get<vector<int64_t>>(stats_reply_);
+        EncodeTunnelStats(stats, buffer);
         
-        result->Success(EncodableValue(statsMap));
+        result->Success(stats_reply_);
       }
       catch (exception &e)
       {
@@ -173,29 +347,843 @@ namespace wireguard_flutter
       return;
     }
 
+    else if (call.method_name() == "getWireGuardStatisticsHistory")
+    {
+      auto *tunnel = FindTunnel(args, *result);
+      if (tunnel == nullptr)
+      {
+        return;
+      }
+
+      // Keeps the sampler running while Dart polls
+      tunnels_->noteStatisticsRead();
+
+      int64_t maxSamples = static_cast<int64_t>(StatsHistory::kCapacity);
+      if (args != nullptr)
+      {
+        IntValue(*args, "maxSamples", maxSamples);
+      }
+
+      vector<int64_t> buffer;
+      tunnel->getStatisticsHistory(static_cast<size_t>(max<int64_t>(maxSamples, 0)), buffer);
+      result->Success(EncodableValue(move(buffer)));
+      return;
+    }
+    else if (call.method_name() == "getDataUsage")
+    {
+      if (!usage_ledger_->isOpen())
+      {
+        result->Error("Usage ledger unavailable");
+        return;
+      }
+
+      string tunnel;
+      if (args != nullptr)
+      {
+        if (const auto *name = get_if<string>(ValueOrNull(*args, "tunnel")))
+        {
+          tunnel = *name;
+        }
+      }
+
+      EncodableList entries;
+      for (const auto &entry : usage_ledger_->usage(tunnel))
+      {
+        entries.push_back(EncodableValue(EncodableMap{
+            {EncodableValue("tunnel"), EncodableValue(entry.tunnel)},
+            {EncodableValue("day"), EncodableValue(static_cast<int64_t>(entry.day))},
+            {EncodableValue("bytesIn"), EncodableValue(static_cast<int64_t>(entry.bytesIn))},
+            {EncodableValue("bytesOut"), EncodableValue(static_cast<int64_t>(entry.bytesOut))},
+        }));
+      }
+      result->Success(EncodableValue(entries));
+      return;
+    }
+    else if (call.method_name() == "setDataQuota")
+    {
+      if (args == nullptr)
+      {
+        result->Error("Arguments are required");
+        return;
+      }
+
+      UsageLedger::Quota quota;
+      int64_t limitBytes = 0;
+      if (!IntValue(*args, "limitBytes", limitBytes) || limitBytes <= 0)
+      {
+        result->Error("Argument 'limitBytes' must be a positive integer");
+        return;
+      }
+      quota.limitBytes = static_cast<uint64_t>(limitBytes);
+
+      if (const auto *tunnel = get_if<string>(ValueOrNull(*args, "tunnel")))
+      {
+        quota.tunnel = *tunnel;
+      }
+      if (const auto *period = get_if<string>(ValueOrNull(*args, "period")))
+      {
+        if (!UsageLedger::parsePeriod(*period, quota.period))
+        {
+          result->Error("Argument 'period' must be 'day', 'month' or 'total'");
+          return;
+        }
+      }
+      if (const auto *action = get_if<string>(ValueOrNull(*args, "action")))
+      {
+        if (!UsageLedger::parseAction(*action, quota.action))
+        {
+          result->Error("Argument 'action' must be 'notify' or 'disconnect'");
+          return;
+        }
+      }
+
+      usage_ledger_->setQuota(quota);
+      result->Success();
+      return;
+    }
+    else if (call.method_name() == "clearDataQuotas")
+    {
+      string tunnel;
+      if (args != nullptr)
+      {
+        if (const auto *name = get_if<string>(ValueOrNull(*args, "tunnel")))
+        {
+          tunnel = *name;
+        }
+      }
+      usage_ledger_->clearQuotas(tunnel);
+      result->Success();
+      return;
+    }
+    else if (call.method_name() == "getTunnels")
+    {
+      EncodableList list;
+      for (auto *registered : tunnels_->tunnels())
+      {
+        auto *tunnel = &TunnelManagers::manager(*registered);
+        list.push_back(EncodableValue(EncodableMap{
+            {EncodableValue("tunnel"), EncodableValue(tunnel->name())},
+            {EncodableValue("stage"), EncodableValue(tunnel->getStatus())},
+            {EncodableValue("statsBlock"), EncodableValue(tunnel->getStatsBlockIndex())},
+        }));
+      }
+      result->Success(EncodableValue(list));
+      return;
+    }
+    else if (call.method_name() == "getDriverLogs")
+    {
+      int64_t maxEntries = 100;
+      LogLevel minLevel = LogLevel::Info;
+      if (args)
+      {
+        IntValue(*args, "maxEntries", maxEntries);
+        const auto *level = get_if<string>(ValueOrNull(*args, "minLevel"));
+        if (level && !parseLogLevel(*level, minLevel))
+        {
+          result->Error("Argument 'minLevel' must be debug, info, warn or error");
+          return;
+        }
+      }
+
+      // The ring holds no more than its capacity anyway
+      auto count = static_cast<size_t>(clamp<int64_t>(maxEntries, 0, static_cast<int64_t>(LogRing::kDefaultCapacity)));
+      vector<LogRing::Entry> entries;
+      DriverLog::instance().tail(count, minLevel, entries);
+      EncodableList list;
+      list.reserve(entries.size());
+      for (const auto &entry : entries)
+      {
+        list.push_back(EncodableValue(EncodableMap{
+            {EncodableValue("seq"), EncodableValue(static_cast<int64_t>(entry.sequence))},
+            {EncodableValue("timestampMs"), EncodableValue(entry.timestampMs)},
+            {EncodableValue("level"), EncodableValue(logLevelName(entry.level))},
+            {EncodableValue("message"), EncodableValue(entry.message)},
+        }));
+      }
+      result->Success(EncodableValue(list));
+      return;
+    }
+    else if (call.method_name() == "getConnectTimings")
+    {
+      // Latest breakdown of one tunnel, histograms of every connect so far
+      string name = TunnelName(args);
+      EncodableMap response;
+      response[EncodableValue("tunnel")] = EncodableValue(name);
+
+      ConnectBreakdown latest;
+      if (connect_timings_->latest(name, latest))
+      {
+        EncodableMap phases;
+        for (size_t i = 0; i < kConnectPhaseCount; i++)
+        {
+          if (latest.phaseMs[i] >= 0)
+          {
+            phases[EncodableValue(connectPhaseName(static_cast<ConnectPhase>(i)))] = EncodableValue(latest.phaseMs[i]);
+          }
+        }
+        response[EncodableValue("latest")] = EncodableValue(EncodableMap{
+            {EncodableValue("startedAtMs"), EncodableValue(latest.startedAtMs)},
+            {EncodableValue("finished"), EncodableValue(latest.finished)},
+            {EncodableValue("phases"), EncodableValue(phases)},
+        });
+      }
+
+      EncodableMap histograms;
+      auto aggregated = connect_timings_->histograms();
+      for (size_t i = 0; i < kConnectPhaseCount; i++)
+      {
+        const auto &histogram = aggregated[i];
+        histograms[EncodableValue(connectPhaseName(static_cast<ConnectPhase>(i)))] = EncodableValue(EncodableMap{
+            {EncodableValue("count"), EncodableValue(static_cast<int64_t>(histogram.count()))},
+            {EncodableValue("meanMs"), EncodableValue(histogram.mean())},
+            {EncodableValue("p50Ms"), EncodableValue(histogram.percentile(50))},
+            {EncodableValue("p90Ms"), EncodableValue(histogram.percentile(90))},
+            {EncodableValue("p99Ms"), EncodableValue(histogram.percentile(99))},
+            {EncodableValue("maxMs"), EncodableValue(histogram.max())},
+        });
+      }
+      response[EncodableValue("histograms")] = EncodableValue(histograms);
+
+      result->Success(EncodableValue(response));
+      return;
+    }
+    else if (call.method_name() == "getPluginMetrics")
+    {
+      // Lifetime average of the loop's wakeups, timers and polls included
+      auto uptimeMs = chrono::duration_cast<chrono::milliseconds>(loop_->uptime()).count();
+      auto wakeups = loop_->wakeups();
+      double wakeupsPerHour = uptimeMs > 0 ? static_cast<double>(wakeups) * 3600000.0 / static_cast<double>(uptimeMs) : 0.0;
+      auto monitor = tunnels_->metrics();
+
+      vector<MethodMetrics::Summary> summaries;
+      method_metrics_.summarize(summaries);
+      EncodableMap methods;
+      for (const auto &summary : summaries)
+      {
+        const auto &latency = summary.latencyUs;
+        methods[EncodableValue(summary.name)] = EncodableValue(EncodableMap{
+            {EncodableValue("calls"), EncodableValue(static_cast<int64_t>(summary.calls))},
+            {EncodableValue("errors"), EncodableValue(static_cast<int64_t>(summary.errors))},
+            {EncodableValue("meanUs"), EncodableValue(latency.mean())},
+            {EncodableValue("p50Us"), EncodableValue(latency.percentile(50))},
+            {EncodableValue("p90Us"), EncodableValue(latency.percentile(90))},
+            {EncodableValue("p99Us"), EncodableValue(latency.percentile(99))},
+            {EncodableValue("maxUs"), EncodableValue(latency.max())},
+        });
+      }
+      auto sinceResetMs = chrono::duration_cast<chrono::milliseconds>(method_metrics_.sinceReset()).count();
+
+      result->Success(EncodableValue(EncodableMap{
+          {EncodableValue("uptimeMs"), EncodableValue(static_cast<int64_t>(uptimeMs))},
+          {EncodableValue("wakeups"), EncodableValue(static_cast<int64_t>(wakeups))},
+          {EncodableValue("wakeupsPerHour"), EncodableValue(wakeupsPerHour)},
+          {EncodableValue("monitorTicks"), EncodableValue(static_cast<int64_t>(monitor.ticks))},
+          {EncodableValue("monitorIntervalMs"), EncodableValue(static_cast<int64_t>(monitor.interval.count()))},
+          {EncodableValue("monitorIdle"), EncodableValue(monitor.idle)},
+          {EncodableValue("sinceResetMs"), EncodableValue(static_cast<int64_t>(sinceResetMs))},
+          {EncodableValue("methods"), EncodableValue(methods)},
+          {EncodableValue("logLevel"), EncodableValue(logLevelName(Logger::currentLevel()))},
+          {EncodableValue("logsDropped"), EncodableValue(static_cast<int64_t>(Logger::instance().dropped()))},
+      }));
+      return;
+    }
+    else if (call.method_name() == "resetPluginMetrics")
+    {
+      method_metrics_.reset();
+      result->Success();
+      return;
+    }
+    else if (call.method_name() == "setTracing")
+    {
+      const auto *enabled = args ? get_if<bool>(ValueOrNull(*args, "enabled")) : nullptr;
+      if (enabled == nullptr)
+      {
+        result->Error("Argument 'enabled' is required");
+        return;
+      }
+      TraceRecorder::instance().setEnabled(*enabled);
+      result->Success();
+      return;
+    }
+    else if (call.method_name() == "dumpTrace")
+    {
+      // Chrome trace-event JSON, for Perfetto or chrome://tracing
+      filesystem::path path;
+      const auto *requested = args ? get_if<string>(ValueOrNull(*args, "path")) : nullptr;
+      if (requested && !requested->empty())
+      {
+        path = Utf8ToWide(*requested);
+      }
+      else
+      {
+        auto stamp = chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+        path = filesystem::path(GetDataDirectory()) / (L"trace_" + to_wstring(stamp) + L".json");
+      }
+
+      size_t events = 0;
+      if (!TraceRecorder::instance().dump(path, events))
+      {
+        result->Error("Failed to write trace to " + WideToUtf8(path.wstring()));
+        return;
+      }
+      result->Success(EncodableValue(EncodableMap{
+          {EncodableValue("path"), EncodableValue(WideToUtf8(path.wstring()))},
+          {EncodableValue("events"), EncodableValue(static_cast<int64_t>(events))},
+      }));
+      return;
+    }
+    else if (call.method_name() == "setLogLevel")
+    {
+      // Debug records only exist in builds with WIREGUARD_FLUTTER_DEBUG_LOGS
+      const auto *name = args ? get_if<string>(ValueOrNull(*args, "level")) : nullptr;
+      LogLevel level = LogLevel::Info;
+      if (name == nullptr || !parseLogLevel(*name, level))
+      {
+        result->Error("Argument 'level' must be debug, info, warn or error");
+        return;
+      }
+      Logger::setLevel(level);
+      result->Success();
+      return;
+    }
+    else if (call.method_name() == "configureStatistics")
+    {
+      if (tunnels_ == nullptr)
+      {
+        result->Error("Invalid state: tunnel manager not initialized");
+        return;
+      }
+      if (args == nullptr)
+      {
+        result->Error("Arguments are required");
+        return;
+      }
+
+      RateEstimator::Options options;
+      int64_t value = 0;
+      if (IntValue(*args, "ewmaTimeConstantMs", value))
+      {
+        options.ewmaTimeConstant = chrono::milliseconds(max<int64_t>(value, 0));
+      }
+      if (IntValue(*args, "windowSamples", value))
+      {
+        options.windowSamples = static_cast<size_t>(max<int64_t>(value, 1));
+      }
+
+      // Without a tunnel name every tunnel, current and future, is configured
+      if (ValueOrNull(*args, "tunnel") == nullptr)
+      {
+        tunnels_->configureStatistics(options);
+      }
+      else if (auto *tunnel = FindTunnel(args, *result))
+      {
+        tunnel->configureStatistics(options);
+      }
+      else
+      {
+        return;
+      }
+      result->Success();
+      return;
+    }
+    else if (call.method_name() == "configureReconnect")
+    {
+      if (tunnels_ == nullptr)
+      {
+        result->Error("Invalid state: tunnel manager not initialized");
+        return;
+      }
+      if (args == nullptr)
+      {
+        result->Error("Arguments are required");
+        return;
+      }
+
+      // Unset fields keep their defaults; a recovery already running
+      // finishes under the options it started with
+      ReconnectPolicy::Options options;
+      if (const auto *enabled = get_if<bool>(ValueOrNull(*args, "enabled")))
+      {
+        options.enabled = *enabled;
+      }
+      int64_t value = 0;
+      if (IntValue(*args, "initialBackoffMs", value))
+      {
+        options.initialBackoff = chrono::milliseconds(max<int64_t>(value, 0));
+      }
+      if (IntValue(*args, "maxBackoffMs", value))
+      {
+        options.maxBackoff = chrono::milliseconds(max<int64_t>(value, 0));
+      }
+      if (IntValue(*args, "maxAttempts", value))
+      {
+        options.maxAttempts = static_cast<uint32_t>(clamp<int64_t>(value, 0, UINT32_MAX));
+      }
+
+      if (ValueOrNull(*args, "tunnel") == nullptr)
+      {
+        tunnels_->configureReconnect(options);
+      }
+      else if (auto *tunnel = FindTunnel(args, *result))
+      {
+        tunnel->configureReconnect(options);
+      }
+      else
+      {
+        return;
+      }
+      result->Success();
+      return;
+    }
+
+    else if (call.method_name() == "configureKeepalive")
+    {
+      if (tunnels_ == nullptr)
+      {
+        result->Error("Invalid state: tunnel manager not initialized");
+        return;
+      }
+      const auto *adaptive = args ? get_if<bool>(ValueOrNull(*args, "adaptive")) : nullptr;
+      if (adaptive == nullptr)
+      {
+        result->Error("Argument 'adaptive' is required");
+        return;
+      }
+
+      // Learning starts over under the new bounds
+      KeepaliveTuner::Options options;
+      int64_t value = 0;
+      if (IntValue(*args, "minSeconds", value))
+      {
+        options.floor = chrono::seconds(clamp<int64_t>(value, 1, 65535));
+      }
+      if (IntValue(*args, "maxSeconds", value))
+      {
+        options.ceiling = chrono::seconds(clamp<int64_t>(value, 1, 65535));
+      }
+      if (options.ceiling < options.floor)
+      {
+        result->Error("Argument 'maxSeconds' is below 'minSeconds'");
+        return;
+      }
+
+      if (ValueOrNull(*args, "tunnel") == nullptr)
+      {
+        tunnels_->configureKeepalive(*adaptive, options);
+      }
+      else if (auto *tunnel = FindTunnel(args, *result))
+      {
+        tunnel->configureKeepalive(*adaptive, options);
+      }
+      else
+      {
+        return;
+      }
+      result->Success();
+      return;
+    }
+
+    else if (call.method_name() == "configureLatencyProbe")
+    {
+      if (tunnels_ == nullptr)
+      {
+        result->Error("Invalid state: tunnel manager not initialized");
+        return;
+      }
+      const auto *enabled = args ? get_if<bool>(ValueOrNull(*args, "enabled")) : nullptr;
+      if (enabled == nullptr)
+      {
+        result->Error("Argument 'enabled' is required");
+        return;
+      }
+
+      LatencyProbe::Options options;
+      options.enabled = *enabled;
+      // The probe runs on the loop, which must never wait on DNS
+      if (const auto *target = get_if<string>(ValueOrNull(*args, "target")))
+      {
+        string host;
+        string port;
+        if (!target->empty() &&
+            (!WgQuickConfig::splitEndpoint(*target, host, port) || !WgQuickConfig::isAddressLiteral(host)))
+        {
+          result->Error("Argument 'target' must be an address and port");
+          return;
+        }
+        options.target = *target;
+      }
+      int64_t value = 0;
+      if (IntValue(*args, "intervalMs", value))
+      {
+        options.interval = chrono::milliseconds(clamp<int64_t>(value, 1000, 3600000));
+      }
+      if (IntValue(*args, "timeoutMs", value))
+      {
+        options.tracker.timeout = chrono::milliseconds(clamp<int64_t>(value, 100, 60000));
+      }
+      if (IntValue(*args, "window", value))
+      {
+        options.tracker.window = static_cast<uint32_t>(clamp<int64_t>(value, 1, 3600));
+      }
+
+      if (ValueOrNull(*args, "tunnel") == nullptr)
+      {
+        tunnels_->configureLatencyProbe(options);
+      }
+      else if (auto *tunnel = FindTunnel(args, *result))
+      {
+        tunnel->configureLatencyProbe(options);
+      }
+      else
+      {
+        return;
+      }
+      result->Success();
+      return;
+    }
+
+    else if (call.method_name() == "setStandby")
+    {
+      if (tunnels_ == nullptr)
+      {
+        result->Error("Invalid state: tunnel manager not initialized");
+        return;
+      }
+
+      // Without a public key the standby is removed
+      optional<StandbyFailover::Peer> peer;
+      const auto *publicKey = args ? get_if<string>(ValueOrNull(*args, "publicKey")) : nullptr;
+      if (publicKey != nullptr)
+      {
+        const auto *endpoint = get_if<string>(ValueOrNull(*args, "endpoint"));
+        if (endpoint == nullptr)
+        {
+          result->Error("Argument 'endpoint' is required with 'publicKey'");
+          return;
+        }
+        const auto *presharedKey = get_if<string>(ValueOrNull(*args, "presharedKey"));
+        peer = StandbyFailover::Peer{*publicKey, presharedKey ? *presharedKey : string(), *endpoint};
+      }
+
+      // Set before a start too, so the first connect already has it.
+      // Answered on the platform thread once the loop applied it, which
+      // first waits for the endpoint's name
+      shared_ptr<MethodResult<EncodableValue>> pending(move(result));
+      auto *dispatcher = dispatcher_.get();
+      auto replies = pending_replies_;
+      bool accepted = TunnelManagers::manager(tunnels_->getOrCreate(TunnelName(args))).setStandby(
+          peer,
+          [pending, dispatcher, replies](bool applied)
+          {
+            lock_guard<mutex> lock(replies->mutex);
+            if (replies->closed)
+            {
+              return;
+            }
+            if (applied)
+            {
+              dispatcher->postTask([pending]()
+                                   { pending->Success(); });
+            }
+            else
+            {
+              dispatcher->postTask([pending]()
+                                   { pending->Error("Failed to set the standby peer"); });
+            }
+          });
+      if (!accepted)
+      {
+        pending->Error("Failed to set the standby peer");
+      }
+      return;
+    }
+    else if (call.method_name() == "failover")
+    {
+      auto *tunnel = FindTunnel(args, *result);
+      if (tunnel == nullptr)
+      {
+        return;
+      }
+      // Answered on the platform thread once the loop switched
+      shared_ptr<MethodResult<EncodableValue>> pending(move(result));
+      auto *dispatcher = dispatcher_.get();
+      auto replies = pending_replies_;
+      tunnel->failover(
+          [pending, dispatcher, replies](const StandbyFailover::Result &switched)
+          {
+            EncodableMap fields = WireGuardTunnelManager::failoverFields(switched);
+            lock_guard<mutex> lock(replies->mutex);
+            if (!replies->closed)
+            {
+              dispatcher->postTask([pending, fields]()
+                                   { pending->Success(EncodableValue(fields)); });
+            }
+          });
+      return;
+    }
+    else if (call.method_name() == "rankEndpoints")
+    {
+      const auto *endpoints = args ? get_if<EncodableList>(ValueOrNull(*args, "endpoints")) : nullptr;
+      if (endpoints == nullptr)
+      {
+        result->Error("Argument 'endpoints' is required");
+        return;
+      }
+      vector<string> targets;
+      for (const auto &value : *endpoints)
+      {
+        const auto *endpoint = get_if<string>(&value);
+        if (endpoint == nullptr)
+        {
+          result->Error("Argument 'endpoints' must be a list of strings");
+          return;
+        }
+        targets.push_back(*endpoint);
+      }
+
+      EndpointProber::Options options;
+      int64_t value = 0;
+      if (IntValue(*args, "rounds", value))
+      {
+        options.rounds = static_cast<uint32_t>(clamp<int64_t>(value, 1, 20));
+      }
+      if (IntValue(*args, "intervalMs", value))
+      {
+        options.interval = chrono::milliseconds(clamp<int64_t>(value, 0, 5000));
+      }
+      if (IntValue(*args, "timeoutMs", value))
+      {
+        options.timeout = chrono::milliseconds(clamp<int64_t>(value, 0, 60000));
+      }
+
+      // Answered on the platform thread once every reply or the timeout is in
+      shared_ptr<MethodResult<EncodableValue>> pending(move(result));
+      auto *dispatcher = dispatcher_.get();
+      auto replies = pending_replies_;
+      bool started = EndpointProber::start(
+          *loop_, targets, options,
+          [pending, dispatcher, replies](vector<EndpointProber::Result> ranked)
+          {
+            EncodableList list;
+            for (const auto &entry : ranked)
+            {
+              list.push_back(EncodableValue(EncodableMap{
+                  {EncodableValue("endpoint"), EncodableValue(entry.endpoint)},
+                  {EncodableValue("address"), EncodableValue(entry.address)},
+                  {EncodableValue("sent"), EncodableValue(static_cast<int64_t>(entry.sent))},
+                  {EncodableValue("received"), EncodableValue(static_cast<int64_t>(entry.received))},
+                  {EncodableValue("rttMs"), EncodableValue(entry.rttMs)},
+                  {EncodableValue("minRttMs"), EncodableValue(entry.minRttMs)},
+                  {EncodableValue("jitterMs"), EncodableValue(entry.jitterMs)},
+                  {EncodableValue("loss"), EncodableValue(entry.loss)},
+              }));
+            }
+            lock_guard<mutex> lock(replies->mutex);
+            if (!replies->closed)
+            {
+              dispatcher->postTask([pending, list]()
+                                   { pending->Success(EncodableValue(list)); });
+            }
+          });
+      if (!started)
+      {
+        pending->Error("Could not open a probe socket");
+      }
+      return;
+    }
+    else if (call.method_name() == "startSpeedTest")
+    {
+      const auto *endpoint = args ? get_if<string>(ValueOrNull(*args, "endpoint")) : nullptr;
+      if (endpoint == nullptr)
+      {
+        result->Error("Argument 'endpoint' is required");
+        return;
+      }
+      // One at a time; parallel tests would only measure each other
+      if (speed_test_ && !speed_test_->finished())
+      {
+        result->Error("A speed test is already running");
+        return;
+      }
+
+      ThroughputTest::Options options;
+      if (const auto *protocol = get_if<string>(ValueOrNull(*args, "protocol")))
+      {
+        options.protocol = *protocol == "udp" ? ThroughputTest::Protocol::Udp : ThroughputTest::Protocol::Tcp;
+      }
+      if (const auto *direction = get_if<string>(ValueOrNull(*args, "direction")))
+      {
+        options.direction =
+            *direction == "download" ? ThroughputTest::Direction::Download : ThroughputTest::Direction::Upload;
+      }
+      if (const auto *latencyEndpoint = get_if<string>(ValueOrNull(*args, "latencyEndpoint")))
+      {
+        options.latencyEndpoint = *latencyEndpoint;
+      }
+      int64_t value = 0;
+      if (IntValue(*args, "streams", value))
+      {
+        options.streams = static_cast<uint32_t>(clamp<int64_t>(value, 1, 16));
+      }
+      if (IntValue(*args, "durationMs", value))
+      {
+        options.duration = chrono::milliseconds(clamp<int64_t>(value, 1000, 120000));
+      }
+      if (IntValue(*args, "warmupMs", value))
+      {
+        options.warmup = chrono::milliseconds(clamp<int64_t>(value, 0, 60000));
+      }
+      if (IntValue(*args, "intervalMs", value))
+      {
+        options.interval = chrono::milliseconds(clamp<int64_t>(value, 100, 10000));
+      }
+      if (IntValue(*args, "rateBps", value))
+      {
+        options.rateBps = static_cast<uint64_t>(clamp<int64_t>(value, 8000, 10000000000));
+      }
+      if (IntValue(*args, "datagramSize", value))
+      {
+        options.datagramSize = static_cast<uint32_t>(clamp<int64_t>(value, 64, 65507));
+      }
+
+      // Reports go out as "speed_test" events, tagged with the id returned
+      int64_t id = ++speed_test_id_;
+      auto *dispatcher = dispatcher_.get();
+      auto replies = pending_replies_;
+      speed_test_ = ThroughputTest::start(
+          *loop_, *endpoint, options,
+          [id, dispatcher, replies](const ThroughputTest::Report &report)
+          {
+            EncodableList streams;
+            for (double bps : report.streamBps)
+            {
+              streams.push_back(EncodableValue(bps));
+            }
+            EncodableMap event{
+                {EncodableValue("test"), EncodableValue(id)},
+                {EncodableValue("done"), EncodableValue(report.done)},
+                {EncodableValue("elapsedMs"), EncodableValue(static_cast<int64_t>(report.elapsed.count()))},
+                {EncodableValue("bytes"), EncodableValue(static_cast<int64_t>(report.bytes))},
+                {EncodableValue("goodputBps"), EncodableValue(report.goodputBps)},
+                {EncodableValue("intervalBps"), EncodableValue(report.intervalBps)},
+                {EncodableValue("streamBps"), EncodableValue(streams)},
+                {EncodableValue("fairness"), EncodableValue(report.fairness)},
+                {EncodableValue("connected"), EncodableValue(static_cast<int32_t>(report.connected))},
+                {EncodableValue("failed"), EncodableValue(static_cast<int32_t>(report.failed))},
+                {EncodableValue("rttSamples"), EncodableValue(static_cast<int64_t>(report.rttSamples))},
+                {EncodableValue("rttMinUs"), EncodableValue(report.rttMinUs)},
+                {EncodableValue("rttP50Us"), EncodableValue(report.rttP50Us)},
+                {EncodableValue("rttP90Us"), EncodableValue(report.rttP90Us)},
+                {EncodableValue("rttP99Us"), EncodableValue(report.rttP99Us)},
+                {EncodableValue("loss"), EncodableValue(report.loss)},
+                {EncodableValue("error"), EncodableValue(report.error)},
+            };
+            lock_guard<mutex> lock(replies->mutex);
+            if (!replies->closed)
+            {
+              dispatcher->postEvent("speed_test", move(event));
+            }
+          });
+      if (!speed_test_)
+      {
+        result->Error("Could not start a speed test to " + *endpoint);
+        return;
+      }
+      result->Success(EncodableValue(id));
+      return;
+    }
+    else if (call.method_name() == "stopSpeedTest")
+    {
+      // The test ends with a final report
+      if (speed_test_)
+      {
+        speed_test_->cancel();
+      }
+      result->Success();
+      return;
+    }
+
     result->NotImplemented();
   }
 
+  string WireguardFlutterPlugin::TunnelName(const EncodableMap *args) const
+  {
+    if (args != nullptr)
+    {
+      const auto *name = get_if<string>(ValueOrNull(*args, "tunnel"));
+      if (name && !name->empty())
+      {
+        return *name;
+      }
+    }
+    return default_tunnel_;
+  }
+
+  WireGuardTunnelManager *WireguardFlutterPlugin::FindTunnel(const EncodableMap *args,
+                                                             MethodResult<EncodableValue> &result)
+  {
+    if (tunnels_ == nullptr)
+    {
+      result.Error("Invalid state: tunnel manager not initialized");
+      return nullptr;
+    }
+
+    // The default tunnel always resolves; others only once started
+    string name = TunnelName(args);
+    auto *tunnel = name == default_tunnel_ ? &tunnels_->getOrCreate(name) : tunnels_->find(name);
+    if (tunnel == nullptr)
+    {
+      result.Error("Unknown tunnel '" + name + "'");
+      return nullptr;
+    }
+    return &TunnelManagers::manager(*tunnel);
+  }
+
   unique_ptr<StreamHandlerError<EncodableValue>> WireguardFlutterPlugin::OnListen(
       const EncodableValue *arguments,
       unique_ptr<EventSink<EncodableValue>> &&events)
   {
-    events_ = move(events);
-    if (tunnel_manager_ != nullptr)
-    {
-      tunnel_manager_->setEventSink(events_.get());
-    }
+    // Sends the current stage right away, so Dart never has to poll for it
+    dispatcher_->setSink(move(events));
+    // Idle monitoring picks up sampling again for the new listener
+    tunnels_->wake();
     return nullptr;
   }
 
   unique_ptr<StreamHandlerError<EncodableValue>> WireguardFlutterPlugin::OnCancel(
       const EncodableValue *arguments)
   {
-    events_ = nullptr;
-    if (tunnel_manager_ != nullptr)
+    dispatcher_->clearSink();
+    return nullptr;
+  }
+
+  unique_ptr<StreamHandlerError<EncodableValue>> WireguardFlutterPlugin::OnLogListen(
+      const EncodableValue *arguments,
+      unique_ptr<EventSink<EncodableValue>> &&events)
+  {
+    LogLevel minLevel = LogLevel::Info;
+    int64_t batchMs = DriverLog::kDefaultBatchInterval.count();
+    if (const auto *args = get_if<EncodableMap>(arguments))
     {
-      tunnel_manager_->setEventSink(nullptr);
+      const auto *level = get_if<string>(ValueOrNull(*args, "minLevel"));
+      if (level && !parseLogLevel(*level, minLevel))
+      {
+        return make_unique<StreamHandlerError<EncodableValue>>(
+            "invalid-argument", "Argument 'minLevel' must be debug, info, warn or error", nullptr);
+      }
+      IntValue(*args, "batchMs", batchMs);
     }
+
+    log_dispatcher_->setSink(move(events));
+    DriverLog::instance().listen(minLevel, chrono::milliseconds(clamp<int64_t>(batchMs, 10, 10000)));
+    return nullptr;
+  }
+
+  unique_ptr<StreamHandlerError<EncodableValue>> WireguardFlutterPlugin::OnLogCancel(
+      const EncodableValue *arguments)
+  {
+    DriverLog::instance().cancel();
+    log_dispatcher_->clearSink();
     return nullptr;
   }
 
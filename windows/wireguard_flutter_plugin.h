@@ -10,7 +10,22 @@
 #include <flutter/encodable_value.h>
 
 #include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 
+#include "connect_timings.h"
+#include "dns_resolver.h"
+#include "driver_log.h"
+#include "event_dispatcher.h"
+#include "event_loop.h"
+#include "method_metrics.h"
+#include "race_adapters.h"
+#include "resolver_cache.h"
+#include "throughput_test.h"
+#include "tunnel_managers.h"
+#include "tunnel_registry.h"
+#include "usage_ledger.h"
 #include "wireguard_tunnel_manager.h"
 
 namespace wireguard_flutter
@@ -21,7 +36,7 @@ namespace wireguard_flutter
   public:
     static void RegisterWithRegistrar(flutter::PluginRegistrarWindows *registrar);
 
-    WireguardFlutterPlugin();
+    explicit WireguardFlutterPlugin(flutter::PluginRegistrarWindows *registrar);
 
     virtual ~WireguardFlutterPlugin();
 
@@ -34,14 +49,67 @@ namespace wireguard_flutter
     void HandleMethodCall(const flutter::MethodCall<flutter::EncodableValue> &method_call,
                           std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
 
-    std::unique_ptr<WireGuardTunnelManager> tunnel_manager_;
-    std::unique_ptr<flutter::EventSink<flutter::EncodableValue>> events_;
+    // Name from the call's "tunnel" argument, or the default tunnel
+    std::string TunnelName(const flutter::EncodableMap *args) const;
+
+    // Reports an error on |result| and returns nullptr when the tunnel is
+    // unknown
+    WireGuardTunnelManager *FindTunnel(const flutter::EncodableMap *args,
+                                       flutter::MethodResult<flutter::EncodableValue> &result);
+
+    // Declared before the tunnels so they outlive their final flush and the
+    // status change posted when they stop. The loop runs every timer and
+    // notification of this plugin instance.
+    std::unique_ptr<EventLoop> loop_;
+    std::unique_ptr<EventDispatcher> dispatcher_;
+    // Batches of driver log messages for the log channel
+    std::unique_ptr<EventDispatcher> log_dispatcher_;
+    std::unique_ptr<UsageLedger> usage_ledger_;
+    std::unique_ptr<ConnectTimingStore> connect_timings_;
+    // Endpoint names of configs handed over, resolved ahead of connects;
+    // the resolver waits for its queries, so it goes last
+    std::unique_ptr<DnsResolver> dns_resolver_;
+    std::unique_ptr<ResolverCache> resolver_cache_;
+    // Adapters of endpoint races; waits for adapters being created or
+    // removed, after the tunnels cancelled their races
+    std::unique_ptr<RaceAdapters> race_adapters_;
+    // Creates the registry's tunnels; outlives them
+    std::unique_ptr<TunnelManagers> tunnel_managers_;
+    std::unique_ptr<TunnelRegistry> tunnels_;
+
+    // Calls answered from the loop post their reply through dispatcher_
+    // while holding this; the destructor closes it first, so nothing is
+    // posted to a dispatcher that is going away
+    struct PendingReplies {
+      std::mutex mutex;
+      bool closed = false;
+    };
+    std::shared_ptr<PendingReplies> pending_replies_ = std::make_shared<PendingReplies>();
+
+    // The running or latest speed test, touched on the platform thread only
+    std::shared_ptr<ThroughputTest> speed_test_;
+    int64_t speed_test_id_ = 0;
+
+    // Reply of getWireGuardStatistics, an Int64List encoded in place on
+    // every call so polling reuses its storage; platform thread only
+    flutter::EncodableValue stats_reply_{std::vector<int64_t>()};
+
+    // Per-method call counts and latencies, reported by getPluginMetrics
+    MethodMetrics method_metrics_;
+
+    // Tunnel used when a method call names none; set by initialize
+    std::string default_tunnel_ = "default";
 
     std::unique_ptr<flutter::StreamHandlerError<flutter::EncodableValue>> OnListen(
         const flutter::EncodableValue *arguments,
         std::unique_ptr<flutter::EventSink<flutter::EncodableValue>> &&events);
     std::unique_ptr<flutter::StreamHandlerError<flutter::EncodableValue>> OnCancel(
         const flutter::EncodableValue *arguments);
+    std::unique_ptr<flutter::StreamHandlerError<flutter::EncodableValue>> OnLogListen(
+        const flutter::EncodableValue *arguments,
+        std::unique_ptr<flutter::EventSink<flutter::EncodableValue>> &&events);
+    std::unique_ptr<flutter::StreamHandlerError<flutter::EncodableValue>> OnLogCancel(
+        const flutter::EncodableValue *arguments);
   };
 
 } // namespace wireguard_flutter
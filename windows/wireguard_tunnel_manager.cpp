@@ -6,10 +6,15 @@
 #include <netioapi.h>
 
 #include "wireguard_tunnel_manager.h"
-#include <iostream>
+#include "logger.h"
+#include "trace_recorder.h"
+#include "wg_quick_config.h"
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 #include <chrono>
+#include <functional>
+#include <utility>
 #include <vector>
 
 #pragma comment(lib, "iphlpapi.lib")
@@ -18,17 +23,120 @@
 
 namespace wireguard_flutter {
 
-WireGuardTunnelManager::WireGuardTunnelManager() {
-    std::cout << "WireGuardTunnelManager: Initializing..." << std::endl;
+static_assert(static_cast<int>(TunnelState::Connecting) == WIREGUARD_FLUTTER_STATE_CONNECTING &&
+                  static_cast<int>(TunnelState::Connected) == WIREGUARD_FLUTTER_STATE_CONNECTED &&
+                  static_cast<int>(TunnelState::Error) == WIREGUARD_FLUTTER_STATE_ERROR &&
+                  static_cast<int>(TunnelState::Disconnecting) == WIREGUARD_FLUTTER_STATE_DISCONNECTING &&
+                  static_cast<int>(TunnelState::Reconnecting) == WIREGUARD_FLUTTER_STATE_RECONNECTING &&
+                  static_cast<int>(TunnelState::Degraded) == WIREGUARD_FLUTTER_STATE_DEGRADED,
+              "tunnel states must match the counter block");
+
+namespace {
+
+std::atomic<uint32_t> nextNameSuffix{0};
+
+// WireGuard's REJECT_AFTER_TIME; a session without a handshake for this long
+// no longer carries traffic
+constexpr int64_t kStaleHandshakeMs = 180000;
+
+// A connect without a handshake this long after the adapter came up is
+// recorded without the firstHandshake phase
+constexpr auto kFirstHandshakeTimeout = std::chrono::seconds(90);
+
+// How long a connect waits for endpoint names the cache has nothing for;
+// the tunnel service resolves whatever is left itself
+constexpr auto kResolveTimeout = std::chrono::seconds(3);
+
+// A stopping service is given this long, and its status polled this often
+// when there is no process handle to wait on
+constexpr auto kServiceStopTimeout = std::chrono::seconds(3);
+constexpr auto kServiceStopPoll = std::chrono::milliseconds(100);
+
+// How often a running service's process is checked when the loop has no
+// wait left for it
+constexpr auto kServiceExitPoll = std::chrono::milliseconds(500);
+
+// Path MTU echoes each wait this long for an answer; a new path settles
+// for kMtuProbeDelay before it is searched
+constexpr auto kMtuProbeTimeout = std::chrono::milliseconds(1000);
+constexpr auto kMtuProbeDelay = std::chrono::milliseconds(2000);
+
+// Up, whether or not the peer answers
+bool carriesTraffic(TunnelState state) {
+    return state == TunnelState::Connected || state == TunnelState::Degraded;
+}
+
+VOID CALLBACK runPoolTask(PTP_CALLBACK_INSTANCE, PVOID context) {
+    std::unique_ptr<std::function<void()>> task(static_cast<std::function<void()>*>(context));
+    (*task)();
+}
+
+// Runs |task| on the process thread pool; false when it could not be queued
+bool submitToPool(std::function<void()> task) {
+    auto pending = std::make_unique<std::function<void()>>(std::move(task));
+    if (!TrySubmitThreadpoolCallback(&runPoolTask, pending.get(), nullptr)) {
+        return false;
+    }
+    pending.release();
+    return true;
+}
+
+} // namespace
+
+WireGuardTunnelManager::WireGuardTunnelManager(EventLoop& eventLoop, const std::string& name)
+    : loop(eventLoop),
+      reconnect(std::hash<std::string>{}(name) ^
+                static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count())),
+      tunnelName(name) {
+    WG_LOG_INFO("WireGuardTunnelManager: Initializing {}...", tunnelName);
+    statsBlock = &TunnelStatsBlock(tunnelName, statsBlockIndex);
 }
 
 WireGuardTunnelManager::~WireGuardTunnelManager() {
-    std::cout << "WireGuardTunnelManager: Cleaning up..." << std::endl;
+    WG_LOG_INFO("WireGuardTunnelManager: Cleaning up...");
     stopTunnel();
 }
 
-void WireGuardTunnelManager::setEventSink(flutter::EventSink<flutter::EncodableValue>* sink) {
-    eventSink = sink;
+void WireGuardTunnelManager::setEventDispatcher(EventDispatcher* eventDispatcher) {
+    dispatcher = eventDispatcher;
+}
+
+void WireGuardTunnelManager::setUsageLedger(UsageLedger* ledger) {
+    usageLedger = ledger;
+}
+
+void WireGuardTunnelManager::setConnectTimingStore(ConnectTimingStore* store) {
+    timingStore = store;
+}
+
+void WireGuardTunnelManager::setResolverCache(ResolverCache* cache) {
+    resolverCache = cache;
+}
+
+void WireGuardTunnelManager::setRaceBackend(EndpointRacer::Backend* backend) {
+    raceBackend = backend;
+}
+
+void WireGuardTunnelManager::recordPhase(ConnectPhase phase, std::chrono::steady_clock::time_point at) {
+    int64_t beganUs = TraceRecorder::timestampUs(connectTimer.mark());
+    connectTimer.finishPhase(phase, at);
+    TraceRecorder::instance().complete("connect", connectPhaseName(phase), beganUs,
+                                       TraceRecorder::timestampUs(at) - beganUs, tunnelName);
+    WG_LOG_INFO("WireGuardTunnelManager: {} took {} ms", connectPhaseName(phase),
+                connectTimer.breakdown().phaseMs[static_cast<size_t>(phase)]);
+    if (timingStore) {
+        timingStore->update(tunnelName, connectTimer.breakdown());
+    }
+}
+
+void WireGuardTunnelManager::finishConnect() {
+    if (!connectTimer.isRunning()) {
+        return;
+    }
+    connectTimer.finish();
+    if (timingStore) {
+        timingStore->update(tunnelName, connectTimer.breakdown());
+    }
 }
 
 std::wstring WireGuardTunnelManager::getAppDirectory() {
@@ -45,63 +153,107 @@ std::wstring WireGuardTunnelManager::getAppExecutablePath() {
 }
 
 bool WireGuardTunnelManager::createConfigFile(const std::string& config) {
-    std::wcout << L"WireGuardTunnelManager: Creating config file..." << std::endl;
+    WG_LOG_INFO("WireGuardTunnelManager: Creating config file...");
     
     try {
         // Create a temporary file path
         wchar_t tempPath[MAX_PATH];
         GetTempPathW(MAX_PATH, tempPath);
         
-        // Generate a unique filename based on timestamp
+        // Generate a unique filename based on timestamp; the counter keeps
+        // tunnels started in the same millisecond apart
         auto now = std::chrono::system_clock::now();
         auto timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
         
+        // The tunnel service names its adapter after the config file
+        std::wostringstream nameStream;
+        nameStream << L"wg_flutter_" << timestamp << L"_" << nextNameSuffix++;
+        adapterName = nameStream.str();
+        
         std::wostringstream pathStream;
-        pathStream << tempPath << L"wg_flutter_" << timestamp << L".conf";
+        pathStream << tempPath << adapterName << L".conf";
         currentConfigPath = pathStream.str();
         
-        // Write config to file
-        std::ofstream configFile(currentConfigPath);
-        if (!configFile.is_open()) {
-            std::cerr << "Failed to create config file" << std::endl;
-            return false;
-        }
-        
-        configFile << config;
-        configFile.close();
-        
-        std::wcout << L"Config file created: " << currentConfigPath << std::endl;
-        return true;
+        return writeConfigFile(config);
     }
     catch (const std::exception& e) {
-        std::cerr << "Exception creating config file: " << e.what() << std::endl;
+        WG_LOG_ERROR("Exception creating config file: {}", e.what());
         return false;
     }
 }
 
+bool WireGuardTunnelManager::writeConfigFile(const std::string& config) {
+    std::ofstream configFile(currentConfigPath, std::ios::trunc);
+    if (!configFile.is_open()) {
+        WG_LOG_ERROR("Failed to create config file");
+        return false;
+    }
+    
+    configFile << config;
+    configFile.close();
+    writtenConfig = config;
+    
+    WG_LOG_DEBUG("Config file written: {}", currentConfigPath);
+    return true;
+}
+
+void WireGuardTunnelManager::prefetchEndpoints(const std::string& config) {
+    WgQuickConfig parsed;
+    if (resolverCache && WgQuickConfig::parse(config, parsed)) {
+        resolverCache->prefetch(parsed.endpointHosts(), ResolverCache::Clock::now());
+    }
+}
+
+// Never waits on DNS: names the cache has no answer for are left to the
+// service
+std::string WireGuardTunnelManager::withResolvedEndpoints(const std::string& config) {
+    WgQuickConfig parsed;
+    if (!resolverCache || !WgQuickConfig::parse(config, parsed)) {
+        return config;
+    }
+    auto now = ResolverCache::Clock::now();
+    
+    std::string resolved = config;
+    for (size_t i = 0; i < parsed.peers.size(); i++) {
+        std::string host;
+        std::string port;
+        if (!WgQuickConfig::splitEndpoint(parsed.peers[i].endpoint, host, port) ||
+            WgQuickConfig::isAddressLiteral(host)) {
+            continue;
+        }
+        auto addresses = resolverCache->lookup(host, now);
+        if (addresses.empty()) {
+            WG_LOG_WARN("WireGuardTunnelManager: No address for {} yet; the service resolves it", host);
+            continue;
+        }
+        resolved = WgQuickConfig::withPeerEndpoint(resolved, i, WgQuickConfig::joinEndpoint(addresses.front(), port));
+    }
+    return resolved;
+}
+
 void WireGuardTunnelManager::cleanupTempFiles() {
     if (!currentConfigPath.empty()) {
-        std::wcout << L"WireGuardTunnelManager: Cleaning up config file: " << currentConfigPath << std::endl;
+        WG_LOG_DEBUG("WireGuardTunnelManager: Cleaning up config file: {}", currentConfigPath);
         DeleteFileW(currentConfigPath.c_str());
         currentConfigPath.clear();
     }
 }
 
 bool WireGuardTunnelManager::installService() {
-    std::cout << "WireGuardTunnelManager: Installing Windows Service..." << std::endl;
+    WG_LOG_INFO("WireGuardTunnelManager: Installing Windows Service...");
     
     // Generate unique service name based on timestamp
     auto now = std::chrono::system_clock::now();
     auto timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
     std::wostringstream serviceNameStream;
-    serviceNameStream << L"WireGuardTunnel$FlutterVPN_" << timestamp;
+    serviceNameStream << L"WireGuardTunnel$FlutterVPN_" << timestamp << L"_" << nextNameSuffix++;
     serviceName = serviceNameStream.str();
     
     // Open Service Control Manager
     SC_HANDLE scm = OpenSCManagerW(NULL, NULL, SC_MANAGER_ALL_ACCESS);
     if (!scm) {
-        std::cerr << "Failed to open Service Control Manager. Error: " << GetLastError() << std::endl;
-        std::cerr << "Ensure application is running as Administrator" << std::endl;
+        WG_LOG_ERROR("Failed to open Service Control Manager. Error: {}", GetLastError());
+        WG_LOG_ERROR("Ensure application is running as Administrator");
         return false;
     }
     
@@ -111,7 +263,7 @@ bool WireGuardTunnelManager::installService() {
     cmdStream << L"\"" << exePath << L"\" /service \"" << currentConfigPath << L"\"";
     std::wstring cmdLine = cmdStream.str();
     
-    std::wcout << L"Service command: " << cmdLine << std::endl;
+    WG_LOG_DEBUG("Service command: {}", cmdLine);
     
     // Create the service
     serviceHandle = CreateServiceW(
@@ -132,7 +284,7 @@ bool WireGuardTunnelManager::installService() {
     
     if (!serviceHandle) {
         DWORD error = GetLastError();
-        std::cerr << "Failed to create service. Error: " << error << std::endl;
+        WG_LOG_ERROR("Failed to create service. Error: {}", error);
         CloseServiceHandle(scm);
         return false;
     }
@@ -142,36 +294,37 @@ bool WireGuardTunnelManager::installService() {
     sidInfo.dwServiceSidType = SERVICE_SID_TYPE_UNRESTRICTED;
     
     if (!ChangeServiceConfig2W(serviceHandle, SERVICE_CONFIG_SERVICE_SID_INFO, &sidInfo)) {
-        std::cerr << "Warning: Failed to set service SID type. Error: " << GetLastError() << std::endl;
+        WG_LOG_WARN("Failed to set service SID type. Error: {}", GetLastError());
     }
     
     CloseServiceHandle(scm);
-    std::cout << "Service installed successfully" << std::endl;
+    WG_LOG_INFO("Service installed successfully");
     return true;
 }
 
 bool WireGuardTunnelManager::startService() {
-    std::cout << "WireGuardTunnelManager: Starting service..." << std::endl;
+    WG_LOG_INFO("WireGuardTunnelManager: Starting service...");
     
     if (!serviceHandle) {
-        std::cerr << "Service handle is NULL" << std::endl;
+        WG_LOG_ERROR("Service handle is NULL");
         return false;
     }
     
     if (!StartServiceW(serviceHandle, 0, NULL)) {
         DWORD error = GetLastError();
         if (error != ERROR_SERVICE_ALREADY_RUNNING) {
-            std::cerr << "Failed to start service. Error: " << error << std::endl;
+            WG_LOG_ERROR("Failed to start service. Error: {}", error);
             return false;
         }
     }
     
-    std::cout << "Service started successfully" << std::endl;
+    WG_LOG_INFO("Service started successfully");
     return true;
 }
 
 bool WireGuardTunnelManager::stopService() {
-    std::cout << "WireGuardTunnelManager: Stopping service..." << std::endl;
+    TraceSpan span("service", "stop", tunnelName);
+    WG_LOG_INFO("WireGuardTunnelManager: Stopping service...");
     
     if (!serviceHandle) {
         return true;
@@ -181,27 +334,95 @@ bool WireGuardTunnelManager::stopService() {
     if (!ControlService(serviceHandle, SERVICE_CONTROL_STOP, &status)) {
         DWORD error = GetLastError();
         if (error != ERROR_SERVICE_NOT_ACTIVE) {
-            std::cerr << "Failed to stop service. Error: " << error << std::endl;
+            WG_LOG_ERROR("Failed to stop service. Error: {}", error);
         }
     }
     
+    // The process handle signals the moment the service exits; the status
+    // poll below then only confirms it
+    if (serviceProcess) {
+        WaitForSingleObject(serviceProcess, 3000);
+    }
+    
     // Wait for service to stop
     for (int i = 0; i < 30; i++) {
         if (QueryServiceStatus(serviceHandle, &status)) {
             if (status.dwCurrentState == SERVICE_STOPPED) {
-                std::cout << "Service stopped successfully" << std::endl;
+                WG_LOG_INFO("Service stopped successfully");
                 return true;
             }
         }
+        TraceRecorder::instance().instant("service", "stop.retry", tunnelName, "attempt", i + 1);
         std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
     
-    std::cout << "Service stop timeout" << std::endl;
+    WG_LOG_WARN("Service stop timeout");
     return false;
 }
 
+void WireGuardTunnelManager::stopServiceAsync(std::function<void(bool)> done) {
+    WG_LOG_INFO("WireGuardTunnelManager: Stopping service...");
+    if (!serviceHandle) {
+        done(true);
+        return;
+    }
+    
+    SERVICE_STATUS status;
+    if (!ControlService(serviceHandle, SERVICE_CONTROL_STOP, &status)) {
+        DWORD error = GetLastError();
+        if (error != ERROR_SERVICE_NOT_ACTIVE) {
+            WG_LOG_ERROR("Failed to stop service. Error: {}", error);
+        }
+    }
+    
+    // The process exiting and the status poll race; whichever sees the
+    // service gone first finishes. Both hold monitorMutex like the tick, so
+    // stopTunnel can take over at any point.
+    auto pending = std::make_shared<std::function<void(bool)>>(std::move(done));
+    auto startUs = TraceRecorder::nowUs();
+    auto deadline = std::chrono::steady_clock::now() + kServiceStopTimeout;
+    auto finish = [this, pending, startUs](bool stopped) {
+        if (!*pending) {
+            return;
+        }
+        auto callback = std::exchange(*pending, nullptr);
+        // On the loop, so neither cancel waits; the ids stay for stopMonitoring
+        loop.cancel(serviceExitWait.load());
+        loop.cancel(serviceStopTimer.load());
+        TraceRecorder::instance().complete("service", "stop", startUs, TraceRecorder::nowUs() - startUs, tunnelName);
+        if (stopped) {
+            WG_LOG_INFO("Service stopped successfully");
+        } else {
+            WG_LOG_WARN("Service stop timeout");
+        }
+        callback(stopped);
+    };
+    
+    if (serviceProcess) {
+        serviceExitWait = loop.addWait(serviceProcess, [this, finish]() {
+            std::unique_lock<std::mutex> lock(monitorMutex, std::try_to_lock);
+            if (lock.owns_lock()) {
+                finish(true);
+            }
+        });
+    }
+    serviceStopTimer = loop.addRepeatingTimer(kServiceStopPoll, [this, finish, deadline]() {
+        std::unique_lock<std::mutex> lock(monitorMutex, std::try_to_lock);
+        if (!lock.owns_lock()) {
+            return;
+        }
+        SERVICE_STATUS current;
+        if (QueryServiceStatus(serviceHandle, &current) && current.dwCurrentState == SERVICE_STOPPED) {
+            finish(true);
+        } else if (std::chrono::steady_clock::now() >= deadline) {
+            finish(false);
+        }
+    });
+}
+
 bool WireGuardTunnelManager::deleteService() {
-    std::cout << "WireGuardTunnelManager: Deleting service..." << std::endl;
+    TraceSpan span("service", "delete", tunnelName);
+    WG_LOG_INFO("WireGuardTunnelManager: Deleting service...");
     
     if (!serviceHandle) {
         return true;
@@ -209,302 +430,1532 @@ bool WireGuardTunnelManager::deleteService() {
     
     if (!DeleteService(serviceHandle)) {
         DWORD error = GetLastError();
-        std::cerr << "Failed to delete service. Error: " << error << std::endl;
+        WG_LOG_ERROR("Failed to delete service. Error: {}", error);
     }
     
     CloseServiceHandle(serviceHandle);
     serviceHandle = nullptr;
     
-    std::cout << "Service deleted successfully" << std::endl;
+    WG_LOG_INFO("Service deleted successfully");
     return true;
 }
 
 bool WireGuardTunnelManager::checkConnectionStatus() {
-    // Check if WireGuard adapter exists and is up
-    ULONG bufferSize = 15000;
-    PIP_ADAPTER_ADDRESSES addresses = (IP_ADAPTER_ADDRESSES*)malloc(bufferSize);
+    // Only the adapter named after this tunnel's config file counts; other
+    // tunnels' adapters are WireGuard adapters too
+    if (!adapter.isOpen() && !adapterName.empty()) {
+        adapter.open(adapterName);
+    }
     
-    if (!addresses) {
+    if (!adapter.isOpen() || !adapter.getLuid(wireguardInterfaceLuid)) {
         return false;
     }
+    hasInterfaceLuid = true;
     
-    ULONG result = GetAdaptersAddresses(
-        AF_UNSPEC,
-        GAA_FLAG_INCLUDE_PREFIX | GAA_FLAG_INCLUDE_GATEWAYS,
-        NULL,
-        addresses,
-        &bufferSize
-    );
+    MIB_IF_ROW2 ifRow;
+    ZeroMemory(&ifRow, sizeof(ifRow));
+    ifRow.InterfaceLuid = wireguardInterfaceLuid;
     
-    bool connected = false;
+    if (GetIfEntry2(&ifRow) != NO_ERROR) {
+        return false;
+    }
+    wireguardInterfaceName = ifRow.Alias;
+    return ifRow.OperStatus == IfOperStatusUp;
+}
+
+void WireGuardTunnelManager::sampleStatistics(int64_t handshakeAgeMs) {
+    // The LUID is cached when the adapter comes up; without it there is
+    // nothing to sample yet
+    if (!hasInterfaceLuid) {
+        return;
+    }
     
-    if (result == NO_ERROR) {
-        PIP_ADAPTER_ADDRESSES currentAddress = addresses;
-        
-        while (currentAddress) {
-            std::wstring description(currentAddress->Description);
-            std::wstring friendlyName(currentAddress->FriendlyName);
-            
-            // Check if this is a WireGuard adapter
-            if (description.find(L"WireGuard") != std::wstring::npos ||
-                friendlyName.find(L"WireGuard") != std::wstring::npos) {
-                
-                // Store the interface name for statistics
-                wireguardInterfaceName = friendlyName;
-                
-                // Check if adapter is up
-                if (currentAddress->OperStatus == IfOperStatusUp) {
-                    connected = true;
-                    break;
-                }
-            }
-            
-            currentAddress = currentAddress->Next;
+    // Get statistics from MIB_IF_ROW2
+    MIB_IF_ROW2 ifRow;
+    ZeroMemory(&ifRow, sizeof(ifRow));
+    ifRow.InterfaceLuid = wireguardInterfaceLuid;
+    
+    if (GetIfEntry2(&ifRow) != NO_ERROR) {
+        return;
+    }
+    
+    // Monotonic clock so a wall-clock change cannot produce bogus rates
+    auto now = std::chrono::steady_clock::now();
+    
+    InterfaceCounters counters;
+    counters.octetsIn = ifRow.InOctets;
+    counters.octetsOut = ifRow.OutOctets;
+    counters.packetsIn = ifRow.InUcastPkts + ifRow.InNUcastPkts;
+    counters.packetsOut = ifRow.OutUcastPkts + ifRow.OutNUcastPkts;
+    counters.errorsIn = ifRow.InErrors;
+    counters.errorsOut = ifRow.OutErrors;
+    counters.discardsIn = ifRow.InDiscards;
+    counters.discardsOut = ifRow.OutDiscards;
+    
+    std::unique_lock<std::mutex> lock(statsMutex);
+    rateIn.addSample(counters.octetsIn, now);
+    rateOut.addSample(counters.octetsOut, now);
+    counterTracker.addSample(counters, now);
+    
+    const auto& in = rateIn.rates();
+    const auto& out = rateOut.rates();
+    const auto& interval = counterTracker.metrics();
+    
+    latestStats.bytesIn = ifRow.InOctets;
+    latestStats.bytesOut = ifRow.OutOctets;
+    latestStats.speedInBps = in.instantBps;
+    latestStats.speedOutBps = out.instantBps;
+    latestStats.smoothedInBps = in.smoothedBps;
+    latestStats.smoothedOutBps = out.smoothedBps;
+    latestStats.peakInBps = in.peakBps;
+    latestStats.peakOutBps = out.peakBps;
+    latestStats.p50InBps = in.p50Bps;
+    latestStats.p50OutBps = out.p50Bps;
+    latestStats.p95InBps = in.p95Bps;
+    latestStats.p95OutBps = out.p95Bps;
+    latestStats.packetsIn = counters.packetsIn;
+    latestStats.packetsOut = counters.packetsOut;
+    latestStats.errorsIn = counters.errorsIn;
+    latestStats.errorsOut = counters.errorsOut;
+    latestStats.discardsIn = counters.discardsIn;
+    latestStats.discardsOut = counters.discardsOut;
+    latestStats.packetsInPerSec = interval.packetsInPerSec;
+    latestStats.packetsOutPerSec = interval.packetsOutPerSec;
+    latestStats.avgPacketSizeIn = interval.avgPacketSizeIn;
+    latestStats.avgPacketSizeOut = interval.avgPacketSizeOut;
+    latestStats.dropRatioPpm = interval.dropRatioPpm;
+    auto rtt = latencyProbe.tracker().summary();
+    latestStats.rttSamples = rtt.samples;
+    latestStats.rttMinUs = static_cast<uint64_t>(rtt.minUs);
+    latestStats.rttP50Us = static_cast<uint64_t>(rtt.p50Us);
+    latestStats.rttP90Us = static_cast<uint64_t>(rtt.p90Us);
+    latestStats.rttP99Us = static_cast<uint64_t>(rtt.p99Us);
+    latestStats.rttJitterUs = static_cast<uint64_t>(rtt.jitterUs);
+    latestStats.rttLossPpm = rtt.lossPpm;
+    
+    auto wallClockMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    statsHistory.push(latestStats, wallClockMs);
+    
+    TunnelStats snapshot = latestStats;
+    lock.unlock();
+    
+    accountUsage(counters.octetsIn, counters.octetsOut);
+    observePath(counters, handshakeAgeMs, now);
+    probeLatency(counters, now);
+    
+    // Readers over dart:ffi see the sample without any channel message
+    auto state = tunnelState.is(TunnelState::Degraded) ? WIREGUARD_FLUTTER_STATE_DEGRADED
+                                                       : WIREGUARD_FLUTTER_STATE_CONNECTED;
+    statsBlock->publish(snapshot, state, handshakeAgeMs);
+}
+
+void WireGuardTunnelManager::sampleUsage(int64_t handshakeAgeMs) {
+    // Usage, quotas and the path watchdog are kept up to date even when no
+    // one reads the rates
+    if (!hasInterfaceLuid) {
+        return;
+    }
+    
+    MIB_IF_ROW2 ifRow;
+    ZeroMemory(&ifRow, sizeof(ifRow));
+    ifRow.InterfaceLuid = wireguardInterfaceLuid;
+    
+    if (GetIfEntry2(&ifRow) == NO_ERROR) {
+        InterfaceCounters counters;
+        counters.octetsIn = ifRow.InOctets;
+        counters.octetsOut = ifRow.OutOctets;
+        counters.packetsIn = ifRow.InUcastPkts + ifRow.InNUcastPkts;
+        counters.packetsOut = ifRow.OutUcastPkts + ifRow.OutNUcastPkts;
+        accountUsage(counters.octetsIn, counters.octetsOut);
+        observePath(counters, handshakeAgeMs, std::chrono::steady_clock::now());
+    }
+}
+
+void WireGuardTunnelManager::observePath(const InterfaceCounters& counters, int64_t handshakeAgeMs,
+                                         std::chrono::steady_clock::time_point at) {
+    PathWatchdog::Sample sample;
+    sample.at = at;
+    sample.bytesIn = counters.octetsIn;
+    sample.bytesOut = counters.octetsOut;
+    sample.packetsIn = counters.packetsIn;
+    sample.packetsOut = counters.packetsOut;
+    sample.handshakeAgeMs = handshakeAgeMs;
+    auto verdict = watchdog.addSample(sample);
+    if (verdict.action != PathWatchdog::Action::None) {
+        pathVerdict = verdict;
+    }
+    
+    if (adaptiveKeepalive) {
+        KeepaliveTuner::Sample tunerSample;
+        tunerSample.at = at;
+        tunerSample.bytesIn = counters.octetsIn;
+        tunerSample.bytesOut = counters.octetsOut;
+        tunerSample.handshakeAgeMs = handshakeAgeMs;
+        if (auto change = keepaliveTuner.addSample(tunerSample)) {
+            applyKeepaliveChange(*change);
+        }
+    }
+}
+
+void WireGuardTunnelManager::onPathVerdict(const PathWatchdog::Verdict& verdict) {
+    const char* cause = PathWatchdog::causeName(verdict.cause);
+    switch (verdict.action) {
+    case PathWatchdog::Action::Rehandshake:
+        WG_LOG_WARN("WireGuardTunnelManager: {} degraded ({}); forcing a handshake", tunnelName, cause);
+        TraceRecorder::instance().instant("path", "degraded", tunnelName, "cause", static_cast<int64_t>(verdict.cause));
+        enterState(TunnelState::Degraded);
+        if (!adapter.forceHandshake()) {
+            WG_LOG_WARN("WireGuardTunnelManager: Could not reset the peers of {}", tunnelName);
+        }
+        cadence.reset();
+        break;
+    case PathWatchdog::Action::Recovered:
+        if (enterState(TunnelState::Connected)) {
+            ReconnectPolicy::Recovery recovery;
+            recovery.reason = ReconnectPolicy::Reason::PathDead;
+            recovery.duration = verdict.degradedFor;
+            recovery.recovered = true;
+            reportRecovery(recovery);
+        }
+        break;
+    case PathWatchdog::Action::Failover:
+        // A warm standby takes over in one driver update; restarting is
+        // the fallback
+        if (standby.armed() && performFailover(StandbyFailover::Reason::Watchdog).switched) {
+            break;
+        }
+        if (!reconnect.options().enabled) {
+            WG_LOG_WARN("WireGuardTunnelManager: {} still degraded ({})", tunnelName, cause);
+            break;
         }
+        WG_LOG_WARN("WireGuardTunnelManager: {} still degraded ({}); restarting", tunnelName, cause);
+        beginRecovery(ReconnectPolicy::Reason::PathDead, tunnelState.snapshot());
+        break;
+    case PathWatchdog::Action::None:
+        break;
+    }
+}
+
+void WireGuardTunnelManager::accountUsage(uint64_t octetsIn, uint64_t octetsOut) {
+    if (!usageLedger) {
+        return;
     }
     
-    free(addresses);
-    return connected;
+    // The adapter is created for each session, so its counters start at zero;
+    // a drop means it was recreated and everything it holds is new
+    uint64_t deltaIn = octetsIn >= ledgerBytesIn ? octetsIn - ledgerBytesIn : octetsIn;
+    uint64_t deltaOut = octetsOut >= ledgerBytesOut ? octetsOut - ledgerBytesOut : octetsOut;
+    ledgerBytesIn = octetsIn;
+    ledgerBytesOut = octetsOut;
+    
+    usageLedger->record(tunnelName, deltaIn, deltaOut);
+    
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastLedgerFlush >= std::chrono::seconds(30)) {
+        usageLedger->flush();
+        lastLedgerFlush = now;
+    }
+    
+    UsageLedger::QuotaHit hit;
+    if (!usageLedger->checkQuotas(tunnelName, hit)) {
+        return;
+    }
+    
+    bool disconnect = hit.quota.action == UsageLedger::QuotaAction::Disconnect;
+    WG_LOG_INFO("WireGuardTunnelManager: Data quota exceeded ({} of {} bytes)", hit.usedBytes,
+                hit.quota.limitBytes);
+    
+    flutter::EncodableMap event;
+    event[flutter::EncodableValue("tunnel")] = flutter::EncodableValue(tunnelName);
+    event[flutter::EncodableValue("period")] = flutter::EncodableValue(UsageLedger::periodName(hit.quota.period));
+    event[flutter::EncodableValue("usedBytes")] = flutter::EncodableValue(static_cast<int64_t>(hit.usedBytes));
+    event[flutter::EncodableValue("limitBytes")] = flutter::EncodableValue(static_cast<int64_t>(hit.quota.limitBytes));
+    event[flutter::EncodableValue("disconnect")] = flutter::EncodableValue(disconnect);
+    postEvent("quota_exceeded", std::move(event));
+    
+    if (disconnect) {
+        quotaDisconnectRequested = true;
+    }
 }
 
-std::map<std::string, uint64_t> WireGuardTunnelManager::getWireGuardInterfaceStatistics() {
-    std::map<std::string, uint64_t> stats;
-    stats["byte_in"] = 0;
-    stats["byte_out"] = 0;
-    stats["speed_in_bps"] = 0;
-    stats["speed_out_bps"] = 0;
+int64_t WireGuardTunnelManager::queryHandshakeAgeMs() {
+    // With a standby on the adapter, its keepalives would hide a dead
+    // active peer, so only the active one counts
+    if (standby.armed()) {
+        return standbyBackend.handshakeAgeMs(standby.active());
+    }
+    uint64_t lastHandshake = 0;
+    if (!adapter.queryLastHandshake(lastHandshake)) {
+        return -1;
+    }
+    return WireGuardAdapter::handshakeAgeMs(lastHandshake);
+}
+
+void WireGuardTunnelManager::resetStatistics() {
+    std::lock_guard<std::mutex> lock(statsMutex);
+    rateIn.reset();
+    rateOut.reset();
+    counterTracker.reset();
+    latestStats = TunnelStats{};
+    statsHistory.clear();
+}
+
+void WireGuardTunnelManager::getStatistics(TunnelStats& stats) {
+    if (!carriesTraffic(tunnelState.state())) {
+        stats = TunnelStats{};
+        return;
+    }
     
-    ULONG bufferSize = 15000;
-    PIP_ADAPTER_ADDRESSES addresses = (IP_ADAPTER_ADDRESSES*)malloc(bufferSize);
+    std::lock_guard<std::mutex> lock(statsMutex);
+    stats = latestStats;
+}
+
+void WireGuardTunnelManager::getStatisticsHistory(size_t maxSamples, std::vector<int64_t>& out) {
+    std::lock_guard<std::mutex> lock(statsMutex);
+    statsHistory.encode(maxSamples, out);
+}
+
+void WireGuardTunnelManager::configureStatistics(const RateEstimator::Options& options) {
+    std::lock_guard<std::mutex> lock(statsMutex);
+    rateIn.configure(options);
+    rateOut.configure(options);
+}
+
+void WireGuardTunnelManager::configureReconnect(const ReconnectPolicy::Options& options) {
+    std::lock_guard<std::mutex> lock(reconnectOptionsMutex);
+    reconnectOptions = options;
+    reconnectOptionsChanged = true;
+}
+
+void WireGuardTunnelManager::applyReconnectOptions() {
+    // A recovery in progress finishes under the options it started with
+    if (!reconnectOptionsChanged || reconnect.recovering()) {
+        return;
+    }
+    reconnectOptionsChanged = false;
+    std::lock_guard<std::mutex> lock(reconnectOptionsMutex);
+    reconnect.configure(reconnectOptions);
+}
+
+void WireGuardTunnelManager::configureKeepalive(bool adaptive, const KeepaliveTuner::Options& options) {
+    std::lock_guard<std::mutex> lock(keepaliveOptionsMutex);
+    keepaliveAdaptiveOption = adaptive;
+    keepaliveOptions = options;
+    keepaliveOptionsChanged = true;
+}
+
+void WireGuardTunnelManager::applyKeepaliveOptions() {
+    if (!keepaliveOptionsChanged) {
+        return;
+    }
+    keepaliveOptionsChanged = false;
+    KeepaliveTuner::Options options;
+    {
+        std::lock_guard<std::mutex> lock(keepaliveOptionsMutex);
+        adaptiveKeepalive = keepaliveAdaptiveOption;
+        options = keepaliveOptions;
+    }
+    WgQuickConfig parsed;
+    configuredKeepalive = 0;
+    if (WgQuickConfig::parse(tunnelConfig, parsed) && !parsed.peers.empty()) {
+        configuredKeepalive = parsed.peers[0].persistentKeepalive;
+    }
+    if (configuredKeepalive != 0) {
+        options.initial = std::chrono::seconds(configuredKeepalive);
+    }
+    keepaliveTuner.configure(options);
+    keepalivePending = adaptiveKeepalive || keepaliveOverridden;
+}
+
+void WireGuardTunnelManager::configureLatencyProbe(const LatencyProbe::Options& options) {
+    std::lock_guard<std::mutex> lock(latencyOptionsMutex);
+    latencyOptions = options;
+    latencyOptionsChanged = true;
+}
+
+void WireGuardTunnelManager::applyLatencyOptions() {
+    if (!latencyOptionsChanged) {
+        return;
+    }
+    latencyOptionsChanged = false;
+    {
+        std::lock_guard<std::mutex> lock(latencyOptionsMutex);
+        latency = latencyOptions;
+    }
+    // Reopened by the next sample, possibly to a new target
+    latencyProbe.close();
+    latencyProbe.tracker().configure(latency.tracker);
+    latencyUnavailable = false;
+    lastLatencyProbe = std::chrono::steady_clock::time_point();
+}
+
+void WireGuardTunnelManager::probeLatency(const InterfaceCounters& counters,
+                                          std::chrono::steady_clock::time_point at) {
+    if (!latency.enabled || latencyUnavailable || !carriesTraffic(tunnelState.state())) {
+        return;
+    }
+    if (!latencyProbe.isOpen()) {
+        std::string target = latency.target;
+        WgQuickConfig parsed;
+        if (target.empty() && WgQuickConfig::parse(tunnelConfig, parsed)) {
+            std::string gateway = parsed.innerGateway();
+            target = gateway.empty() ? gateway : WgQuickConfig::joinEndpoint(gateway, LatencyProbe::kEchoPort);
+        }
+        // Not retried until the options change or the tunnel restarts
+        if (target.empty() || !latencyProbe.open(target)) {
+            WG_LOG_INFO("WireGuardTunnelManager: No round-trip probe for {}", tunnelName);
+            latencyUnavailable = true;
+            return;
+        }
+        WG_LOG_DEBUG("WireGuardTunnelManager: Probing round trips of {} to {}", tunnelName, target);
+    }
+    if (at - lastLatencyProbe < latency.interval) {
+        return;
+    }
     
-    if (!addresses) {
-        return stats;
+    // Nothing but the last probe and its echo went through: the tunnel is
+    // idle and is left that way, so quiet stretches stay quiet
+    uint64_t packets = counters.packetsIn + counters.packetsOut;
+    if (packets >= latencyPackets && packets <= latencyPackets + 2) {
+        latencyProbe.tracker().expire(at);
+        return;
     }
+    latencyPackets = packets;
+    lastLatencyProbe = at;
+    latencyProbe.send(at);
+}
+
+void WireGuardTunnelManager::startMonitoring() {
+    WG_LOG_INFO("WireGuardTunnelManager: Starting connection monitor...");
     
-    ULONG result = GetAdaptersAddresses(
-        AF_UNSPEC,
-        GAA_FLAG_INCLUDE_PREFIX | GAA_FLAG_INCLUDE_GATEWAYS,
-        NULL,
-        addresses,
-        &bufferSize
-    );
+    monitoring = true;
+    connectDeadline = loop.addTimer(std::chrono::seconds(30), [this]() { onConnectTimeout(); });
+    watchServiceProcess();
+}
+
+void WireGuardTunnelManager::stopMonitoring() {
+    monitoring = false;
     
-    if (result == NO_ERROR) {
-        PIP_ADAPTER_ADDRESSES currentAddress = addresses;
-        
-        while (currentAddress) {
-            std::wstring description(currentAddress->Description);
-            std::wstring friendlyName(currentAddress->FriendlyName);
-            
-            // Check if this is a WireGuard adapter
-            if (description.find(L"WireGuard") != std::wstring::npos ||
-                friendlyName.find(L"WireGuard") != std::wstring::npos) {
-                
-                // Get statistics from MIB_IF_ROW2
-                MIB_IF_ROW2 ifRow;
-                ZeroMemory(&ifRow, sizeof(ifRow));
-                ifRow.InterfaceLuid = currentAddress->Luid;
-                
-                if (GetIfEntry2(&ifRow) == NO_ERROR) {
-                    uint64_t currentBytesIn = ifRow.InOctets;
-                    uint64_t currentBytesOut = ifRow.OutOctets;
-                    
-                    stats["byte_in"] = currentBytesIn;
-                    stats["byte_out"] = currentBytesOut;
-                    
-                    // Calculate instantaneous speeds (raw, no smoothing)
-                    // Smoothing will be handled in Dart layer for flexibility
-                    auto now = std::chrono::system_clock::now();
-                    
-                    // Initialize on first call
-                    if (lastStatsTime.time_since_epoch().count() == 0) {
-                        lastBytesIn = currentBytesIn;
-                        lastBytesOut = currentBytesOut;
-                        lastStatsTime = now;
-                        stats["speed_in_bps"] = 0;
-                        stats["speed_out_bps"] = 0;
-                    } else {
-                        // Calculate time difference
-                        auto timeDiff = std::chrono::duration_cast<std::chrono::milliseconds>(now - lastStatsTime);
-                        double timeDiffSeconds = timeDiff.count() / 1000.0;
-                        
-                        // Only calculate if we have at least 100ms elapsed
-                        if (timeDiffSeconds >= 0.1) {
-                            // Calculate byte differences
-                            uint64_t byteInDiff = (currentBytesIn > lastBytesIn) ? (currentBytesIn - lastBytesIn) : 0;
-                            uint64_t byteOutDiff = (currentBytesOut > lastBytesOut) ? (currentBytesOut - lastBytesOut) : 0;
-                            
-                            // Calculate RAW instantaneous speeds (bytes per second)
-                            // No smoothing here - Dart will handle that
-                            double rawSpeedIn = byteInDiff / timeDiffSeconds;
-                            double rawSpeedOut = byteOutDiff / timeDiffSeconds;
-                            
-                            stats["speed_in_bps"] = static_cast<uint64_t>(rawSpeedIn);
-                            stats["speed_out_bps"] = static_cast<uint64_t>(rawSpeedOut);
-                            
-                            // Update tracking variables
-                            lastBytesIn = currentBytesIn;
-                            lastBytesOut = currentBytesOut;
-                            lastStatsTime = now;
-                        }
-                    }
-                }
-                break;
+    // Ids are kept, so a later call from another thread still waits for a
+    // callback that is tearing the tunnel down
+    for (auto* task : {&connectDeadline, &serviceExitWait, &serviceStopTimer, &reconnectTimer, &mtuProbeTask}) {
+        if (EventLoop::TaskId id = task->load()) {
+            loop.cancel(id);
+        }
+    }
+    mtuSearcher.cancel();
+}
+
+std::chrono::milliseconds WireGuardTunnelManager::monitorTick(bool listened) {
+    TraceSpan span("monitor", "tunnel.tick", tunnelName);
+    // Never blocks the loop; a tunnel being torn down skips the tick
+    if (!monitoring) {
+        return cadence.options().idle;
+    }
+    std::unique_lock<std::mutex> lock(monitorMutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        return cadence.options().fast;
+    }
+    applyReconnectOptions();
+    applyKeepaliveOptions();
+    applyLatencyOptions();
+    
+    // Check for actual connection
+    auto current = tunnelState.snapshot();
+    if (current.state == TunnelState::Connecting) {
+        if (!checkConnectionStatus()) {
+            return cadence.next(MonitorCadence::Activity::Connecting, listened);
+        }
+        WG_LOG_INFO("WireGuard connection established!");
+        loop.cancel(connectDeadline);
+        recordPhase(ConnectPhase::AdapterUp);
+        cadence.reset();
+        sampleStatistics(queryHandshakeAgeMs());
+        enterState(current, TunnelState::Connected);
+        scheduleMtuProbe(kMtuProbeDelay);
+        return cadence.next(MonitorCadence::Activity::Connected, listened);
+    }
+    
+    // Check if connected adapter went down
+    if (carriesTraffic(current.state) && !checkConnectionStatus()) {
+        WG_LOG_WARN("WireGuard connection lost");
+        TraceRecorder::instance().instant("adapter", "link.lost", tunnelName);
+        if (reconnect.options().enabled) {
+            beginRecovery(ReconnectPolicy::Reason::LinkLost, current);
+            return cadence.next(MonitorCadence::Activity::Recovering, listened);
+        }
+        stopMonitoring();
+        finishConnect();
+        if (usageLedger) {
+            usageLedger->flush();
+        }
+        enterState(current, TunnelState::Disconnected);
+        return cadence.options().idle;
+    }
+    
+    // Attempts are driven by reconnectTimer; the tick only watches for the
+    // adapter, which may also come back on its own
+    if (current.state == TunnelState::Reconnecting) {
+        if (restarting || !checkConnectionStatus()) {
+            return cadence.next(MonitorCadence::Activity::Recovering, listened);
+        }
+        auto recovery = reconnect.onRecovered(std::chrono::steady_clock::now());
+        if (!enterState(current, TunnelState::Connected)) {
+            return cadence.options().fast;
+        }
+        armReconnectTimer();
+        cadence.reset();
+        if (recovery) {
+            reportRecovery(*recovery);
+        }
+        // The restart may have been for a new network
+        scheduleMtuProbe(kMtuProbeDelay);
+        sampleStatistics(queryHandshakeAgeMs());
+        return cadence.next(MonitorCadence::Activity::Connected, listened);
+    }
+    
+    if (!carriesTraffic(current.state)) {
+        return cadence.options().idle;
+    }
+    
+    applyStandby();
+    applyKeepalive();
+    int64_t handshakeAgeMs = queryHandshakeAgeMs();
+    if (connectTimer.isRunning()) {
+        // The adapter is new for each connect, so any handshake is ours
+        auto now = std::chrono::steady_clock::now();
+        if (handshakeAgeMs >= 0) {
+            recordPhase(ConnectPhase::FirstHandshake, now - std::chrono::milliseconds(handshakeAgeMs));
+            finishConnect();
+        } else if (now - connectTimer.mark() > kFirstHandshakeTimeout) {
+            finishConnect();
+        }
+    }
+    
+    // A roam is over once a handshake went through the new path
+    if (reconnect.roaming() && handshakeAgeMs >= 0) {
+        auto handshakeAt = std::chrono::steady_clock::now() - std::chrono::milliseconds(handshakeAgeMs);
+        if (handshakeAt >= reconnect.roamStart()) {
+            if (auto recovery = reconnect.onRecovered(handshakeAt)) {
+                armReconnectTimer();
+                reportRecovery(*recovery);
             }
-            
-            currentAddress = currentAddress->Next;
         }
     }
     
-    free(addresses);
-    return stats;
+    if (listened) {
+        sampleStatistics(handshakeAgeMs);
+    } else {
+        sampleUsage(handshakeAgeMs);
+    }
+    
+    if (pathVerdict.action != PathWatchdog::Action::None) {
+        onPathVerdict(std::exchange(pathVerdict, PathWatchdog::Verdict{}));
+        if (!carriesTraffic(tunnelState.state())) {
+            return cadence.next(MonitorCadence::Activity::Recovering, listened);
+        }
+    }
+    
+    // Quota enforcement happens here, without waiting for Dart
+    if (quotaDisconnectRequested) {
+        disconnectFromMonitor();
+        return cadence.options().idle;
+    }
+    
+    // A suspect path is sampled fast, so evidence builds up in under a second
+    bool watching = handshakeAgeMs > kStaleHandshakeMs || reconnect.roaming() ||
+                    watchdog.status() != PathWatchdog::Status::Healthy;
+    auto activity = watching ? MonitorCadence::Activity::Recovering : MonitorCadence::Activity::Connected;
+    return cadence.next(activity, listened);
 }
 
-std::map<std::string, uint64_t> WireGuardTunnelManager::getStatistics() {
-    if (!isConnected) {
-        // Reset tracking on disconnect
-        lastBytesIn = 0;
-        lastBytesOut = 0;
-        lastStatsTime = std::chrono::system_clock::time_point{};
-        return {{"byte_in", 0}, {"byte_out", 0}, {"speed_in_bps", 0}, {"speed_out_bps", 0}};
+void WireGuardTunnelManager::onConnectTimeout() {
+    auto current = tunnelState.snapshot();
+    if (current.state != TunnelState::Connecting) {
+        return;
     }
     
-    return getWireGuardInterfaceStatistics();
+    WG_LOG_ERROR("Connection timeout - adapter not coming up");
+    TraceRecorder::instance().instant("connect", "timeout", tunnelName);
+    stopMonitoring();
+    finishConnect();
+    enterState(current, TunnelState::Error);
 }
 
-void WireGuardTunnelManager::monitorConnection() {
-    std::cout << "WireGuardTunnelManager: Starting connection monitor..." << std::endl;
+void WireGuardTunnelManager::watchServiceProcess() {
+    SERVICE_STATUS_PROCESS status;
+    DWORD needed = 0;
+    if (!QueryServiceStatusEx(serviceHandle, SC_STATUS_PROCESS_INFO, reinterpret_cast<LPBYTE>(&status),
+                              sizeof(status), &needed) || status.dwProcessId == 0) {
+        // The monitor tick still notices the adapter going away
+        return;
+    }
     
-    int connectionCheckAttempts = 0;
-    const int maxConnectionCheckAttempts = 30; // 30 seconds
+    serviceProcess = OpenProcess(SYNCHRONIZE, FALSE, status.dwProcessId);
+    if (!serviceProcess) {
+        return;
+    }
+    serviceExitWait = loop.addWait(serviceProcess, [this]() { onServiceExit(); });
+    if (serviceExitWait != 0) {
+        return;
+    }
     
-    while (shouldMonitor) {
-        // Check for actual connection
-        if (isConnecting && checkConnectionStatus()) {
-            std::cout << "WireGuard connection established!" << std::endl;
-            isConnecting = false;
-            isConnected = true;
-            updateStatusThreadSafe("connected");
-        } else if (isConnecting) {
-            connectionCheckAttempts++;
-            if (connectionCheckAttempts >= maxConnectionCheckAttempts) {
-                std::cerr << "Connection timeout - adapter not coming up" << std::endl;
-                updateStatusThreadSafe("error");
-                break;
-            }
+    // Every wait the loop has is taken, e.g. by many tunnels; the process
+    // is polled instead
+    WG_LOG_WARN("WireGuardTunnelManager: No wait left for the service of {}, polling it", tunnelName);
+    serviceExitWait = loop.addRepeatingTimer(kServiceExitPoll, [this]() {
+        if (WaitForSingleObject(serviceProcess, 0) != WAIT_OBJECT_0) {
+            return;
         }
-        
-        // Check if connected adapter went down
-        if (isConnected && !checkConnectionStatus()) {
-            std::cout << "WireGuard connection lost" << std::endl;
-            isConnected = false;
-            updateStatusThreadSafe("disconnected");
-            break;
+        // On the loop, so this does not wait; the id stays for stopMonitoring
+        loop.cancel(serviceExitWait.load());
+        onServiceExit();
+    });
+}
+
+void WireGuardTunnelManager::onServiceExit() {
+    auto current = tunnelState.snapshot();
+    if (current.state == TunnelState::Reconnecting) {
+        // The restarted service gave up before its adapter came up
+        WG_LOG_WARN("WireGuard tunnel service exited while reconnecting");
+        TraceRecorder::instance().instant("service", "exited", tunnelName);
+        closeServiceProcess();
+        handleReconnectStep(reconnect.onAttemptFailed(std::chrono::steady_clock::now()));
+        return;
+    }
+    
+    TunnelState next = TunnelState::Error;
+    if (carriesTraffic(current.state)) {
+        next = TunnelState::Disconnected;
+    } else if (current.state != TunnelState::Connecting) {
+        return;
+    }
+    
+    if (next == TunnelState::Disconnected && reconnect.options().enabled) {
+        WG_LOG_WARN("WireGuard tunnel service exited");
+        TraceRecorder::instance().instant("service", "exited", tunnelName);
+        closeServiceProcess();
+        beginRecovery(ReconnectPolicy::Reason::ServiceExited, current);
+        return;
+    }
+    
+    WG_LOG_INFO("WireGuard tunnel service exited");
+    TraceRecorder::instance().instant("service", "exited", tunnelName);
+    stopMonitoring();
+    finishConnect();
+    closeAdapter();
+    if (usageLedger) {
+        usageLedger->flush();
+    }
+    enterState(current, next);
+}
+
+void WireGuardTunnelManager::closeServiceProcess() {
+    if (serviceProcess) {
+        CloseHandle(serviceProcess);
+        serviceProcess = nullptr;
+    }
+}
+
+void WireGuardTunnelManager::beginRecovery(ReconnectPolicy::Reason reason,
+                                           const TunnelStateMachine::Snapshot& current) {
+    if (!enterState(current, TunnelState::Reconnecting)) {
+        return;
+    }
+    WG_LOG_INFO("WireGuardTunnelManager: Reconnecting {} ({})", tunnelName, ReconnectPolicy::reasonName(reason));
+    finishConnect();
+    // The restarted service creates a new adapter under the same name
+    closeAdapter();
+    hasInterfaceLuid = false;
+    if (usageLedger) {
+        usageLedger->flush();
+    }
+    reconnect.onLost(reason, std::chrono::steady_clock::now());
+    watchdog.reset();
+    pathVerdict = PathWatchdog::Verdict{};
+    cadence.reset();
+    armReconnectTimer();
+}
+
+void WireGuardTunnelManager::armReconnectTimer() {
+    // Only called on the loop, so cancelling never waits
+    if (EventLoop::TaskId previous = reconnectTimer.exchange(0)) {
+        loop.cancel(previous);
+    }
+    auto due = reconnect.nextDue();
+    if (due == ReconnectPolicy::Clock::time_point::max()) {
+        return;
+    }
+    auto delay = std::chrono::ceil<std::chrono::milliseconds>(due - ReconnectPolicy::Clock::now());
+    reconnectTimer = loop.addTimer(std::max(delay, std::chrono::milliseconds(0)), [this]() { onReconnectDue(); });
+}
+
+void WireGuardTunnelManager::onReconnectDue() {
+    // A restart still stopping the old service re-arms once it is done
+    if (!monitoring || restarting) {
+        return;
+    }
+    handleReconnectStep(reconnect.poll(std::chrono::steady_clock::now()));
+}
+
+void WireGuardTunnelManager::handleReconnectStep(const ReconnectPolicy::Step& step) {
+    switch (step.action) {
+    case ReconnectPolicy::Action::Roam:
+        roam();
+        break;
+    case ReconnectPolicy::Action::Restart:
+        restartService();
+        return;
+    case ReconnectPolicy::Action::GiveUp:
+        WG_LOG_WARN("WireGuardTunnelManager: Giving up on {} after {} attempts", tunnelName, step.outcome.attempts);
+        stopMonitoring();
+        reportRecovery(step.outcome);
+        enterState(TunnelState::Disconnected);
+        return;
+    case ReconnectPolicy::Action::None:
+        break;
+    }
+    armReconnectTimer();
+}
+
+void WireGuardTunnelManager::restartService() {
+    TraceRecorder::instance().instant("reconnect", "restart", tunnelName);
+    WG_LOG_INFO("WireGuardTunnelManager: Restarting the service of {}...", tunnelName);
+    
+    // The installed service and its config file are reused; only the
+    // process and its adapter are replaced. The old process is waited for
+    // on the loop, so other tunnels keep ticking meanwhile; stopTunnel
+    // cancels the wait and stops the service itself.
+    loop.cancel(serviceExitWait);
+    closeAdapter();
+    hasInterfaceLuid = false;
+    restarting = true;
+    stopServiceAsync([this](bool) {
+        restarting = false;
+        closeServiceProcess();
+        if (!monitoring) {
+            return;
+        }
+        if (!startRestartedService()) {
+            handleReconnectStep(reconnect.onAttemptFailed(std::chrono::steady_clock::now()));
+            return;
+        }
+        armReconnectTimer();
+    });
+}
+
+bool WireGuardTunnelManager::startRestartedService() {
+    // A stale address is used while the cache refreshes
+    std::string config = withLearnedMtu(withResolvedEndpoints(tunnelConfig));
+    if (config != writtenConfig) {
+        WG_LOG_INFO("WireGuardTunnelManager: Endpoint addresses of {} changed", tunnelName);
+        writeConfigFile(config);
+    }
+    if (!startService()) {
+        return false;
+    }
+    watchServiceProcess();
+    return true;
+}
+
+void WireGuardTunnelManager::roam() {
+    TraceSpan span("reconnect", "roam", tunnelName);
+    if (!adapter.reapplyEndpoints()) {
+        WG_LOG_WARN("WireGuardTunnelManager: Could not re-apply the endpoints of {}", tunnelName);
+        return;
+    }
+    WG_LOG_INFO("WireGuardTunnelManager: Network changed; re-applied the endpoints of {}", tunnelName);
+    // Ticks fast until the handshake shows up
+    cadence.reset();
+}
+
+void WireGuardTunnelManager::onNetworkChange() {
+    // Not one of this tunnel's own callbacks, so stopTunnel does not wait
+    // for it; the mutex keeps it out instead
+    if (!monitoring) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(monitorMutex, std::try_to_lock);
+    if (!lock.owns_lock() || !monitoring) {
+        return;
+    }
+    TunnelState current = tunnelState.state();
+    if (!carriesTraffic(current) && current != TunnelState::Reconnecting) {
+        return;
+    }
+    // Answers may differ on the new network; the registry expired them, so
+    // this refreshes them before a restart needs them
+    prefetchEndpoints(tunnelConfig);
+    reconnect.onNetworkChange(std::chrono::steady_clock::now(), carriesTraffic(current));
+    armReconnectTimer();
+    if (carriesTraffic(current)) {
+        scheduleMtuProbe(kMtuProbeDelay);
+    }
+    // The new NAT has its own timeout; a restart applies the change once
+    // its adapter is up
+    if (adaptiveKeepalive) {
+        if (auto change = keepaliveTuner.onNetworkChange()) {
+            applyKeepaliveChange(*change);
         }
+    }
+}
+
+void WireGuardTunnelManager::reportRecovery(const ReconnectPolicy::Recovery& recovery) {
+    const char* reason = ReconnectPolicy::reasonName(recovery.reason);
+    auto durationMs = static_cast<int64_t>(recovery.duration.count());
+    if (recovery.recovered) {
+        WG_LOG_INFO("WireGuardTunnelManager: {} recovered from {} in {} ms after {} attempts", tunnelName, reason,
+                    durationMs, recovery.attempts);
+    }
+    TraceRecorder::instance().instant("reconnect", recovery.recovered ? "recovered" : "gave.up", tunnelName,
+                                      "durationMs", durationMs);
+    
+    flutter::EncodableMap event;
+    event[flutter::EncodableValue("tunnel")] = flutter::EncodableValue(tunnelName);
+    event[flutter::EncodableValue("reason")] = flutter::EncodableValue(reason);
+    event[flutter::EncodableValue("durationMs")] = flutter::EncodableValue(durationMs);
+    event[flutter::EncodableValue("attempts")] = flutter::EncodableValue(static_cast<int64_t>(recovery.attempts));
+    event[flutter::EncodableValue("recovered")] = flutter::EncodableValue(recovery.recovered);
+    postEvent("recovery", std::move(event));
+}
+
+void WireGuardTunnelManager::reportRace(const EndpointRace& race) {
+    auto winner = race.winner();
+    flutter::EncodableList candidates;
+    for (const auto& entry : race.entries()) {
+        flutter::EncodableMap candidate;
+        candidate[flutter::EncodableValue("endpoint")] = flutter::EncodableValue(entry.endpoint);
+        candidate[flutter::EncodableValue("address")] = flutter::EncodableValue(entry.address);
+        candidate[flutter::EncodableValue("result")] = flutter::EncodableValue(EndpointRace::resultName(entry.result));
+        candidate[flutter::EncodableValue("elapsedMs")] =
+            flutter::EncodableValue(static_cast<int64_t>(entry.elapsed.count()));
+        candidates.push_back(flutter::EncodableValue(std::move(candidate)));
+    }
+    
+    flutter::EncodableMap event;
+    event[flutter::EncodableValue("tunnel")] = flutter::EncodableValue(tunnelName);
+    event[flutter::EncodableValue("winner")] = flutter::EncodableValue(winner ? static_cast<int32_t>(*winner) : -1);
+    event[flutter::EncodableValue("durationMs")] =
+        flutter::EncodableValue(static_cast<int64_t>(race.duration().count()));
+    event[flutter::EncodableValue("candidates")] = flutter::EncodableValue(std::move(candidates));
+    postEvent("endpoint_race", std::move(event));
+}
+
+void WireGuardTunnelManager::scheduleMtuProbe(std::chrono::milliseconds delay) {
+    // Only called on the loop, so cancelling never waits; a search in
+    // progress starts over on the new path
+    if (EventLoop::TaskId previous = mtuProbeTask.exchange(0)) {
+        loop.cancel(previous);
+    }
+    mtuSearcher.cancel();
+    mtuProbeTask = loop.addTimer(delay, [this]() { beginMtuProbe(); });
+}
+
+void WireGuardTunnelManager::beginMtuProbe() {
+    mtuProbeTask = 0;
+    if (!monitoring || !carriesTraffic(tunnelState.state())) {
+        return;
+    }
+    WgQuickConfig parsed;
+    std::string host;
+    std::string port;
+    if (!WgQuickConfig::parse(writtenConfig, parsed) || parsed.peers.empty() ||
+        !WgQuickConfig::splitEndpoint(parsed.peers[0].endpoint, host, port) ||
+        !WgQuickConfig::isAddressLiteral(host)) {
+        WG_LOG_DEBUG("WireGuardTunnelManager: No endpoint address to search the path MTU of {}", tunnelName);
+        return;
+    }
+    
+    mtuAddress = host;
+    mtuProbeStart = std::chrono::steady_clock::now();
+    if (!mtuProber.open(host, hasInterfaceLuid ? &wireguardInterfaceLuid : nullptr)) {
+        finishMtuProbe(PmtuSearch(), false);
+        return;
+    }
+    PmtuSearch::Options options;
+    options.floor = mtuProber.ipv6() ? 1280 : 576;
+    options.ceiling = mtuProber.interfaceMtu();
+    mtuSearcher.start(options, kMtuProbeTimeout, [this](const PmtuSearch& search, bool interrupted) {
+        if (monitoring) {
+            finishMtuProbe(search, interrupted);
+        }
+    });
+}
+
+void WireGuardTunnelManager::finishMtuProbe(const PmtuSearch& search, bool interrupted) {
+    auto durationMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - mtuProbeStart).count();
+    uint32_t interfaceMtu = mtuProber.interfaceMtu();
+    uint32_t pathMtu = interrupted ? 0 : search.pathMtu();
+    bool ipv6 = mtuProber.ipv6();
+    mtuProber.close();
+    
+    std::string error;
+    uint32_t tunnelMtu = 0;
+    bool applied = false;
+    if (interfaceMtu == 0) {
+        error = "no route";
+    } else if (interrupted) {
+        // Too many waits on the loop; the MTU is left as it is
+        error = "interrupted";
+    } else if (pathMtu == 0) {
+        // Echoes are filtered somewhere; the MTU is left as it is
+        error = "no replies";
+    } else {
+        tunnelMtu = PmtuSearch::tunnelMtu(pathMtu, ipv6);
+        learnedMtuAddress = mtuAddress;
+        learnedMtu = tunnelMtu;
+        // A config that sets an MTU keeps it
+        WgQuickConfig parsed;
+        if (!WgQuickConfig::parse(tunnelConfig, parsed) || parsed.mtu == 0) {
+            applied = adapter.setMtu(tunnelMtu);
+        }
+    }
+    
+    if (error.empty()) {
+        WG_LOG_INFO("WireGuardTunnelManager: Path MTU to {} is {}; tunnel MTU {} {}", mtuAddress, pathMtu, tunnelMtu,
+                    applied ? "applied" : "not applied");
+    } else {
+        WG_LOG_WARN("WireGuardTunnelManager: Could not search the path MTU to {} ({})", mtuAddress, error);
+    }
+    TraceRecorder::instance().instant("path", "mtu", tunnelName, "pathMtu", static_cast<int64_t>(pathMtu));
+    
+    flutter::EncodableMap event;
+    event[flutter::EncodableValue("tunnel")] = flutter::EncodableValue(tunnelName);
+    event[flutter::EncodableValue("address")] = flutter::EncodableValue(mtuAddress);
+    event[flutter::EncodableValue("interfaceMtu")] = flutter::EncodableValue(static_cast<int32_t>(interfaceMtu));
+    event[flutter::EncodableValue("pathMtu")] = flutter::EncodableValue(static_cast<int32_t>(pathMtu));
+    event[flutter::EncodableValue("tunnelMtu")] = flutter::EncodableValue(static_cast<int32_t>(tunnelMtu));
+    event[flutter::EncodableValue("probes")] = flutter::EncodableValue(static_cast<int32_t>(search.probes()));
+    event[flutter::EncodableValue("durationMs")] = flutter::EncodableValue(static_cast<int64_t>(durationMs));
+    event[flutter::EncodableValue("applied")] = flutter::EncodableValue(applied);
+    event[flutter::EncodableValue("error")] = flutter::EncodableValue(error);
+    postEvent("path_mtu", std::move(event));
+}
+
+std::string WireGuardTunnelManager::withLearnedMtu(const std::string& config) {
+    WgQuickConfig parsed;
+    std::string host;
+    std::string port;
+    if (learnedMtu == 0 || !WgQuickConfig::parse(config, parsed) || parsed.mtu != 0 || parsed.peers.empty() ||
+        !WgQuickConfig::splitEndpoint(parsed.peers[0].endpoint, host, port) || host != learnedMtuAddress) {
+        return config;
+    }
+    return WgQuickConfig::withInterfaceMtu(config, learnedMtu);
+}
+
+void WireGuardTunnelManager::closeAdapter() {
+    adapter.close();
+    // The next adapter starts from the config again
+    standby.reset();
+    standbyPending = standbyPeer.has_value();
+    keepaliveOverridden = false;
+    keepalivePending = adaptiveKeepalive;
+    // Reopened over the next adapter
+    latencyProbe.close();
+}
+
+bool WireGuardTunnelManager::setStandby(const std::optional<StandbyFailover::Peer>& peer,
+                                        std::function<void(bool)> done) {
+    auto job = std::make_shared<StandbyJob>();
+    job->manager = this;
+    job->peer = peer;
+    job->done = std::move(done);
+    if (peer) {
+        std::string host;
+        if (!WgQuickConfig::splitEndpoint(peer->endpoint, host, job->port)) {
+            WG_LOG_WARN("WireGuardTunnelManager: Standby endpoint {} has no port", peer->endpoint);
+            return false;
+        }
+        // The driver takes addresses only
+        if (!WgQuickConfig::isAddressLiteral(host)) {
+            job->host = host;
+        }
+    }
+    
+    // Only the latest standby counts; one still waiting for its name would
+    // otherwise replace this one
+    std::vector<std::shared_ptr<StandbyJob>> superseded;
+    {
+        std::lock_guard<std::mutex> lock(startMutex);
+        auto previous = std::stable_partition(standbyJobs.begin(), standbyJobs.end(),
+                                              [](const std::shared_ptr<StandbyJob>& pending) {
+                                                  return pending->failover;
+                                              });
+        superseded.assign(previous, standbyJobs.end());
+        standbyJobs.erase(previous, standbyJobs.end());
+    }
+    for (const auto& previous : superseded) {
+        abandonStandbyJob(previous);
+    }
+    queueStandbyJob(job);
+    return true;
+}
+
+// Runs |job| on the loop, once the cache answered for the standby's name
+// or with whatever it has after kResolveTimeout
+void WireGuardTunnelManager::queueStandbyJob(const std::shared_ptr<StandbyJob>& job) {
+    {
+        std::lock_guard<std::mutex> lock(startMutex);
+        standbyJobs.push_back(job);
+    }
+    std::lock_guard<std::mutex> jobLock(job->mutex);
+    if (job->host.empty() || !resolverCache) {
+        loop.post([job]() { continueStandby(job); });
+        return;
+    }
+    job->timeout = loop.addTimer(kResolveTimeout, [job]() { continueStandby(job); });
+    EventLoop* standbyLoop = &loop;
+    resolverCache->whenResolved({job->host}, ResolverCache::Clock::now(), [standbyLoop, job]() {
+        standbyLoop->post([job]() { continueStandby(job); });
+    });
+}
+
+// Runs on the loop once, like continueStart
+void WireGuardTunnelManager::continueStandby(const std::shared_ptr<StandbyJob>& job) {
+    std::function<void(bool)> done;
+    std::function<void(const StandbyFailover::Result&)> failoverDone;
+    bool applied = false;
+    StandbyFailover::Result result;
+    {
+        std::lock_guard<std::mutex> jobLock(job->mutex);
+        WireGuardTunnelManager* manager = job->manager;
+        if (!manager) {
+            return;
+        }
+        job->manager = nullptr;
+        // On the loop, so this does not wait
+        manager->loop.cancel(job->timeout);
         
-        std::this_thread::sleep_for(std::chrono::seconds(1));
+        if (job->failover) {
+            result.error = "not connected";
+            if (manager->monitoring && carriesTraffic(manager->tunnelState.state())) {
+                result = manager->performFailover(StandbyFailover::Reason::User);
+            }
+        } else {
+            std::optional<StandbyFailover::Peer> resolved = job->peer;
+            applied = true;
+            if (resolved && !job->host.empty()) {
+                auto addresses = manager->resolverCache
+                                     ? manager->resolverCache->lookup(job->host, ResolverCache::Clock::now())
+                                     : std::vector<std::string>();
+                if (addresses.empty()) {
+                    WG_LOG_WARN("WireGuardTunnelManager: No address for standby {}", job->host);
+                    applied = false;
+                } else {
+                    resolved->endpoint = WgQuickConfig::joinEndpoint(addresses.front(), job->port);
+                }
+            }
+            if (applied) {
+                manager->standbyPeer = resolved;
+                manager->standbyPending = true;
+                manager->applyStandby();
+            }
+        }
+        done = std::exchange(job->done, nullptr);
+        failoverDone = std::exchange(job->failoverDone, nullptr);
+        std::lock_guard<std::mutex> lock(manager->startMutex);
+        auto& jobs = manager->standbyJobs;
+        jobs.erase(std::remove(jobs.begin(), jobs.end(), job), jobs.end());
+    }
+    if (done) {
+        done(applied);
+    }
+    if (failoverDone) {
+        failoverDone(result);
+    }
+}
+
+// Answers |job| as failed unless the loop already ran it; not called on
+// the loop, since it waits for a timeout callback that is running
+void WireGuardTunnelManager::abandonStandbyJob(const std::shared_ptr<StandbyJob>& job) {
+    std::function<void(bool)> done;
+    std::function<void(const StandbyFailover::Result&)> failoverDone;
+    EventLoop::TaskId timeout = 0;
+    {
+        std::lock_guard<std::mutex> jobLock(job->mutex);
+        if (!job->manager) {
+            return;
+        }
+        job->manager = nullptr;
+        done = std::exchange(job->done, nullptr);
+        failoverDone = std::exchange(job->failoverDone, nullptr);
+        timeout = job->timeout;
+    }
+    loop.cancel(timeout);
+    if (done) {
+        done(false);
+    }
+    if (failoverDone) {
+        StandbyFailover::Result result;
+        result.error = "tunnel stopped";
+        failoverDone(result);
+    }
+}
+
+void WireGuardTunnelManager::applyStandby() {
+    if (!standbyPending || !monitoring || !carriesTraffic(tunnelState.state()) || !adapter.isOpen()) {
+        return;
+    }
+    standbyPending = false;
+    if (!standbyPeer) {
+        standby.disarm();
+        return;
+    }
+    
+    // After a failover the traffic stays where it went
+    WgQuickConfig parsed;
+    std::string active = standby.active();
+    if (active.empty() && WgQuickConfig::parse(tunnelConfig, parsed) && !parsed.peers.empty()) {
+        active = parsed.peers[0].publicKey;
+    }
+    if (!standby.arm(active, *standbyPeer)) {
+        WG_LOG_WARN("WireGuardTunnelManager: Could not add the standby peer of {}", tunnelName);
+        return;
+    }
+    WG_LOG_INFO("WireGuardTunnelManager: Standby at {} kept warm for {}", standbyPeer->endpoint, tunnelName);
+}
+
+void WireGuardTunnelManager::applyKeepalive() {
+    if (!keepalivePending || !monitoring || !carriesTraffic(tunnelState.state()) || !adapter.isOpen()) {
+        return;
+    }
+    keepalivePending = false;
+    uint32_t seconds = adaptiveKeepalive ? static_cast<uint32_t>(keepaliveTuner.keepalive().count())
+                                         : configuredKeepalive;
+    if (!setActiveKeepalive(seconds)) {
+        WG_LOG_WARN("WireGuardTunnelManager: Could not set the keepalive of {}", tunnelName);
+        return;
+    }
+    keepaliveOverridden = adaptiveKeepalive;
+}
+
+void WireGuardTunnelManager::applyKeepaliveChange(const KeepaliveTuner::Change& change) {
+    auto seconds = static_cast<uint32_t>(change.keepalive.count());
+    bool applied = false;
+    if (monitoring && carriesTraffic(tunnelState.state()) && adapter.isOpen()) {
+        applied = setActiveKeepalive(seconds);
+        keepaliveOverridden = keepaliveOverridden || applied;
+    }
+    // Otherwise the next adapter gets it
+    keepalivePending = !applied;
+    const char* reason = KeepaliveTuner::reasonName(change.reason);
+    WG_LOG_INFO("WireGuardTunnelManager: Keepalive of {} is now {} s ({})", tunnelName, seconds, reason);
+    TraceRecorder::instance().instant("path", "keepalive", tunnelName, "seconds", static_cast<int64_t>(seconds));
+    
+    flutter::EncodableMap event;
+    event[flutter::EncodableValue("tunnel")] = flutter::EncodableValue(tunnelName);
+    event[flutter::EncodableValue("keepaliveS")] = flutter::EncodableValue(static_cast<int32_t>(seconds));
+    event[flutter::EncodableValue("reason")] = flutter::EncodableValue(reason);
+    auto survivedMs = static_cast<int64_t>(keepaliveTuner.survived().count());
+    auto lostMs = static_cast<int64_t>(keepaliveTuner.lost().count());
+    event[flutter::EncodableValue("survivedMs")] = flutter::EncodableValue(survivedMs);
+    event[flutter::EncodableValue("lostMs")] = flutter::EncodableValue(lostMs);
+    event[flutter::EncodableValue("applied")] = flutter::EncodableValue(applied);
+    postEvent("keepalive", std::move(event));
+}
+
+bool WireGuardTunnelManager::setActiveKeepalive(uint32_t seconds) {
+    // After a failover the standby carries the traffic
+    WgQuickConfig parsed;
+    std::string active = standby.active();
+    if (active.empty() && WgQuickConfig::parse(tunnelConfig, parsed) && !parsed.peers.empty()) {
+        active = parsed.peers[0].publicKey;
+    }
+    BYTE key[WIREGUARD_KEY_LENGTH];
+    if (active.empty() || !WireGuardAdapter::decodeKey(active, key)) {
+        return false;
+    }
+    return adapter.setPersistentKeepalive(key, static_cast<WORD>(std::min<uint32_t>(seconds, 65535)));
+}
+
+void WireGuardTunnelManager::failover(std::function<void(const StandbyFailover::Result&)> done) {
+    auto job = std::make_shared<StandbyJob>();
+    job->manager = this;
+    job->failover = true;
+    job->failoverDone = std::move(done);
+    queueStandbyJob(job);
+}
+
+flutter::EncodableMap WireGuardTunnelManager::failoverFields(const StandbyFailover::Result& result) {
+    flutter::EncodableMap fields;
+    fields[flutter::EncodableValue("reason")] = flutter::EncodableValue(StandbyFailover::reasonName(result.reason));
+    fields[flutter::EncodableValue("switched")] = flutter::EncodableValue(result.switched);
+    fields[flutter::EncodableValue("from")] = flutter::EncodableValue(result.from);
+    fields[flutter::EncodableValue("to")] = flutter::EncodableValue(result.to);
+    fields[flutter::EncodableValue("standbyHandshakeAgeMs")] = flutter::EncodableValue(result.standbyHandshakeAgeMs);
+    auto durationUs = static_cast<int64_t>(result.duration.count());
+    fields[flutter::EncodableValue("durationUs")] = flutter::EncodableValue(durationUs);
+    fields[flutter::EncodableValue("error")] = flutter::EncodableValue(result.error);
+    return fields;
+}
+
+StandbyFailover::Result WireGuardTunnelManager::performFailover(StandbyFailover::Reason reason) {
+    TraceSpan span("path", "failover", tunnelName);
+    auto began = std::chrono::steady_clock::now();
+    auto result = standby.failover(reason);
+    result.duration =
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - began);
+    if (result.switched) {
+        WG_LOG_INFO("WireGuardTunnelManager: {} failed over to its standby in {} us ({})", tunnelName,
+                    result.duration.count(), StandbyFailover::reasonName(reason));
+        watchdog.onFailedOver(began);
+        cadence.reset();
+        // The new active peer still has the standby's keepalive
+        keepalivePending = adaptiveKeepalive;
+    } else {
+        WG_LOG_WARN("WireGuardTunnelManager: {} could not fail over ({})", tunnelName, result.error);
     }
     
-    std::cout << "Connection monitor stopped" << std::endl;
+    flutter::EncodableMap event = failoverFields(result);
+    event[flutter::EncodableValue("tunnel")] = flutter::EncodableValue(tunnelName);
+    postEvent("failover", std::move(event));
+    return result;
 }
 
-bool WireGuardTunnelManager::startTunnel(const std::string& config) {
-    std::lock_guard<std::mutex> lock(statusMutex);
+void WireGuardTunnelManager::disconnectFromMonitor() {
+    if (!enterState(TunnelState::Disconnecting)) {
+        return;
+    }
+    WG_LOG_INFO("WireGuardTunnelManager: Disconnecting on data quota");
     
-    if (isConnected || isConnecting) {
-        std::cerr << "WireGuardTunnelManager: Already connected or connecting" << std::endl;
+    // Runs on the loop, so the service is stopped without blocking it and
+    // torn down once it is gone; a stopTunnel in between cancels the wait
+    // and finishes the teardown itself
+    stopMonitoring();
+    reconnect.reset();
+    finishConnect();
+    closeAdapter();
+    if (usageLedger) {
+        usageLedger->flush();
+    }
+    stopServiceAsync([this](bool) {
+        deleteService();
+        closeServiceProcess();
+        cleanupTempFiles();
+        enterState(TunnelState::Disconnected);
+    });
+}
+
+bool WireGuardTunnelManager::startTunnel(const std::string& config,
+                                         const std::vector<EndpointRacer::Candidate>& raceCandidates,
+                                         const EndpointRace::Options& raceOptions,
+                                         std::function<void(bool)> done) {
+    // Winning this transition makes the caller the only one setting up
+    if (!enterState(TunnelState::Connecting)) {
+        WG_LOG_WARN("WireGuardTunnelManager: Already connected or connecting");
         return false;
     }
     
-    std::cout << "WireGuardTunnelManager: Starting tunnel..." << std::endl;
+    TraceSpan span("tunnel", "start", tunnelName);
+    WG_LOG_INFO("WireGuardTunnelManager: Starting tunnel...");
+    
+    // Names resolve while the race runs
+    prefetchEndpoints(config);
+    
+    auto job = std::make_shared<StartJob>();
+    std::lock_guard<std::mutex> jobLock(job->mutex);
+    job->manager = this;
+    job->done = std::move(done);
+    {
+        std::lock_guard<std::mutex> lock(startMutex);
+        startJob = job;
+    }
+    
+    // The race runs on the loop and is reported on its own, outside the
+    // connect phases
+    if (!raceCandidates.empty() && raceBackend) {
+        job->racer = EndpointRacer::start(loop, *raceBackend, resolverCache, config, raceCandidates, raceOptions,
+                                          [job](const std::string& raced, const EndpointRace& race) {
+                                              onRaced(job, raced, race);
+                                          });
+        return true;
+    }
+    resolveForStart(job, config);
+    return true;
+}
+
+void WireGuardTunnelManager::onRaced(const std::shared_ptr<StartJob>& job, const std::string& config,
+                                     const EndpointRace& race) {
+    std::lock_guard<std::mutex> jobLock(job->mutex);
+    WireGuardTunnelManager* manager = job->manager;
+    if (!manager) {
+        return;
+    }
+    job->racer.reset();
+    manager->reportRace(race);
+    manager->resolveForStart(job, config);
+}
+
+// Called with the job's mutex held. The service is started on the loop
+// once the cache answered for every name, or with whatever it has after
+// kResolveTimeout; waiting counts towards configWrite.
+void WireGuardTunnelManager::resolveForStart(const std::shared_ptr<StartJob>& job, const std::string& config) {
+    tunnelConfig = config;
+    connectTimer.start();
+    job->resolveStartUs = TraceRecorder::nowUs();
+    
+    std::vector<std::string> hosts;
+    WgQuickConfig parsed;
+    if (resolverCache && WgQuickConfig::parse(config, parsed)) {
+        hosts = parsed.endpointHosts();
+    }
+    if (hosts.empty()) {
+        loop.post([job]() { continueStart(job); });
+        return;
+    }
+    job->timeout = loop.addTimer(kResolveTimeout, [job]() { continueStart(job); });
+    EventLoop* startLoop = &loop;
+    resolverCache->whenResolved(hosts, ResolverCache::Clock::now(), [startLoop, job]() {
+        startLoop->post([job]() { continueStart(job); });
+    });
+}
+
+// Runs on the loop once, whichever of the answers and the timeout comes
+// first; the job keeps it away from a manager stopTunnel is done with.
+// Writing the config and creating and starting the service wait on the disk
+// and the service control manager, so they run on the pool.
+void WireGuardTunnelManager::continueStart(const std::shared_ptr<StartJob>& job) {
+    std::string startConfig;
+    {
+        std::lock_guard<std::mutex> jobLock(job->mutex);
+        WireGuardTunnelManager* manager = job->manager;
+        if (!manager || job->launching) {
+            return;
+        }
+        job->launching = true;
+        // On the loop, so this does not wait
+        manager->loop.cancel(job->timeout);
+        TraceRecorder::instance().complete("tunnel", "resolve", job->resolveStartUs,
+                                           TraceRecorder::nowUs() - job->resolveStartUs, manager->tunnelName);
+        startConfig = manager->withLearnedMtu(manager->withResolvedEndpoints(manager->tunnelConfig));
+    }
+    if (!submitToPool([job, startConfig]() { launchForStart(job, startConfig); })) {
+        WG_LOG_WARN("WireGuardTunnelManager: Failed to queue the launch ({}), launching on the loop", GetLastError());
+        launchForStart(job, startConfig);
+    }
+}
+
+// On the pool. Holds the job's mutex throughout, so stopTunnel waits for
+// the service to be started before it stops it.
+void WireGuardTunnelManager::launchForStart(const std::shared_ptr<StartJob>& job, const std::string& startConfig) {
+    std::lock_guard<std::mutex> jobLock(job->mutex);
+    WireGuardTunnelManager* manager = job->manager;
+    if (!manager) {
+        return;
+    }
+    bool launched = manager->launchTunnel(startConfig);
+    manager->loop.post([job, launched]() { finishStart(job, launched); });
+}
+
+// Back on the loop, unless stopTunnel took the start in between
+void WireGuardTunnelManager::finishStart(const std::shared_ptr<StartJob>& job, bool launched) {
+    std::function<void(bool)> done;
+    {
+        std::lock_guard<std::mutex> jobLock(job->mutex);
+        WireGuardTunnelManager* manager = job->manager;
+        if (!manager) {
+            return;
+        }
+        job->manager = nullptr;
+        if (launched) {
+            manager->beginSession();
+        }
+        done = std::exchange(job->done, nullptr);
+        std::lock_guard<std::mutex> lock(manager->startMutex);
+        if (manager->startJob == job) {
+            manager->startJob.reset();
+        }
+    }
+    if (done) {
+        done(launched);
+    }
+}
+
+// Writes the config, installs and starts the service; on failure undoes
+// what it did and ends the connect
+bool WireGuardTunnelManager::launchTunnel(const std::string& startConfig) {
+    TraceSpan span("tunnel", "launch", tunnelName);
     
     // Create config file
-    if (!createConfigFile(config)) {
+    if (!createConfigFile(startConfig)) {
+        finishConnect();
+        enterState(TunnelState::Disconnected);
         return false;
     }
+    recordPhase(ConnectPhase::ConfigWrite);
     
     // Install Windows Service
     if (!installService()) {
+        finishConnect();
         cleanupTempFiles();
+        enterState(TunnelState::Disconnected);
         return false;
     }
+    recordPhase(ConnectPhase::ServiceInstall);
     
     // Start the service
     if (!startService()) {
+        finishConnect();
         deleteService();
         cleanupTempFiles();
+        enterState(TunnelState::Disconnected);
         return false;
     }
-    
-    // Reset flags and statistics
-    isConnecting = true;
+    recordPhase(ConnectPhase::ServiceStart);
+    return true;
+}
+
+// The rest of the start, on the loop before monitoring
+void WireGuardTunnelManager::beginSession() {
     connectionStartTime = std::chrono::system_clock::now();
     
-    // Reset speed tracking for new connection
-    lastBytesIn = 0;
-    lastBytesOut = 0;
-    lastStatsTime = std::chrono::system_clock::time_point{};
-    
-    updateStatus("connecting");
+    // Reset rate estimation for new connection
+    resetStatistics();
+    hasInterfaceLuid = false;
+    ledgerBytesIn = 0;
+    ledgerBytesOut = 0;
+    lastLedgerFlush = std::chrono::steady_clock::now();
+    quotaDisconnectRequested = false;
     
-    // Start monitoring thread
-    shouldMonitor = true;
-    statusMonitorThread = std::thread(&WireGuardTunnelManager::monitorConnection, this);
+    // No loop callback touches the policy before monitoring starts; a
+    // restart stopTunnel cut short is forgotten with it
+    reconnect.reset();
+    restarting = false;
+    applyReconnectOptions();
+    // The config's own keepalive is where learning starts
+    keepaliveOptionsChanged = true;
+    applyKeepaliveOptions();
+    // Round trips start over for each session
+    latencyOptionsChanged = true;
+    applyLatencyOptions();
+    latencyPackets = 0;
+    watchdog.reset();
+    pathVerdict = PathWatchdog::Verdict{};
+    startMonitoring();
     
-    std::cout << "WireGuardTunnelManager: Tunnel start initiated" << std::endl;
-    return true;
+    WG_LOG_INFO("WireGuardTunnelManager: Tunnel start initiated");
 }
 
 void WireGuardTunnelManager::stopTunnel() {
-    std::cout << "WireGuardTunnelManager: Stopping tunnel..." << std::endl;
+    TraceSpan span("tunnel", "stop", tunnelName);
+    WG_LOG_INFO("WireGuardTunnelManager: Stopping tunnel...");
     
-    // Signal monitor to stop
-    shouldMonitor = false;
+    // A start still on the loop is cut short; taking its mutex waits for
+    // one that is already launching the service on the pool
+    std::shared_ptr<StartJob> job;
+    {
+        std::lock_guard<std::mutex> lock(startMutex);
+        job.swap(startJob);
+    }
+    if (job) {
+        std::function<void(bool)> done;
+        std::shared_ptr<EndpointRacer> racer;
+        EventLoop::TaskId timeout = 0;
+        {
+            std::lock_guard<std::mutex> jobLock(job->mutex);
+            job->manager = nullptr;
+            done = std::exchange(job->done, nullptr);
+            racer = std::move(job->racer);
+            timeout = job->timeout;
+        }
+        loop.cancel(timeout);
+        // Waits until the race adapters are removed
+        if (racer) {
+            racer->cancel();
+        }
+        if (done) {
+            done(false);
+        }
+    }
     
-    // Wait for monitoring thread
-    if (statusMonitorThread.joinable()) {
-        statusMonitorThread.join();
+    // So are standby changes and failovers that have not reached the loop
+    std::vector<std::shared_ptr<StandbyJob>> abandoned;
+    {
+        std::lock_guard<std::mutex> lock(startMutex);
+        abandoned.swap(standbyJobs);
+    }
+    for (const auto& job : abandoned) {
+        abandonStandbyJob(job);
     }
     
+    // Waits for a monitor callback that is already running, then cancels
+    // whatever it left waiting; callbacks starting in between find the
+    // mutex taken and return
+    stopMonitoring();
+    std::lock_guard<std::mutex> lock(monitorMutex);
+    stopMonitoring();
+    finishConnect();
+    reconnect.reset();
+    
+    // Already disconnected when the monitor saw the tunnel go down; the
+    // service may still need removing either way. A quota disconnect may
+    // have been waiting for the service, and is finished here.
+    bool stopping = enterState(TunnelState::Disconnecting) || tunnelState.is(TunnelState::Disconnecting);
+    
     // Stop and delete the service
+    closeAdapter();
     stopService();
     deleteService();
+    closeServiceProcess();
     
-    isConnected = false;
-    isConnecting = false;
-    
-    std::lock_guard<std::mutex> lock(statusMutex);
-    updateStatus("disconnected");
+    if (usageLedger) {
+        usageLedger->flush();
+    }
+    if (stopping) {
+        enterState(TunnelState::Disconnected);
+    }
     
     // Cleanup
     cleanupTempFiles();
     
-    std::cout << "WireGuardTunnelManager: Tunnel stopped" << std::endl;
+    WG_LOG_INFO("WireGuardTunnelManager: Tunnel stopped");
 }
 
 std::string WireGuardTunnelManager::getStatus() {
-    std::lock_guard<std::mutex> lock(statusMutex);
-    return currentStatus;
+    return TunnelStateMachine::stageName(tunnelState.state());
+}
+
+void WireGuardTunnelManager::refreshStatus() {
+    auto current = tunnelState.snapshot();
+    if (dispatcher) {
+        dispatcher->postStage(tunnelName, TunnelStateMachine::stageName(current.state), current.generation);
+    }
+}
+
+bool WireGuardTunnelManager::enterState(TunnelState next) {
+    TunnelStateMachine::Snapshot previous;
+    if (!tunnelState.transition(next, &previous)) {
+        return false;
+    }
+    publishState(next, previous.generation + 1);
+    return true;
 }
 
-void WireGuardTunnelManager::updateStatus(const std::string& status) {
-    currentStatus = status;
-    if (eventSink) {
-        eventSink->Success(flutter::EncodableValue(status));
+bool WireGuardTunnelManager::enterState(const TunnelStateMachine::Snapshot& expected, TunnelState next) {
+    if (!tunnelState.transition(expected, next)) {
+        return false;
     }
-    std::cout << "WireGuardTunnelManager: Status updated to: " << status << std::endl;
+    publishState(next, expected.generation + 1);
+    return true;
 }
 
-void WireGuardTunnelManager::updateStatusThreadSafe(const std::string& status) {
-    std::lock_guard<std::mutex> lock(statusMutex);
-    pendingStatusUpdates.push(status);
+// Safe from any thread; the generation lets the dispatcher drop a change
+// that loses the race to a newer one
+void WireGuardTunnelManager::publishState(TunnelState next, uint64_t generation) {
+    const char* stage = TunnelStateMachine::stageName(next);
+    TraceRecorder::instance().instant("state", stage, tunnelName, "generation", static_cast<int64_t>(generation));
+    statsBlock->publishState(static_cast<WireguardFlutterTunnelState>(next));
+    if (dispatcher) {
+        dispatcher->postStage(tunnelName, stage, generation);
+    }
+    WG_LOG_INFO("WireGuardTunnelManager: {} status updated to: {}", tunnelName, stage);
 }
 
-void WireGuardTunnelManager::processPendingStatusUpdates() {
-    std::lock_guard<std::mutex> lock(statusMutex);
-    while (!pendingStatusUpdates.empty()) {
-        updateStatus(pendingStatusUpdates.front());
-        pendingStatusUpdates.pop();
+void WireGuardTunnelManager::postEvent(const std::string& name, flutter::EncodableMap fields) {
+    if (dispatcher) {
+        dispatcher->postEvent(name, std::move(fields));
     }
 }
 
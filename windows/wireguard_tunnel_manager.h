@@ -1,80 +1,365 @@
 #pragma once
 
 #include <windows.h>
+#include <ifdef.h>
 #include <string>
 #include <memory>
 #include <atomic>
+#include <functional>
 #include <thread>
 #include <mutex>
-#include <queue>
 #include <chrono>
-#include <map>
-#include <flutter/event_channel.h>
+#include <optional>
+#include <vector>
 #include <flutter/encodable_value.h>
 
+#include "adapter_standby.h"
+#include "connect_timings.h"
+#include "endpoint_racer.h"
+#include "event_dispatcher.h"
+#include "event_loop.h"
+#include "interface_counters.h"
+#include "keepalive_tuner.h"
+#include "latency_probe.h"
+#include "monitor_cadence.h"
+#include "path_mtu_prober.h"
+#include "path_watchdog.h"
+#include "pmtu_search.h"
+#include "pmtu_searcher.h"
+#include "rate_estimator.h"
+#include "reconnect_policy.h"
+#include "resolver_cache.h"
+#include "stats_block.h"
+#include "stats_history.h"
+#include "standby_failover.h"
+#include "tunnel_registry.h"
+#include "tunnel_state.h"
+#include "tunnel_stats.h"
+#include "usage_ledger.h"
+#include "wireguard_adapter.h"
+
 namespace wireguard_flutter {
 
-class WireGuardTunnelManager {
+class WireGuardTunnelManager : public TunnelRegistry::Tunnel {
 private:
     // Service handle
     SC_HANDLE serviceHandle = nullptr;
     std::wstring serviceName;
     
-    // Connection state
-    std::atomic<bool> isConnected{false};
-    std::atomic<bool> isConnecting{false};
-    std::string currentStatus = "disconnected";
+    // Connection state; read without locks from any thread
+    TunnelStateMachine tunnelState;
     std::wstring currentConfigPath;
     
-    // Status monitoring
-    std::thread statusMonitorThread;
-    std::atomic<bool> shouldMonitor{true};
+    // Monitoring runs as callbacks on the plugin's event loop. The periodic
+    // tick is shared by all tunnels and driven by the TunnelRegistry;
+    // monitorMutex keeps it out while the platform thread tears down.
+    EventLoop& loop;
+    std::atomic<bool> monitoring{false};
+    std::mutex monitorMutex;
+    std::atomic<EventLoop::TaskId> connectDeadline{0};
+    // Waits for the service process to exit, or polls it when the loop has
+    // no wait left
+    std::atomic<EventLoop::TaskId> serviceExitWait{0};
+    HANDLE serviceProcess = nullptr;
+    // Polls the service while stopServiceAsync waits for it
+    std::atomic<EventLoop::TaskId> serviceStopTimer{0};
+    // Only touched by monitorTick
+    MonitorCadence cadence;
+    
+    // Restarts a lost tunnel and roams after network changes. Only touched
+    // by loop callbacks while monitoring, and by stopTunnel once monitoring
+    // has stopped; options from other threads wait in reconnectOptions
+    // until the next tick picks them up.
+    ReconnectPolicy reconnect;
+    std::atomic<EventLoop::TaskId> reconnectTimer{0};
+    // The old service of a restart is still stopping; its adapter may still
+    // be up under the name the new one gets
+    bool restarting = false;
+    std::mutex reconnectOptionsMutex;
+    ReconnectPolicy::Options reconnectOptions;
+    std::atomic<bool> reconnectOptionsChanged{false};
     
-    // Event sink for status updates
-    flutter::EventSink<flutter::EncodableValue>* eventSink = nullptr;
+    // Fed by the samplers; the verdict of the latest sample waits for
+    // monitorTick to act on it. Only touched by loop callbacks.
+    PathWatchdog watchdog;
+    PathWatchdog::Verdict pathVerdict;
     
-    // Thread safety
-    std::mutex statusMutex;
-    std::queue<std::string> pendingStatusUpdates;
+    // Delivers status changes and events to Dart on the platform thread
+    EventDispatcher* dispatcher = nullptr;
     
     // Connection tracking
     std::chrono::system_clock::time_point connectionStartTime;
     
+    // Phases of the current connect; the timer is only touched by
+    // startTunnel, the start it leaves to the loop and the pool, one at a
+    // time under the start's mutex, and, once monitoring, by loop callbacks.
+    // The store is owned by the plugin and shared.
+    ConnectTimer connectTimer;
+    ConnectTimingStore* timingStore = nullptr;
+    
+    // Endpoint names are handed to the tunnel service as addresses from
+    // the plugin's cache. tunnelConfig is the config as started, with the
+    // names; the file is rewritten from it when a restart finds newer
+    // addresses.
+    ResolverCache* resolverCache = nullptr;
+    // Adapters of endpoint races, owned by the plugin and shared
+    EndpointRacer::Backend* raceBackend = nullptr;
+    std::string tunnelConfig;
+    std::string writtenConfig;
+    
+    // A start racing its endpoints, waiting on the cache for their names or
+    // launching the service on a pool thread. Loop and pool callbacks reach
+    // the manager through it until the start finishes or stopTunnel takes
+    // it and clears |manager|; startMutex only guards startJob and
+    // standbyJobs.
+    struct StartJob {
+        std::mutex mutex;
+        WireGuardTunnelManager* manager = nullptr;
+        std::function<void(bool)> done;
+        std::shared_ptr<EndpointRacer> racer;
+        EventLoop::TaskId timeout = 0;
+        int64_t resolveStartUs = 0;
+        // Handed to the pool; a late resolve timeout finds it set
+        bool launching = false;
+    };
+    std::mutex startMutex;
+    std::shared_ptr<StartJob> startJob;
+    
+    // A setStandby or failover on its way to the loop, the former possibly
+    // waiting on the cache for the standby's name. Reaches the manager like
+    // a StartJob; stopTunnel answers the pending ones as failed.
+    struct StandbyJob {
+        std::mutex mutex;
+        WireGuardTunnelManager* manager = nullptr;
+        // setStandby: the peer, with the name its endpoint still needs
+        std::optional<StandbyFailover::Peer> peer;
+        std::string host;
+        std::string port;
+        std::function<void(bool)> done;
+        // Or a failover
+        bool failover = false;
+        std::function<void(const StandbyFailover::Result&)> failoverDone;
+        EventLoop::TaskId timeout = 0;
+    };
+    std::vector<std::shared_ptr<StandbyJob>> standbyJobs;
+    
     // WireGuard interface name for stats
     std::wstring wireguardInterfaceName;
     
-    // Speed tracking (for calculating instantaneous speeds)
-    uint64_t lastBytesIn = 0;
-    uint64_t lastBytesOut = 0;
-    std::chrono::system_clock::time_point lastStatsTime;
+    // LUID of the adapter, cached by checkConnectionStatus so sampling can go
+    // straight to GetIfEntry2 without enumerating adapters. Only touched on
+    // the loop, which also runs the rest of a start; other threads see the
+    // samples as latestStats under statsMutex.
+    NET_LUID wireguardInterfaceLuid{};
+    bool hasInterfaceLuid = false;
+    
+    // Name used in method calls, events and the usage ledger
+    std::string tunnelName;
+    
+    // Counter block readers find through getTunnels
+    StatsBlock* statsBlock = nullptr;
+    int32_t statsBlockIndex = -1;
+    
+    // Usage accounting; the ledger is owned by the plugin and shared
+    UsageLedger* usageLedger = nullptr;
+    uint64_t ledgerBytesIn = 0;
+    uint64_t ledgerBytesOut = 0;
+    std::chrono::steady_clock::time_point lastLedgerFlush;
+    bool quotaDisconnectRequested = false;
+    
+    // Adapter created by the tunnel service, named after the config file.
+    // Only touched by loop callbacks while monitoring.
+    std::wstring adapterName;
+    WireGuardAdapter adapter;
+    
+    // Warm standby peer on the adapter, touched on the loop thread only.
+    // The configured peer is kept apart and applied again whenever a new
+    // adapter comes up.
+    AdapterStandby standbyBackend{adapter};
+    StandbyFailover standby{standbyBackend};
+    std::optional<StandbyFailover::Peer> standbyPeer;
+    bool standbyPending = false;
+    
+    // Path MTU to the first peer's endpoint, searched from outside the
+    // tunnel once it is up and again after network changes. The tunnel MTU
+    // it gives is applied to the adapter unless the config sets one, and is
+    // written into the config of later starts to the same address. Only
+    // touched by loop callbacks, and by the start before monitoring.
+    PathMtuProber mtuProber;
+    PmtuSearcher mtuSearcher{loop, mtuProber};
+    std::atomic<EventLoop::TaskId> mtuProbeTask{0};
+    std::chrono::steady_clock::time_point mtuProbeStart;
+    std::string mtuAddress;
+    std::string learnedMtuAddress;
+    uint32_t learnedMtu = 0;
+    
+    // Persistent keepalive of the active peer, learned from the NAT in front
+    // of the tunnel while adaptive. The config's value is the starting point
+    // and comes back when adaptive mode is turned off. Only touched by loop
+    // callbacks, and by the start before monitoring; options from other
+    // threads wait in keepaliveOptions like the reconnect ones.
+    KeepaliveTuner keepaliveTuner;
+    bool adaptiveKeepalive = false;
+    uint32_t configuredKeepalive = 0;
+    // The adapter holds a value other than the config's
+    bool keepaliveOverridden = false;
+    bool keepalivePending = false;
+    std::mutex keepaliveOptionsMutex;
+    bool keepaliveAdaptiveOption = false;
+    KeepaliveTuner::Options keepaliveOptions;
+    std::atomic<bool> keepaliveOptionsChanged{false};
+    
+    // Round trips through the tunnel, probed by the sampler while someone
+    // reads the statistics and the tunnel carries traffic of its own. Only
+    // touched by loop callbacks, and by the start before monitoring;
+    // options from other threads wait in latencyOptions.
+    LatencyProbe latencyProbe{loop};
+    LatencyProbe::Options latency;
+    bool latencyUnavailable = false;
+    std::chrono::steady_clock::time_point lastLatencyProbe;
+    uint64_t latencyPackets = 0;
+    std::mutex latencyOptionsMutex;
+    LatencyProbe::Options latencyOptions;
+    std::atomic<bool> latencyOptionsChanged{false};
+    
+    // Rates are estimated by the monitor tick; getStatistics
+    // only copies the latest sample out
+    std::mutex statsMutex;
+    RateEstimator rateIn;
+    RateEstimator rateOut;
+    InterfaceCounterTracker counterTracker;
+    TunnelStats latestStats{};
+    StatsHistory statsHistory;
 
 public:
-    WireGuardTunnelManager();
-    ~WireGuardTunnelManager();
+    WireGuardTunnelManager(EventLoop& eventLoop, const std::string& name);
+    ~WireGuardTunnelManager() override;
     
-    void setEventSink(flutter::EventSink<flutter::EncodableValue>* sink);
-    bool startTunnel(const std::string& config);
+    void setEventDispatcher(EventDispatcher* eventDispatcher);
+    const std::string& name() const { return tunnelName; }
+    int32_t getStatsBlockIndex() const { return statsBlockIndex; }
+    bool isActive() const override {
+        TunnelState current = tunnelState.state();
+        return current == TunnelState::Connecting || current == TunnelState::Connected ||
+               current == TunnelState::Reconnecting || current == TunnelState::Degraded;
+    }
+    void setUsageLedger(UsageLedger* ledger);
+    void setConnectTimingStore(ConnectTimingStore* store);
+    void setResolverCache(ResolverCache* cache);
+    void setRaceBackend(EndpointRacer::Backend* backend);
+    // With |raceCandidates|, they and the config's own endpoint are raced
+    // first and the tunnel starts on the winner. Returns false when already
+    // connected or connecting. Otherwise the service is started on the
+    // thread pool once the endpoint names are resolved, and |done| gets the
+    // outcome on the loop; a stopTunnel before that calls it with false
+    // instead.
+    bool startTunnel(const std::string& config,
+                     const std::vector<EndpointRacer::Candidate>& raceCandidates,
+                     const EndpointRace::Options& raceOptions,
+                     std::function<void(bool)> done);
     void stopTunnel();
     std::string getStatus();
-    std::map<std::string, uint64_t> getStatistics();
+    // Re-sends the current stage through the dispatcher
+    void refreshStatus();
+    void getStatistics(TunnelStats& stats);
+    void configureStatistics(const RateEstimator::Options& options) override;
+    void getStatisticsHistory(size_t maxSamples, std::vector<int64_t>& out);
+    void configureReconnect(const ReconnectPolicy::Options& options) override;
+    // Keeps |peer| warm next to the config's first peer, or removes the
+    // standby without one; applied once the tunnel is up. Its endpoint may
+    // be a name, which the cache resolves first. |done| runs on the loop,
+    // or with false from a newer setStandby or stopTunnel; false without
+    // calling it when the endpoint has no port.
+    bool setStandby(const std::optional<StandbyFailover::Peer>& peer, std::function<void(bool)> done);
+    // Learns the keepalive with |options| while |adaptive|; otherwise the
+    // config's own value is used. Picked up by the next tick.
+    void configureKeepalive(bool adaptive, const KeepaliveTuner::Options& options) override;
+    // Round-trip probing through the tunnel; picked up by the next tick,
+    // which starts the statistics over
+    void configureLatencyProbe(const LatencyProbe::Options& options) override;
+    // Moves the first peer's traffic to the standby on the loop; |done|
+    // gets the result there, or "tunnel stopped" from stopTunnel
+    void failover(std::function<void(const StandbyFailover::Result&)> done);
+    // |result| as sent to Dart
+    static flutter::EncodableMap failoverFields(const StandbyFailover::Result& result);
     
-    // Process pending status updates (call from main thread)
-    void processPendingStatusUpdates();
+    // Called by the registry's shared timer on the event loop
+    std::chrono::milliseconds monitorTick(bool listened) override;
+    void onNetworkChange() override;
     
 private:
+    static void onRaced(const std::shared_ptr<StartJob>& job, const std::string& config, const EndpointRace& race);
+    void resolveForStart(const std::shared_ptr<StartJob>& job, const std::string& config);
+    static void continueStart(const std::shared_ptr<StartJob>& job);
+    static void launchForStart(const std::shared_ptr<StartJob>& job, const std::string& startConfig);
+    static void finishStart(const std::shared_ptr<StartJob>& job, bool launched);
+    bool launchTunnel(const std::string& startConfig);
+    void beginSession();
     bool installService();
     bool startService();
     bool stopService();
+    // stopService for the loop: |done| runs on the loop once the service
+    // stopped, or with false once it timed out, and never runs if
+    // stopMonitoring cancels the wait first
+    void stopServiceAsync(std::function<void(bool)> done);
     bool deleteService();
-    void monitorConnection();
-    void updateStatus(const std::string& status);
-    void updateStatusThreadSafe(const std::string& status);
+    void startMonitoring();
+    void stopMonitoring();
+    void onConnectTimeout();
+    void watchServiceProcess();
+    void onServiceExit();
+    void closeServiceProcess();
+    void applyReconnectOptions();
+    void beginRecovery(ReconnectPolicy::Reason reason, const TunnelStateMachine::Snapshot& current);
+    void armReconnectTimer();
+    void onReconnectDue();
+    void handleReconnectStep(const ReconnectPolicy::Step& step);
+    // Stops the service on the loop, then starts it again and arms the
+    // attempt's timeout
+    void restartService();
+    bool startRestartedService();
+    void roam();
+    void reportRecovery(const ReconnectPolicy::Recovery& recovery);
+    void reportRace(const EndpointRace& race);
+    void scheduleMtuProbe(std::chrono::milliseconds delay);
+    void beginMtuProbe();
+    void finishMtuProbe(const PmtuSearch& search, bool interrupted);
+    std::string withLearnedMtu(const std::string& config);
+    static void continueStandby(const std::shared_ptr<StandbyJob>& job);
+    void queueStandbyJob(const std::shared_ptr<StandbyJob>& job);
+    void abandonStandbyJob(const std::shared_ptr<StandbyJob>& job);
+    void closeAdapter();
+    void applyStandby();
+    void applyKeepaliveOptions();
+    void applyKeepalive();
+    void applyKeepaliveChange(const KeepaliveTuner::Change& change);
+    bool setActiveKeepalive(uint32_t seconds);
+    void applyLatencyOptions();
+    void probeLatency(const InterfaceCounters& counters, std::chrono::steady_clock::time_point at);
+    StandbyFailover::Result performFailover(StandbyFailover::Reason reason);
+    void observePath(const InterfaceCounters& counters, int64_t handshakeAgeMs,
+                     std::chrono::steady_clock::time_point at);
+    void onPathVerdict(const PathWatchdog::Verdict& verdict);
+    bool enterState(TunnelState next);
+    bool enterState(const TunnelStateMachine::Snapshot& expected, TunnelState next);
+    void publishState(TunnelState next, uint64_t generation);
+    void postEvent(const std::string& name, flutter::EncodableMap fields);
+    void accountUsage(uint64_t octetsIn, uint64_t octetsOut);
+    void recordPhase(ConnectPhase phase, std::chrono::steady_clock::time_point at = std::chrono::steady_clock::now());
+    void finishConnect();
+    void disconnectFromMonitor();
+    void prefetchEndpoints(const std::string& config);
+    std::string withResolvedEndpoints(const std::string& config);
     bool createConfigFile(const std::string& config);
+    bool writeConfigFile(const std::string& config);
     void cleanupTempFiles();
     bool checkConnectionStatus();
     std::wstring getAppDirectory();
     std::wstring getAppExecutablePath();
-    std::map<std::string, uint64_t> getWireGuardInterfaceStatistics();
+    void sampleStatistics(int64_t handshakeAgeMs);
+    void sampleUsage(int64_t handshakeAgeMs);
+    int64_t queryHandshakeAgeMs();
+    void resetStatistics();
 };
 
 } // namespace wireguard_flutter